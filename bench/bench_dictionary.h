@@ -0,0 +1,45 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+// The dictionary and inputs shared by the benchmarks of dict primitives.
+//
+#ifndef RIME_BENCH_DICTIONARY_H_
+#define RIME_BENCH_DICTIONARY_H_
+
+#include <iterator>
+#include <rime/common.h>
+#include <rime/dict/dict_compiler.h>
+#include <rime/dict/dictionary.h>
+
+namespace rime_bench {
+
+// compiles luna_pinyin.dict.yaml in the working directory on first use.
+inline rime::Dictionary* LoadDictionary() {
+  static rime::the<rime::Dictionary> dict;
+  if (!dict) {
+    dict.reset(new rime::Dictionary(
+        "luna_pinyin", {},
+        {rime::New<rime::Table>(rime::path{"luna_pinyin.table.bin"})},
+        rime::New<rime::Prism>(rime::path{"luna_pinyin.prism.bin"})));
+    rime::DictCompiler dict_compiler(dict.get());
+    dict_compiler.Compile(rime::path());  // no schema file
+    dict->Load();
+  }
+  return dict.get();
+}
+
+inline const char* const kSampleInputs[] = {
+    "zhongguo",
+    "shurufa",
+    "women",
+    "zhonghuarenmingongheguo",
+    "woxianzaijiuyaoqushangban",
+    "jintiantianqihenhaowomenquchuwanba",
+};
+
+inline constexpr int kNumSampleInputs = std::size(kSampleInputs);
+
+}  // namespace rime_bench
+
+#endif  // RIME_BENCH_DICTIONARY_H_
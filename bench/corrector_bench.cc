@@ -0,0 +1,54 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <benchmark/benchmark.h>
+#include <rime/common.h>
+#include <rime/dict/corrector.h>
+
+namespace {
+
+// pairs of input and syllable from the corrector tests.
+const char* kSamplePairs[][2] = {
+    {"chsng", "chang"}, {"chpng", "chang"}, {"cahng", "chang"},
+    {"tyan", "tuan"},   {"jie", "jue"},     {"shen", "jue"},
+};
+
+// the threshold the syllabifier searches with.
+const rime::corrector::Distance kThreshold = 5;
+const rime::corrector::Distance kNoThreshold = 1000;
+
+static void RestrictedDistance(benchmark::State& state,
+                               rime::corrector::Distance threshold) {
+  rime::EditDistanceCorrector corrector(rime::path{"corrector_bench.bin"});
+  for (auto _ : state) {
+    for (const auto& pair : kSamplePairs) {
+      benchmark::DoNotOptimize(
+          corrector.RestrictedDistance(pair[0], pair[1], threshold));
+    }
+  }
+}
+
+// the weighted distance of every pair, as computed without bounds.
+static void BM_RestrictedDistanceScalar(benchmark::State& state) {
+  RestrictedDistance(state, kNoThreshold);
+}
+BENCHMARK(BM_RestrictedDistanceScalar);
+
+// far pairs are cut off by the bit-parallel distance.
+static void BM_RestrictedDistanceBounded(benchmark::State& state) {
+  RestrictedDistance(state, kThreshold);
+}
+BENCHMARK(BM_RestrictedDistanceBounded);
+
+static void BM_BitParallelDistance(benchmark::State& state) {
+  for (auto _ : state) {
+    for (const auto& pair : kSamplePairs) {
+      benchmark::DoNotOptimize(
+          rime::EditDistanceCorrector::BitParallelDistance(pair[0], pair[1]));
+    }
+  }
+}
+BENCHMARK(BM_BitParallelDistance);
+
+}  // namespace
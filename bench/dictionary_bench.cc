@@ -0,0 +1,51 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <benchmark/benchmark.h>
+#include <rime/common.h>
+#include <rime/algo/syllabifier.h>
+#include <rime/dict/dictionary.h>
+#include "bench_dictionary.h"
+
+namespace {
+
+using rime_bench::kNumSampleInputs;
+using rime_bench::kSampleInputs;
+using rime_bench::LoadDictionary;
+
+// iterates over all entries found at the start of the input, making a
+// DictEntry of each as the translator does.
+static void BM_DictEntryIterator(benchmark::State& state) {
+  auto* dict = LoadDictionary();
+  if (!dict->loaded()) {
+    state.SkipWithError("failed to load dictionary.");
+    return;
+  }
+  rime::Syllabifier syllabifier;
+  rime::SyllableGraph graph;
+  syllabifier.BuildSyllableGraph(kSampleInputs[state.range(0)], *dict->prism(),
+                                 &graph);
+  auto collector = dict->Lookup(graph, 0);
+  if (!collector) {
+    state.SkipWithError("no entries found.");
+    return;
+  }
+  size_t entries = 0;
+  for (auto _ : state) {
+    // copies iterate independently of the looked up ones.
+    rime::DictEntryCollector copy(*collector);
+    for (auto& x : copy) {
+      auto& iter = x.second;
+      for (; !iter.exhausted(); iter.Next()) {
+        benchmark::DoNotOptimize(iter.Peek());
+        ++entries;
+      }
+    }
+  }
+  state.SetItemsProcessed(entries);
+  state.SetLabel(kSampleInputs[state.range(0)]);
+}
+BENCHMARK(BM_DictEntryIterator)->DenseRange(0, kNumSampleInputs - 1);
+
+}  // namespace
@@ -0,0 +1,64 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <benchmark/benchmark.h>
+#include <rime/common.h>
+#include <rime/algo/syllabifier.h>
+#include <rime/dict/dictionary.h>
+#include <rime/gear/poet.h>
+#include "bench_dictionary.h"
+
+namespace {
+
+using rime_bench::kNumSampleInputs;
+using rime_bench::kSampleInputs;
+using rime_bench::LoadDictionary;
+
+// the default of translator/max_homophones.
+const size_t kMaxHomophones = 1;
+
+// the word graph of the input, as the script translator makes it from
+// dictionary lookups at each position.
+rime::WordGraph MakeWordGraph(rime::Dictionary* dict,
+                              const rime::SyllableGraph& syllable_graph) {
+  rime::WordGraph graph;
+  for (const auto& x : syllable_graph.edges) {
+    auto& same_start_pos = graph[x.first];
+    auto collector = dict->Lookup(syllable_graph, x.first);
+    if (!collector)
+      continue;
+    for (auto& y : *collector) {
+      auto& homophones = same_start_pos[y.first];
+      for (auto& iter = y.second;
+           homophones.size() < kMaxHomophones && !iter.exhausted();
+           iter.Next()) {
+        homophones.push_back(iter.Peek());
+      }
+    }
+  }
+  return graph;
+}
+
+static void BM_PoetMakeSentence(benchmark::State& state) {
+  auto* dict = LoadDictionary();
+  if (!dict->loaded()) {
+    state.SkipWithError("failed to load dictionary.");
+    return;
+  }
+  rime::Syllabifier syllabifier;
+  rime::SyllableGraph syllable_graph;
+  syllabifier.BuildSyllableGraph(kSampleInputs[state.range(0)], *dict->prism(),
+                                 &syllable_graph);
+  auto graph = MakeWordGraph(dict, syllable_graph);
+  for (auto _ : state) {
+    // a new poet does not reuse the lattice of the last sentence.
+    rime::Poet poet(nullptr, nullptr);
+    benchmark::DoNotOptimize(
+        poet.MakeSentence(graph, syllable_graph.interpreted_length, ""));
+  }
+  state.SetLabel(kSampleInputs[state.range(0)]);
+}
+BENCHMARK(BM_PoetMakeSentence)->DenseRange(0, kNumSampleInputs - 1);
+
+}  // namespace
@@ -0,0 +1,62 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <benchmark/benchmark.h>
+#include <rime/common.h>
+#include <rime/dict/dictionary.h>
+#include <rime/dict/prism.h>
+#include "bench_dictionary.h"
+
+namespace {
+
+using rime_bench::kNumSampleInputs;
+using rime_bench::kSampleInputs;
+using rime_bench::LoadDictionary;
+
+// prefixes being typed, which are completed by the expand search.
+const char* kSamplePrefixes[] = {"z", "zh", "zho", "sh", "w", "ji", "xia"};
+
+const size_t kExpandSearchLimit = 512;
+
+static void BM_PrismCommonPrefixSearch(benchmark::State& state) {
+  auto* dict = LoadDictionary();
+  if (!dict->loaded()) {
+    state.SkipWithError("failed to load dictionary.");
+    return;
+  }
+  auto& prism = *dict->prism();
+  const std::string input = kSampleInputs[state.range(0)];
+  std::vector<rime::Prism::Match> matches;
+  for (auto _ : state) {
+    // as the syllabifier does, at each position of the input.
+    for (size_t pos = 0; pos < input.length(); ++pos) {
+      matches.clear();
+      prism.CommonPrefixSearch(input.substr(pos), &matches);
+      benchmark::DoNotOptimize(matches);
+    }
+  }
+  state.SetLabel(kSampleInputs[state.range(0)]);
+}
+BENCHMARK(BM_PrismCommonPrefixSearch)->DenseRange(0, kNumSampleInputs - 1);
+
+static void BM_PrismExpandSearch(benchmark::State& state) {
+  auto* dict = LoadDictionary();
+  if (!dict->loaded()) {
+    state.SkipWithError("failed to load dictionary.");
+    return;
+  }
+  auto& prism = *dict->prism();
+  const std::string prefix = kSamplePrefixes[state.range(0)];
+  std::vector<rime::Prism::Match> matches;
+  for (auto _ : state) {
+    matches.clear();
+    prism.ExpandSearch(prefix, &matches, kExpandSearchLimit);
+    benchmark::DoNotOptimize(matches);
+  }
+  state.SetLabel(prefix);
+}
+BENCHMARK(BM_PrismExpandSearch)
+    ->DenseRange(0, std::size(kSamplePrefixes) - 1);
+
+}  // namespace
@@ -0,0 +1,294 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+// Replays key sequences against input schemas and reports the latency of
+// each keystroke, as seen by a frontend that updates its candidate window
+// after every key.
+//
+// usage: rime_bench [--json] [--repeat N] [schema_id[=corpus_file]]...
+//
+// The corpus of a schema defaults to <schema_id>.keys, with one utterance
+// per line in the syntax of RimeApi::simulate_key_sequence.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <rime_api.h>
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+const char* kUserDataDir = "rime_bench_data";
+
+struct Corpus {
+  std::string schema_id;
+  std::string file_name;
+  // utterances split into keys
+  std::vector<std::vector<std::string>> utterances;
+};
+
+struct Result {
+  size_t keystrokes = 0;
+  double total_us = 0;
+  double mean_us = 0;
+  double p50_us = 0;
+  double p95_us = 0;
+  double p99_us = 0;
+  double max_us = 0;
+  double keys_per_second = 0;
+  size_t peak_rss_kb = 0;
+};
+
+// splits a key sequence into single characters and {named} keys.
+std::vector<std::string> SplitKeys(const std::string& sequence) {
+  std::vector<std::string> keys;
+  for (size_t i = 0; i < sequence.length(); ++i) {
+    size_t end = i + 1;
+    if (sequence[i] == '{') {
+      size_t close = sequence.find('}', i);
+      if (close != std::string::npos)
+        end = close + 1;
+    }
+    keys.push_back(sequence.substr(i, end - i));
+    i = end - 1;
+  }
+  return keys;
+}
+
+bool LoadCorpus(Corpus* corpus) {
+  std::ifstream in(corpus->file_name);
+  if (!in) {
+    fprintf(stderr, "error opening corpus: %s\n", corpus->file_name.c_str());
+    return false;
+  }
+  std::string line;
+  while (std::getline(in, line)) {
+    if (!line.empty() && line.back() == '\r')
+      line.pop_back();
+    if (line.empty() || line[0] == '#')
+      continue;
+    corpus->utterances.push_back(SplitKeys(line));
+  }
+  return !corpus->utterances.empty();
+}
+
+size_t PeakRssKb() {
+#if defined(_WIN32)
+  PROCESS_MEMORY_COUNTERS counters;
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    return 0;
+  return counters.PeakWorkingSetSize / 1024;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+#if defined(__APPLE__)
+  return usage.ru_maxrss / 1024;  // in bytes
+#else
+  return usage.ru_maxrss;  // in kilobytes
+#endif
+#endif
+}
+
+// processes one key and reads the context, returning the elapsed time.
+double ProcessKey(RimeApi* rime,
+                  RimeSessionId session_id,
+                  const std::string& key) {
+  using Clock = std::chrono::steady_clock;
+  auto start = Clock::now();
+  rime->simulate_key_sequence(session_id, key.c_str());
+  RIME_STRUCT(RimeContext, context);
+  if (rime->get_context(session_id, &context))
+    rime->free_context(&context);
+  RIME_STRUCT(RimeCommit, commit);
+  if (rime->get_commit(session_id, &commit))
+    rime->free_commit(&commit);
+  auto end = Clock::now();
+  return std::chrono::duration<double, std::micro>(end - start).count();
+}
+
+void Replay(RimeApi* rime,
+            RimeSessionId session_id,
+            const Corpus& corpus,
+            std::vector<double>* latencies) {
+  for (const auto& keys : corpus.utterances) {
+    for (const auto& key : keys) {
+      double elapsed = ProcessKey(rime, session_id, key);
+      if (latencies)
+        latencies->push_back(elapsed);
+    }
+    rime->clear_composition(session_id);
+  }
+}
+
+// nearest-rank percentile of sorted values.
+double Percentile(const std::vector<double>& sorted, double p) {
+  size_t rank = size_t(p / 100.0 * sorted.size() + 0.5);
+  rank = std::clamp<size_t>(rank, 1, sorted.size());
+  return sorted[rank - 1];
+}
+
+bool Run(RimeApi* rime, const Corpus& corpus, int repeat, Result* result) {
+  RimeSessionId session_id = rime->create_session();
+  if (!session_id) {
+    fprintf(stderr, "error creating rime session.\n");
+    return false;
+  }
+  if (!rime->select_schema(session_id, corpus.schema_id.c_str())) {
+    fprintf(stderr, "error selecting schema: %s\n", corpus.schema_id.c_str());
+    rime->destroy_session(session_id);
+    return false;
+  }
+  // warm up, so that dictionaries are loaded before the timing.
+  Replay(rime, session_id, corpus, nullptr);
+  std::vector<double> latencies;
+  for (int i = 0; i < repeat; ++i) {
+    Replay(rime, session_id, corpus, &latencies);
+  }
+  rime->destroy_session(session_id);
+  if (latencies.empty())
+    return false;
+  result->keystrokes = latencies.size();
+  for (double latency : latencies) {
+    result->total_us += latency;
+  }
+  std::sort(latencies.begin(), latencies.end());
+  result->mean_us = result->total_us / latencies.size();
+  result->p50_us = Percentile(latencies, 50);
+  result->p95_us = Percentile(latencies, 95);
+  result->p99_us = Percentile(latencies, 99);
+  result->max_us = latencies.back();
+  result->keys_per_second =
+      result->total_us > 0 ? latencies.size() * 1e6 / result->total_us : 0;
+  result->peak_rss_kb = PeakRssKb();
+  return true;
+}
+
+// lists the schemas to deploy, ahead of those in the shared default.yaml.
+bool PrepareUserData(const std::vector<Corpus>& corpora) {
+  std::error_code ec;
+  // start afresh, without what the user dictionaries learnt last time.
+  std::filesystem::remove_all(kUserDataDir, ec);
+  std::filesystem::create_directories(kUserDataDir, ec);
+  std::ofstream out(std::filesystem::path(kUserDataDir) /
+                    "default.custom.yaml");
+  if (!out)
+    return false;
+  out << "patch:\n  schema_list:\n";
+  for (const auto& corpus : corpora) {
+    out << "    - schema: " << corpus.schema_id << "\n";
+  }
+  return bool(out);
+}
+
+void PrintText(const std::vector<Corpus>& corpora,
+               const std::vector<Result>& results) {
+  printf("%-22s %8s %9s %9s %9s %9s %10s %10s\n", "schema", "keys", "p50_us",
+         "p95_us", "p99_us", "max_us", "keys/s", "rss_kb");
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Result& r = results[i];
+    printf("%-22s %8zu %9.1f %9.1f %9.1f %9.1f %10.0f %10zu\n",
+           corpora[i].schema_id.c_str(), r.keystrokes, r.p50_us, r.p95_us,
+           r.p99_us, r.max_us, r.keys_per_second, r.peak_rss_kb);
+  }
+}
+
+void PrintJson(const std::vector<Corpus>& corpora,
+               const std::vector<Result>& results) {
+  printf("{\"benchmarks\":[");
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Result& r = results[i];
+    printf(
+        "%s\n{\"schema\":\"%s\",\"corpus\":\"%s\",\"keystrokes\":%zu,"
+        "\"mean_us\":%.3f,\"p50_us\":%.3f,\"p95_us\":%.3f,\"p99_us\":%.3f,"
+        "\"max_us\":%.3f,\"keys_per_second\":%.1f,\"peak_rss_kb\":%zu}",
+        i ? "," : "", corpora[i].schema_id.c_str(),
+        corpora[i].file_name.c_str(), r.keystrokes, r.mean_us, r.p50_us,
+        r.p95_us, r.p99_us, r.max_us, r.keys_per_second, r.peak_rss_kb);
+  }
+  printf("\n],\"peak_rss_kb\":%zu}\n", PeakRssKb());
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  bool json = false;
+  int repeat = 10;
+  std::vector<Corpus> corpora;
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--json")) {
+      json = true;
+    } else if (!strcmp(argv[i], "--repeat") && i + 1 < argc) {
+      repeat = (std::max)(atoi(argv[++i]), 1);
+    } else if (argv[i][0] == '-') {
+      fprintf(stderr,
+              "usage: %s [--json] [--repeat N] [schema_id[=corpus_file]]...\n",
+              argv[0]);
+      return 1;
+    } else {
+      std::string arg(argv[i]);
+      size_t eq = arg.find('=');
+      if (eq == std::string::npos)
+        corpora.push_back({arg, arg + ".keys"});
+      else
+        corpora.push_back({arg.substr(0, eq), arg.substr(eq + 1)});
+    }
+  }
+  if (corpora.empty()) {
+    corpora = {{"luna_pinyin", "luna_pinyin.keys"},
+               {"cangjie5", "cangjie5.keys"},
+               {"double_pinyin_flypy", "double_pinyin_flypy.keys"}};
+  }
+  for (auto& corpus : corpora) {
+    if (!LoadCorpus(&corpus))
+      return 1;
+  }
+  if (!PrepareUserData(corpora)) {
+    fprintf(stderr, "error preparing user data in %s\n", kUserDataDir);
+    return 1;
+  }
+
+  RimeApi* rime = rime_get_api();
+  RIME_STRUCT(RimeTraits, traits);
+  // shared data is copied to the working directory ($build/bench).
+  traits.shared_data_dir = ".";
+  traits.user_data_dir = kUserDataDir;
+  traits.app_name = "rime.bench";
+  traits.min_log_level = 2;  // ERROR
+  rime->setup(&traits);
+  rime->initialize(NULL);
+  if (rime->start_maintenance(True))
+    rime->join_maintenance_thread();
+
+  std::vector<Result> results;
+  int status = 0;
+  for (const auto& corpus : corpora) {
+    Result result;
+    if (!Run(rime, corpus, repeat, &result)) {
+      fprintf(stderr, "error benchmarking schema: %s\n",
+              corpus.schema_id.c_str());
+      status = 1;
+      break;
+    }
+    results.push_back(result);
+  }
+  rime->finalize();
+
+  if (json)
+    PrintJson(corpora, results);
+  else
+    PrintText(corpora, results);
+  return status;
+}
@@ -0,0 +1,23 @@
+#include <benchmark/benchmark.h>
+#include <rime_api.h>
+#include <rime/service.h>
+#include <rime/setup.h>
+
+int main(int argc, char** argv) {
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    return 1;
+
+  RIME_STRUCT(RimeTraits, traits);
+  // put all files in the working directory ($build/bench).
+  traits.shared_data_dir = traits.user_data_dir = traits.prebuilt_data_dir =
+      traits.staging_dir = ".";
+  rime::SetupDeployer(&traits);
+  rime::SetupLogging("rime.bench");
+  rime::LoadModules(rime::kDefaultModules);
+  rime::Service::instance().StartService();
+
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,409 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+// Compiles synthetic dictionaries and reports the time taken by each stage
+// of DictCompiler::Compile, the peak memory and the size of the output.
+//
+// usage: rime_compile_bench [--json] [--memory-limit MB]
+//                           [--sizes N,...] [--variants V,...]
+//
+// The corpora are generated from a fixed seed, so that the numbers of a
+// build can be compared with those of a baseline built with the same
+// standard library. Variants are:
+//   plain    entries all coded in syllables, as in a pinyin dictionary;
+//   encoder  phrases without codes, encoded by rules from the codes of
+//            the characters, as in a shape-based dictionary;
+//   packs    a plain dictionary with a pack of another tenth as many
+//            entries, built against the syllabary of the primary table.
+// Sizes default to 100000, 1000000 and 5000000 entries.
+//
+// The peak memory is that of the process so far; compile one corpus per
+// run for the peak of each.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <rime/common.h>
+#include <rime/deployer.h>
+#include <rime/service.h>
+#include <rime/setup.h>
+#include <rime/dict/dict_compiler.h>
+#include <rime/dict/dictionary.h>
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace rime;
+
+namespace {
+
+const char* kDataDir = "rime_compile_bench_data";
+const unsigned kSeed = 20240101;
+// characters from U+4E00 on; phrases are made of them.
+const int kNumCharacters = 20000;
+
+struct Corpus {
+  string name;
+  size_t num_entries;
+  bool encoder;
+  bool packs;
+};
+
+struct StageTiming {
+  string item;
+  string stage;
+  double milliseconds;
+};
+
+struct Result {
+  vector<StageTiming> stages;
+  double total_ms = 0;
+  // compiling again with nothing changed.
+  double up_to_date_ms = 0;
+  size_t peak_rss_kb = 0;
+  vector<pair<string, uintmax_t>> outputs;
+};
+
+size_t PeakRssKb() {
+#if defined(_WIN32)
+  PROCESS_MEMORY_COUNTERS counters;
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    return 0;
+  return counters.PeakWorkingSetSize / 1024;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+#if defined(__APPLE__)
+  return usage.ru_maxrss / 1024;  // in bytes
+#else
+  return usage.ru_maxrss;  // in kilobytes
+#endif
+#endif
+}
+
+// in 3 bytes, as are the CJK unified ideographs.
+string EncodeUtf8(char32_t c) {
+  string s;
+  s += char(0xe0 | (c >> 12));
+  s += char(0x80 | ((c >> 6) & 0x3f));
+  s += char(0x80 | (c & 0x3f));
+  return s;
+}
+
+// syllables of pinyin-like shape, some of which make no real pinyin.
+vector<string> MakeSyllables() {
+  const char* initials[] = {"",  "b", "p", "m",  "f",  "d",  "t", "n",
+                            "l", "g", "k", "h",  "j",  "q",  "x", "zh",
+                            "ch", "sh", "r", "z", "c",  "s",  "y", "w"};
+  const char* finals[] = {"a",   "o",   "e",    "i",   "u",   "ai",
+                          "ei",  "ao",  "ou",   "an",  "en",  "ang",
+                          "eng", "ong", "ia",   "ie",  "iao", "iu",
+                          "ian", "in",  "iang", "ing", "ua",  "uo"};
+  vector<string> syllables;
+  for (const char* i : initials) {
+    for (const char* f : finals) {
+      syllables.push_back(string(i) + f);
+    }
+  }
+  return syllables;
+}
+
+// the characters with their codes; a character may be read in more than
+// one way.
+struct CharacterSet {
+  vector<string> text;
+  vector<vector<string>> codes;
+};
+
+CharacterSet MakeCharacters(const Corpus& corpus, std::mt19937* rng) {
+  CharacterSet chars;
+  vector<string> syllables = MakeSyllables();
+  std::uniform_int_distribution<size_t> syllable(0, syllables.size() - 1);
+  std::uniform_int_distribution<int> letter('a', 'y');
+  std::uniform_int_distribution<int> shape_length(1, 5);
+  std::uniform_int_distribution<int> readings(1, 10);
+  for (int i = 0; i < kNumCharacters; ++i) {
+    chars.text.push_back(EncodeUtf8(char32_t(0x4e00 + i)));
+    vector<string> codes;
+    // one in ten characters has two readings.
+    int num_codes = readings(*rng) == 1 ? 2 : 1;
+    for (int j = 0; j < num_codes; ++j) {
+      if (corpus.encoder) {
+        string code;
+        for (int k = shape_length(*rng); k > 0; --k)
+          code += char(letter(*rng));
+        codes.push_back(code);
+      } else {
+        codes.push_back(syllables[syllable(*rng)]);
+      }
+    }
+    chars.codes.push_back(codes);
+  }
+  return chars;
+}
+
+// writes the entries of a dictionary: the characters first, unless it is a
+// pack, then phrases of 2 to 4 characters.
+bool WriteDict(const Corpus& corpus,
+               const string& dict_name,
+               const CharacterSet& chars,
+               size_t num_entries,
+               bool pack,
+               std::mt19937* rng) {
+  std::ofstream out(std::filesystem::path(kDataDir) /
+                    (dict_name + ".dict.yaml"));
+  if (!out)
+    return false;
+  out << "# synthetic dictionary of rime_compile_bench\n"
+      << "---\n"
+      << "name: " << dict_name << "\n"
+      << "version: \"1\"\n"
+      << "sort: by_weight\n";
+  if (corpus.encoder) {
+    out << "encoder:\n"
+        << "  rules:\n"
+        << "    - length_equal: 2\n"
+        << "      formula: \"AaAzBaBbBz\"\n"
+        << "    - length_equal: 3\n"
+        << "      formula: \"AaAzBaBzCz\"\n"
+        << "    - length_in_range: [4, 10]\n"
+        << "      formula: \"AaBzCaYzZz\"\n";
+  }
+  out << "...\n\n";
+  // weights roughly in Zipf's distribution.
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  std::uniform_int_distribution<int> character(0, kNumCharacters - 1);
+  std::uniform_int_distribution<int> phrase_length(2, 4);
+  auto weight = [&] { return int(1e6 * std::pow(uniform(*rng), 4.0)); };
+  size_t count = 0;
+  if (!pack) {
+    for (int i = 0; i < kNumCharacters && count < num_entries; ++i) {
+      for (const auto& code : chars.codes[i]) {
+        out << chars.text[i] << '\t' << code << '\t' << weight() << '\n';
+        ++count;
+      }
+    }
+  }
+  for (; count < num_entries; ++count) {
+    string text;
+    string code;
+    for (int k = phrase_length(*rng); k > 0; --k) {
+      int c = character(*rng);
+      text += chars.text[c];
+      if (!corpus.encoder) {
+        if (!code.empty())
+          code += ' ';
+        code += chars.codes[c][0];
+      }
+    }
+    // encoded by the rules, if left empty.
+    out << text << '\t' << code << '\t' << weight() << '\n';
+  }
+  return bool(out);
+}
+
+bool Generate(const Corpus& corpus) {
+  std::mt19937 rng(kSeed);
+  CharacterSet chars = MakeCharacters(corpus, &rng);
+  if (!WriteDict(corpus, corpus.name, chars, corpus.num_entries, false, &rng))
+    return false;
+  if (corpus.packs &&
+      !WriteDict(corpus, corpus.name + ".extra", chars,
+                 corpus.num_entries / 10, true, &rng))
+    return false;
+  return true;
+}
+
+an<Dictionary> CreateDictionary(const Corpus& corpus) {
+  std::filesystem::path dir(kDataDir);
+  vector<string> packs;
+  vector<of<Table>> tables{New<Table>(dir / (corpus.name + ".table.bin"))};
+  if (corpus.packs) {
+    packs.push_back(corpus.name + ".extra");
+    tables.push_back(New<Table>(dir / (corpus.name + ".extra.table.bin")));
+  }
+  return New<Dictionary>(corpus.name, packs, tables,
+                         New<Prism>(dir / (corpus.name + ".prism.bin")));
+}
+
+double Compile(const Corpus& corpus, int options) {
+  auto dict = CreateDictionary(corpus);
+  DictCompiler dict_compiler(dict.get());
+  dict_compiler.set_options(options);
+  auto start = std::chrono::steady_clock::now();
+  bool success = dict_compiler.Compile(path());  // no schema file
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return success ? elapsed.count() : -1;
+}
+
+bool Run(const Corpus& corpus, Result* result) {
+  if (!Generate(corpus)) {
+    fprintf(stderr, "error generating corpus: %s\n", corpus.name.c_str());
+    return false;
+  }
+  std::mutex mutex;
+  auto connection = Service::instance().deployer().message_sink().connect(
+      [&](const string& type, const string& value) {
+        if (type != "deploy_timing")
+          return;
+        std::istringstream in(value);
+        StageTiming timing;
+        if (std::getline(in, timing.item, '\t') &&
+            std::getline(in, timing.stage, '\t') && in >> timing.milliseconds) {
+          std::lock_guard<std::mutex> lock(mutex);
+          result->stages.push_back(timing);
+        }
+      });
+  result->total_ms = Compile(corpus, DictCompiler::kRebuild);
+  connection.disconnect();
+  if (result->total_ms < 0)
+    return false;
+  result->peak_rss_kb = PeakRssKb();
+  result->up_to_date_ms = Compile(corpus, 0);
+  std::filesystem::path dir(kDataDir);
+  vector<string> outputs{corpus.name + ".table.bin",
+                         corpus.name + ".prism.bin",
+                         corpus.name + ".reverse.bin"};
+  if (corpus.packs)
+    outputs.push_back(corpus.name + ".extra.table.bin");
+  for (const auto& file_name : outputs) {
+    std::error_code ec;
+    uintmax_t size = std::filesystem::file_size(dir / file_name, ec);
+    result->outputs.push_back({file_name, ec ? 0 : size});
+  }
+  return result->up_to_date_ms >= 0;
+}
+
+vector<string> Split(const string& list) {
+  vector<string> items;
+  std::istringstream in(list);
+  string item;
+  while (std::getline(in, item, ',')) {
+    if (!item.empty())
+      items.push_back(item);
+  }
+  return items;
+}
+
+void PrintText(const vector<Corpus>& corpora, const vector<Result>& results) {
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Result& r = results[i];
+    printf("%s: %zu entries, %.1f ms, up to date in %.1f ms, rss %zu kb\n",
+           corpora[i].name.c_str(), corpora[i].num_entries, r.total_ms,
+           r.up_to_date_ms, r.peak_rss_kb);
+    for (const auto& x : r.stages) {
+      printf("  %-28s %-18s %10.1f ms\n", x.item.c_str(), x.stage.c_str(),
+             x.milliseconds);
+    }
+    for (const auto& x : r.outputs) {
+      printf("  %-47s %10ju bytes\n", x.first.c_str(), x.second);
+    }
+  }
+}
+
+void PrintJson(const vector<Corpus>& corpora, const vector<Result>& results) {
+  printf("{\"benchmarks\":[");
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Result& r = results[i];
+    printf(
+        "%s\n{\"corpus\":\"%s\",\"entries\":%zu,\"encoder\":%s,"
+        "\"packs\":%s,\"total_ms\":%.3f,\"up_to_date_ms\":%.3f,"
+        "\"peak_rss_kb\":%zu,\"stages\":[",
+        i ? "," : "", corpora[i].name.c_str(), corpora[i].num_entries,
+        corpora[i].encoder ? "true" : "false",
+        corpora[i].packs ? "true" : "false", r.total_ms, r.up_to_date_ms,
+        r.peak_rss_kb);
+    for (size_t j = 0; j < r.stages.size(); ++j) {
+      printf("%s{\"item\":\"%s\",\"stage\":\"%s\",\"ms\":%.3f}",
+             j ? "," : "", r.stages[j].item.c_str(),
+             r.stages[j].stage.c_str(), r.stages[j].milliseconds);
+    }
+    printf("],\"outputs\":{");
+    for (size_t j = 0; j < r.outputs.size(); ++j) {
+      printf("%s\"%s\":%ju", j ? "," : "", r.outputs[j].first.c_str(),
+             r.outputs[j].second);
+    }
+    printf("}}");
+  }
+  printf("\n]}\n");
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  bool json = false;
+  vector<string> sizes{"100000", "1000000", "5000000"};
+  vector<string> variants{"plain", "encoder", "packs"};
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--json")) {
+      json = true;
+    } else if (!strcmp(argv[i], "--memory-limit") && i + 1 < argc) {
+      DictCompiler::set_memory_limit(size_t(atoi(argv[++i])) << 20);
+    } else if (!strcmp(argv[i], "--sizes") && i + 1 < argc) {
+      sizes = Split(argv[++i]);
+    } else if (!strcmp(argv[i], "--variants") && i + 1 < argc) {
+      variants = Split(argv[++i]);
+    } else {
+      fprintf(stderr,
+              "usage: %s [--json] [--memory-limit MB] [--sizes N,...] "
+              "[--variants plain,encoder,packs]\n",
+              argv[0]);
+      return 1;
+    }
+  }
+  vector<Corpus> corpora;
+  for (const auto& size : sizes) {
+    for (const auto& variant : variants) {
+      if (variant != "plain" && variant != "encoder" && variant != "packs") {
+        fprintf(stderr, "unknown variant: %s\n", variant.c_str());
+        return 1;
+      }
+      size_t num_entries = strtoul(size.c_str(), nullptr, 10);
+      corpora.push_back({"synth_" + size + "_" + variant, num_entries,
+                         variant == "encoder", variant == "packs"});
+    }
+  }
+  std::error_code ec;
+  std::filesystem::remove_all(kDataDir, ec);
+  std::filesystem::create_directories(kDataDir, ec);
+
+  RIME_STRUCT(RimeTraits, traits);
+  // sources and the files built from them are all in the data directory.
+  traits.shared_data_dir = traits.user_data_dir = traits.prebuilt_data_dir =
+      traits.staging_dir = kDataDir;
+  SetupDeployer(&traits);
+  SetupLogging("rime.compile_bench");
+  Service::instance().StartService();
+
+  vector<Result> results;
+  int status = 0;
+  for (const auto& corpus : corpora) {
+    Result result;
+    if (!Run(corpus, &result)) {
+      fprintf(stderr, "error compiling corpus: %s\n", corpus.name.c_str());
+      status = 1;
+      break;
+    }
+    results.push_back(result);
+  }
+  Service::instance().StopService();
+
+  if (json)
+    PrintJson(corpora, results);
+  else
+    PrintText(corpora, results);
+  return status;
+}
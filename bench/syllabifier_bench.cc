@@ -0,0 +1,57 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <benchmark/benchmark.h>
+#include <rime/common.h>
+#include <rime/algo/syllabifier.h>
+#include <rime/dict/dictionary.h>
+#include "bench_dictionary.h"
+
+namespace {
+
+using rime_bench::kNumSampleInputs;
+using rime_bench::kSampleInputs;
+using rime_bench::LoadDictionary;
+
+static void BM_BuildSyllableGraph(benchmark::State& state) {
+  auto* dict = LoadDictionary();
+  if (!dict->loaded()) {
+    state.SkipWithError("failed to load dictionary.");
+    return;
+  }
+  auto& prism = *dict->prism();
+  const std::string input = kSampleInputs[state.range(0)];
+  for (auto _ : state) {
+    rime::Syllabifier syllabifier;
+    rime::SyllableGraph graph;
+    benchmark::DoNotOptimize(
+        syllabifier.BuildSyllableGraph(input, prism, &graph));
+  }
+  state.SetLabel(kSampleInputs[state.range(0)]);
+}
+BENCHMARK(BM_BuildSyllableGraph)->DenseRange(0, kNumSampleInputs - 1);
+
+// rebuilds the graph after every key typed, as the translator does.
+static void BM_BuildSyllableGraphTyping(benchmark::State& state) {
+  auto* dict = LoadDictionary();
+  if (!dict->loaded()) {
+    state.SkipWithError("failed to load dictionary.");
+    return;
+  }
+  auto& prism = *dict->prism();
+  const std::string input = kSampleInputs[state.range(0)];
+  for (auto _ : state) {
+    rime::Syllabifier syllabifier;
+    rime::SyllabifierCache cache;
+    for (size_t length = 1; length <= input.length(); ++length) {
+      rime::SyllableGraph graph;
+      benchmark::DoNotOptimize(syllabifier.BuildSyllableGraph(
+          input.substr(0, length), prism, &graph, &cache));
+    }
+  }
+  state.SetLabel(kSampleInputs[state.range(0)]);
+}
+BENCHMARK(BM_BuildSyllableGraphTyping)->DenseRange(0, kNumSampleInputs - 1);
+
+}  // namespace
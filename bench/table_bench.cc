@@ -0,0 +1,62 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <benchmark/benchmark.h>
+#include <rime/common.h>
+#include <rime/algo/syllabifier.h>
+#include <rime/dict/dictionary.h>
+#include "bench_dictionary.h"
+
+namespace {
+
+using rime_bench::kNumSampleInputs;
+using rime_bench::kSampleInputs;
+using rime_bench::LoadDictionary;
+
+static void BM_TableQuery(benchmark::State& state) {
+  auto* dict = LoadDictionary();
+  if (!dict->loaded()) {
+    state.SkipWithError("failed to load dictionary.");
+    return;
+  }
+  rime::Syllabifier syllabifier;
+  rime::SyllableGraph graph;
+  syllabifier.BuildSyllableGraph(kSampleInputs[state.range(0)], *dict->prism(),
+                                 &graph);
+  auto& table = *dict->primary_table();
+  rime::TableQueryResult result;
+  for (auto _ : state) {
+    for (const auto& index : graph.indices) {
+      table.Query(graph, index.first, &result);
+      benchmark::DoNotOptimize(result);
+    }
+  }
+  state.SetLabel(kSampleInputs[state.range(0)]);
+}
+BENCHMARK(BM_TableQuery)->DenseRange(0, kNumSampleInputs - 1);
+
+static void BM_TableQueryCached(benchmark::State& state) {
+  auto* dict = LoadDictionary();
+  if (!dict->loaded()) {
+    state.SkipWithError("failed to load dictionary.");
+    return;
+  }
+  rime::Syllabifier syllabifier;
+  rime::SyllableGraph graph;
+  syllabifier.BuildSyllableGraph(kSampleInputs[state.range(0)], *dict->prism(),
+                                 &graph);
+  auto& table = *dict->primary_table();
+  rime::TableQueryCache cache;
+  rime::TableQueryResult result;
+  for (auto _ : state) {
+    for (const auto& index : graph.indices) {
+      table.Query(graph, index.first, &result, &cache);
+      benchmark::DoNotOptimize(result);
+    }
+  }
+  state.SetLabel(kSampleInputs[state.range(0)]);
+}
+BENCHMARK(BM_TableQueryCached)->DenseRange(0, kNumSampleInputs - 1);
+
+}  // namespace
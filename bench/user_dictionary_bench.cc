@@ -0,0 +1,85 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <benchmark/benchmark.h>
+#include <random>
+#include <rime/common.h>
+#include <rime/algo/syllabifier.h>
+#include <rime/dict/dictionary.h>
+#include <rime/dict/user_db.h>
+#include <rime/dict/user_dictionary.h>
+#include "bench_dictionary.h"
+
+namespace {
+
+using rime_bench::kNumSampleInputs;
+using rime_bench::kSampleInputs;
+using rime_bench::LoadDictionary;
+
+const int kNumSyntheticEntries = 100000;
+const int kMaxSyllablesPerEntry = 4;
+// the depth the script translator looks up user phrases to.
+const size_t kDepthLimit = 5;
+
+// a user dictionary of random phrases over the syllabary of luna_pinyin,
+// created afresh on first use.
+rime::UserDictionary* LoadUserDictionary(rime::Dictionary* dict) {
+  static rime::the<rime::UserDictionary> user_dict;
+  if (user_dict)
+    return user_dict.get();
+  auto* component = rime::UserDb::Require("userdb");
+  if (!component)
+    return nullptr;
+  rime::an<rime::Db> db(component->Create("user_dictionary_bench"));
+  if (db->Exists())
+    db->Remove();
+  if (!db->Open())
+    return nullptr;
+  user_dict.reset(new rime::UserDictionary("user_dictionary_bench", db));
+  user_dict->Attach(dict->primary_table(), dict->prism());
+  if (!user_dict->Load())
+    return nullptr;
+  auto& table = *dict->primary_table();
+  int num_syllables = table.metadata()->num_syllables;
+  std::mt19937 rng(20111030);
+  std::uniform_int_distribution<int> syllable_id(0, num_syllables - 1);
+  std::uniform_int_distribution<int> length(1, kMaxSyllablesPerEntry);
+  std::uniform_int_distribution<int> commits(1, 10);
+  for (int i = 0; i < kNumSyntheticEntries; ++i) {
+    rime::DictEntry entry;
+    for (int j = length(rng); j > 0; --j) {
+      entry.custom_code += table.GetSyllableById(syllable_id(rng)) + ' ';
+    }
+    entry.text = "w" + std::to_string(i);
+    user_dict->UpdateEntry(entry, commits(rng));
+  }
+  return user_dict.get();
+}
+
+static void BM_UserDictionaryLookup(benchmark::State& state) {
+  auto* dict = LoadDictionary();
+  if (!dict->loaded()) {
+    state.SkipWithError("failed to load dictionary.");
+    return;
+  }
+  auto* user_dict = LoadUserDictionary(dict);
+  if (!user_dict) {
+    state.SkipWithError("failed to load user dictionary.");
+    return;
+  }
+  rime::Syllabifier syllabifier;
+  rime::SyllableGraph graph;
+  syllabifier.BuildSyllableGraph(kSampleInputs[state.range(0)], *dict->prism(),
+                                 &graph);
+  for (auto _ : state) {
+    // at each position, as in making a sentence.
+    for (const auto& x : graph.edges) {
+      benchmark::DoNotOptimize(user_dict->Lookup(graph, x.first, kDepthLimit));
+    }
+  }
+  state.SetLabel(kSampleInputs[state.range(0)]);
+}
+BENCHMARK(BM_UserDictionaryLookup)->DenseRange(0, kNumSampleInputs - 1);
+
+}  // namespace
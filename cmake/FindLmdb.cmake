@@ -0,0 +1,26 @@
+set(_lmdb_ORIG_CMAKE_FIND_LIBRARY_SUFFIXES ${CMAKE_FIND_LIBRARY_SUFFIXES})
+
+find_path(Lmdb_INCLUDE_PATH lmdb.h)
+
+if (Lmdb_STATIC)
+  if (WIN32)
+    set(CMAKE_FIND_LIBRARY_SUFFIXES .lib ${CMAKE_FIND_LIBRARY_SUFFIXES})
+  else (WIN32)
+    set(CMAKE_FIND_LIBRARY_SUFFIXES .a ${CMAKE_FIND_LIBRARY_SUFFIXES})
+  endif (WIN32)
+endif (Lmdb_STATIC)
+find_library(Lmdb_LIBRARY NAMES lmdb liblmdb)
+if(Lmdb_INCLUDE_PATH AND Lmdb_LIBRARY)
+  set(Lmdb_FOUND TRUE)
+endif(Lmdb_INCLUDE_PATH AND Lmdb_LIBRARY)
+if(Lmdb_FOUND)
+  if(NOT Lmdb_FIND_QUIETLY)
+    message(STATUS "Found lmdb: ${Lmdb_LIBRARY}")
+  endif(NOT Lmdb_FIND_QUIETLY)
+else(Lmdb_FOUND)
+  if(Lmdb_FIND_REQUIRED)
+    message(FATAL_ERROR "Could not find lmdb library.")
+  endif(Lmdb_FIND_REQUIRED)
+endif(Lmdb_FOUND)
+
+set(CMAKE_FIND_LIBRARY_SUFFIXES ${_lmdb_ORIG_CMAKE_FIND_LIBRARY_SUFFIXES})
@@ -7,6 +7,7 @@
 #include <boost/algorithm/string.hpp>
 #include <boost/dll.hpp>
 #include <filesystem>
+#include <fstream>
 #include <rime/build_config.h>
 #include <rime/common.h>
 #include <rime/component.h>
@@ -23,11 +24,15 @@ class PluginManager {
   void LoadPlugins(path plugins_dir);
 
   static string plugin_name_of(path plugin_file);
+  // names of the components a plugin provides, listed one per line in
+  // a manifest file named after the plugin library, eg. librime-lua.manifest
+  static vector<string> plugin_components_of(path plugin_file);
 
   static PluginManager& instance();
 
  private:
   PluginManager() = default;
+  void LoadPlugin(path plugin_file, const string& plugin_name);
 
   map<string, boost::dll::shared_library> plugin_libs_;
 };
@@ -45,30 +50,56 @@ void PluginManager::LoadPlugins(path plugins_dir) {
       if (fs::is_regular_file(plugin_file_status)) {
         DLOG(INFO) << "found plugin: " << plugin_file;
         string plugin_name = plugin_name_of(plugin_file);
-        if (plugin_libs_.find(plugin_name) == plugin_libs_.end()) {
-          LOG(INFO) << "loading plugin '" << plugin_name << "' from "
-                    << plugin_file;
-          try {
-            auto plugin_lib = boost::dll::shared_library(plugin_file);
-            plugin_libs_[plugin_name] = plugin_lib;
-          } catch (const std::exception& ex) {
-            LOG(ERROR) << "error loading plugin " << plugin_name << ": "
-                       << ex.what();
-            continue;
-          }
-        }
-        if (RimeModule* module = mm.Find(plugin_name)) {
-          mm.LoadModule(module);
-          LOG(INFO) << "loaded plugin: " << plugin_name;
+        auto components = plugin_components_of(plugin_file);
+        if (components.empty()) {
+          LoadPlugin(plugin_file, plugin_name);
         } else {
-          LOG(WARNING) << "module '" << plugin_name
-                       << "' is not provided by plugin library " << plugin_file;
+          mm.LoadOnDemand(plugin_name, components,
+                          [this, plugin_file, plugin_name] {
+                            LoadPlugin(plugin_file, plugin_name);
+                          });
         }
       }
     }
   }
 }
 
+void PluginManager::LoadPlugin(path plugin_file, const string& plugin_name) {
+  ModuleManager& mm = ModuleManager::instance();
+  if (plugin_libs_.find(plugin_name) == plugin_libs_.end()) {
+    LOG(INFO) << "loading plugin '" << plugin_name << "' from "
+              << plugin_file;
+    try {
+      auto plugin_lib = boost::dll::shared_library(plugin_file);
+      plugin_libs_[plugin_name] = plugin_lib;
+    } catch (const std::exception& ex) {
+      LOG(ERROR) << "error loading plugin " << plugin_name << ": "
+                 << ex.what();
+      return;
+    }
+  }
+  if (RimeModule* module = mm.Find(plugin_name)) {
+    mm.LoadModule(module);
+    LOG(INFO) << "loaded plugin: " << plugin_name;
+  } else {
+    LOG(WARNING) << "module '" << plugin_name
+                 << "' is not provided by plugin library " << plugin_file;
+  }
+}
+
+vector<string> PluginManager::plugin_components_of(path plugin_file) {
+  vector<string> components;
+  std::ifstream in(path(plugin_file).replace_extension(".manifest").c_str());
+  string line;
+  while (std::getline(in, line)) {
+    boost::trim(line);
+    if (!line.empty() && line[0] != '#') {
+      components.push_back(line);
+    }
+  }
+  return components;
+}
+
 string PluginManager::plugin_name_of(path plugin_file) {
   string name = plugin_file.stem().string();
   // remove prefix "(lib)rime-"
@@ -5,7 +5,12 @@
 // 2012-01-19 GONG Chen <chen.sst@gmail.com>
 //
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <fstream>
+#include <future>
+#include <mutex>
+#include <rime/worker_pool.h>
 #include <rime/algo/algebra.h>
 #include <rime/algo/calculus.h>
 
@@ -61,10 +66,86 @@ void Script::Dump(const path& file_path) const {
   out.close();
 }
 
+namespace {
+
+struct ProjectionMemo {
+  uint64_t projection_id = 0;
+  uint64_t generation = 0;
+  // input -> transformed value, or an empty string if not modified.
+  hash_map<string, string> results;
+  // bytes held by the results, counted towards the usage of the projection.
+  size_t bytes = 0;
+  an<std::atomic<size_t>> usage;
+
+  ~ProjectionMemo() { Clear(); }
+
+  void Add(const string& input, const string& result) {
+    size_t added = sizeof(*results.begin()) + input.capacity() +
+                   result.capacity();
+    bytes += added;
+    *usage += added;
+  }
+
+  void Clear() {
+    results.clear();
+    if (usage)
+      *usage -= bytes;
+    bytes = 0;
+  }
+};
+
+}  // namespace
+
+// projections a thread keeps memos of at a time; the memo filled first is
+// given to another projection.
+static const size_t kProjectionMemosPerThread = 8;
+
+static thread_local std::array<ProjectionMemo, kProjectionMemosPerThread>
+    projection_memos;
+static thread_local size_t next_projection_memo = 0;
+
+static ProjectionMemo& projection_memo(uint64_t projection_id,
+                                       uint64_t generation,
+                                       const an<std::atomic<size_t>>& usage) {
+  for (ProjectionMemo& memo : projection_memos) {
+    if (memo.projection_id == projection_id) {
+      if (memo.generation != generation) {
+        memo.generation = generation;
+        memo.Clear();
+      }
+      return memo;
+    }
+  }
+  ProjectionMemo& memo = projection_memos[next_projection_memo];
+  next_projection_memo = (next_projection_memo + 1) % projection_memos.size();
+  memo.Clear();
+  memo.projection_id = projection_id;
+  memo.generation = generation;
+  memo.usage = usage;
+  return memo;
+}
+
+static uint64_t new_projection_id() {
+  static std::atomic<uint64_t> next_projection_id{1};
+  return next_projection_id++;
+}
+
+Projection::Projection()
+    : memo_id_(new_projection_id()),
+      memo_bytes_(New<std::atomic<size_t>>(0)),
+      memo_budget_("projection_memo",
+                   {[this] { return memo_bytes_->load(); }, nullptr,
+                    [this](size_t bytes) {
+                      // cheap to fill again, so emptied when shrunk at all;
+                      // each thread empties its memo on next use.
+                      ++memo_generation_;
+                    }}) {}
+
 bool Projection::Load(an<ConfigList> settings) {
   if (!settings)
     return false;
   calculation_.clear();
+  ++memo_generation_;
   Calculus calc;
   bool success = true;
   for (size_t i = 0; i < settings->size(); ++i) {
@@ -95,9 +176,56 @@ bool Projection::Load(an<ConfigList> settings) {
   return success;
 }
 
+static std::mutex shared_projections_mutex;
+static map<string, weak<Projection>> shared_projections;
+
+an<Projection> Projection::Shared(an<ConfigList> settings) {
+  if (!settings)
+    return New<Projection>();
+  string formulas;
+  for (size_t i = 0; i < settings->size(); ++i) {
+    if (auto v = settings->GetValueAt(i))
+      formulas += v->str();
+    formulas += '\n';
+  }
+  std::lock_guard<std::mutex> lock(shared_projections_mutex);
+  auto& shared = shared_projections[formulas];
+  auto projection = shared.lock();
+  if (!projection) {
+    projection = New<Projection>();
+    projection->Load(settings);
+    shared = projection;
+  }
+  return projection;
+}
+
 bool Projection::Apply(string* value) {
   if (!value || value->empty())
     return false;
+  ProjectionMemo& memo =
+      projection_memo(memo_id_, memo_generation_, memo_bytes_);
+  auto found = memo.results.find(*value);
+  if (found != memo.results.end()) {
+    if (found->second.empty())
+      return false;
+    value->assign(found->second);
+    return true;
+  }
+  string input(*value);
+  bool modified = Transform(value);
+  if (memo.results.size() >= kMaxMemoSize)
+    memo.Clear();
+  // a value transformed to an empty string is not memoized as modified.
+  if (!modified || !value->empty()) {
+    string& result = memo.results[input];
+    if (modified)
+      result = *value;
+    memo.Add(input, result);
+  }
+  return modified;
+}
+
+bool Projection::Transform(string* value) {
   bool modified = false;
   Spelling s(*value);
   for (an<Calculation>& x : calculation_) {
@@ -114,6 +242,9 @@ bool Projection::Apply(string* value) {
   return modified;
 }
 
+// spellings a task of the worker pool applies a calculation to.
+static const size_t kSpellingsPerShard = 1024;
+
 bool Projection::Apply(Script* value) {
   if (!value || value->empty())
     return false;
@@ -122,17 +253,44 @@ bool Projection::Apply(Script* value) {
   for (an<Calculation>& x : calculation_) {
     ++round;
     DLOG(INFO) << "round #" << round;
-    Script temp;
+    // the calculation is applied to shards of spellings in parallel, then
+    // the results are merged in the order of the spellings.
+    vector<const Script::value_type*> spellings;
+    spellings.reserve(value->size());
     for (const Script::value_type& v : *value) {
-      Spelling s(v.first);
-      bool applied = false;
-      try {
-        applied = x->Apply(&s);
-      } catch (std::runtime_error& e) {
-        LOG(ERROR) << "Error applying calculation: " << e.what();
-        return false;
+      spellings.push_back(&v);
+    }
+    vector<Spelling> results(spellings.size());
+    vector<char> applied(spellings.size(), false);
+    std::atomic<bool> failed = false;
+    auto apply = [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end && !failed; ++i) {
+        results[i] = Spelling(spellings[i]->first);
+        try {
+          applied[i] = x->Apply(&results[i]);
+        } catch (std::runtime_error& e) {
+          LOG(ERROR) << "Error applying calculation: " << e.what();
+          failed = true;
+        }
       }
-      if (applied) {
+    };
+    vector<std::future<void>> shards;
+    for (size_t begin = 0; begin < spellings.size();
+         begin += kSpellingsPerShard) {
+      size_t end = (std::min)(begin + kSpellingsPerShard, spellings.size());
+      shards.push_back(WorkerPool::Shared().Submit(
+          [&apply, begin, end] { apply(begin, end); }));
+    }
+    for (auto& shard : shards) {
+      shard.get();
+    }
+    if (failed)
+      return false;
+    Script temp;
+    for (size_t i = 0; i < spellings.size(); ++i) {
+      const auto& v = *spellings[i];
+      const Spelling& s = results[i];
+      if (applied[i]) {
         modified = true;
         if (!x->deletion()) {
           temp.Merge(v.first, SpellingProperties(), v.second);
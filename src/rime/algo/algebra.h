@@ -8,8 +8,11 @@
 #ifndef RIME_ALGEBRA_H_
 #define RIME_ALGEBRA_H_
 
+#include <stdint.h>
+#include <atomic>
 #include <rime/common.h>
 #include <rime/config.h>
+#include <rime/memory_budget.h>
 #include "spelling.h"
 
 namespace rime {
@@ -28,14 +31,33 @@ class Script : public map<string, vector<Spelling>> {
 
 class Projection {
  public:
+  RIME_API Projection();
+
   RIME_API bool Load(an<ConfigList> settings);
+  // returns a projection loaded with the settings, shared by all loads of
+  // the same formulas. it is not to be loaded again.
+  RIME_API static an<Projection> Shared(an<ConfigList> settings);
   // "spelling" -> "gnilleps"
+  // results are memoized, as the values come from a small set of spellings.
   RIME_API bool Apply(string* value);
   // {z, y, x} -> {a, b, c, d}
   RIME_API bool Apply(Script* value);
 
  protected:
+  bool Transform(string* value);
+
   vector<of<Calculation>> calculation_;
+
+  static const size_t kMaxMemoSize = 4096;
+  // each thread keeps a memo of its own under this id, so that applying a
+  // shared projection takes no lock.
+  const uint64_t memo_id_;
+  // memos of a former generation are emptied on their next use.
+  std::atomic<uint64_t> memo_generation_{0};
+  // bytes held by the memos of all threads, which update it as they fill,
+  // empty or give away their memos, even after the projection is gone.
+  an<std::atomic<size_t>> memo_bytes_;
+  MemoryBudgetRegistration memo_budget_;
 };
 
 }  // namespace rime
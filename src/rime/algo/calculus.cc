@@ -93,8 +93,67 @@ bool Transliteration::Apply(Spelling* spelling) {
   return modified;
 }
 
+// LiteralPattern
+
+bool LiteralPattern::Parse(const string& pattern) {
+  size_t begin = 0;
+  size_t end = pattern.length();
+  front = end > begin && pattern[begin] == '^';
+  if (front)
+    ++begin;
+  back = end > begin && pattern[end - 1] == '$';
+  if (back)
+    --end;
+  if (begin == end)
+    return false;
+  text = pattern.substr(begin, end - begin);
+  return text.find_first_of(".[]{}()\\*+?|^$") == string::npos;
+}
+
 // Transformation
 
+void Transformation::Compile(const string& pattern,
+                             const string& replacement) {
+  replacement_.assign(replacement);
+  // '$' and '\\' are special in the replacement format.
+  literal_ = literal_pattern_.Parse(pattern) &&
+             replacement.find_first_of("$\\") == string::npos;
+  if (!literal_)
+    pattern_.assign(pattern);
+}
+
+bool Transformation::ApplyLiteral(Spelling* spelling) {
+  string& str(spelling->str);
+  const string& text(literal_pattern_.text);
+  if (text.length() > str.length())
+    return false;
+  if (literal_pattern_.front || literal_pattern_.back) {
+    if (literal_pattern_.front && literal_pattern_.back &&
+        text.length() != str.length())
+      return false;
+    size_t pos = literal_pattern_.front ? 0 : str.length() - text.length();
+    if (str.compare(pos, text.length(), text) != 0)
+      return false;
+    if (text == replacement_)
+      return false;
+    str.replace(pos, text.length(), replacement_);
+    return true;
+  }
+  size_t pos = str.find(text);
+  if (pos == string::npos || text == replacement_)
+    return false;
+  string result;
+  size_t start = 0;
+  for (; pos != string::npos; pos = str.find(text, start)) {
+    result.append(str, start, pos - start);
+    result.append(replacement_);
+    start = pos + text.length();
+  }
+  result.append(str, start, string::npos);
+  str.swap(result);
+  return true;
+}
+
 Calculation* Transformation::Parse(const vector<string>& args) {
   if (args.size() < 3)
     return NULL;
@@ -103,14 +162,15 @@ Calculation* Transformation::Parse(const vector<string>& args) {
   if (left.empty())
     return NULL;
   the<Transformation> x(new Transformation);
-  x->pattern_.assign(left);
-  x->replacement_.assign(right);
+  x->Compile(left, right);
   return x.release();
 }
 
 bool Transformation::Apply(Spelling* spelling) {
   if (!spelling || spelling->str.empty())
     return false;
+  if (literal_)
+    return ApplyLiteral(spelling);
   string result = boost::regex_replace(spelling->str, pattern_, replacement_);
   if (result == spelling->str)
     return false;
@@ -127,14 +187,18 @@ Calculation* Erasion::Parse(const vector<string>& args) {
   if (pattern.empty())
     return NULL;
   the<Erasion> x(new Erasion);
-  x->pattern_.assign(pattern);
+  // erasion matches the whole spelling, with or without anchors.
+  x->literal_ = x->literal_pattern_.Parse(pattern);
+  if (!x->literal_)
+    x->pattern_.assign(pattern);
   return x.release();
 }
 
 bool Erasion::Apply(Spelling* spelling) {
   if (!spelling || spelling->str.empty())
     return false;
-  if (!boost::regex_match(spelling->str, pattern_))
+  if (literal_ ? spelling->str != literal_pattern_.text
+               : !boost::regex_match(spelling->str, pattern_))
     return false;
   spelling->str.clear();
   return true;
@@ -150,8 +214,7 @@ Calculation* Derivation::Parse(const vector<string>& args) {
   if (left.empty())
     return NULL;
   the<Derivation> x(new Derivation);
-  x->pattern_.assign(left);
-  x->replacement_.assign(right);
+  x->Compile(left, right);
   return x.release();
 }
 
@@ -165,8 +228,7 @@ Calculation* Fuzzing::Parse(const vector<string>& args) {
   if (left.empty())
     return NULL;
   the<Fuzzing> x(new Fuzzing);
-  x->pattern_.assign(left);
-  x->replacement_.assign(right);
+  x->Compile(left, right);
   return x.release();
 }
 
@@ -189,8 +251,7 @@ Calculation* Abbreviation::Parse(const vector<string>& args) {
   if (left.empty())
     return NULL;
   the<Abbreviation> x(new Abbreviation);
-  x->pattern_.assign(left);
-  x->replacement_.assign(right);
+  x->Compile(left, right);
   return x.release();
 }
 
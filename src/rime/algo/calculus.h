@@ -47,6 +47,17 @@ class Transliteration : public Calculation {
   map<uint32_t, uint32_t> char_map_;
 };
 
+// a pattern of literal text, optionally anchored with ^ and $, which is
+// matched by plain string comparison instead of the regex engine.
+struct LiteralPattern {
+  string text;
+  bool front = false;
+  bool back = false;
+
+  // returns false if the pattern needs a regex.
+  bool Parse(const string& pattern);
+};
+
 // xform/x/y/
 class Transformation : public Calculation {
  public:
@@ -54,8 +65,14 @@ class Transformation : public Calculation {
   bool Apply(Spelling* spelling);
 
  protected:
+  // compiles the rule, without a regex if both sides are literal text.
+  void Compile(const string& pattern, const string& replacement);
+  bool ApplyLiteral(Spelling* spelling);
+
   boost::regex pattern_;
   string replacement_;
+  bool literal_ = false;
+  LiteralPattern literal_pattern_;
 };
 
 // erase/x/
@@ -67,6 +84,8 @@ class Erasion : public Calculation {
 
  protected:
   boost::regex pattern_;
+  bool literal_ = false;
+  LiteralPattern literal_pattern_;
 };
 
 // derive/x/X/
@@ -0,0 +1,83 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <stdint.h>
+#include <rime/algo/cpu_features.h>
+
+#if defined(RIME_KERNEL_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace rime {
+
+#if defined(RIME_KERNEL_X86)
+
+static void cpuid(unsigned int leaf, unsigned int registers[4]) {
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuidex(info, int(leaf), 0);
+  for (int i = 0; i < 4; ++i) {
+    registers[i] = unsigned(info[i]);
+  }
+#else
+  __cpuid_count(leaf, 0, registers[0], registers[1], registers[2],
+                registers[3]);
+#endif
+}
+
+// the register states enabled by the operating system.
+static uint64_t xgetbv() {
+#if defined(_MSC_VER)
+  return _xgetbv(0);
+#else
+  uint32_t eax, edx;
+  __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return (uint64_t(edx) << 32) | eax;
+#endif
+}
+
+static CpuFeatures Detect() {
+  CpuFeatures features;
+  unsigned int registers[4] = {0};
+  cpuid(0, registers);
+  unsigned int max_leaf = registers[0];
+  if (max_leaf < 1)
+    return features;
+  cpuid(1, registers);
+  const unsigned int ecx = registers[2];
+  features.sse42 = (ecx & (1u << 20)) != 0;
+  // AVX registers are usable only if the OS saves them on context switches.
+  bool osxsave = (ecx & (1u << 27)) != 0;
+  bool avx = (ecx & (1u << 28)) != 0;
+  bool ymm_enabled = osxsave && (xgetbv() & 0x6) == 0x6;
+  if (avx && ymm_enabled && max_leaf >= 7) {
+    cpuid(7, registers);
+    features.avx2 = (registers[1] & (1u << 5)) != 0;
+  }
+  return features;
+}
+
+#else
+
+static CpuFeatures Detect() {
+  CpuFeatures features;
+#if defined(RIME_KERNEL_NEON) || defined(__ARM_NEON)
+  // Advanced SIMD is mandatory on AArch64.
+  features.neon = true;
+#endif
+  return features;
+}
+
+#endif
+
+const CpuFeatures& cpu_features() {
+  static const CpuFeatures features = Detect();
+  return features;
+}
+
+}  // namespace rime
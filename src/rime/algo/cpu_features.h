@@ -0,0 +1,66 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#ifndef RIME_CPU_FEATURES_H_
+#define RIME_CPU_FEATURES_H_
+
+#include <rime_api.h>
+
+// Vector code beyond the baseline of the target architecture is compiled
+// for functions marked with these attributes, and only called once the
+// processor is found to support it.
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || \
+    defined(_M_IX86)
+#define RIME_KERNEL_X86
+#if defined(_MSC_VER) && !defined(__clang__)
+#define RIME_TARGET_SSE42
+#define RIME_TARGET_AVX2
+#else
+#define RIME_TARGET_SSE42 __attribute__((target("sse4.2")))
+#define RIME_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define RIME_KERNEL_NEON
+#endif
+
+namespace rime {
+
+// Instruction set extensions of the processor running the library.
+struct CpuFeatures {
+  bool sse42 = false;
+  bool avx2 = false;
+  bool neon = false;
+};
+
+// detected once, at the first call.
+RIME_API const CpuFeatures& cpu_features();
+
+// A routine with a portable implementation and optional variants in vector
+// instructions, resolved to the best one the processor supports. A kernel
+// is selected once into a function pointer, e.g.
+//
+//   static const Function find = Kernel<Function>{find_portable,
+//                                                 find_sse42,
+//                                                 find_avx2}.Select();
+template <class Function>
+struct Kernel {
+  Function portable;
+  Function sse42 = nullptr;
+  Function avx2 = nullptr;
+  Function neon = nullptr;
+
+  Function Select(const CpuFeatures& features = cpu_features()) const {
+    if (avx2 && features.avx2)
+      return avx2;
+    if (sse42 && features.sse42)
+      return sse42;
+    if (neon && features.neon)
+      return neon;
+    return portable;
+  }
+};
+
+}  // namespace rime
+
+#endif  // RIME_CPU_FEATURES_H_
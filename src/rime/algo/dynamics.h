@@ -1,15 +1,56 @@
+#include <array>
 #include <cmath>
 
 namespace rime {
 namespace algo {
 
+// exp(-k / 200) of formula_d for whole tick deltas k up to the size of the
+// table, which covers most entries in a user dictionary; entries untouched
+// longer have decayed to next to nothing.
+static constexpr size_t kDecayTableSize = 2048;
+
+inline const std::array<double, kDecayTableSize>& decay_table() {
+  static const auto table = [] {
+    std::array<double, kDecayTableSize> table;
+    for (size_t k = 0; k < kDecayTableSize; ++k) {
+      table[k] = exp(-(double)k / 200);
+    }
+    return table;
+  }();
+  return table;
+}
+
+// exp((ta - t) / 200), looked up for whole deltas in the table, where the
+// result is the same as computed.
+inline double decay(double t, double ta) {
+  double delta = t - ta;
+  if (delta >= 0 && delta < kDecayTableSize) {
+    size_t k = (size_t)delta;
+    if (k == delta)
+      return decay_table()[k];
+  }
+  return exp((ta - t) / 200);
+}
+
 inline double formula_d(double d, double t, double da, double ta) {
-  return d + da * exp((ta - t) / 200);
+  return d + da * decay(t, ta);
+}
+
+// the factor of formula_p depending only on t, the present tick, which is
+// the same for the entries scored in a lookup; so the last one is kept.
+inline double formula_p_recency(double t) {
+  thread_local double last_t = -1;
+  thread_local double last_factor = 0;
+  if (t != last_t) {
+    last_factor = pow((1 - exp(-t / 10000)), 10);
+    last_t = t;
+  }
+  return last_factor;
 }
 
 inline double formula_p(double s, double u, double t, double d) {
   const double kM = 1 / (1 - exp(-0.005));
-  double m = s - (s - u) * pow((1 - exp(-t / 10000)), 10);
+  double m = s - (s - u) * formula_p_recency(t);
   return (d < 20) ? m + (0.5 - m) * (d / kM)
                   : m + (1 - m) * (pow(4, (d / kM)) - 1) / 3;
 }
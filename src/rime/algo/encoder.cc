@@ -4,6 +4,7 @@
 //
 // 2013-07-17 GONG Chen <chen.sst@gmail.com>
 //
+#include <algorithm>
 #include <boost/algorithm/string.hpp>
 #include <utf8.h>
 #include <rime/config.h>
@@ -46,6 +47,7 @@ bool TableEncoder::LoadSettings(Config* config) {
   loaded_ = false;
   max_phrase_length_ = 0;
   encoding_rules_.clear();
+  char_codes_.clear();
   exclude_patterns_.clear();
   tail_anchor_.clear();
 
@@ -233,9 +235,38 @@ int TableEncoder::CalculateCodeIndex(const string& code, int index, int start) {
   return k;
 }
 
+the<Encoder> TableEncoder::Clone(PhraseCollector* collector) const {
+  the<Encoder> encoder(new TableEncoder(*this));
+  encoder->set_collector(collector);
+  return encoder;
+}
+
+void TableEncoder::set_collector(PhraseCollector* collector) {
+  if (collector != collector_) {
+    char_codes_.clear();
+  }
+  Encoder::set_collector(collector);
+}
+
+const vector<string>& TableEncoder::TranslateChar(const string& character) {
+  auto found = char_codes_.find(character);
+  if (found != char_codes_.end())
+    return found->second;
+  auto& codes = char_codes_[character];
+  if (collector_->TranslateWord(character, &codes)) {
+    codes.erase(std::remove_if(codes.begin(), codes.end(),
+                               [this](const string& x) {
+                                 return IsCodeExcluded(x);
+                               }),
+                codes.end());
+  } else {
+    codes.clear();
+  }
+  return codes;
+}
+
 bool TableEncoder::EncodePhrase(const string& phrase, const string& value) {
-  size_t phrase_length = utf8::unchecked::distance(
-      phrase.c_str(), phrase.c_str() + phrase.length());
+  size_t phrase_length = strings::utf8_length(phrase);
   if (static_cast<int>(phrase_length) > max_phrase_length_)
     return false;
 
@@ -271,19 +302,13 @@ bool TableEncoder::DfsEncode(const string& phrase,
   size_t word_len = word_end - word_start;
   string word(word_start, word_len);
   bool ret = false;
-  vector<string> translations;
-  if (collector_->TranslateWord(word, &translations)) {
-    for (const string& x : translations) {
-      if (IsCodeExcluded(x)) {
-        continue;
-      }
-      code->push_back(x);
-      bool ok = DfsEncode(phrase, value, start_pos + word_len, code, limit);
-      ret = ret || ok;
-      code->pop_back();
-      if (limit && *limit <= 0) {
-        return ret;
-      }
+  for (const string& x : TranslateChar(word)) {
+    code->push_back(x);
+    bool ok = DfsEncode(phrase, value, start_pos + word_len, code, limit);
+    ret = ret || ok;
+    code->pop_back();
+    if (limit && *limit <= 0) {
+      return ret;
     }
   }
   return ret;
@@ -291,9 +316,12 @@ bool TableEncoder::DfsEncode(const string& phrase,
 
 ScriptEncoder::ScriptEncoder(PhraseCollector* collector) : Encoder(collector) {}
 
+the<Encoder> ScriptEncoder::Clone(PhraseCollector* collector) const {
+  return the<Encoder>(new ScriptEncoder(collector));
+}
+
 bool ScriptEncoder::EncodePhrase(const string& phrase, const string& value) {
-  size_t phrase_length = utf8::unchecked::distance(
-      phrase.c_str(), phrase.c_str() + phrase.length());
+  size_t phrase_length = strings::utf8_length(phrase);
   if (static_cast<int>(phrase_length) > kMaxPhraseLength)
     return false;
 
@@ -10,6 +10,7 @@
 
 #include <boost/regex.hpp>
 #include <rime_api.h>
+#include <rime/common.h>
 
 namespace rime {
 
@@ -41,8 +42,13 @@ class Encoder {
   virtual bool LoadSettings(Config* config) { return false; }
 
   virtual bool EncodePhrase(const string& phrase, const string& value) = 0;
+  // an encoder of the same settings, collecting phrases for another
+  // collector; encoders are not shared by threads.
+  virtual the<Encoder> Clone(PhraseCollector* collector) const = 0;
 
-  void set_collector(PhraseCollector* collector) { collector_ = collector; }
+  virtual void set_collector(PhraseCollector* collector) {
+    collector_ = collector;
+  }
 
  protected:
   PhraseCollector* collector_;
@@ -71,6 +77,8 @@ class RIME_API TableEncoder : public Encoder {
 
   bool Encode(const RawCode& code, string* result);
   bool EncodePhrase(const string& phrase, const string& value);
+  the<Encoder> Clone(PhraseCollector* collector) const;
+  void set_collector(PhraseCollector* collector);
 
   bool IsCodeExcluded(const string& code);
 
@@ -83,6 +91,9 @@ class RIME_API TableEncoder : public Encoder {
  protected:
   bool ParseFormula(const string& formula, TableEncodingRule* rule);
   int CalculateCodeIndex(const string& code, int index, int start);
+  // codes of a character that are not excluded, as translated by the
+  // collector; remembered until the settings or the collector change.
+  const vector<string>& TranslateChar(const string& character);
   bool DfsEncode(const string& phrase,
                  const string& value,
                  size_t start_pos,
@@ -96,6 +107,7 @@ class RIME_API TableEncoder : public Encoder {
   string tail_anchor_;
   // for optimization
   int max_phrase_length_;
+  hash_map<string, vector<string>> char_codes_;
 };
 
 // for syllable-based phrase encoding
@@ -104,6 +116,7 @@ class ScriptEncoder : public Encoder {
   ScriptEncoder(PhraseCollector* collector);
 
   bool EncodePhrase(const string& phrase, const string& value);
+  the<Encoder> Clone(PhraseCollector* collector) const;
 
  private:
   bool DfsEncode(const string& phrase,
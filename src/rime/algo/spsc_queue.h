@@ -0,0 +1,65 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#ifndef RIME_SPSC_QUEUE_H_
+#define RIME_SPSC_QUEUE_H_
+
+#include <atomic>
+#include <rime/common.h>
+
+namespace rime {
+
+// A bounded queue passing items from one thread to another without a lock.
+// Only one thread at a time may push, and one thread at a time may pop.
+template <class T>
+class SpscQueue {
+ public:
+  explicit SpscQueue(size_t capacity) : slots_(capacity + 1) {}
+  SpscQueue(const SpscQueue&) = delete;
+  SpscQueue& operator=(const SpscQueue&) = delete;
+
+  // returns false if the queue is full.
+  bool TryPush(T value) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t next = advance(tail);
+    if (next == head_.load(std::memory_order_acquire))
+      return false;
+    slots_[tail] = std::move(value);
+    tail_.store(next, std::memory_order_release);
+    return true;
+  }
+
+  // returns false if the queue is empty.
+  bool TryPop(T* value) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire))
+      return false;
+    *value = std::move(slots_[head]);
+    head_.store(advance(head), std::memory_order_release);
+    return true;
+  }
+
+  // as seen by the calling thread; may change as soon as it returns.
+  bool empty() const {
+    return head_.load(std::memory_order_acquire) ==
+           tail_.load(std::memory_order_acquire);
+  }
+  size_t capacity() const { return slots_.size() - 1; }
+
+ private:
+  size_t advance(size_t index) const {
+    return index + 1 < slots_.size() ? index + 1 : 0;
+  }
+
+  // one slot is left empty to tell a full queue from an empty one.
+  vector<T> slots_;
+  // written by the consumer and the producer respectively, kept apart so
+  // that they do not share a cache line.
+  alignas(64) std::atomic<size_t> head_{0};
+  alignas(64) std::atomic<size_t> tail_{0};
+};
+
+}  // namespace rime
+
+#endif  // RIME_SPSC_QUEUE_H_
@@ -1,8 +1,100 @@
+#include <bitset>
 #include <rime/algo/strings.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RIME_STRINGS_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define RIME_STRINGS_NEON
+#endif
+
 namespace rime {
 namespace strings {
 
+static inline bool is_utf8_continuation(char c) {
+  return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+#if defined(RIME_STRINGS_SSE2) || defined(RIME_STRINGS_NEON)
+const size_t kBlockSize = 16;
+
+// number of bytes starting a code point in a block.
+static inline size_t count_leading_bytes(const char* p) {
+#if defined(RIME_STRINGS_SSE2)
+  __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  // continuation bytes are signed values below -64
+  __m128i continuation = _mm_cmplt_epi8(block, _mm_set1_epi8(-64));
+  int mask = _mm_movemask_epi8(continuation);
+  return kBlockSize - std::bitset<kBlockSize>(mask).count();
+#elif defined(RIME_STRINGS_NEON)
+  int8x16_t block = vld1q_s8(reinterpret_cast<const int8_t*>(p));
+  uint8x16_t leading = vcgeq_s8(block, vdupq_n_s8(-64));
+  return vaddvq_u8(vshrq_n_u8(leading, 7));
+#endif
+}
+
+// whether all bytes of a block are ASCII.
+static inline bool is_ascii_block(const char* p) {
+#if defined(RIME_STRINGS_SSE2)
+  __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  return _mm_movemask_epi8(block) == 0;
+#elif defined(RIME_STRINGS_NEON)
+  uint8x16_t block = vld1q_u8(reinterpret_cast<const uint8_t*>(p));
+  return vmaxvq_u8(block) < 0x80;
+#endif
+}
+#endif
+
+size_t utf8_length(const char* begin, const char* end) {
+  size_t length = 0;
+  const char* p = begin;
+#if defined(RIME_STRINGS_SSE2) || defined(RIME_STRINGS_NEON)
+  for (; end - p >= static_cast<ptrdiff_t>(kBlockSize); p += kBlockSize) {
+    length += count_leading_bytes(p);
+  }
+#endif
+  for (; p < end; ++p) {
+    if (!is_utf8_continuation(*p))
+      ++length;
+  }
+  return length;
+}
+
+size_t utf8_offset(const char* begin, const char* end, size_t index) {
+  const char* p = begin;
+#if defined(RIME_STRINGS_SSE2) || defined(RIME_STRINGS_NEON)
+  // skip whole blocks before the one where the code point starts
+  for (; end - p >= static_cast<ptrdiff_t>(kBlockSize); p += kBlockSize) {
+    size_t count = count_leading_bytes(p);
+    if (count > index)
+      break;
+    index -= count;
+  }
+#endif
+  for (; p < end; ++p) {
+    if (!is_utf8_continuation(*p)) {
+      if (index == 0)
+        break;
+      --index;
+    }
+  }
+  return p - begin;
+}
+
+size_t ascii_prefix_length(const char* begin, const char* end) {
+  const char* p = begin;
+#if defined(RIME_STRINGS_SSE2) || defined(RIME_STRINGS_NEON)
+  for (; end - p >= static_cast<ptrdiff_t>(kBlockSize) && is_ascii_block(p);
+       p += kBlockSize) {
+  }
+#endif
+  while (p < end && static_cast<unsigned char>(*p) < 0x80)
+    ++p;
+  return p - begin;
+}
+
 vector<string> split(const string& str,
                      const string& delim,
                      SplitBehavior behavior) {
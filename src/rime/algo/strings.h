@@ -1,6 +1,7 @@
 #ifndef RIME_STRINGS_H_
 #define RIME_STRINGS_H_
 
+#include <rime_api.h>
 #include <rime/common.h>
 #include <initializer_list>
 
@@ -39,6 +40,28 @@ inline string join(std::initializer_list<C>&& container, T&& delim) {
   return join(std::begin(container), std::end(container), delim);
 }
 
+// Text is taken as valid UTF-8, where each byte but a continuation byte
+// (10xxxxxx) starts a code point. Blocks of bytes are scanned with SIMD
+// instructions where available.
+
+// returns the number of code points in the text.
+RIME_API size_t utf8_length(const char* begin, const char* end);
+
+inline size_t utf8_length(const string& str) {
+  return utf8_length(str.data(), str.data() + str.length());
+}
+
+// returns the byte offset of the code point at the given index, or the
+// length of the text if there are not as many code points.
+RIME_API size_t utf8_offset(const char* begin, const char* end, size_t index);
+
+inline size_t utf8_offset(const string& str, size_t index) {
+  return utf8_offset(str.data(), str.data() + str.length(), index);
+}
+
+// returns the number of leading ASCII bytes.
+RIME_API size_t ascii_prefix_length(const char* begin, const char* end);
+
 }  // namespace strings
 }  // namespace rime
 
@@ -10,6 +10,7 @@
 #include <rime/algo/syllabifier.h>
 #include <rime/dict/corrector.h>
 #include <rime/dict/prism.h>
+#include <rime/hot_log.h>
 #include "syllabifier.h"
 
 namespace rime {
@@ -22,12 +23,83 @@ using VertexQueue =
 const double kCompletionPenalty = -0.6931471805599453;     // log(0.5)
 const double kCorrectionCredibility = -4.605170185988091;  // log(0.01)
 
+void Syllabifier::MatchSpellings(
+    const string& input,
+    size_t current_pos,
+    Prism& prism,
+    const SyllabifierCache* last,
+    size_t common_prefix_length,
+    SyllabifierCache::VertexSpellings* spellings) {
+  if (last) {
+    auto found = last->vertices.find(current_pos);
+    // spellings at the vertex remain the same if the new input keeps the
+    // prism path from the vertex, or only truncates the last input.
+    if (found != last->vertices.end() &&
+        (current_pos + found->second.path_length < common_prefix_length ||
+         input.length() <= common_prefix_length)) {
+      for (const auto& m : found->second.matches) {
+        if (current_pos + m.second <= input.length())
+          spellings->matches.push_back(m);
+      }
+      spellings->path_length =
+          (std::min)(found->second.path_length, input.length() - current_pos);
+      return;
+    }
+  }
+  const char* current_input = input.c_str() + current_pos;
+  size_t node_pos = 0;
+  size_t key_pos = 0;
+  prism.trie().Traverse(current_input, &node_pos, &key_pos);
+  spellings->path_length = key_pos;
+  vector<Prism::Match> matches;
+  prism.CommonPrefixSearch(current_input, &matches);
+  for (const auto& m : matches) {
+    spellings->matches.push_back({m.value, m.length});
+  }
+}
+
 int Syllabifier::BuildSyllableGraph(const string& input,
                                     Prism& prism,
                                     SyllableGraph* graph) {
+  return BuildSyllableGraph(input, prism, graph, nullptr);
+}
+
+int Syllabifier::BuildSyllableGraph(const string& input,
+                                    Prism& prism,
+                                    SyllableGraph* graph,
+                                    SyllabifierCache* cache) {
   if (input.empty())
     return 0;
 
+  SyllabifierCache last;
+  size_t common_prefix_length = 0;
+  const void* prism_image = prism.trie().image();
+  if (cache) {
+    if (cache->prism_image == prism_image) {
+      last.input.swap(cache->input);
+      last.vertices.swap(cache->vertices);
+      last.corrections.swap(cache->corrections);
+      last.completion = cache->completion;
+      size_t max_length = (std::min)(input.length(), last.input.length());
+      while (common_prefix_length < max_length &&
+             input[common_prefix_length] == last.input[common_prefix_length])
+        ++common_prefix_length;
+    }
+    cache->Clear();
+    cache->input = input;
+    cache->prism_image = prism_image;
+    if (last.corrections.size() < SyllabifierCache::kMaxCorrections)
+      cache->corrections.swap(last.corrections);
+  }
+  // a tolerance search follows the input through the prism no further than
+  // the longest spelling, give or take the tolerated edits.
+  const size_t kTolerance = 5;
+  size_t correction_window =
+      corrector_ && cache ? prism.max_spelling_length() + kTolerance + 1 : 0;
+
+  graph->vertices.reserve(input.length() + 1);
+  graph->edges.reserve(input.length());
+
   size_t farthest = 0;
   VertexQueue queue;
   queue.push(Vertex{0, kNormalSpelling});  // start
@@ -48,28 +120,53 @@ int Syllabifier::BuildSyllableGraph(const string& input,
 
     if (current_pos > farthest)
       farthest = current_pos;
-    DLOG(INFO) << "current_pos: " << current_pos;
+    RIME_HOT_LOG(Syllabifier) << "current_pos: " << current_pos;
 
     // see where we can go by advancing a syllable
     vector<Prism::Match> matches;
     set<SyllableId> exact_match_syllables;
     auto current_input = input.substr(current_pos);
-    prism.CommonPrefixSearch(current_input, &matches);
+    if (cache) {
+      auto& spellings = cache->vertices[current_pos];
+      MatchSpellings(input, current_pos, prism,
+                     common_prefix_length > 0 ? &last : nullptr,
+                     common_prefix_length, &spellings);
+      for (const auto& m : spellings.matches) {
+        matches.push_back({m.first, m.second});
+      }
+    } else {
+      prism.CommonPrefixSearch(current_input, &matches);
+    }
     if (corrector_) {
       for (auto& m : matches) {
         exact_match_syllables.insert(m.value);
       }
-      Corrections corrections;
-      corrector_->ToleranceSearch(prism, current_input, &corrections, 5);
-      for (const auto& m : corrections) {
-        for (auto accessor = prism.QuerySpelling(m.first);
-             !accessor.exhausted(); accessor.Next()) {
-          if (accessor.properties().type == kNormalSpelling) {
-            matches.push_back({m.first, m.second.length});
-            break;
+      SyllabifierCache::Corrections searched;
+      auto* found = &searched;
+      bool cached = false;
+      if (cache) {
+        auto key = current_input.substr(0, correction_window);
+        auto it = cache->corrections.find(key);
+        cached = it != cache->corrections.end();
+        found = cached ? &it->second : &cache->corrections[key];
+      }
+      if (!cached) {
+        Corrections corrections;
+        corrector_->ToleranceSearch(prism, current_input, &corrections,
+                                    kTolerance);
+        for (const auto& m : corrections) {
+          for (auto accessor = prism.QuerySpelling(m.first);
+               !accessor.exhausted(); accessor.Next()) {
+            if (accessor.properties().type == kNormalSpelling) {
+              found->matches.push_back({m.first, m.second.length});
+              break;
+            }
           }
         }
       }
+      for (const auto& m : found->matches) {
+        matches.push_back({m.first, m.second});
+      }
     }
 
     if (!matches.empty()) {
@@ -82,7 +179,7 @@ int Syllabifier::BuildSyllableGraph(const string& input,
         while (end_pos < input.length() &&
                delimiters_.find(input[end_pos]) != string::npos)
           ++end_pos;
-        DLOG(INFO) << "end_pos: " << end_pos;
+        RIME_HOT_LOG(Syllabifier) << "end_pos: " << end_pos;
         bool matches_input = (current_pos == 0 && end_pos == input.length());
         SpellingMap& spellings(end_vertices[end_pos]);
         SpellingType end_vertex_type = kInvalidSpelling;
@@ -107,7 +204,7 @@ int Syllabifier::BuildSyllableGraph(const string& input,
             }
             auto it = spellings.find(syllable_id);
             if (it == spellings.end()) {
-              spellings.insert({syllable_id, props});
+              spellings.emplace(syllable_id, props);
             } else {
               it->second.type = (std::min)(it->second.type, props.type);
             }
@@ -120,7 +217,7 @@ int Syllabifier::BuildSyllableGraph(const string& input,
           accessor.Next();
         }
         if (spellings.empty()) {
-          DLOG(INFO) << "not spelled.";
+          RIME_HOT_LOG(Syllabifier) << "not spelled.";
           end_vertices.erase(end_pos);
           continue;
         }
@@ -131,13 +228,13 @@ int Syllabifier::BuildSyllableGraph(const string& input,
           end_vertex_type = vertex.second;
         }
         queue.push(Vertex{end_pos, end_vertex_type});
-        DLOG(INFO) << "added to syllable graph, edge: [" << current_pos << ", "
-                   << end_pos << ")";
+        RIME_HOT_LOG(Syllabifier) << "added to syllable graph, edge: ["
+                                  << current_pos << ", " << end_pos << ")";
       }
     }
   }
 
-  DLOG(INFO) << "remove stale vertices and edges";
+  RIME_HOT_LOG(Syllabifier) << "remove stale vertices and edges";
   set<int> good;
   good.insert(farthest);
   // fuzzy spellings are immune to invalidation by normal spellings
@@ -147,10 +244,11 @@ int Syllabifier::BuildSyllableGraph(const string& input,
     if (graph->vertices.find(i) == graph->vertices.end())
       continue;
     // remove stale edges
-    for (auto j = graph->edges[i].begin(); j != graph->edges[i].end();) {
+    auto& end_vertices(graph->edges[i]);
+    for (auto j = end_vertices.begin(); j != end_vertices.end();) {
       if (good.find(j->first) == good.end()) {
         // not connected
-        graph->edges[i].erase(j++);
+        j = end_vertices.erase(j);
         continue;
       }
       // remove disqualified syllables (eg. matching abbreviated spellings)
@@ -162,7 +260,7 @@ int Syllabifier::BuildSyllableGraph(const string& input,
           continue;  // Don't care correction edges
         }
         if (k->second.type > last_type) {
-          j->second.erase(k++);
+          k = j->second.erase(k);
         } else {
           if (k->second.type < edge_type)
             edge_type = k->second.type;
@@ -170,15 +268,15 @@ int Syllabifier::BuildSyllableGraph(const string& input,
         }
       }
       if (j->second.empty()) {
-        graph->edges[i].erase(j++);
+        j = end_vertices.erase(j);
       } else {
         if (edge_type < kAbbreviation)
           CheckOverlappedSpellings(graph, i, j->first);
         ++j;
       }
     }
-    if (graph->vertices[i] > last_type || graph->edges[i].empty()) {
-      DLOG(INFO) << "remove stale vertex at " << i;
+    if (graph->vertices[i] > last_type || end_vertices.empty()) {
+      RIME_HOT_LOG(Syllabifier) << "remove stale vertex at " << i;
       graph->vertices.erase(i);
       graph->edges.erase(i);
       continue;
@@ -188,16 +286,55 @@ int Syllabifier::BuildSyllableGraph(const string& input,
   }
 
   if (enable_completion_ && farthest < input.length()) {
-    DLOG(INFO) << "completion enabled";
-    const size_t kExpandSearchLimit = 512;
+    RIME_HOT_LOG(Syllabifier) << "completion enabled";
+    string prefix = input.substr(farthest);
+    const prism::CompletionList* completions = prism.QueryCompletions(prefix);
+    const prism::CompactCompletionList* compact_completions =
+        prism.QueryCompactCompletions(prefix);
     vector<Prism::Match> keys;
-    prism.ExpandSearch(input.substr(farthest), &keys, kExpandSearchLimit);
-    if (!keys.empty()) {
+    if (!completions && !compact_completions) {
+      const auto& resumed = last.completion;
+      bool resumable = resumed.end > resumed.start &&
+                       resumed.start == farthest &&
+                       resumed.end <= common_prefix_length;
+      size_t node_pos = resumable ? resumed.node_pos : 0;
+      size_t key_pos = resumable ? resumed.end - resumed.start : 0;
+      if (prism.ExpandSearchFrom(prefix, key_pos, &node_pos, &keys,
+                                 Prism::kCompletionLimit) &&
+          cache) {
+        cache->completion = {farthest, input.length(), node_pos};
+      }
+    }
+    if (completions || compact_completions || !keys.empty()) {
       size_t current_pos = farthest;
       size_t end_pos = input.length();
       size_t code_length = end_pos - current_pos;
       auto& end_vertices(graph->edges[current_pos]);
       auto& spellings(end_vertices[end_pos]);
+      if (completions) {
+        // precomputed for a short prefix, in the order of syllable ids
+        for (const auto& desc : *completions) {
+          SpellingProperties props;
+          props.type = kCompletion;
+          props.credibility = desc->credibility + kCompletionPenalty;
+          props.end_pos = end_pos;
+          if (!desc->tips.empty())
+            props.tips = desc->tips.c_str();
+          spellings.emplace_hint(spellings.end(), desc->syllable_id, props);
+        }
+      }
+      if (compact_completions) {
+        for (SpellingAccessor accessor(compact_completions,
+                                       prism.spelling_tables());
+             !accessor.exhausted(); accessor.Next()) {
+          SpellingProperties props = accessor.properties();
+          props.type = kCompletion;
+          props.credibility += kCompletionPenalty;
+          props.end_pos = end_pos;
+          spellings.emplace_hint(spellings.end(), accessor.syllable_id(),
+                                 props);
+        }
+      }
       for (const auto& m : keys) {
         if (m.length < code_length)
           continue;
@@ -214,17 +351,17 @@ int Syllabifier::BuildSyllableGraph(const string& input,
             props.end_pos = end_pos;
             // add a syllable with properties to the edge's
             // spelling-to-syllable map
-            spellings.insert({syllable_id, props});
+            spellings.emplace(syllable_id, props);
           }
           accessor.Next();
         }
       }
       if (spellings.empty()) {
-        DLOG(INFO) << "no completion could be made.";
+        RIME_HOT_LOG(Syllabifier) << "no completion could be made.";
         end_vertices.erase(end_pos);
       } else {
-        DLOG(INFO) << "added to syllable graph, completion: [" << current_pos
-                   << ", " << end_pos << ")";
+        RIME_HOT_LOG(Syllabifier) << "added to syllable graph, completion: ["
+                                  << current_pos << ", " << end_pos << ")";
         farthest = end_pos;
       }
     }
@@ -232,8 +369,9 @@ int Syllabifier::BuildSyllableGraph(const string& input,
 
   graph->input_length = input.length();
   graph->interpreted_length = farthest;
-  DLOG(INFO) << "input length: " << graph->input_length;
-  DLOG(INFO) << "syllabified length: " << graph->interpreted_length;
+  RIME_HOT_LOG(Syllabifier) << "input length: " << graph->input_length;
+  RIME_HOT_LOG(Syllabifier) << "syllabified length: "
+                            << graph->interpreted_length;
 
   Transpose(graph);
 
@@ -268,7 +406,8 @@ void Syllabifier::CheckOverlappedSpellings(SyllableGraph* graph,
           spelling.second.credibility += kPenaltyForAmbiguousSyllable;
         }
         graph->vertices[joint] = kAmbiguousSpelling;
-        DLOG(INFO) << "ambiguous syllable joint at position " << joint << ".";
+        RIME_HOT_LOG(Syllabifier) << "ambiguous syllable joint at position "
+                                  << joint << ".";
       }
       break;
     }
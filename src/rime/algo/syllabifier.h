@@ -9,6 +9,7 @@
 #define RIME_SYLLABIFIER_H_
 
 #include <stdint.h>
+#include <boost/container/flat_map.hpp>
 #include <rime_api.h>
 #include "spelling.h"
 
@@ -25,14 +26,20 @@ struct EdgeProperties : SpellingProperties {
   bool is_correction = false;
 };
 
-using SpellingMap = map<SyllableId, EdgeProperties>;
-using VertexMap = map<size_t, SpellingType>;
-using EndVertexMap = map<size_t, SpellingMap>;
-using EdgeMap = map<size_t, EndVertexMap>;
+// vertices and edges of a syllable graph are stored in sorted vectors.
+// they provide the interface of std::map, but unlike std::map, inserting or
+// erasing an element invalidates references and iterators to the others.
+template <class Key, class T>
+using graph_map = boost::container::flat_map<Key, T>;
+
+using SpellingMap = graph_map<SyllableId, EdgeProperties>;
+using VertexMap = graph_map<size_t, SpellingType>;
+using EndVertexMap = graph_map<size_t, SpellingMap>;
+using EdgeMap = graph_map<size_t, EndVertexMap>;
 
 using SpellingPropertiesList = vector<const EdgeProperties*>;
-using SpellingIndex = map<SyllableId, SpellingPropertiesList>;
-using SpellingIndices = map<size_t, SpellingIndex>;
+using SpellingIndex = graph_map<SyllableId, SpellingPropertiesList>;
+using SpellingIndices = graph_map<size_t, SpellingIndex>;
 
 struct SyllableGraph {
   size_t input_length = 0;
@@ -42,6 +49,51 @@ struct SyllableGraph {
   SpellingIndices indices;
 };
 
+// spellings matched at each vertex of the last syllabified input.
+// BuildSyllableGraph reuses them for a new input that shares a prefix with
+// the last one, such as after typing or deleting characters at the end.
+struct SyllabifierCache {
+  struct VertexSpellings {
+    // pairs of (spelling id, length)
+    vector<pair<SyllableId, size_t>> matches;
+    // length of the longest prefix of the input from the vertex which is
+    // a valid path in the prism.
+    size_t path_length = 0;
+  };
+
+  // corrections found for an input from a vertex do not change as more is
+  // typed; they are kept for the same prism, keyed by the part of the input
+  // a tolerance search reads, up to kMaxCorrections of them.
+  struct Corrections {
+    // pairs of (spelling id, length)
+    vector<pair<SyllableId, size_t>> matches;
+  };
+  static const size_t kMaxCorrections = 1024;
+
+  // the trie node of the partial spelling last expanded to completions, at
+  // [start, end) of the input; the search for a longer one starting at the
+  // same vertex continues from it.
+  struct Completion {
+    size_t start = 0;
+    size_t end = 0;
+    size_t node_pos = 0;
+  };
+
+  string input;
+  const void* prism_image = nullptr;
+  map<size_t, VertexSpellings> vertices;
+  hash_map<string, Corrections> corrections;
+  Completion completion;
+
+  void Clear() {
+    input.clear();
+    prism_image = nullptr;
+    vertices.clear();
+    corrections.clear();
+    completion = Completion();
+  }
+};
+
 class Syllabifier {
  public:
   Syllabifier() = default;
@@ -55,9 +107,21 @@ class Syllabifier {
   RIME_API int BuildSyllableGraph(const string& input,
                                   Prism& prism,
                                   SyllableGraph* graph);
+  // builds the graph reusing spellings matched for the last input in cache,
+  // then updates the cache for the current input.
+  RIME_API int BuildSyllableGraph(const string& input,
+                                  Prism& prism,
+                                  SyllableGraph* graph,
+                                  SyllabifierCache* cache);
   RIME_API void EnableCorrection(Corrector* corrector);
 
  protected:
+  void MatchSpellings(const string& input,
+                      size_t current_pos,
+                      Prism& prism,
+                      const SyllabifierCache* last,
+                      size_t common_prefix_length,
+                      SyllabifierCache::VertexSpellings* spellings);
   void CheckOverlappedSpellings(SyllableGraph* graph, size_t start, size_t end);
   void Transpose(SyllableGraph* graph);
 
@@ -4,9 +4,16 @@
 //
 // 2013-01-30 GONG Chen <chen.sst@gmail.com>
 //
+#include <filesystem>
 #include <fstream>
+#include <future>
 #include <sstream>
+#include <rime/worker_pool.h>
+#include <rime/algo/strings.h>
 #include <rime/algo/utilities.h>
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
 
 namespace rime {
 
@@ -28,19 +35,188 @@ int CompareVersionString(const string& x, const string& y) {
   return 0;
 }
 
-ChecksumComputer::ChecksumComputer(uint32_t initial_remainder)
-    : crc_(initial_remainder) {}
+static uint32_t gf2_matrix_times(const uint32_t* mat, uint32_t vec) {
+  uint32_t sum = 0;
+  for (; vec; vec >>= 1, ++mat) {
+    if (vec & 1)
+      sum ^= *mat;
+  }
+  return sum;
+}
 
-void ChecksumComputer::ProcessFile(const path& file_path) {
+static void gf2_matrix_square(uint32_t* square, const uint32_t* mat) {
+  for (int n = 0; n < 32; ++n) {
+    square[n] = gf2_matrix_times(mat, mat[n]);
+  }
+}
+
+// the remainder after processing as many zero bytes from the remainder.
+// as the crc is linear, processing a file from any remainder is the same as
+// this XOR processing the file from 0.
+static uint32_t skip_zero_bytes(uint32_t remainder, uint64_t length) {
+  if (remainder == 0)
+    return 0;
+  // the operator of a zero byte, in the representation of the remainder.
+  uint32_t op[32];
+  for (int n = 0; n < 32; ++n) {
+    boost::crc_32_type crc(uint32_t(1) << n);
+    crc.process_byte(0);
+    op[n] = crc.get_interim_remainder();
+  }
+  uint32_t square[32];
+  while (length) {
+    if (length & 1)
+      remainder = gf2_matrix_times(op, remainder);
+    length >>= 1;
+    if (length) {
+      gf2_matrix_square(square, op);
+      std::copy(square, square + 32, op);
+    }
+  }
+  return remainder;
+}
+
+FileChecksum FileChecksum::Compute(const path& file_path) {
   std::ifstream fin(file_path.c_str());
   std::stringstream buffer;
   buffer << fin.rdbuf();
   const auto& file_content(buffer.str());
-  crc_.process_bytes(file_content.data(), file_content.length());
+  boost::crc_32_type crc(0);
+  crc.process_bytes(file_content.data(), file_content.length());
+  return {crc.get_interim_remainder(), file_content.length()};
+}
+
+ChecksumComputer::ChecksumComputer(uint32_t initial_remainder)
+    : crc_(initial_remainder) {}
+
+void ChecksumComputer::ProcessFile(const path& file_path) {
+  Append(FileChecksumManifest::instance().Get(file_path));
+}
+
+void ChecksumComputer::ProcessFiles(const vector<path>& file_paths) {
+  auto& manifest = FileChecksumManifest::instance();
+  vector<FileChecksum> checksums(file_paths.size());
+  vector<std::future<void>> pending;
+  for (size_t i = 0; i < file_paths.size(); ++i) {
+    pending.push_back(WorkerPool::Shared().Submit(
+        [&, i] { checksums[i] = manifest.Get(file_paths[i]); }));
+  }
+  for (auto& x : pending) {
+    x.get();
+  }
+  for (const auto& checksum : checksums) {
+    Append(checksum);
+  }
+}
+
+void ChecksumComputer::ProcessText(const string& text) {
+  crc_.process_bytes(text.data(), text.length());
+}
+
+void ChecksumComputer::Append(const FileChecksum& file_checksum) {
+  crc_.reset(
+      skip_zero_bytes(crc_.get_interim_remainder(), file_checksum.length) ^
+      file_checksum.remainder);
 }
 
 uint32_t ChecksumComputer::Checksum() {
   return crc_.checksum();
 }
 
+FileChecksumManifest& FileChecksumManifest::instance() {
+  static FileChecksumManifest manifest;
+  return manifest;
+}
+
+bool FileChecksumManifest::GetFileInfo(const path& file_path, FileInfo* info) {
+  std::error_code ec;
+  info->size = std::filesystem::file_size(file_path, ec);
+  if (ec)
+    return false;
+  auto modified_time = std::filesystem::last_write_time(file_path, ec);
+  if (ec)
+    return false;
+  info->modified_time = modified_time.time_since_epoch().count();
+#ifndef _WIN32
+  struct stat st;
+  if (::stat(file_path.c_str(), &st) != 0)
+    return false;
+  info->inode = st.st_ino;
+#endif
+  return true;
+}
+
+FileChecksum FileChecksumManifest::Get(const path& file_path) {
+  FileInfo info;
+  if (!GetFileInfo(file_path, &info)) {
+    return FileChecksum::Compute(file_path);
+  }
+  string key = file_path.u8string();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it != entries_.end() && it->second.first == info)
+      return it->second.second;
+  }
+  auto checksum = FileChecksum::Compute(file_path);
+  // the file may have been written while it was read.
+  FileInfo info_after;
+  if (!GetFileInfo(file_path, &info_after) || !(info_after == info) ||
+      checksum.length != info.size)
+    return checksum;
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_[key] = {info, checksum};
+  modified_ = true;
+  return checksum;
+}
+
+// each line of the manifest:
+// path <Tab> size <Tab> modified time <Tab> inode <Tab> remainder
+bool FileChecksumManifest::Load(const path& file_path) {
+  std::ifstream fin(file_path.c_str());
+  if (!fin)
+    return false;
+  std::lock_guard<std::mutex> lock(mutex_);
+  string line;
+  while (getline(fin, line)) {
+    auto row = strings::split(line, "\t");
+    if (row.size() != 5)
+      continue;
+    try {
+      FileInfo info;
+      info.size = std::stoull(row[1]);
+      info.modified_time = std::stoll(row[2]);
+      info.inode = std::stoull(row[3]);
+      FileChecksum checksum;
+      checksum.remainder = static_cast<uint32_t>(std::stoul(row[4]));
+      checksum.length = info.size;
+      entries_.emplace(row[0], std::make_pair(info, checksum));
+    } catch (...) {
+      continue;
+    }
+  }
+  LOG(INFO) << "loaded " << entries_.size()
+            << " file checksums from manifest: " << file_path;
+  return true;
+}
+
+bool FileChecksumManifest::Save(const path& file_path) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!modified_)
+    return true;
+  std::ofstream fout(file_path.c_str());
+  if (!fout) {
+    LOG(ERROR) << "error saving file checksum manifest: " << file_path;
+    return false;
+  }
+  for (const auto& entry : entries_) {
+    const auto& info = entry.second.first;
+    fout << entry.first << '\t' << info.size << '\t' << info.modified_time
+         << '\t' << info.inode << '\t' << entry.second.second.remainder
+         << std::endl;
+  }
+  modified_ = false;
+  return bool(fout);
+}
+
 }  // namespace rime
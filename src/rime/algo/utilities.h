@@ -8,6 +8,7 @@
 #define RIME_UTILITIES_H_
 
 #include <stdint.h>
+#include <mutex>
 #include <boost/crc.hpp>
 #include <rime/common.h>
 
@@ -15,16 +16,61 @@ namespace rime {
 
 int CompareVersionString(const string& x, const string& y);
 
+// the checksum of a file's content, that can be carried on from the
+// checksum of whatever has been processed before the file.
+struct FileChecksum {
+  // the remainder after processing the content from a remainder of 0.
+  uint32_t remainder = 0;
+  uint64_t length = 0;
+
+  static FileChecksum Compute(const path& file_path);
+};
+
 class ChecksumComputer {
  public:
   explicit ChecksumComputer(uint32_t initial_remainder = 0);
   void ProcessFile(const path& file_path);
+  // the same as processing the files one after another; files that are not
+  // in the manifest are read in parallel.
+  void ProcessFiles(const vector<path>& file_paths);
+  void ProcessText(const string& text);
   uint32_t Checksum();
 
  private:
+  void Append(const FileChecksum& file_checksum);
+
   boost::crc_32_type crc_;
 };
 
+// checksums of the files read while deploying, kept with the size,
+// modification time and inode of each file. unchanged files are not read
+// again, also in later deployments if the manifest is saved.
+class FileChecksumManifest {
+ public:
+  static FileChecksumManifest& instance();
+
+  bool Load(const path& file_path);
+  bool Save(const path& file_path);
+  // reads the file if it has changed since its checksum was recorded.
+  FileChecksum Get(const path& file_path);
+
+ private:
+  struct FileInfo {
+    uint64_t size = 0;
+    int64_t modified_time = 0;
+    uint64_t inode = 0;
+    bool operator==(const FileInfo& other) const {
+      return size == other.size && modified_time == other.modified_time &&
+             inode == other.inode;
+    }
+  };
+  static bool GetFileInfo(const path& file_path, FileInfo* info);
+
+  std::mutex mutex_;
+  map<string, pair<FileInfo, FileChecksum>> entries_;
+  bool modified_ = false;
+};
+
 inline uint32_t Checksum(const path& file_path) {
   ChecksumComputer c;
   c.ProcessFile(file_path);
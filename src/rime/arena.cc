@@ -0,0 +1,39 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <cstdint>
+#include <rime/arena.h>
+#include <rime/perf_counters.h>
+
+namespace rime {
+
+Arena::Arena(size_t block_size) : block_size_(block_size) {}
+
+Arena::~Arena() {
+  for (char* block : blocks_) {
+    delete[] block;
+  }
+}
+
+void* Arena::Allocate(size_t size, size_t alignment) {
+  size_t padding =
+      (alignment - reinterpret_cast<uintptr_t>(ptr_) % alignment) % alignment;
+  if (!ptr_ || padding + size > remaining_) {
+    // oversized objects get a block of their own
+    size_t new_block_size = (std::max)(block_size_, size + alignment);
+    ptr_ = new char[new_block_size];
+    blocks_.push_back(ptr_);
+    remaining_ = new_block_size;
+    capacity_ += new_block_size;
+    PerfCounters::Count(PerfCounters::kBytesAllocated, new_block_size);
+    padding =
+        (alignment - reinterpret_cast<uintptr_t>(ptr_) % alignment) % alignment;
+  }
+  void* result = ptr_ + padding;
+  ptr_ += padding + size;
+  remaining_ -= padding + size;
+  return result;
+}
+
+}  // namespace rime
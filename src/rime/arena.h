@@ -0,0 +1,81 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#ifndef RIME_ARENA_H_
+#define RIME_ARENA_H_
+
+#include <rime_api.h>
+#include <rime/common.h>
+
+namespace rime {
+
+// A monotonic allocator for short-lived objects of a session, such as dict
+// entries and candidates made for the current input.
+// Memory is never reused; it is all given back when the arena is destroyed.
+// An arena is not thread-safe.
+class RIME_API Arena {
+ public:
+  static const size_t kDefaultBlockSize = 64 * 1024;
+
+  explicit Arena(size_t block_size = kDefaultBlockSize);
+  ~Arena();
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  void* Allocate(size_t size, size_t alignment);
+  // total size of memory blocks held by the arena.
+  size_t capacity() const { return capacity_; }
+
+ private:
+  size_t block_size_;
+  vector<char*> blocks_;
+  char* ptr_ = nullptr;
+  size_t remaining_ = 0;
+  size_t capacity_ = 0;
+};
+
+// Deallocation is a no-op; each copy of the allocator keeps the arena alive,
+// so objects allocated from it can outlive the owner's reference.
+template <class T>
+class ArenaAllocator {
+ public:
+  using value_type = T;
+
+  explicit ArenaAllocator(an<Arena> arena) : arena_(std::move(arena)) {}
+  template <class U>
+  ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.arena()) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(arena_->Allocate(n * sizeof(T), alignof(T)));
+  }
+  void deallocate(T* p, size_t n) {}
+
+  const an<Arena>& arena() const { return arena_; }
+
+ private:
+  an<Arena> arena_;
+};
+
+template <class T, class U>
+inline bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena() == b.arena();
+}
+
+template <class T, class U>
+inline bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return !(a == b);
+}
+
+// allocates a shared object from the arena if given, otherwise from the heap.
+template <class T, class... Args>
+inline an<T> NewIn(const an<Arena>& arena, Args&&... args) {
+  if (!arena)
+    return New<T>(std::forward<Args>(args)...);
+  return std::allocate_shared<T>(ArenaAllocator<T>(arena),
+                                 std::forward<Args>(args)...);
+}
+
+}  // namespace rime
+
+#endif  // RIME_ARENA_H_
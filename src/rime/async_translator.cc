@@ -0,0 +1,81 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <rime/async_translator.h>
+#include <rime/engine.h>
+#include <rime/segmentation.h>
+#include <rime/translation.h>
+
+namespace rime {
+
+struct AsyncTranslator::State {
+  std::mutex mutex;
+  // candidates by query, most recent last.
+  list<pair<string, CandidateList>> results;
+  set<string> pending;
+  std::atomic<bool> arrived{false};
+};
+
+static string query_key(const string& input, const Segment& segment) {
+  return std::to_string(segment.start) + ":" + input;
+}
+
+AsyncTranslator::AsyncTranslator(const Ticket& ticket)
+    : Translator(ticket), state_(New<State>()) {}
+
+AsyncTranslator::~AsyncTranslator() = default;
+
+an<Translation> AsyncTranslator::Query(const string& input,
+                                       const Segment& segment) {
+  string key = query_key(input, segment);
+  {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    for (const auto& result : state_->results) {
+      if (result.first != key)
+        continue;
+      if (result.second.empty())
+        return nullptr;
+      auto translation = New<FifoTranslation>();
+      for (const auto& cand : result.second) {
+        translation->Append(cand);
+      }
+      return translation;
+    }
+    if (!state_->pending.insert(key).second)
+      return nullptr;
+  }
+  Job job = MakeJob(input, segment);
+  if (!job) {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    state_->pending.erase(key);
+    return nullptr;
+  }
+  Messenger::AsyncMessageSink notify;
+  if (engine_)
+    notify = engine_->async_message_sink();
+  std::thread([state = state_, key, job = std::move(job),
+               notify = std::move(notify), name_space = name_space_] {
+    CandidateList candidates = job();
+    {
+      std::lock_guard<std::mutex> lock(state->mutex);
+      state->pending.erase(key);
+      state->results.emplace_back(key, std::move(candidates));
+      if (state->results.size() > kMaxResults)
+        state->results.pop_front();
+      state->arrived = true;
+    }
+    if (notify)
+      notify("translation", name_space);
+  }).detach();
+  return nullptr;
+}
+
+bool AsyncTranslator::TakeArrivals() {
+  return state_->arrived.exchange(false);
+}
+
+}  // namespace rime
@@ -0,0 +1,46 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#ifndef RIME_ASYNC_TRANSLATOR_H_
+#define RIME_ASYNC_TRANSLATOR_H_
+
+#include <rime/candidate.h>
+#include <rime/common.h>
+#include <rime/translator.h>
+
+namespace rime {
+
+// A translator for slow or remote sources, whose candidates are made off
+// the input thread so that they never stall a keystroke.
+//
+// A query for new input starts a job and returns nothing at once; the other
+// translators' candidates are shown meanwhile. When the candidates arrive,
+// the frontend is sent a "translation" message, and the composition is made
+// anew with them as the context is next asked for.
+class RIME_API AsyncTranslator : public Translator {
+ public:
+  // the candidates of as many recent queries are kept.
+  static const size_t kMaxResults = 8;
+
+  explicit AsyncTranslator(const Ticket& ticket);
+  ~AsyncTranslator() override;
+
+  an<Translation> Query(const string& input, const Segment& segment) final;
+  bool TakeArrivals() final;
+
+ protected:
+  using Job = function<CandidateList()>;
+
+  // makes the job finding the candidates, to be run on a thread of its own.
+  // as the job may outlive the translator, it must not refer to it.
+  virtual Job MakeJob(const string& input, const Segment& segment) = 0;
+
+ private:
+  struct State;
+  an<State> state_;
+};
+
+}  // namespace rime
+
+#endif  // RIME_ASYNC_TRANSLATOR_H_
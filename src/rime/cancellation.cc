@@ -0,0 +1,28 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <rime/cancellation.h>
+
+namespace rime {
+
+static thread_local const Cancellation* current_cancellation = nullptr;
+
+const Cancellation* Cancellation::current() {
+  return current_cancellation;
+}
+
+bool Cancellation::Requested() {
+  return current_cancellation && current_cancellation->requested();
+}
+
+Cancellation::Activation::Activation(const Cancellation* cancellation)
+    : previous_(current_cancellation) {
+  current_cancellation = cancellation;
+}
+
+Cancellation::Activation::~Activation() {
+  current_cancellation = previous_;
+}
+
+}  // namespace rime
@@ -0,0 +1,72 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#ifndef RIME_CANCELLATION_H_
+#define RIME_CANCELLATION_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <rime_api.h>
+
+namespace rime {
+
+// Tells the work done for a session that its result is no longer wanted, as
+// a newer key event has arrived. Translation checks it at coarse points and
+// leaves out what is yet to be done; the newer key composes anew.
+class RIME_API Cancellation {
+ public:
+  Cancellation() = default;
+  Cancellation(const Cancellation&) = delete;
+  Cancellation& operator=(const Cancellation&) = delete;
+
+  // may be called from any thread; cancels the work in progress.
+  void Request() { requested_.store(true, std::memory_order_relaxed); }
+  // may be called from any thread; cancels the work begun for generations
+  // before the given one, but not that of the generation or later, which
+  // may have begun by the time of the request.
+  void RequestBefore(uint64_t generation) {
+    uint64_t cancelled = cancelled_before_.load(std::memory_order_relaxed);
+    while (cancelled < generation &&
+           !cancelled_before_.compare_exchange_weak(
+               cancelled, generation, std::memory_order_relaxed)) {
+    }
+  }
+  // begins work not cancelled by the requests made so far.
+  void Reset() { Begin(cancelled_before_.load(std::memory_order_relaxed)); }
+  // begins the work of a generation; generations are numbered in the order
+  // the work is wanted, such as by the keys posted to a session.
+  void Begin(uint64_t generation) {
+    requested_.store(false, std::memory_order_relaxed);
+    generation_.store(generation, std::memory_order_relaxed);
+  }
+  bool requested() const {
+    return requested_.load(std::memory_order_relaxed) ||
+           cancelled_before_.load(std::memory_order_relaxed) >
+               generation_.load(std::memory_order_relaxed);
+  }
+
+  // the cancellation of the work on the calling thread, or null.
+  static const Cancellation* current();
+  // whether the work on the calling thread has been cancelled.
+  static bool Requested();
+
+  // makes the cancellation current on the calling thread within its scope.
+  class Activation {
+   public:
+    explicit Activation(const Cancellation* cancellation);
+    ~Activation();
+
+   private:
+    const Cancellation* previous_;
+  };
+
+ private:
+  std::atomic<bool> requested_{false};
+  std::atomic<uint64_t> generation_{0};
+  std::atomic<uint64_t> cancelled_before_{0};
+};
+
+}  // namespace rime
+
+#endif  // RIME_CANCELLATION_H_
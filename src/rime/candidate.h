@@ -7,15 +7,22 @@
 #ifndef RIME_CANDIDATE_H_
 #define RIME_CANDIDATE_H_
 
+#include <stdint.h>
 #include <rime/common.h>
 
 namespace rime {
 
+// Candidates are made by the hundreds per keystroke; translators and filters
+// allocate them from the session arena with NewIn<>() where one is at hand,
+// which keeps each candidate and its reference count in one arena block.
 class Candidate {
  public:
   Candidate() = default;
   Candidate(const string& type, size_t start, size_t end, double quality = 0.)
-      : type_(type), start_(start), end_(end), quality_(quality) {}
+      : type_(type),
+        start_(uint32_t(start)),
+        end_(uint32_t(end)),
+        quality_(quality) {}
   virtual ~Candidate() = default;
 
   static an<Candidate> GetGenuineCandidate(const an<Candidate>& cand);
@@ -37,14 +44,15 @@ class Candidate {
   virtual string preedit() const { return string(); }
 
   void set_type(const string& type) { type_ = type; }
-  void set_start(size_t start) { start_ = start; }
-  void set_end(size_t end) { end_ = end; }
+  void set_start(size_t start) { start_ = uint32_t(start); }
+  void set_end(size_t end) { end_ = uint32_t(end); }
   void set_quality(double quality) { quality_ = quality; }
 
  private:
   string type_;
-  size_t start_ = 0;
-  size_t end_ = 0;
+  // positions in the input, which is never as long as 4 GiB.
+  uint32_t start_ = 0;
+  uint32_t end_ = 0;
   double quality_ = 0.;
 };
 
@@ -11,10 +11,40 @@
 
 namespace rime {
 
+// takes the storage of the oldest record when the history is full.
+CommitRecord& CommitHistory::NewRecord(const string& type) {
+  if (size_ == kMaxRecords) {
+    first_ = (first_ + 1) % kMaxRecords;
+  } else {
+    ++size_;
+  }
+  CommitRecord& record = back();
+  record.type = type;
+  record.text.clear();
+  return record;
+}
+
+void CommitHistory::AppendText(CommitRecord* record, const string& text) {
+  record->text += text;
+  preceding_text_ += text;
+  // keeps the last kMaxPrecedingChars code points.
+  size_t start = preceding_text_.length();
+  for (size_t count = 0; start > 0 && count < kMaxPrecedingChars;) {
+    if ((preceding_text_[--start] & 0xc0) != 0x80)
+      ++count;
+  }
+  if (start > 0)
+    preceding_text_.erase(0, start);
+}
+
 void CommitHistory::Push(const CommitRecord& record) {
-  push_back(record);
-  if (!empty() && size() > kMaxRecords)
-    pop_front();
+  AppendText(&NewRecord(record.type), record.text);
+}
+
+void CommitHistory::clear() {
+  first_ = 0;
+  size_ = 0;
+  preceding_text_.clear();
 }
 
 void CommitHistory::Push(const KeyEvent& key_event) {
@@ -36,11 +66,11 @@ void CommitHistory::Push(const Composition& composition, const string& input) {
     if (auto cand = seg.GetSelectedCandidate()) {
       if (last && last->type == cand->type()) {
         // join adjacent text of same type
-        last->text += cand->text();
+        AppendText(last, cand->text());
       } else {
         // new record
-        Push({cand->type(), cand->text()});
-        last = &back();
+        last = &NewRecord(cand->type());
+        AppendText(last, cand->text());
       }
       if (seg.status >= Segment::kConfirmed) {
         // terminate a record by confirmation
@@ -50,6 +80,7 @@ void CommitHistory::Push(const Composition& composition, const string& input) {
     } else {
       // no translation for the segment
       Push({"raw", input.substr(seg.start, seg.end - seg.start)});
+      last = NULL;
       end = seg.end;
     }
   }
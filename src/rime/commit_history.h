@@ -7,6 +7,7 @@
 #ifndef RIME_COMMIT_HISTORY_H_
 #define RIME_COMMIT_HISTORY_H_
 
+#include <iterator>
 #include <rime/common.h>
 
 namespace rime {
@@ -14,6 +15,7 @@ namespace rime {
 struct CommitRecord {
   string type;
   string text;
+  CommitRecord() = default;
   CommitRecord(const string& a_type, const string& a_text)
       : type(a_type), text(a_text) {}
   CommitRecord(int keycode) : type("thru"), text(1, keycode) {}
@@ -22,14 +24,101 @@ struct CommitRecord {
 class KeyEvent;
 class Composition;
 
-class CommitHistory : public list<CommitRecord> {
+// The latest records of committed text, kept in a ring buffer of fixed
+// capacity. Slots are reused, so the strings of an evicted record keep their
+// storage for the next one.
+class CommitHistory {
  public:
-  static const size_t kMaxRecords = 20;
+  static constexpr size_t kMaxRecords = 20;
+  // code points of committed text kept for preceding_text().
+  static constexpr size_t kMaxPrecedingChars = 8;
+
+  template <class T, class History>
+  class Iterator {
+   public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = CommitRecord;
+    using difference_type = std::ptrdiff_t;
+    using pointer = T*;
+    using reference = T&;
+
+    Iterator() = default;
+    Iterator(History* history, size_t index)
+        : history_(history), index_(index) {}
+
+    reference operator*() const { return history_->at(index_); }
+    pointer operator->() const { return &history_->at(index_); }
+    Iterator& operator++() {
+      ++index_;
+      return *this;
+    }
+    Iterator operator++(int) { return Iterator(history_, index_++); }
+    Iterator& operator--() {
+      --index_;
+      return *this;
+    }
+    Iterator operator--(int) { return Iterator(history_, index_--); }
+    bool operator==(const Iterator& other) const {
+      return index_ == other.index_;
+    }
+    bool operator!=(const Iterator& other) const {
+      return index_ != other.index_;
+    }
+
+   private:
+    History* history_ = nullptr;
+    size_t index_ = 0;
+  };
+
+  using iterator = Iterator<CommitRecord, CommitHistory>;
+  using const_iterator = Iterator<const CommitRecord, const CommitHistory>;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
   void Push(const CommitRecord& record);
   void Push(const KeyEvent& key_event);
   void Push(const Composition& composition, const string& input);
+  void clear();
   string repr() const;
   string latest_text() const { return empty() ? string() : back().text; }
+  // the last few characters committed since the history was cleared.
+  const string& preceding_text() const { return preceding_text_; }
+
+  bool empty() const { return size_ == 0; }
+  size_t size() const { return size_; }
+  // records from the oldest (0) to the latest (size() - 1).
+  CommitRecord& at(size_t index) {
+    return records_[(first_ + index) % kMaxRecords];
+  }
+  const CommitRecord& at(size_t index) const {
+    return records_[(first_ + index) % kMaxRecords];
+  }
+  CommitRecord& front() { return at(0); }
+  const CommitRecord& front() const { return at(0); }
+  CommitRecord& back() { return at(size_ - 1); }
+  const CommitRecord& back() const { return at(size_ - 1); }
+
+  iterator begin() { return iterator(this, 0); }
+  iterator end() { return iterator(this, size_); }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, size_); }
+  reverse_iterator rbegin() { return reverse_iterator(end()); }
+  reverse_iterator rend() { return reverse_iterator(begin()); }
+  const_reverse_iterator rbegin() const {
+    return const_reverse_iterator(end());
+  }
+  const_reverse_iterator rend() const {
+    return const_reverse_iterator(begin());
+  }
+
+ private:
+  CommitRecord& NewRecord(const string& type);
+  void AppendText(CommitRecord* record, const string& text);
+
+  CommitRecord records_[kMaxRecords];
+  size_t first_ = 0;
+  size_t size_ = 0;
+  string preceding_text_;
 };
 
 }  // Namespace rime
@@ -12,6 +12,8 @@
 
 namespace rime {
 
+static const SegmentTags::TagId kPhonyTag = SegmentTags::Intern("phony");
+
 bool Composition::HasFinishedComposition() const {
   if (empty())
     return false;
@@ -40,7 +42,7 @@ Preedit Composition::GetPreedit(const string& full_input,
         preedit.text += cand->text();
       } else {  // raw input
         end = at(i).end;
-        if (!at(i).HasTag("phony")) {
+        if (!at(i).HasTag(kPhonyTag)) {
           preedit.text += input_.substr(start, end - start);
         }
       }
@@ -108,7 +110,7 @@ string Composition::GetCommitText() const {
       result += cand->text();
     } else {
       end = seg.end;
-      if (!seg.HasTag("phony")) {
+      if (!seg.HasTag(kPhonyTag)) {
         result += input_.substr(seg.start, seg.end - seg.start);
       }
     }
@@ -150,7 +152,7 @@ string Composition::GetDebugText() const {
     if (!seg.tags.empty()) {
       result += "{";
       int j = 0;
-      for (const string& tag : seg.tags) {
+      for (const string& tag : seg.tags.names()) {
         if (j++ > 0)
           result += ",";
         result += tag;
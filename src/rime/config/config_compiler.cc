@@ -1,6 +1,9 @@
+#include <atomic>
 #include <boost/algorithm/string.hpp>
+#include <filesystem>
 #include <rime/common.h>
 #include <rime/resource.h>
+#include <rime/worker_pool.h>
 #include <rime/config/config_compiler.h>
 #include <rime/config/config_compiler_impl.h>
 #include <rime/config/config_data.h>
@@ -325,6 +328,76 @@ an<ConfigResource> ConfigCompiler::GetCompiledResource(
   return graph_->resources[resource_id];
 }
 
+struct ConfigCompileSession::Source {
+  path file_path;
+  std::mutex mutex;
+  bool parsed = false;
+  bool loaded = false;
+  an<ConfigItem> root;
+
+  void Parse() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (parsed)
+      return;
+    ConfigData data;
+    loaded = data.LoadFromFile(file_path, nullptr);
+    root = data.root;
+    parsed = true;
+  }
+};
+
+static std::atomic<ConfigCompileSession*> current_compile_session = nullptr;
+
+ConfigCompileSession::ConfigCompileSession()
+    : previous_(current_compile_session.exchange(this)) {}
+
+ConfigCompileSession::~ConfigCompileSession() {
+  current_compile_session = previous_;
+}
+
+ConfigCompileSession* ConfigCompileSession::current() {
+  return current_compile_session;
+}
+
+an<ConfigCompileSession::Source> ConfigCompileSession::GetSource(
+    const path& file_path) {
+  // a source file updated meanwhile is parsed again.
+  string key = file_path.u8string();
+  std::error_code ec;
+  auto file_size = std::filesystem::file_size(file_path, ec);
+  if (!ec) {
+    auto write_time = std::filesystem::last_write_time(file_path, ec);
+    key += ":" + std::to_string(file_size) + ":" +
+           std::to_string(write_time.time_since_epoch().count());
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& source = sources_[key];
+  if (!source) {
+    source = New<Source>();
+    source->file_path = file_path;
+  }
+  return source;
+}
+
+an<ConfigItem> ConfigCompileSession::Load(const path& file_path,
+                                          bool* loaded) {
+  auto source = GetSource(file_path);
+  // parses the file unless it is being parsed on a worker thread.
+  source->Parse();
+  *loaded = source->loaded;
+  return source->root;
+}
+
+void ConfigCompileSession::Prefetch(const path& file_path) {
+  auto source = GetSource(file_path);
+  {
+    std::lock_guard<std::mutex> lock(source->mutex);
+    if (source->parsed)
+      return;
+  }
+  WorkerPool::Shared().Submit([source] { source->Parse(); });
+}
+
 an<ConfigResource> ConfigCompiler::Compile(const string& file_name) {
   auto resource_id = resource_resolver_->ToResourceId(file_name);
   auto resource = New<ConfigResource>(resource_id, New<ConfigData>());
@@ -333,6 +406,25 @@ an<ConfigResource> ConfigCompiler::Compile(const string& file_name) {
   resource->loaded = resource->data->LoadFromFile(
       resource_resolver_->ResolvePath(resource_id), this);
   Pop();
+  if (auto session = ConfigCompileSession::current()) {
+    // the referenced resources are parsed while this one is linked.
+    set<string> referenced;
+    for (const auto& x : graph_->deps) {
+      if (!boost::starts_with(x.first, resource_id + ":"))
+        continue;
+      for (const auto& dependency : x.second) {
+        if (auto include = As<IncludeReference>(dependency)) {
+          referenced.insert(include->reference.resource_id);
+        } else if (auto patch = As<PatchReference>(dependency)) {
+          referenced.insert(patch->reference.resource_id);
+        }
+      }
+    }
+    for (const auto& id : referenced) {
+      if (graph_->resources.find(id) == graph_->resources.end())
+        session->Prefetch(resource_resolver_->ResolvePath(id));
+    }
+  }
   if (plugin_)
     plugin_->ReviewCompileOutput(this, resource);
   return resource;
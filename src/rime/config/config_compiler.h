@@ -5,6 +5,7 @@
 #ifndef RIME_CONFIG_COMPILER_H_
 #define RIME_CONFIG_COMPILER_H_
 
+#include <mutex>
 #include <ostream>
 #include <rime/common.h>
 #include <rime/config/config_data.h>
@@ -33,6 +34,34 @@ struct Reference {
 
 std::ostream& operator<<(std::ostream& stream, const Reference& reference);
 
+// Source files of configs, parsed once for all the configs compiled while
+// the session is open, eg. during a deployment. Files referenced by a config
+// are parsed in parallel as soon as the config is compiled.
+class ConfigCompileSession {
+ public:
+  RIME_API ConfigCompileSession();
+  RIME_API ~ConfigCompileSession();
+  ConfigCompileSession(const ConfigCompileSession&) = delete;
+  ConfigCompileSession& operator=(const ConfigCompileSession&) = delete;
+
+  // the session open, if any.
+  static ConfigCompileSession* current();
+
+  // the parsed tree of the source file, which is not to be modified.
+  an<ConfigItem> Load(const path& file_path, bool* loaded);
+  // starts parsing the source file on a worker thread.
+  void Prefetch(const path& file_path);
+
+ private:
+  struct Source;
+  an<Source> GetSource(const path& file_path);
+
+  ConfigCompileSession* previous_;
+  std::mutex mutex_;
+  // by file path, size and modified time.
+  map<string, an<Source>> sources_;
+};
+
 class ConfigCompilerPlugin;
 class ResourceResolver;
 struct Dependency;
@@ -93,6 +93,38 @@ size_t Config::GetListSize(const string& path) {
   return list ? list->size() : 0;
 }
 
+bool Config::GetBool(const ConfigPath& path, bool* value) {
+  auto p = As<ConfigValue>(data_->Traverse(path));
+  return p && p->GetBool(value);
+}
+
+bool Config::GetInt(const ConfigPath& path, int* value) {
+  auto p = As<ConfigValue>(data_->Traverse(path));
+  return p && p->GetInt(value);
+}
+
+bool Config::GetDouble(const ConfigPath& path, double* value) {
+  auto p = As<ConfigValue>(data_->Traverse(path));
+  return p && p->GetDouble(value);
+}
+
+bool Config::GetString(const ConfigPath& path, string* value) {
+  auto p = As<ConfigValue>(data_->Traverse(path));
+  return p && p->GetString(value);
+}
+
+an<ConfigItem> Config::GetItem(const ConfigPath& path) {
+  return data_->Traverse(path);
+}
+
+an<ConfigList> Config::GetList(const ConfigPath& path) {
+  return As<ConfigList>(data_->Traverse(path));
+}
+
+an<ConfigMap> Config::GetMap(const ConfigPath& path) {
+  return As<ConfigMap>(data_->Traverse(path));
+}
+
 an<ConfigItem> Config::GetItem(const string& path) {
   DLOG(INFO) << "read: " << path;
   return data_->Traverse(path);
@@ -138,12 +170,11 @@ bool Config::SetItem(const string& path, an<ConfigItem> item) {
 }
 
 an<ConfigItem> Config::GetItem() const {
-  return data_->root;
+  return std::atomic_load(&data_->root);
 }
 
 void Config::SetItem(an<ConfigItem> item) {
-  data_->root = item;
-  set_modified();
+  data_->TraverseWrite("", item);
 }
 
 const ResourceType ConfigResourceProvider::kDefaultResourceType = {"config", "",
@@ -181,15 +212,29 @@ Config* ConfigComponentBase::Create(const string& file_name) {
 
 an<ConfigData> ConfigComponentBase::GetConfigData(const string& file_name) {
   auto config_id = resource_resolver_->ToResourceId(file_name);
+  // while sessions are served the previous build, the configs being
+  // deployed are not shared with them.
+  if (Service::instance().deployer().serving_previous_build() &&
+      FallbackResourceResolver::deploying()) {
+    return LoadConfig(config_id);
+  }
+  {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    // obtain the shared copy
+    if (auto data = cache_[config_id].lock())
+      return data;
+  }
+  // create a new copy and load it; configs are built in parallel during
+  // deployment, so the lock is not held while loading.
+  auto data = LoadConfig(config_id);
+  std::lock_guard<std::mutex> lock(cache_mutex_);
   // keep a weak reference to the shared config data in the component
   weak<ConfigData>& wp(cache_[config_id]);
-  if (wp.expired()) {  // create a new copy and load it
-    auto data = LoadConfig(config_id);
-    wp = data;
-    return data;
+  if (auto loaded = wp.lock()) {  // loaded by another thread meanwhile
+    return loaded;
   }
-  // obtain the shared copy
-  return wp.lock();
+  wp = data;
+  return data;
 }
 
 an<ConfigData> ConfigLoader::LoadConfig(ResourceResolver* resource_resolver,
@@ -197,6 +242,8 @@ an<ConfigData> ConfigLoader::LoadConfig(ResourceResolver* resource_resolver,
   auto data = New<ConfigData>();
   data->LoadFromFile(resource_resolver->ResolvePath(config_id), nullptr);
   data->set_auto_save(auto_save_);
+  // loaded configs are shared by sessions and mostly read from.
+  data->set_cache_traversal(true);
   return data;
 }
 
@@ -8,6 +8,7 @@
 #define RIME_CONFIG_COMPONENT_H_
 
 #include <iostream>
+#include <mutex>
 #include <type_traits>
 #include <rime/common.h>
 #include <rime/component.h>
@@ -45,6 +46,14 @@ class Config : public Class<Config, const string&>, public ConfigItemRef {
   RIME_API bool GetDouble(const string& path, double* value);
   RIME_API bool GetString(const string& path, string* value);
   RIME_API size_t GetListSize(const string& path);
+  // the same, with paths split beforehand.
+  RIME_API bool GetBool(const ConfigPath& path, bool* value);
+  RIME_API bool GetInt(const ConfigPath& path, int* value);
+  RIME_API bool GetDouble(const ConfigPath& path, double* value);
+  RIME_API bool GetString(const ConfigPath& path, string* value);
+  RIME_API an<ConfigItem> GetItem(const ConfigPath& path);
+  RIME_API an<ConfigList> GetList(const ConfigPath& path);
+  RIME_API an<ConfigMap> GetMap(const ConfigPath& path);
 
   an<ConfigItem> GetItem(const string& path);
   an<ConfigValue> GetValue(const string& path);
@@ -102,6 +111,7 @@ class ConfigComponentBase : public Config::Component {
 
  private:
   an<ConfigData> GetConfigData(const string& file_name);
+  std::mutex cache_mutex_;
   map<string, weak<ConfigData>> cache_;
 };
 
@@ -4,11 +4,13 @@
 //
 #include <cctype>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <sstream>
 #include <boost/algorithm/string.hpp>
 #include <filesystem>
 #include <yaml-cpp/yaml.h>
+#include <rime/arena.h>
 #include <rime/config/config_compiler.h>
 #include <rime/config/config_cow_ref.h>
 #include <rime/config/config_data.h>
@@ -18,19 +20,45 @@ namespace rime {
 
 an<ConfigItem> ConvertFromYaml(const YAML::Node& yaml_node,
                                ConfigCompiler* compiler);
+an<ConfigItem> ConvertFromSource(const an<ConfigItem>& source,
+                                 ConfigCompiler* compiler);
 
 void EmitYaml(an<ConfigItem> node, YAML::Emitter* emitter, int depth);
 
+static const char kBinaryFormat[] = "Rime::Config/1.0";
+static const size_t kBinaryFormatLength = sizeof(kBinaryFormat);
+
+void EncodeBinary(an<ConfigItem> node, string* out);
+an<ConfigItem> DecodeBinary(const char** cursor,
+                            const char* end,
+                            int depth,
+                            const an<Arena>& arena);
+
 ConfigData::~ConfigData() {
   if (auto_save_)
     Save();
 }
 
 bool ConfigData::Save() {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
   return modified_ && !file_path_.empty() && SaveToFile(file_path_);
 }
 
+void ConfigData::set_modified() {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  modified_ = true;
+  traversed_.clear();
+}
+
+void ConfigData::set_cache_traversal(bool cache_traversal) {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  cache_traversal_ = cache_traversal;
+  traversed_.clear();
+}
+
 bool ConfigData::LoadFromStream(std::istream& stream) {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  traversed_.clear();
   if (!stream.good()) {
     LOG(ERROR) << "failed to load config from stream.";
     return false;
@@ -46,6 +74,7 @@ bool ConfigData::LoadFromStream(std::istream& stream) {
 }
 
 bool ConfigData::SaveToStream(std::ostream& stream) {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
   if (!stream.good()) {
     LOG(ERROR) << "failed to save config to stream.";
     return false;
@@ -61,15 +90,35 @@ bool ConfigData::SaveToStream(std::ostream& stream) {
 }
 
 bool ConfigData::LoadFromFile(const path& file_path, ConfigCompiler* compiler) {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
   // update status
   file_path_ = file_path;
   modified_ = false;
   root.reset();
+  traversed_.clear();
   if (!std::filesystem::exists(file_path)) {
     if (!boost::ends_with(file_path.u8string(), ".custom.yaml"))
       LOG(WARNING) << "nonexistent config file '" << file_path << "'.";
     return false;
   }
+  if (!compiler) {
+    auto binary_file_path = BinaryFilePath(file_path);
+    if (std::filesystem::exists(binary_file_path) &&
+        LoadFromBinaryFile(binary_file_path, file_path)) {
+      file_path_ = file_path;
+      return true;
+    }
+  }
+  if (compiler) {
+    if (auto session = ConfigCompileSession::current()) {
+      bool loaded = false;
+      auto source = session->Load(file_path, &loaded);
+      if (!loaded)
+        return false;
+      root = ConvertFromSource(source, compiler);
+      return true;
+    }
+  }
   LOG(INFO) << "loading config file '" << file_path << "'.";
   try {
     YAML::Node doc = YAML::LoadFile(file_path.string());
@@ -82,6 +131,7 @@ bool ConfigData::LoadFromFile(const path& file_path, ConfigCompiler* compiler) {
 }
 
 bool ConfigData::SaveToFile(const path& file_path) {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
   // update status
   file_path_ = file_path;
   modified_ = false;
@@ -95,6 +145,90 @@ bool ConfigData::SaveToFile(const path& file_path) {
   return SaveToStream(out);
 }
 
+path ConfigData::BinaryFilePath(const path& file_path) {
+  return path(file_path).replace_extension(".bin");
+}
+
+// the binary file is valid as long as the source file is unchanged.
+static bool GetSourceFileStatus(const path& source_path,
+                                uint64_t* size,
+                                int64_t* mtime) {
+  std::error_code ec;
+  auto file_size = std::filesystem::file_size(source_path, ec);
+  if (ec)
+    return false;
+  auto write_time = std::filesystem::last_write_time(source_path, ec);
+  if (ec)
+    return false;
+  *size = file_size;
+  *mtime = write_time.time_since_epoch().count();
+  return true;
+}
+
+bool ConfigData::LoadFromBinaryFile(const path& file_path,
+                                    const path& source_path) {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  uint64_t source_size = 0;
+  int64_t source_mtime = 0;
+  if (!GetSourceFileStatus(source_path, &source_size, &source_mtime))
+    return false;
+  std::ifstream in(file_path.c_str(), std::ios::binary);
+  string buffer((std::istreambuf_iterator<char>(in)),
+                std::istreambuf_iterator<char>());
+  const size_t header_size =
+      kBinaryFormatLength + sizeof(source_size) + sizeof(source_mtime);
+  if (buffer.size() < header_size ||
+      buffer.compare(0, kBinaryFormatLength, kBinaryFormat,
+                     kBinaryFormatLength) != 0) {
+    LOG(WARNING) << "invalid binary config file '" << file_path << "'.";
+    return false;
+  }
+  const char* cursor = buffer.data() + kBinaryFormatLength;
+  const char* end = buffer.data() + buffer.size();
+  if (std::memcmp(cursor, &source_size, sizeof(source_size)) != 0 ||
+      std::memcmp(cursor + sizeof(source_size), &source_mtime,
+                  sizeof(source_mtime)) != 0) {
+    LOG(INFO) << "outdated binary config file '" << file_path << "'.";
+    return false;
+  }
+  cursor += sizeof(source_size) + sizeof(source_mtime);
+  LOG(INFO) << "loading binary config file '" << file_path << "'.";
+  // the nodes of a deployed config are packed in an arena, which they keep
+  // alive; nodes written to are copied out of it.
+  auto item = DecodeBinary(&cursor, end, 0, New<Arena>());
+  if (!cursor || cursor != end) {
+    LOG(ERROR) << "corrupt binary config file '" << file_path << "'.";
+    return false;
+  }
+  root = item;
+  modified_ = false;
+  traversed_.clear();
+  return true;
+}
+
+bool ConfigData::SaveToBinaryFile(const path& file_path,
+                                  const path& source_path) {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  uint64_t source_size = 0;
+  int64_t source_mtime = 0;
+  if (!GetSourceFileStatus(source_path, &source_size, &source_mtime))
+    return false;
+  string buffer(kBinaryFormat, kBinaryFormatLength);
+  buffer.append(reinterpret_cast<const char*>(&source_size),
+                sizeof(source_size));
+  buffer.append(reinterpret_cast<const char*>(&source_mtime),
+                sizeof(source_mtime));
+  EncodeBinary(root, &buffer);
+  std::ofstream out(file_path.c_str(), std::ios::binary | std::ios::trunc);
+  out.write(buffer.data(), buffer.size());
+  out.close();
+  if (!out) {
+    LOG(ERROR) << "error saving binary config file '" << file_path << "'.";
+    return false;
+  }
+  return true;
+}
+
 bool ConfigData::IsListItemReference(const string& key) {
   return key.length() > 1 && key[0] == '@' && std::isalnum(key[1]);
 }
@@ -155,8 +289,13 @@ size_t ConfigData::ResolveListIndex(an<ConfigItem> item,
 class ConfigDataRootRef : public ConfigItemRef {
  public:
   ConfigDataRootRef(ConfigData* data) : ConfigItemRef(nullptr), data_(data) {}
-  an<ConfigItem> GetItem() const override { return data_->root; }
-  void SetItem(an<ConfigItem> item) override { data_->root = item; }
+  an<ConfigItem> GetItem() const override {
+    return std::atomic_load(&data_->root);
+  }
+  // swaps in the new root, which Config::GetItem() reads without the lock.
+  void SetItem(an<ConfigItem> item) override {
+    std::atomic_store(&data_->root, item);
+  }
 
  private:
   ConfigData* data_;
@@ -198,8 +337,14 @@ an<ConfigItemRef> TraverseCopyOnWrite(an<ConfigItemRef> head,
   return head;
 }
 
+// the nodes on the path are copied rather than changed, so the items
+// returned by Traverse() before stay as they were, for the readers using
+// them without the lock.
 bool ConfigData::TraverseWrite(const string& node_path, an<ConfigItem> item) {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
   LOG(INFO) << "write: " << node_path;
+  // nodes may be created on the way even if the write fails.
+  traversed_.clear();
   auto root = New<ConfigDataRootRef>(this);
   if (auto target = TraverseCopyOnWrite(root, node_path)) {
     *target = item;
@@ -222,12 +367,35 @@ string ConfigData::JoinPath(const vector<string>& keys) {
   return boost::join(keys, "/");
 }
 
+ConfigPath::ConfigPath(const string& path)
+    : path_(path), keys_(ConfigData::SplitPath(path)) {}
+
 an<ConfigItem> ConfigData::Traverse(const string& node_path) {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  if (cache_traversal_) {
+    auto found = traversed_.find(node_path);
+    if (found != traversed_.end())
+      return found->second;
+  }
+  return Traverse(node_path, SplitPath(node_path));
+}
+
+an<ConfigItem> ConfigData::Traverse(const ConfigPath& node_path) {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  if (cache_traversal_) {
+    auto found = traversed_.find(node_path.str());
+    if (found != traversed_.end())
+      return found->second;
+  }
+  return Traverse(node_path.str(), node_path.keys());
+}
+
+an<ConfigItem> ConfigData::Traverse(const string& node_path,
+                                    const vector<string>& keys) {
   DLOG(INFO) << "traverse: " << node_path;
   if (node_path.empty() || node_path == "/") {
     return root;
   }
-  vector<string> keys = SplitPath(node_path);
   // find the YAML::Node, and wrap it!
   an<ConfigItem> p = root;
   for (auto it = keys.begin(), end = keys.end(); it != end; ++it) {
@@ -238,7 +406,8 @@ an<ConfigItem> ConfigData::Traverse(const string& node_path) {
       list_index = ResolveListIndex(p, *it, true);
     }
     if (!p || p->type() != node_type) {
-      return nullptr;
+      p = nullptr;
+      break;
     }
     if (node_type == ConfigItem::kList) {
       p = As<ConfigList>(p)->GetAt(list_index);
@@ -246,6 +415,10 @@ an<ConfigItem> ConfigData::Traverse(const string& node_path) {
       p = As<ConfigMap>(p)->Get(*it);
     }
   }
+  // list items are referred to by position, which changes with the list.
+  if (cache_traversal_ && node_path.find('@') == string::npos) {
+    traversed_[node_path] = p;
+  }
   return p;
 }
 
@@ -289,6 +462,155 @@ an<ConfigItem> ConvertFromYaml(const YAML::Node& node,
   return nullptr;
 }
 
+// a node is encoded as its type, followed by the size of a scalar, list or
+// map, and then the string, list elements or pairs of key and value.
+static void EncodeSize(size_t size, string* out) {
+  uint32_t n = static_cast<uint32_t>(size);
+  out->append(reinterpret_cast<const char*>(&n), sizeof(n));
+}
+
+static void EncodeString(const string& str, string* out) {
+  EncodeSize(str.size(), out);
+  out->append(str);
+}
+
+void EncodeBinary(an<ConfigItem> node, string* out) {
+  auto type = node ? node->type() : ConfigItem::kNull;
+  if (type == ConfigItem::kMap) {
+    auto map = As<ConfigMap>(node);
+    // null values are left out, as in YAML.
+    size_t size = 0;
+    for (auto it = map->begin(), end = map->end(); it != end; ++it) {
+      if (it->second && it->second->type() != ConfigItem::kNull)
+        ++size;
+    }
+    out->push_back(static_cast<char>(type));
+    EncodeSize(size, out);
+    for (auto it = map->begin(), end = map->end(); it != end; ++it) {
+      if (!it->second || it->second->type() == ConfigItem::kNull)
+        continue;
+      EncodeString(it->first, out);
+      EncodeBinary(it->second, out);
+    }
+  } else if (type == ConfigItem::kList) {
+    auto list = As<ConfigList>(node);
+    out->push_back(static_cast<char>(type));
+    EncodeSize(list->size(), out);
+    for (auto it = list->begin(), end = list->end(); it != end; ++it) {
+      EncodeBinary(*it, out);
+    }
+  } else if (type == ConfigItem::kScalar) {
+    out->push_back(static_cast<char>(type));
+    EncodeString(As<ConfigValue>(node)->str(), out);
+  } else {
+    out->push_back(static_cast<char>(ConfigItem::kNull));
+  }
+}
+
+static bool DecodeSize(const char** cursor, const char* end, size_t* size) {
+  uint32_t n = 0;
+  if (end - *cursor < static_cast<ptrdiff_t>(sizeof(n)))
+    return false;
+  std::memcpy(&n, *cursor, sizeof(n));
+  *cursor += sizeof(n);
+  *size = n;
+  return true;
+}
+
+static bool DecodeString(const char** cursor, const char* end, string* str) {
+  size_t size = 0;
+  if (!DecodeSize(cursor, end, &size) ||
+      static_cast<size_t>(end - *cursor) < size)
+    return false;
+  str->assign(*cursor, size);
+  *cursor += size;
+  return true;
+}
+
+// sets *cursor to nullptr on error.
+an<ConfigItem> DecodeBinary(const char** cursor,
+                            const char* end,
+                            int depth,
+                            const an<Arena>& arena) {
+  const int kMaxDepth = 256;
+  if (!*cursor || *cursor == end || depth > kMaxDepth) {
+    *cursor = nullptr;
+    return nullptr;
+  }
+  auto type = static_cast<ConfigItem::ValueType>(*(*cursor)++);
+  size_t size = 0;
+  if (type == ConfigItem::kNull) {
+    return nullptr;
+  } else if (type == ConfigItem::kScalar) {
+    string value;
+    if (DecodeString(cursor, end, &value))
+      return NewIn<ConfigValue>(arena, value);
+  } else if (type == ConfigItem::kList) {
+    if (DecodeSize(cursor, end, &size)) {
+      auto list = NewIn<ConfigList>(arena);
+      list->Reserve(size);
+      for (size_t i = 0; i < size && *cursor; ++i) {
+        list->Append(DecodeBinary(cursor, end, depth + 1, arena));
+      }
+      if (*cursor)
+        return list;
+      return nullptr;
+    }
+  } else if (type == ConfigItem::kMap) {
+    if (DecodeSize(cursor, end, &size)) {
+      auto map = NewIn<ConfigMap>(arena);
+      map->Reserve(size);
+      string key;
+      for (size_t i = 0; i < size && *cursor; ++i) {
+        if (!DecodeString(cursor, end, &key)) {
+          *cursor = nullptr;
+          return nullptr;
+        }
+        map->Set(key, DecodeBinary(cursor, end, depth + 1, arena));
+      }
+      if (*cursor)
+        return map;
+      return nullptr;
+    }
+  }
+  *cursor = nullptr;
+  return nullptr;
+}
+
+// copies a parsed tree shared by configs in a compile session, for the
+// compiler to take directives out and modify the copy.
+an<ConfigItem> ConvertFromSource(const an<ConfigItem>& node,
+                                 ConfigCompiler* compiler) {
+  if (!node || node->type() == ConfigItem::kNull) {
+    return nullptr;
+  }
+  if (auto value = As<ConfigValue>(node)) {
+    return New<ConfigValue>(value->str());
+  }
+  if (auto list = As<ConfigList>(node)) {
+    auto config_list = New<ConfigList>();
+    for (auto it = list->begin(), end = list->end(); it != end; ++it) {
+      compiler->Push(config_list, config_list->size());
+      config_list->Append(ConvertFromSource(*it, compiler));
+      compiler->Pop();
+    }
+    return config_list;
+  }
+  if (auto map = As<ConfigMap>(node)) {
+    auto config_map = New<ConfigMap>();
+    for (auto it = map->begin(), end = map->end(); it != end; ++it) {
+      compiler->Push(config_map, it->first);
+      auto value = ConvertFromSource(it->second, compiler);
+      compiler->Pop();
+      if (!compiler->Parse(it->first, value)) {
+        config_map->Set(it->first, value);
+      }
+    }
+    return config_map;
+  }
+  return nullptr;
+}
+
 void EmitScalar(const string& str_value, YAML::Emitter* emitter) {
   if (str_value.find_first_of("\r\n") != string::npos) {
     *emitter << YAML::Literal;
@@ -7,12 +7,14 @@
 #define RIME_CONFIG_DATA_H_
 
 #include <iostream>
+#include <mutex>
 #include <rime/common.h>
 
 namespace rime {
 
 class ConfigCompiler;
 class ConfigItem;
+class ConfigPath;
 
 class ConfigData {
  public:
@@ -25,8 +27,16 @@ class ConfigData {
   bool SaveToStream(std::ostream& stream);
   bool LoadFromFile(const path& file_path, ConfigCompiler* compiler);
   bool SaveToFile(const path& file_path);
+  // a compiled config is also saved in binary, which is much faster to load
+  // than YAML; it is used in place of the YAML file it was saved with.
+  bool LoadFromBinaryFile(const path& file_path, const path& source_path);
+  bool SaveToBinaryFile(const path& file_path, const path& source_path);
+  static path BinaryFilePath(const path& file_path);
+  // copies the nodes down to the one written, leaving those in use intact.
   bool TraverseWrite(const string& path, an<ConfigItem> item);
+  // the item returned is a snapshot, never changed by TraverseWrite().
   an<ConfigItem> Traverse(const string& path);
+  an<ConfigItem> Traverse(const ConfigPath& path);
 
   static vector<string> SplitPath(const string& path);
   static string JoinPath(const vector<string>& keys);
@@ -38,15 +48,25 @@ class ConfigData {
 
   const path& file_path() const { return file_path_; }
   bool modified() const { return modified_; }
-  void set_modified() { modified_ = true; }
+  void set_modified();
   void set_auto_save(bool auto_save) { auto_save_ = auto_save; }
+  // remembers the nodes found by path, until the data is written to.
+  // nodes are to be modified through ConfigData for the cache to be cleared.
+  void set_cache_traversal(bool cache_traversal);
 
   an<ConfigItem> root;
 
  protected:
+  an<ConfigItem> Traverse(const string& path, const vector<string>& keys);
+
   path file_path_;
   bool modified_ = false;
   bool auto_save_ = false;
+  bool cache_traversal_ = false;
+  hash_map<string, an<ConfigItem>> traversed_;
+  // the data is shared by configs in sessions on different threads;
+  // the user config is written to as well.
+  std::recursive_mutex mutex_;
 };
 
 }  // namespace rime
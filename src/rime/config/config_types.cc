@@ -184,7 +184,12 @@ an<ConfigValue> ConfigMap::GetValue(const string& key) const {
 }
 
 bool ConfigMap::Set(const string& key, an<ConfigItem> element) {
-  map_[key] = element;
+  // keys set in order, as they are loaded, are appended.
+  auto it = map_.lower_bound(key);
+  if (it != map_.end() && it->first == key)
+    it->second = std::move(element);
+  else
+    map_.emplace_hint(it, key, std::move(element));
   return true;
 }
 
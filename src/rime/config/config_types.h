@@ -8,6 +8,7 @@
 #define RIME_CONFIG_TYPES_H_
 
 #include <type_traits>
+#include <boost/container/flat_map.hpp>
 #include <rime_api.h>
 #include <rime/common.h>
 
@@ -73,6 +74,7 @@ class ConfigList : public ConfigItem {
   bool Resize(size_t size);
   RIME_API bool Clear();
   RIME_API size_t size() const;
+  void Reserve(size_t size) { seq_.reserve(size); }
 
   Iterator begin();
   Iterator end();
@@ -84,9 +86,11 @@ class ConfigList : public ConfigItem {
 };
 
 // limitation: map keys have to be strings, preferably alphanumeric
+// the entries are kept in a vector sorted by key, which takes one allocation
+// per map rather than one per key; maps are mostly read once loaded.
 class ConfigMap : public ConfigItem {
  public:
-  using Map = map<string, an<ConfigItem>>;
+  using Map = boost::container::flat_map<string, an<ConfigItem>>;
   using Iterator = Map::iterator;
 
   ConfigMap() : ConfigItem(kMap) {}
@@ -95,6 +99,7 @@ class ConfigMap : public ConfigItem {
   RIME_API an<ConfigValue> GetValue(const string& key) const;
   RIME_API bool Set(const string& key, an<ConfigItem> element);
   bool Clear();
+  void Reserve(size_t size) { map_.reserve(size); }
 
   Iterator begin();
   Iterator end();
@@ -119,6 +124,19 @@ an<ConfigItem> AsConfigItem(const T& x, const std::true_type&) {
 
 }  // namespace
 
+// a "path/to/node" split into keys once, to read the node repeatedly.
+class ConfigPath {
+ public:
+  RIME_API explicit ConfigPath(const string& path);
+
+  const string& str() const { return path_; }
+  const vector<string>& keys() const { return keys_; }
+
+ private:
+  string path_;
+  vector<string> keys_;
+};
+
 class ConfigData;
 class ConfigListEntryRef;
 class ConfigMapEntryRef;
@@ -134,6 +152,9 @@ class ConfigItemRef {
     SetItem(AsConfigItem(x, std::is_convertible<T, an<ConfigItem>>()));
     return *this;
   }
+  // entries are written to in place, which suits configs being built;
+  // config data shared with other threads is written by path, through
+  // Config::SetItem() and the like, which copy the nodes on write.
   ConfigListEntryRef operator[](size_t index);
   ConfigMapEntryRef operator[](const string& key);
 
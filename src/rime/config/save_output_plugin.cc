@@ -5,6 +5,7 @@
 #include <rime/resource.h>
 #include <rime/service.h>
 #include <rime/config/config_compiler.h>
+#include <rime/config/config_data.h>
 #include <rime/config/config_types.h>
 #include <rime/config/plugins.h>
 
@@ -26,7 +27,12 @@ bool SaveOutputPlugin::ReviewCompileOutput(ConfigCompiler* compiler,
 bool SaveOutputPlugin::ReviewLinkOutput(ConfigCompiler* compiler,
                                         an<ConfigResource> resource) {
   auto file_path = resource_resolver_->ResolvePath(resource->resource_id);
-  return resource->data->SaveToFile(file_path);
+  if (!resource->data->SaveToFile(file_path))
+    return false;
+  // the YAML file still works without the binary one.
+  resource->data->SaveToBinaryFile(ConfigData::BinaryFilePath(file_path),
+                                   file_path);
+  return true;
 }
 
 }  // namespace rime
@@ -6,6 +6,7 @@
 //
 #include <algorithm>
 #include <utility>
+#include <rime/arena.h>
 #include <rime/candidate.h>
 #include <rime/context.h>
 #include <rime/menu.h>
@@ -13,12 +14,14 @@
 
 namespace rime {
 
-const string kSelectedBeforeEditing = "selected_before_editing";
+static const SegmentTags::TagId kSelectedBeforeEditing =
+    SegmentTags::Intern("selected_before_editing");
 
 bool Context::Commit() {
   if (!IsComposing())
     return false;
   // notify the engine and interesting components
+  ++revision_;
   commit_notifier_(this);
   // start over
   Clear();
@@ -26,12 +29,14 @@ bool Context::Commit() {
 }
 
 string Context::GetCommitText() const {
+  ComposePending();
   if (get_option("dumb"))
     return string();
   return composition_.GetCommitText();
 }
 
 string Context::GetScriptText() const {
+  ComposePending();
   return composition_.GetScriptText();
 }
 
@@ -42,14 +47,19 @@ string Context::GetSoftCursor() const {
 }
 
 Preedit Context::GetPreedit() const {
+  ComposePending();
   return composition_.GetPreedit(input_, caret_pos_, GetSoftCursor());
 }
 
 bool Context::IsComposing() const {
-  return !input_.empty() || !composition_.empty();
+  if (!input_.empty())
+    return true;
+  ComposePending();
+  return !composition_.empty();
 }
 
 bool Context::HasMenu() const {
+  ComposePending();
   if (composition_.empty())
     return false;
   const auto& menu(composition_.back().menu);
@@ -57,6 +67,7 @@ bool Context::HasMenu() const {
 }
 
 an<Candidate> Context::GetSelectedCandidate() const {
+  ComposePending();
   if (composition_.empty())
     return nullptr;
   return composition_.back().GetSelectedCandidate();
@@ -70,6 +81,7 @@ bool Context::PushInput(char ch) {
     input_.insert(caret_pos_, 1, ch);
     ++caret_pos_;
   }
+  ++revision_;
   update_notifier_(this);
   return true;
 }
@@ -82,6 +94,7 @@ bool Context::PushInput(const string& str) {
     input_.insert(caret_pos_, str);
     caret_pos_ += str.length();
   }
+  ++revision_;
   update_notifier_(this);
   return true;
 }
@@ -91,6 +104,7 @@ bool Context::PopInput(size_t len) {
     return false;
   caret_pos_ -= len;
   input_.erase(caret_pos_, len);
+  ++revision_;
   update_notifier_(this);
   return true;
 }
@@ -99,6 +113,7 @@ bool Context::DeleteInput(size_t len) {
   if (caret_pos_ + len > input_.length())
     return false;
   input_.erase(caret_pos_, len);
+  ++revision_;
   update_notifier_(this);
   return true;
 }
@@ -107,10 +122,34 @@ void Context::Clear() {
   input_.clear();
   caret_pos_ = 0;
   composition_.clear();
+  pending_compose_ = nullptr;
+  arena_.reset();
+  shared_results_.clear();
+  ++revision_;
   update_notifier_(this);
 }
 
+const an<Arena>& Context::arena() {
+  // objects left over from earlier keystrokes are not reclaimed until the
+  // composition is cleared; start over if a long composition piles up.
+  const size_t kMaxArenaCapacity = 4 * 1024 * 1024;
+  if (!arena_ || arena_->capacity() > kMaxArenaCapacity) {
+    arena_ = New<Arena>();
+    shared_results_.clear();
+  }
+  return arena_;
+}
+
+size_t Context::arena_capacity() const {
+  return arena_ ? arena_->capacity() : 0;
+}
+
+an<void>& Context::shared_results(const string& kind) {
+  return shared_results_[kind];
+}
+
 bool Context::Select(size_t index) {
+  ComposePending();
   if (composition_.empty())
     return false;
   Segment& seg(composition_.back());
@@ -118,6 +157,7 @@ bool Context::Select(size_t index) {
     seg.selected_index = index;
     seg.status = Segment::kSelected;
     DLOG(INFO) << "Selected: '" << cand->text() << "', index = " << index;
+    ++revision_;
     select_notifier_(this);
     return true;
   }
@@ -125,6 +165,7 @@ bool Context::Select(size_t index) {
 }
 
 bool Context::Highlight(size_t index) {
+  ComposePending();
   if (composition_.empty() || !composition_.back().menu)
     return false;
   Segment& seg(composition_.back());
@@ -137,6 +178,7 @@ bool Context::Highlight(size_t index) {
     return false;
   }
   seg.selected_index = new_index;
+  ++revision_;
   update_notifier_(this);
   DLOG(INFO) << "selection changed from: " << previous_index
              << " to: " << new_index;
@@ -144,16 +186,19 @@ bool Context::Highlight(size_t index) {
 }
 
 bool Context::DeleteCandidate(size_t index) {
+  ComposePending();
   if (composition_.empty())
     return false;
   Segment& seg(composition_.back());
   seg.selected_index = index;
   DLOG(INFO) << "Deleting candidate: " << seg.GetSelectedCandidate()->text();
+  ++revision_;
   delete_notifier_(this);
   return true;  // CAVEAT: this doesn't mean anything is deleted for sure
 }
 
 bool Context::DeleteCurrentSelection() {
+  ComposePending();
   if (composition_.empty())
     return false;
   Segment& seg(composition_.back());
@@ -161,6 +206,7 @@ bool Context::DeleteCurrentSelection() {
 }
 
 bool Context::ConfirmCurrentSelection() {
+  ComposePending();
   if (composition_.empty())
     return false;
   Segment& seg(composition_.back());
@@ -175,17 +221,20 @@ bool Context::ConfirmCurrentSelection() {
     }
     // confirm raw input
   }
+  ++revision_;
   select_notifier_(this);
   return true;
 }
 
 void Context::BeginEditing() {
+  ComposePending();
+  ++revision_;
   for (auto it = composition_.rbegin(); it != composition_.rend(); ++it) {
     if (it->status > Segment::kSelected) {
       return;
     }
     if (it->status == Segment::kSelected) {
-      it->tags.insert(kSelectedBeforeEditing);
+      it->tags.Add(kSelectedBeforeEditing);
       return;
     }
   }
@@ -197,11 +246,13 @@ bool Context::ConfirmPreviousSelection() {
 }
 
 bool Context::ReopenPreviousSegment() {
+  ComposePending();
   if (composition_.Trim()) {
     if (!composition_.empty() &&
         composition_.back().status >= Segment::kSelected) {
       composition_.back().Reopen(caret_pos());
     }
+    ++revision_;
     update_notifier_(this);
     return true;
   }
@@ -209,6 +260,7 @@ bool Context::ReopenPreviousSegment() {
 }
 
 bool Context::ClearPreviousSegment() {
+  ComposePending();
   if (composition_.empty())
     return false;
   size_t where = composition_.back().start;
@@ -219,18 +271,20 @@ bool Context::ClearPreviousSegment() {
 }
 
 bool Context::ReopenPreviousSelection() {
+  ComposePending();
   for (auto it = composition_.rbegin(); it != composition_.rend(); ++it) {
     if (it->status > Segment::kSelected)
       return false;
     if (it->status == Segment::kSelected) {
       // do not reopen the previous selection after editing input.
-      if (it->tags.count(kSelectedBeforeEditing) != 0) {
+      if (it->HasTag(kSelectedBeforeEditing)) {
         return false;
       }
       while (it != composition_.rbegin()) {
         composition_.pop_back();
       }
       it->Reopen(caret_pos());
+      ++revision_;
       update_notifier_(this);
       return true;
     }
@@ -239,6 +293,8 @@ bool Context::ReopenPreviousSelection() {
 }
 
 bool Context::ClearNonConfirmedComposition() {
+  ComposePending();
+  ++revision_;
   bool reverted = false;
   while (!composition_.empty() &&
          composition_.back().status < Segment::kSelected) {
@@ -254,6 +310,7 @@ bool Context::ClearNonConfirmedComposition() {
 
 bool Context::RefreshNonConfirmedComposition() {
   if (ClearNonConfirmedComposition()) {
+    ++revision_;
     update_notifier_(this);
     return true;
   }
@@ -265,22 +322,67 @@ void Context::set_caret_pos(size_t caret_pos) {
     caret_pos_ = input_.length();
   else
     caret_pos_ = caret_pos;
+  ++revision_;
   update_notifier_(this);
 }
 
 void Context::set_composition(Composition&& comp) {
+  pending_compose_ = nullptr;
+  ++revision_;
   composition_ = std::move(comp);
 }
 
+void Context::DeferCompose(function<void(Context* ctx)> compose) {
+  pending_compose_ = std::move(compose);
+}
+
+void Context::ComposePending() const {
+  if (!pending_compose_)
+    return;
+  auto compose = std::move(pending_compose_);
+  pending_compose_ = nullptr;
+  compose(const_cast<Context*>(this));
+}
+
+void Context::Hibernate(function<void(Context* ctx)> translate) {
+  arena_.reset();
+  shared_results_.clear();
+  if (pending_compose_ || !translate)
+    return;
+  // (segment index, highlighted candidate index)
+  vector<pair<size_t, size_t>> released;
+  for (size_t i = 0; i < composition_.size(); ++i) {
+    Segment& seg(composition_[i]);
+    if (seg.status != Segment::kGuess || !seg.menu)
+      continue;
+    seg.menu->CancelPrefetch();
+    seg.menu.reset();
+    seg.status = Segment::kVoid;
+    released.emplace_back(i, seg.selected_index);
+  }
+  if (released.empty())
+    return;
+  pending_compose_ = [translate = std::move(translate),
+                      released = std::move(released)](Context* ctx) {
+    translate(ctx);
+    for (const auto& x : released) {
+      if (x.first < ctx->composition_.size())
+        ctx->composition_[x.first].selected_index = x.second;
+    }
+  };
+}
+
 void Context::set_input(const string& value) {
   input_ = value;
   caret_pos_ = input_.length();
+  ++revision_;
   update_notifier_(this);
 }
 
 void Context::set_option(const string& name, bool value) {
   options_[name] = value;
   DLOG(INFO) << "Context::set_option " << name << " = " << value;
+  ++revision_;
   option_update_notifier_(this, name);
 }
 
@@ -292,8 +394,23 @@ bool Context::get_option(const string& name) const {
     return false;
 }
 
+void Context::StartLatencyBudget(std::chrono::milliseconds budget) {
+  has_deadline_ = budget.count() > 0;
+  if (has_deadline_)
+    deadline_ = std::chrono::steady_clock::now() + budget;
+  degraded_ = false;
+}
+
+bool Context::OverLatencyBudget() {
+  if (!has_deadline_ || std::chrono::steady_clock::now() < deadline_)
+    return false;
+  degraded_ = true;
+  return true;
+}
+
 void Context::set_property(const string& name, const string& value) {
   properties_[name] = value;
+  ++revision_;
   property_update_notifier_(this, name);
 }
 
@@ -319,4 +436,31 @@ void Context::ClearTransientOptions() {
   }
 }
 
+template <class T>
+static void erase_session_scoped(map<string, T>& items) {
+  for (auto it = items.begin(); it != items.end();) {
+    if (it->first.empty() || it->first[0] != '_')
+      items.erase(it++);
+    else
+      ++it;
+  }
+}
+
+void Context::Reset() {
+  Clear();
+  commit_history_.clear();
+  erase_session_scoped(options_);
+  erase_session_scoped(properties_);
+}
+
+void Context::SwapNotifiers(Context* other) {
+  commit_notifier_.swap(other->commit_notifier_);
+  select_notifier_.swap(other->select_notifier_);
+  update_notifier_.swap(other->update_notifier_);
+  delete_notifier_.swap(other->delete_notifier_);
+  option_update_notifier_.swap(other->option_update_notifier_);
+  property_update_notifier_.swap(other->property_update_notifier_);
+  unhandled_key_notifier_.swap(other->unhandled_key_notifier_);
+}
+
 }  // namespace rime
@@ -7,23 +7,31 @@
 #ifndef RIME_CONTEXT_H_
 #define RIME_CONTEXT_H_
 
+#include <chrono>
 #include <rime/common.h>
 #include <rime/commit_history.h>
 #include <rime/composition.h>
+#include <rime/local_signal.h>
 
 namespace rime {
 
+class Arena;
 class Candidate;
 class KeyEvent;
 
 class RIME_API Context {
  public:
-  using Notifier = signal<void(Context* ctx)>;
-  using OptionUpdateNotifier = signal<void(Context* ctx, const string& option)>;
+  // notifiers of a session, emitted on the thread processing its keys.
+  // since they became LocalSignals, plugins built against the headers with
+  // boost::signals2::signal notifiers must be rebuilt; their connections are
+  // still boost::signals2::connections.
+  using Notifier = LocalSignal<void(Context* ctx)>;
+  using OptionUpdateNotifier =
+      LocalSignal<void(Context* ctx, const string& option)>;
   using PropertyUpdateNotifier =
-      signal<void(Context* ctx, const string& property)>;
+      LocalSignal<void(Context* ctx, const string& property)>;
   using KeyEventNotifier =
-      signal<void(Context* ctx, const KeyEvent& key_event)>;
+      LocalSignal<void(Context* ctx, const KeyEvent& key_event)>;
 
   Context() = default;
   ~Context() = default;
@@ -65,11 +73,56 @@ class RIME_API Context {
   size_t caret_pos() const { return caret_pos_; }
 
   void set_composition(Composition&& comp);
-  Composition& composition() { return composition_; }
-  const Composition& composition() const { return composition_; }
+  // the composition may be modified through a mutable reference.
+  Composition& composition() {
+    ComposePending();
+    ++revision_;
+    return composition_;
+  }
+  const Composition& composition() const {
+    ComposePending();
+    return composition_;
+  }
+  // the input is composed when the composition is next accessed, rather than
+  // on every update, while a batch of key events is processed.
+  void DeferCompose(function<void(Context* ctx)> compose);
+  // brings the composition up to date with the input if composing has been
+  // deferred.
+  void ComposePending() const;
+  bool has_pending_compose() const { return bool(pending_compose_); }
+  // releases the menus of segments yet to be selected, to be made anew by
+  // translate when the composition is next accessed, and starts a new arena.
+  // the input and the rest of the composition are kept as they are.
+  void Hibernate(function<void(Context* ctx)> translate);
+  // changes whenever the input, the composition, options or properties may
+  // have changed, for the frontend to tell whether to show them anew.
+  size_t revision() const {
+    ComposePending();
+    return revision_;
+  }
+  // transient objects made for the current composition, such as dict entries
+  // and candidates, are allocated from the arena.
+  // a new arena is started after the composition is cleared.
+  const an<Arena>& arena();
+  // bytes held by the current arena.
+  size_t arena_capacity() const;
+  // results shared by the components working on the current composition,
+  // such as the lookups of translators on the same input, by their kind.
+  // they are dropped along with the arena.
+  an<void>& shared_results(const string& kind);
   CommitHistory& commit_history() { return commit_history_; }
   const CommitHistory& commit_history() const { return commit_history_; }
 
+  // starts the time the composition is expected to be made in; 0 for no
+  // limit. the composition is no longer degraded.
+  void StartLatencyBudget(std::chrono::milliseconds budget);
+  // true once the budget is spent, for an expensive stage to be skipped or
+  // shortened, which marks the composition as degraded.
+  bool OverLatencyBudget();
+  // some results of the composition were left out to keep within budget,
+  // and could be refined later.
+  bool degraded() const { return degraded_; }
+
   void set_option(const string& name, bool value);
   bool get_option(const string& name) const;
   void set_property(const string& name, const string& value);
@@ -79,6 +132,9 @@ class RIME_API Context {
   // options and properties starting with '_' are local to schema;
   // others are session scoped.
   void ClearTransientOptions();
+  // clears the input, the commit history and session scoped options and
+  // properties, for the context to be reused in a new session.
+  void Reset();
 
   Notifier& commit_notifier() { return commit_notifier_; }
   Notifier& select_notifier() { return select_notifier_; }
@@ -91,6 +147,9 @@ class RIME_API Context {
     return property_update_notifier_;
   }
   KeyEventNotifier& unhandled_key_notifier() { return unhandled_key_notifier_; }
+  // exchanges the notifiers, along with the slots connected to them, with
+  // those of the other context.
+  void SwapNotifiers(Context* other);
 
  private:
   string GetSoftCursor() const;
@@ -98,9 +157,16 @@ class RIME_API Context {
   string input_;
   size_t caret_pos_ = 0;
   Composition composition_;
+  mutable function<void(Context* ctx)> pending_compose_;
+  size_t revision_ = 1;
+  an<Arena> arena_;
+  map<string, an<void>> shared_results_;
   CommitHistory commit_history_;
   map<string, bool> options_;
   map<string, string> properties_;
+  std::chrono::steady_clock::time_point deadline_;
+  bool has_deadline_ = false;
+  bool degraded_ = false;
 
   Notifier commit_notifier_;
   Notifier select_notifier_;
@@ -4,11 +4,15 @@
 //
 // 2011-12-01 GONG Chen <chen.sst@gmail.com>
 //
+#include <boost/algorithm/string.hpp>
 #include <chrono>
 #include <exception>
+#include <filesystem>
+#include <fstream>
 #include <utility>
 #include <rime/common.h>
 #include <rime/deployer.h>
+#include <rime/resource.h>
 
 namespace rime {
 
@@ -35,7 +39,16 @@ bool Deployer::RunTask(const string& task_name, TaskInitializer arg) {
     LOG(ERROR) << "error creating deployment task: " << task_name;
     return false;
   }
-  return t->Run(this);
+  t->set_name(task_name);
+  FallbackResourceResolver::Deploying deploying;
+  DeploymentTimer timer(this, task_name, "run");
+  // the task sees files added or removed since paths were last resolved,
+  // and so do the sessions after it.
+  FallbackResourceResolver::InvalidateCache();
+  bool success = t->Run(this);
+  FallbackResourceResolver::InvalidateCache();
+  ++generation_;
+  return success;
 }
 
 bool Deployer::ScheduleTask(const string& task_name, TaskInitializer arg) {
@@ -49,6 +62,7 @@ bool Deployer::ScheduleTask(const string& task_name, TaskInitializer arg) {
     LOG(ERROR) << "error creating deployment task: " << task_name;
     return false;
   }
+  t->set_name(task_name);
   ScheduleTask(t);
   return true;
 }
@@ -77,11 +91,21 @@ bool Deployer::HasPendingTasks() {
 
 bool Deployer::Run() {
   LOG(INFO) << "running deployment tasks:";
+  FallbackResourceResolver::Deploying deploying;
   message_sink_("deploy", "start");
+  {
+    std::lock_guard<std::mutex> lock(report_mutex_);
+    timings_.clear();
+  }
   int success = 0;
   int failure = 0;
   do {
+    if (maintenance_mode_ && serve_previous_build_)
+      ServePreviousBuild();
     while (auto task = NextTask()) {
+      FallbackResourceResolver::InvalidateCache();
+      DeploymentTimer timer(this, task->name().empty() ? "task" : task->name(),
+                            "run");
       try {
         if (task->Run(this))
           ++success;
@@ -93,8 +117,12 @@ bool Deployer::Run() {
       }
       // boost::this_thread::interruption_point();
     }
+    StopServingPreviousBuild();
+    FallbackResourceResolver::InvalidateCache();
+    ++generation_;
     LOG(INFO) << success + failure << " tasks ran: " << success << " success, "
               << failure << " failure.";
+    WriteReport();
     message_sink_("deploy", !failure ? "success" : "failure");
     // new tasks could have been enqueued while we were sending the message.
     // before quitting, double check if there is nothing left to do.
@@ -102,12 +130,13 @@ bool Deployer::Run() {
   return !failure;
 }
 
-bool Deployer::StartWork(bool maintenance_mode) {
+bool Deployer::StartWork(bool maintenance_mode, bool serve_previous_build) {
   if (IsWorking()) {
     LOG(WARNING) << "a work thread is already running.";
     return false;
   }
   maintenance_mode_ = maintenance_mode;
+  serve_previous_build_ = serve_previous_build;
   if (pending_tasks_.empty()) {
     return false;
   }
@@ -122,8 +151,8 @@ bool Deployer::StartWork(bool maintenance_mode) {
 #endif
 }
 
-bool Deployer::StartMaintenance() {
-  return StartWork(true);
+bool Deployer::StartMaintenance(bool serve_previous_build) {
+  return StartWork(true, serve_previous_build);
 }
 
 bool Deployer::IsWorking() {
@@ -150,4 +179,99 @@ path Deployer::user_data_sync_dir() const {
   return sync_dir / user_id;
 }
 
+path Deployer::previous_build_dir() const {
+  return staging_dir / "previous_build";
+}
+
+// files replaced by renaming new ones over them, never written in place;
+// they are linked to rather than copied.
+static bool is_replaced_by_rename(const path& file_path) {
+  auto file_name = file_path.filename().u8string();
+  return boost::ends_with(file_name, ".table.bin") ||
+         boost::ends_with(file_name, ".prism.bin") ||
+         boost::ends_with(file_name, ".reverse.bin");
+}
+
+void Deployer::ServePreviousBuild() {
+  namespace fs = std::filesystem;
+  path snapshot = previous_build_dir();
+  std::error_code ec;
+  fs::remove_all(snapshot, ec);
+  if (!fs::is_directory(staging_dir, ec) || fs::is_empty(staging_dir, ec)) {
+    // nothing built yet; sessions wait for the build.
+    return;
+  }
+  if (!fs::create_directories(snapshot, ec)) {
+    LOG(WARNING) << "error creating " << snapshot << ": " << ec.message();
+    return;
+  }
+  for (fs::directory_iterator it(staging_dir, ec), end; !ec && it != end;
+       it.increment(ec)) {
+    if (!it->is_regular_file(ec))
+      continue;
+    path target = snapshot / it->path().filename();
+    bool linked = false;
+    if (is_replaced_by_rename(it->path())) {
+      fs::create_hard_link(it->path(), target, ec);
+      linked = !ec;
+    }
+    if (!linked)
+      fs::copy_file(it->path(), target, ec);
+    if (ec)
+      break;
+  }
+  if (ec) {
+    LOG(WARNING) << "error keeping the previous build: " << ec.message();
+    fs::remove_all(snapshot, ec);
+    return;
+  }
+  LOG(INFO) << "serving the previous build from " << snapshot;
+  FallbackResourceResolver::ServeSnapshot(staging_dir, snapshot);
+  serving_previous_build_ = true;
+}
+
+void Deployer::StopServingPreviousBuild() {
+  if (!serving_previous_build_)
+    return;
+  FallbackResourceResolver::ServeSnapshot(staging_dir, path());
+  serving_previous_build_ = false;
+  // files still mapped by sessions are kept until they are closed, on
+  // systems that allow; otherwise removed before the next snapshot.
+  std::error_code ec;
+  std::filesystem::remove_all(previous_build_dir(), ec);
+}
+
+void Deployer::ReportTiming(const string& item,
+                            const string& stage,
+                            double milliseconds) {
+  DLOG(INFO) << "deployed " << item << " [" << stage << "] in "
+             << milliseconds << " ms.";
+  std::lock_guard<std::mutex> lock(report_mutex_);
+  timings_.push_back({item, stage, milliseconds});
+  // messages of tasks running in parallel are sent one at a time.
+  message_sink_("deploy_timing", item + "\t" + stage + "\t" +
+                                     std::to_string(milliseconds));
+}
+
+path Deployer::report_file() const {
+  return staging_dir / "deployment_report.txt";
+}
+
+void Deployer::WriteReport() {
+  std::lock_guard<std::mutex> lock(report_mutex_);
+  if (timings_.empty())
+    return;
+  std::ofstream out(report_file().c_str());
+  if (!out) {
+    LOG(WARNING) << "error writing deployment report: " << report_file();
+    return;
+  }
+  out << "# Rime deployment report\n"
+      << "# item\tstage\tmilliseconds\n";
+  for (const auto& x : timings_) {
+    out << x.item << '\t' << x.stage << '\t' << x.milliseconds << '\n';
+  }
+  LOG(INFO) << "deployment report: " << report_file();
+}
+
 }  // namespace rime
@@ -7,6 +7,8 @@
 #ifndef RIME_DEPLOYER_H_
 #define RIME_DEPLOYER_H_
 
+#include <atomic>
+#include <chrono>
 #include <future>
 #include <mutex>
 #include <queue>
@@ -27,6 +29,13 @@ class DeploymentTask : public Class<DeploymentTask, TaskInitializer> {
   virtual ~DeploymentTask() = default;
 
   virtual bool Run(Deployer* deployer) = 0;
+
+  // the name the task is created by, in deployment reports.
+  const string& name() const { return name_; }
+  void set_name(const string& name) { name_ = name; }
+
+ private:
+  string name_;
 };
 
 class Deployer : public Messenger {
@@ -56,21 +65,85 @@ class Deployer : public Messenger {
   bool HasPendingTasks();
 
   bool Run();
-  bool StartWork(bool maintenance_mode = false);
-  bool StartMaintenance();
+  bool StartWork(bool maintenance_mode = false,
+                 bool serve_previous_build = false);
+  // with serve_previous_build, sessions keep working on the files of the
+  // last build while the tasks replace them, and find the new files once
+  // all tasks have run.
+  bool StartMaintenance(bool serve_previous_build = false);
   bool IsWorking();
   bool IsMaintenanceMode();
+  // whether the files of the previous build are being served during
+  // maintenance.
+  bool serving_previous_build() const { return serving_previous_build_; }
   // the following two methods equally wait until all threads are joined
   void JoinWorkThread();
   void JoinMaintenanceThread();
 
   path user_data_sync_dir() const;
+  // where the files of the last build are kept while they are replaced.
+  path previous_build_dir() const;
+
+  // counts the runs of deployment tasks; files loaded before a change of
+  // generation may have been deployed again.
+  uint64_t generation() const { return generation_; }
+
+  // the time taken by a stage of deploying an item, eg. building the table
+  // of a dictionary. Sent as a "deploy_timing" message, of the value
+  // "<item>\t<stage>\t<milliseconds>", and written to the report file at
+  // the end of the run.
+  void ReportTiming(const string& item,
+                    const string& stage,
+                    double milliseconds);
+  path report_file() const;
 
  private:
+  void WriteReport();
+  void ServePreviousBuild();
+  void StopServingPreviousBuild();
+
+  struct Timing {
+    string item;
+    string stage;
+    double milliseconds;
+  };
+  std::mutex report_mutex_;
+  vector<Timing> timings_;
+
   std::queue<of<DeploymentTask>> pending_tasks_;
   std::mutex mutex_;
   std::future<void> work_;
   bool maintenance_mode_ = false;
+  bool serve_previous_build_ = false;
+  std::atomic<bool> serving_previous_build_{false};
+  std::atomic<uint64_t> generation_{0};
+};
+
+// reports the time from its creation to its destruction to the deployer.
+class DeploymentTimer {
+ public:
+  DeploymentTimer(Deployer* deployer, const string& item, const string& stage)
+      : deployer_(deployer),
+        item_(item),
+        stage_(stage),
+        start_(std::chrono::steady_clock::now()) {}
+  ~DeploymentTimer() { Stop(); }
+  // reports the time now, instead of on destruction.
+  void Stop() {
+    std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start_;
+    if (deployer_)
+      deployer_->ReportTiming(item_, stage_, elapsed.count());
+    deployer_ = nullptr;
+  }
+  DeploymentTimer(const DeploymentTimer&) = delete;
+  DeploymentTimer& operator=(const DeploymentTimer&) = delete;
+
+ private:
+  Deployer* deployer_;
+  string item_;
+  string stage_;
+  std::chrono::steady_clock::time_point start_;
 };
 
 }  // namespace rime
@@ -0,0 +1,101 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <rime/build_config.h>
+#include <rime/dict/build_cache.h>
+
+namespace fs = std::filesystem;
+
+namespace rime {
+
+static std::mutex directory_mutex;
+static path cache_directory;
+
+void BuildCache::set_directory(const path& directory) {
+  std::lock_guard<std::mutex> lock(directory_mutex);
+  cache_directory = directory;
+}
+
+path BuildCache::directory() {
+  std::lock_guard<std::mutex> lock(directory_mutex);
+  return cache_directory;
+}
+
+// files are copied to a temporary file first, then renamed.
+path BuildCache::TempFilePath(const path& file_path) {
+  size_t nonce = std::hash<std::thread::id>()(std::this_thread::get_id()) ^
+                 std::chrono::steady_clock::now().time_since_epoch().count();
+  path temp = file_path;
+  temp += ".tmp" + std::to_string(nonce);
+  return temp;
+}
+
+// eg. luna_pinyin.table.bin-1.11.2-0123abcd
+path BuildCache::CachedFilePath(const path& directory,
+                                const path& file_path,
+                                const vector<uint32_t>& checksums) {
+  std::ostringstream name;
+  name << file_path.filename().u8string() << '-' << RIME_VERSION;
+  for (uint32_t checksum : checksums) {
+    name << '-' << std::hex << std::setw(8) << std::setfill('0') << checksum;
+  }
+  return directory / name.str();
+}
+
+bool BuildCache::Fetch(const path& file_path,
+                       const vector<uint32_t>& checksums) {
+  path dir = directory();
+  if (dir.empty())
+    return false;
+  path cached = CachedFilePath(dir, file_path, checksums);
+  std::error_code ec;
+  if (!fs::exists(cached, ec))
+    return false;
+  // the file being replaced may still be mapped by running sessions.
+  path temp = TempFilePath(file_path);
+  fs::copy_file(cached, temp, fs::copy_options::overwrite_existing, ec);
+  if (!ec)
+    fs::rename(temp, file_path, ec);
+  if (ec) {
+    LOG(WARNING) << "error copying " << cached << " from build cache: "
+                 << ec.message();
+    fs::remove(temp, ec);
+    return false;
+  }
+  LOG(INFO) << "reused " << file_path << " from build cache.";
+  return true;
+}
+
+bool BuildCache::Store(const path& file_path,
+                       const vector<uint32_t>& checksums) {
+  path dir = directory();
+  if (dir.empty())
+    return false;
+  std::error_code ec;
+  fs::create_directories(dir, ec);
+  path cached = CachedFilePath(dir, file_path, checksums);
+  if (fs::exists(cached, ec))
+    return true;
+  // others see the file only when it is complete.
+  path temp = TempFilePath(cached);
+  fs::copy_file(file_path, temp, fs::copy_options::overwrite_existing, ec);
+  if (!ec)
+    fs::rename(temp, cached, ec);
+  if (ec) {
+    LOG(WARNING) << "error storing " << file_path << " in build cache: "
+                 << ec.message();
+    fs::remove(temp, ec);
+    return false;
+  }
+  return true;
+}
+
+}  // namespace rime
@@ -0,0 +1,39 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#ifndef RIME_BUILD_CACHE_H_
+#define RIME_BUILD_CACHE_H_
+
+#include <rime_api.h>
+#include <rime/common.h>
+
+namespace rime {
+
+// Compiled dictionary files shared by the users of a machine, or of a
+// network directory. A file is found by its name, the version of the
+// library that built it, and the checksums of what it was built from.
+class BuildCache {
+ public:
+  // the cache is disabled until a directory is set.
+  RIME_API static void set_directory(const path& directory);
+  static path directory();
+
+  // copies the file built from the same sources to file_path, if cached.
+  static bool Fetch(const path& file_path, const vector<uint32_t>& checksums);
+  // keeps a copy of the built file for others building from the same
+  // sources.
+  static bool Store(const path& file_path, const vector<uint32_t>& checksums);
+  // a name next to file_path, unique to the calling thread, to write the
+  // file under before renaming it in place.
+  static path TempFilePath(const path& file_path);
+
+ private:
+  static path CachedFilePath(const path& directory,
+                             const path& file_path,
+                             const vector<uint32_t>& checksums);
+};
+
+}  // namespace rime
+
+#endif  // RIME_BUILD_CACHE_H_
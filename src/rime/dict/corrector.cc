@@ -7,11 +7,14 @@
 
 #include "corrector.h"
 #include <algorithm>
+#include <array>
+#include <bitset>
 #include <numeric>
 #include <queue>
 #include <rime/schema.h>
 #include <rime/service.h>
 #include <rime/ticket.h>
+#include <rime/worker_pool.h>
 
 using namespace rime;
 using namespace corrector;
@@ -72,12 +75,43 @@ void DFSCollect(const string& origin,
 
 Script SymDeleteCollector::Collect(size_t edit_distance) {
   // TODO: specifically for 1 length str
-  Script script;
-
+  vector<const string*> syllables;
   for (auto& v : syllabary_) {
-    DFSCollect(v, v, edit_distance, script);
+    syllables.push_back(&v);
+  }
+  // syllables are collected in shards on the worker threads, which are
+  // merged in order to make the same script as collected in one pass.
+  auto& pool = WorkerPool::Shared();
+  size_t num_shards = (std::min)(
+      pool.size(), (syllables.size() + kMinShardSize - 1) / kMinShardSize);
+  if (num_shards <= 1) {
+    Script script;
+    for (const auto* v : syllables) {
+      DFSCollect(*v, *v, edit_distance, script);
+    }
+    return script;
+  }
+  vector<Script> shards(num_shards);
+  vector<std::future<void>> pending;
+  for (size_t i = 0; i < num_shards; ++i) {
+    size_t begin = syllables.size() * i / num_shards;
+    size_t end = syllables.size() * (i + 1) / num_shards;
+    pending.push_back(pool.Submit([&, i, begin, end] {
+      for (size_t j = begin; j < end; ++j) {
+        DFSCollect(*syllables[j], *syllables[j], edit_distance, shards[i]);
+      }
+    }));
+  }
+  for (auto& task : pending) {
+    task.get();
+  }
+  Script script(std::move(shards[0]));
+  for (size_t i = 1; i < num_shards; ++i) {
+    for (auto& x : shards[i]) {
+      auto& spellings = script[x.first];
+      spellings.insert(spellings.end(), x.second.begin(), x.second.end());
+    }
   }
-
   return script;
 }
 
@@ -108,14 +142,14 @@ void EditDistanceCorrector::ToleranceSearch(const Prism& prism,
   vector<size_t> jump_pos(key_len);
 
   auto match_next = [&](size_t& node, size_t& point) -> bool {
-    auto res_val = trie_->traverse(key.c_str(), node, point, point + 1);
+    auto res_val = trie_->Traverse(key.c_str(), &node, &point, point + 1);
     if (res_val == -2)
       return false;
     if (res_val >= 0) {
+      auto current_input = key.substr(0, point);
       for (auto accessor = QuerySpelling(res_val); !accessor.exhausted();
            accessor.Next()) {
         auto origin = accessor.properties().tips;
-        auto current_input = key.substr(0, point);
         if (origin == current_input) {
           continue;  // early termination: this comparison is O(n)
         }
@@ -149,10 +183,24 @@ void EditDistanceCorrector::ToleranceSearch(const Prism& prism,
   }
 }
 
+// the keys next to each other, looked up without hashing.
+static const std::array<std::bitset<256>, 256>& keyboard_neighbors() {
+  static const auto neighbors = [] {
+    std::array<std::bitset<256>, 256> result;
+    for (const auto& key : keyboard_map) {
+      for (char neighbor : key.second) {
+        result[(unsigned char)key.first].set((unsigned char)neighbor);
+      }
+    }
+    return result;
+  }();
+  return neighbors;
+}
+
 inline uint8_t SubstCost(char left, char right) {
   if (left == right)
     return 0;
-  if (keyboard_map[left].find(right) != keyboard_map[left].end()) {
+  if (keyboard_neighbors()[(unsigned char)left][(unsigned char)right]) {
     return 1;
   }
   return 4;
@@ -189,12 +237,65 @@ Distance EditDistanceCorrector::LevenshteinDistance(const std::string& s1,
   return result;
 }
 
+// Hyyrö's bit-parallel algorithm of the edit distance with transposition,
+// where each column of the dynamic programming matrix is encoded by the
+// vertical deltas of its cells.
+Distance EditDistanceCorrector::BitParallelDistance(const std::string& s1,
+                                                    const std::string& s2) {
+  size_t m = s1.size();
+  if (m == 0)
+    return s2.size();
+  if (m > kMaxBitParallelLength)
+    return 0;
+  uint64_t peq[256];
+  for (unsigned char c : s1)
+    peq[c] = 0;
+  for (unsigned char c : s2)
+    peq[c] = 0;
+  for (size_t i = 0; i < m; ++i)
+    peq[(unsigned char)s1[i]] |= uint64_t(1) << i;
+  const uint64_t last = uint64_t(1) << (m - 1);
+  uint64_t vp = ~uint64_t(0);
+  uint64_t vn = 0;
+  uint64_t d0 = 0;
+  uint64_t previous_pm = 0;
+  Distance score = m;
+  for (unsigned char c : s2) {
+    uint64_t pm = peq[c];
+    uint64_t tr = (((~d0) & pm) << 1) & previous_pm;
+    d0 = (((pm & vp) + vp) ^ vp) | pm | vn | tr;
+    uint64_t hp = vn | ~(d0 | vp);
+    uint64_t hn = d0 & vp;
+    if (hp & last)
+      ++score;
+    else if (hn & last)
+      --score;
+    hp = (hp << 1) | 1;
+    hn <<= 1;
+    vp = hn | ~(d0 | hp);
+    vn = d0 & hp;
+    previous_pm = pm;
+  }
+  return score;
+}
+
 // L's distance with transposition allowed
 Distance EditDistanceCorrector::RestrictedDistance(const std::string& s1,
                                                    const std::string& s2,
                                                    Distance threshold) {
   auto len1 = s1.size(), len2 = s2.size();
-  vector<size_t> d((len1 + 1) * (len2 + 1));
+  // every operation costs at least 1, and insertion or deletion 2.
+  // skip the weighted distance if either bound exceeds the threshold.
+  if (len1 <= kMaxBitParallelLength) {
+    Distance length_difference = len1 > len2 ? len1 - len2 : len2 - len1;
+    Distance lower_bound =
+        (std::max)(BitParallelDistance(s1, s2), length_difference * 2);
+    if (lower_bound > threshold)
+      return lower_bound;
+  }
+  // reused by the comparisons of each thread.
+  static thread_local vector<size_t> d;
+  d.assign((len1 + 1) * (len2 + 1), 0);
 
   auto index = [len1, len2](size_t i, size_t j) { return i * (len2 + 1) + j; };
 
@@ -267,8 +368,8 @@ void NearSearchCorrector::ToleranceSearch(const Prism& prism,
     char ch = rec.ch;
     char& exchange(const_cast<char*>(key.c_str())[rec.idx]);
     std::swap(ch, exchange);
-    auto val =
-        prism.trie().traverse(key.c_str(), rec.node_pos, rec.idx, rec.idx + 1);
+    auto val = prism.trie().Traverse(key.c_str(), &rec.node_pos, &rec.idx,
+                                     rec.idx + 1);
     std::swap(ch, exchange);
 
     if (val == -2)
@@ -25,6 +25,9 @@ class SymDeleteCollector {
 
   Script Collect(size_t edit_distance);
 
+  // syllables collected by each worker thread, at least.
+  static const size_t kMinShardSize = 64;
+
  private:
   const Syllabary& syllabary_;
 };
@@ -107,9 +110,19 @@ class EditDistanceCorrector : public Corrector, public Prism {
                                 size_t tolerance) override;
   corrector::Distance LevenshteinDistance(const std::string& s1,
                                           const std::string& s2);
-  corrector::Distance RestrictedDistance(const std::string& s1,
-                                         const std::string& s2,
-                                         corrector::Distance threshold);
+  RIME_API corrector::Distance RestrictedDistance(
+      const std::string& s1,
+      const std::string& s2,
+      corrector::Distance threshold);
+  // the restricted edit distance counting each operation as 1, computed
+  // with bit vectors, which bounds the distance above from below.
+  // s1 is to be no longer than kMaxBitParallelLength, or 0 is returned.
+  RIME_API static corrector::Distance BitParallelDistance(
+      const std::string& s1,
+      const std::string& s2);
+
+  // the longest string that fits in the bit vectors.
+  static const size_t kMaxBitParallelLength = 64;
 };
 
 class RIME_API NearSearchCorrector : public Corrector {
@@ -61,6 +61,8 @@ class Db : public Class<Db, const string&> {
   bool loaded() const { return loaded_; }
   bool readonly() const { return readonly_; }
   bool disabled() const { return disabled_; }
+  // whether values can hold arbitrary bytes.
+  virtual bool binary_safe() const { return false; }
   void disable() { disabled_ = true; }
   void enable() { disabled_ = false; }
 
@@ -79,7 +81,11 @@ class Transactional {
   virtual bool BeginTransaction() { return false; }
   virtual bool AbortTransaction() { return false; }
   virtual bool CommitTransaction() { return false; }
-  bool in_transaction() const { return in_transaction_; }
+  // writes committed transactions that are held in memory to storage.
+  virtual bool FlushPendingWrites() { return true; }
+  // whether a transaction is in progress on the calling thread, for dbs
+  // that take transactions on several threads.
+  virtual bool in_transaction() const { return in_transaction_; }
 
  protected:
   bool in_transaction_ = false;
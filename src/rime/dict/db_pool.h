@@ -1,6 +1,7 @@
 #ifndef RIME_DB_POOL_H_
 #define RIME_DB_POOL_H_
 
+#include <mutex>
 #include <rime/common.h>
 #include <rime/resource.h>
 
@@ -17,6 +18,7 @@ class DbPool {
 
  protected:
   the<ResourceResolver> resource_resolver_;
+  std::mutex db_pool_mutex_;
   map<string, weak<T>> db_pool_;
 };
 
@@ -12,6 +12,7 @@ DbPool<T>::DbPool(the<ResourceResolver> resource_resolver)
 
 template <class T>
 an<T> DbPool<T>::GetDb(const string& db_name) {
+  std::lock_guard<std::mutex> lock(db_pool_mutex_);
   auto db = db_pool_[db_name].lock();
   if (!db) {
     auto file_path = resource_resolver_->ResolvePath(db_name);
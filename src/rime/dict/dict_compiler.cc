@@ -7,20 +7,27 @@
 #include <filesystem>
 #include <cfloat>
 #include <cmath>
+#include <atomic>
 #include <fstream>
+#include <limits>
+#include <thread>
 #include <rime/algo/algebra.h>
 #include <rime/algo/utilities.h>
+#include <rime/dict/build_cache.h>
 #include <rime/dict/corrector.h>
 #include <rime/dict/dict_compiler.h>
 #include <rime/dict/dict_settings.h>
 #include <rime/dict/dictionary.h>
 #include <rime/dict/entry_collector.h>
+#include <rime/dict/entry_sorter.h>
 #include <rime/dict/preset_vocabulary.h>
 #include <rime/dict/prism.h>
 #include <rime/dict/reverse_lookup_dictionary.h>
 #include <rime/dict/table.h>
+#include <rime/deployer.h>
 #include <rime/resource.h>
 #include <rime/service.h>
+#include <rime/worker_pool.h>
 
 namespace rime {
 
@@ -36,6 +43,16 @@ DictCompiler::DictCompiler(Dictionary* dictionary)
 
 DictCompiler::~DictCompiler() {}
 
+static std::atomic<size_t> dict_compiler_memory_limit = 0;
+
+void DictCompiler::set_memory_limit(size_t memory_limit) {
+  dict_compiler_memory_limit = memory_limit;
+}
+
+size_t DictCompiler::memory_limit() {
+  return dict_compiler_memory_limit;
+}
+
 static bool load_dict_settings_from_file(DictSettings* settings,
                                          const path& dict_file) {
   std::ifstream fin(dict_file.c_str());
@@ -67,18 +84,71 @@ static uint32_t compute_dict_file_checksum(uint32_t initial_checksum,
   if (dict_files.empty()) {
     return initial_checksum;
   }
+  vector<path> files(dict_files);
+  if (settings.use_preset_vocabulary()) {
+    files.push_back(PresetVocabulary::DictFilePath(settings.vocabulary()));
+  }
   ChecksumComputer cc(initial_checksum);
-  for (const auto& file_path : dict_files) {
-    cc.ProcessFile(file_path);
+  cc.ProcessFiles(files);
+  return cc.Checksum();
+}
+
+// pack tables refer to syllables by their ids in the syllabary of the
+// primary table. they are valid as long as the syllabary is the same, even
+// if other entries of the primary table have changed.
+static uint32_t compute_syllabary_checksum(const Syllabary& syllabary) {
+  ChecksumComputer cc;
+  for (const auto& syllable : syllabary) {
+    cc.ProcessText(syllable);
+    cc.ProcessText("\n");
   }
-  if (settings.use_preset_vocabulary()) {
-    cc.ProcessFile(PresetVocabulary::DictFilePath(settings.vocabulary()));
+  return cc.Checksum();
+}
+
+static uint32_t compute_algebra_checksum(an<ConfigList> algebra) {
+  ChecksumComputer cc;
+  if (algebra) {
+    for (size_t i = 0; i < algebra->size(); ++i) {
+      if (auto rule = algebra->GetValueAt(i)) {
+        cc.ProcessText(rule->str());
+      }
+      cc.ProcessText("\n");
+    }
   }
   return cc.Checksum();
 }
 
+static Deployer* deployer() {
+  return &Service::instance().deployer();
+}
+
+// files are built under a temporary name and take the place of the target
+// once complete, so that neither a failed build nor a reader of the target
+// ever finds a partial file.
+static bool install_built_file(MappedFile* file, const path& target_path) {
+  path temp_path = file->file_path();
+  file->Close();
+  std::error_code ec;
+  std::filesystem::rename(temp_path, target_path, ec);
+  if (ec) {
+    LOG(ERROR) << "error installing " << target_path << ": " << ec.message();
+    std::filesystem::remove(temp_path, ec);
+    return false;
+  }
+  return true;
+}
+
+std::future<void> DictCompiler::RunStage(function<void()> stage) {
+  if (pool_)
+    return pool_->Submit(std::move(stage));
+  std::packaged_task<void()> task(std::move(stage));
+  task();
+  return task.get_future();
+}
+
 bool DictCompiler::Compile(const path& schema_file) {
   LOG(INFO) << "compiling dictionary for " << schema_file;
+  DeploymentTimer parse_timer(deployer(), dict_name_, "parse");
   bool build_table_from_source = true;
   DictSettings settings;
   auto dict_file = source_resolver_->ResolvePath(dict_name_ + ".dict.yaml");
@@ -142,6 +212,24 @@ bool DictCompiler::Compile(const path& schema_file) {
   if (options_ & kRebuildPrism) {
     rebuild_prism = true;
   }
+  // others may have built the same files from the same sources.
+  if (rebuild_table && build_table_from_source &&
+      !(options_ & kRebuildTable) && FetchTable(0, dict_file_checksum)) {
+    rebuild_table = false;
+  }
+  if (rebuild_prism && !(options_ & kRebuildPrism) &&
+      FetchPrism(dict_file_checksum, schema_file_checksum)) {
+    rebuild_prism = false;
+  }
+  parse_timer.Stop();
+  // the reverse db, the prism and the packs only read what has been built
+  // before them, and are built in parallel; unless the compiler is already
+  // run in parallel with others, as it is in a workspace update.
+  if (!WorkerPool::OnWorkerThread()) {
+    unsigned num_stages = unsigned(packs_.size()) + 1;
+    pool_.reset(new WorkerPool((std::max)(
+        1u, (std::min)(std::thread::hardware_concurrency(), num_stages))));
+  }
   Syllabary syllabary;
   if (rebuild_table) {
     EntryCollector collector;
@@ -155,64 +243,116 @@ bool DictCompiler::Compile(const path& schema_file) {
     else
       LOG(WARNING) << "couldn't load syllabary from '" << schema_file << "'";
   }
-  if (rebuild_prism &&
-      !BuildPrism(schema_file, dict_file_checksum, schema_file_checksum)) {
-    return false;
+  bool prism_built = true;
+  vector<std::future<void>> stages;
+  if (rebuild_prism) {
+    stages.push_back(RunStage([&] {
+      DeploymentTimer timer(deployer(), dict_name_, "build_prism");
+      prism_built =
+          BuildPrism(schema_file, dict_file_checksum, schema_file_checksum);
+    }));
   }
+  uint32_t syllabary_checksum = compute_syllabary_checksum(syllabary);
   for (int table_index = 1; table_index < tables_.size(); ++table_index) {
-    const auto& pack_name = packs_[table_index - 1];
-    auto pack_table = tables_[table_index];
-    EntryCollector collector(std::move(syllabary));
-    DictSettings settings;
-    auto dict_file = source_resolver_->ResolvePath(pack_name + ".dict.yaml");
-    if (!std::filesystem::exists(dict_file)) {
-      if (pack_table->Exists())
-        LOG(INFO) << "pack source file '" << dict_file
-                  << "' does not exist, using prebuilt table '"
-                  << pack_table->file_path() << "'";
-      else
-        LOG(ERROR) << "neither pack source file '" << dict_file
-                   << "' nor a prebuilt table exists";
-      continue;
-    }
-    if (!load_dict_settings_from_file(&settings, dict_file)) {
-      LOG(ERROR) << "failed to load settings from '" << dict_file << "'.";
-      continue;
-    }
-    vector<path> dict_files;
-    if (!get_dict_files_from_settings(&dict_files, settings,
-                                      source_resolver_.get())) {
-      continue;
-    }
-    uint32_t pack_file_checksum =
-        compute_dict_file_checksum(dict_file_checksum, dict_files, settings);
-    bool rebuild_pack = true;
-    if (pack_table->Exists() && pack_table->Load()) {
-      rebuild_pack = pack_table->dict_file_checksum() != pack_file_checksum;
-    }
-    if (rebuild_pack) {
-      LOG(INFO) << "rebuilding pack '" << pack_name << "'";
-      if (!BuildTable(table_index, collector, &settings, dict_files,
-                      pack_file_checksum)) {
-        LOG(ERROR) << "failed to build pack: " << pack_name;
-      }
-    } else {
-      LOG(INFO) << "pack '" << pack_name << "' reuses up-to-date table '"
+    stages.push_back(RunStage([&, table_index] {
+      BuildPack(table_index, syllabary, syllabary_checksum);
+    }));
+  }
+  for (auto& stage : stages) {
+    stage.get();
+  }
+  return prism_built;
+}
+
+void DictCompiler::BuildPack(int table_index,
+                             const Syllabary& syllabary,
+                             uint32_t syllabary_checksum) {
+  const auto& pack_name = packs_[table_index - 1];
+  auto pack_table = tables_[table_index];
+  EntryCollector collector{Syllabary(syllabary)};
+  DictSettings settings;
+  auto dict_file = source_resolver_->ResolvePath(pack_name + ".dict.yaml");
+  if (!std::filesystem::exists(dict_file)) {
+    if (pack_table->Exists())
+      LOG(INFO) << "pack source file '" << dict_file
+                << "' does not exist, using prebuilt table '"
                 << pack_table->file_path() << "'";
-    }
-    syllabary = std::move(collector.syllabary);
+    else
+      LOG(ERROR) << "neither pack source file '" << dict_file
+                 << "' nor a prebuilt table exists";
+    return;
+  }
+  if (!load_dict_settings_from_file(&settings, dict_file)) {
+    LOG(ERROR) << "failed to load settings from '" << dict_file << "'.";
+    return;
+  }
+  vector<path> dict_files;
+  if (!get_dict_files_from_settings(&dict_files, settings,
+                                    source_resolver_.get())) {
+    return;
+  }
+  // only packs whose own source files have changed are rebuilt.
+  uint32_t pack_file_checksum =
+      compute_dict_file_checksum(syllabary_checksum, dict_files, settings);
+  bool rebuild_pack = true;
+  if (pack_table->Exists() && pack_table->Load()) {
+    rebuild_pack = pack_table->dict_file_checksum() != pack_file_checksum;
+  }
+  if (rebuild_pack) {
     pack_table->Close();
+    if (FetchTable(table_index, pack_file_checksum)) {
+      LOG(INFO) << "pack '" << pack_name << "' is fetched from build cache.";
+      rebuild_pack = false;
+    }
   }
-  // done!
-  return true;
+  if (rebuild_pack) {
+    LOG(INFO) << "rebuilding pack '" << pack_name << "'";
+    if (!BuildTable(table_index, collector, &settings, dict_files,
+                    pack_file_checksum)) {
+      LOG(ERROR) << "failed to build pack: " << pack_name;
+    }
+  } else {
+    LOG(INFO) << "pack '" << pack_name << "' reuses up-to-date table '"
+              << pack_table->file_path() << "'";
+  }
+  pack_table->Close();
 }
 
+
 static path relocate_target(const path& source_path,
                             ResourceResolver* target_resolver) {
   auto resource_id = source_path.filename().u8string();
   return target_resolver->ResolvePath(resource_id);
 }
 
+bool DictCompiler::FetchTable(int table_index, uint32_t dict_file_checksum) {
+  auto& table = tables_[table_index];
+  auto target_path =
+      relocate_target(table->file_path(), target_resolver_.get());
+  if (table_index == 0) {
+    // the reverse db is built along with the primary table.
+    auto reverse_db_path =
+        target_resolver_->ResolvePath(dict_name_ + ".reverse.bin");
+    if (!BuildCache::Fetch(reverse_db_path, {dict_file_checksum}))
+      return false;
+  }
+  if (!BuildCache::Fetch(target_path, {dict_file_checksum}))
+    return false;
+  table = New<Table>(target_path);
+  return true;
+}
+
+bool DictCompiler::FetchPrism(uint32_t dict_file_checksum,
+                              uint32_t schema_file_checksum) {
+  auto target_path =
+      relocate_target(prism_->file_path(), target_resolver_.get());
+  if (!BuildCache::Fetch(target_path,
+                         {dict_file_checksum, schema_file_checksum}))
+    return false;
+  prism_ = New<Prism>(target_path);
+  return true;
+}
+
 bool DictCompiler::BuildTable(int table_index,
                               EntryCollector& collector,
                               DictSettings* settings,
@@ -222,15 +362,30 @@ bool DictCompiler::BuildTable(int table_index,
   auto target_path =
       relocate_target(table->file_path(), target_resolver_.get());
   LOG(INFO) << "building table: " << target_path;
-  table = New<Table>(target_path);
+  table = New<Table>(BuildCache::TempFilePath(target_path));
 
-  collector.Configure(settings);
-  collector.Collect(dict_files);
+  const string& item = table_index > 0 ? packs_[table_index - 1] : dict_name_;
+  DeploymentTimer collect_timer(deployer(), item, "collect");
+  // schemas applying other spelling algebra to the same dictionary, or a
+  // later deployment, build from the entries collected once.
+  auto entries_path = target_resolver_->ResolvePath(item + ".entries.bin");
+  if ((options_ & kRebuildTable) ||
+      !collector.Load(entries_path, dict_file_checksum)) {
+    collector.Configure(settings);
+    collector.Collect(dict_files);
+    collector.Save(entries_path, dict_file_checksum);
+  }
+  collect_timer.Stop();
   if (options_ & kDump) {
-    path dump_path(table->file_path());
+    path dump_path(target_path);
     dump_path.replace_extension(".txt");
     collector.Dump(dump_path);
   }
+  if (memory_limit() > 0) {
+    return BuildTableFromSortedRuns(table_index, collector, settings,
+                                    target_path, dict_file_checksum);
+  }
+  DeploymentTimer build_timer(deployer(), item, "build_table");
   Vocabulary vocabulary;
   // build .table.bin
   {
@@ -262,16 +417,126 @@ bool DictCompiler::BuildTable(int table_index,
     if (settings->sort_order() != "original") {
       vocabulary.SortHomophones();
     }
-    table->Remove();
-    if (!table->Build(collector.syllabary, vocabulary, collector.num_entries,
-                      dict_file_checksum) ||
-        !table->Save()) {
+    table->set_compact_entries(settings->compact_entries());
+    // build reverse db for the primary table, from the same vocabulary
+    // while the table is being built.
+    bool reverse_db_built = true;
+    std::future<void> reverse_db;
+    if (table_index == 0) {
+      reverse_db = RunStage([&] {
+        reverse_db_built = BuildReverseDb(settings, collector, vocabulary,
+                                          dict_file_checksum);
+      });
+    }
+    bool table_built = table->Build(collector.syllabary, vocabulary,
+                                    collector.num_entries,
+                                    dict_file_checksum) &&
+                       table->Save();
+    if (reverse_db.valid()) {
+      reverse_db.get();
+    }
+    if (!table_built) {
+      table->Remove();
       return false;
     }
+    if (!install_built_file(table.get(), target_path)) {
+      return false;
+    }
+    table = New<Table>(target_path);
+    BuildCache::Store(target_path, {dict_file_checksum});
+    if (!reverse_db_built) {
+      return false;
+    }
+  }
+  build_timer.Stop();
+  return true;
+}
+
+bool DictCompiler::BuildTableFromSortedRuns(int table_index,
+                                            EntryCollector& collector,
+                                            DictSettings* settings,
+                                            const path& target_path,
+                                            uint32_t dict_file_checksum) {
+  auto& table = tables_[table_index];
+  const string& item = table_index > 0 ? packs_[table_index - 1] : dict_name_;
+  DeploymentTimer build_timer(deployer(), item, "build_table");
+  path run_file_prefix(table->file_path());
+  run_file_prefix += ".sort";
+  EntrySorter sorter(run_file_prefix, memory_limit());
+  {
+    map<string, SyllableId> syllable_to_id;
+    SyllableId syllable_id = 0;
+    for (const auto& s : collector.syllabary) {
+      syllable_to_id[s] = syllable_id++;
+    }
+    for (auto& r : collector.entries) {
+      ShortDictEntry e;
+      for (const auto& s : r->raw_code) {
+        e.code.push_back(syllable_to_id[s]);
+      }
+      e.text.swap(r->text);
+      e.weight = log(r->weight > 0 ? r->weight : DBL_EPSILON);
+      // entries move to the sorter one by one, not to be held twice.
+      r.reset();
+      if (e.code.empty()) {
+        LOG(ERROR) << "Error locating entries in vocabulary.";
+        continue;
+      }
+      if (!sorter.Add(std::move(e))) {
+        return false;
+      }
+    }
+    vector<of<RawDictEntry>>().swap(collector.entries);
+  }
+  if (!sorter.Finish()) {
+    return false;
+  }
+  bool sort_homophones = settings->sort_order() != "original";
+  // the reverse db is built from entries of single syllables.
+  Vocabulary single_syllable_entries;
+  Vocabulary group;
+  ShortDictEntry next;
+  bool has_next = sorter.Next(&next);
+  auto next_vocabulary = [&]() -> const Vocabulary* {
+    group.clear();
+    if (!has_next)
+      return nullptr;
+    SyllableId head = next.code[0];
+    do {
+      auto ls = group.LocateEntries(next.code);
+      ls->push_back(New<ShortDictEntry>(std::move(next)));
+      next = ShortDictEntry();
+      has_next = sorter.Next(&next);
+    } while (has_next && next.code[0] == head);
+    if (sort_homophones) {
+      group.SortHomophones();
+    }
+    if (table_index == 0) {
+      auto page = group.find(head);
+      if (page != group.end() && !page->second.entries.empty()) {
+        single_syllable_entries[head].entries = page->second.entries;
+      }
+    }
+    return &group;
+  };
+  table->set_compact_entries(settings->compact_entries());
+  if (!table->Build(collector.syllabary, next_vocabulary,
+                    collector.num_entries, dict_file_checksum) ||
+      !table->Save()) {
+    table->Remove();
+    return false;
+  }
+  if (!install_built_file(table.get(), target_path)) {
+    return false;
   }
-  // build reverse db for the primary table
+  table = New<Table>(target_path);
+  BuildCache::Store(target_path, {dict_file_checksum});
+  build_timer.Stop();
+  // build reverse db for the primary table, from the entries of single
+  // syllables kept while the table was built
   if (table_index == 0 &&
-      !BuildReverseDb(settings, collector, vocabulary, dict_file_checksum)) {
+      !BuildReverseDb(settings, collector, single_syllable_entries,
+                      dict_file_checksum)) {
     return false;
   }
   return true;
@@ -281,15 +546,21 @@ bool DictCompiler::BuildReverseDb(DictSettings* settings,
                                   const EntryCollector& collector,
                                   const Vocabulary& vocabulary,
                                   uint32_t dict_file_checksum) {
+  DeploymentTimer timer(deployer(), dict_name_, "build_reverse_db");
   // build .reverse.bin
   auto target_path = target_resolver_->ResolvePath(dict_name_ + ".reverse.bin");
-  ReverseDb reverse_db(target_path);
+  ReverseDb reverse_db(BuildCache::TempFilePath(target_path));
   if (!reverse_db.Build(settings, collector.syllabary, vocabulary,
                         collector.stems, dict_file_checksum) ||
       !reverse_db.Save()) {
     LOG(ERROR) << "error building reversedb.";
+    reverse_db.Remove();
+    return false;
+  }
+  if (!install_built_file(&reverse_db, target_path)) {
     return false;
   }
+  BuildCache::Store(target_path, {dict_file_checksum});
   return true;
 }
 
@@ -307,16 +578,61 @@ bool DictCompiler::BuildPrism(const path& schema_file,
   if (!primary_table->Load() || !primary_table->GetSyllabary(&syllabary) ||
       syllabary.empty())
     return false;
-  // apply spelling algebra and prepare corrections (if enabled)
-  Script script;
+  // weigh syllables by their heaviest words, for predictive lookups
+  vector<prism::Weight> syllable_weights(syllabary.size());
+  for (size_t i = 0; i < syllabary.size(); ++i) {
+    prism::Weight weight = std::numeric_limits<prism::Weight>::lowest();
+    TableAccessor a = primary_table->QueryWords(static_cast<SyllableId>(i));
+    for (; !a.exhausted(); a.Next()) {
+      weight = (std::max)(weight, a.entry_weight());
+    }
+    syllable_weights[i] = weight;
+  }
+  Config config;
+  an<ConfigList> algebra;
+  // speller/prism_trie: louds trades lookup speed for a smaller prism.
+  prism::TrieBackend trie_backend = prism::kDoubleArrayTrie;
   if (!schema_file.empty()) {
-    Config config;
     if (!config.LoadFromFile(schema_file)) {
       LOG(ERROR) << "error loading prism definition from " << schema_file;
       return false;
     }
+    algebra = config.GetList("speller/algebra");
+    string trie;
+    if (config.GetString("speller/prism_trie", &trie) && trie == "louds")
+      trie_backend = prism::kLoudsTrie;
+  }
+  uint32_t syllabary_checksum = compute_syllabary_checksum(syllabary);
+  uint32_t algebra_checksum = compute_algebra_checksum(algebra);
+  // the same spellings are derived from the same syllabary by the same
+  // algebra; only the weights of the words may have changed.
+  if (!(options_ & (kRebuildPrism | kDump)) && prism_->Exists() &&
+      prism_->Load() && prism_->syllabary_checksum() == syllabary_checksum &&
+      prism_->algebra_checksum() == algebra_checksum &&
+      prism_->trie_backend() == trie_backend) {
+    prism_->Close();
+    // the weights are updated in a copy, as the prism may be in use.
+    Prism prism(BuildCache::TempFilePath(target_path));
+    std::error_code ec;
+    std::filesystem::copy_file(target_path, prism.file_path(), ec);
+    if (!ec && prism.UpdateWeights(syllable_weights, dict_file_checksum,
+                                   schema_file_checksum) &&
+        install_built_file(&prism, target_path)) {
+      LOG(INFO) << "reuse existing prism: " << target_path;
+      BuildCache::Store(target_path,
+                        {dict_file_checksum, schema_file_checksum});
+      return true;
+    }
+    prism.Close();
+    std::filesystem::remove(prism.file_path(), ec);
+  }
+  prism_ = New<Prism>(BuildCache::TempFilePath(target_path));
+  prism_->set_source_checksums(syllabary_checksum, algebra_checksum);
+  prism_->set_trie_backend(trie_backend);
+  // apply spelling algebra and prepare corrections (if enabled)
+  Script script;
+  if (!schema_file.empty()) {
     Projection p;
-    auto algebra = config.GetList("speller/algebra");
     if (algebra && p.Load(algebra)) {
       for (const auto& x : syllabary) {
         script.AddSyllable(x);
@@ -349,18 +665,24 @@ bool DictCompiler::BuildPrism(const path& schema_file,
 #endif
   }
   if ((options_ & kDump) && !script.empty()) {
-    path dump_path(prism_->file_path());
+    path dump_path(target_path);
     dump_path.replace_extension(".txt");
     script.Dump(dump_path);
   }
   // build .prism.bin
   {
-    prism_->Remove();
     if (!prism_->Build(syllabary, script.empty() ? nullptr : &script,
-                       dict_file_checksum, schema_file_checksum) ||
+                       dict_file_checksum, schema_file_checksum,
+                       &syllable_weights) ||
         !prism_->Save()) {
+      prism_->Remove();
+      return false;
+    }
+    if (!install_built_file(prism_.get(), target_path)) {
       return false;
     }
+    prism_ = New<Prism>(target_path);
+    BuildCache::Store(target_path, {dict_file_checksum, schema_file_checksum});
   }
 
   return true;
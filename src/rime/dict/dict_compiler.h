@@ -7,6 +7,7 @@
 #ifndef RIME_DICT_COMPILER_H_
 #define RIME_DICT_COMPILER_H_
 
+#include <future>
 #include <rime_api.h>
 #include <rime/common.h>
 
@@ -21,6 +22,7 @@ class EditDistanceCorrector;
 class EntryCollector;
 class Vocabulary;
 class ResourceResolver;
+class WorkerPool;
 
 class DictCompiler {
  public:
@@ -37,19 +39,40 @@ class DictCompiler {
   RIME_API bool Compile(const path& schema_file);
   void set_options(int options) { options_ = options; }
 
+  // beyond this many bytes of entries, tables are built from entries
+  // sorted on disk; 0 (the default) keeps all entries in memory.
+  RIME_API static void set_memory_limit(size_t memory_limit);
+  static size_t memory_limit();
+
  private:
   bool BuildTable(int table_index,
                   EntryCollector& collector,
                   DictSettings* settings,
                   const vector<path>& dict_files,
                   uint32_t dict_file_checksum);
+  // builds the table from entries sorted in runs on disk, for compiling
+  // large dictionaries within the memory limit.
+  bool BuildTableFromSortedRuns(int table_index,
+                                EntryCollector& collector,
+                                DictSettings* settings,
+                                const path& target_path,
+                                uint32_t dict_file_checksum);
+  // builds a pack table against the syllabary of the primary table.
+  void BuildPack(int table_index,
+                 const set<string>& syllabary,
+                 uint32_t syllabary_checksum);
   bool BuildPrism(const path& schema_file,
                   uint32_t dict_file_checksum,
                   uint32_t schema_file_checksum);
+  // copies files built by others from the same sources from the build cache.
+  bool FetchTable(int table_index, uint32_t dict_file_checksum);
+  bool FetchPrism(uint32_t dict_file_checksum, uint32_t schema_file_checksum);
   bool BuildReverseDb(DictSettings* settings,
                       const EntryCollector& collector,
                       const Vocabulary& vocabulary,
                       uint32_t dict_file_checksum);
+  // runs a build stage on the pool, or on the spot if there is none.
+  std::future<void> RunStage(function<void()> stage);
 
   const string& dict_name_;
   const vector<string>& packs_;
@@ -59,6 +82,7 @@ class DictCompiler {
   int options_ = 0;
   the<ResourceResolver> source_resolver_;
   the<ResourceResolver> target_resolver_;
+  the<WorkerPool> pool_;
 };
 
 }  // namespace rime
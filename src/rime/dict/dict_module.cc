@@ -10,11 +10,14 @@
 #include <rime/registry.h>
 #include <rime/dict/db.h>
 #include <rime/dict/level_db.h>
+#include <rime/dict/lmdb_db.h>
+#include <rime/dict/sorted_db.h>
 #include <rime/dict/table_db.h>
 #include <rime/dict/text_db.h>
 #include <rime/dict/user_db.h>
 #include <rime/dict/corrector.h>
 #include <rime/dict/dictionary.h>
+#include <rime/dict/next_word_index.h>
 #include <rime/dict/reverse_lookup_dictionary.h>
 #include <rime/dict/user_dictionary.h>
 #include <rime/dict/user_db_recovery_task.h>
@@ -27,8 +30,12 @@ static void rime_dict_initialize() {
 
   r.Register("tabledb", new DbComponent<TableDb>);
   r.Register("stabledb", new DbComponent<StableDb>);
+  r.Register("sorteddb", new DbComponent<SortedDb>);
   r.Register("plain_userdb", new UserDbComponent<TextDb>);
   r.Register("userdb", new UserDbComponent<LevelDb>);
+#ifdef RIME_ENABLE_LMDB
+  r.Register("lmdb_userdb", new UserDbComponent<LmdbDb>);
+#endif
   // NOTE: register a legacy_userdb component in your plugin if you wish to
   // upgrade userdbs from an old file format (eg. TreeDb) during maintenance.
   // r.Register("legacy_userdb", ...);
@@ -38,6 +45,7 @@ static void rime_dict_initialize() {
   r.Register("dictionary", new DictionaryComponent);
   r.Register("reverse_lookup_dictionary", new ReverseLookupDictionaryComponent);
   r.Register("user_dictionary", new UserDictionaryComponent);
+  r.Register("next_word_index", new NextWordIndexComponent);
 
   r.Register("userdb_recovery_task", new UserDbRecoveryTaskComponent);
 }
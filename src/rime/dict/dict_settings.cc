@@ -76,6 +76,10 @@ double DictSettings::min_phrase_weight() {
   return (*this)["min_phrase_weight"].ToDouble();
 }
 
+bool DictSettings::compact_entries() {
+  return (*this)["compact_entries"].ToBool();
+}
+
 an<ConfigList> DictSettings::GetTables() {
   if (empty())
     return nullptr;
@@ -26,6 +26,7 @@ class DictSettings : public Config {
   bool use_rule_based_encoder();
   int max_phrase_length();
   double min_phrase_weight();
+  bool compact_entries();
   an<ConfigList> GetTables();
   int GetColumnIndex(const string& column_label);
 };
@@ -4,14 +4,25 @@
 //
 // 2011-07-05 GONG Chen <chen.sst@gmail.com>
 //
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
 #include <filesystem>
+#include <iterator>
+#include <rime/algo/encoder.h>
 #include <rime/algo/syllabifier.h>
+#include <rime/cancellation.h>
 #include <rime/common.h>
 #include <rime/dict/dictionary.h>
+#include <rime/dict/tsv.h>
+#include <rime/perf_counters.h>
 #include <rime/resource.h>
 #include <rime/schema.h>
 #include <rime/service.h>
 #include <rime/ticket.h>
+#include <rime/worker_pool.h>
 #include <utility>
 
 namespace rime {
@@ -22,11 +33,19 @@ struct Chunk {
   Table* table = nullptr;
   Code code;
   const table::Entry* entries = nullptr;
+  // compact entries are stored in columns instead
+  const table::StringType* texts = nullptr;
+  const table::QuantizedWeight* weights = nullptr;
   size_t size = 0;
   size_t cursor = 0;
   string remaining_code;  // for predictive queries
   size_t matching_code_size = 0;
   double credibility = 0.0;
+  bool is_correction = false;
+  // the ranked entries of a node of a code trie, completing a prefix of
+  // prefix_length with different codes.
+  const table::RankedEntry* ranked = nullptr;
+  size_t prefix_length = 0;
 
   Chunk() = default;
   Chunk(Table* t,
@@ -47,68 +66,214 @@ struct Chunk {
       : table(t),
         code(a.index_code()),
         entries(a.entry()),
+        texts(a.quantized_weights() ? a.entry_text() : nullptr),
+        weights(a.quantized_weights()),
         size(a.remaining()),
         cursor(0),
         remaining_code(r),
         matching_code_size(a.index_code().size()),
         credibility(cr) {}
 
+  // the entries of a code trie node, each with its own code.
+  Chunk(Table* t, const table::CodeTrieNode& node, size_t length)
+      : table(t),
+        size(node.entries.size),
+        cursor(0),
+        matching_code_size(1),
+        ranked(node.entries.at.get()),
+        prefix_length(length) {
+    code.resize(1);
+    Seek(0);
+  }
+
+  bool has_entry() const {
+    return (entries || texts || ranked) && cursor < size;
+  }
+
+  // moves to the entry at pos, taking the code of a ranked entry.
+  void Seek(size_t pos) {
+    cursor = pos;
+    if (!ranked || cursor >= size)
+      return;
+    SyllableId syllable_id = ranked[cursor].syllable_id;
+    // the same code as the entry before
+    if (cursor > 0 && code[0] == syllable_id)
+      return;
+    code[0] = syllable_id;
+    string syllable = table->GetSyllableById(syllable_id);
+    remaining_code.assign(syllable, (std::min)(prefix_length,
+                                               syllable.length()));
+  }
+
+  const table::StringType& text() const {
+    return ranked  ? ranked[cursor].text
+           : texts ? texts[cursor]
+                   : entries[cursor].text;
+  }
+
+  double weight() const {
+    return ranked    ? ranked[cursor].weight
+           : weights ? table::DequantizeWeight(weights[cursor])
+                     : entries[cursor].weight;
+  }
+
   bool is_exact_match() const { return matching_code_size == code.size(); }
 
   bool is_predictive_match() const { return matching_code_size < code.size(); }
 };
 
+// the chunks found by a lookup, grouped by end position.
 struct QueryResult {
   vector<Chunk> chunks;
+  // binary heaps of chunk indices, each at the offset of its range of
+  // chunks; of the same size as chunks.
+  vector<size_t> heap;
+  // the tables the chunks refer to.
+  vector<of<Table>> tables;
 };
 
+// chunks found in the tables, with their end positions.
+using FoundChunks = vector<std::pair<size_t, Chunk>>;
+
 bool compare_chunk_by_head_element(const Chunk& a, const Chunk& b) {
-  if (!a.entries || a.cursor >= a.size)
+  if (!a.has_entry())
     return false;
-  if (!b.entries || b.cursor >= b.size)
+  if (!b.has_entry())
     return true;
   if (a.is_exact_match() != b.is_exact_match())
     return a.is_exact_match() > b.is_exact_match();
   if (a.remaining_code.length() != b.remaining_code.length())
     return a.remaining_code.length() < b.remaining_code.length();
-  return a.credibility + a.entries[a.cursor].weight >
-         b.credibility + b.entries[b.cursor].weight;  // by weight desc
+  return a.credibility + a.weight() >
+         b.credibility + b.weight();  // by weight desc
 }
 
 struct CodeMatch {
   bool success;
   size_t depth;
   size_t end_pos;
+  bool is_correction;
 };
 
-CodeMatch match_extra_code(const table::Code* extra_code,
-                           size_t depth,
-                           const SyllableGraph& syll_graph,
-                           size_t current_pos,
-                           bool predict_word) {
-  const CodeMatch kFailed{false, 0, 0};
-  if (!extra_code || depth >= extra_code->size)
-    return {true, depth, current_pos};
-  if (current_pos >= syll_graph.interpreted_length) {
-    if (predict_word)
-      return {true, depth, syll_graph.interpreted_length};
-    else
-      return kFailed;
-  }
-  auto index = syll_graph.indices.find(current_pos);
-  if (index == syll_graph.indices.end())
-    return kFailed;
-  SyllableId current_syll_id = extra_code->at[depth];
-  auto spellings = index->second.find(current_syll_id);
-  if (spellings == index->second.end())
-    return kFailed;
+// Matches the extra code of long entries against the syllable graph, from
+// a start position to the farthest end position, or to the end of the
+// input if predicting words.
+//
+// The positions reachable by each syllable from a vertex are looked up
+// once per query. Rather than trying each path through the graph, the
+// positions reached after each syllable of the code are kept as a set;
+// the sets found for the last code are reused for a code sharing a prefix
+// with it. A position is marked if each path to it takes a corrected
+// spelling.
+class ExtraCodeMatcher {
+ public:
+  ExtraCodeMatcher(const SyllableGraph& syll_graph, bool predict_word)
+      : syll_graph_(syll_graph), predict_word_(predict_word) {}
+
+  CodeMatch Match(const table::Code* extra_code, size_t start_pos);
+
+ private:
+  // positions are stored with the mark in the lowest bit, so that a clean
+  // path to a position sorts before a corrected one.
+  static size_t Mark(size_t pos, bool is_correction) {
+    return (pos << 1) | size_t(is_correction);
+  }
+  static size_t Position(size_t marked) { return marked >> 1; }
+  static bool IsCorrection(size_t marked) { return marked & 1; }
+
+  const vector<size_t>& EndPositions(SyllableId syllable_id, size_t pos);
+
+  const SyllableGraph& syll_graph_;
+  bool predict_word_;
+  hash_map<uint64_t, vector<size_t>> end_positions_;
+  // the last code matched, and the positions reached after each syllable.
+  size_t last_start_pos_ = 0;
+  vector<SyllableId> last_code_;
+  vector<vector<size_t>> reached_;
+};
+
+const vector<size_t>& ExtraCodeMatcher::EndPositions(SyllableId syllable_id,
+                                                     size_t pos) {
+  uint64_t key = (uint64_t(pos) << 32) | uint32_t(syllable_id);
+  auto found = end_positions_.find(key);
+  if (found != end_positions_.end())
+    return found->second;
+  auto& end_positions = end_positions_[key];
+  auto index = syll_graph_.indices.find(pos);
+  if (index != syll_graph_.indices.end()) {
+    auto spellings = index->second.find(syllable_id);
+    if (spellings != index->second.end()) {
+      for (const EdgeProperties* props : spellings->second) {
+        end_positions.push_back(Mark(props->end_pos, props->is_correction));
+      }
+    }
+  }
+  return end_positions;
+}
+
+CodeMatch ExtraCodeMatcher::Match(const table::Code* extra_code,
+                                  size_t start_pos) {
+  const CodeMatch kFailed{false, 0, 0, false};
+  if (!extra_code || extra_code->size == 0)
+    return {true, 0, start_pos, false};
+  size_t code_size = extra_code->size;
+  size_t common = 0;
+  if (start_pos == last_start_pos_ && !reached_.empty()) {
+    size_t max_common = (std::min)(code_size, last_code_.size());
+    while (common < max_common && last_code_[common] == extra_code->at[common])
+      ++common;
+  } else {
+    last_code_.clear();
+    reached_.assign(1, vector<size_t>{Mark(start_pos, false)});
+    last_start_pos_ = start_pos;
+  }
+  last_code_.resize(common);
+  reached_.resize(common + 1);
+  const size_t interpreted_length = syll_graph_.interpreted_length;
   CodeMatch best_match = kFailed;
-  for (const SpellingProperties* props : spellings->second) {
-    CodeMatch match = match_extra_code(extra_code, depth + 1, syll_graph,
-                                       props->end_pos, predict_word);
-    if (!match.success)
+  // the farthest match wins; of those ending at the same position, the one
+  // matching more of the code.
+  auto better = [&best_match](const CodeMatch& match) {
+    return !best_match.success || match.end_pos > best_match.end_pos ||
+           (match.end_pos == best_match.end_pos &&
+            match.depth > best_match.depth);
+  };
+  for (size_t depth = 0; depth < code_size; ++depth) {
+    const auto& current = reached_[depth];
+    // words are predicted from the positions past the end of the input.
+    if (predict_word_ && !current.empty() &&
+        Position(current.back()) >= interpreted_length) {
+      CodeMatch match{true, depth, interpreted_length,
+                      IsCorrection(current.back())};
+      if (better(match))
+        best_match = match;
+    }
+    if (depth < common)
       continue;
-    if (match.end_pos > best_match.end_pos)
+    SyllableId syllable_id = extra_code->at[depth];
+    vector<size_t> next;
+    for (size_t marked : current) {
+      size_t pos = Position(marked);
+      if (pos >= interpreted_length)
+        break;
+      for (size_t end : EndPositions(syllable_id, pos)) {
+        next.push_back(end | (marked & 1));
+      }
+    }
+    std::sort(next.begin(), next.end());
+    next.erase(std::unique(next.begin(), next.end(),
+                           [](size_t a, size_t b) {
+                             return Position(a) == Position(b);
+                           }),
+               next.end());
+    last_code_.push_back(syllable_id);
+    reached_.push_back(std::move(next));
+  }
+  const auto& complete = reached_[code_size];
+  if (!complete.empty()) {
+    CodeMatch match{true, code_size, Position(complete.back()),
+                    IsCorrection(complete.back())};
+    if (better(match))
       best_match = match;
   }
   return best_match;
@@ -116,43 +281,215 @@ CodeMatch match_extra_code(const table::Code* extra_code,
 
 }  // namespace dictionary
 
-DictEntryIterator::DictEntryIterator()
-    : query_result_(New<dictionary::QueryResult>()) {}
+string DictEntryView::text() const {
+  return chunk_.table->GetEntryText(chunk_.text());
+}
+
+double DictEntryView::weight() const {
+  const double kS = 18.420680743952367;  // log(1e8)
+  return chunk_.weight() - kS + chunk_.credibility;
+}
+
+const Code& DictEntryView::code() const {
+  return chunk_.code;
+}
+
+bool DictEntryView::IsExactMatch() const {
+  return chunk_.is_exact_match();
+}
+
+bool DictEntryView::IsPredictiveMatch() const {
+  return chunk_.is_predictive_match();
+}
+
+// orders the heap of chunk indices so that the chunk with the best head
+// element comes on top; ties go to the chunk added first.
+struct DictEntryIterator::HeapCompare {
+  const vector<dictionary::Chunk>* chunks = nullptr;
+
+  bool operator()(size_t a, size_t b) const {
+    const auto& x = (*chunks)[a];
+    const auto& y = (*chunks)[b];
+    if (dictionary::compare_chunk_by_head_element(y, x))
+      return true;
+    if (dictionary::compare_chunk_by_head_element(x, y))
+      return false;
+    return b < a;
+  }
+};
+
+DictEntryIterator::HeapCompare DictEntryIterator::heap_compare() const {
+  return HeapCompare{&query_result_->chunks};
+}
+
+size_t* DictEntryIterator::heap() const {
+  return query_result_->heap.data() + chunk_begin_;
+}
+
+DictEntryIterator::DictEntryIterator() = default;
+
+DictEntryIterator::DictEntryIterator(an<dictionary::QueryResult> query_result,
+                                     size_t chunk_begin,
+                                     size_t chunk_end)
+    : query_result_(std::move(query_result)),
+      chunk_begin_(chunk_begin),
+      chunk_end_(chunk_end),
+      chunk_index_(chunk_begin) {
+  for (size_t i = chunk_begin; i < chunk_end; ++i) {
+    entry_count_ += query_result_->chunks[i].size;
+  }
+}
+
+DictEntryIterator::DictEntryIterator(const DictEntryIterator& other)
+    : DictEntryFilterBinder(other),
+      query_result_(other.query_result_),
+      chunk_begin_(other.chunk_begin_),
+      chunk_end_(other.chunk_end_),
+      chunk_index_(other.chunk_index_),
+      sorted_(other.sorted_),
+      heap_size_(other.heap_size_),
+      // the current entry is made anew, not to share its comment or preedit
+      // with the original.
+      entry_count_(other.entry_count_),
+      arena_(other.arena_),
+      view_filter_(other.view_filter_) {
+  Detach();
+}
+
+DictEntryIterator& DictEntryIterator::operator=(
+    const DictEntryIterator& other) {
+  if (this != &other) {
+    *this = DictEntryIterator(other);
+  }
+  return *this;
+}
+
+void DictEntryIterator::Detach() {
+  if (!query_result_)
+    return;
+  const auto& source = *query_result_;
+  auto detached = New<dictionary::QueryResult>();
+  detached->chunks.assign(source.chunks.begin() + chunk_begin_,
+                          source.chunks.begin() + chunk_end_);
+  detached->heap.resize(detached->chunks.size());
+  for (size_t i = 0; i < heap_size_; ++i) {
+    detached->heap[i] = source.heap[chunk_begin_ + i] - chunk_begin_;
+  }
+  detached->tables = source.tables;
+  query_result_ = std::move(detached);
+  chunk_index_ -= chunk_begin_;
+  chunk_end_ -= chunk_begin_;
+  chunk_begin_ = 0;
+}
 
 void DictEntryIterator::AddChunk(dictionary::Chunk&& chunk) {
-  query_result_->chunks.push_back(std::move(chunk));
+  if (!query_result_) {
+    query_result_ = New<dictionary::QueryResult>();
+  } else if (chunk_end_ != query_result_->chunks.size()) {
+    // the range cannot grow into that of another iterator.
+    Detach();
+  }
   entry_count_ += chunk.size;
+  query_result_->chunks.push_back(std::move(chunk));
+  query_result_->heap.push_back(0);
+  ++chunk_end_;
+  if (sorted_) {
+    heap()[heap_size_++] = chunk_end_ - 1;
+    std::push_heap(heap(), heap() + heap_size_, heap_compare());
+  }
+}
+
+void DictEntryIterator::AddChunks(DictEntryIterator&& other) {
+  if (!other.query_result_)
+    return;
+  auto& chunks = other.query_result_->chunks;
+  for (size_t i = other.chunk_begin_; i < other.chunk_end_; ++i) {
+    AddChunk(std::move(chunks[i]));
+  }
+  HoldTables(other.query_result_->tables);
+  other.chunk_index_ = other.chunk_end_ = other.chunk_begin_;
+  other.heap_size_ = 0;
+  other.entry_count_ = 0;
+}
+
+void DictEntryIterator::HoldTables(const vector<of<Table>>& tables) {
+  if (!query_result_)
+    query_result_ = New<dictionary::QueryResult>();
+  auto& held = query_result_->tables;
+  for (const auto& table : tables) {
+    if (std::find(held.begin(), held.end(), table) == held.end())
+      held.push_back(table);
+  }
 }
 
 void DictEntryIterator::Sort() {
-  auto& chunks = query_result_->chunks;
-  // partial-sort remaining chunks, move best match to chunk_index_
-  std::partial_sort(chunks.begin() + chunk_index_,
-                    chunks.begin() + chunk_index_ + 1, chunks.end(),
-                    dictionary::compare_chunk_by_head_element);
+  if (!query_result_)
+    return;
+  const auto& chunks = query_result_->chunks;
+  size_t* heap = this->heap();
+  if (!sorted_) {
+    // from now on, chunks are merged by a binary heap
+    heap_size_ = 0;
+    for (size_t i = chunk_index_; i < chunk_end_; ++i) {
+      heap[heap_size_++] = i;
+    }
+    sorted_ = true;
+  }
+  heap_size_ = std::remove_if(heap, heap + heap_size_,
+                              [&chunks](size_t i) {
+                                return chunks[i].cursor >= chunks[i].size;
+                              }) -
+               heap;
+  std::make_heap(heap, heap + heap_size_, heap_compare());
 }
 
 void DictEntryIterator::AddFilter(DictEntryFilter filter) {
   DictEntryFilterBinder::AddFilter(filter);
   // the introduced filter could invalidate the current or even all the
   // remaining entries
-  while (!exhausted() && !filter_(Peek())) {
+  while (!exhausted() && !AcceptsCurrentEntry()) {
+    FindNextEntry();
+  }
+}
+
+void DictEntryIterator::AddViewFilter(DictEntryViewFilter filter) {
+  if (!view_filter_) {
+    view_filter_.swap(filter);
+  } else {
+    DictEntryViewFilter previous_filter(std::move(view_filter_));
+    view_filter_ = [previous_filter, filter](const DictEntryView& e) {
+      return previous_filter(e) && filter(e);
+    };
+  }
+  while (!exhausted() && !AcceptsCurrentEntry()) {
     FindNextEntry();
   }
 }
 
+bool DictEntryIterator::AcceptsCurrentEntry() {
+  return (!view_filter_ || view_filter_(PeekView())) &&
+         (!filter_ || filter_(Peek()));
+}
+
+size_t DictEntryIterator::current_chunk() const {
+  return sorted_ ? heap()[0] : chunk_index_;
+}
+
+DictEntryView DictEntryIterator::PeekView() const {
+  const auto& chunk = query_result_->chunks[current_chunk()];
+  return DictEntryView(chunk);
+}
+
 an<DictEntry> DictEntryIterator::Peek() {
   if (!entry_ && !exhausted()) {
     // get next entry from current chunk
-    const auto& chunk = query_result_->chunks[chunk_index_];
-    const auto& e = chunk.entries[chunk.cursor];
-    DLOG(INFO) << "creating temporary dict entry '"
-               << chunk.table->GetEntryText(e) << "'.";
-    entry_ = New<DictEntry>();
+    const auto& chunk = query_result_->chunks[current_chunk()];
+    DictEntryView view = PeekView();
+    DLOG(INFO) << "creating temporary dict entry '" << view.text() << "'.";
+    entry_ = NewIn<DictEntry>(arena_);
     entry_->code = chunk.code;
-    entry_->text = chunk.table->GetEntryText(e);
-    const double kS = 18.420680743952367;  // log(1e8)
-    entry_->weight = e.weight - kS + chunk.credibility;
+    entry_->text = view.text();
+    entry_->weight = view.weight();
     if (!chunk.remaining_code.empty()) {
       entry_->comment = "~" + chunk.remaining_code;
       entry_->remaining_code_length = chunk.remaining_code.length();
@@ -160,6 +497,7 @@ an<DictEntry> DictEntryIterator::Peek() {
     if (chunk.is_predictive_match()) {
       entry_->matching_code_size = chunk.matching_code_size;
     }
+    entry_->is_correction = chunk.is_correction;
   }
   return entry_;
 }
@@ -168,24 +506,40 @@ bool DictEntryIterator::FindNextEntry() {
   if (exhausted()) {
     return false;
   }
-  auto& chunk = query_result_->chunks[chunk_index_];
-  if (++chunk.cursor >= chunk.size) {
+  entry_.reset();
+  auto& chunks = query_result_->chunks;
+  if (sorted_) {
+    // advance the chunk on top and let it sink to its place
+    auto compare = heap_compare();
+    size_t* heap = this->heap();
+    std::pop_heap(heap, heap + heap_size_, compare);
+    auto& chunk = chunks[heap[heap_size_ - 1]];
+    chunk.Seek(chunk.cursor + 1);
+    if (chunk.cursor >= chunk.size) {
+      --heap_size_;
+    } else {
+      std::push_heap(heap, heap + heap_size_, compare);
+    }
+    return !exhausted();
+  }
+  auto& chunk = chunks[chunk_index_];
+  chunk.Seek(chunk.cursor + 1);
+  if (chunk.cursor >= chunk.size) {
     ++chunk_index_;
   }
   if (exhausted()) {
     return false;
   }
-  // reorder chunks to move the one with the best entry to head
+  // move the chunk with the best entry to head
   Sort();
-  return true;
+  return !exhausted();
 }
 
 bool DictEntryIterator::Next() {
-  entry_.reset();
   if (!FindNextEntry()) {
     return false;
   }
-  while (filter_ && !filter_(Peek())) {
+  while (!AcceptsCurrentEntry()) {
     if (!FindNextEntry()) {
       return false;
     }
@@ -195,12 +549,20 @@ bool DictEntryIterator::Next() {
 
 // Note: does not apply filters
 bool DictEntryIterator::Skip(size_t num_entries) {
+  entry_.reset();
+  if (sorted_) {
+    for (; num_entries > 0; --num_entries) {
+      if (!FindNextEntry())
+        return false;
+    }
+    return true;
+  }
   while (num_entries > 0) {
     if (exhausted())
       return false;
     auto& chunk = query_result_->chunks[chunk_index_];
     if (chunk.cursor + num_entries < chunk.size) {
-      chunk.cursor += num_entries;
+      chunk.Seek(chunk.cursor + num_entries);
       return true;
     }
     num_entries -= (chunk.size - chunk.cursor);
@@ -210,11 +572,140 @@ bool DictEntryIterator::Skip(size_t num_entries) {
 }
 
 bool DictEntryIterator::exhausted() const {
-  return chunk_index_ >= query_result_->chunks.size();
+  return sorted_ ? heap_size_ == 0 : chunk_index_ >= chunk_end_;
+}
+
+// DictionaryOverlay members
+
+DictionaryOverlay::~DictionaryOverlay() {
+  for (const auto& table : retired_tables_) {
+    table->Remove();
+  }
+  if (table_)
+    table_->Remove();
+}
+
+an<Table> DictionaryOverlay::table(const Table* primary_table) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!primary_table || primary_table->image_id() != primary_image_id_)
+    return nullptr;
+  return table_;
+}
+
+bool DictionaryOverlay::Rebase(Table* primary_table) {
+  path file_path;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!table_ || !primary_table ||
+        primary_table->image_id() == primary_image_id_)
+      return true;
+    file_path = file_path_;
+  }
+  LOG(INFO) << "loading the overlay of '" << name_ << "' for a new table.";
+  return Load(file_path, primary_table);
+}
+
+static path overlay_file_path(const string& name) {
+  static std::atomic<int> serial_number{0};
+  std::error_code ec;
+  path dir = std::filesystem::temp_directory_path(ec);
+  string file_name = "rime." + name + ".overlay." +
+                     std::to_string(std::chrono::steady_clock::now()
+                                        .time_since_epoch()
+                                        .count()) +
+                     "." + std::to_string(serial_number++) + ".table.bin";
+  return ec ? path(file_name) : dir / file_name;
+}
+
+bool DictionaryOverlay::Load(const path& tsv_file, Table* primary_table) {
+  Syllabary syllabary;
+  if (!primary_table || !primary_table->GetSyllabary(&syllabary)) {
+    LOG(ERROR) << "the table of dictionary '" << name_ << "' is not loaded.";
+    return false;
+  }
+  map<string, SyllableId> syllable_to_id;
+  SyllableId syllable_id = 0;
+  for (const auto& s : syllabary) {
+    syllable_to_id[s] = syllable_id++;
+  }
+  TsvLineReader reader(tsv_file);
+  if (!reader.Open()) {
+    LOG(ERROR) << "error opening overlay file: " << tsv_file;
+    return false;
+  }
+  Vocabulary vocabulary;
+  size_t num_entries = 0;
+  std::string_view line;
+  TsvFields row;
+  while (reader.ReadLine(&line)) {
+    if (line.empty() || line[0] == '#')
+      continue;
+    TsvLineReader::Split(line, &row);
+    Code code;
+    if (row.size() >= 2 && !row[0].empty()) {
+      RawCode raw_code;
+      raw_code.FromString(string(row[1]));
+      for (const auto& s : raw_code) {
+        auto found = syllable_to_id.find(s);
+        if (found == syllable_to_id.end()) {
+          code.clear();
+          break;
+        }
+        code.push_back(found->second);
+      }
+    }
+    auto ls = code.empty() ? nullptr : vocabulary.LocateEntries(code);
+    if (!ls) {
+      LOG(WARNING) << "invalid overlay entry at line " << reader.line_number()
+                   << " in file: " << tsv_file;
+      continue;
+    }
+    auto e = New<ShortDictEntry>();
+    e->text = string(row[0]);
+    e->code.swap(code);
+    double weight = row.size() > 2 ? std::atof(string(row[2]).c_str()) : 0.0;
+    e->weight = log(weight > 0 ? weight : DBL_EPSILON);
+    ls->push_back(e);
+    ++num_entries;
+  }
+  vocabulary.SortHomophones();
+  auto table = New<Table>(overlay_file_path(name_));
+  if (!table->Build(syllabary, vocabulary, num_entries, 0) || !table->Save() ||
+      !table->Load()) {
+    LOG(ERROR) << "error building overlay of dictionary '" << name_ << "'.";
+    table->Remove();
+    return false;
+  }
+  // the file stays mapped after it is gone, where the system allows it;
+  // otherwise it is removed along with the overlay.
+  std::error_code ec;
+  std::filesystem::remove(table->file_path(), ec);
+  LOG(INFO) << "loaded " << num_entries << " entries into the overlay of '"
+            << name_ << "'.";
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (table_)
+    retired_tables_.push_back(std::move(table_));
+  table_ = std::move(table);
+  file_path_ = tsv_file;
+  primary_image_id_ = primary_table->image_id();
+  return true;
 }
 
 // Dictionary members
 
+static std::mutex& load_mutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+// a pack with a syllable filter is mapped by the first lookup passing it;
+// returns true if the pack is to be deferred so.
+static bool defer_pack(Table* table) {
+  if (table->IsOpen() || !table->Exists())
+    return false;
+  return table->has_syllable_filter() || table->LoadSyllableFilter();
+}
+
 Dictionary::Dictionary(string name,
                        vector<string> packs,
                        vector<of<Table>> tables,
@@ -222,64 +713,162 @@ Dictionary::Dictionary(string name,
     : name_(name),
       packs_(std::move(packs)),
       tables_(std::move(tables)),
-      prism_(std::move(prism)) {}
+      prism_(std::move(prism)),
+      table_query_caches_(tables_.size()),
+      deferred_tables_(tables_.size()) {}
 
 Dictionary::~Dictionary() {
   // should not close shared table and prism objects
 }
 
 static void lookup_table(Table* table,
-                         DictEntryCollector* collector,
+                         TableQueryCache* cache,
+                         dictionary::FoundChunks* found,
                          const SyllableGraph& syllable_graph,
                          size_t start_pos,
                          bool predict_word,
                          double initial_credibility) {
   TableQueryResult result;
-  if (!table->Query(syllable_graph, start_pos, &result)) {
+  if (!table->Query(syllable_graph, start_pos, &result, cache)) {
     return;
   }
   // copy result
+  size_t chunks = 0;
+  dictionary::ExtraCodeMatcher extra_code_matcher(syllable_graph, predict_word);
   for (auto& v : result) {
     size_t end_pos = v.first;
     for (TableAccessor& a : v.second) {
       double cr = initial_credibility + a.credibility();
       if (a.extra_code()) {
         do {
-          dictionary::CodeMatch match = dictionary::match_extra_code(
-              a.extra_code(), 0, syllable_graph, end_pos, predict_word);
+          dictionary::CodeMatch match =
+              extra_code_matcher.Match(a.extra_code(), end_pos);
           if (!match.success)
             continue;
           size_t matching_code_size = a.index_code().size() + match.depth;
-          (*collector)[match.end_pos].AddChunk(
-              {table, a.code(), a.entry(), matching_code_size, cr});
+          found->emplace_back(
+              match.end_pos,
+              dictionary::Chunk{table, a.code(), a.entry(),
+                                matching_code_size, cr});
+          found->back().second.is_correction =
+              a.is_correction() || match.is_correction;
+          ++chunks;
         } while (a.Next());
       } else {
-        (*collector)[end_pos].AddChunk({table, a, cr});
+        found->emplace_back(end_pos, dictionary::Chunk{table, a, cr});
+        found->back().second.is_correction = a.is_correction();
+        ++chunks;
       }
     }
   }
+  PerfCounters::Count(PerfCounters::kTableChunksScanned, chunks);
+}
+
+// moves the chunks found into one buffer, grouped by end position in the
+// order they were found, and makes an iterator for each group.
+static an<DictEntryCollector> collect_chunks(dictionary::FoundChunks* found,
+                                             const vector<of<Table>>& tables,
+                                             const an<Arena>& arena) {
+  // the end of the range of chunks at each end position, counted first.
+  thread_local vector<size_t> range_end;
+  range_end.clear();
+  for (const auto& x : *found) {
+    if (x.first >= range_end.size())
+      range_end.resize(x.first + 1, 0);
+    ++range_end[x.first];
+  }
+  size_t total = 0;
+  for (auto& n : range_end) {
+    size_t count = n;
+    n = total;
+    total += count;
+  }
+  auto query_result = New<dictionary::QueryResult>();
+  query_result->chunks.resize(total);
+  query_result->heap.resize(total);
+  query_result->tables = tables;
+  for (auto& x : *found) {
+    query_result->chunks[range_end[x.first]++] = std::move(x.second);
+  }
+  found->clear();
+  auto collector = New<DictEntryCollector>();
+  collector->reserve(range_end.size());
+  size_t range_begin = 0;
+  for (size_t end_pos = 0; end_pos < range_end.size(); ++end_pos) {
+    if (range_end[end_pos] == range_begin)
+      continue;
+    auto& iter = (*collector)[end_pos];
+    iter = DictEntryIterator(query_result, range_begin, range_end[end_pos]);
+    // sort each group of equal code length
+    iter.Sort();
+    iter.set_arena(arena);
+    range_begin = range_end[end_pos];
+  }
+  return collector;
 }
 
 an<DictEntryCollector> Dictionary::Lookup(const SyllableGraph& syllable_graph,
                                           size_t start_pos,
                                           bool predict_word,
-                                          double initial_credibility) {
-  if (!loaded())
+                                          double initial_credibility,
+                                          an<Arena> arena) {
+  if (!loaded() || Cancellation::Requested())
     return nullptr;
-  auto collector = New<DictEntryCollector>();
-  for (const auto& table : tables_) {
-    if (!table->IsOpen())
-      continue;
-    lookup_table(table.get(), collector.get(), syllable_graph, start_pos,
-                 predict_word, initial_credibility);
+  PerfCounters::Count(PerfCounters::kDictionaryLookups);
+  // reused by the lookups on each thread, and emptied by collect_chunks().
+  thread_local dictionary::FoundChunks found;
+  // the query caches are not shared between threads. lookups on worker
+  // threads, which may run for several positions at once, go without them.
+  bool concurrent = WorkerPool::OnWorkerThread();
+  bool parallel = !concurrent && parallel_lookup_min_length_ > 0 &&
+                  tables_.size() > 1 &&
+                  syllable_graph.interpreted_length >=
+                      start_pos + parallel_lookup_min_length_;
+  if (parallel) {
+    // look up packs on worker threads, and the primary table on this thread.
+    vector<dictionary::FoundChunks> pack_results(tables_.size());
+    vector<std::future<void>> pending;
+    for (size_t i = 1; i < tables_.size(); ++i) {
+      if (!PrepareTable(i, syllable_graph, start_pos))
+        continue;
+      Table* table = tables_[i].get();
+      TableQueryCache* cache = &table_query_caches_[i];
+      dictionary::FoundChunks* result = &pack_results[i];
+      pending.push_back(WorkerPool::Shared().Submit([=, &syllable_graph] {
+        lookup_table(table, cache, result, syllable_graph, start_pos,
+                     predict_word, initial_credibility);
+      }));
+    }
+    if (primary_table()->IsOpen()) {
+      lookup_table(primary_table().get(), &table_query_caches_[0], &found,
+                   syllable_graph, start_pos, predict_word,
+                   initial_credibility);
+    }
+    for (auto& task : pending) {
+      task.get();
+    }
+    // merge in the order of tables, as if looked up one after another
+    for (auto& pack_result : pack_results) {
+      std::move(pack_result.begin(), pack_result.end(),
+                std::back_inserter(found));
+    }
+  } else {
+    for (size_t i = 0; i < tables_.size(); ++i) {
+      if (!PrepareTable(i, syllable_graph, start_pos))
+        continue;
+      const auto& table = tables_[i];
+      lookup_table(table.get(), concurrent ? nullptr : &table_query_caches_[i],
+                   &found, syllable_graph, start_pos, predict_word,
+                   initial_credibility);
+    }
   }
-  if (collector->empty())
-    return nullptr;
-  // sort each group of equal code length
-  for (auto& v : *collector) {
-    v.second.Sort();
+  if (auto overlay_table = this->overlay_table()) {
+    lookup_table(overlay_table.get(), nullptr, &found, syllable_graph,
+                 start_pos, predict_word, initial_credibility);
   }
-  return collector;
+  if (found.empty())
+    return nullptr;
+  return collect_chunks(&found, tables_, arena);
 }
 
 size_t Dictionary::LookupWords(DictEntryIterator* result,
@@ -289,9 +878,15 @@ size_t Dictionary::LookupWords(DictEntryIterator* result,
   DLOG(INFO) << "lookup: " << str_code;
   if (!loaded())
     return 0;
+  PerfCounters::Count(PerfCounters::kDictionaryLookups);
+  size_t num_codes = 0;
+  if (predictive &&
+      LookupCompletions(result, str_code, expand_search_limit, &num_codes)) {
+    return num_codes;
+  }
   vector<Prism::Match> keys;
   if (predictive) {
-    prism_->ExpandSearch(str_code, &keys, expand_search_limit);
+    prism_->ExpandSearchByWeight(str_code, &keys, expand_search_limit);
   } else {
     Prism::Match match{0, 0};
     if (prism_->GetValue(str_code, &match.value)) {
@@ -299,7 +894,77 @@ size_t Dictionary::LookupWords(DictEntryIterator* result,
     }
   }
   DLOG(INFO) << "found " << keys.size() << " matching keys thru the prism.";
-  size_t code_length(str_code.length());
+  AddWords(result, keys, str_code.length());
+  return keys.size();
+}
+
+size_t Dictionary::LookupMoreWords(DictEntryIterator* result,
+                                   const string& str_code,
+                                   an<Prism::SearchState>* search,
+                                   size_t limit) {
+  if (!loaded() || !search)
+    return 0;
+  PerfCounters::Count(PerfCounters::kDictionaryLookups);
+  if (!*search)
+    *search = prism_->StartExpandSearch(str_code);
+  vector<Prism::Match> keys;
+  prism_->ResumeExpandSearch(search->get(), &keys, limit);
+  DLOG(INFO) << "found " << keys.size() << " more keys thru the prism.";
+  AddWords(result, keys, str_code.length());
+  return keys.size();
+}
+
+bool Dictionary::LookupCompletions(DictEntryIterator* result,
+                                   const string& str_code,
+                                   size_t limit,
+                                   size_t* num_codes) {
+  // the prefix in the trie is a spelling only if spelt as the code.
+  if (str_code.length() > table::kMaxCodeTriePrefixLength ||
+      !prism_->spells_syllables())
+    return false;
+  vector<Table*> tables;
+  for (size_t i = 0; i < tables_.size(); ++i) {
+    // the codes of a deferred pack are unknown until it is mapped.
+    if (deferred_tables_[i])
+      return false;
+    if (tables_[i]->IsOpen())
+      tables.push_back(tables_[i].get());
+  }
+  an<Table> overlay_table = this->overlay_table();
+  if (overlay_table)
+    tables.push_back(overlay_table.get());
+  for (Table* table : tables) {
+    if (!table->has_code_trie())
+      return false;
+  }
+  // the tables share the syllabary of the primary table.
+  const table::CodeTrieNode* primary_node =
+      primary_table()->FindCodeTrieNode(str_code);
+  *num_codes = primary_node ? primary_node->num_codes : 0;
+  // the prism finds the heaviest of more codes, which may differ from
+  // the first in the ranking.
+  if (limit && *num_codes > limit)
+    return false;
+  result->HoldTables(tables_);
+  size_t chunks = 0;
+  for (Table* table : tables) {
+    const auto* node = table->FindCodeTrieNode(str_code);
+    if (node && node->entries.size > 0) {
+      result->AddChunk({table, *node, str_code.length()});
+      ++chunks;
+    }
+  }
+  DLOG(INFO) << "found " << *num_codes << " codes in the code trie.";
+  PerfCounters::Count(PerfCounters::kTableChunksScanned, chunks);
+  return true;
+}
+
+void Dictionary::AddWords(DictEntryIterator* result,
+                          const vector<Prism::Match>& keys,
+                          size_t code_length) {
+  size_t chunks = 0;
+  an<Table> overlay_table = this->overlay_table();
+  result->HoldTables(tables_);
   for (auto& match : keys) {
     SpellingAccessor accessor(prism_->QuerySpelling(match.value));
     while (!accessor.exhausted()) {
@@ -314,18 +979,27 @@ size_t Dictionary::LookupWords(DictEntryIterator* result,
         if (syllable.length() > code_length)
           remaining_code = syllable.substr(code_length);
       }
-      for (const auto& table : tables_) {
-        if (!table->IsOpen())
+      for (size_t i = 0; i < tables_.size(); ++i) {
+        if (!PrepareTable(i, syllable_id))
           continue;
+        const auto& table = tables_[i];
         TableAccessor a = table->QueryWords(syllable_id);
         if (!a.exhausted()) {
           DLOG(INFO) << "remaining code: " << remaining_code;
           result->AddChunk({table.get(), a, remaining_code});
+          ++chunks;
+        }
+      }
+      if (overlay_table) {
+        TableAccessor a = overlay_table->QueryWords(syllable_id);
+        if (!a.exhausted()) {
+          result->AddChunk({overlay_table.get(), a, remaining_code});
+          ++chunks;
         }
       }
     }
   }
-  return keys.size();
+  PerfCounters::Count(PerfCounters::kTableChunksScanned, chunks);
 }
 
 bool Dictionary::Decode(const Code& code, vector<string>* result) {
@@ -363,6 +1037,9 @@ bool Dictionary::Load() {
                << "'; it contains no tables.";
     return false;
   }
+  // the tables and prism may be shared with dictionaries being loaded on
+  // other threads.
+  std::lock_guard<std::mutex> lock(load_mutex());
   auto& primary_table = tables_[0];
   if (!primary_table || (!primary_table->IsOpen() && !primary_table->Load())) {
     LOG(ERROR) << "Error loading table for dictionary '" << name_ << "'.";
@@ -375,13 +1052,77 @@ bool Dictionary::Load() {
   // packs are optional
   for (int i = 1; i < tables_.size(); ++i) {
     const auto& table = tables_[i];
-    if (!table->IsOpen() && table->Exists() && table->Load()) {
+    if (defer_pack(table.get())) {
+      LOG(INFO) << "deferred pack: " << packs_[i - 1];
+      deferred_tables_[i] = true;
+    } else if (!table->IsOpen() && table->Exists() && table->Load()) {
       LOG(INFO) << "loaded pack: " << packs_[i - 1];
     }
   }
   return true;
 }
 
+bool Dictionary::PrepareTable(size_t index, SyllableId syllable_id) {
+  if (!deferred_tables_[index])
+    return tables_[index]->IsOpen();
+  return tables_[index]->MayMatch(syllable_id) && LoadDeferredTable(index);
+}
+
+bool Dictionary::PrepareTable(size_t index,
+                              const SyllableGraph& syllable_graph,
+                              size_t start_pos) {
+  if (!deferred_tables_[index])
+    return tables_[index]->IsOpen();
+  auto spellings = syllable_graph.indices.find(start_pos);
+  if (spellings == syllable_graph.indices.end())
+    return false;
+  for (const auto& spelling : spellings->second) {
+    if (tables_[index]->MayMatch(spelling.first))
+      return LoadDeferredTable(index);
+  }
+  return false;
+}
+
+bool Dictionary::LoadDeferredTable(size_t index) {
+  std::lock_guard<std::mutex> lock(load_mutex());
+  const auto& table = tables_[index];
+  if (deferred_tables_[index]) {
+    if (table->IsOpen() || table->Load()) {
+      LOG(INFO) << "loaded pack: " << packs_[index - 1];
+    } else {
+      LOG(ERROR) << "Error loading pack: " << packs_[index - 1];
+    }
+    // not to try again
+    deferred_tables_[index] = false;
+  }
+  return table->IsOpen();
+}
+
+an<Table> Dictionary::overlay_table() const {
+  return overlay_ && !tables_.empty() ? overlay_->table(tables_[0].get())
+                                      : nullptr;
+}
+
+bool Dictionary::Refresh() {
+  if (!component_)
+    return false;
+  uint64_t generation = Service::instance().deployer().generation();
+  if (generation == deployer_generation_)
+    return false;
+  deployer_generation_ = generation;
+  return component_->Reacquire(this);
+}
+
+void Dictionary::WarmUp() {
+  if (!loaded())
+    return;
+  for (const auto& table : tables_) {
+    if (table->IsOpen())
+      table->WarmUp();
+  }
+  prism_->WarmUp();
+}
+
 bool Dictionary::loaded() const {
   return !tables_.empty() && tables_[0]->IsOpen() && prism_ && prism_->IsOpen();
 }
@@ -427,34 +1168,145 @@ Dictionary* DictionaryComponent::Create(const Ticket& ticket) {
       }
     }
   }
-  return Create(std::move(dict_name), std::move(prism_name), std::move(packs));
+  auto dictionary =
+      Create(std::move(dict_name), std::move(prism_name), std::move(packs));
+  // tables and prisms shared with other dictionaries keep their mode once
+  // loaded
+  int load_flags =
+      MappedFile::GetLoadFlags(config, ticket.name_space + "/load_mode");
+  if (dictionary && load_flags != MappedFile::kLoadDefault) {
+    for (const auto& table : dictionary->tables()) {
+      if (!table->IsOpen())
+        table->set_load_flags(load_flags);
+    }
+    if (!dictionary->prism()->IsOpen())
+      dictionary->prism()->set_load_flags(load_flags);
+  }
+  int parallel_lookup_min_length = 0;
+  if (dictionary &&
+      config->GetInt(ticket.name_space + "/parallel_lookup_min_length",
+                     &parallel_lookup_min_length) &&
+      parallel_lookup_min_length > 0) {
+    dictionary->set_parallel_lookup_min_length(parallel_lookup_min_length);
+  }
+  return dictionary;
+}
+
+template <class T>
+an<T> DictionaryComponent::Acquire(map<string, SharedFile<T>>* files,
+                                   ResourceResolver* resolver,
+                                   const string& name) {
+  auto file_path = resolver->ResolvePath(name);
+  std::error_code ec;
+  auto last_write_time = std::filesystem::last_write_time(file_path, ec);
+  auto& file = (*files)[name];
+  auto object = file.object.lock();
+  // a file deployed again is mapped anew, while the object of the old file
+  // is kept by the dictionaries yet to switch to the new one.
+  if (!object || object->file_path() != file_path ||
+      file.last_write_time != last_write_time) {
+    object = New<T>(file_path);
+    file.object = object;
+    file.last_write_time = last_write_time;
+  }
+  return object;
 }
 
 Dictionary* DictionaryComponent::Create(string dict_name,
                                         string prism_name,
                                         vector<string> packs) {
+  std::lock_guard<std::mutex> lock(map_mutex_);
   // obtain prism and primary table objects
-  auto primary_table = table_map_[dict_name].lock();
-  if (!primary_table) {
-    auto file_path = table_resource_resolver_->ResolvePath(dict_name);
-    table_map_[dict_name] = primary_table = New<Table>(file_path);
+  vector<of<Table>> tables = {
+      Acquire(&table_map_, table_resource_resolver_.get(), dict_name)};
+  auto prism =
+      Acquire(&prism_map_, prism_resource_resolver_.get(), prism_name);
+  for (const auto& pack : packs) {
+    tables.push_back(
+        Acquire(&table_map_, table_resource_resolver_.get(), pack));
+  }
+  auto& overlay = overlay_map_[dict_name];
+  if (!overlay)
+    overlay = New<DictionaryOverlay>(dict_name);
+  auto dictionary = new Dictionary(std::move(dict_name), std::move(packs),
+                                   std::move(tables), std::move(prism));
+  dictionary->set_overlay(overlay);
+  dictionary->component_ = this;
+  dictionary->prism_name_ = prism_name;
+  dictionary->deployer_generation_ =
+      Service::instance().deployer().generation();
+  return dictionary;
+}
+
+bool DictionaryComponent::Reacquire(Dictionary* dictionary) {
+  vector<of<Table>> tables;
+  an<Prism> prism;
+  {
+    std::lock_guard<std::mutex> lock(map_mutex_);
+    tables.push_back(Acquire(&table_map_, table_resource_resolver_.get(),
+                             dictionary->name_));
+    for (const auto& pack : dictionary->packs_) {
+      tables.push_back(
+          Acquire(&table_map_, table_resource_resolver_.get(), pack));
+    }
+    prism = Acquire(&prism_map_, prism_resource_resolver_.get(),
+                    dictionary->prism_name_);
+  }
+  if (tables == dictionary->tables_ && prism == dictionary->prism_)
+    return false;
+  vector<std::atomic<bool>> deferred_tables(tables.size());
+  {
+    std::lock_guard<std::mutex> lock(load_mutex());
+    if (!tables[0]->IsOpen() && !tables[0]->Load()) {
+      LOG(ERROR) << "Error loading table for dictionary '"
+                 << dictionary->name_ << "' deployed again.";
+      return false;
+    }
+    if (!prism->IsOpen() && !prism->Load()) {
+      LOG(ERROR) << "Error loading prism for dictionary '"
+                 << dictionary->name_ << "' deployed again.";
+      return false;
+    }
+    for (size_t i = 1; i < tables.size(); ++i) {
+      if (defer_pack(tables[i].get()))
+        deferred_tables[i] = true;
+      else if (!tables[i]->IsOpen() && tables[i]->Exists())
+        tables[i]->Load();
+    }
   }
-  auto prism = prism_map_[prism_name].lock();
-  if (!prism) {
-    auto file_path = prism_resource_resolver_->ResolvePath(prism_name);
-    prism_map_[prism_name] = prism = New<Prism>(file_path);
+  if (dictionary->overlay_)
+    dictionary->overlay_->Rebase(tables[0].get());
+  LOG(INFO) << "switching dictionary '" << dictionary->name_
+            << "' to the files deployed again.";
+  // the old files are unmapped as the last entries found in them are gone.
+  dictionary->tables_.swap(tables);
+  dictionary->deferred_tables_.swap(deferred_tables);
+  dictionary->prism_.swap(prism);
+  return true;
+}
+
+bool DictionaryComponent::LoadOverlay(const string& dict_name,
+                                      const path& tsv_file) {
+  an<Table> primary_table;
+  an<DictionaryOverlay> overlay;
+  {
+    std::lock_guard<std::mutex> lock(map_mutex_);
+    primary_table =
+        Acquire(&table_map_, table_resource_resolver_.get(), dict_name);
+    auto& shared_overlay = overlay_map_[dict_name];
+    if (!shared_overlay)
+      shared_overlay = New<DictionaryOverlay>(dict_name);
+    overlay = shared_overlay;
   }
-  vector<of<Table>> tables = {std::move(primary_table)};
-  for (const auto& pack : packs) {
-    auto table = table_map_[pack].lock();
-    if (!table) {
-      auto file_path = table_resource_resolver_->ResolvePath(pack);
-      table_map_[pack] = table = New<Table>(file_path);
+  {
+    std::lock_guard<std::mutex> lock(load_mutex());
+    if (!primary_table->IsOpen() && !primary_table->Load()) {
+      LOG(ERROR) << "Error loading table for dictionary '" << dict_name
+                 << "'.";
+      return false;
     }
-    tables.push_back(std::move(table));
   }
-  return new Dictionary(std::move(dict_name), std::move(packs),
-                        std::move(tables), std::move(prism));
+  return overlay->Load(tsv_file, primary_table.get());
 }
 
 }  // namespace rime
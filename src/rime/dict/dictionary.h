@@ -7,7 +7,10 @@
 #ifndef RIME_DICTIONARY_H_
 #define RIME_DICTIONARY_H_
 
+#include <atomic>
+#include <mutex>
 #include <rime_api.h>
+#include <rime/arena.h>
 #include <rime/common.h>
 #include <rime/component.h>
 #include <rime/dict/prism.h>
@@ -23,42 +26,127 @@ struct QueryResult;
 
 }  // namespace dictionary
 
+// A view of the current entry of a chunk in a compiled table, as found by
+// a dictionary query.
+// Filters can inspect it before a DictEntry is made out of the table entry.
+class RIME_API DictEntryView {
+ public:
+  explicit DictEntryView(const dictionary::Chunk& chunk) : chunk_(chunk) {}
+
+  string text() const;
+  double weight() const;
+  const Code& code() const;
+  bool IsExactMatch() const;
+  bool IsPredictiveMatch() const;
+
+ private:
+  const dictionary::Chunk& chunk_;
+};
+
+using DictEntryViewFilter = function<bool(const DictEntryView& entry)>;
+
 class RIME_API DictEntryIterator : public DictEntryFilterBinder {
  public:
   DictEntryIterator();
+  // iterates over a range of the chunks found by a lookup, which keeps the
+  // chunks of all end positions in one buffer.
+  DictEntryIterator(an<dictionary::QueryResult> query_result,
+                    size_t chunk_begin,
+                    size_t chunk_end);
   virtual ~DictEntryIterator() = default;
-  DictEntryIterator(const DictEntryIterator& other) = default;
-  DictEntryIterator& operator=(const DictEntryIterator& other) = default;
+  // a copy iterates over the entries independently of the original.
+  DictEntryIterator(const DictEntryIterator& other);
+  DictEntryIterator& operator=(const DictEntryIterator& other);
   DictEntryIterator(DictEntryIterator&& other) = default;
   DictEntryIterator& operator=(DictEntryIterator&& other) = default;
 
   void AddChunk(dictionary::Chunk&& chunk);
+  // appends the chunks of an unsorted iterator.
+  void AddChunks(DictEntryIterator&& other);
   void Sort();
   void AddFilter(DictEntryFilter filter) override;
+  // a view filter runs before the entry is materialized for other filters.
+  void AddViewFilter(DictEntryViewFilter filter);
+  // the full DictEntry is made only when the current entry is peeked.
   an<DictEntry> Peek();
+  DictEntryView PeekView() const;
   bool Next();
   bool Skip(size_t num_entries);
   bool exhausted() const;
   size_t entry_count() const { return entry_count_; }
+  // allocates entries from the arena instead of the heap.
+  void set_arena(an<Arena> arena) { arena_ = std::move(arena); }
+  // keeps the tables of the chunks mapped as long as the entries are
+  // iterated, should the dictionary switch to tables deployed again.
+  void HoldTables(const vector<of<Table>>& tables);
 
  protected:
   bool FindNextEntry();
+  bool AcceptsCurrentEntry();
+  size_t current_chunk() const;
 
  private:
+  struct HeapCompare;
+  HeapCompare heap_compare() const;
+  size_t* heap() const;
+  // takes a copy of the chunks in range, to add chunks to them or to
+  // iterate over them independently.
+  void Detach();
+
+  // the chunks in [chunk_begin_, chunk_end_) of the buffer belong to this
+  // iterator; other ranges may belong to other iterators of a lookup.
   an<dictionary::QueryResult> query_result_;
+  size_t chunk_begin_ = 0;
+  size_t chunk_end_ = 0;
+  // chunks are visited in order until sorted, then merged by a binary heap
+  // of chunk indices, kept in the buffer at the offset of the range.
   size_t chunk_index_ = 0;
+  bool sorted_ = false;
+  size_t heap_size_ = 0;
   an<DictEntry> entry_ = nullptr;
   size_t entry_count_ = 0;
+  an<Arena> arena_;
+  DictEntryViewFilter view_filter_;
 };
 
-using DictEntryCollector = map<size_t, DictEntryIterator>;
+using DictEntryCollector = EndPosMap<DictEntryIterator>;
 
 class Config;
+class DictionaryComponent;
 class Schema;
 class EditDistanceCorrector;
 struct SyllableGraph;
 struct Ticket;
 
+// Terms loaded into a dictionary at runtime, without deploying it again.
+// Shared by the dictionaries of the same name, which look the terms up along
+// with their tables as soon as they are loaded.
+class DictionaryOverlay {
+ public:
+  explicit DictionaryOverlay(const string& name) : name_(name) {}
+  RIME_API ~DictionaryOverlay();
+
+  // builds an index of the terms in a tsv file of text, code and optional
+  // weight, as in the entries of a dict.yaml, replacing the terms loaded
+  // before. codes are spelled in the syllables of the primary table.
+  RIME_API bool Load(const path& tsv_file, Table* primary_table);
+  // loads the terms again if they were indexed for another primary table,
+  // eg. one deployed again with different syllables.
+  RIME_API bool Rebase(Table* primary_table);
+  // the index of the terms loaded for the primary table; nullptr if none
+  // is loaded, or the terms are indexed for another table.
+  RIME_API an<Table> table(const Table* primary_table) const;
+
+ private:
+  string name_;
+  mutable std::mutex mutex_;
+  an<Table> table_;
+  path file_path_;
+  uint64_t primary_image_id_ = 0;
+  // replaced by a later load; entries found before may still refer to them.
+  vector<of<Table>> retired_tables_;
+};
+
 class Dictionary : public Class<Dictionary, const Ticket&> {
  public:
   RIME_API Dictionary(string name,
@@ -70,11 +158,19 @@ class Dictionary : public Class<Dictionary, const Ticket&> {
   bool Exists() const;
   RIME_API bool Remove();
   RIME_API bool Load();
+  // pages in the loaded tables and prism ahead of the first lookup.
+  RIME_API void WarmUp();
+  // switches to the tables and prism deployed since they were loaded, if
+  // any. called between compositions, when no lookup is in progress;
+  // entries found before keep the files they were found in mapped.
+  // returns true if the dictionary switched to new files.
+  RIME_API bool Refresh();
 
   RIME_API an<DictEntryCollector> Lookup(const SyllableGraph& syllable_graph,
                                          size_t start_pos,
                                          bool predict_word = false,
-                                         double initial_credibility = 0.0);
+                                         double initial_credibility = 0.0,
+                                         an<Arena> arena = nullptr);
   // if predictive is true, do an expand search with limit,
   // otherwise do an exact match.
   // return num of matching keys.
@@ -82,6 +178,14 @@ class Dictionary : public Class<Dictionary, const Ticket&> {
                               const string& str_code,
                               bool predictive,
                               size_t limit = 0);
+  // like a predictive LookupWords(), but continues the search from the keys
+  // found by the previous calls, given the same search state.
+  // the search is started if *search is null.
+  // return num of keys newly matched, of at most limit.
+  RIME_API size_t LookupMoreWords(DictEntryIterator* result,
+                                  const string& str_code,
+                                  an<Prism::SearchState>* search,
+                                  size_t limit);
   // translate syllable id sequence to string code
   RIME_API bool Decode(const Code& code, vector<string>* result);
 
@@ -92,12 +196,55 @@ class Dictionary : public Class<Dictionary, const Ticket&> {
   const vector<of<Table>>& tables() const { return tables_; }
   const an<Table>& primary_table() const { return tables_[0]; }
   const an<Prism>& prism() const { return prism_; }
+  const an<DictionaryOverlay>& overlay() const { return overlay_; }
+  void set_overlay(an<DictionaryOverlay> overlay) {
+    overlay_ = std::move(overlay);
+  }
+
+  // packs are looked up in parallel by the shared worker pool, if the input
+  // to look up has at least this many characters; 0 disables it.
+  void set_parallel_lookup_min_length(size_t length) {
+    parallel_lookup_min_length_ = length;
+  }
 
  private:
+  friend class DictionaryComponent;
+
+  an<Table> overlay_table() const;
+  // whether the table at the index is open for a lookup of words starting
+  // with the syllable, or of the syllables from a position of the graph.
+  // a pack deferred by Load() is mapped once a lookup passes its filter.
+  bool PrepareTable(size_t index, SyllableId syllable_id);
+  bool PrepareTable(size_t index,
+                    const SyllableGraph& syllable_graph,
+                    size_t start_pos);
+  bool LoadDeferredTable(size_t index);
+  // finds the words completing a short code in the code tries of tables of
+  // codes, in one chunk per table; returns false if the prism is to be
+  // searched instead.
+  bool LookupCompletions(DictEntryIterator* result,
+                         const string& str_code,
+                         size_t limit,
+                         size_t* num_codes);
+  // adds the words of the spellings found thru the prism.
+  void AddWords(DictEntryIterator* result,
+                const vector<Prism::Match>& keys,
+                size_t code_length);
+
   string name_;
   vector<string> packs_;
   vector<of<Table>> tables_;
   an<Prism> prism_;
+  an<DictionaryOverlay> overlay_;
+  // per-table caches reused by lookups on successive inputs.
+  vector<TableQueryCache> table_query_caches_;
+  // packs with a syllable filter, yet to be mapped; of the size of tables_.
+  vector<std::atomic<bool>> deferred_tables_;
+  size_t parallel_lookup_min_length_ = 0;
+  // where the files were acquired, to acquire them again once deployed.
+  DictionaryComponent* component_ = nullptr;
+  string prism_name_;
+  uint64_t deployer_generation_ = 0;
 };
 
 class ResourceResolver;
@@ -108,10 +255,31 @@ class DictionaryComponent : public Dictionary::Component {
   ~DictionaryComponent() override;
   Dictionary* Create(const Ticket& ticket) override;
   Dictionary* Create(string dict_name, string prism_name, vector<string> packs);
+  // loads terms into the overlay of the dictionaries of the name.
+  RIME_API bool LoadOverlay(const string& dict_name, const path& tsv_file);
 
  private:
-  map<string, weak<Prism>> prism_map_;
-  map<string, weak<Table>> table_map_;
+  friend class Dictionary;
+  // switches the dictionary to the files deployed since it was created.
+  bool Reacquire(Dictionary* dictionary);
+
+  // a file shared by dictionaries, as long as it is not deployed again.
+  template <class T>
+  struct SharedFile {
+    weak<T> object;
+    std::filesystem::file_time_type last_write_time;
+  };
+  template <class T>
+  an<T> Acquire(map<string, SharedFile<T>>* files,
+                ResourceResolver* resolver,
+                const string& name);
+
+  // guards the maps of tables and prisms shared by dictionaries.
+  std::mutex map_mutex_;
+  map<string, SharedFile<Prism>> prism_map_;
+  map<string, SharedFile<Table>> table_map_;
+  // kept for the dictionaries to come, as the terms are not deployed.
+  map<string, of<DictionaryOverlay>> overlay_map_;
   the<ResourceResolver> prism_resource_resolver_;
   the<ResourceResolver> table_resource_resolver_;
 };
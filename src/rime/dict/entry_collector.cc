@@ -5,16 +5,68 @@
 // 2011-11-27 GONG Chen <chen.sst@gmail.com>
 //
 #include <algorithm>
+#include <filesystem>
 #include <fstream>
+#include <future>
+#include <sstream>
 #include <utility>
 #include <boost/algorithm/string.hpp>
-#include <rime/algo/strings.h>
+#include <rime/worker_pool.h>
+#include <rime/dict/build_cache.h>
 #include <rime/dict/dict_settings.h>
 #include <rime/dict/entry_collector.h>
 #include <rime/dict/preset_vocabulary.h>
+#include <rime/dict/tsv.h>
 
 namespace rime {
 
+// a line of entry in a dict file, parsed by one of the shards.
+struct DictFileLine {
+  size_t line_number;
+  std::string_view line;
+  string word;
+  string code_str;
+  string weight_str;
+  string stem_str;
+  an<RawDictEntry> entry;
+};
+
+// lines parsed by a task of the worker pool.
+static const size_t kLinesPerShard = 10000;
+
+// phrases encoded by a task of the worker pool.
+static const size_t kMinPhrasesPerShard = 1000;
+
+// keeps the entries encoded by a shard, to be added in the order of the
+// phrases; words are translated by the entry collector, which is not
+// modified while the shards run.
+class EncodedPhraseCollector : public PhraseCollector {
+ public:
+  struct EncodedPhrase {
+    string word;
+    string code_str;
+    string weight_str;
+  };
+
+  explicit EncodedPhraseCollector(PhraseCollector* source) : source_(source) {}
+
+  void CreateEntry(const string& word,
+                   const string& code_str,
+                   const string& weight_str) override {
+    encoded.push_back({word, code_str, weight_str});
+  }
+  bool TranslateWord(const string& word, vector<string>* code) override {
+    return source_->TranslateWord(word, code);
+  }
+
+  vector<EncodedPhrase> encoded;
+  // the number of encoded entries per phrase
+  vector<size_t> counts;
+
+ private:
+  PhraseCollector* source_;
+};
+
 EntryCollector::EntryCollector() {}
 
 EntryCollector::EntryCollector(Syllabary&& fixed_syllabary)
@@ -59,9 +111,21 @@ void EntryCollector::Collect(const path& dict_file) {
   current_dict_file = dict_file.u8string();
   line_number = 0;
   // read table
-  std::ifstream fin(dict_file.c_str());
+  TsvLineReader reader(dict_file);
+  if (!reader.Open()) {
+    LOG(ERROR) << "error opening dict file: " << dict_file << ".";
+    return;
+  }
+  std::string_view line;
+  std::stringstream header;
+  while (reader.ReadLine(&line)) {
+    header << line << std::endl;
+    if (line == "...") {  // yaml doc ending
+      break;
+    }
+  }
   DictSettings settings;
-  if (!settings.LoadDictHeader(fin)) {
+  if (!settings.LoadDictHeader(header)) {
     LOG(ERROR) << "missing dict settings.";
     return;
   }
@@ -75,11 +139,11 @@ void EntryCollector::Collect(const path& dict_file) {
                << ".";
     return;
   }
+  // lines of entries, parsed in parallel shards and collected in order.
+  vector<DictFileLine> lines;
   bool enable_comment = true;
-  string line;
-  while (getline(fin, line)) {
-    boost::algorithm::trim_right(line);
-    line_number++;
+  while (reader.ReadLine(&line)) {
+    line_number = reader.line_number();
     // skip empty lines and comments
     if (line.empty())
       continue;
@@ -90,67 +154,86 @@ void EntryCollector::Collect(const path& dict_file) {
       }
       continue;
     }
-    // read a dict entry
-    auto row = strings::split(line, "\t");
-    int num_columns = static_cast<int>(row.size());
-    if (num_columns <= text_column || row[text_column].empty()) {
+    lines.push_back({line_number, line});
+  }
+  auto parse_lines = [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      auto& x = lines[i];
+      // read a dict entry
+      TsvFields row;
+      TsvLineReader::Split(x.line, &row);
+      int num_columns = static_cast<int>(row.size());
+      if (num_columns <= text_column || row[text_column].empty())
+        continue;
+      x.word = row[text_column];
+      if (code_column != -1 && num_columns > code_column &&
+          !row[code_column].empty())
+        x.code_str = row[code_column];
+      if (weight_column != -1 && num_columns > weight_column &&
+          !row[weight_column].empty())
+        x.weight_str = row[weight_column];
+      if (stem_column != -1 && num_columns > stem_column &&
+          !row[stem_column].empty())
+        x.stem_str = row[stem_column];
+      if (!x.code_str.empty()) {
+        x.entry = MakeEntry(x.word, x.code_str, x.weight_str,
+                            current_dict_file, x.line_number);
+      }
+    }
+  };
+  vector<std::future<void>> shards;
+  for (size_t begin = 0; begin < lines.size(); begin += kLinesPerShard) {
+    size_t end = (std::min)(begin + kLinesPerShard, lines.size());
+    shards.push_back(WorkerPool::Shared().Submit(
+        [&parse_lines, begin, end] { parse_lines(begin, end); }));
+  }
+  for (auto& shard : shards) {
+    shard.get();
+  }
+  for (const auto& x : lines) {
+    if (x.word.empty()) {
       LOG(WARNING) << "Missing entry text at #" << num_entries
-                   << ", line: " << line_number
+                   << ", line: " << x.line_number
                    << " of file: " << current_dict_file << ".";
       continue;
     }
-    const auto& word(row[text_column]);
-    string code_str;
-    string weight_str;
-    string stem_str;
-    if (code_column != -1 && num_columns > code_column &&
-        !row[code_column].empty())
-      code_str = row[code_column];
-    if (weight_column != -1 && num_columns > weight_column &&
-        !row[weight_column].empty())
-      weight_str = row[weight_column];
-    if (stem_column != -1 && num_columns > stem_column &&
-        !row[stem_column].empty())
-      stem_str = row[stem_column];
     // collect entry
-    collection.insert(word);
-    if (!code_str.empty()) {
-      CreateEntry(word, code_str, weight_str);
+    collection.insert(x.word);
+    if (x.entry) {
+      AddEntry(x.entry, x.code_str);
     } else {
-      encode_queue.push({word, weight_str});
+      encode_queue.push({x.word, x.weight_str});
     }
-    if (!stem_str.empty() && !code_str.empty()) {
-      DLOG(INFO) << "add stem '" << word << "': "
-                 << "[" << code_str << "] = [" << stem_str << "]";
-      stems[word].insert(stem_str);
+    if (!x.stem_str.empty() && !x.code_str.empty()) {
+      DLOG(INFO) << "add stem '" << x.word << "': "
+                 << "[" << x.code_str << "] = [" << x.stem_str << "]";
+      stems[x.word].insert(x.stem_str);
     }
   }
-  fin.close();
   LOG(INFO) << "Pass 1: total " << num_entries << " entries collected.";
   LOG(INFO) << "num unique syllables: " << syllabary.size();
   LOG(INFO) << "num of entries to encode: " << encode_queue.size();
 }
 
 void EntryCollector::Finish() {
+  vector<pair<string, string>> phrases;
+  phrases.reserve(encode_queue.size());
   while (!encode_queue.empty()) {
-    const auto& phrase(encode_queue.front().first);
-    const auto& weight_str(encode_queue.front().second);
-    if (!encoder->EncodePhrase(phrase, weight_str)) {
-      LOG(ERROR) << "Encode failure: '" << phrase << "'.";
-    }
+    phrases.push_back(std::move(encode_queue.front()));
     encode_queue.pop();
   }
+  EncodePhrases(phrases, true);
   LOG(INFO) << "Pass 2: total " << num_entries << " entries collected.";
   if (preset_vocabulary) {
+    phrases.clear();
     preset_vocabulary->Reset();
     string phrase, weight_str;
     while (preset_vocabulary->GetNextEntry(&phrase, &weight_str)) {
       if (collection.find(phrase) != collection.end())
         continue;
-      if (!encoder->EncodePhrase(phrase, weight_str)) {
-        LOG(WARNING) << "Encode failure: '" << phrase << "'.";
-      }
+      phrases.emplace_back(phrase, weight_str);
     }
+    EncodePhrases(phrases, false);
   }
   decltype(collection)().swap(collection);
   decltype(words)().swap(words);
@@ -158,9 +241,65 @@ void EntryCollector::Finish() {
   LOG(INFO) << "Pass 3: total " << num_entries << " entries collected.";
 }
 
+// phrases are encoded in parallel by clones of the encoder, then the
+// entries are added in order, as if they were encoded one by one.
+void EntryCollector::EncodePhrases(const vector<pair<string, string>>& phrases,
+                                   bool required) {
+  auto& pool = WorkerPool::Shared();
+  size_t shard_size = (std::max)(
+      kMinPhrasesPerShard, (phrases.size() + pool.size() - 1) / pool.size());
+  vector<EncodedPhraseCollector> results;
+  for (size_t begin = 0; begin < phrases.size(); begin += shard_size) {
+    results.emplace_back(this);
+  }
+  vector<std::future<void>> shards;
+  for (size_t i = 0; i < results.size(); ++i) {
+    shards.push_back(pool.Submit([this, &phrases, &results, shard_size, i] {
+      auto& result = results[i];
+      auto shard_encoder = encoder->Clone(&result);
+      size_t begin = i * shard_size;
+      size_t end = (std::min)(begin + shard_size, phrases.size());
+      for (size_t j = begin; j < end; ++j) {
+        size_t count = result.encoded.size();
+        shard_encoder->EncodePhrase(phrases[j].first, phrases[j].second);
+        result.counts.push_back(result.encoded.size() - count);
+      }
+    }));
+  }
+  for (auto& shard : shards) {
+    shard.get();
+  }
+  for (size_t i = 0; i < results.size(); ++i) {
+    const auto& result = results[i];
+    auto encoded = result.encoded.begin();
+    for (size_t j = 0; j < result.counts.size(); ++j) {
+      const auto& phrase = phrases[i * shard_size + j].first;
+      if (result.counts[j] == 0) {
+        if (required)
+          LOG(ERROR) << "Encode failure: '" << phrase << "'.";
+        else
+          LOG(WARNING) << "Encode failure: '" << phrase << "'.";
+      }
+      for (size_t k = 0; k < result.counts[j]; ++k, ++encoded) {
+        CreateEntry(encoded->word, encoded->code_str, encoded->weight_str);
+      }
+    }
+  }
+}
+
 void EntryCollector::CreateEntry(const string& word,
                                  const string& code_str,
                                  const string& weight_str) {
+  AddEntry(MakeEntry(word, code_str, weight_str, current_dict_file,
+                     line_number),
+           code_str);
+}
+
+an<RawDictEntry> EntryCollector::MakeEntry(const string& word,
+                                           const string& code_str,
+                                           const string& weight_str,
+                                           const string& dict_file,
+                                           size_t line_number) const {
   an<RawDictEntry> e = New<RawDictEntry>();
   e->raw_code.FromString(code_str);
   e->text = word;
@@ -174,9 +313,8 @@ void EntryCollector::CreateEntry(const string& word,
     try {
       percentage = std::stod(weight_str.substr(0, weight_str.length() - 1));
     } catch (...) {
-      LOG(WARNING) << "invalid entry definition at #" << num_entries
-                   << ", line: " << line_number
-                   << " of file: " << current_dict_file << ".";
+      LOG(WARNING) << "invalid entry definition at line: " << line_number
+                   << " of file: " << dict_file << ".";
       percentage = 100.0;
     }
     e->weight *= percentage / 100.0;
@@ -184,12 +322,15 @@ void EntryCollector::CreateEntry(const string& word,
     try {
       e->weight = std::stod(weight_str);
     } catch (...) {
-      LOG(WARNING) << "invalid entry definition at #" << num_entries
-                   << ", line: " << line_number
-                   << " of file: " << current_dict_file << ".";
+      LOG(WARNING) << "invalid entry definition at line: " << line_number
+                   << " of file: " << dict_file << ".";
       e->weight = 0.0;
     }
   }
+  return e;
+}
+
+void EntryCollector::AddEntry(an<RawDictEntry> e, const string& code_str) {
   // learn new syllables, or check if syllables are in the fixed syllabary.
   for (const string& s : e->raw_code) {
     if (syllabary.find(s) == syllabary.end()) {
@@ -213,7 +354,12 @@ void EntryCollector::CreateEntry(const string& word,
                    << code_str << "].";
       return;
     }
-    weights.push_back(std::make_pair(code_str, e->weight));
+    // kept in the order of codes for TranslateWord()
+    weights.insert(std::upper_bound(weights.begin(), weights.end(), code_str,
+                                    [](const string& code, const auto& p) {
+                                      return code < p.first;
+                                    }),
+                   std::make_pair(code_str, e->weight));
     total_weight[e->text] += e->weight;
   }
   entries.emplace_back(std::move(e));
@@ -230,11 +376,11 @@ bool EntryCollector::TranslateWord(const string& word, vector<string>* result) {
   }
   const auto& w = words.find(word);
   if (w != words.end()) {
-    std::sort(w->second.begin(), w->second.end(),
-              [](const auto& a, const auto& b) { return a.first < b.first; });
+    const auto& t = total_weight.find(word);
+    double word_weight = t != total_weight.end() ? t->second : 0.0;
     for (const auto& v : w->second) {
       const double kMinimalWeight = 0.05;  // 5%
-      double min_weight = total_weight[word] * kMinimalWeight;
+      double min_weight = word_weight * kMinimalWeight;
       if (v.second < min_weight)
         continue;
       result->push_back(v.first);
@@ -258,4 +404,138 @@ void EntryCollector::Dump(const path& file_path) const {
   out.close();
 }
 
+// bump the version whenever the layout of saved entries changes.
+static const char kEntriesFormat[] = "Rime::Entries/1.0";
+
+template <class T>
+static void WriteValue(std::ofstream& out, const T& value) {
+  out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+static void WriteString(std::ofstream& out, const string& str) {
+  WriteValue(out, uint32_t(str.size()));
+  out.write(str.data(), str.size());
+}
+
+template <class T>
+static bool ReadValue(std::ifstream& in, T* value) {
+  return bool(in.read(reinterpret_cast<char*>(value), sizeof(T)));
+}
+
+static bool ReadString(std::ifstream& in, string* str) {
+  uint32_t size = 0;
+  if (!ReadValue(in, &size))
+    return false;
+  str->resize(size);
+  return bool(in.read(&(*str)[0], size));
+}
+
+bool EntryCollector::Save(const path& file_path,
+                          uint32_t dict_file_checksum) const {
+  // written to a temporary file first, for others may be loading it.
+  path temp_path = BuildCache::TempFilePath(file_path);
+  std::ofstream out(temp_path.c_str(), std::ios::binary | std::ios::trunc);
+  WriteString(out, kEntriesFormat);
+  WriteValue(out, dict_file_checksum);
+  WriteValue(out, uint64_t(num_entries));
+  WriteValue(out, uint32_t(syllabary.size()));
+  for (const string& syllable : syllabary) {
+    WriteString(out, syllable);
+  }
+  WriteValue(out, uint32_t(entries.size()));
+  for (const auto& e : entries) {
+    WriteString(out, e->text);
+    WriteValue(out, e->weight);
+    WriteValue(out, uint32_t(e->raw_code.size()));
+    for (const string& syllable : e->raw_code) {
+      WriteString(out, syllable);
+    }
+  }
+  WriteValue(out, uint32_t(stems.size()));
+  for (const auto& v : stems) {
+    WriteString(out, v.first);
+    WriteValue(out, uint32_t(v.second.size()));
+    for (const string& stem : v.second) {
+      WriteString(out, stem);
+    }
+  }
+  out.close();
+  std::error_code ec;
+  if (out) {
+    std::filesystem::rename(temp_path, file_path, ec);
+  }
+  if (!out || ec) {
+    LOG(WARNING) << "error saving collected entries: " << file_path;
+    std::filesystem::remove(temp_path, ec);
+    return false;
+  }
+  LOG(INFO) << "saved " << entries.size() << " entries to " << file_path;
+  return true;
+}
+
+bool EntryCollector::Load(const path& file_path,
+                          uint32_t dict_file_checksum) {
+  std::ifstream in(file_path.c_str(), std::ios::binary);
+  if (!in)
+    return false;
+  string format;
+  uint32_t checksum = 0;
+  uint64_t total_entries = 0;
+  if (!ReadString(in, &format) || format != kEntriesFormat ||
+      !ReadValue(in, &checksum) || checksum != dict_file_checksum ||
+      !ReadValue(in, &total_entries)) {
+    return false;
+  }
+  Syllabary loaded_syllabary;
+  vector<of<RawDictEntry>> loaded_entries;
+  ReverseLookupTable loaded_stems;
+  uint32_t count = 0;
+  if (!ReadValue(in, &count))
+    return false;
+  for (uint32_t i = 0; i < count; ++i) {
+    string syllable;
+    if (!ReadString(in, &syllable))
+      return false;
+    loaded_syllabary.insert(loaded_syllabary.end(), std::move(syllable));
+  }
+  if (!ReadValue(in, &count))
+    return false;
+  loaded_entries.reserve(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    auto e = New<RawDictEntry>();
+    uint32_t code_size = 0;
+    if (!ReadString(in, &e->text) || !ReadValue(in, &e->weight) ||
+        !ReadValue(in, &code_size))
+      return false;
+    e->raw_code.resize(code_size);
+    for (auto& syllable : e->raw_code) {
+      if (!ReadString(in, &syllable))
+        return false;
+    }
+    loaded_entries.push_back(std::move(e));
+  }
+  if (!ReadValue(in, &count))
+    return false;
+  for (uint32_t i = 0; i < count; ++i) {
+    string key;
+    uint32_t num_stems = 0;
+    if (!ReadString(in, &key) || !ReadValue(in, &num_stems))
+      return false;
+    auto& stems_of_key = loaded_stems[key];
+    for (uint32_t j = 0; j < num_stems; ++j) {
+      string stem;
+      if (!ReadString(in, &stem))
+        return false;
+      stems_of_key.insert(stems_of_key.end(), std::move(stem));
+    }
+  }
+  syllabary.swap(loaded_syllabary);
+  entries.swap(loaded_entries);
+  stems.swap(loaded_stems);
+  num_entries = total_entries;
+  LOG(INFO) << "loaded " << entries.size() << " collected entries from "
+            << file_path;
+  return true;
+}
+
 }  // namespace rime
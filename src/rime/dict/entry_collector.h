@@ -51,18 +51,37 @@ class EntryCollector : public PhraseCollector {
 
   // export contents of table and prism to text files
   void Dump(const path& file_path) const;
+  // keeps the collected entries in a binary file, for building again from
+  // sources of the same checksum without collecting the entries again.
+  bool Save(const path& file_path, uint32_t dict_file_checksum) const;
+  // loads entries saved from sources of the same checksum.
+  bool Load(const path& file_path, uint32_t dict_file_checksum);
 
   void CreateEntry(const string& word,
                    const string& code_str,
                    const string& weight_str);
+  // safe to call from several threads while no entry is being added.
   bool TranslateWord(const string& word, vector<string>* code);
 
  protected:
   void LoadPresetVocabulary(DictSettings* settings);
   // call Collect() multiple times for all required tables
   void Collect(const path& dict_file);
+  // parses code and weight of an entry; safe to call from several threads.
+  an<RawDictEntry> MakeEntry(const string& word,
+                             const string& code_str,
+                             const string& weight_str,
+                             const string& dict_file,
+                             size_t line_number) const;
+  // learns the syllables and the word of the entry, and keeps the entry.
+  // entries are added in the order of the dict files.
+  void AddEntry(an<RawDictEntry> e, const string& code_str);
   // encode all collected entries
   void Finish();
+  // encodes the phrases on the worker pool; failures are errors if the
+  // phrases are required to be encoded.
+  void EncodePhrases(const vector<pair<string, string>>& phrases,
+                     bool required);
 
  protected:
   the<PresetVocabulary> preset_vocabulary;
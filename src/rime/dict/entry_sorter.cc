@@ -0,0 +1,174 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <algorithm>
+#include <filesystem>
+#include <rime/dict/entry_sorter.h>
+
+namespace rime {
+
+static bool FirstSyllableLess(SyllableId x_head,
+                              uint64_t x_sequence,
+                              SyllableId y_head,
+                              uint64_t y_sequence) {
+  return x_head != y_head ? x_head < y_head : x_sequence < y_sequence;
+}
+
+template <class T>
+static void WriteValue(std::ofstream& out, const T& value) {
+  out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <class T>
+static bool ReadValue(std::ifstream& in, T* value) {
+  return bool(in.read(reinterpret_cast<char*>(value), sizeof(T)));
+}
+
+EntrySorter::EntrySorter(const path& run_file_prefix, size_t memory_limit)
+    : run_file_prefix_(run_file_prefix), memory_limit_(memory_limit) {}
+
+EntrySorter::~EntrySorter() {
+  for (auto& run : runs_) {
+    run->in.close();
+    std::error_code ec;
+    std::filesystem::remove(run->file_path, ec);
+  }
+}
+
+size_t EntrySorter::EstimateSize(const ShortDictEntry& entry) {
+  return sizeof(Record) + entry.text.capacity() +
+         entry.code.capacity() * sizeof(SyllableId);
+}
+
+bool EntrySorter::Add(ShortDictEntry&& entry) {
+  if (finished_ || entry.code.empty())
+    return false;
+  buffered_size_ += EstimateSize(entry);
+  buffer_.push_back({num_entries_++, std::move(entry)});
+  if (memory_limit_ > 0 && buffered_size_ >= memory_limit_) {
+    return Spill();
+  }
+  return true;
+}
+
+bool EntrySorter::Spill() {
+  path file_path(run_file_prefix_);
+  file_path += ".run" + std::to_string(runs_.size());
+  auto run = std::make_unique<Run>();
+  run->file_path = file_path;
+  runs_.push_back(std::move(run));
+  std::ofstream out(file_path.c_str(), std::ios::binary | std::ios::trunc);
+  if (!out) {
+    LOG(ERROR) << "error creating sorted run: " << file_path;
+    return false;
+  }
+  std::stable_sort(buffer_.begin(), buffer_.end(),
+                   [](const Record& x, const Record& y) {
+                     return x.entry.code[0] < y.entry.code[0];
+                   });
+  for (const auto& record : buffer_) {
+    WriteValue(out, record.sequence);
+    WriteValue(out, record.entry.weight);
+    WriteValue(out, uint32_t(record.entry.code.size()));
+    out.write(reinterpret_cast<const char*>(record.entry.code.data()),
+              record.entry.code.size() * sizeof(SyllableId));
+    WriteValue(out, uint32_t(record.entry.text.size()));
+    out.write(record.entry.text.data(), record.entry.text.size());
+  }
+  out.close();
+  if (!out) {
+    LOG(ERROR) << "error writing sorted run: " << file_path;
+    return false;
+  }
+  DLOG(INFO) << "spilled " << buffer_.size() << " entries to " << file_path;
+  vector<Record>().swap(buffer_);
+  buffered_size_ = 0;
+  return true;
+}
+
+bool EntrySorter::ReadRecord(Run* run) {
+  auto& record = run->head;
+  uint32_t code_size = 0;
+  uint32_t text_size = 0;
+  if (!ReadValue(run->in, &record.sequence) ||
+      !ReadValue(run->in, &record.entry.weight) ||
+      !ReadValue(run->in, &code_size)) {
+    run->exhausted = true;
+    return false;
+  }
+  record.entry.code.resize(code_size);
+  run->in.read(reinterpret_cast<char*>(record.entry.code.data()),
+               code_size * sizeof(SyllableId));
+  if (!ReadValue(run->in, &text_size)) {
+    run->exhausted = true;
+    return false;
+  }
+  record.entry.text.resize(text_size);
+  run->in.read(&record.entry.text[0], text_size);
+  if (!run->in) {
+    run->exhausted = true;
+    return false;
+  }
+  return true;
+}
+
+bool EntrySorter::Finish() {
+  if (finished_)
+    return true;
+  finished_ = true;
+  if (runs_.empty()) {
+    std::stable_sort(buffer_.begin(), buffer_.end(),
+                     [](const Record& x, const Record& y) {
+                       return x.entry.code[0] < y.entry.code[0];
+                     });
+    return true;
+  }
+  if (!buffer_.empty() && !Spill()) {
+    return false;
+  }
+  LOG(INFO) << "merging " << runs_.size() << " sorted runs of "
+            << num_entries_ << " entries.";
+  for (auto& run : runs_) {
+    run->in.open(run->file_path.c_str(), std::ios::binary);
+    if (!run->in) {
+      LOG(ERROR) << "error opening sorted run: " << run->file_path;
+      return false;
+    }
+    ReadRecord(run.get());
+  }
+  return true;
+}
+
+bool EntrySorter::Next(ShortDictEntry* entry) {
+  if (!finished_ || !entry)
+    return false;
+  if (runs_.empty()) {
+    if (cursor_ >= buffer_.size()) {
+      vector<Record>().swap(buffer_);
+      return false;
+    }
+    *entry = std::move(buffer_[cursor_++].entry);
+    return true;
+  }
+  // there are a few runs for any sensible memory limit; a linear scan
+  // for the least head is cheaper than keeping a heap of them.
+  Run* next = nullptr;
+  for (auto& run : runs_) {
+    if (run->exhausted)
+      continue;
+    if (!next || FirstSyllableLess(run->head.entry.code[0],
+                                   run->head.sequence,
+                                   next->head.entry.code[0],
+                                   next->head.sequence)) {
+      next = run.get();
+    }
+  }
+  if (!next)
+    return false;
+  *entry = std::move(next->head.entry);
+  ReadRecord(next);
+  return true;
+}
+
+}  // namespace rime
@@ -0,0 +1,67 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#ifndef RIME_ENTRY_SORTER_H_
+#define RIME_ENTRY_SORTER_H_
+
+#include <fstream>
+#include <rime_api.h>
+#include <rime/common.h>
+#include <rime/dict/vocabulary.h>
+
+namespace rime {
+
+// Groups dictionary entries by their first syllable, keeping the order in
+// which they were added within each group.
+//
+// Entries are buffered up to a memory limit; beyond that, the buffer is
+// sorted and spilled to a temporary run file next to run_file_prefix, and
+// the runs are merged as entries are read back.
+class EntrySorter {
+ public:
+  // a memory limit of 0 keeps all entries in memory.
+  RIME_API EntrySorter(const path& run_file_prefix, size_t memory_limit);
+  RIME_API ~EntrySorter();
+  EntrySorter(const EntrySorter&) = delete;
+  EntrySorter& operator=(const EntrySorter&) = delete;
+
+  // entries with an empty code are not accepted.
+  RIME_API bool Add(ShortDictEntry&& entry);
+  // no more entries are to be added; starts reading them back.
+  RIME_API bool Finish();
+  // the next entry, in order of its first syllable.
+  RIME_API bool Next(ShortDictEntry* entry);
+
+  size_t num_entries() const { return num_entries_; }
+  size_t num_runs() const { return runs_.size(); }
+
+ private:
+  struct Record {
+    uint64_t sequence;
+    ShortDictEntry entry;
+  };
+  struct Run {
+    path file_path;
+    std::ifstream in;
+    Record head;
+    bool exhausted = false;
+  };
+
+  bool Spill();
+  bool ReadRecord(Run* run);
+  static size_t EstimateSize(const ShortDictEntry& entry);
+
+  path run_file_prefix_;
+  size_t memory_limit_;
+  size_t buffered_size_ = 0;
+  size_t num_entries_ = 0;
+  vector<Record> buffer_;
+  size_t cursor_ = 0;
+  vector<the<Run>> runs_;
+  bool finished_ = false;
+};
+
+}  // namespace rime
+
+#endif  // RIME_ENTRY_SORTER_H_
@@ -5,7 +5,16 @@
 // 2014-12-04 Chen Gong <chen.sst@gmail.com>
 //
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <leveldb/cache.h>
 #include <leveldb/db.h>
+#include <leveldb/filter_policy.h>
 #include <leveldb/write_batch.h>
 #include <rime/common.h>
 #include <rime/service.h>
@@ -16,85 +25,389 @@ namespace rime {
 
 static const char* kMetaCharacter = "\x01";
 
+// writes held in memory; an empty value marks a deleted key.
+using PendingWrites = map<string, std::optional<string>>;
+
+// write-behind: committed updates are flushed to storage in one batch after
+// so many keys are written or so many seconds have passed.
+static const size_t kMaxPendingWrites = 256;
+static const time_t kMaxPendingSeconds = 10;
+// how often the dbs with pending writes are checked for those overdue.
+static const auto kFlushCheckInterval = std::chrono::seconds(1);
+
+static void apply_writes(const PendingWrites& writes, PendingWrites* target) {
+  for (const auto& write : writes) {
+    (*target)[write.first] = write.second;
+  }
+}
+
+// returns whether the key is written; an erased key leaves *value empty.
+static bool find_write(const PendingWrites& writes,
+                       const string& key,
+                       std::optional<string>* value) {
+  auto found = writes.find(key);
+  if (found == writes.end())
+    return false;
+  *value = found->second;
+  return true;
+}
+
+static std::mutex options_mutex;
+static LevelDbOptions configured_options;
+// the cache and filter policy must outlive all dbs using them; like those
+// of leveldb's own defaults, they are never freed.
+static leveldb::Cache* shared_block_cache = nullptr;
+static size_t shared_block_cache_size = 0;
+static const leveldb::FilterPolicy* bloom_filter_policy = nullptr;
+static int bloom_filter_bits = 0;
+
+static leveldb::Options get_options() {
+  std::lock_guard<std::mutex> lock(options_mutex);
+  leveldb::Options options;
+  if (configured_options.block_cache_size > 0) {
+    if (shared_block_cache_size != configured_options.block_cache_size) {
+      shared_block_cache =
+          leveldb::NewLRUCache(configured_options.block_cache_size);
+      shared_block_cache_size = configured_options.block_cache_size;
+    }
+    options.block_cache = shared_block_cache;
+  }
+  if (configured_options.bloom_filter_bits > 0) {
+    if (bloom_filter_bits != configured_options.bloom_filter_bits) {
+      bloom_filter_policy =
+          leveldb::NewBloomFilterPolicy(configured_options.bloom_filter_bits);
+      bloom_filter_bits = configured_options.bloom_filter_bits;
+    }
+    options.filter_policy = bloom_filter_policy;
+  }
+  if (configured_options.write_buffer_size > 0) {
+    options.write_buffer_size = configured_options.write_buffer_size;
+  }
+  if (!configured_options.compression) {
+    options.compression = leveldb::kNoCompression;
+  }
+  return options;
+}
+
+struct LevelDbWrapper;
+
+// flushes the pending writes of dbs once they are due, rather than when
+// the next write comes, which may be long after or never.
+class PendingWritesFlusher {
+ public:
+  static PendingWritesFlusher& instance() {
+    // never destroyed, as dbs held by static objects, eg. the sessions of
+    // the service, may be released after it; the thread ends with the
+    // process.
+    static PendingWritesFlusher* flusher = new PendingWritesFlusher;
+    return *flusher;
+  }
+
+  // the thread is started with the first db to have pending writes.
+  void Schedule(LevelDbWrapper* db) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    scheduled_.insert(db);
+    if (!running_) {
+      running_ = true;
+      std::thread([this] { Run(); }).detach();
+    }
+    wake_.notify_one();
+  }
+
+  // waits for the db to be flushed if it is, and leaves it out after.
+  void Cancel(LevelDbWrapper* db) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    scheduled_.erase(db);
+  }
+
+ private:
+  void Run();
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  set<LevelDbWrapper*> scheduled_;
+  bool running_ = false;
+};
+
+// iterates over the records in a snapshot of the db merged with pending
+// writes.
 struct LevelDbCursor {
+  leveldb::DB* db = nullptr;
+  const leveldb::Snapshot* snapshot = nullptr;
   leveldb::Iterator* iterator = nullptr;
-
-  LevelDbCursor(leveldb::DB* db) {
+  an<const PendingWrites> overlay;
+  PendingWrites::const_iterator overlay_position;
+  // whether the current record comes from the overlay
+  bool on_overlay = false;
+
+  // the overlay is taken before the snapshot, so that writes flushed in
+  // between are found in both rather than in neither.
+  LevelDbCursor(leveldb::DB* db,
+                an<const PendingWrites> pending,
+                bool fill_cache)
+      : db(db),
+        overlay(std::move(pending)),
+        overlay_position(overlay->end()) {
+    snapshot = db->GetSnapshot();
     leveldb::ReadOptions options;
-    options.fill_cache = false;
+    options.fill_cache = fill_cache;
+    options.snapshot = snapshot;
     iterator = db->NewIterator(options);
   }
 
-  bool IsValid() const { return iterator && iterator->Valid(); }
+  bool IsValid() const {
+    return iterator && (on_overlay || iterator->Valid());
+  }
 
-  string GetKey() const { return iterator->key().ToString(); }
+  string GetKey() const {
+    return on_overlay ? overlay_position->first : iterator->key().ToString();
+  }
 
-  string GetValue() const { return iterator->value().ToString(); }
+  string GetValue() const {
+    return on_overlay ? *overlay_position->second
+                      : iterator->value().ToString();
+  }
 
-  void Next() { iterator->Next(); }
+  void Next() {
+    if (on_overlay)
+      ++overlay_position;
+    else
+      iterator->Next();
+    Settle();
+  }
 
   bool Jump(const string& key) {
     if (!iterator) {
       return false;
     }
     iterator->Seek(key);
+    overlay_position = overlay->lower_bound(key);
+    Settle();
     return true;
   }
 
+  // moves to the lesser key of both sources, skipping records shadowed or
+  // deleted by pending writes.
+  void Settle() {
+    on_overlay = false;
+    while (overlay_position != overlay->end()) {
+      int order = iterator->Valid() ? iterator->key().ToString().compare(
+                                          overlay_position->first)
+                                    : 1;
+      if (order < 0)
+        return;
+      if (order == 0)
+        iterator->Next();
+      if (overlay_position->second) {
+        on_overlay = true;
+        return;
+      }
+      ++overlay_position;
+    }
+  }
+
   void Release() {
     delete iterator;
     iterator = nullptr;
+    if (snapshot) {
+      db->ReleaseSnapshot(snapshot);
+      snapshot = nullptr;
+    }
   }
 };
 
+static uint64_t new_wrapper_id() {
+  static std::atomic<uint64_t> next_wrapper_id{1};
+  return next_wrapper_id++;
+}
+
+// writes of the transactions in progress on this thread, by the id of db;
+// each thread may have a transaction of its own on a db at a time.
+static thread_local map<uint64_t, PendingWrites> thread_batches;
+
+// readers of a db shared by sessions on several threads take no lock: they
+// read a published set of pending writes, which writers replace but never
+// modify, and otherwise leveldb, which is safe for concurrent use.
 struct LevelDbWrapper {
   leveldb::DB* ptr = nullptr;
-  leveldb::WriteBatch batch;
+  // the key of its batches in thread_batches; renewed on release, so that
+  // batches left on other threads by transactions never ended are not found.
+  uint64_t id = new_wrapper_id();
+  // committed writes yet to be flushed to storage
+  an<const PendingWrites> pending = New<PendingWrites>();
+  time_t pending_since = 0;
+  // serializes writers
+  std::mutex write_mutex;
+  // scans only fill a block cache shared by all dbs, sized for the purpose;
+  // otherwise they would evict the blocks of frequently fetched records.
+  bool fill_cache_on_scan = false;
 
   leveldb::Status Open(const path& file_path, bool readonly) {
-    leveldb::Options options;
+    leveldb::Options options = get_options();
     options.create_if_missing = !readonly;
+    fill_cache_on_scan = options.block_cache != nullptr;
     return leveldb::DB::Open(options, file_path.string(), &ptr);
   }
 
   void Release() {
+    PendingWritesFlusher::instance().Cancel(this);
+    Flush();
+    thread_batches.erase(id);
+    id = new_wrapper_id();
     delete ptr;
     ptr = nullptr;
   }
 
-  LevelDbCursor* CreateCursor() { return new LevelDbCursor(ptr); }
+  an<const PendingWrites> committed() const {
+    return std::atomic_load(&pending);
+  }
+
+  // the batch of the transaction begun on the calling thread, or null.
+  PendingWrites* batch() {
+    auto found = thread_batches.find(id);
+    return found != thread_batches.end() ? &found->second : nullptr;
+  }
+
+  bool HasBatch() const { return thread_batches.count(id) != 0; }
+
+  void BeginBatch() { thread_batches[id].clear(); }
+
+  void EndBatch() { thread_batches.erase(id); }
+
+  LevelDbCursor* CreateCursor(const PendingWrites* batch) {
+    an<const PendingWrites> overlay = committed();
+    if (batch && !batch->empty()) {
+      auto merged = New<PendingWrites>(*overlay);
+      apply_writes(*batch, merged.get());
+      overlay = merged;
+    }
+    return new LevelDbCursor(ptr, overlay, fill_cache_on_scan);
+  }
 
-  bool Fetch(const string& key, string* value) {
+  bool Fetch(const string& key, string* value, const PendingWrites* batch) {
+    std::optional<string> write;
+    if ((batch && find_write(*batch, key, &write)) ||
+        find_write(*committed(), key, &write)) {
+      if (!write)
+        return false;
+      *value = std::move(*write);
+      return true;
+    }
     auto status = ptr->Get(leveldb::ReadOptions(), key, value);
     return status.ok();
   }
 
-  bool Update(const string& key, const string& value, bool write_batch) {
-    if (write_batch) {
-      batch.Put(key, value);
+  bool Update(const string& key, const string& value, PendingWrites* batch) {
+    if (batch) {
+      (*batch)[key] = value;
       return true;
     }
-    auto status = ptr->Put(leveldb::WriteOptions(), key, value);
-    return status.ok();
+    return Write(key, value);
   }
 
-  bool Erase(const string& key, bool write_batch) {
-    if (write_batch) {
-      batch.Delete(key);
+  bool Erase(const string& key, PendingWrites* batch) {
+    if (batch) {
+      (*batch)[key] = std::nullopt;
       return true;
     }
-    auto status = ptr->Delete(leveldb::WriteOptions(), key);
-    return status.ok();
+    return Write(key, std::nullopt);
   }
 
-  void ClearBatch() { batch.Clear(); }
+  bool CommitBatch(const PendingWrites& batch) {
+    if (batch.empty())
+      return true;
+    return Commit(
+        [&batch](PendingWrites* writes) { apply_writes(batch, writes); });
+  }
 
-  bool CommitBatch() {
-    auto status = ptr->Write(leveldb::WriteOptions(), &batch);
-    return status.ok();
+  bool Write(const string& key, std::optional<string> value) {
+    return Commit([&key, &value](PendingWrites* writes) {
+      (*writes)[key] = std::move(value);
+    });
+  }
+
+  bool Flush() {
+    std::lock_guard<std::mutex> lock(write_mutex);
+    return FlushPending();
+  }
+
+  // returns false if the pending writes are yet to be due, or have failed
+  // to be flushed, for the flusher to try again later.
+  bool FlushIfOverdue(time_t now) {
+    std::lock_guard<std::mutex> lock(write_mutex);
+    if (!pending->empty() && now - pending_since < kMaxPendingSeconds)
+      return false;
+    return FlushPending();
+  }
+
+ private:
+  bool Commit(function<void(PendingWrites* writes)> apply) {
+    bool ok = true;
+    bool held = false;
+    {
+      std::lock_guard<std::mutex> lock(write_mutex);
+      if (pending->empty())
+        pending_since = time(NULL);
+      auto writes = New<PendingWrites>(*pending);
+      apply(writes.get());
+      std::atomic_store(&pending, an<const PendingWrites>(writes));
+      ok = FlushIfDue();
+      held = !pending->empty();
+    }
+    // scheduled without holding write_mutex, which the flusher takes while
+    // holding its own lock.
+    if (held)
+      PendingWritesFlusher::instance().Schedule(this);
+    return ok;
+  }
+
+  // the following expect write_mutex to be held.
+
+  bool FlushIfDue() {
+    if (pending->size() < kMaxPendingWrites &&
+        time(NULL) - pending_since < kMaxPendingSeconds)
+      return true;
+    return FlushPending();
+  }
+
+  bool FlushPending() {
+    if (pending->empty() || !ptr)
+      return true;
+    leveldb::WriteBatch updates;
+    for (const auto& write : *pending) {
+      if (write.second)
+        updates.Put(write.first, *write.second);
+      else
+        updates.Delete(write.first);
+    }
+    auto status = ptr->Write(leveldb::WriteOptions(), &updates);
+    if (!status.ok()) {
+      LOG(ERROR) << "failed to write pending updates: " << status.ToString();
+      return false;
+    }
+    std::atomic_store(&pending, an<const PendingWrites>(New<PendingWrites>()));
+    return true;
   }
 };
 
+void PendingWritesFlusher::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    if (scheduled_.empty()) {
+      wake_.wait(lock);
+      continue;
+    }
+    wake_.wait_for(lock, kFlushCheckInterval);
+    time_t now = time(NULL);
+    for (auto it = scheduled_.begin(); it != scheduled_.end();) {
+      if ((*it)->FlushIfOverdue(now))
+        it = scheduled_.erase(it);
+      else
+        ++it;
+    }
+  }
+}
+
 // LevelDbAccessor members
 
 LevelDbAccessor::LevelDbAccessor() {}
@@ -167,27 +480,27 @@ an<DbAccessor> LevelDb::QueryAll() {
 an<DbAccessor> LevelDb::Query(const string& key) {
   if (!loaded())
     return nullptr;
-  return New<LevelDbAccessor>(db_->CreateCursor(), key);
+  return New<LevelDbAccessor>(db_->CreateCursor(db_->batch()), key);
 }
 
 bool LevelDb::Fetch(const string& key, string* value) {
   if (!value || !loaded())
     return false;
-  return db_->Fetch(key, value);
+  return db_->Fetch(key, value, db_->batch());
 }
 
 bool LevelDb::Update(const string& key, const string& value) {
   if (!loaded() || readonly())
     return false;
   DLOG(INFO) << "update db entry: " << key << " => " << value;
-  return db_->Update(key, value, in_transaction());
+  return db_->Update(key, value, db_->batch());
 }
 
 bool LevelDb::Erase(const string& key) {
   if (!loaded() || readonly())
     return false;
   DLOG(INFO) << "erase db entry: " << key;
-  return db_->Erase(key, in_transaction());
+  return db_->Erase(key, db_->batch());
 }
 
 bool LevelDb::Backup(const path& snapshot_file) {
@@ -215,6 +528,11 @@ bool LevelDb::Restore(const path& snapshot_file) {
   return success;
 }
 
+void LevelDb::Configure(const LevelDbOptions& options) {
+  std::lock_guard<std::mutex> lock(options_mutex);
+  configured_options = options;
+}
+
 bool LevelDb::Recover() {
   LOG(INFO) << "trying to recover db '" << name() << "'.";
   auto status = leveldb::RepairDB(file_path().string(), leveldb::Options());
@@ -226,6 +544,16 @@ bool LevelDb::Recover() {
   return false;
 }
 
+bool LevelDb::Compact() {
+  if (!loaded() || readonly())
+    return false;
+  if (!db_->Flush())
+    return false;
+  LOG(INFO) << "compacting db '" << name() << "'.";
+  db_->ptr->CompactRange(nullptr, nullptr);
+  return true;
+}
+
 bool LevelDb::Remove() {
   if (loaded()) {
     LOG(ERROR) << "attempt to remove opened db '" << name() << "'.";
@@ -303,28 +631,38 @@ bool LevelDb::MetaUpdate(const string& key, const string& value) {
 bool LevelDb::BeginTransaction() {
   if (!loaded())
     return false;
-  db_->ClearBatch();
-  in_transaction_ = true;
+  db_->BeginBatch();
   return true;
 }
 
 bool LevelDb::AbortTransaction() {
-  if (!loaded() || !in_transaction())
+  if (!loaded() || !db_->batch())
     return false;
-  db_->ClearBatch();
-  in_transaction_ = false;
+  db_->EndBatch();
   return true;
 }
 
 bool LevelDb::CommitTransaction() {
-  if (!loaded() || !in_transaction())
+  if (!loaded())
     return false;
-  bool ok = db_->CommitBatch();
-  db_->ClearBatch();
-  in_transaction_ = false;
+  auto* batch = db_->batch();
+  if (!batch)
+    return false;
+  bool ok = db_->CommitBatch(*batch);
+  db_->EndBatch();
   return ok;
 }
 
+bool LevelDb::in_transaction() const {
+  return loaded() && db_->HasBatch();
+}
+
+bool LevelDb::FlushPendingWrites() {
+  if (!loaded())
+    return false;
+  return db_->Flush();
+}
+
 template <>
 RIME_API string UserDbComponent<LevelDb>::extension() const {
   return ".userdb";
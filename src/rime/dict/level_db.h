@@ -14,6 +14,19 @@ namespace rime {
 struct LevelDbCursor;
 struct LevelDbWrapper;
 
+// tuning of the LevelDb instances opened after LevelDb::Configure().
+struct LevelDbOptions {
+  // size in bytes of an LRU block cache shared by all dbs in the process;
+  // 0 leaves each db with the default cache of its own.
+  size_t block_cache_size = 0;
+  // bits per key of a bloom filter speeding up fetching by exact keys;
+  // 0 for no filter.
+  int bloom_filter_bits = 0;
+  // 0 for the default of leveldb.
+  size_t write_buffer_size = 0;
+  bool compression = true;
+};
+
 class LevelDb;
 
 class LevelDbAccessor : public DbAccessor {
@@ -57,14 +70,23 @@ class LevelDb : public Db, public Recoverable, public Transactional {
   bool Fetch(const string& key, string* value) override;
   bool Update(const string& key, const string& value) override;
   bool Erase(const string& key) override;
+  bool binary_safe() const override { return true; }
 
   // Recoverable
   bool Recover() override;
 
+  RIME_API static void Configure(const LevelDbOptions& options);
+
+  // flushes pending writes and compacts the whole key range, dropping the
+  // space held by erased and overwritten entries.
+  RIME_API bool Compact();
+
   // Transactional
   bool BeginTransaction() override;
   bool AbortTransaction() override;
   bool CommitTransaction() override;
+  bool FlushPendingWrites() override;
+  bool in_transaction() const override;
 
  private:
   void Initialize();
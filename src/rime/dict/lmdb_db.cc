@@ -0,0 +1,527 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <rime/common.h>
+
+#ifdef RIME_ENABLE_LMDB
+
+#include <atomic>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <lmdb.h>
+#include <rime/dict/lmdb_db.h>
+#include <rime/dict/user_db.h>
+
+namespace rime {
+
+static const char* kMetaCharacter = "\x01";
+
+// the address space reserved for the memory map, which bounds the size of
+// the db. the file only grows as records are written, except on Windows.
+static const size_t kMapSize = size_t(256) << 20;
+
+// commits are made durable by the OS in its own time, which keeps the db
+// intact if the process crashes; they are synced to disk at the latest so
+// many seconds later, or when pending writes are flushed.
+static const time_t kMaxUnsyncedSeconds = 10;
+
+static MDB_val to_mdb_val(const string& s) {
+  return MDB_val{s.size(), const_cast<char*>(s.data())};
+}
+
+static string to_string(const MDB_val& v) {
+  return string(static_cast<const char*>(v.mv_data), v.mv_size);
+}
+
+struct LmdbWrapper {
+  MDB_env* env = nullptr;
+  MDB_dbi dbi = 0;
+  // the write transaction of the current db transaction, used only by the
+  // thread that began it.
+  MDB_txn* batch = nullptr;
+  std::thread::id batch_owner;
+  // read transactions are reset after use and renewed for the next reader,
+  // which spares the lock taken to assign a new reader slot.
+  vector<MDB_txn*> idle_readers;
+  std::mutex readers_mutex;
+  std::atomic<time_t> synced_at{0};
+
+  int Open(const path& file_path, bool readonly) {
+    if (!readonly) {
+      std::error_code ec;
+      std::filesystem::create_directories(file_path, ec);
+    }
+    int rc = mdb_env_create(&env);
+    if (rc != MDB_SUCCESS)
+      return rc;
+    mdb_env_set_mapsize(env, kMapSize);
+    // read transactions are not bound to threads, so a thread may hold
+    // several accessors at a time.
+    unsigned int flags = MDB_NOTLS | MDB_NOSYNC | (readonly ? MDB_RDONLY : 0);
+    rc = mdb_env_open(env, file_path.string().c_str(), flags, 0644);
+    if (rc == MDB_SUCCESS) {
+      // frees the reader slots of processes that died reading the db.
+      int dead = 0;
+      mdb_reader_check(env, &dead);
+      MDB_txn* txn = nullptr;
+      rc = mdb_txn_begin(env, nullptr, readonly ? MDB_RDONLY : 0, &txn);
+      if (rc == MDB_SUCCESS) {
+        rc = mdb_dbi_open(txn, nullptr, 0, &dbi);
+        if (rc == MDB_SUCCESS)
+          rc = mdb_txn_commit(txn);
+        else
+          mdb_txn_abort(txn);
+      }
+    }
+    if (rc != MDB_SUCCESS) {
+      mdb_env_close(env);
+      env = nullptr;
+      return rc;
+    }
+    synced_at = time(NULL);
+    return MDB_SUCCESS;
+  }
+
+  void Release() {
+    if (!env)
+      return;
+    AbortBatch();
+    for (MDB_txn* txn : idle_readers) {
+      mdb_txn_abort(txn);
+    }
+    idle_readers.clear();
+    mdb_env_sync(env, 1);
+    mdb_env_close(env);
+    env = nullptr;
+  }
+
+  bool OwnsBatch(bool in_transaction) const {
+    return in_transaction && batch &&
+           batch_owner == std::this_thread::get_id();
+  }
+
+  MDB_txn* BeginRead() {
+    MDB_txn* txn = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(readers_mutex);
+      if (!idle_readers.empty()) {
+        txn = idle_readers.back();
+        idle_readers.pop_back();
+      }
+    }
+    if (txn && mdb_txn_renew(txn) == MDB_SUCCESS)
+      return txn;
+    if (txn)
+      mdb_txn_abort(txn);
+    int rc = mdb_txn_begin(env, nullptr, MDB_RDONLY, &txn);
+    if (rc != MDB_SUCCESS) {
+      LOG(ERROR) << "error beginning read transaction: " << mdb_strerror(rc);
+      return nullptr;
+    }
+    return txn;
+  }
+
+  void EndRead(MDB_txn* txn) {
+    if (!txn)
+      return;
+    mdb_txn_reset(txn);
+    std::lock_guard<std::mutex> lock(readers_mutex);
+    idle_readers.push_back(txn);
+  }
+
+  bool Fetch(const string& key, string* value, bool with_batch) {
+    MDB_txn* txn = with_batch ? batch : BeginRead();
+    if (!txn)
+      return false;
+    MDB_val k = to_mdb_val(key);
+    MDB_val v;
+    bool found = mdb_get(txn, dbi, &k, &v) == MDB_SUCCESS;
+    if (found)
+      value->assign(static_cast<const char*>(v.mv_data), v.mv_size);
+    if (!with_batch)
+      EndRead(txn);
+    return found;
+  }
+
+  bool Write(const string& key,
+             const std::optional<string>& value,
+             bool with_batch) {
+    if (with_batch)
+      return Put(batch, key, value);
+    MDB_txn* txn = nullptr;
+    int rc = mdb_txn_begin(env, nullptr, 0, &txn);
+    if (rc != MDB_SUCCESS) {
+      LOG(ERROR) << "error beginning write transaction: " << mdb_strerror(rc);
+      return false;
+    }
+    if (!Put(txn, key, value)) {
+      mdb_txn_abort(txn);
+      return false;
+    }
+    return Commit(txn);
+  }
+
+  bool BeginBatch() {
+    int rc = mdb_txn_begin(env, nullptr, 0, &batch);
+    if (rc != MDB_SUCCESS) {
+      LOG(ERROR) << "error beginning write transaction: " << mdb_strerror(rc);
+      batch = nullptr;
+      return false;
+    }
+    batch_owner = std::this_thread::get_id();
+    return true;
+  }
+
+  void AbortBatch() {
+    if (!batch)
+      return;
+    mdb_txn_abort(batch);
+    batch = nullptr;
+  }
+
+  bool CommitBatch() {
+    MDB_txn* txn = batch;
+    batch = nullptr;
+    return Commit(txn);
+  }
+
+  bool Sync() {
+    int rc = mdb_env_sync(env, 1);
+    if (rc != MDB_SUCCESS) {
+      LOG(ERROR) << "error syncing db: " << mdb_strerror(rc);
+      return false;
+    }
+    synced_at = time(NULL);
+    return true;
+  }
+
+ private:
+  bool Put(MDB_txn* txn,
+           const string& key,
+           const std::optional<string>& value) {
+    MDB_val k = to_mdb_val(key);
+    int rc;
+    if (value) {
+      MDB_val v = to_mdb_val(*value);
+      rc = mdb_put(txn, dbi, &k, &v, 0);
+    } else {
+      rc = mdb_del(txn, dbi, &k, nullptr);
+      if (rc == MDB_NOTFOUND)
+        rc = MDB_SUCCESS;
+    }
+    if (rc != MDB_SUCCESS) {
+      LOG(ERROR) << "error writing db entry '" << key
+                 << "': " << mdb_strerror(rc);
+      return false;
+    }
+    return true;
+  }
+
+  bool Commit(MDB_txn* txn) {
+    int rc = mdb_txn_commit(txn);
+    if (rc != MDB_SUCCESS) {
+      LOG(ERROR) << "error committing transaction: " << mdb_strerror(rc);
+      return false;
+    }
+    if (time(NULL) - synced_at >= kMaxUnsyncedSeconds)
+      return Sync();
+    return true;
+  }
+};
+
+// iterates over the records committed when the cursor is created. records
+// are read in place from the memory map, and only copied when returned.
+struct LmdbCursor {
+  LmdbWrapper* db = nullptr;
+  MDB_txn* txn = nullptr;
+  MDB_cursor* cursor = nullptr;
+  MDB_val key{0, nullptr};
+  MDB_val value{0, nullptr};
+  bool valid = false;
+
+  explicit LmdbCursor(LmdbWrapper* db) : db(db), txn(db->BeginRead()) {
+    if (txn && mdb_cursor_open(txn, db->dbi, &cursor) != MDB_SUCCESS)
+      cursor = nullptr;
+  }
+
+  bool IsValid() const { return valid; }
+
+  bool HasPrefix(const string& prefix) const {
+    return valid && key.mv_size >= prefix.size() &&
+           std::memcmp(key.mv_data, prefix.data(), prefix.size()) == 0;
+  }
+
+  bool Jump(const string& target) {
+    if (!cursor) {
+      return false;
+    }
+    // lmdb takes no empty keys, nor seeks to one.
+    if (target.empty()) {
+      valid = mdb_cursor_get(cursor, &key, &value, MDB_FIRST) == MDB_SUCCESS;
+    } else {
+      key = to_mdb_val(target);
+      valid =
+          mdb_cursor_get(cursor, &key, &value, MDB_SET_RANGE) == MDB_SUCCESS;
+    }
+    return true;
+  }
+
+  void Next() {
+    valid = mdb_cursor_get(cursor, &key, &value, MDB_NEXT) == MDB_SUCCESS;
+  }
+
+  void Release() {
+    valid = false;
+    if (cursor) {
+      mdb_cursor_close(cursor);
+      cursor = nullptr;
+    }
+    if (txn) {
+      db->EndRead(txn);
+      txn = nullptr;
+    }
+  }
+};
+
+// LmdbDbAccessor members
+
+LmdbDbAccessor::LmdbDbAccessor(LmdbCursor* cursor, const string& prefix)
+    : DbAccessor(prefix),
+      cursor_(cursor),
+      is_metadata_query_(prefix == kMetaCharacter) {
+  Reset();
+}
+
+LmdbDbAccessor::~LmdbDbAccessor() {
+  cursor_->Release();
+}
+
+bool LmdbDbAccessor::Reset() {
+  return cursor_->Jump(prefix_);
+}
+
+bool LmdbDbAccessor::Jump(const string& key) {
+  return cursor_->Jump(key);
+}
+
+bool LmdbDbAccessor::GetNextRecord(string* key, string* value) {
+  if (!key || !value || !cursor_->HasPrefix(prefix_))
+    return false;
+  *key = to_string(cursor_->key);
+  if (is_metadata_query_) {
+    key->erase(0, 1);  // remove meta character
+  }
+  *value = to_string(cursor_->value);
+  cursor_->Next();
+  return true;
+}
+
+bool LmdbDbAccessor::exhausted() {
+  return !cursor_->HasPrefix(prefix_);
+}
+
+// LmdbDb members
+
+LmdbDb::LmdbDb(const path& file_path,
+               const string& db_name,
+               const string& db_type)
+    : Db(file_path, db_name), db_type_(db_type) {}
+
+LmdbDb::~LmdbDb() {
+  if (loaded())
+    Close();
+}
+
+void LmdbDb::Initialize() {
+  db_.reset(new LmdbWrapper);
+}
+
+an<DbAccessor> LmdbDb::QueryMetadata() {
+  return Query(kMetaCharacter);
+}
+
+an<DbAccessor> LmdbDb::QueryAll() {
+  an<DbAccessor> all = Query("");
+  if (all)
+    all->Jump(" ");  // skip metadata
+  return all;
+}
+
+// queries see the records committed, not the writes of a transaction in
+// progress, which the cursor of a query could outlive.
+an<DbAccessor> LmdbDb::Query(const string& key) {
+  if (!loaded())
+    return nullptr;
+  return New<LmdbDbAccessor>(new LmdbCursor(db_.get()), key);
+}
+
+bool LmdbDb::Fetch(const string& key, string* value) {
+  if (!value || !loaded())
+    return false;
+  return db_->Fetch(key, value, db_->OwnsBatch(in_transaction()));
+}
+
+bool LmdbDb::Update(const string& key, const string& value) {
+  if (!loaded() || readonly())
+    return false;
+  DLOG(INFO) << "update db entry: " << key << " => " << value;
+  return db_->Write(key, value, db_->OwnsBatch(in_transaction()));
+}
+
+bool LmdbDb::Erase(const string& key) {
+  if (!loaded() || readonly())
+    return false;
+  DLOG(INFO) << "erase db entry: " << key;
+  return db_->Write(key, std::nullopt, db_->OwnsBatch(in_transaction()));
+}
+
+bool LmdbDb::Backup(const path& snapshot_file) {
+  if (!loaded())
+    return false;
+  LOG(INFO) << "backing up db '" << name() << "' to " << snapshot_file;
+  bool success = UserDbHelper(this).UniformBackup(snapshot_file);
+  if (!success) {
+    LOG(ERROR) << "failed to create snapshot file '" << snapshot_file
+               << "' for db '" << name() << "'.";
+  }
+  return success;
+}
+
+bool LmdbDb::Restore(const path& snapshot_file) {
+  if (!loaded() || readonly())
+    return false;
+  bool success = UserDbHelper(this).UniformRestore(snapshot_file);
+  if (!success) {
+    LOG(ERROR) << "failed to restore db '" << name() << "' from '"
+               << snapshot_file << "'.";
+  }
+  return success;
+}
+
+bool LmdbDb::Remove() {
+  if (loaded()) {
+    LOG(ERROR) << "attempt to remove opened db '" << name() << "'.";
+    return false;
+  }
+  std::error_code ec;
+  std::filesystem::remove_all(file_path(), ec);
+  if (ec) {
+    LOG(ERROR) << "Error removing db '" << name() << "': " << ec.message();
+    return false;
+  }
+  return true;
+}
+
+bool LmdbDb::Open() {
+  if (loaded())
+    return false;
+  Initialize();
+  readonly_ = false;
+  int rc = db_->Open(file_path(), readonly_);
+  loaded_ = rc == MDB_SUCCESS;
+
+  if (loaded_) {
+    string db_name;
+    if (!MetaFetch("/db_name", &db_name)) {
+      if (!CreateMetadata()) {
+        LOG(ERROR) << "error creating metadata.";
+        Close();
+      }
+    }
+  } else {
+    LOG(ERROR) << "Error opening db '" << name() << "': " << mdb_strerror(rc);
+  }
+  return loaded_;
+}
+
+bool LmdbDb::OpenReadOnly() {
+  if (loaded())
+    return false;
+  Initialize();
+  readonly_ = true;
+  int rc = db_->Open(file_path(), readonly_);
+  loaded_ = rc == MDB_SUCCESS;
+
+  if (!loaded_) {
+    LOG(ERROR) << "Error opening db '" << name()
+               << "' read-only: " << mdb_strerror(rc);
+  }
+  return loaded_;
+}
+
+bool LmdbDb::Close() {
+  if (!loaded())
+    return false;
+
+  db_->Release();
+
+  LOG(INFO) << "closed db '" << name() << "'.";
+  loaded_ = false;
+  readonly_ = false;
+  in_transaction_ = false;
+  return true;
+}
+
+bool LmdbDb::CreateMetadata() {
+  return Db::CreateMetadata() && MetaUpdate("/db_type", db_type_);
+}
+
+bool LmdbDb::MetaFetch(const string& key, string* value) {
+  return Fetch(kMetaCharacter + key, value);
+}
+
+bool LmdbDb::MetaUpdate(const string& key, const string& value) {
+  return Update(kMetaCharacter + key, value);
+}
+
+// the transaction holds the single writer lock of the db until it ends;
+// writes made by other threads meanwhile wait for it.
+bool LmdbDb::BeginTransaction() {
+  if (!loaded() || readonly())
+    return false;
+  if (db_->OwnsBatch(in_transaction()))
+    db_->AbortBatch();
+  in_transaction_ = db_->BeginBatch();
+  return in_transaction_;
+}
+
+bool LmdbDb::AbortTransaction() {
+  if (!loaded() || !db_->OwnsBatch(in_transaction()))
+    return false;
+  db_->AbortBatch();
+  in_transaction_ = false;
+  return true;
+}
+
+bool LmdbDb::CommitTransaction() {
+  if (!loaded() || !db_->OwnsBatch(in_transaction()))
+    return false;
+  bool ok = db_->CommitBatch();
+  in_transaction_ = false;
+  return ok;
+}
+
+bool LmdbDb::FlushPendingWrites() {
+  if (!loaded())
+    return false;
+  return readonly() || db_->Sync();
+}
+
+template <>
+RIME_API string UserDbComponent<LmdbDb>::extension() const {
+  return ".userdb.lmdb";
+}
+
+template <>
+RIME_API UserDbWrapper<LmdbDb>::UserDbWrapper(const path& file_path,
+                                              const string& db_name)
+    : LmdbDb(file_path, db_name, "userdb") {}
+
+}  // namespace rime
+
+#endif  // RIME_ENABLE_LMDB
@@ -0,0 +1,76 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#ifndef RIME_LMDB_DB_H_
+#define RIME_LMDB_DB_H_
+
+#include <rime/dict/db.h>
+
+namespace rime {
+
+struct LmdbCursor;
+struct LmdbWrapper;
+
+class LmdbDbAccessor : public DbAccessor {
+ public:
+  LmdbDbAccessor(LmdbCursor* cursor, const string& prefix);
+  virtual ~LmdbDbAccessor();
+
+  bool Reset() override;
+  bool Jump(const string& key) override;
+  bool GetNextRecord(string* key, string* value) override;
+  bool exhausted() override;
+
+ private:
+  the<LmdbCursor> cursor_;
+  bool is_metadata_query_ = false;
+};
+
+// A db in an LMDB environment, a B+tree in a memory-mapped file.
+// Reads take no lock and see records in place in the map; writes are made
+// in transactions that leave the file consistent if the process crashes,
+// so the db needs no recovery.
+class LmdbDb : public Db, public Transactional {
+ public:
+  LmdbDb(const path& file_path,
+         const string& db_name,
+         const string& db_type = "");
+  virtual ~LmdbDb();
+
+  bool Remove() override;
+  bool Open() override;
+  bool OpenReadOnly() override;
+  bool Close() override;
+
+  bool Backup(const path& snapshot_file) override;
+  bool Restore(const path& snapshot_file) override;
+
+  bool CreateMetadata() override;
+  bool MetaFetch(const string& key, string* value) override;
+  bool MetaUpdate(const string& key, const string& value) override;
+
+  an<DbAccessor> QueryMetadata() override;
+  an<DbAccessor> QueryAll() override;
+  an<DbAccessor> Query(const string& key) override;
+  bool Fetch(const string& key, string* value) override;
+  bool Update(const string& key, const string& value) override;
+  bool Erase(const string& key) override;
+  bool binary_safe() const override { return true; }
+
+  // Transactional
+  bool BeginTransaction() override;
+  bool AbortTransaction() override;
+  bool CommitTransaction() override;
+  bool FlushPendingWrites() override;
+
+ private:
+  void Initialize();
+
+  the<LmdbWrapper> db_;
+  string db_type_;
+};
+
+}  // namespace rime
+
+#endif  // RIME_LMDB_DB_H_
@@ -10,7 +10,13 @@
 #include <filesystem>
 #include <boost/interprocess/file_mapping.hpp>
 #include <boost/interprocess/mapped_region.hpp>
+#include <rime/config.h>
 #include <rime/dict/mapped_file.h>
+#include <rime/dict/string_table.h>
+#if defined(__linux__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 namespace rime {
 
@@ -21,22 +27,66 @@ class MappedFileImpl {
     kOpenReadWrite,
   };
 
-  MappedFileImpl(const path& file_path, OpenMode mode) {
+  MappedFileImpl(const path& file_path,
+                 OpenMode mode,
+                 int load_flags = MappedFile::kLoadDefault) {
     boost::interprocess::mode_t file_mapping_mode =
         (mode == kOpenReadOnly) ? boost::interprocess::read_only
                                 : boost::interprocess::read_write;
     file_.reset(new boost::interprocess::file_mapping(file_path.c_str(),
                                                       file_mapping_mode));
-    region_.reset(
-        new boost::interprocess::mapped_region(*file_, file_mapping_mode));
+    auto map_options = boost::interprocess::default_map_options;
+#ifdef MAP_POPULATE
+    if (load_flags & MappedFile::kLoadPrefetch) {
+      map_options = MAP_POPULATE;
+    }
+#endif
+    region_.reset(new boost::interprocess::mapped_region(
+        *file_, file_mapping_mode, 0, 0, nullptr, map_options));
+    Advise(load_flags);
   }
   ~MappedFileImpl() {
     region_.reset();
     file_.reset();
   }
   bool Flush() { return region_->flush(); }
+  void Advise(int load_flags) {
+    using boost::interprocess::mapped_region;
+    if (load_flags & MappedFile::kLoadRandomAccess) {
+      region_->advise(mapped_region::advice_random);
+    }
+#ifdef MADV_HUGEPAGE
+    if (load_flags & MappedFile::kLoadHugePages) {
+      madvise(region_->get_address(), region_->get_size(), MADV_HUGEPAGE);
+    }
+#endif
+    if (load_flags & MappedFile::kLoadPrefetch) {
+      region_->advise(mapped_region::advice_willneed);
+    }
+  }
   void* get_address() const { return region_->get_address(); }
   size_t get_size() const { return region_->get_size(); }
+  size_t resident_size() const {
+    size_t size = get_size();
+#if defined(__linux__) || defined(__APPLE__)
+    size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#ifdef __APPLE__
+    vector<char> pages((size + page_size - 1) / page_size);
+#else
+    vector<unsigned char> pages((size + page_size - 1) / page_size);
+#endif
+    if (mincore(get_address(), size, pages.data()) != 0)
+      return size;
+    size_t resident_pages = 0;
+    for (auto page : pages) {
+      if (page & 1)
+        ++resident_pages;
+    }
+    return (std::min)(size, resident_pages * page_size);
+#else
+    return size;
+#endif
+  }
 
  private:
   the<boost::interprocess::file_mapping> file_;
@@ -46,6 +96,7 @@ class MappedFileImpl {
 MappedFile::MappedFile(const path& file_path) : file_path_(file_path) {}
 
 MappedFile::~MappedFile() {
+  memory_stats_.reset();
   if (file_) {
     file_.reset();
   }
@@ -68,6 +119,7 @@ bool MappedFile::Create(size_t capacity) {
     fbuf.close();
   }
   LOG(INFO) << "opening file for read/write access.";
+  memory_stats_.reset();
   file_.reset(new MappedFileImpl(file_path_, MappedFileImpl::kOpenReadWrite));
   size_ = 0;
   return bool(file_);
@@ -78,7 +130,9 @@ bool MappedFile::OpenReadOnly() {
     LOG(ERROR) << "attempt to open non-existent file '" << file_path_ << "'.";
     return false;
   }
-  file_.reset(new MappedFileImpl(file_path_, MappedFileImpl::kOpenReadOnly));
+  memory_stats_.reset();
+  file_.reset(new MappedFileImpl(file_path_, MappedFileImpl::kOpenReadOnly,
+                                 load_flags_));
   size_ = file_->get_size();
   return bool(file_);
 }
@@ -88,18 +142,89 @@ bool MappedFile::OpenReadWrite() {
     LOG(ERROR) << "attempt to open non-existent file '" << file_path_ << "'.";
     return false;
   }
+  memory_stats_.reset();
   file_.reset(new MappedFileImpl(file_path_, MappedFileImpl::kOpenReadWrite));
   size_ = 0;
   return bool(file_);
 }
 
+int MappedFile::GetLoadFlags(Config* config, const string& path) {
+  static const map<string, int> kLoadFlagNames = {
+      {"prefetch", kLoadPrefetch},
+      {"random_access", kLoadRandomAccess},
+      {"huge_pages", kLoadHugePages},
+  };
+  vector<string> names;
+  if (!config) {
+    return kLoadDefault;
+  } else if (auto list = config->GetList(path)) {
+    for (const auto& item : *list) {
+      if (auto value = As<ConfigValue>(item)) {
+        names.push_back(value->str());
+      }
+    }
+  } else {
+    string name;
+    if (config->GetString(path, &name)) {
+      names.push_back(name);
+    }
+  }
+  int flags = kLoadDefault;
+  for (const auto& name : names) {
+    auto found = kLoadFlagNames.find(name);
+    if (found != kLoadFlagNames.end()) {
+      flags |= found->second;
+    } else {
+      LOG(WARNING) << "unknown load mode '" << name << "' at " << path;
+    }
+  }
+  return flags;
+}
+
 void MappedFile::Close() {
+  memory_stats_.reset();
   if (file_) {
     file_.reset();
     size_ = 0;
   }
 }
 
+void MappedFile::TrackMemoryUsage(const string& category) {
+  memory_stats_.reset();
+  if (!file_)
+    return;
+  memory_stats_.reset(new MemoryStatsRegistration(
+      [this, category](vector<MemoryUsage>* usages) {
+        MemoryUsage usage;
+        usage.category = category;
+        usage.name = file_path_.u8string();
+        usage.mapped_bytes = file_->get_size();
+        usage.resident_bytes = file_->resident_size();
+        usages->push_back(std::move(usage));
+      }));
+}
+
+void MappedFile::TouchPages(const void* start, size_t size) {
+  if (!start || size == 0)
+    return;
+#if defined(__linux__) || defined(__APPLE__)
+  size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#else
+  size_t page_size = 4096;
+#endif
+  auto bytes = static_cast<const volatile char*>(start);
+  char sum = 0;
+  for (size_t offset = 0; offset < size; offset += page_size) {
+    sum ^= bytes[offset];
+  }
+  sum ^= bytes[size - 1];
+  (void)sum;
+}
+
+size_t MappedFile::resident_size() const {
+  return file_ ? file_->resident_size() : 0;
+}
+
 bool MappedFile::Exists() const {
   return std::filesystem::exists(file_path_);
 }
@@ -119,6 +244,12 @@ bool MappedFile::ShrinkToFit() {
   return Resize(size_);
 }
 
+void MappedFile::ReportFileTooLarge(size_t required_size) const {
+  LOG(ERROR) << "file would grow to " << required_size << " bytes, beyond "
+             << kMaxFileSize << " bytes addressable by 32-bit offsets: "
+             << file_path_;
+}
+
 bool MappedFile::Remove() {
   if (IsOpen())
     Close();
@@ -137,6 +268,14 @@ bool MappedFile::Resize(size_t capacity) {
   return true;
 }
 
+char* MappedFile::AllocateStringTableImage(size_t size) {
+  struct alignas(StringTable::kImageAlignment) Unit {
+    char bytes[StringTable::kImageAlignment];
+  };
+  size_t count = (size + sizeof(Unit) - 1) / sizeof(Unit);
+  return reinterpret_cast<char*>(Allocate<Unit>(count));
+}
+
 String* MappedFile::CreateString(const string& str) {
   String* ret = Allocate<String>();
   if (ret && !str.empty()) {
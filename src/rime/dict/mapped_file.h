@@ -9,8 +9,10 @@
 
 #include <stdint.h>
 #include <cstring>
+#include <limits>
 #include <rime_api.h>
 #include <rime/common.h>
+#include <rime/memory_stats.h>
 
 namespace rime {
 
@@ -78,6 +80,7 @@ struct List {
 
 // MappedFile class definition
 
+class Config;
 class MappedFileImpl;
 
 class RIME_API MappedFile {
@@ -98,17 +101,39 @@ class RIME_API MappedFile {
   template <class T>
   Array<T>* CreateArray(size_t array_size);
 
+  // allocates a string table image aligned for being mapped in place.
+  char* AllocateStringTableImage(size_t size);
   String* CreateString(const string& str);
   bool CopyString(const string& src, String* dest);
 
   size_t capacity() const;
   char* address() const;
+  // reports the memory mapped for the file under the category, until the
+  // file is closed.
+  void TrackMemoryUsage(const string& category);
+  // reads a byte of every page in the range, so that the pages are resident
+  // before the first lookup needs them.
+  static void TouchPages(const void* start, size_t size);
 
  public:
   // noncpyable
   MappedFile(const MappedFile&) = delete;
   MappedFile& operator=(const MappedFile&) = delete;
 
+  // hints on how to map and access a file opened read-only.
+  enum LoadFlags {
+    kLoadDefault = 0,
+    // read the whole file into memory before first access.
+    kLoadPrefetch = 1 << 0,
+    // turn off read-ahead for scattered reads.
+    kLoadRandomAccess = 1 << 1,
+    // back the mapping with transparent huge pages where supported.
+    kLoadHugePages = 1 << 2,
+  };
+  // reads load flags from a list of names, or a single name, at the path:
+  // "prefetch", "random_access", "huge_pages".
+  static int GetLoadFlags(Config* config, const string& path);
+
   bool Exists() const;
   bool IsOpen() const;
   void Close();
@@ -119,11 +144,24 @@ class RIME_API MappedFile {
 
   const path& file_path() const { return file_path_; }
   size_t file_size() const { return size_; }
+  // the largest file in which any two addresses are within reach of an
+  // OffsetPtr with the default 32-bit offset.
+  static constexpr size_t kMaxFileSize =
+      static_cast<size_t>(std::numeric_limits<int32_t>::max());
+  int load_flags() const { return load_flags_; }
+  // takes effect the next time the file is opened read-only.
+  void set_load_flags(int flags) { load_flags_ = flags; }
+  // bytes of the mapped file resident in memory, as far as the system tells.
+  size_t resident_size() const;
 
  private:
+  void ReportFileTooLarge(size_t required_size) const;
+
   path file_path_;
   size_t size_ = 0;
+  int load_flags_ = kLoadDefault;
   the<MappedFileImpl> file_;
+  the<MemoryStatsRegistration> memory_stats_;
 };
 
 // member function definitions
@@ -137,10 +175,16 @@ T* MappedFile::Allocate(size_t count) {
 
   size_t used_space = RIME_ALIGNED(size_, T);
   size_t required_space = sizeof(T) * count;
+  if (used_space + required_space > kMaxFileSize) {
+    // offsets to the data would wrap around; fail rather than corrupt it.
+    ReportFileTooLarge(used_space + required_space);
+    return NULL;
+  }
   size_t file_size = capacity();
   if (used_space + required_space > file_size) {
     // not enough space; grow the file
-    size_t new_size = (std::max)(used_space + required_space, file_size * 2);
+    size_t new_size = (std::max)(used_space + required_space,
+                                 (std::min)(file_size * 2, kMaxFileSize));
     if (!Resize(new_size) || !OpenReadWrite())
       return NULL;
   }
@@ -0,0 +1,192 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <algorithm>
+#include <iterator>
+#include <rime/language.h>
+#include <rime/schema.h>
+#include <rime/ticket.h>
+#include <rime/algo/dynamics.h>
+#include <rime/dict/next_word_index.h>
+
+namespace rime {
+
+// separates the words of a context of two words.
+static const char kContextSeparator = '\x1f';
+
+static bool is_valid_word(const string& word) {
+  return !word.empty() && word.find('\t') == string::npos &&
+         word.find(kContextSeparator) == string::npos;
+}
+
+NextWordIndex::NextWordIndex(const string& name, an<Db> db)
+    : name_(name), db_(db) {}
+
+NextWordIndex::~NextWordIndex() {}
+
+bool NextWordIndex::loaded() const {
+  return db_ && db_->loaded();
+}
+
+bool NextWordIndex::readonly() const {
+  return db_ && db_->readonly();
+}
+
+bool NextWordIndex::Load() {
+  if (!db_)
+    return false;
+  // the db is shared with indexes being loaded on other threads.
+  static std::mutex load_mutex;
+  std::lock_guard<std::mutex> lock(load_mutex);
+  if (!db_->loaded() && !db_->Open())
+    return false;
+  string value;
+  try {
+    if (db_->MetaFetch("/tick", &value))
+      tick_ = std::stoul(value);
+  } catch (...) {
+    tick_ = 0;
+  }
+  return true;
+}
+
+bool NextWordIndex::Learn(const vector<string>& context,
+                          const vector<string>& words) {
+  if (!loaded() || readonly() || words.empty())
+    return false;
+  ++tick_;
+  string last_word = context.empty() ? string() : context.back();
+  string word_before = context.size() < 2 ? string() : context.end()[-2];
+  bool success = true;
+  for (const string& word : words) {
+    if (!is_valid_word(word)) {
+      // the chain of words is broken.
+      last_word.clear();
+      word_before.clear();
+      continue;
+    }
+    if (is_valid_word(last_word)) {
+      success = LearnWord(last_word, word) && success;
+      if (is_valid_word(word_before)) {
+        success = LearnWord(word_before + kContextSeparator + last_word,
+                            word) &&
+                  success;
+      }
+    }
+    word_before = last_word;
+    last_word = word;
+  }
+  return db_->MetaUpdate("/tick", std::to_string(tick_)) && success;
+}
+
+bool NextWordIndex::LearnWord(const string& context, const string& word) {
+  string key = context + '\t' + word;
+  string value;
+  UserDbValue v;
+  if (db_->Fetch(key, &value))
+    v.Unpack(value);
+  if (v.tick > tick_)
+    v.tick = tick_;  // fix abnormal timestamp
+  v.commits = (std::max)(v.commits, 0) + 1;
+  v.dee = algo::formula_d(1, (double)tick_, v.dee, (double)v.tick);
+  v.tick = tick_;
+  return db_->Update(key, v.PackFor(db_.get()));
+}
+
+vector<NextWordIndex::Prediction> NextWordIndex::Predict(
+    const vector<string>& context,
+    size_t limit) {
+  vector<Prediction> predictions;
+  if (!loaded() || context.empty() || limit == 0)
+    return predictions;
+  const string& last_word = context.back();
+  if (!is_valid_word(last_word))
+    return predictions;
+  if (context.size() >= 2 && is_valid_word(context.end()[-2])) {
+    PredictAfter(context.end()[-2] + kContextSeparator + last_word, limit,
+                 &predictions);
+  }
+  if (predictions.size() < limit) {
+    PredictAfter(last_word, limit, &predictions);
+  }
+  return predictions;
+}
+
+void NextWordIndex::PredictAfter(const string& context,
+                                 size_t limit,
+                                 vector<Prediction>* predictions) {
+  const string prefix = context + '\t';
+  auto accessor = db_->Query(prefix);
+  if (!accessor)
+    return;
+  vector<Prediction> found;
+  string key, value;
+  for (size_t scanned = 0; scanned < kMaxScannedRecords &&
+                           accessor->GetNextRecord(&key, &value);
+       ++scanned) {
+    UserDbValue v;
+    if (!v.Unpack(value) || v.commits <= 0)
+      continue;
+    string word = key.substr(prefix.length());
+    auto predicted = std::find_if(
+        predictions->begin(), predictions->end(),
+        [&word](const Prediction& p) { return p.text == word; });
+    if (predicted != predictions->end())
+      continue;
+    double weight = v.tick < tick_ ? algo::formula_d(0, (double)tick_, v.dee,
+                                                     (double)v.tick)
+                                   : v.dee;
+    found.push_back({std::move(word), weight});
+  }
+  size_t count = (std::min)(found.size(), limit - predictions->size());
+  std::partial_sort(found.begin(), found.begin() + count, found.end(),
+                    [](const Prediction& a, const Prediction& b) {
+                      return a.weight > b.weight;
+                    });
+  std::move(found.begin(), found.begin() + count,
+            std::back_inserter(*predictions));
+}
+
+// NextWordIndexComponent members
+
+NextWordIndexComponent::NextWordIndexComponent() {}
+
+NextWordIndex* NextWordIndexComponent::Create(const Ticket& ticket) {
+  if (!ticket.schema)
+    return nullptr;
+  Config* config = ticket.schema->config();
+  string dict_name;
+  if (config->GetString(ticket.name_space + "/user_dict", &dict_name) ||
+      config->GetString("translator/user_dict", &dict_name)) {
+    // user specified name
+  } else if (config->GetString(ticket.name_space + "/dictionary",
+                               &dict_name) ||
+             config->GetString("translator/dictionary", &dict_name)) {
+    dict_name = Language::get_language_component(dict_name);
+  } else {
+    LOG(ERROR) << ticket.name_space << "/dictionary not specified in schema '"
+               << ticket.schema->schema_id() << "'.";
+    return nullptr;
+  }
+  string db_class("userdb");
+  if (!config->GetString(ticket.name_space + "/db_class", &db_class)) {
+    config->GetString("translator/db_class", &db_class);
+  }
+  // kept next to the user dictionary.
+  const string db_name = dict_name + ".next";
+  std::lock_guard<std::mutex> lock(db_pool_mutex_);
+  auto db = db_pool_[db_name].lock();
+  if (!db) {
+    auto component = Db::Require(db_class);
+    if (!component) {
+      LOG(ERROR) << "undefined db class '" << db_class << "'.";
+      return nullptr;
+    }
+    db.reset(component->Create(db_name));
+    db_pool_[db_name] = db;
+  }
+  return new NextWordIndex(db_name, db);
+}
+
+}  // namespace rime
@@ -0,0 +1,75 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#ifndef RIME_NEXT_WORD_INDEX_H_
+#define RIME_NEXT_WORD_INDEX_H_
+
+#include <mutex>
+#include <rime/common.h>
+#include <rime/component.h>
+#include <rime/dict/user_db.h>
+
+namespace rime {
+
+struct Ticket;
+
+// The words committed after one or two others, learned from commits and kept
+// in a user db next to the user dictionary, so that the next words can be
+// told right after a commit, without any input.
+//
+// key ::= context <Tab> word
+// context ::= word | word <US> word
+class NextWordIndex : public Class<NextWordIndex, const Ticket&> {
+ public:
+  struct Prediction {
+    string text;
+    double weight = 0.0;
+  };
+
+  // records scanned for a context in a prediction.
+  static const size_t kMaxScannedRecords = 512;
+
+  NextWordIndex(const string& name, an<Db> db);
+  virtual ~NextWordIndex();
+
+  bool Load();
+  bool loaded() const;
+  bool readonly() const;
+
+  // learns that the words were committed in order after the context, the
+  // words committed before them, the latest last.
+  bool Learn(const vector<string>& context, const vector<string>& words);
+  // the words most likely to follow the context, best first. the words
+  // found after the last two words of the context come before the words
+  // found after the last word only.
+  vector<Prediction> Predict(const vector<string>& context, size_t limit);
+
+  const string& name() const { return name_; }
+
+ protected:
+  bool LearnWord(const string& context, const string& word);
+  void PredictAfter(const string& context,
+                    size_t limit,
+                    vector<Prediction>* predictions);
+
+ private:
+  string name_;
+  an<Db> db_;
+  TickCount tick_ = 0;
+};
+
+class NextWordIndexComponent : public NextWordIndex::Component {
+ public:
+  NextWordIndexComponent();
+  NextWordIndex* Create(const Ticket& ticket) override;
+
+ private:
+  // sessions on different threads share the dbs
+  std::mutex db_pool_mutex_;
+  hash_map<string, weak<Db>> db_pool_;
+};
+
+}  // namespace rime
+
+#endif  // RIME_NEXT_WORD_INDEX_H_
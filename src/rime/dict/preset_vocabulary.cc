@@ -4,9 +4,14 @@
 //
 // 2011-11-27 GONG Chen <chen.sst@gmail.com>
 //
-#include <utf8.h>
+#include <algorithm>
+#include <cstring>
+#include <mutex>
 #include <rime/resource.h>
 #include <rime/service.h>
+#include <rime/algo/strings.h>
+#include <rime/algo/utilities.h>
+#include <rime/dict/mapped_file.h>
 #include <rime/dict/preset_vocabulary.h>
 #include <rime/dict/text_db.h>
 
@@ -14,6 +19,28 @@ namespace rime {
 
 static const ResourceType kVocabularyResourceType = {"vocabulary", "", ".txt"};
 
+static const ResourceType kVocabularyImageResourceType = {
+    "vocabulary_image", "", ".vocabulary.bin"};
+
+namespace vocabulary {
+
+struct Entry {
+  String phrase;
+  String weight;
+};
+
+struct Metadata {
+  static const int kFormatMaxLength = 32;
+  char format[kFormatMaxLength];
+  uint32_t source_checksum;
+  // sorted by phrase
+  OffsetPtr<Array<Entry>> entries;
+};
+
+}  // namespace vocabulary
+
+static const char kVocabularyImageFormat[] = "Rime::Vocabulary/1.0";
+
 struct VocabularyDb : public TextDb {
   VocabularyDb(const path& file_path, const string& db_name);
   an<DbAccessor> cursor;
@@ -26,7 +53,7 @@ VocabularyDb::VocabularyDb(const path& file_path, const string& db_name)
              kVocabularyResourceType.name,
              VocabularyDb::format) {}
 
-static bool rime_vocabulary_entry_parser(const Tsv& row,
+static bool rime_vocabulary_entry_parser(const TsvFields& row,
                                          string* key,
                                          string* value) {
   if (row.size() < 1 || row[0].empty()) {
@@ -52,6 +79,132 @@ const TextFormat VocabularyDb::format = {
     "Rime vocabulary",
 };
 
+class VocabularyImage : public MappedFile {
+ public:
+  explicit VocabularyImage(const path& file_path) : MappedFile(file_path) {}
+
+  // succeeds if the image is compiled from the source of the checksum.
+  bool Load(uint32_t source_checksum);
+  bool Build(VocabularyDb* db, uint32_t source_checksum);
+
+  const vocabulary::Entry* Lookup(const string& phrase) const;
+  uint32_t source_checksum() const { return source_checksum_; }
+  size_t size() const { return entries_ ? entries_->size : 0; }
+  const vocabulary::Entry& at(size_t i) const { return entries_->at[i]; }
+
+ private:
+  uint32_t source_checksum_ = 0;
+  Array<vocabulary::Entry>* entries_ = nullptr;
+};
+
+bool VocabularyImage::Load(uint32_t source_checksum) {
+  if (IsOpen())
+    Close();
+  entries_ = nullptr;
+  if (!Exists() || !OpenReadOnly())
+    return false;
+  auto metadata = Find<vocabulary::Metadata>(0);
+  if (!metadata ||
+      strncmp(metadata->format, kVocabularyImageFormat,
+              vocabulary::Metadata::kFormatMaxLength) ||
+      metadata->source_checksum != source_checksum || !metadata->entries) {
+    Close();
+    return false;
+  }
+  entries_ = metadata->entries.get();
+  source_checksum_ = source_checksum;
+  return true;
+}
+
+bool VocabularyImage::Build(VocabularyDb* db, uint32_t source_checksum) {
+  LOG(INFO) << "compiling vocabulary image: " << file_path();
+  auto cursor = db->QueryAll();
+  if (!cursor)
+    return false;
+  vector<pair<string, string>> records;
+  size_t string_size = 0;
+  string key, value;
+  while (cursor->GetNextRecord(&key, &value)) {
+    string_size += key.length() + value.length() + 2;
+    records.emplace_back(key, value);
+  }
+  const size_t kReservedSize = 1024;
+  Remove();
+  if (!Create(sizeof(vocabulary::Metadata) + kReservedSize +
+              sizeof(Array<vocabulary::Entry>) +
+              records.size() * sizeof(vocabulary::Entry) + string_size)) {
+    LOG(ERROR) << "error creating vocabulary image: " << file_path();
+    return false;
+  }
+  auto metadata = Allocate<vocabulary::Metadata>();
+  auto entries = metadata ? CreateArray<vocabulary::Entry>(records.size())
+                          : nullptr;
+  if (!entries) {
+    LOG(ERROR) << "error creating vocabulary entries.";
+    return false;
+  }
+  for (size_t i = 0; i < records.size(); ++i) {
+    if (!CopyString(records[i].first, &entries->at[i].phrase) ||
+        !CopyString(records[i].second, &entries->at[i].weight)) {
+      LOG(ERROR) << "error creating vocabulary entry: " << records[i].first;
+      return false;
+    }
+  }
+  metadata->entries = entries;
+  metadata->source_checksum = source_checksum;
+  std::strncpy(metadata->format, kVocabularyImageFormat,
+               vocabulary::Metadata::kFormatMaxLength);
+  entries_ = entries;
+  if (!ShrinkToFit())
+    return false;
+  // reopened read-only, to be shared.
+  return Load(source_checksum);
+}
+
+const vocabulary::Entry* VocabularyImage::Lookup(const string& phrase) const {
+  if (!entries_)
+    return nullptr;
+  auto found = std::lower_bound(
+      entries_->begin(), entries_->end(), phrase,
+      [](const vocabulary::Entry& entry, const string& phrase) {
+        return std::strcmp(entry.phrase.c_str(), phrase.c_str()) < 0;
+      });
+  if (found == entries_->end() || phrase != found->phrase.c_str())
+    return nullptr;
+  return found;
+}
+
+// images in use by the dictionaries being compiled.
+static std::mutex vocabulary_images_mutex;
+static map<path, weak<VocabularyImage>> vocabulary_images;
+
+static an<VocabularyImage> LoadVocabularyImage(const string& vocabulary,
+                                               const path& source_path,
+                                               VocabularyDb* db) {
+  the<ResourceResolver> resolver(
+      Service::instance().CreateStagingResourceResolver(
+          kVocabularyImageResourceType));
+  path image_path = resolver->ResolvePath(vocabulary);
+  uint32_t source_checksum = Checksum(source_path);
+  std::lock_guard<std::mutex> lock(vocabulary_images_mutex);
+  auto& cached = vocabulary_images[image_path];
+  // shared as is; the mapping is not to be changed while in use.
+  if (auto image = cached.lock()) {
+    if (image->source_checksum() == source_checksum)
+      return image;
+  }
+  auto image = New<VocabularyImage>(image_path);
+  if (!image->Load(source_checksum)) {
+    if (!db->OpenReadOnly() || !image->Build(db, source_checksum)) {
+      LOG(ERROR) << "error compiling vocabulary image: " << image_path;
+      image->Remove();
+      return nullptr;
+    }
+  }
+  cached = image;
+  return image;
+}
+
 path PresetVocabulary::DictFilePath(const string& vocabulary) {
   the<ResourceResolver> resource_resolver(
       Service::instance().CreateResourceResolver(kVocabularyResourceType));
@@ -59,8 +212,13 @@ path PresetVocabulary::DictFilePath(const string& vocabulary) {
 }
 
 PresetVocabulary::PresetVocabulary(const string& vocabulary) {
-  db_.reset(new VocabularyDb(DictFilePath(vocabulary), vocabulary));
-  if (db_ && db_->OpenReadOnly()) {
+  path source_path = DictFilePath(vocabulary);
+  db_.reset(new VocabularyDb(source_path, vocabulary));
+  image_ = LoadVocabularyImage(vocabulary, source_path, db_.get());
+  if (image_) {
+    db_->Close();
+    db_.reset();
+  } else if (db_->loaded() || db_->OpenReadOnly()) {
     db_->cursor = db_->QueryAll();
   }
 }
@@ -72,8 +230,14 @@ PresetVocabulary::~PresetVocabulary() {
 
 bool PresetVocabulary::GetWeightForEntry(const string& key, double* weight) {
   string weight_str;
-  if (!db_ || !db_->Fetch(key, &weight_str))
+  if (image_) {
+    auto entry = image_->Lookup(key);
+    if (!entry)
+      return false;
+    weight_str = entry->weight.c_str();
+  } else if (!db_ || !db_->Fetch(key, &weight_str)) {
     return false;
+  }
   try {
     *weight = std::stod(weight_str);
   } catch (...) {
@@ -83,11 +247,22 @@ bool PresetVocabulary::GetWeightForEntry(const string& key, double* weight) {
 }
 
 void PresetVocabulary::Reset() {
+  cursor_ = 0;
   if (db_ && db_->cursor)
     db_->cursor->Reset();
 }
 
 bool PresetVocabulary::GetNextEntry(string* key, string* value) {
+  if (image_) {
+    while (cursor_ < image_->size()) {
+      const auto& entry = image_->at(cursor_++);
+      *key = entry.phrase.c_str();
+      *value = entry.weight.c_str();
+      if (IsQualifiedPhrase(*key, *value))
+        return true;
+    }
+    return false;
+  }
   if (!db_ || !db_->cursor)
     return false;
   bool got = false;
@@ -100,8 +275,7 @@ bool PresetVocabulary::GetNextEntry(string* key, string* value) {
 bool PresetVocabulary::IsQualifiedPhrase(const string& phrase,
                                          const string& weight_str) {
   if (max_phrase_length_ > 0) {
-    size_t length = utf8::unchecked::distance(phrase.c_str(),
-                                              phrase.c_str() + phrase.length());
+    size_t length = strings::utf8_length(phrase);
     if (static_cast<int>(length) > max_phrase_length_)
       return false;
   }
@@ -12,7 +12,11 @@
 namespace rime {
 
 struct VocabularyDb;
+class VocabularyImage;
 
+// The vocabulary is compiled into a mapped image in the staging directory,
+// where it is shared by all dictionaries compiled with it until the text
+// is modified.
 class PresetVocabulary {
  public:
   explicit PresetVocabulary(const string& vocabulary);
@@ -31,6 +35,9 @@ class PresetVocabulary {
   static path DictFilePath(const string& vacabulary);
 
  protected:
+  an<VocabularyImage> image_;
+  size_t cursor_ = 0;
+  // read from the text when the image cannot be built.
   the<VocabularyDb> db_;
   int max_phrase_length_ = 0;
   double min_phrase_weight_ = 0.0;
@@ -5,10 +5,13 @@
 // 2011-05-16 Zou Xu <zouivex@gmail.com>
 // 2012-01-26 GONG Chen <chen.sst@gmail.com>  spelling algebra support
 //
+#include <algorithm>
 #include <cfloat>
 #include <cstring>
+#include <limits>
 #include <queue>
 #include <rime/algo/algebra.h>
+#include <rime/algo/utilities.h>
 #include <rime/dict/prism.h>
 
 namespace rime {
@@ -20,18 +23,172 @@ struct node_t {
   size_t node_pos;
 };
 
+// a node to expand, or a spelling found, in the best-first search.
+struct weighted_node_t {
+  prism::Weight weight;
+  string key;
+  size_t node_pos;
+  int value;  // spelling id, or -1 for a node to expand
+
+  // orders the heaviest on top; of equal weight, spellings go before nodes
+  // and then keys in alphabetical order.
+  bool operator<(const weighted_node_t& other) const {
+    if (weight != other.weight)
+      return weight < other.weight;
+    if ((value < 0) != (other.value < 0))
+      return value < 0;
+    return key > other.key;
+  }
+};
+
 }  // namespace
 
-const char kPrismFormat[] = "Rime::Prism/3.0";
+const char kPrismFormat[] = "Rime::Prism/3.5";
+const double kPrismFormatWeights = 3.1;
+const double kPrismFormatCompletions = 3.2;
+const double kPrismFormatSourceChecksums = 3.3;
+const double kPrismFormatCompactSpellings = 3.4;
+const double kPrismFormatLoudsTrie = 3.5;
+
+const prism::Weight kNoWeight = std::numeric_limits<prism::Weight>::lowest();
 
 const char kPrismFormatPrefix[] = "Rime::Prism/";
 const size_t kPrismFormatPrefixLen = sizeof(kPrismFormatPrefix) - 1;
 
 const char kDefaultAlphabet[] = "abcdefghijklmnopqrstuvwxyz";
 
+// the state of an expand search, which finds keys starting with the given
+// key breadth-first, or by weight if the weights are given.
+struct Prism::SearchState {
+  const SpellingTrie* trie;
+  const char* alphabet;
+  const prism::Weight* spelling_weights;
+  const prism::Weight* subtree_weights;
+  // the key itself, if it is a spelling
+  int exact_match = -1;
+  size_t exact_match_length = 0;
+  // breadth-first search, resumed from the next child of the current node
+  std::queue<node_t> queue;
+  node_t current;
+  const char* next_char = nullptr;
+  // best-first search
+  std::priority_queue<weighted_node_t> heap;
+
+  SearchState(const SpellingTrie* trie,
+              const char* alphabet,
+              const prism::Weight* spelling_weights = nullptr,
+              const prism::Weight* subtree_weights = nullptr)
+      : trie(trie),
+        alphabet(alphabet),
+        spelling_weights(spelling_weights),
+        subtree_weights(subtree_weights) {}
+
+  bool weighted() const { return spelling_weights && subtree_weights; }
+  // the traversal of the key continues from the node of its first key_pos
+  // characters, if given; returns false if the key is not a valid path.
+  bool Start(const string& key, size_t* node_pos = nullptr,
+             size_t key_pos = 0);
+  size_t Resume(vector<Prism::Match>* result, size_t limit);
+};
+
+bool Prism::SearchState::Start(const string& key,
+                               size_t* key_node,
+                               size_t key_pos) {
+  size_t node_pos = key_node ? *key_node : 0;
+  int ret = trie->Traverse(key.c_str(), &node_pos, &key_pos);
+  // key is not a valid path
+  if (ret == -2)
+    return false;
+  if (key_node)
+    *key_node = node_pos;
+  if (ret != -1) {
+    exact_match = ret;
+    exact_match_length = key_pos;
+  }
+  if (weighted()) {
+    heap.push({subtree_weights[node_pos], key, node_pos, -1});
+  } else {
+    queue.push({key, node_pos});
+  }
+  return true;
+}
+
+size_t Prism::SearchState::Resume(vector<Prism::Match>* result,
+                                  size_t limit) {
+  size_t count = 0;
+  auto full = [&count, limit] { return limit && count >= limit; };
+  if (exact_match >= 0) {
+    result->push_back(Prism::Match{exact_match, exact_match_length});
+    ++count;
+    exact_match = -1;
+  }
+  if (weighted()) {
+    while (!heap.empty() && !full()) {
+      weighted_node_t node = heap.top();
+      heap.pop();
+      if (node.value >= 0) {
+        // no spelling left in the queue weighs more than this one
+        result->push_back(Prism::Match{node.value, node.key.length()});
+        ++count;
+        continue;
+      }
+      for (const char* c = alphabet; *c; ++c) {
+        string k = node.key + *c;
+        size_t k_pos = node.key.length();
+        size_t n_pos = node.node_pos;
+        int ret = trie->Traverse(k.c_str(), &n_pos, &k_pos);
+        if (ret <= -2)
+          continue;
+        if (ret >= 0) {
+          heap.push({spelling_weights[ret], k, n_pos, ret});
+        }
+        heap.push({subtree_weights[n_pos], k, n_pos, -1});
+      }
+    }
+    return count;
+  }
+  while (!full()) {
+    if (!next_char || !*next_char) {
+      if (queue.empty())
+        break;
+      current = std::move(queue.front());
+      queue.pop();
+      next_char = alphabet;
+    }
+    for (; *next_char && !full(); ++next_char) {
+      string k = current.key + *next_char;
+      size_t k_pos = current.key.length();
+      size_t n_pos = current.node_pos;
+      int ret = trie->Traverse(k.c_str(), &n_pos, &k_pos);
+      if (ret <= -2) {
+        // ignore
+      } else if (ret == -1) {
+        queue.push({k, n_pos});
+      } else {
+        queue.push({k, n_pos});
+        result->push_back(Prism::Match{ret, k_pos});
+        ++count;
+      }
+    }
+  }
+  return count;
+}
+
+// finds keys starting with the given key, breadth-first.
+static void expand_search(const SpellingTrie& trie,
+                          const char* alphabet,
+                          const string& key,
+                          vector<Prism::Match>* result,
+                          size_t limit) {
+  result->clear();
+  Prism::SearchState search(&trie, alphabet);
+  search.Start(key);
+  search.Resume(result, limit);
+}
+
 SpellingAccessor::SpellingAccessor(prism::SpellingMap* spelling_map,
                                    SyllableId spelling_id)
-    : spelling_id_(spelling_id), iter_(NULL), end_(NULL) {
+    : spelling_id_(spelling_id) {
   if (spelling_map &&
       spelling_id < static_cast<SyllableId>(spelling_map->size)) {
     iter_ = spelling_map->at[spelling_id].begin();
@@ -39,11 +196,38 @@ SpellingAccessor::SpellingAccessor(prism::SpellingMap* spelling_map,
   }
 }
 
+SpellingAccessor::SpellingAccessor(
+    const prism::CompactSpellingMap* spelling_map,
+    const prism::SpellingTables* tables,
+    SyllableId spelling_id)
+    : spelling_id_(spelling_id), tables_(tables) {
+  if (spelling_map &&
+      spelling_id < static_cast<SyllableId>(spelling_map->size)) {
+    compact_iter_ = spelling_map->at[spelling_id].begin();
+    compact_end_ = spelling_map->at[spelling_id].end();
+  }
+}
+
+SpellingAccessor::SpellingAccessor(
+    const prism::CompactCompletionList* completions,
+    const prism::SpellingTables* tables)
+    : spelling_id_(completions && completions->size ? 0 : -1),
+      tables_(tables) {
+  if (completions) {
+    compact_iter_ = completions->begin();
+    compact_end_ = completions->end();
+  }
+}
+
 bool SpellingAccessor::Next() {
   if (exhausted())
     return false;
-  if (!iter_ || ++iter_ >= end_)
+  if (compact_iter_) {
+    if (++compact_iter_ >= compact_end_)
+      spelling_id_ = -1;
+  } else if (!iter_ || ++iter_ >= end_) {
     spelling_id_ = -1;
+  }
   return exhausted();
 }
 
@@ -52,6 +236,8 @@ bool SpellingAccessor::exhausted() const {
 }
 
 SyllableId SpellingAccessor::syllable_id() const {
+  if (compact_iter_ && compact_iter_ < compact_end_)
+    return compact_iter_->syllable_id();
   if (iter_ && iter_ < end_)
     return iter_->syllable_id;
   else
@@ -60,7 +246,15 @@ SyllableId SpellingAccessor::syllable_id() const {
 
 SpellingProperties SpellingAccessor::properties() const {
   SpellingProperties props;
-  if (iter_ && iter_ < end_) {
+  if (compact_iter_ && compact_iter_ < compact_end_) {
+    props.type = static_cast<SpellingType>(compact_iter_->type());
+    props.credibility = tables_->credibilities.at[compact_iter_->credibility];
+    if (compact_iter_->tips) {
+      const String& tips = tables_->tips.at[compact_iter_->tips - 1];
+      if (!tips.empty())
+        props.tips = tips.c_str();
+    }
+  } else if (iter_ && iter_ < end_) {
     props.type = static_cast<SpellingType>(iter_->type);
     props.credibility = iter_->credibility;
     if (!iter_->tips.empty())
@@ -70,13 +264,14 @@ SpellingProperties SpellingAccessor::properties() const {
 }
 
 Prism::Prism(const path& file_path)
-    : MappedFile(file_path), trie_(new Darts::DoubleArray) {}
+    : MappedFile(file_path), trie_(new DoubleArrayTrie) {}
 
 bool Prism::Load() {
   LOG(INFO) << "loading prism file: " << file_path();
 
   if (IsOpen())
     Close();
+  max_spelling_length_ = 0;
 
   if (!OpenReadOnly()) {
     LOG(ERROR) << "error opening prism file '" << file_path() << "'.";
@@ -96,26 +291,77 @@ bool Prism::Load() {
   }
   format_ = atof(&metadata_->format[kPrismFormatPrefixLen]);
 
+  if (!AttachTrie()) {
+    Close();
+    return false;
+  }
+
+  FindSpellingMap();
+  spelling_weights_ = subtree_weights_ = NULL;
+  if (format_ >= kPrismFormatWeights - DBL_EPSILON) {
+    spelling_weights_ = metadata_->spelling_weights.get();
+    subtree_weights_ = metadata_->subtree_weights.get();
+  }
+  TrackMemoryUsage("prism");
+  return true;
+}
+
+bool Prism::AttachTrie() {
+  if (format_ >= kPrismFormatLoudsTrie - DBL_EPSILON &&
+      metadata_->louds_trie) {
+    size_t image_size = metadata_->louds_trie_size * sizeof(uint32_t);
+    LOG(INFO) << "found LOUDS trie image of size " << image_size << ".";
+    trie_backend_ = prism::kLoudsTrie;
+    trie_.reset(new LoudsTrie);
+    trie_->set_image(metadata_->louds_trie.get(), image_size);
+    return trie_->image() != nullptr;
+  }
   char* array = metadata_->double_array.get();
   if (!array) {
     LOG(ERROR) << "double array image not found.";
-    Close();
     return false;
   }
   size_t array_size = metadata_->double_array_size;
   LOG(INFO) << "found double array image of size " << array_size << ".";
-  trie_->set_array(array, array_size);
+  trie_backend_ = prism::kDoubleArrayTrie;
+  trie_.reset(new DoubleArrayTrie);
+  trie_->set_image(array, array_size * sizeof(uint32_t));
+  return true;
+}
 
+void Prism::FindSpellingMap() {
   spelling_map_ = NULL;
   if (format_ > 1.0 - DBL_EPSILON) {
     spelling_map_ = metadata_->spelling_map.get();
   }
-  return true;
+  completion_map_ = NULL;
+  bool has_completions = format_ >= kPrismFormatCompletions - DBL_EPSILON &&
+                         metadata_->completion_limit == kCompletionLimit;
+  if (has_completions) {
+    completion_map_ = metadata_->completion_map.get();
+  }
+  compact_spelling_map_ = NULL;
+  compact_completion_map_ = NULL;
+  spelling_tables_ = NULL;
+  if (format_ >= kPrismFormatCompactSpellings - DBL_EPSILON &&
+      metadata_->compact_spelling_map) {
+    compact_spelling_map_ = metadata_->compact_spelling_map.get();
+    spelling_tables_ = &metadata_->spelling_tables;
+    if (has_completions) {
+      compact_completion_map_ = metadata_->compact_completion_map.get();
+    }
+  }
+}
+
+void Prism::WarmUp() {
+  if (!metadata_)
+    return;
+  TouchPages(trie_->image(), trie_->image_size());
 }
 
 bool Prism::Save() {
   LOG(INFO) << "saving prism file: " << file_path();
-  if (!trie_->total_size()) {
+  if (!trie_->image_size()) {
     LOG(ERROR) << "the trie has not been constructed!";
     return false;
   }
@@ -124,36 +370,118 @@ bool Prism::Save() {
 bool Prism::Build(const Syllabary& syllabary,
                   const Script* script,
                   uint32_t dict_file_checksum,
-                  uint32_t schema_file_checksum) {
-  // building double-array trie
+                  uint32_t schema_file_checksum,
+                  const vector<prism::Weight>* syllable_weights) {
+  // building the trie of the backend
   size_t num_syllables = syllabary.size();
   size_t num_spellings = script ? script->size() : syllabary.size();
   vector<const char*> keys(num_spellings);
+  // given the lengths, the builder does not scan the keys for their ends
+  // again and again; this matters for large sets of keys.
+  vector<size_t> lengths(num_spellings);
   size_t key_id = 0;
   size_t map_size = 0;
   if (script) {
     for (auto it = script->begin(); it != script->end(); ++it, ++key_id) {
       keys[key_id] = it->first.c_str();
+      lengths[key_id] = it->first.length();
       map_size += it->second.size();
     }
   } else {
     for (auto it = syllabary.begin(); it != syllabary.end(); ++it, ++key_id) {
       keys[key_id] = it->c_str();
+      lengths[key_id] = it->length();
     }
   }
-  if (0 != trie_->build(num_spellings, &keys[0])) {
-    LOG(ERROR) << "Error building double-array trie.";
+  // keys of both the script and the syllabary are sorted, as required.
+  if (trie_backend_ == prism::kLoudsTrie)
+    trie_.reset(new LoudsTrie);
+  else
+    trie_.reset(new DoubleArrayTrie);
+  if (!trie_->Build(num_spellings, &keys[0], &lengths[0])) {
+    LOG(ERROR) << "Error building the trie of spellings.";
     return false;
   }
+  string alphabet;
+  {
+    set<char> chars;
+    for (size_t i = 0; i < num_spellings; ++i)
+      chars.insert(keys[i], keys[i] + lengths[i]);
+    alphabet.assign(chars.begin(), chars.end());
+  }
+  map<string, SyllableId> syllable_to_id;
+  if (script) {
+    SyllableId syll_id = 0;
+    for (auto it = syllabary.begin(); it != syllabary.end(); ++it) {
+      syllable_to_id[*it] = syll_id++;
+    }
+  }
+  // completions of short prefixes, as (spelling id, descriptor index)
+  map<size_t, vector<pair<size_t, size_t>>> completions;
+  size_t num_completions = 0;
+  if (script) {
+    vector<const vector<Spelling>*> spellings;
+    for (const auto& x : *script) {
+      spellings.push_back(&x.second);
+    }
+    vector<string> prefixes{string()};
+    for (size_t length = 1; length <= kMaxCompletionPrefixLength; ++length) {
+      vector<string> longer_prefixes;
+      for (const auto& prefix : prefixes) {
+        for (char c : alphabet) {
+          string k = prefix + c;
+          size_t node_pos = 0;
+          size_t key_pos = 0;
+          if (trie_->Traverse(k.c_str(), &node_pos, &key_pos) == -2)
+            continue;
+          longer_prefixes.push_back(k);
+          vector<Match> matches;
+          expand_search(*trie_, alphabet.c_str(), k, &matches,
+                        kCompletionLimit);
+          if (matches.size() < kMinPrecomputedCompletions)
+            continue;
+          // the first descriptor of each syllable wins, as in the syllabifier
+          map<SyllableId, pair<size_t, size_t>> found;
+          for (const auto& m : matches) {
+            const auto& descriptors = *spellings[m.value];
+            for (size_t j = 0; j < descriptors.size(); ++j) {
+              if (descriptors[j].properties.type >= kAbbreviation)
+                continue;
+              found.emplace(syllable_to_id[descriptors[j].str],
+                            pair<size_t, size_t>(m.value, j));
+            }
+          }
+          auto& list = completions[node_pos];
+          for (const auto& x : found) {
+            list.push_back(x.second);
+          }
+          num_completions += list.size();
+        }
+      }
+      prefixes.swap(longer_prefixes);
+    }
+  }
   // creating prism file
   size_t array_size = trie_->size();
-  size_t image_size = trie_->total_size();
+  size_t image_size = trie_->image_size();
   const size_t kDescriptorExtraSize = 12;
   size_t estimated_map_size =
       num_spellings * 12 +
       map_size * (4 + sizeof(prism::SpellingDescriptor) + kDescriptorExtraSize);
+  if (syllable_weights && syllable_weights->size() != num_syllables) {
+    LOG(WARNING) << "ignoring syllable weights of a different syllabary.";
+    syllable_weights = nullptr;
+  }
+  size_t weights_size =
+      syllable_weights ? (num_spellings + array_size) * sizeof(prism::Weight)
+                       : 0;
+  size_t completion_map_size =
+      sizeof(prism::CompletionMap) +
+      completions.size() * sizeof(prism::CompletionMapItem) +
+      num_completions * sizeof(prism::CompactSpellingDescriptor);
   const size_t kReservedSize = 1024;
-  if (!Create(image_size + estimated_map_size + kReservedSize)) {
+  if (!Create(image_size + estimated_map_size + weights_size +
+              completion_map_size + kReservedSize)) {
     LOG(ERROR) << "Error creating prism file '" << file_path() << "'.";
     return false;
   }
@@ -167,35 +495,38 @@ bool Prism::Build(const Syllabary& syllabary,
   metadata->schema_file_checksum = schema_file_checksum;
   metadata->num_syllables = num_syllables;
   metadata->num_spellings = num_spellings;
+  metadata->syllabary_checksum = syllabary_checksum_;
+  metadata->algebra_checksum = algebra_checksum_;
   metadata_ = metadata;
-  // alphabet
-  {
-    set<char> alphabet;
-    for (size_t i = 0; i < num_spellings; ++i)
-      for (const char* p = keys[i]; *p; ++p)
-        alphabet.insert(*p);
-    char* p = metadata->alphabet;
-    set<char>::const_iterator c = alphabet.begin();
-    for (; c != alphabet.end(); ++p, ++c)
-      *p = *c;
-    *p = '\0';
-  }
-  // saving double-array image
-  char* array = Allocate<char>(image_size);
-  if (!array) {
-    LOG(ERROR) << "Error creating double-array image.";
-    return false;
+  format_ = kPrismFormatCompactSpellings;
+  std::strncpy(metadata->alphabet, alphabet.c_str(),
+               sizeof(metadata->alphabet) - 1);
+  // saving the image of the trie
+  if (trie_backend_ == prism::kLoudsTrie) {
+    size_t num_words = image_size / sizeof(uint32_t);
+    uint32_t* image = Allocate<uint32_t>(num_words);
+    if (!image) {
+      LOG(ERROR) << "Error creating LOUDS trie image.";
+      return false;
+    }
+    std::memcpy(image, trie_->image(), image_size);
+    metadata->louds_trie = image;
+    metadata->louds_trie_size = num_words;
+  } else {
+    char* array = Allocate<char>(image_size);
+    if (!array) {
+      LOG(ERROR) << "Error creating double-array image.";
+      return false;
+    }
+    std::memcpy(array, trie_->image(), image_size);
+    metadata->double_array = array;
+    metadata->double_array_size = array_size;
   }
-  std::memcpy(array, trie_->array(), image_size);
-  metadata->double_array = array;
-  metadata->double_array_size = array_size;
   // building spelling map
-  if (script) {
-    map<string, SyllableId> syllable_to_id;
-    SyllableId syll_id = 0;
-    for (auto it = syllabary.begin(); it != syllabary.end(); ++it) {
-      syllable_to_id[*it] = syll_id++;
-    }
+  spelling_map_ = NULL;
+  compact_spelling_map_ = NULL;
+  if (script && !BuildCompactSpellingMap(*script, syllable_to_id)) {
+    LOG(INFO) << "spellings do not fit compact descriptors.";
     auto spelling_map = CreateArray<prism::SpellingMapItem>(num_spellings);
     if (!spelling_map) {
       LOG(ERROR) << "Error creating spelling map.";
@@ -227,19 +558,255 @@ bool Prism::Build(const Syllabary& syllabary,
     metadata->spelling_map = spelling_map;
     spelling_map_ = spelling_map;
   }
+  if (script && !spelling_map_ && !compact_spelling_map_) {
+    LOG(ERROR) << "Error creating spelling map.";
+    return false;
+  }
+  // weights of spellings
+  if (syllable_weights) {
+    auto spelling_weights = Allocate<prism::Weight>(num_spellings);
+    auto subtree_weights = Allocate<prism::Weight>(array_size);
+    if (!spelling_weights || !subtree_weights) {
+      LOG(ERROR) << "Error creating spelling weights.";
+      return false;
+    }
+    ComputeWeights(*syllable_weights, spelling_weights, subtree_weights);
+    metadata->spelling_weights = spelling_weights;
+    metadata->subtree_weights = subtree_weights;
+    spelling_weights_ = spelling_weights;
+    subtree_weights_ = subtree_weights;
+  }
+  // precomputed completions
+  if (!completions.empty() && compact_spelling_map_) {
+    auto completion_map =
+        CreateArray<prism::CompactCompletionMapItem>(completions.size());
+    if (!completion_map) {
+      LOG(ERROR) << "Error creating completion map.";
+      return false;
+    }
+    auto item = completion_map->begin();
+    for (const auto& x : completions) {
+      item->node_pos = static_cast<uint32_t>(x.first);
+      item->completions.size = x.second.size();
+      item->completions.at =
+          Allocate<prism::CompactSpellingDescriptor>(x.second.size());
+      if (!item->completions.at) {
+        LOG(ERROR) << "Error creating completion list.";
+        return false;
+      }
+      auto completion = item->completions.begin();
+      for (const auto& d : x.second) {
+        *completion++ = compact_spelling_map_->at[d.first].at[d.second];
+      }
+      ++item;
+    }
+    metadata->compact_completion_map = completion_map;
+    metadata->completion_limit = kCompletionLimit;
+    compact_completion_map_ = completion_map;
+  } else if (!completions.empty() && spelling_map_) {
+    auto completion_map =
+        CreateArray<prism::CompletionMapItem>(completions.size());
+    if (!completion_map) {
+      LOG(ERROR) << "Error creating completion map.";
+      return false;
+    }
+    auto item = completion_map->begin();
+    for (const auto& x : completions) {
+      item->node_pos = static_cast<uint32_t>(x.first);
+      item->completions.size = x.second.size();
+      item->completions.at =
+          Allocate<OffsetPtr<prism::SpellingDescriptor>>(x.second.size());
+      if (!item->completions.at) {
+        LOG(ERROR) << "Error creating completion list.";
+        return false;
+      }
+      auto completion = item->completions.begin();
+      for (const auto& d : x.second) {
+        *completion++ = &spelling_map_->at[d.first].at[d.second];
+      }
+      ++item;
+    }
+    metadata->completion_map = completion_map;
+    metadata->completion_limit = kCompletionLimit;
+    completion_map_ = completion_map;
+  }
   // at last, complete the metadata
   std::strncpy(metadata->format, kPrismFormat,
                prism::Metadata::kFormatMaxLength);
   return true;
 }
 
+// spelling descriptors of 8 bytes, referring to tables of the distinct
+// credibilities and tips. returns false, having allocated nothing, when the
+// syllables or the distinct values are too many to fit.
+bool Prism::BuildCompactSpellingMap(
+    const Script& script,
+    const map<string, SyllableId>& syllable_to_id) {
+  map<prism::Credibility, size_t> credibilities;
+  map<string, size_t> tips;
+  for (const auto& x : script) {
+    for (const Spelling& s : x.second) {
+      credibilities.emplace(
+          static_cast<prism::Credibility>(s.properties.credibility), 0);
+      if (!s.properties.tips.empty())
+        tips.emplace(s.properties.tips, 0);
+    }
+  }
+  using Descriptor = prism::CompactSpellingDescriptor;
+  if (syllable_to_id.size() > Descriptor::kMaxSyllableId ||
+      credibilities.size() > Descriptor::kMaxTableSize ||
+      tips.size() >= Descriptor::kMaxTableSize)
+    return false;
+  auto tables = &metadata_->spelling_tables;
+  tables->credibilities.size = credibilities.size();
+  tables->credibilities.at = Allocate<prism::Credibility>(credibilities.size());
+  tables->tips.size = tips.size();
+  tables->tips.at = Allocate<String>(tips.size());
+  if ((!credibilities.empty() && !tables->credibilities.at) ||
+      (!tips.empty() && !tables->tips.at)) {
+    LOG(ERROR) << "Error creating spelling tables.";
+    return false;
+  }
+  size_t index = 0;
+  for (auto& x : credibilities) {
+    tables->credibilities.at[index] = x.first;
+    x.second = index++;
+  }
+  index = 0;
+  for (auto& x : tips) {
+    if (!CopyString(x.first, &tables->tips.at[index])) {
+      LOG(ERROR) << "Error creating spelling tips.";
+      return false;
+    }
+    // 0 for no tips
+    x.second = ++index;
+  }
+  auto spelling_map =
+      CreateArray<prism::CompactSpellingMapItem>(script.size());
+  if (!spelling_map) {
+    LOG(ERROR) << "Error creating spelling map.";
+    return false;
+  }
+  auto item = spelling_map->begin();
+  for (const auto& x : script) {
+    item->size = x.second.size();
+    item->at = Allocate<Descriptor>(x.second.size());
+    if (!item->at) {
+      LOG(ERROR) << "Error creating spelling descriptors.";
+      return false;
+    }
+    auto desc = item->begin();
+    for (const Spelling& s : x.second) {
+      auto syllable = syllable_to_id.find(s.str);
+      SyllableId syllable_id =
+          syllable != syllable_to_id.end() ? syllable->second : 0;
+      desc->syllable_id_and_type =
+          static_cast<uint32_t>(syllable_id) |
+          (static_cast<uint32_t>(s.properties.type) << 24);
+      desc->credibility = static_cast<uint16_t>(credibilities[
+          static_cast<prism::Credibility>(s.properties.credibility)]);
+      desc->tips = s.properties.tips.empty()
+                       ? 0
+                       : static_cast<uint16_t>(tips[s.properties.tips]);
+      ++desc;
+    }
+    ++item;
+  }
+  metadata_->compact_spelling_map = spelling_map;
+  compact_spelling_map_ = spelling_map;
+  spelling_tables_ = tables;
+  return true;
+}
+
+// the heaviest spelling under each node of the trie, found depth-first.
+static prism::Weight weigh_subtree(const SpellingTrie& trie,
+                                   const char* alphabet,
+                                   const prism::Weight* spelling_weights,
+                                   prism::Weight* subtree_weights,
+                                   size_t node_pos) {
+  prism::Weight weight = kNoWeight;
+  size_t leaf_pos = node_pos;
+  size_t key_pos = 0;
+  int spelling_id = trie.Traverse("", &leaf_pos, &key_pos);
+  if (spelling_id >= 0) {
+    weight = spelling_weights[spelling_id];
+  }
+  for (const char* c = alphabet; *c; ++c) {
+    size_t child_pos = node_pos;
+    key_pos = 0;
+    if (trie.Traverse(c, &child_pos, &key_pos, 1) == -2)
+      continue;
+    weight = (std::max)(weight, weigh_subtree(trie, alphabet, spelling_weights,
+                                              subtree_weights, child_pos));
+  }
+  subtree_weights[node_pos] = weight;
+  return weight;
+}
+
+void Prism::ComputeWeights(const vector<prism::Weight>& syllable_weights,
+                           prism::Weight* spelling_weights,
+                           prism::Weight* subtree_weights) {
+  size_t num_spellings = metadata_->num_spellings;
+  std::fill_n(spelling_weights, num_spellings, kNoWeight);
+  std::fill_n(subtree_weights, trie_->size(), kNoWeight);
+  // without a spelling map, each spelling is the syllable of the same id.
+  for (size_t spelling_id = 0; spelling_id < num_spellings; ++spelling_id) {
+    for (SpellingAccessor accessor(QuerySpelling(spelling_id));
+         !accessor.exhausted(); accessor.Next()) {
+      SpellingProperties props = accessor.properties();
+      // only normal spellings are looked up for words
+      if (props.type > kNormalSpelling)
+        continue;
+      prism::Weight weight =
+          syllable_weights[accessor.syllable_id()] + props.credibility;
+      spelling_weights[spelling_id] =
+          (std::max)(spelling_weights[spelling_id], weight);
+    }
+  }
+  // every node on the path of a spelling weighs at least the spelling
+  weigh_subtree(*trie_, metadata_->alphabet, spelling_weights,
+                subtree_weights, 0);
+}
+
+bool Prism::UpdateWeights(const vector<prism::Weight>& syllable_weights,
+                          uint32_t dict_file_checksum,
+                          uint32_t schema_file_checksum) {
+  LOG(INFO) << "updating weights of prism file: " << file_path();
+  if (IsOpen())
+    Close();
+  if (!OpenReadWrite()) {
+    LOG(ERROR) << "error opening prism file '" << file_path() << "'.";
+    return false;
+  }
+  metadata_ = Find<prism::Metadata>(0);
+  if (!metadata_ ||
+      strncmp(metadata_->format, kPrismFormatPrefix, kPrismFormatPrefixLen) ||
+      (format_ = atof(&metadata_->format[kPrismFormatPrefixLen])) <
+          kPrismFormatWeights - DBL_EPSILON ||
+      !metadata_->spelling_weights || !metadata_->subtree_weights ||
+      syllable_weights.size() != metadata_->num_syllables || !AttachTrie()) {
+    LOG(WARNING) << "no weights to update in prism file '" << file_path()
+                 << "'.";
+    Close();
+    return false;
+  }
+  FindSpellingMap();
+  ComputeWeights(syllable_weights, metadata_->spelling_weights.get(),
+                 metadata_->subtree_weights.get());
+  metadata_->dict_file_checksum = dict_file_checksum;
+  metadata_->schema_file_checksum = schema_file_checksum;
+  bool flushed = Flush();
+  Close();
+  return flushed && Load();
+}
+
 bool Prism::HasKey(const string& key) {
-  int value = trie_->exactMatchSearch<int>(key.c_str());
+  int value = trie_->ExactMatch(key.c_str());
   return value != -1;
 }
 
 bool Prism::GetValue(const string& key, int* value) const {
-  int result = trie_->exactMatchSearch<int>(key.c_str());
+  int result = trie_->ExactMatch(key.c_str());
   if (result == -1) {
     return false;
   }
@@ -255,7 +822,7 @@ void Prism::CommonPrefixSearch(const string& key, vector<Match>* result) {
   size_t len = key.length();
   result->resize(len);
   size_t num_results =
-      trie_->commonPrefixSearch(key.c_str(), &result->front(), len, len);
+      trie_->CommonPrefixSearch(key.c_str(), &result->front(), len, len);
   result->resize(num_results);
 }
 
@@ -264,49 +831,122 @@ void Prism::ExpandSearch(const string& key,
                          size_t limit) {
   if (!result)
     return;
+  const char* alphabet =
+      (format_ > 1.0 - DBL_EPSILON) ? metadata_->alphabet : kDefaultAlphabet;
+  expand_search(*trie_, alphabet, key, result, limit);
+}
+
+bool Prism::ExpandSearchFrom(const string& key,
+                             size_t key_pos,
+                             size_t* node_pos,
+                             vector<Match>* result,
+                             size_t limit) {
+  if (!node_pos || !result)
+    return false;
   result->clear();
-  size_t count = 0;
-  size_t node_pos = 0;
-  size_t key_pos = 0;
-  int ret = trie_->traverse(key.c_str(), node_pos, key_pos);
-  // key is not a valid path
-  if (ret == -2)
+  const char* alphabet =
+      (format_ > 1.0 - DBL_EPSILON) ? metadata_->alphabet : kDefaultAlphabet;
+  Prism::SearchState search(trie_.get(), alphabet);
+  if (!search.Start(key, node_pos, key_pos))
+    return false;
+  search.Resume(result, limit);
+  return true;
+}
+
+void Prism::ExpandSearchByWeight(const string& key,
+                                 vector<Match>* result,
+                                 size_t limit) {
+  if (!has_weights() || !limit) {
+    ExpandSearch(key, result, limit);
     return;
-  if (ret != -1) {
-    result->push_back(Match{ret, key_pos});
-    if (limit && ++count >= limit)
-      return;
-  }
-  std::queue<node_t> q;
-  q.push({key, node_pos});
-  while (!q.empty()) {
-    node_t node = q.front();
-    q.pop();
-    const char* c =
-        (format_ > 1.0 - DBL_EPSILON) ? metadata_->alphabet : kDefaultAlphabet;
-    for (; *c; ++c) {
-      string k = node.key + *c;
-      size_t k_pos = node.key.length();
-      size_t n_pos = node.node_pos;
-      ret = trie_->traverse(k.c_str(), n_pos, k_pos);
-      if (ret <= -2) {
-        // ignore
-      } else if (ret == -1) {
-        q.push({k, n_pos});
-      } else {
-        q.push({k, n_pos});
-        result->push_back(Match{ret, k_pos});
-        if (limit && ++count >= limit)
-          return;
-      }
+  }
+  if (!result)
+    return;
+  result->clear();
+  SearchState search(trie_.get(), metadata_->alphabet, spelling_weights_,
+                     subtree_weights_);
+  search.Start(key);
+  search.Resume(result, limit);
+}
+
+an<Prism::SearchState> Prism::StartExpandSearch(const string& key) {
+  const char* alphabet =
+      (format_ > 1.0 - DBL_EPSILON) ? metadata_->alphabet : kDefaultAlphabet;
+  auto search = has_weights()
+                    ? New<SearchState>(trie_.get(), alphabet,
+                                       spelling_weights_, subtree_weights_)
+                    : New<SearchState>(trie_.get(), alphabet);
+  search->Start(key);
+  return search;
+}
+
+size_t Prism::ResumeExpandSearch(SearchState* search,
+                                 vector<Match>* result,
+                                 size_t limit) {
+  if (!search || !result)
+    return 0;
+  return search->Resume(result, limit);
+}
+
+size_t Prism::max_spelling_length() {
+  size_t length = max_spelling_length_;
+  if (length == 0 && metadata_) {
+    vector<Match> spellings;
+    ExpandSearch("", &spellings, 0);
+    for (const auto& m : spellings) {
+      length = (std::max)(length, m.length);
     }
+    // computing it twice on concurrent calls does no harm.
+    max_spelling_length_ = length;
   }
+  return length;
 }
 
 SpellingAccessor Prism::QuerySpelling(SyllableId spelling_id) {
+  if (compact_spelling_map_)
+    return SpellingAccessor(compact_spelling_map_, spelling_tables_,
+                            spelling_id);
   return SpellingAccessor(spelling_map_, spelling_id);
 }
 
+const prism::CompletionList* Prism::QueryCompletions(
+    const string& prefix) const {
+  if (!completion_map_ || prefix.empty() ||
+      prefix.length() > kMaxCompletionPrefixLength)
+    return nullptr;
+  size_t node_pos = 0;
+  size_t key_pos = 0;
+  if (trie_->Traverse(prefix.c_str(), &node_pos, &key_pos) == -2)
+    return nullptr;
+  auto item = std::lower_bound(
+      completion_map_->begin(), completion_map_->end(), node_pos,
+      [](const prism::CompletionMapItem& a, size_t b) {
+        return a.node_pos < b;
+      });
+  if (item == completion_map_->end() || item->node_pos != node_pos)
+    return nullptr;
+  return &item->completions;
+}
+
+const prism::CompactCompletionList* Prism::QueryCompactCompletions(
+    const string& prefix) const {
+  if (!compact_completion_map_ || prefix.empty() ||
+      prefix.length() > kMaxCompletionPrefixLength)
+    return nullptr;
+  size_t node_pos = 0;
+  size_t key_pos = 0;
+  if (trie_->Traverse(prefix.c_str(), &node_pos, &key_pos) == -2)
+    return nullptr;
+  auto item = std::lower_bound(
+      compact_completion_map_->begin(), compact_completion_map_->end(),
+      node_pos, [](const prism::CompactCompletionMapItem& a, size_t b) {
+        return a.node_pos < b;
+      });
+  if (item == compact_completion_map_->end() || item->node_pos != node_pos)
+    return nullptr;
+  return &item->completions;
+}
+
 size_t Prism::array_size() const {
   return trie_->size();
 }
@@ -319,4 +959,24 @@ uint32_t Prism::schema_file_checksum() const {
   return metadata_ ? metadata_->schema_file_checksum : 0;
 }
 
+uint32_t Prism::syllabary_checksum() const {
+  return metadata_ && format_ >= kPrismFormatSourceChecksums - DBL_EPSILON
+             ? metadata_->syllabary_checksum
+             : 0;
+}
+
+uint32_t Prism::algebra_checksum() const {
+  return metadata_ && format_ >= kPrismFormatSourceChecksums - DBL_EPSILON
+             ? metadata_->algebra_checksum
+             : 0;
+}
+
+bool Prism::spells_syllables() const {
+  // the checksum of an empty list of rules.
+  static const uint32_t kNoAlgebraChecksum = ChecksumComputer().Checksum();
+  return syllabary_checksum() != 0 &&
+         algebra_checksum() == kNoAlgebraChecksum &&
+         metadata_->num_spellings == metadata_->num_syllables;
+}
+
 }  // namespace rime
@@ -9,10 +9,11 @@
 #ifndef RIME_PRISM_H_
 #define RIME_PRISM_H_
 
-#include <darts.h>
+#include <atomic>
 #include <rime/common.h>
 #include <rime/algo/spelling.h>
 #include <rime/dict/mapped_file.h>
+#include <rime/dict/spelling_trie.h>
 #include <rime/dict/vocabulary.h>
 
 namespace rime {
@@ -21,6 +22,8 @@ namespace prism {
 
 using Credibility = float;
 
+using Weight = float;
+
 struct SpellingDescriptor {
   SyllableId syllable_id;
   int32_t type;
@@ -31,6 +34,60 @@ struct SpellingDescriptor {
 using SpellingMapItem = List<SpellingDescriptor>;
 using SpellingMap = Array<SpellingMapItem>;
 
+// v3.4: a spelling descriptor packed into 8 bytes. the credibility and the
+// tips are kept once for all descriptors, in the tables of the prism.
+struct CompactSpellingDescriptor {
+  static const SyllableId kMaxSyllableId = (1 << 24) - 1;
+  static const size_t kMaxTableSize = 1 << 16;
+
+  // the syllable id in the low 24 bits, the spelling type in the next 4.
+  uint32_t syllable_id_and_type;
+  // index of the credibility in the table.
+  uint16_t credibility;
+  // 1 + index of the tips in the table, or 0 for no tips.
+  uint16_t tips;
+
+  SyllableId syllable_id() const {
+    return static_cast<SyllableId>(syllable_id_and_type & 0xffffff);
+  }
+  int32_t type() const {
+    return static_cast<int32_t>((syllable_id_and_type >> 24) & 0xf);
+  }
+};
+
+using CompactSpellingMapItem = List<CompactSpellingDescriptor>;
+using CompactSpellingMap = Array<CompactSpellingMapItem>;
+
+// the distinct values referred to by compact descriptors.
+struct SpellingTables {
+  List<Credibility> credibilities;
+  List<String> tips;
+};
+
+// v3.2: the syllables a short prefix can be completed to, as found by
+// expanding the prefix within the completion limit; one descriptor per
+// syllable, sorted by syllable id.
+using CompletionList = List<OffsetPtr<SpellingDescriptor>>;
+
+struct CompletionMapItem {
+  uint32_t node_pos;  // of the prefix in the trie
+  CompletionList completions;
+};
+
+// sorted by node_pos
+using CompletionMap = Array<CompletionMapItem>;
+
+// v3.4: copies of the compact descriptors of the completions.
+using CompactCompletionList = List<CompactSpellingDescriptor>;
+
+struct CompactCompletionMapItem {
+  uint32_t node_pos;
+  CompactCompletionList completions;
+};
+
+// sorted by node_pos
+using CompactCompletionMap = Array<CompactCompletionMapItem>;
+
 struct Metadata {
   static const int kFormatMaxLength = 32;
   char format[kFormatMaxLength];
@@ -43,6 +100,32 @@ struct Metadata {
   // v1.0
   OffsetPtr<SpellingMap> spelling_map;
   char alphabet[256];
+  // v3.1: the heaviest word spelt by each spelling, and found under each
+  // node of the double array, for searching the heaviest spellings first.
+  OffsetPtr<Weight> spelling_weights;
+  OffsetPtr<Weight> subtree_weights;
+  // v3.2
+  OffsetPtr<CompletionMap> completion_map;
+  uint32_t completion_limit;
+  // v3.3: what the spellings are derived from; while they are unchanged,
+  // the prism is kept and only its weights are updated.
+  uint32_t syllabary_checksum;
+  uint32_t algebra_checksum;
+  // v3.4: the spelling map and completions in compact descriptors, in place
+  // of spelling_map and completion_map unless the values do not fit.
+  OffsetPtr<CompactSpellingMap> compact_spelling_map;
+  OffsetPtr<CompactCompletionMap> compact_completion_map;
+  SpellingTables spelling_tables;
+  // v3.5: a LOUDS trie of louds_trie_size words, in place of the double
+  // array which is then absent.
+  OffsetPtr<uint32_t> louds_trie;
+  uint32_t louds_trie_size;
+};
+
+// the trie of the spellings, chosen for a prism when it is built.
+enum TrieBackend {
+  kDoubleArrayTrie,  // fast; the default
+  kLoudsTrie,        // several times smaller, and slower to look up
 };
 
 }  // namespace prism
@@ -50,6 +133,12 @@ struct Metadata {
 class SpellingAccessor {
  public:
   SpellingAccessor(prism::SpellingMap* spelling_map, SyllableId spelling_id);
+  SpellingAccessor(const prism::CompactSpellingMap* spelling_map,
+                   const prism::SpellingTables* tables,
+                   SyllableId spelling_id);
+  // iterates over precomputed completions.
+  SpellingAccessor(const prism::CompactCompletionList* completions,
+                   const prism::SpellingTables* tables);
   bool Next();
   bool exhausted() const;
   SyllableId syllable_id() const;
@@ -57,24 +146,44 @@ class SpellingAccessor {
 
  protected:
   SyllableId spelling_id_;
-  prism::SpellingDescriptor* iter_;
-  prism::SpellingDescriptor* end_;
+  prism::SpellingDescriptor* iter_ = nullptr;
+  prism::SpellingDescriptor* end_ = nullptr;
+  const prism::CompactSpellingDescriptor* compact_iter_ = nullptr;
+  const prism::CompactSpellingDescriptor* compact_end_ = nullptr;
+  const prism::SpellingTables* tables_ = nullptr;
 };
 
 class Script;
 
 class Prism : public MappedFile {
  public:
-  using Match = Darts::DoubleArray::result_pair_type;
+  using Match = SpellingTrie::Match;
+
+  // the number of spellings found by expanding an incomplete syllable.
+  static const size_t kCompletionLimit = 512;
+  // completions are precomputed for prefixes up to this length, if they
+  // expand to at least kMinPrecomputedCompletions spellings.
+  static const size_t kMaxCompletionPrefixLength = 2;
+  static const size_t kMinPrecomputedCompletions = 16;
 
   RIME_API explicit Prism(const path& file_path);
 
   RIME_API bool Load();
   RIME_API bool Save();
+  // pages in the trie of the loaded prism ahead of the first lookup.
+  RIME_API void WarmUp();
+  // syllable_weights, if given, are the weights of the heaviest words of
+  // each syllable, in the order of the syllabary.
   RIME_API bool Build(const Syllabary& syllabary,
                       const Script* script = nullptr,
                       uint32_t dict_file_checksum = 0,
-                      uint32_t schema_file_checksum = 0);
+                      uint32_t schema_file_checksum = 0,
+                      const vector<prism::Weight>* syllable_weights = nullptr);
+  // recomputes the weights of a prism built with weights, for the words of
+  // the dictionary have changed but not its syllabary.
+  RIME_API bool UpdateWeights(const vector<prism::Weight>& syllable_weights,
+                              uint32_t dict_file_checksum,
+                              uint32_t schema_file_checksum);
 
   RIME_API bool HasKey(const string& key);
   RIME_API bool GetValue(const string& key, int* value) const;
@@ -82,19 +191,95 @@ class Prism : public MappedFile {
   RIME_API void ExpandSearch(const string& key,
                              vector<Match>* result,
                              size_t limit);
+  // like ExpandSearch(), but the key is traversed from node_pos, the node of
+  // its first key_pos characters in the trie (0 for the root), and node_pos
+  // is set to the node of the key for a search of a longer key to continue
+  // from. returns false if the key is not a path in the trie.
+  RIME_API bool ExpandSearchFrom(const string& key,
+                                 size_t key_pos,
+                                 size_t* node_pos,
+                                 vector<Match>* result,
+                                 size_t limit);
+  // like ExpandSearch(), but finds the spellings of heaviest words first;
+  // the key itself, if a spelling, still comes first.
+  // falls back to ExpandSearch() if the prism was built without weights.
+  RIME_API void ExpandSearchByWeight(const string& key,
+                                     vector<Match>* result,
+                                     size_t limit);
+  // the state of an expand search to be resumed for more spellings.
+  struct SearchState;
+  // starts an expand search, which finds spellings in the order of
+  // ExpandSearchByWeight() with a limit.
+  RIME_API an<SearchState> StartExpandSearch(const string& key);
+  // appends at most limit (0 for no limit) spellings found after those of
+  // the previous calls; returns the number of spellings appended.
+  RIME_API size_t ResumeExpandSearch(SearchState* search,
+                                     vector<Match>* result,
+                                     size_t limit);
   SpellingAccessor QuerySpelling(SyllableId spelling_id);
+  // precomputed completions of the prefix within kCompletionLimit, or null.
+  RIME_API const prism::CompletionList* QueryCompletions(
+      const string& prefix) const;
+  // the same in a prism of compact descriptors; to be iterated over with a
+  // SpellingAccessor made with spelling_tables().
+  RIME_API const prism::CompactCompletionList* QueryCompactCompletions(
+      const string& prefix) const;
+  const prism::SpellingTables* spelling_tables() const {
+    return spelling_tables_;
+  }
 
   RIME_API size_t array_size() const;
+  // the length of the longest spelling, found by a full search the first
+  // time it is asked for.
+  RIME_API size_t max_spelling_length();
+  bool has_weights() const { return spelling_weights_ && subtree_weights_; }
 
   uint32_t dict_file_checksum() const;
   uint32_t schema_file_checksum() const;
-  Darts::DoubleArray& trie() const { return *trie_; }
+  // 0 if not recorded in the prism.
+  uint32_t syllabary_checksum() const;
+  uint32_t algebra_checksum() const;
+  // whether the spellings are the syllables as they are, derived by no
+  // spelling algebra; false if unknown, as in prisms before v3.3.
+  RIME_API bool spells_syllables() const;
+  // to be recorded in the prism being built.
+  void set_source_checksums(uint32_t syllabary_checksum,
+                            uint32_t algebra_checksum) {
+    syllabary_checksum_ = syllabary_checksum;
+    algebra_checksum_ = algebra_checksum;
+  }
+  prism::TrieBackend trie_backend() const { return trie_backend_; }
+  // the trie of the prism to be built.
+  void set_trie_backend(prism::TrieBackend backend) {
+    trie_backend_ = backend;
+  }
+  const SpellingTrie& trie() const { return *trie_; }
 
  protected:
-  the<Darts::DoubleArray> trie_;
+  void ComputeWeights(const vector<prism::Weight>& syllable_weights,
+                      prism::Weight* spelling_weights,
+                      prism::Weight* subtree_weights);
+  // finds the spelling map and completions of the format in the metadata.
+  void FindSpellingMap();
+  // reads the trie of the backend found in the metadata.
+  bool AttachTrie();
+  bool BuildCompactSpellingMap(const Script& script,
+                               const map<string, SyllableId>& syllable_to_id);
+
+  the<SpellingTrie> trie_;
+  prism::TrieBackend trie_backend_ = prism::kDoubleArrayTrie;
   prism::Metadata* metadata_ = nullptr;
   prism::SpellingMap* spelling_map_ = nullptr;
+  const prism::CompactSpellingMap* compact_spelling_map_ = nullptr;
+  const prism::SpellingTables* spelling_tables_ = nullptr;
+  const prism::Weight* spelling_weights_ = nullptr;
+  const prism::Weight* subtree_weights_ = nullptr;
+  const prism::CompletionMap* completion_map_ = nullptr;
+  const prism::CompactCompletionMap* compact_completion_map_ = nullptr;
   double format_ = 0.0;
+  uint32_t syllabary_checksum_ = 0;
+  uint32_t algebra_checksum_ = 0;
+  std::atomic<size_t> max_spelling_length_ = 0;
 };
 
 }  // namespace rime
@@ -5,10 +5,13 @@
 // 2012-01-05 GONG Chen <chen.sst@gmail.com>
 // 2014-07-06 GONG Chen <chen.sst@gmail.com> redesigned binary file format.
 //
+#include <algorithm>
 #include <cfloat>
 #include <cstdlib>
+#include <mutex>
 #include <sstream>
 #include <boost/algorithm/string.hpp>
+#include <utf8.h>
 #include <rime/resource.h>
 #include <rime/schema.h>
 #include <rime/service.h>
@@ -19,7 +22,9 @@
 
 namespace rime {
 
-const char kReverseFormat[] = "Rime::Reverse/3.1";
+const char kReverseFormat[] = "Rime::Reverse/3.2";
+// the first format with an index of single characters.
+const double kReverseFormatWithCharIndex = 3.2;
 const double kReverseFormatCompatible = 3.0;
 
 const char kReverseFormatPrefix[] = "Rime::Reverse/";
@@ -27,6 +32,17 @@ const size_t kReverseFormatPrefixLen = sizeof(kReverseFormatPrefix) - 1;
 
 static const char* kStemKeySuffix = "\x1fstem";
 
+static bool get_single_code_point(const string& text, uint32_t* code_point) {
+  if (text.empty() || !utf8::is_valid(text.begin(), text.end()))
+    return false;
+  auto it = text.begin();
+  *code_point = utf8::unchecked::next(it);
+  return it == text.end();
+}
+
+// texts of candidates are looked up again while paging back and forth.
+static const size_t kMaxRecentResults = 1024;
+
 ReverseDb::ReverseDb(const path& file_path) : MappedFile(file_path) {}
 
 bool ReverseDb::Load() {
@@ -60,11 +76,28 @@ bool ReverseDb::Load() {
     return false;
   }
 
+  char_index_ = nullptr;
+  if (format - kReverseFormatWithCharIndex > 0.0 - DBL_EPSILON &&
+      metadata_->char_index.size > 0) {
+    char_index_ = &metadata_->char_index;
+  }
+
+  string_table_stats_.reset();
   key_trie_.reset(
       new StringTable(metadata_->key_trie.get(), metadata_->key_trie_size));
   value_trie_.reset(
       new StringTable(metadata_->value_trie.get(), metadata_->value_trie_size));
 
+  TrackMemoryUsage("reverse_db");
+  string_table_stats_.reset(
+      new MemoryStatsRegistration([this](vector<MemoryUsage>* usages) {
+        MemoryUsage usage;
+        usage.category = "string_table";
+        usage.name = file_path().u8string();
+        usage.heap_bytes = key_trie_->HeapSize() + value_trie_->HeapSize();
+        usage.count = key_trie_->NumKeys();
+        usages->push_back(std::move(usage));
+      }));
   return true;
 }
 
@@ -81,6 +114,25 @@ bool ReverseDb::Lookup(const string& text, string* result) {
   return !result->empty();
 }
 
+bool ReverseDb::LookupChar(uint32_t code_point, string* result) {
+  if (!char_index_) {
+    // the file is of an earlier format.
+    string text;
+    utf8::unchecked::append(code_point, std::back_inserter(text));
+    return Lookup(text, result);
+  }
+  if (!value_trie_)
+    return false;
+  uint32_t base = metadata_->char_index_base;
+  if (code_point < base || code_point - base >= char_index_->size)
+    return false;
+  StringId value_id = char_index_->at[code_point - base];
+  if (value_id == kInvalidStringId)
+    return false;
+  *result = value_trie_->GetString(value_id);
+  return !result->empty();
+}
+
 bool ReverseDb::Build(DictSettings* settings,
                       const Syllabary& syllabary,
                       const Vocabulary& vocabulary,
@@ -123,6 +175,21 @@ bool ReverseDb::Build(DictSettings* settings,
   key_trie_builder.Build();
   value_trie_builder.Build();
 
+  // the range of single characters to index by code point.
+  uint32_t min_code_point = 0;
+  uint32_t max_code_point = 0;
+  size_t char_index_size = 0;
+  for (const auto& v : rev_table) {
+    uint32_t code_point;
+    if (!get_single_code_point(v.first, &code_point))
+      continue;
+    if (char_index_size == 0 || code_point < min_code_point)
+      min_code_point = code_point;
+    if (char_index_size == 0 || code_point > max_code_point)
+      max_code_point = code_point;
+    char_index_size = max_code_point - min_code_point + 1;
+  }
+
   // dict settings required by UniTE
   string dict_settings;
   if (settings && settings->use_rule_based_encoder()) {
@@ -137,6 +204,7 @@ bool ReverseDb::Build(DictSettings* settings,
   size_t value_trie_image_size = value_trie_builder.BinarySize();
   size_t estimated_data_size = kReservedSize + dict_settings.length() +
                                entry_count * sizeof(StringId) +
+                               char_index_size * sizeof(StringId) +
                                key_trie_image_size + value_trie_image_size;
   if (!Create(estimated_data_size)) {
     LOG(ERROR) << "Error creating prism file '" << file_path() << "'.";
@@ -167,8 +235,27 @@ bool ReverseDb::Build(DictSettings* settings,
   metadata_->index.size = entry_count;
   metadata_->index.at = entries;
 
+  if (char_index_size > 0) {
+    auto char_entries = Allocate<StringId>(char_index_size);
+    if (!char_entries) {
+      return false;
+    }
+    std::fill_n(char_entries, char_index_size, kInvalidStringId);
+    i = 0;
+    for (const auto& v : rev_table) {
+      uint32_t code_point;
+      if (get_single_code_point(v.first, &code_point)) {
+        char_entries[code_point - min_code_point] = value_ids[i];
+      }
+      ++i;
+    }
+    metadata_->char_index_base = min_code_point;
+    metadata_->char_index.size = char_index_size;
+    metadata_->char_index.at = char_entries;
+  }
+
   // save key trie image
-  char* key_trie_image = Allocate<char>(key_trie_image_size);
+  char* key_trie_image = AllocateStringTableImage(key_trie_image_size);
   if (!key_trie_image) {
     LOG(ERROR) << "Error creating key trie image.";
     return false;
@@ -178,7 +265,7 @@ bool ReverseDb::Build(DictSettings* settings,
   metadata_->key_trie_size = key_trie_image_size;
 
   // save value trie image
-  char* value_trie_image = Allocate<char>(value_trie_image_size);
+  char* value_trie_image = AllocateStringTableImage(value_trie_image_size);
   if (!value_trie_image) {
     LOG(ERROR) << "Error creating value trie image.";
     return false;
@@ -205,12 +292,85 @@ uint32_t ReverseDb::dict_file_checksum() const {
 ReverseLookupDictionary::ReverseLookupDictionary(an<ReverseDb> db) : db_(db) {}
 
 bool ReverseLookupDictionary::Load() {
+  // the db is shared with dictionaries being loaded on other threads.
+  static std::mutex load_mutex;
+  std::lock_guard<std::mutex> lock(load_mutex);
   return db_ && (db_->IsOpen() || db_->Load());
 }
 
 bool ReverseLookupDictionary::ReverseLookup(const string& text,
                                             string* result) {
-  return db_->Lookup(text, result);
+  {
+    std::lock_guard<std::mutex> lock(recent_results_mutex_);
+    auto it = recent_results_.find(text);
+    if (it != recent_results_.end()) {
+      *result = it->second;
+      return !result->empty();
+    }
+  }
+  string found;
+  db_->Lookup(text, &found);
+  *result = found;
+  std::lock_guard<std::mutex> lock(recent_results_mutex_);
+  if (recent_results_.size() >= kMaxRecentResults) {
+    recent_results_.clear();
+  }
+  recent_results_.emplace(text, std::move(found));
+  return !result->empty();
+}
+
+bool ReverseLookupDictionary::ReverseLookupChars(const string& text,
+                                                 string* result) {
+  if (!utf8::is_valid(text.begin(), text.end()))
+    return false;
+  string codes;
+  string char_codes;
+  for (auto it = text.begin(); it != text.end();) {
+    if (!db_->LookupChar(utf8::unchecked::next(it), &char_codes))
+      return false;
+    if (!codes.empty())
+      codes += ' ';
+    codes += char_codes.substr(0, char_codes.find(' '));
+  }
+  *result = codes;
+  return !codes.empty();
+}
+
+size_t ReverseLookupDictionary::ReverseLookup(const vector<string>& texts,
+                                              vector<string>* results) {
+  results->assign(texts.size(), string());
+  // texts not looked up lately, in key order for locality in the trie.
+  vector<size_t> misses;
+  {
+    std::lock_guard<std::mutex> lock(recent_results_mutex_);
+    for (size_t i = 0; i < texts.size(); ++i) {
+      auto it = recent_results_.find(texts[i]);
+      if (it != recent_results_.end())
+        (*results)[i] = it->second;
+      else
+        misses.push_back(i);
+    }
+  }
+  std::sort(misses.begin(), misses.end(),
+            [&texts](size_t a, size_t b) { return texts[a] < texts[b]; });
+  for (size_t k = 0; k < misses.size(); ++k) {
+    size_t i = misses[k];
+    if (k > 0 && texts[i] == texts[misses[k - 1]])
+      (*results)[i] = (*results)[misses[k - 1]];
+    else
+      db_->Lookup(texts[i], &(*results)[i]);
+  }
+  if (!misses.empty()) {
+    std::lock_guard<std::mutex> lock(recent_results_mutex_);
+    if (recent_results_.size() + misses.size() > kMaxRecentResults) {
+      recent_results_.clear();
+    }
+    for (size_t i : misses) {
+      recent_results_.emplace(texts[i], (*results)[i]);
+    }
+  }
+  return std::count_if(results->begin(), results->end(),
+                       [](const string& x) { return !x.empty(); });
 }
 
 bool ReverseLookupDictionary::LookupStems(const string& text, string* result) {
@@ -231,6 +391,12 @@ an<DictSettings> ReverseLookupDictionary::GetDictSettings() {
   return settings;
 }
 
+void ReverseLookupDictionary::set_load_flags(int flags) {
+  if (db_ && !db_->IsOpen()) {
+    db_->set_load_flags(flags);
+  }
+}
+
 static const ResourceType kReverseDbResourceType = {"reverse_db", "",
                                                     ".reverse.bin"};
 
@@ -255,7 +421,13 @@ ReverseLookupDictionary* ReverseLookupDictionaryComponent::Create(
     // missing!
     return NULL;
   }
-  return Create(dict_name);
+  auto dict = Create(dict_name);
+  int load_flags =
+      MappedFile::GetLoadFlags(config, ticket.name_space + "/load_mode");
+  if (dict && load_flags != MappedFile::kLoadDefault) {
+    dict->set_load_flags(load_flags);
+  }
+  return dict;
 }
 
 }  // namespace rime
@@ -9,6 +9,7 @@
 #define RIME_REVERSE_LOOKUP_DICTIONARY_H_
 
 #include <stdint.h>
+#include <mutex>
 #include <rime/common.h>
 #include <rime/component.h>
 #include <rime/dict/db_pool.h>
@@ -30,6 +31,10 @@ struct Metadata {
   uint32_t key_trie_size;
   OffsetPtr<char> value_trie;
   uint32_t value_trie_size;
+  // since format 3.2: values of single characters indexed by code point,
+  // starting from char_index_base.
+  uint32_t char_index_base;
+  List<StringId> char_index;
 };
 
 }  // namespace reverse
@@ -43,6 +48,8 @@ class ReverseDb : public MappedFile {
 
   bool Load();
   bool Lookup(const string& text, string* result);
+  // looks up a single character by its code point.
+  bool LookupChar(uint32_t code_point, string* result);
 
   bool Build(DictSettings* settings,
              const Syllabary& syllabary,
@@ -56,8 +63,12 @@ class ReverseDb : public MappedFile {
 
  private:
   reverse::Metadata* metadata_ = nullptr;
+  // points into the file if it has one.
+  const List<StringId>* char_index_ = nullptr;
   the<StringTable> key_trie_;
   the<StringTable> value_trie_;
+  // dropped before the string tables it reports on.
+  the<MemoryStatsRegistration> string_table_stats_;
 };
 
 class ReverseLookupDictionary
@@ -66,11 +77,22 @@ class ReverseLookupDictionary
   explicit ReverseLookupDictionary(an<ReverseDb> db);
   bool Load();
   bool ReverseLookup(const string& text, string* result);
+  // looks up the texts in one go, eg. those of the candidates on a page.
+  // results[i] is left empty if texts[i] is not found.
+  // returns the number of texts found.
+  size_t ReverseLookup(const vector<string>& texts, vector<string>* results);
+  // assembles the codes of a phrase from the first code of each character.
+  bool ReverseLookupChars(const string& text, string* result);
   bool LookupStems(const string& text, string* result);
   an<DictSettings> GetDictSettings();
+  // see MappedFile::LoadFlags; ignored if the db is already loaded.
+  void set_load_flags(int flags);
 
  protected:
   an<ReverseDb> db_;
+  // results of recent lookups, including texts not found.
+  hash_map<string, string> recent_results_;
+  std::mutex recent_results_mutex_;
 };
 
 class ResourceResolver;
@@ -0,0 +1,377 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <algorithm>
+#include <cfloat>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <rime/algo/utilities.h>
+#include <rime/dict/sorted_db.h>
+#include <rime/dict/table_db.h>
+
+namespace rime {
+
+const char kSortedDbFormat[] = "Rime::SortedDb/1.0";
+const double kSortedDbFormatCompatible = 1.0;
+
+const char kSortedDbFormatPrefix[] = "Rime::SortedDb/";
+const size_t kSortedDbFormatPrefixLen = sizeof(kSortedDbFormatPrefix) - 1;
+
+static const uint32_t kIndexInterval = 16;
+
+using sorted::IndexEntry;
+using sorted::Record;
+
+// keys are compared as unsigned bytes, the same as std::string does.
+static int compare_prefix(const char* prefix, const char* key) {
+  char key_prefix[IndexEntry::kPrefixLength] = {0};
+  std::strncpy(key_prefix, key, IndexEntry::kPrefixLength);
+  return std::memcmp(prefix, key_prefix, IndexEntry::kPrefixLength);
+}
+
+// finds the first record not less than the key, without allocating.
+static const Record* find_lower_bound(const List<Record>& records,
+                                      const List<IndexEntry>& index,
+                                      uint32_t index_interval,
+                                      const char* key) {
+  const Record* begin = records.begin();
+  const Record* end = records.end();
+  if (index.size && index_interval) {
+    // the last indexed record that is not greater than the key
+    const IndexEntry* block = std::upper_bound(
+        index.begin(), index.end(), key,
+        [&records](const char* key, const IndexEntry& entry) {
+          int c = compare_prefix(entry.prefix, key);
+          if (c != 0)
+            return c > 0;
+          return std::strcmp(key, records.at[entry.record_index].key.c_str()) <
+                 0;
+        });
+    if (block == index.begin())
+      return begin;
+    uint32_t first = (block - 1)->record_index;
+    begin = records.begin() + first;
+    end = records.begin() + (std::min)(records.size, first + index_interval);
+  }
+  return std::lower_bound(begin, end, key,
+                          [](const Record& record, const char* key) {
+                            return std::strcmp(record.key.c_str(), key) < 0;
+                          });
+}
+
+// SortedDbFile
+
+class SortedDbFile : public MappedFile {
+ public:
+  explicit SortedDbFile(const path& file_path) : MappedFile(file_path) {}
+
+  bool Load();
+  bool Build(Db* source, uint32_t source_file_checksum);
+  bool Save() { return ShrinkToFit(); }
+
+  const Record* LowerBound(const char* key) const {
+    return find_lower_bound(metadata_->records, metadata_->index,
+                            metadata_->index_interval, key);
+  }
+  const Record* LowerBoundMetadata(const char* key) const {
+    return find_lower_bound(metadata_->metadata, {}, 0, key);
+  }
+
+  sorted::Metadata* metadata() const { return metadata_; }
+
+ private:
+  sorted::Metadata* metadata_ = nullptr;
+};
+
+bool SortedDbFile::Load() {
+  if (IsOpen())
+    Close();
+
+  if (!OpenReadOnly()) {
+    LOG(ERROR) << "Error opening sorted db '" << file_path() << "'.";
+    return false;
+  }
+
+  metadata_ = Find<sorted::Metadata>(0);
+  if (!metadata_) {
+    LOG(ERROR) << "metadata not found.";
+    Close();
+    return false;
+  }
+  if (strncmp(metadata_->format, kSortedDbFormatPrefix,
+              kSortedDbFormatPrefixLen)) {
+    LOG(ERROR) << "invalid metadata.";
+    Close();
+    return false;
+  }
+  double format = std::atof(&metadata_->format[kSortedDbFormatPrefixLen]);
+  if (format - kSortedDbFormatCompatible < 0.0 - DBL_EPSILON ||
+      format - kSortedDbFormatCompatible > 1.0 + DBL_EPSILON) {
+    LOG(ERROR) << "incompatible sorted db format.";
+    Close();
+    return false;
+  }
+  return true;
+}
+
+static bool read_all(an<DbAccessor> accessor,
+                     vector<pair<string, string>>* records,
+                     size_t* string_size) {
+  if (!accessor)
+    return false;
+  string key, value;
+  while (accessor->GetNextRecord(&key, &value)) {
+    *string_size += key.length() + value.length() + 2;
+    records->emplace_back(key, value);
+  }
+  return true;
+}
+
+bool SortedDbFile::Build(Db* source, uint32_t source_file_checksum) {
+  LOG(INFO) << "building sorted db...";
+  // both accessors yield records in the order of keys
+  vector<pair<string, string>> metadata;
+  vector<pair<string, string>> records;
+  size_t string_size = 0;
+  if (!read_all(source->QueryMetadata(), &metadata, &string_size) ||
+      !read_all(source->QueryAll(), &records, &string_size)) {
+    LOG(ERROR) << "Error reading db '" << source->name() << "'.";
+    return false;
+  }
+  size_t index_size = (records.size() + kIndexInterval - 1) / kIndexInterval;
+
+  const size_t kReservedSize = 1024;
+  size_t estimated_file_size =
+      kReservedSize + sizeof(sorted::Metadata) +
+      (metadata.size() + records.size()) * sizeof(Record) +
+      index_size * sizeof(IndexEntry) + string_size;
+  if (!Create(estimated_file_size)) {
+    LOG(ERROR) << "Error creating sorted db file '" << file_path() << "'.";
+    return false;
+  }
+
+  metadata_ = Allocate<sorted::Metadata>();
+  if (!metadata_) {
+    LOG(ERROR) << "Error creating metadata in file '" << file_path() << "'.";
+    return false;
+  }
+  metadata_->source_file_checksum = source_file_checksum;
+  metadata_->index_interval = kIndexInterval;
+
+  auto copy_records = [this](const vector<pair<string, string>>& src,
+                             List<Record>* dest) {
+    Record* at = Allocate<Record>(src.size());
+    if (!at)
+      return false;
+    dest->at = at;
+    dest->size = src.size();
+    for (size_t i = 0; i < src.size(); ++i) {
+      if (!CopyString(src[i].first, &at[i].key) ||
+          !CopyString(src[i].second, &at[i].value))
+        return false;
+    }
+    return true;
+  };
+  if (!copy_records(metadata, &metadata_->metadata) ||
+      !copy_records(records, &metadata_->records)) {
+    LOG(ERROR) << "Error creating records.";
+    return false;
+  }
+
+  IndexEntry* index = Allocate<IndexEntry>(index_size);
+  if (!index) {
+    LOG(ERROR) << "Error creating index.";
+    return false;
+  }
+  metadata_->index.at = index;
+  metadata_->index.size = index_size;
+  for (size_t i = 0; i < index_size; ++i) {
+    uint32_t record_index = i * kIndexInterval;
+    index[i].record_index = record_index;
+    std::strncpy(index[i].prefix, records[record_index].first.c_str(),
+                 IndexEntry::kPrefixLength);
+  }
+
+  // at last, complete the metadata
+  std::strncpy(metadata_->format, kSortedDbFormat,
+               sorted::Metadata::kFormatMaxLength - 1);
+  LOG(INFO) << "built sorted db of " << records.size() << " records.";
+  return true;
+}
+
+// SortedDbAccessor
+
+class SortedDbAccessor : public DbAccessor {
+ public:
+  SortedDbAccessor(const SortedDbFile* file,
+                   bool metadata,
+                   const string& prefix)
+      : DbAccessor(prefix), file_(file), metadata_(metadata) {
+    Reset();
+  }
+
+  bool Reset() override { return Jump(prefix_); }
+  bool Jump(const string& key) override {
+    iter_ = metadata_ ? file_->LowerBoundMetadata(key.c_str())
+                      : file_->LowerBound(key.c_str());
+    return iter_ != end();
+  }
+  bool GetNextRecord(string* key, string* value) override {
+    if (!key || !value || exhausted())
+      return false;
+    *key = iter_->key.c_str();
+    *value = iter_->value.c_str();
+    ++iter_;
+    return true;
+  }
+  bool exhausted() override {
+    return iter_ == end() || std::strncmp(iter_->key.c_str(), prefix_.c_str(),
+                                          prefix_.length()) != 0;
+  }
+
+ private:
+  const Record* end() const {
+    return metadata_ ? file_->metadata()->metadata.end()
+                     : file_->metadata()->records.end();
+  }
+
+  const SortedDbFile* file_;
+  bool metadata_;
+  const Record* iter_ = nullptr;
+};
+
+// SortedDb members
+
+SortedDb::SortedDb(const path& file_path, const string& db_name)
+    : Db(file_path, db_name),
+      source_file_path_(file_path.parent_path() / (db_name + ".txt")) {}
+
+SortedDb::~SortedDb() {
+  if (loaded())
+    Close();
+}
+
+bool SortedDb::Open() {
+  if (loaded())
+    return false;
+  if (!Exists() && !Compile()) {
+    LOG(ERROR) << "sorted db '" << name() << "' does not exist.";
+    return false;
+  }
+  file_.reset(new SortedDbFile(file_path()));
+  loaded_ = file_->Load();
+  if (loaded_) {
+    readonly_ = true;
+  } else {
+    LOG(ERROR) << "Error opening db '" << name() << "' read-only.";
+    file_.reset();
+  }
+  return loaded_;
+}
+
+bool SortedDb::OpenReadOnly() {
+  return Open();
+}
+
+bool SortedDb::Close() {
+  if (!loaded())
+    return false;
+  file_.reset();
+  loaded_ = false;
+  readonly_ = false;
+  return true;
+}
+
+bool SortedDb::Compile() {
+  if (loaded()) {
+    LOG(ERROR) << "cannot compile opened db '" << name() << "'.";
+    return false;
+  }
+  if (!std::filesystem::exists(source_file_path_)) {
+    LOG(ERROR) << "source file '" << source_file_path_ << "' of db '" << name()
+               << "' does not exist.";
+    return false;
+  }
+  uint32_t checksum = Checksum(source_file_path_);
+  SortedDbFile file(file_path());
+  if (Exists() && file.Load() &&
+      file.metadata()->source_file_checksum == checksum) {
+    return true;
+  }
+  file.Close();
+  LOG(INFO) << "compiling db '" << name() << "' from " << source_file_path_;
+  StableDb source(source_file_path_, name());
+  if (!source.Open()) {
+    return false;
+  }
+  if (!file.Build(&source, checksum) || !file.Save()) {
+    LOG(ERROR) << "Error compiling db '" << name() << "'.";
+    file.Close();
+    file.Remove();
+    return false;
+  }
+  return true;
+}
+
+bool SortedDb::Backup(const path& snapshot_file) {
+  if (!loaded())
+    return false;
+  LOG(INFO) << "backing up db '" << name() << "' to " << snapshot_file;
+  if (std::filesystem::exists(snapshot_file))
+    std::filesystem::remove(snapshot_file);
+  TableDb snapshot(snapshot_file, name());
+  if (!snapshot.Open()) {
+    LOG(ERROR) << "failed to create snapshot file '" << snapshot_file
+               << "' for db '" << name() << "'.";
+    return false;
+  }
+  for (const auto& record : file_->metadata()->records) {
+    snapshot.Update(record.key.c_str(), record.value.c_str());
+  }
+  return snapshot.Close();
+}
+
+bool SortedDb::MetaFetch(const string& key, string* value) {
+  if (!value || !loaded())
+    return false;
+  const Record* found = file_->LowerBoundMetadata(key.c_str());
+  if (found == file_->metadata()->metadata.end() || key != found->key.c_str())
+    return false;
+  *value = found->value.c_str();
+  return true;
+}
+
+an<DbAccessor> SortedDb::QueryMetadata() {
+  if (!loaded())
+    return nullptr;
+  return New<SortedDbAccessor>(file_.get(), true, "");
+}
+
+an<DbAccessor> SortedDb::QueryAll() {
+  return Query("");
+}
+
+an<DbAccessor> SortedDb::Query(const string& key) {
+  if (!loaded())
+    return nullptr;
+  return New<SortedDbAccessor>(file_.get(), false, key);
+}
+
+bool SortedDb::Fetch(const string& key, string* value) {
+  if (!value || !loaded())
+    return false;
+  const Record* found = file_->LowerBound(key.c_str());
+  if (found == file_->metadata()->records.end() || key != found->key.c_str())
+    return false;
+  *value = found->value.c_str();
+  return true;
+}
+
+template <>
+string DbComponent<SortedDb>::extension() const {
+  return ".sorted.bin";
+}
+
+}  // namespace rime
@@ -0,0 +1,89 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#ifndef RIME_SORTED_DB_H_
+#define RIME_SORTED_DB_H_
+
+#include <stdint.h>
+#include <rime/dict/db.h>
+#include <rime/dict/mapped_file.h>
+
+namespace rime {
+
+namespace sorted {
+
+struct Record {
+  String key;
+  String value;
+};
+
+// every kIndexInterval-th record is indexed by the leading bytes of its key,
+// zero padded, so that a lookup scans a compact array before it touches the
+// strings of at most one block of records.
+struct IndexEntry {
+  static const int kPrefixLength = 12;
+  char prefix[kPrefixLength];
+  uint32_t record_index;
+};
+
+struct Metadata {
+  static const int kFormatMaxLength = 32;
+  char format[kFormatMaxLength];
+  uint32_t source_file_checksum;
+  uint32_t index_interval;
+  // both lists are sorted by key
+  List<Record> metadata;
+  List<Record> records;
+  List<IndexEntry> index;
+};
+
+}  // namespace sorted
+
+class SortedDbFile;
+
+// A read-only db compiled from a tabledb text file into a memory-mapped array
+// of records sorted by key.
+// The compiled file 'name.sorted.bin' is built from 'name.txt' next to it,
+// during deployment or else on first open.
+class SortedDb : public Db {
+ public:
+  RIME_API SortedDb(const path& file_path, const string& db_name);
+  RIME_API virtual ~SortedDb();
+
+  RIME_API bool Open() override;
+  RIME_API bool OpenReadOnly() override;
+  RIME_API bool Close() override;
+
+  // writes the records to a tabledb text file.
+  RIME_API bool Backup(const path& snapshot_file) override;
+  bool Restore(const path& snapshot_file) override { return false; }
+
+  bool CreateMetadata() override { return false; }
+  RIME_API bool MetaFetch(const string& key, string* value) override;
+  bool MetaUpdate(const string& key, const string& value) override {
+    return false;
+  }
+
+  RIME_API an<DbAccessor> QueryMetadata() override;
+  RIME_API an<DbAccessor> QueryAll() override;
+  RIME_API an<DbAccessor> Query(const string& key) override;
+  RIME_API bool Fetch(const string& key, string* value) override;
+  bool Update(const string& key, const string& value) override {
+    return false;
+  }
+  bool Erase(const string& key) override { return false; }
+
+  // (re)builds the compiled file if it is missing or older than the source.
+  RIME_API bool Compile();
+
+  const path& source_file_path() const { return source_file_path_; }
+
+ private:
+  path source_file_path_;
+  the<SortedDbFile> file_;
+};
+
+}  // namespace rime
+
+#endif  // RIME_SORTED_DB_H_
@@ -0,0 +1,305 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <algorithm>
+#include <bitset>
+#include <cstring>
+#include <rime/dict/spelling_trie.h>
+
+namespace rime {
+
+bool DoubleArrayTrie::Build(size_t num_keys,
+                            const char* const* keys,
+                            const size_t* lengths) {
+  return array_.build(num_keys, keys, lengths) == 0;
+}
+
+void DoubleArrayTrie::set_image(const void* image, size_t image_size) {
+  array_.set_array(image, image_size / array_.unit_size());
+}
+
+int DoubleArrayTrie::ExactMatch(const char* key) const {
+  return array_.exactMatchSearch<int>(key);
+}
+
+size_t DoubleArrayTrie::CommonPrefixSearch(const char* key,
+                                           Match* results,
+                                           size_t max_num_results,
+                                           size_t length) const {
+  return array_.commonPrefixSearch(key, results, max_num_results, length);
+}
+
+// the image of a LOUDS trie, in 32-bit words:
+//
+// header: num_edges, num_keys, num_groups, value_bits
+// labels of the edges, 4 to a word
+// bit vectors has_child, first_child and is_key, each followed by its ranks
+// and, for first_child, the positions of sampled ones
+// values of the keys in the order of their nodes, of value_bits bits each
+// and a word to spare for reading any of them in two words
+
+static const size_t kHeaderWords = 4;
+static const size_t kBlockWords = 8;
+static const size_t kSampleRate = 64;
+
+static size_t popcount(uint32_t word) {
+  return std::bitset<32>(word).count();
+}
+
+static size_t values_size(size_t num_keys, size_t value_bits) {
+  return (num_keys * value_bits + 31) / 32 + 1;
+}
+
+static size_t bit_vector_size(size_t num_bits) {
+  size_t num_words = (num_bits + 31) / 32;
+  return num_words + num_words / kBlockWords + 1;
+}
+
+static void append_bit_vector(const vector<bool>& bits,
+                              bool sampled,
+                              vector<uint32_t>* image) {
+  size_t words = image->size();
+  size_t num_words = (bits.size() + 31) / 32;
+  image->resize(words + num_words, 0);
+  vector<uint32_t> samples;
+  size_t num_ones = 0;
+  for (size_t i = 0; i < bits.size(); ++i) {
+    if (!bits[i])
+      continue;
+    (*image)[words + i / 32] |= 1u << (i % 32);
+    if (sampled && num_ones % kSampleRate == 0)
+      samples.push_back(static_cast<uint32_t>(i));
+    ++num_ones;
+  }
+  uint32_t rank = 0;
+  for (size_t k = 0; k <= num_words; ++k) {
+    if (k % kBlockWords == 0)
+      image->push_back(rank);
+    if (k < num_words)
+      rank += static_cast<uint32_t>(popcount((*image)[words + k]));
+  }
+  image->insert(image->end(), samples.begin(), samples.end());
+}
+
+const uint32_t* LoudsTrie::BitVector::Attach(const uint32_t* image,
+                                             size_t num_bits,
+                                             size_t num_samples) {
+  size_t num_words = (num_bits + 31) / 32;
+  words = image;
+  ranks = words + num_words;
+  samples = num_samples ? ranks + num_words / kBlockWords + 1 : nullptr;
+  return ranks + num_words / kBlockWords + 1 + num_samples;
+}
+
+size_t LoudsTrie::BitVector::rank(size_t i) const {
+  size_t word = i / 32;
+  size_t n = ranks[word / kBlockWords];
+  for (size_t k = word - word % kBlockWords; k < word; ++k)
+    n += popcount(words[k]);
+  if (i % 32)
+    n += popcount(words[word] & ((1u << (i % 32)) - 1));
+  return n;
+}
+
+size_t LoudsTrie::BitVector::select(size_t n) const {
+  size_t pos = samples[n / kSampleRate];
+  size_t word = pos / 32;
+  // ones to skip from the sampled one on
+  size_t skipped = n % kSampleRate;
+  uint32_t bits = words[word] & (~0u << (pos % 32));
+  for (size_t count; skipped >= (count = popcount(bits));) {
+    skipped -= count;
+    bits = words[++word];
+  }
+  for (; skipped; --skipped)
+    bits &= bits - 1;
+  size_t bit = 0;
+  while (!((bits >> bit) & 1))
+    ++bit;
+  return word * 32 + bit;
+}
+
+bool LoudsTrie::Build(size_t num_keys,
+                      const char* const* keys,
+                      const size_t* lengths) {
+  // the keys sharing the first depth characters, in breadth-first order.
+  struct Node {
+    size_t depth;
+    size_t begin;
+    size_t end;
+  };
+  vector<Node> nodes{{0, 0, num_keys}};
+  vector<unsigned char> labels;
+  vector<bool> has_child;
+  vector<bool> first_child;
+  vector<bool> is_key;
+  vector<uint32_t> values;
+  for (size_t n = 0; n < nodes.size(); ++n) {
+    const Node node = nodes[n];
+    size_t i = node.begin;
+    bool key = i < node.end && lengths[i] == node.depth;
+    is_key.push_back(key);
+    if (key)
+      values.push_back(static_cast<uint32_t>(i++));
+    for (size_t group = 0; i < node.end; ++group) {
+      // the keys are to be unique and sorted
+      if (lengths[i] <= node.depth ||
+          (group && static_cast<unsigned char>(keys[i][node.depth]) <=
+                        labels.back()))
+        return false;
+      unsigned char label = keys[i][node.depth];
+      size_t j = i + 1;
+      while (j < node.end && lengths[j] > node.depth &&
+             static_cast<unsigned char>(keys[j][node.depth]) == label)
+        ++j;
+      labels.push_back(label);
+      has_child.push_back(j - i > 1 || lengths[i] > node.depth + 1);
+      first_child.push_back(group == 0);
+      nodes.push_back({node.depth + 1, i, j});
+      i = j;
+    }
+  }
+  size_t num_edges = labels.size();
+  size_t num_groups = std::count(first_child.begin(), first_child.end(), true);
+  size_t value_bits = 1;
+  while (value_bits < 31 && (num_keys >> value_bits))
+    ++value_bits;
+  vector<uint32_t> image{static_cast<uint32_t>(num_edges),
+                         static_cast<uint32_t>(values.size()),
+                         static_cast<uint32_t>(num_groups),
+                         static_cast<uint32_t>(value_bits)};
+  image.resize(kHeaderWords + (num_edges + 3) / 4, 0);
+  if (num_edges)
+    std::memcpy(&image[kHeaderWords], &labels[0], num_edges);
+  append_bit_vector(has_child, false, &image);
+  append_bit_vector(first_child, true, &image);
+  append_bit_vector(is_key, false, &image);
+  size_t words = image.size();
+  image.resize(words + values_size(values.size(), value_bits), 0);
+  for (size_t i = 0; i < values.size(); ++i) {
+    size_t bit = i * value_bits;
+    uint64_t packed = static_cast<uint64_t>(values[i]) << (bit % 32);
+    image[words + bit / 32] |= static_cast<uint32_t>(packed);
+    image[words + bit / 32 + 1] |= static_cast<uint32_t>(packed >> 32);
+  }
+  buffer_.swap(image);
+  set_image(&buffer_[0], buffer_.size() * sizeof(uint32_t));
+  return true;
+}
+
+void LoudsTrie::set_image(const void* image, size_t image_size) {
+  if (image != buffer_.data())
+    vector<uint32_t>().swap(buffer_);
+  image_ = nullptr;
+  image_size_ = 0;
+  num_edges_ = num_groups_ = 0;
+  values_ = nullptr;
+  value_bits_ = 0;
+  const uint32_t* words = reinterpret_cast<const uint32_t*>(image);
+  size_t num_words = image_size / sizeof(uint32_t);
+  if (!words || num_words < kHeaderWords)
+    return;
+  size_t num_edges = words[0];
+  size_t num_keys = words[1];
+  size_t num_groups = words[2];
+  size_t value_bits = words[3];
+  size_t expected_size =
+      kHeaderWords + (num_edges + 3) / 4 + bit_vector_size(num_edges) * 2 +
+      (num_groups + kSampleRate - 1) / kSampleRate +
+      bit_vector_size(num_edges + 1) + values_size(num_keys, value_bits);
+  if (num_words < expected_size || num_groups > num_edges ||
+      value_bits == 0 || value_bits > 31) {
+    LOG(ERROR) << "invalid LOUDS trie image.";
+    return;
+  }
+  image_ = words;
+  image_size_ = image_size;
+  num_edges_ = num_edges;
+  num_groups_ = num_groups;
+  words += kHeaderWords;
+  labels_ = reinterpret_cast<const unsigned char*>(words);
+  words += (num_edges + 3) / 4;
+  words = has_child_.Attach(words, num_edges, 0);
+  words = first_child_.Attach(words, num_edges,
+                              (num_groups + kSampleRate - 1) / kSampleRate);
+  words = is_key_.Attach(words, num_edges + 1, 0);
+  values_ = words;
+  value_bits_ = value_bits;
+}
+
+int LoudsTrie::value(size_t node_pos) const {
+  if (!is_key_.get(node_pos))
+    return -1;
+  size_t bit = is_key_.rank(node_pos) * value_bits_;
+  uint64_t packed = values_[bit / 32] |
+                    static_cast<uint64_t>(values_[bit / 32 + 1]) << 32;
+  return static_cast<int>((packed >> (bit % 32)) & ((1u << value_bits_) - 1));
+}
+
+size_t LoudsTrie::Child(size_t node_pos, unsigned char label) const {
+  size_t group = 0;
+  if (node_pos == 0) {
+    if (!num_groups_)
+      return 0;
+  } else {
+    if (!has_child_.get(node_pos - 1))
+      return 0;
+    group = has_child_.rank(node_pos);
+  }
+  size_t edge = first_child_.select(group);
+  do {
+    if (labels_[edge] == label)
+      return edge + 1;
+    if (labels_[edge] > label)
+      return 0;
+  } while (++edge < num_edges_ && !first_child_.get(edge));
+  return 0;
+}
+
+int LoudsTrie::Traverse(const char* key,
+                        size_t* node_pos,
+                        size_t* key_pos,
+                        size_t length) const {
+  if (!values_)
+    return -2;
+  size_t node = *node_pos;
+  for (; length ? *key_pos < length : key[*key_pos] != '\0'; ++*key_pos) {
+    node = Child(node, static_cast<unsigned char>(key[*key_pos]));
+    if (!node)
+      return -2;
+    *node_pos = node;
+  }
+  return value(node);
+}
+
+int LoudsTrie::ExactMatch(const char* key) const {
+  size_t node_pos = 0;
+  size_t key_pos = 0;
+  int value = Traverse(key, &node_pos, &key_pos);
+  return value < 0 ? -1 : value;
+}
+
+size_t LoudsTrie::CommonPrefixSearch(const char* key,
+                                     Match* results,
+                                     size_t max_num_results,
+                                     size_t length) const {
+  if (!values_)
+    return 0;
+  size_t num_results = 0;
+  size_t node = 0;
+  for (size_t i = 0; length ? i < length : key[i] != '\0'; ++i) {
+    node = Child(node, static_cast<unsigned char>(key[i]));
+    if (!node)
+      break;
+    int v = value(node);
+    if (v < 0)
+      continue;
+    if (num_results < max_num_results)
+      results[num_results] = Match{v, i + 1};
+    ++num_results;
+  }
+  return num_results;
+}
+
+}  // namespace rime
@@ -0,0 +1,143 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#ifndef RIME_SPELLING_TRIE_H_
+#define RIME_SPELLING_TRIE_H_
+
+#include <stdint.h>
+#include <darts.h>
+#include <rime/common.h>
+
+namespace rime {
+
+// The trie of the spellings in a prism, mapping each of the sorted keys it
+// is built from to its index. Traversals follow the conventions of
+// Darts::DoubleArray: the root is at node position 0; the value of the key
+// is returned at a key, -1 at a node on the paths of longer keys, and -2 off
+// the paths of the trie, in which case node_pos and key_pos are left at the
+// last node reached.
+class SpellingTrie {
+ public:
+  using Match = Darts::DoubleArray::result_pair_type;
+
+  virtual ~SpellingTrie() = default;
+
+  virtual bool Build(size_t num_keys,
+                     const char* const* keys,
+                     const size_t* lengths) = 0;
+  // reads the trie in place from an image made by image().
+  virtual void set_image(const void* image, size_t image_size) = 0;
+  virtual const void* image() const = 0;
+  virtual size_t image_size() const = 0;
+  // node positions are less than the size.
+  virtual size_t size() const = 0;
+
+  // the key is traversed up to length, or its end if length is 0.
+  virtual int Traverse(const char* key,
+                       size_t* node_pos,
+                       size_t* key_pos,
+                       size_t length = 0) const = 0;
+  virtual int ExactMatch(const char* key) const = 0;
+  // returns the number of keys found, of which at most max_num_results are
+  // stored to results.
+  virtual size_t CommonPrefixSearch(const char* key,
+                                    Match* results,
+                                    size_t max_num_results,
+                                    size_t length) const = 0;
+};
+
+class DoubleArrayTrie : public SpellingTrie {
+ public:
+  bool Build(size_t num_keys,
+             const char* const* keys,
+             const size_t* lengths) override;
+  void set_image(const void* image, size_t image_size) override;
+  const void* image() const override { return array_.array(); }
+  size_t image_size() const override { return array_.total_size(); }
+  size_t size() const override { return array_.size(); }
+  int Traverse(const char* key,
+               size_t* node_pos,
+               size_t* key_pos,
+               size_t length = 0) const override {
+    return array_.traverse(key, *node_pos, *key_pos, length);
+  }
+  int ExactMatch(const char* key) const override;
+  size_t CommonPrefixSearch(const char* key,
+                            Match* results,
+                            size_t max_num_results,
+                            size_t length) const override;
+
+ private:
+  Darts::DoubleArray array_;
+};
+
+// A succinct trie in level-order unary degree sequence (LOUDS), taking some
+// 11 bits a node and the bits of the largest value a key, where a double
+// array takes 4 bytes a unit with units to spare; lookups are slower by a few
+// rank and select operations a character.
+//
+// Nodes are numbered in breadth-first order, the root 0 and the others by
+// the edges leading to them: the node of edge i is i + 1. Edges are listed
+// with their labels, whether their nodes have children, and whether they are
+// the first edges of their parents.
+class LoudsTrie : public SpellingTrie {
+ public:
+  bool Build(size_t num_keys,
+             const char* const* keys,
+             const size_t* lengths) override;
+  void set_image(const void* image, size_t image_size) override;
+  const void* image() const override { return image_; }
+  size_t image_size() const override { return image_size_; }
+  size_t size() const override { return num_edges_ + 1; }
+  int Traverse(const char* key,
+               size_t* node_pos,
+               size_t* key_pos,
+               size_t length = 0) const override;
+  int ExactMatch(const char* key) const override;
+  size_t CommonPrefixSearch(const char* key,
+                            Match* results,
+                            size_t max_num_results,
+                            size_t length) const override;
+
+ private:
+  // a bit vector in the image, with the numbers of ones before its blocks
+  // of words and, for select, the positions of sampled ones.
+  struct BitVector {
+    const uint32_t* words = nullptr;
+    const uint32_t* ranks = nullptr;
+    const uint32_t* samples = nullptr;
+
+    // returns the end of the bit vector in the image.
+    const uint32_t* Attach(const uint32_t* image,
+                           size_t num_bits,
+                           size_t num_samples);
+    bool get(size_t i) const { return (words[i / 32] >> (i % 32)) & 1; }
+    // the number of ones before position i.
+    size_t rank(size_t i) const;
+    // the position of the one preceded by n ones.
+    size_t select(size_t n) const;
+  };
+
+  // the node reached from node_pos by an edge of the label, or 0 if none.
+  size_t Child(size_t node_pos, unsigned char label) const;
+  // the value of the key at the node, or -1 if it is not a key.
+  int value(size_t node_pos) const;
+
+  vector<uint32_t> buffer_;
+  const uint32_t* image_ = nullptr;
+  size_t image_size_ = 0;
+  size_t num_edges_ = 0;
+  size_t num_groups_ = 0;
+  const unsigned char* labels_ = nullptr;
+  BitVector has_child_;
+  BitVector first_child_;
+  BitVector is_key_;
+  // values of value_bits_ bits each, packed in words
+  const uint32_t* values_ = nullptr;
+  size_t value_bits_ = 0;
+};
+
+}  // namespace rime
+
+#endif  // RIME_SPELLING_TRIE_H_
@@ -5,16 +5,51 @@
 // 2014-07-04 GONG Chen <chen.sst@gmail.com>
 //
 
+#include <array>
+#include <atomic>
+#include <cstdint>
 #include <sstream>
 #include <rime/common.h>
 #include <rime/dict/string_table.h>
 
 namespace rime {
 
+static const size_t kDecodedStringSlots = 1024;
+
+struct DecodedString {
+  uint64_t cache_id = 0;
+  StringId string_id = kInvalidStringId;
+  string text;
+};
+
+// recently decoded strings of all tables; each slot holds the last string
+// decoded of those mapped to it.
+static thread_local std::array<DecodedString, kDecodedStringSlots>
+    decoded_strings;
+
+static DecodedString& decoded_string_slot(uint64_t cache_id,
+                                          StringId string_id) {
+  size_t hash = static_cast<size_t>(cache_id * 0x9e3779b97f4a7c15ull) ^
+                static_cast<size_t>(string_id);
+  return decoded_strings[hash % kDecodedStringSlots];
+}
+
+uint64_t StringTable::NewCacheId() {
+  static std::atomic<uint64_t> next_cache_id{1};
+  return next_cache_id++;
+}
+
 StringTable::StringTable(const char* ptr, size_t size) {
-  std::stringstream stream;
-  stream.write(ptr, size);
-  stream >> trie_;
+  if (reinterpret_cast<uintptr_t>(ptr) % kImageAlignment == 0) {
+    // use the trie in place; the image must outlive this object
+    trie_.map(ptr, size);
+    mapped_ = true;
+  } else {
+    // images in files built by older versions may be unaligned
+    std::stringstream stream;
+    stream.write(ptr, size);
+    stream >> trie_;
+  }
 }
 
 bool StringTable::HasKey(const string& key) {
@@ -53,6 +88,10 @@ void StringTable::Predict(const string& query, vector<StringId>* result) {
 }
 
 string StringTable::GetString(StringId string_id) {
+  DecodedString& slot = decoded_string_slot(cache_id_, string_id);
+  if (slot.cache_id == cache_id_ && slot.string_id == string_id) {
+    return slot.text;
+  }
   marisa::Agent agent;
   agent.set_query(string_id);
   try {
@@ -61,7 +100,14 @@ string StringTable::GetString(StringId string_id) {
     LOG(ERROR) << "invalid id for string table: " << string_id;
     return string();
   }
-  return string(agent.key().ptr(), agent.key().length());
+  slot.cache_id = cache_id_;
+  slot.string_id = string_id;
+  slot.text.assign(agent.key().ptr(), agent.key().length());
+  return slot.text;
+}
+
+void StringTable::ClearDecodedStrings() {
+  cache_id_ = NewCacheId();
 }
 
 size_t StringTable::NumKeys() const {
@@ -72,6 +118,10 @@ size_t StringTable::BinarySize() const {
   return trie_.io_size();
 }
 
+size_t StringTable::HeapSize() {
+  return mapped_ ? 0 : trie_.io_size();
+}
+
 void StringTableBuilder::Add(const string& key,
                              double weight,
                              StringId* reference) {
@@ -80,12 +130,14 @@ void StringTableBuilder::Add(const string& key,
 }
 
 void StringTableBuilder::Clear() {
+  ClearDecodedStrings();
   trie_.clear();
   keys_.clear();
   references_.clear();
 }
 
 void StringTableBuilder::Build() {
+  ClearDecodedStrings();
   trie_.build(keys_);
   UpdateReferences();
 }
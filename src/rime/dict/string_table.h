@@ -8,6 +8,7 @@
 #ifndef RIME_STRING_TABLE_H_
 #define RIME_STRING_TABLE_H_
 
+#include <stdint.h>
 #include <utility>
 #include <marisa.h>
 #include <rime_api.h>
@@ -21,21 +22,40 @@ const StringId kInvalidStringId = (StringId)(-1);
 
 class RIME_API StringTable {
  public:
+  // images aligned to this boundary are mapped without copying.
+  static const size_t kImageAlignment = 8;
+
   StringTable() = default;
   virtual ~StringTable() = default;
+  // the image is used in place if aligned, so it must outlive the object.
   StringTable(const char* ptr, size_t size);
 
   bool HasKey(const string& key);
   StringId Lookup(const string& key);
   void CommonPrefixMatch(const string& query, vector<StringId>* result);
   void Predict(const string& query, vector<StringId>* result);
+  // recently decoded strings are cached by each thread, without locking.
   string GetString(StringId string_id);
 
   size_t NumKeys() const;
   size_t BinarySize() const;
+  // bytes on the heap: the trie unless used in place.
+  size_t HeapSize();
 
  protected:
+  // to be called when the trie changes; the strings decoded so far are no
+  // longer served from the cache.
+  void ClearDecodedStrings();
+
   marisa::Trie trie_;
+  bool mapped_ = false;
+
+ private:
+  static uint64_t NewCacheId();
+
+  // tells the strings of this table, as it is, apart from those of others
+  // in the caches of decoded strings.
+  uint64_t cache_id_ = NewCacheId();
 };
 
 class RIME_API StringTableBuilder : public StringTable {
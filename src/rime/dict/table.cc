@@ -7,20 +7,48 @@
 #include <cfloat>
 #include <cstring>
 #include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <mutex>
 #include <queue>
 #include <utility>
 #include <rime/common.h>
+#include <rime/algo/cpu_features.h>
 #include <rime/algo/syllabifier.h>
 #include <rime/dict/table.h>
 
+#if defined(RIME_KERNEL_X86)
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RIME_TABLE_KEY_SEARCH_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define RIME_TABLE_KEY_SEARCH_NEON
+#endif
+
 namespace rime {
 
-const char kTableFormatLatest[] = "Rime::Table/4.0";
+const char kTableFormatLatest[] = "Rime::Table/6.1";
+const char kTableFormatWithCompactEntries[] = "Rime::Table/6.0";
+// tables without compact entries are still built in the v5 format, which
+// older versions of the library can read.
+const char kTableFormatWithFullEntries[] = "Rime::Table/5.0";
 const int kTableFormatLowestCompatible = 4.0;
+const double kTableFormatFlatTrunkIndex = 5.0;
+const double kTableFormatCompactEntries = 6.0;
+const double kTableFormatCodeTrie = 6.1;
 
 const char kTableFormatPrefix[] = "Rime::Table/";
 const size_t kTableFormatPrefixLen = sizeof(kTableFormatPrefix) - 1;
 
+static uint64_t next_image_id() {
+  static std::atomic<uint64_t> last_image_id{0};
+  return ++last_image_id;
+}
+
 TableAccessor::TableAccessor(const Code& index_code,
                              const List<table::Entry>* list,
                              double credibility)
@@ -45,22 +73,33 @@ TableAccessor::TableAccessor(const Code& index_code,
       size_(code_map->size),
       credibility_(credibility) {}
 
+TableAccessor::TableAccessor(const Code& index_code,
+                             const table::StringType* texts,
+                             const table::QuantizedWeight* weights,
+                             size_t size,
+                             double credibility)
+    : index_code_(index_code),
+      texts_(texts),
+      weights_(weights),
+      size_(size),
+      credibility_(credibility) {}
+
 bool TableAccessor::exhausted() const {
-  if (entries_ || long_entries_) {
+  if (entries_ || long_entries_ || texts_) {
     return !(size_ - cursor_);
   }
   return true;
 }
 
 size_t TableAccessor::remaining() const {
-  if (entries_ || long_entries_) {
+  if (entries_ || long_entries_ || texts_) {
     return size_ - cursor_;
   }
   return 0;
 }
 
 const table::Entry* TableAccessor::entry() const {
-  if (exhausted())
+  if (exhausted() || texts_)
     return NULL;
   if (entries_)
     return &entries_[cursor_];
@@ -68,6 +107,22 @@ const table::Entry* TableAccessor::entry() const {
     return &long_entries_[cursor_].entry;
 }
 
+const table::StringType* TableAccessor::entry_text() const {
+  if (exhausted())
+    return NULL;
+  if (texts_)
+    return &texts_[cursor_];
+  return &entry()->text;
+}
+
+table::Weight TableAccessor::entry_weight() const {
+  if (exhausted())
+    return 0.0f;
+  if (weights_)
+    return table::DequantizeWeight(weights_[cursor_]);
+  return entry()->weight;
+}
+
 const table::Code* TableAccessor::extra_code() const {
   if (!long_entries_ || cursor_ >= size_)
     return NULL;
@@ -93,13 +148,16 @@ bool TableAccessor::Next() {
   return !exhausted();
 }
 
-bool TableQuery::Advance(SyllableId syllable_id, double credibility) {
+bool TableQuery::Advance(SyllableId syllable_id,
+                         double credibility,
+                         bool is_correction) {
   if (!Walk(syllable_id)) {
     return false;
   }
   ++level_;
   index_code_.push_back(syllable_id);
   credibility_.push_back(credibility_.back() + credibility);
+  is_correction_.push_back(is_correction_.back() || is_correction);
   return true;
 }
 
@@ -110,6 +168,7 @@ bool TableQuery::Backdate() {
   if (index_code_.size() > level_) {
     index_code_.pop_back();
     credibility_.pop_back();
+    is_correction_.pop_back();
   }
   return true;
 }
@@ -119,6 +178,8 @@ void TableQuery::Reset() {
   index_code_.clear();
   credibility_.clear();
   credibility_.push_back(0.0);
+  is_correction_.clear();
+  is_correction_.push_back(false);
 }
 
 inline static bool node_less(const table::TrunkIndexNode& a,
@@ -126,13 +187,155 @@ inline static bool node_less(const table::TrunkIndexNode& a,
   return a.key < b.key;
 }
 
-static table::TrunkIndexNode* find_node(table::TrunkIndexNode* first,
-                                        table::TrunkIndexNode* last,
-                                        const SyllableId& key) {
+static const table::IndexNode* find_node(const table::TrunkIndex& index,
+                                         SyllableId key) {
   table::TrunkIndexNode target;
   target.key = key;
-  auto it = std::lower_bound(first, last, target, node_less);
-  return it == last || key < it->key ? last : it;
+  auto it = std::lower_bound(index.begin(), index.end(), target, node_less);
+  return it == index.end() || key < it->key ? nullptr : &it->node;
+}
+
+// binary search narrows down the range to this many keys before switching
+// to a linear scan, which is branch-free within each block of keys.
+const size_t kKeyScanWindow = 64;
+
+// keys are sorted, so the first key not less than the target is within
+// the block where a vector scan stopped.
+static inline size_t finish_scan(const SyllableId* keys,
+                                 size_t size,
+                                 SyllableId key,
+                                 size_t i) {
+  while (i < size && keys[i] < key)
+    ++i;
+  return i;
+}
+
+// returns the position of the first key not less than the given key, by
+// the vector instructions of the baseline of the target architecture.
+static size_t scan_keys_portable(const SyllableId* keys,
+                                 size_t size,
+                                 SyllableId key) {
+  size_t i = 0;
+#if defined(RIME_TABLE_KEY_SEARCH_SSE2)
+  const __m128i target = _mm_set1_epi32(key);
+  for (; i + 4 <= size; i += 4) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+    __m128i less = _mm_cmplt_epi32(block, target);
+    if (_mm_movemask_ps(_mm_castsi128_ps(less)) != 0xf)
+      break;
+  }
+#elif defined(RIME_TABLE_KEY_SEARCH_NEON)
+  const int32x4_t target = vdupq_n_s32(key);
+  for (; i + 4 <= size; i += 4) {
+    uint32x4_t less = vcltq_s32(vld1q_s32(keys + i), target);
+    if (vminvq_u32(less) == 0)
+      break;
+  }
+#endif
+  return finish_scan(keys, size, key, i);
+}
+
+#if defined(RIME_KERNEL_X86)
+RIME_TARGET_AVX2 static size_t scan_keys_avx2(const SyllableId* keys,
+                                              size_t size,
+                                              SyllableId key) {
+  size_t i = 0;
+  const __m256i target = _mm256_set1_epi32(key);
+  for (; i + 8 <= size; i += 8) {
+    __m256i block =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+    __m256i less = _mm256_cmpgt_epi32(target, block);
+    if (_mm256_movemask_ps(_mm256_castsi256_ps(less)) != 0xff)
+      break;
+  }
+  return finish_scan(keys, size, key, i);
+}
+#endif
+
+using ScanKeys = size_t (*)(const SyllableId* keys,
+                            size_t size,
+                            SyllableId key);
+
+static ScanKeys select_scan_keys() {
+  Kernel<ScanKeys> kernel{scan_keys_portable};
+#if defined(RIME_KERNEL_X86)
+  kernel.avx2 = scan_keys_avx2;
+#endif
+  return kernel.Select();
+}
+
+static const ScanKeys scan_keys = select_scan_keys();
+
+static size_t lower_bound_key(const SyllableId* keys,
+                              size_t size,
+                              SyllableId key) {
+  size_t first = 0;
+  while (size > kKeyScanWindow) {
+    size_t half = size / 2;
+    if (keys[first + half] < key) {
+      first += half + 1;
+      size -= half + 1;
+    } else {
+      size = half;
+    }
+  }
+  return first + scan_keys(keys + first, size, key);
+}
+
+static const table::IndexNode* find_node(const table::FlatTrunkIndex& index,
+                                         SyllableId key) {
+  size_t pos = lower_bound_key(index.keys_begin(), index.size, key);
+  return pos == index.size || key < index.keys[pos] ? nullptr
+                                                    : &index.nodes[pos];
+}
+
+bool TableQueryCache::Find(const table::PhraseIndex* index,
+                           SyllableId syllable_id,
+                           const table::IndexNode** node) const {
+  auto found = nodes_.find(Key{index, syllable_id});
+  if (found == nodes_.end())
+    return false;
+  *node = found->second;
+  return true;
+}
+
+void TableQueryCache::Save(const table::PhraseIndex* index,
+                           SyllableId syllable_id,
+                           const table::IndexNode* node) {
+  if (nodes_.size() >= kMaxSize) {
+    nodes_.clear();
+  }
+  nodes_[Key{index, syllable_id}] = node;
+}
+
+void TableQueryCache::Validate(uint64_t table_image_id) {
+  if (table_image_id_ != table_image_id) {
+    nodes_.clear();
+    table_image_id_ = table_image_id;
+  }
+}
+
+void TableQueryCache::Clear() {
+  nodes_.clear();
+  table_image_id_ = 0;
+}
+
+const table::IndexNode* TableQuery::FindNode(const table::PhraseIndex* index,
+                                             SyllableId syllable_id) const {
+  if (!index)
+    return nullptr;
+  const table::IndexNode* node = nullptr;
+  if (cache_ && cache_->Find(index, syllable_id, &node))
+    return node;
+  if (flat_trunk_index_) {
+    node = find_node(*reinterpret_cast<const table::FlatTrunkIndex*>(index),
+                     syllable_id);
+  } else {
+    node = find_node(index->trunk(), syllable_id);
+  }
+  if (cache_)
+    cache_->Save(index, syllable_id, node);
+  return node;
 }
 
 bool TableQuery::Walk(SyllableId syllable_id) {
@@ -143,23 +346,15 @@ bool TableQuery::Walk(SyllableId syllable_id) {
     auto node = &lv1_index_->at[syllable_id];
     if (!node->next_level)
       return false;
-    lv2_index_ = &node->next_level->trunk();
+    lv2_index_ = node->next_level.get();
   } else if (level_ == 1) {
-    if (!lv2_index_)
-      return false;
-    auto node = find_node(lv2_index_->begin(), lv2_index_->end(), syllable_id);
-    if (node == lv2_index_->end())
-      return false;
-    if (!node->next_level)
+    auto node = FindNode(lv2_index_, syllable_id);
+    if (!node || !node->next_level)
       return false;
-    lv3_index_ = &node->next_level->trunk();
+    lv3_index_ = node->next_level.get();
   } else if (level_ == 2) {
-    if (!lv3_index_)
-      return false;
-    auto node = find_node(lv3_index_->begin(), lv3_index_->end(), syllable_id);
-    if (node == lv3_index_->end())
-      return false;
-    if (!node->next_level)
+    auto node = FindNode(lv3_index_, syllable_id);
+    if (!node || !node->next_level)
       return false;
     lv4_index_ = &node->next_level->tail();
   } else {
@@ -173,6 +368,26 @@ inline static Code add_syllable(Code code, SyllableId syllable_id) {
   return code;
 }
 
+// the weights column follows texts of compact entries.
+inline static const table::QuantizedWeight* compact_weights(
+    const List<table::Entry>& entries) {
+  return reinterpret_cast<const table::QuantizedWeight*>(
+      reinterpret_cast<const table::StringType*>(entries.at.get()) +
+      entries.size);
+}
+
+TableAccessor TableQuery::AccessEntries(const Code& index_code,
+                                        const List<table::Entry>& entries,
+                                        double credibility) const {
+  if (!compact_entries_)
+    return TableAccessor(index_code, &entries, credibility);
+  if (!entries.at)
+    return TableAccessor();
+  return TableAccessor(
+      index_code, reinterpret_cast<const table::StringType*>(entries.at.get()),
+      compact_weights(entries), entries.size, credibility);
+}
+
 TableAccessor TableQuery::Access(SyllableId syllable_id,
                                  double credibility) const {
   credibility += credibility_.back();
@@ -181,16 +396,13 @@ TableAccessor TableQuery::Access(SyllableId syllable_id,
         syllable_id >= static_cast<SyllableId>(lv1_index_->size))
       return TableAccessor();
     auto node = &lv1_index_->at[syllable_id];
-    return TableAccessor(add_syllable(index_code_, syllable_id), &node->entries,
+    return AccessEntries(add_syllable(index_code_, syllable_id), node->entries,
                          credibility);
   } else if (level_ == 1 || level_ == 2) {
-    auto index = (level_ == 1) ? lv2_index_ : lv3_index_;
-    if (!index)
-      return TableAccessor();
-    auto node = find_node(index->begin(), index->end(), syllable_id);
-    if (node == index->end())
+    auto node = FindNode((level_ == 1) ? lv2_index_ : lv3_index_, syllable_id);
+    if (!node)
       return TableAccessor();
-    return TableAccessor(add_syllable(index_code_, syllable_id), &node->entries,
+    return AccessEntries(add_syllable(index_code_, syllable_id), node->entries,
                          credibility);
   } else if (level_ == 3) {
     if (!lv4_index_)
@@ -229,7 +441,7 @@ bool Table::OnBuildFinish() {
   string_table_builder_->Build();
   // saving string table image
   size_t image_size = string_table_builder_->BinarySize();
-  char* image = Allocate<char>(image_size);
+  char* image = AllocateStringTableImage(image_size);
   if (!image) {
     LOG(ERROR) << "Error creating string table image.";
     return false;
@@ -241,8 +453,23 @@ bool Table::OnBuildFinish() {
 }
 
 bool Table::OnLoad() {
+  {
+    std::lock_guard<std::mutex> lock(dense_syllabary_mutex_);
+    dense_syllabary_.reset();
+  }
+  string_table_stats_.reset();
   string_table_.reset(new StringTable(metadata_->string_table.get(),
                                       metadata_->string_table_size));
+  TrackMemoryUsage("table");
+  string_table_stats_.reset(
+      new MemoryStatsRegistration([this](vector<MemoryUsage>* usages) {
+        MemoryUsage usage;
+        usage.category = "string_table";
+        usage.name = file_path().u8string();
+        usage.heap_bytes = string_table_->HeapSize();
+        usage.count = string_table_->NumKeys();
+        usages->push_back(std::move(usage));
+      }));
   return true;
 }
 
@@ -279,6 +506,16 @@ bool Table::Load() {
                << kTableFormatLatest;
     return false;
   }
+  if (format_version >
+      atof(&kTableFormatLatest[kTableFormatPrefixLen]) + DBL_EPSILON) {
+    LOG(ERROR) << "table format version " << format_version
+               << " is newer than the supported version "
+               << kTableFormatLatest;
+    Close();
+    return false;
+  }
+  format_ = format_version;
+  image_id_ = next_image_id();
 
   syllabary_ = metadata_->syllabary.get();
   if (!syllabary_) {
@@ -292,6 +529,7 @@ bool Table::Load() {
     Close();
     return false;
   }
+  code_trie_ = has_code_trie() ? metadata_->code_trie.get() : nullptr;
 
   return OnLoad();
 }
@@ -311,14 +549,64 @@ uint32_t Table::dict_file_checksum() const {
   return metadata_ ? metadata_->dict_file_checksum : 0;
 }
 
+bool Table::has_flat_trunk_index() const {
+  return format_ >= kTableFormatFlatTrunkIndex - DBL_EPSILON;
+}
+
+bool Table::has_compact_entries() const {
+  return format_ >= kTableFormatCompactEntries - DBL_EPSILON;
+}
+
+bool Table::has_code_trie() const {
+  return format_ >= kTableFormatCodeTrie - DBL_EPSILON;
+}
+
+const table::CodeTrieNode* Table::FindCodeTrieNode(
+    const string& prefix) const {
+  if (!code_trie_ || prefix.empty() ||
+      prefix.length() > table::kMaxCodeTriePrefixLength)
+    return nullptr;
+  const auto* begin = code_trie_->begin();
+  const auto* end = code_trie_->end();
+  const auto* node = std::lower_bound(
+      begin, end, prefix,
+      [](const table::CodeTrieNode& node, const string& prefix) {
+        return std::strcmp(node.prefix.c_str(), prefix.c_str()) < 0;
+      });
+  if (node == end || prefix != node->prefix.c_str())
+    return nullptr;
+  return node;
+}
+
 bool Table::Build(const Syllabary& syllabary,
                   const Vocabulary& vocabulary,
                   size_t num_entries,
                   uint32_t dict_file_checksum) {
+  bool done = false;
+  return Build(
+      syllabary,
+      [&]() -> const Vocabulary* {
+        if (done)
+          return nullptr;
+        done = true;
+        return &vocabulary;
+      },
+      num_entries, dict_file_checksum);
+}
+
+bool Table::Build(const Syllabary& syllabary,
+                  VocabularySource next_vocabulary,
+                  size_t num_entries,
+                  uint32_t dict_file_checksum) {
   const size_t kReservedSize = 4096;
   size_t num_syllables = syllabary.size();
   size_t estimated_file_size =
       kReservedSize + 32 * num_syllables + 64 * num_entries;
+  if (compact_entries_) {
+    // room for the code trie, should it be a table of codes.
+    estimated_file_size += table::kMaxCodeTriePrefixLength *
+                           sizeof(table::RankedEntry) * num_entries;
+  }
   LOG(INFO) << "building table.";
   LOG(INFO) << "num syllables: " << num_syllables;
   LOG(INFO) << "num entries: " << num_entries;
@@ -356,66 +644,184 @@ bool Table::Build(const Syllabary& syllabary,
   metadata_->syllabary = syllabary_;
 
   LOG(INFO) << "creating table index.";
-  index_ = BuildIndex(vocabulary, num_syllables);
+  index_ = BuildIndex(std::move(next_vocabulary), num_syllables);
   if (!index_) {
     LOG(ERROR) << "Error creating table index.";
     return false;
   }
   metadata_->index = index_;
 
+  if (!BuildSyllableFilter()) {
+    LOG(ERROR) << "Error creating syllable filter.";
+    return false;
+  }
+
   if (!OnBuildFinish()) {
     return false;
   }
 
+  // the texts of the entries are numbered once the string table is built.
+  code_trie_ = nullptr;
+  if (compact_entries_) {
+    bool table_of_codes = true;
+    for (size_t i = 0; i < index_->size; ++i) {
+      if (index_->at[i].next_level) {
+        table_of_codes = false;
+        break;
+      }
+    }
+    if (table_of_codes) {
+      LOG(INFO) << "creating code trie.";
+      code_trie_ = BuildCodeTrie(syllabary);
+      if (!code_trie_) {
+        LOG(ERROR) << "Error creating code trie.";
+        return false;
+      }
+      metadata_->code_trie = code_trie_;
+    }
+  }
+
   // at last, complete the metadata
-  std::strncpy(metadata_->format, kTableFormatLatest,
-               table::Metadata::kFormatMaxLength);
+  const char* format = code_trie_         ? kTableFormatLatest
+                       : compact_entries_ ? kTableFormatWithCompactEntries
+                                          : kTableFormatWithFullEntries;
+  std::strncpy(metadata_->format, format, table::Metadata::kFormatMaxLength);
+  format_ = atof(&format[kTableFormatPrefixLen]);
+  image_id_ = next_image_id();
   return true;
 }
 
-table::Index* Table::BuildIndex(const Vocabulary& vocabulary,
+table::Index* Table::BuildIndex(VocabularySource next_vocabulary,
                                 size_t num_syllables) {
   return reinterpret_cast<table::Index*>(
-      BuildHeadIndex(vocabulary, num_syllables));
+      BuildHeadIndex(std::move(next_vocabulary), num_syllables));
 }
 
-table::HeadIndex* Table::BuildHeadIndex(const Vocabulary& vocabulary,
+table::HeadIndex* Table::BuildHeadIndex(VocabularySource next_vocabulary,
                                         size_t num_syllables) {
   auto index = CreateArray<table::HeadIndexNode>(num_syllables);
   if (!index) {
     return NULL;
   }
-  for (const auto& v : vocabulary) {
-    int syllable_id = v.first;
-    auto& node(index->at[syllable_id]);
-    const auto& entries(v.second.entries);
-    if (!BuildEntryList(entries, &node.entries)) {
-      return NULL;
-    }
-    if (v.second.next_level) {
-      Code code;
-      code.push_back(syllable_id);
-      auto next_level_index = BuildTrunkIndex(code, *v.second.next_level);
-      if (!next_level_index) {
+  while (const Vocabulary* vocabulary = next_vocabulary()) {
+    for (const auto& v : *vocabulary) {
+      int syllable_id = v.first;
+      auto& node(index->at[syllable_id]);
+      const auto& entries(v.second.entries);
+      if (!BuildEntryList(entries, &node.entries)) {
         return NULL;
       }
-      node.next_level = reinterpret_cast<table::PhraseIndex*>(next_level_index);
+      if (v.second.next_level) {
+        Code code;
+        code.push_back(syllable_id);
+        auto next_level_index = BuildTrunkIndex(code, *v.second.next_level);
+        if (!next_level_index) {
+          return NULL;
+        }
+        node.next_level =
+            reinterpret_cast<table::PhraseIndex*>(next_level_index);
+      }
     }
   }
   return index;
 }
 
-table::TrunkIndex* Table::BuildTrunkIndex(const Code& prefix,
-                                          const Vocabulary& vocabulary) {
-  auto index = CreateArray<table::TrunkIndexNode>(vocabulary.size());
+bool Table::BuildSyllableFilter() {
+  vector<uint8_t> bits((index_->size + 7) / 8);
+  for (size_t i = 0; i < index_->size; ++i) {
+    const auto& node = index_->at[i];
+    if (node.entries.size > 0 || node.next_level)
+      bits[i >> 3] |= 1 << (i & 7);
+  }
+  if (bits.empty())
+    return true;
+  auto filter = Allocate<uint8_t>(bits.size());
+  if (!filter)
+    return false;
+  std::copy(bits.begin(), bits.end(), filter);
+  metadata_->syllable_filter_offset =
+      reinterpret_cast<char*>(filter) - address();
+  metadata_->syllable_filter_size = bits.size();
+  return true;
+}
+
+table::CodeTrie* Table::BuildCodeTrie(const Syllabary& syllabary) {
+  // the codes starting with a prefix have consecutive syllable ids, as the
+  // syllabary is sorted.
+  map<string, pair<SyllableId, SyllableId>> prefixes;
+  vector<size_t> code_lengths;
+  code_lengths.reserve(syllabary.size());
+  SyllableId syllable_id = 0;
+  for (const string& code : syllabary) {
+    size_t max_length = (std::min)(code.length(),
+                                   table::kMaxCodeTriePrefixLength);
+    for (size_t length = 1; length <= max_length; ++length) {
+      auto& range = prefixes.emplace(code.substr(0, length),
+                                     make_pair(syllable_id, syllable_id))
+                        .first->second;
+      range.second = syllable_id + 1;
+    }
+    code_lengths.push_back(code.length());
+    ++syllable_id;
+  }
+  auto trie = CreateArray<table::CodeTrieNode>(prefixes.size());
+  if (!trie)
+    return nullptr;
+  TableQuery query(index_, true, nullptr, compact_entries_);
+  vector<table::RankedEntry> ranked;
+  size_t i = 0;
+  for (const auto& prefix : prefixes) {
+    auto& node = trie->at[i++];
+    if (!CopyString(prefix.first, &node.prefix))
+      return nullptr;
+    node.num_codes = prefix.second.second - prefix.second.first;
+    ranked.clear();
+    for (SyllableId id = prefix.second.first; id < prefix.second.second;
+         ++id) {
+      for (TableAccessor a = query.Access(id); !a.exhausted(); a.Next()) {
+        ranked.push_back({id, *a.entry_text(), a.entry_weight()});
+      }
+    }
+    // entries of the same code keep their order.
+    std::stable_sort(ranked.begin(), ranked.end(),
+                     [&code_lengths](const table::RankedEntry& x,
+                                     const table::RankedEntry& y) {
+                       size_t x_length = code_lengths[x.syllable_id];
+                       size_t y_length = code_lengths[y.syllable_id];
+                       if (x_length != y_length)
+                         return x_length < y_length;
+                       return x.weight > y.weight;
+                     });
+    node.entries.size = ranked.size();
+    node.entries.at = Allocate<table::RankedEntry>(ranked.size());
+    if (!node.entries.at)
+      return nullptr;
+    std::copy(ranked.begin(), ranked.end(), node.entries.at.get());
+  }
+  return trie;
+}
+
+table::FlatTrunkIndex* Table::BuildTrunkIndex(const Code& prefix,
+                                              const Vocabulary& vocabulary) {
+  size_t num_keys = vocabulary.size();
+  // the struct holds the first key.
+  size_t num_bytes = sizeof(table::FlatTrunkIndex) +
+                     sizeof(SyllableId) * (num_keys ? num_keys - 1 : 0);
+  auto index = reinterpret_cast<table::FlatTrunkIndex*>(
+      Allocate<char>(num_bytes));
   if (!index) {
     return NULL;
   }
+  index->size = num_keys;
+  index->nodes = Allocate<table::IndexNode>(num_keys);
+  if (!index->nodes) {
+    return NULL;
+  }
   size_t count = 0;
   for (const auto& v : vocabulary) {
     int syllable_id = v.first;
-    auto& node(index->at[count++]);
-    node.key = syllable_id;
+    index->keys[count] = syllable_id;
+    auto& node(index->nodes[count++]);
     const auto& entries(v.second.entries);
     if (!BuildEntryList(entries, &node.entries)) {
       return NULL;
@@ -490,6 +896,8 @@ bool Table::BuildEntryList(const ShortDictEntryList& src,
                            List<table::Entry>* dest) {
   if (!dest)
     return false;
+  if (compact_entries_)
+    return BuildCompactEntryList(src, dest);
   dest->size = src.size();
   dest->at = Allocate<table::Entry>(src.size());
   if (!dest->at) {
@@ -504,6 +912,34 @@ bool Table::BuildEntryList(const ShortDictEntryList& src,
   return true;
 }
 
+bool Table::BuildCompactEntryList(const ShortDictEntryList& src,
+                                  List<table::Entry>* dest) {
+  size_t size = src.size();
+  // texts, then weights padded to the size of a text
+  size_t num_texts = size + (size * sizeof(table::QuantizedWeight) +
+                             sizeof(table::StringType) - 1) /
+                                sizeof(table::StringType);
+  auto texts = Allocate<table::StringType>(num_texts);
+  if (!texts) {
+    LOG(ERROR) << "Error creating table entries; file size: " << file_size();
+    return false;
+  }
+  dest->size = size;
+  dest->at = reinterpret_cast<table::Entry*>(texts);
+  auto weights = reinterpret_cast<table::QuantizedWeight*>(texts + size);
+  size_t i = 0;
+  for (auto d = src.begin(); d != src.end(); ++d, ++i) {
+    if (!AddString((*d)->text, &texts[i], (*d)->weight)) {
+      LOG(ERROR) << "Error creating table entry '" << (*d)->text
+                 << "'; file size: " << file_size();
+      return false;
+    }
+    weights[i] =
+        table::QuantizeWeight(static_cast<table::Weight>((*d)->weight));
+  }
+  return true;
+}
+
 bool Table::BuildEntry(const ShortDictEntry& dict_entry, table::Entry* entry) {
   if (!entry)
     return false;
@@ -516,6 +952,21 @@ bool Table::BuildEntry(const ShortDictEntry& dict_entry, table::Entry* entry) {
   return true;
 }
 
+bool Table::LoadSyllableFilter() {
+  std::ifstream in(file_path(), std::ios::binary);
+  table::Metadata metadata;
+  if (!in.read(reinterpret_cast<char*>(&metadata), sizeof(metadata)) ||
+      strncmp(metadata.format, kTableFormatPrefix, kTableFormatPrefixLen) ||
+      metadata.syllable_filter_size == 0)
+    return false;
+  vector<uint8_t> filter(metadata.syllable_filter_size);
+  if (!in.seekg(metadata.syllable_filter_offset) ||
+      !in.read(reinterpret_cast<char*>(filter.data()), filter.size()))
+    return false;
+  syllable_filter_.swap(filter);
+  return true;
+}
+
 bool Table::GetSyllabary(Syllabary* result) {
   if (!result || !syllabary_)
     return false;
@@ -524,6 +975,27 @@ bool Table::GetSyllabary(Syllabary* result) {
   }
   return true;
 }
+an<const DenseSyllabary> Table::dense_syllabary() {
+  std::lock_guard<std::mutex> lock(dense_syllabary_mutex_);
+  if (!dense_syllabary_ && syllabary_) {
+    vector<string> spellings;
+    spellings.reserve(syllabary_->size);
+    for (size_t i = 0; i < syllabary_->size; ++i) {
+      spellings.push_back(GetString(syllabary_->at[i]));
+    }
+    dense_syllabary_ = New<DenseSyllabary>(std::move(spellings));
+  }
+  return dense_syllabary_;
+}
+
+void Table::WarmUp() {
+  if (!index_)
+    return;
+  dense_syllabary();
+  TouchPages(index_->at, index_->size * sizeof(table::HeadIndexNode));
+  TouchPages(metadata_->string_table.get(), metadata_->string_table_size);
+}
+
 string Table::GetSyllableById(SyllableId syllable_id) {
   if (!syllabary_ || syllable_id < 0 ||
       syllable_id >= static_cast<SyllableId>(syllabary_->size))
@@ -532,14 +1004,16 @@ string Table::GetSyllableById(SyllableId syllable_id) {
 }
 
 TableAccessor Table::QueryWords(SyllableId syllable_id) {
-  TableQuery query(index_);
+  TableQuery query(index_, has_flat_trunk_index(), nullptr,
+                   has_compact_entries());
   return query.Access(syllable_id);
 }
 
 TableAccessor Table::QueryPhrases(const Code& code) {
   if (code.empty())
     return TableAccessor();
-  TableQuery query(index_);
+  TableQuery query(index_, has_flat_trunk_index(), nullptr,
+                   has_compact_entries());
   for (size_t i = 0; i < Code::kIndexCodeMaxLength; ++i) {
     if (code.size() == i + 1)
       return query.Access(code[i]);
@@ -551,12 +1025,17 @@ TableAccessor Table::QueryPhrases(const Code& code) {
 
 bool Table::Query(const SyllableGraph& syll_graph,
                   size_t start_pos,
-                  TableQueryResult* result) {
+                  TableQueryResult* result,
+                  TableQueryCache* cache) {
   if (!result || !index_ || start_pos >= syll_graph.interpreted_length)
     return false;
   result->clear();
+  if (cache) {
+    cache->Validate(image_id_);
+  }
   std::queue<pair<size_t, TableQuery>> q;
-  TableQuery initial_state(index_);
+  TableQuery initial_state(index_, has_flat_trunk_index(), cache,
+                           has_compact_entries());
   q.push({start_pos, initial_state});
   while (!q.empty()) {
     size_t current_pos = q.front().first;
@@ -569,6 +1048,7 @@ bool Table::Query(const SyllableGraph& syll_graph,
     if (query.level() == Code::kIndexCodeMaxLength) {
       TableAccessor accessor(query.Access(-1));
       if (!accessor.exhausted()) {
+        accessor.set_is_correction(query.is_correction());
         (*result)[current_pos].push_back(accessor);
       }
       continue;
@@ -580,9 +1060,12 @@ bool Table::Query(const SyllableGraph& syll_graph,
         size_t end_pos = props->end_pos;
         if (!accessor.exhausted()) {
           (*result)[end_pos].push_back(accessor);
+          (*result)[end_pos].back().set_is_correction(query.is_correction() ||
+                                                      props->is_correction);
         }
         if (end_pos < syll_graph.interpreted_length &&
-            query.Advance(syll_id, props->credibility)) {
+            query.Advance(syll_id, props->credibility,
+                          props->is_correction)) {
           q.push({end_pos, query});
           query.Backdate();
         }
@@ -596,4 +1079,8 @@ string Table::GetEntryText(const table::Entry& entry) {
   return GetString(entry.text);
 }
 
+string Table::GetEntryText(const table::StringType& text) {
+  return GetString(text);
+}
+
 }  // namespace rime
@@ -8,7 +8,9 @@
 #ifndef RIME_TABLE_H_
 #define RIME_TABLE_H_
 
+#include <cmath>
 #include <cstring>
+#include <mutex>
 #include <rime/common.h>
 #include <rime/dict/mapped_file.h>
 #include <rime/dict/vocabulary.h>
@@ -52,6 +54,24 @@ struct Entry {
   Weight weight;
 };
 
+// v6: the entries of an index node can be stored in two columns instead,
+// texts followed by log-scale weights quantized to 16 bits, so that ranking
+// the entries reads only the weights.
+using QuantizedWeight = uint16_t;
+
+const Weight kMinQuantizedWeight = -40.0f;  // below log(DBL_EPSILON)
+const Weight kQuantizedWeightScale = 1024.0f;  // steps per unit of weight
+
+inline QuantizedWeight QuantizeWeight(Weight weight) {
+  Weight q =
+      std::round((weight - kMinQuantizedWeight) * kQuantizedWeightScale);
+  return q <= 0.0f ? 0 : q >= 65535.0f ? 65535 : QuantizedWeight(q);
+}
+
+inline Weight DequantizeWeight(QuantizedWeight q) {
+  return kMinQuantizedWeight + q / kQuantizedWeightScale;
+}
+
 struct LongEntry {
   Code extra_code;
   Entry entry;
@@ -59,31 +79,70 @@ struct LongEntry {
 
 struct PhraseIndex;
 
-struct HeadIndexNode {
+struct IndexNode {
+  // in a table with compact entries, points to the columns of texts and
+  // quantized weights.
   List<Entry> entries;
   OffsetPtr<PhraseIndex> next_level;
 };
 
+using HeadIndexNode = IndexNode;
+
 using HeadIndex = Array<HeadIndexNode>;
 
+// v4
 struct TrunkIndexNode {
   SyllableId key;
-  List<Entry> entries;
-  OffsetPtr<PhraseIndex> next_level;
+  IndexNode node;
 };
 
 using TrunkIndex = Array<TrunkIndexNode>;
 
+// v5: sorted keys of a trunk level are stored contiguously, apart from
+// the nodes, so that looking up a key does not touch any entry data.
+struct FlatTrunkIndex {
+  uint32_t size;
+  OffsetPtr<IndexNode> nodes;
+  SyllableId keys[1];
+  const SyllableId* keys_begin() const { return &keys[0]; }
+  const SyllableId* keys_end() const { return &keys[0] + size; }
+};
+
 using TailIndex = Array<LongEntry>;
 
 // union PhraseIndex {
 //   TrunkIndex trunk;
+//   FlatTrunkIndex flat_trunk;
 //   TailIndex tail;
 // };
 RIME_TABLE_UNION(PhraseIndex, Array<char>, TrunkIndex, trunk, TailIndex, tail);
 
 using Index = HeadIndex;
 
+// v6.1: a table of codes, in which every entry is of one syllable, also
+// ranks the entries completing each short prefix of the codes, in the
+// order of a predictive lookup: by the length of the code, then by weight.
+// the completions of a prefix are then read from one list, rather than
+// from the index node of each code.
+struct RankedEntry {
+  SyllableId syllable_id;
+  StringType text;
+  Weight weight;
+};
+
+struct CodeTrieNode {
+  String prefix;
+  // the number of codes starting with the prefix.
+  uint32_t num_codes;
+  List<RankedEntry> entries;
+};
+
+// the nodes of the prefixes up to kMaxCodeTriePrefixLength characters, in
+// the order of a depth-first walk of the trie.
+using CodeTrie = Array<CodeTrieNode>;
+
+const size_t kMaxCodeTriePrefixLength = 2;
+
 struct Metadata {
   static const int kFormatMaxLength = 32;
   char format[kFormatMaxLength];
@@ -92,11 +151,16 @@ struct Metadata {
   uint32_t num_entries;
   OffsetPtr<Syllabary> syllabary;
   OffsetPtr<Index> index;
-  // v2
-  int32_t reserved_1;
-  int32_t reserved_2;
+  // v2: reserved until they located the syllable filter, a bitmap of the
+  // syllables starting any entry, at an offset from the start of the file,
+  // so that it is read without mapping the table. tables built before have
+  // them zeroed.
+  uint32_t syllable_filter_offset;
+  uint32_t syllable_filter_size;
   OffsetPtr<char> string_table;
   uint32_t string_table_size;
+  // v6.1
+  OffsetPtr<CodeTrie> code_trie;
 };
 
 }  // namespace table
@@ -113,38 +177,94 @@ class TableAccessor {
   TableAccessor(const Code& index_code,
                 const table::TailIndex* code_map,
                 double credibility = 0.0);
+  // compact entries, stored in columns.
+  TableAccessor(const Code& index_code,
+                const table::StringType* texts,
+                const table::QuantizedWeight* weights,
+                size_t size,
+                double credibility = 0.0);
 
   RIME_API bool Next();
 
   RIME_API bool exhausted() const;
   RIME_API size_t remaining() const;
+  // returns null for compact entries; use entry_text() and entry_weight().
   RIME_API const table::Entry* entry() const;
+  RIME_API const table::StringType* entry_text() const;
+  RIME_API table::Weight entry_weight() const;
+  // the column of weights from the current entry on, if entries are compact.
+  const table::QuantizedWeight* quantized_weights() const {
+    return weights_ && cursor_ < size_ ? weights_ + cursor_ : nullptr;
+  }
   RIME_API const table::Code* extra_code() const;
   const Code& index_code() const { return index_code_; }
   Code code() const;
   double credibility() const { return credibility_; }
+  // whether the index code is spelt with a correction in the input.
+  bool is_correction() const { return is_correction_; }
+  void set_is_correction(bool is_correction) { is_correction_ = is_correction; }
 
  private:
   Code index_code_;
   const table::Entry* entries_ = nullptr;
   const table::LongEntry* long_entries_ = nullptr;
+  const table::StringType* texts_ = nullptr;
+  const table::QuantizedWeight* weights_ = nullptr;
   size_t size_ = 0;
   size_t cursor_ = 0;
   double credibility_ = 0.0;
+  bool is_correction_ = false;
 };
 
 using TableQueryResult = map<int, vector<TableAccessor>>;
 
 struct SyllableGraph;
 
+// memoizes nodes found in the trunk index by (parent level, syllable id),
+// so that successive queries of a growing input only search the index
+// for newly added syllables.
+class TableQueryCache {
+ public:
+  static const size_t kMaxSize = 4096;
+
+  // returns true if a result, possibly null, is cached for the key.
+  bool Find(const table::PhraseIndex* index,
+            SyllableId syllable_id,
+            const table::IndexNode** node) const;
+  void Save(const table::PhraseIndex* index,
+            SyllableId syllable_id,
+            const table::IndexNode* node);
+  // drops cached nodes if they do not belong to the loaded table image.
+  void Validate(uint64_t table_image_id);
+  void Clear();
+
+  size_t size() const { return nodes_.size(); }
+
+ private:
+  using Key = pair<const table::PhraseIndex*, SyllableId>;
+  uint64_t table_image_id_ = 0;
+  hash_map<Key, const table::IndexNode*> nodes_;
+};
+
 class TableQuery {
  public:
-  TableQuery(table::Index* index) : lv1_index_(index) { Reset(); }
+  TableQuery(table::Index* index,
+             bool flat_trunk_index = true,
+             TableQueryCache* cache = nullptr,
+             bool compact_entries = false)
+      : lv1_index_(index),
+        flat_trunk_index_(flat_trunk_index),
+        compact_entries_(compact_entries),
+        cache_(cache) {
+    Reset();
+  }
 
   TableAccessor Access(SyllableId syllable_id, double credibility = 0.0) const;
 
   // down to next level
-  bool Advance(SyllableId syllable_id, double credibility = 0.0);
+  bool Advance(SyllableId syllable_id,
+               double credibility = 0.0,
+               bool is_correction = false);
 
   // up one level
   bool Backdate();
@@ -153,23 +273,38 @@ class TableQuery {
   void Reset();
 
   size_t level() const { return level_; }
+  // whether a syllable advanced to is spelt with a correction.
+  bool is_correction() const { return is_correction_.back(); }
 
  protected:
   size_t level_ = 0;
   Code index_code_;
   vector<double> credibility_;
+  vector<bool> is_correction_;
 
  private:
   bool Walk(SyllableId syllable_id);
+  TableAccessor AccessEntries(const Code& index_code,
+                              const List<table::Entry>& entries,
+                              double credibility) const;
+  const table::IndexNode* FindNode(const table::PhraseIndex* index,
+                                   SyllableId syllable_id) const;
 
   table::HeadIndex* lv1_index_ = nullptr;
-  table::TrunkIndex* lv2_index_ = nullptr;
-  table::TrunkIndex* lv3_index_ = nullptr;
+  table::PhraseIndex* lv2_index_ = nullptr;
+  table::PhraseIndex* lv3_index_ = nullptr;
   table::TailIndex* lv4_index_ = nullptr;
+  bool flat_trunk_index_ = true;
+  bool compact_entries_ = false;
+  TableQueryCache* cache_ = nullptr;
 };
 
 class Table : public MappedFile {
  public:
+  // yields the vocabulary of entries sharing the next first syllable, in
+  // ascending order of syllable ids, or null when there is no more.
+  using VocabularySource = function<const Vocabulary*()>;
+
   RIME_API Table(const path& file_path);
   virtual ~Table();
 
@@ -179,32 +314,78 @@ class Table : public MappedFile {
                       const Vocabulary& vocabulary,
                       size_t num_entries,
                       uint32_t dict_file_checksum = 0);
+  // builds the table from vocabularies of one first syllable at a time, so
+  // that the whole vocabulary needs not be kept in memory.
+  RIME_API bool Build(const Syllabary& syllabary,
+                      VocabularySource next_vocabulary,
+                      size_t num_entries,
+                      uint32_t dict_file_checksum = 0);
+
+  // reads the syllable filter of the table from the file, which needs not
+  // be loaded; returns false if the table has none.
+  RIME_API bool LoadSyllableFilter();
+  bool has_syllable_filter() const { return !syllable_filter_.empty(); }
+  // whether the table may have entries starting with the syllable, as far
+  // as the syllable filter tells; true without a filter read.
+  bool MayMatch(SyllableId syllable_id) const {
+    if (syllable_filter_.empty())
+      return true;
+    size_t byte = static_cast<uint32_t>(syllable_id) >> 3;
+    return byte < syllable_filter_.size() &&
+           (syllable_filter_[byte] >> (syllable_id & 7)) & 1;
+  }
 
   bool GetSyllabary(Syllabary* syllabary);
+  // the syllabary of the loaded table, decoded once and shared.
+  RIME_API an<const DenseSyllabary> dense_syllabary();
+  // builds lazy caches and pages in the index and texts of the loaded
+  // table ahead of the first lookup.
+  RIME_API void WarmUp();
   RIME_API string GetSyllableById(int syllable_id);
   RIME_API TableAccessor QueryWords(int syllable_id);
   RIME_API TableAccessor QueryPhrases(const Code& code);
   RIME_API bool Query(const SyllableGraph& syll_graph,
                       size_t start_pos,
-                      TableQueryResult* result);
+                      TableQueryResult* result,
+                      TableQueryCache* cache = nullptr);
   RIME_API string GetEntryText(const table::Entry& entry);
+  RIME_API string GetEntryText(const table::StringType& text);
 
   uint32_t dict_file_checksum() const;
   table::Metadata* metadata() const { return metadata_; }
+  RIME_API bool has_flat_trunk_index() const;
+  RIME_API bool has_compact_entries() const;
+  RIME_API bool has_code_trie() const;
+  // the node of the code trie for a prefix of the codes, or null if the
+  // prefix is longer than the trie or no code starts with it.
+  RIME_API const table::CodeTrieNode* FindCodeTrieNode(
+      const string& prefix) const;
+  // builds the table with compact entries, in format v6; a table of codes
+  // is built with a code trie as well, in format v6.1.
+  void set_compact_entries(bool compact_entries) {
+    compact_entries_ = compact_entries;
+  }
+  // uniquely identifies the table image as loaded or built in this process.
+  uint64_t image_id() const { return image_id_; }
 
  private:
-  table::Index* BuildIndex(const Vocabulary& vocabulary, size_t num_syllables);
-  table::HeadIndex* BuildHeadIndex(const Vocabulary& vocabulary,
+  table::Index* BuildIndex(VocabularySource next_vocabulary,
+                           size_t num_syllables);
+  table::HeadIndex* BuildHeadIndex(VocabularySource next_vocabulary,
                                    size_t num_syllables);
-  table::TrunkIndex* BuildTrunkIndex(const Code& prefix,
-                                     const Vocabulary& vocabulary);
+  table::FlatTrunkIndex* BuildTrunkIndex(const Code& prefix,
+                                         const Vocabulary& vocabulary);
   table::TailIndex* BuildTailIndex(const Code& prefix,
                                    const Vocabulary& vocabulary);
+  table::CodeTrie* BuildCodeTrie(const Syllabary& syllabary);
+  bool BuildSyllableFilter();
   bool BuildPhraseIndex(Code code,
                         const Vocabulary& vocabulary,
                         map<string, int>* index_data);
   Array<table::Entry>* BuildEntryArray(const ShortDictEntryList& entries);
   bool BuildEntryList(const ShortDictEntryList& src, List<table::Entry>* dest);
+  bool BuildCompactEntryList(const ShortDictEntryList& src,
+                             List<table::Entry>* dest);
   bool BuildEntry(const ShortDictEntry& dict_entry, table::Entry* entry);
 
   string GetString(const table::StringType& x);
@@ -214,12 +395,22 @@ class Table : public MappedFile {
   bool OnLoad();
 
  protected:
+  double format_ = 0.0;
+  bool compact_entries_ = false;
+  uint64_t image_id_ = 0;
   table::Metadata* metadata_ = nullptr;
   table::Syllabary* syllabary_ = nullptr;
   table::Index* index_ = nullptr;
+  table::CodeTrie* code_trie_ = nullptr;
 
   the<StringTable> string_table_;
   the<StringTableBuilder> string_table_builder_;
+  std::mutex dense_syllabary_mutex_;
+  an<const DenseSyllabary> dense_syllabary_;
+  // read once, before lookups that may consult it.
+  vector<uint8_t> syllable_filter_;
+  // dropped before the string table it reports on.
+  the<MemoryStatsRegistration> string_table_stats_;
 };
 
 }  // namespace rime
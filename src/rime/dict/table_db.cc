@@ -15,7 +15,7 @@
 
 namespace rime {
 
-static bool rime_table_entry_parser(const Tsv& row,
+static bool rime_table_entry_parser(const TsvFields& row,
                                     string* key,
                                     string* value) {
   if (row.size() < 2 || row[0].empty() || row[1].empty()) {
@@ -23,11 +23,12 @@ static bool rime_table_entry_parser(const Tsv& row,
   }
   string code(row[1]);
   boost::algorithm::trim(code);
-  *key = code + " \t" + row[0];
+  *key = code + " \t";
+  key->append(row[0]);
   UserDbValue v;
   if (row.size() >= 3 && !row[2].empty()) {
     try {
-      v.commits = std::stoi(row[2]);
+      v.commits = std::stoi(string(row[2]));
       const double kS = 1e8;
       v.dee = (v.commits + 1) / kS;
     } catch (...) {
@@ -4,6 +4,9 @@
 //
 // 2013-04-14 GONG Chen <chen.sst@gmail.com>
 //
+#include <filesystem>
+#include <fstream>
+#include <rime/dict/build_cache.h>
 #include <rime/dict/db_utils.h>
 #include <rime/dict/text_db.h>
 
@@ -86,6 +89,7 @@ bool TextDb::Update(const string& key, const string& value) {
   DLOG(INFO) << "update db entry: " << key << " => " << value;
   data_[key] = value;
   modified_ = true;
+  Journal('+', key, value);
   return true;
 }
 
@@ -96,6 +100,7 @@ bool TextDb::Erase(const string& key) {
   if (data_.erase(key) == 0)
     return false;
   modified_ = true;
+  Journal('-', key);
   return true;
 }
 
@@ -104,8 +109,9 @@ bool TextDb::Open() {
     return false;
   loaded_ = true;
   readonly_ = false;
-  loaded_ = !Exists() || LoadFromFile(file_path());
+  loaded_ = (!Exists() || LoadFromFile(file_path())) && ReplayJournal();
   if (loaded_) {
+    journaling_ = true;
     string db_name;
     if (!MetaFetch("/db_name", &db_name)) {
       if (!CreateMetadata()) {
@@ -125,7 +131,7 @@ bool TextDb::OpenReadOnly() {
     return false;
   loaded_ = true;
   readonly_ = false;
-  loaded_ = Exists() && LoadFromFile(file_path());
+  loaded_ = Exists() && LoadFromFile(file_path()) && ReplayJournal();
   if (loaded_) {
     readonly_ = true;
   } else {
@@ -138,16 +144,41 @@ bool TextDb::OpenReadOnly() {
 bool TextDb::Close() {
   if (!loaded())
     return false;
-  if (modified_ && !SaveToFile(file_path())) {
-    return false;
+  bool journaled = false;
+  if (journal_) {
+    journal_->close();
+    journaled = bool(*journal_);
+    journal_.reset();
+  }
+  if (!readonly() && (modified_ || needs_compaction_)) {
+    size_t db_size = metadata_.size() + data_.size();
+    bool compact = !journaled || needs_compaction_ || !Exists() ||
+                   (journal_records_ >= kMinJournalRecords &&
+                    journal_records_ * kCompactionRatio > db_size);
+    if (compact && !Compact()) {
+      return false;
+    }
   }
   loaded_ = false;
   readonly_ = false;
+  journaling_ = false;
+  needs_compaction_ = false;
+  journal_records_ = 0;
   Clear();
   modified_ = false;
   return true;
 }
 
+bool TextDb::Remove() {
+  if (loaded()) {
+    LOG(ERROR) << "attempt to remove opened db '" << name_ << "'.";
+    return false;
+  }
+  std::error_code ec;
+  std::filesystem::remove(journal_path(), ec);
+  return Db::Remove();
+}
+
 void TextDb::Clear() {
   metadata_.clear();
   data_.clear();
@@ -174,6 +205,8 @@ bool TextDb::Restore(const path& snapshot_file) {
     return false;
   }
   modified_ = false;
+  // the journal is of the contents replaced.
+  needs_compaction_ = true;
   return true;
 }
 
@@ -197,6 +230,7 @@ bool TextDb::MetaUpdate(const string& key, const string& value) {
   DLOG(INFO) << "update db metadata: " << key << " => " << value;
   metadata_[key] = value;
   modified_ = true;
+  Journal('@', key, value);
   return true;
 }
 
@@ -205,12 +239,17 @@ bool TextDb::LoadFromFile(const path& file) {
   TsvReader reader(file, format_.parser);
   DbSink sink(this);
   int entries = 0;
+  // the loaded entries are not updates to journal.
+  bool journaling = journaling_;
+  journaling_ = false;
   try {
     entries = reader >> sink;
   } catch (std::exception& ex) {
     LOG(ERROR) << ex.what();
+    journaling_ = journaling;
     return false;
   }
+  journaling_ = journaling;
   DLOG(INFO) << entries << " entries loaded.";
   return true;
 }
@@ -230,4 +269,124 @@ bool TextDb::SaveToFile(const path& file) {
   return true;
 }
 
+// journal records are lines of tab separated fields: an operation, the key
+// and the value, in which tabs, line breaks and backslashes are escaped.
+static void escape_field(const string& field, std::ostream& out) {
+  for (char c : field) {
+    switch (c) {
+      case '\\':
+        out << "\\\\";
+        break;
+      case '\t':
+        out << "\\t";
+        break;
+      case '\n':
+        out << "\\n";
+        break;
+      default:
+        out << c;
+    }
+  }
+}
+
+static bool unescape_fields(const string& line, vector<string>* fields) {
+  fields->assign(1, string());
+  for (size_t i = 0; i < line.length(); ++i) {
+    char c = line[i];
+    if (c == '\t') {
+      fields->emplace_back();
+    } else if (c != '\\') {
+      fields->back() += c;
+    } else if (++i < line.length()) {
+      c = line[i];
+      fields->back() += c == 't' ? '\t' : c == 'n' ? '\n' : c;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+path TextDb::journal_path() const {
+  return path(file_path()).concat(".journal");
+}
+
+bool TextDb::ReplayJournal() {
+  journal_records_ = 0;
+  std::ifstream in(journal_path().c_str());
+  if (!in)
+    return true;
+  string line;
+  vector<string> fields;
+  while (std::getline(in, line)) {
+    // the last record may have been cut short while being written; it is
+    // dropped, and the journal rewritten rather than appended to.
+    if (in.eof()) {
+      needs_compaction_ = true;
+      break;
+    }
+    if (!unescape_fields(line, &fields) || fields.size() != 3 ||
+        fields[0].length() != 1)
+      continue;
+    const string& key = fields[1];
+    switch (fields[0][0]) {
+      case '+':
+        data_[key] = fields[2];
+        break;
+      case '-':
+        data_.erase(key);
+        break;
+      case '@':
+        metadata_[key] = fields[2];
+        break;
+      default:
+        continue;
+    }
+    ++journal_records_;
+  }
+  DLOG(INFO) << journal_records_ << " journal records replayed.";
+  return true;
+}
+
+bool TextDb::Journal(char op, const string& key, const string& value) {
+  if (!journaling_ || needs_compaction_)
+    return false;
+  if (!journal_) {
+    journal_.reset(new std::ofstream(journal_path().c_str(), std::ios::app));
+  }
+  *journal_ << op << '\t';
+  escape_field(key, *journal_);
+  *journal_ << '\t';
+  escape_field(value, *journal_);
+  *journal_ << '\n';
+  if (!*journal_) {
+    LOG(WARNING) << "error writing journal of db '" << name() << "'.";
+    needs_compaction_ = true;
+    return false;
+  }
+  ++journal_records_;
+  return true;
+}
+
+bool TextDb::Compact() {
+  journal_.reset();
+  // the file is replaced as a whole, then the journal it includes.
+  path temp_path = BuildCache::TempFilePath(file_path());
+  std::error_code ec;
+  if (!SaveToFile(temp_path)) {
+    std::filesystem::remove(temp_path, ec);
+    return false;
+  }
+  std::filesystem::rename(temp_path, file_path(), ec);
+  if (ec) {
+    LOG(ERROR) << "error saving db '" << name() << "': " << ec.message();
+    std::filesystem::remove(temp_path, ec);
+    return false;
+  }
+  std::filesystem::remove(journal_path(), ec);
+  journal_records_ = 0;
+  needs_compaction_ = false;
+  return true;
+}
+
 }  // namespace rime
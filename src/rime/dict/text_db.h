@@ -7,6 +7,7 @@
 #ifndef RIME_TEXT_DB_H_
 #define RIME_TEXT_DB_H_
 
+#include <iosfwd>
 #include <rime/dict/db.h>
 #include <rime/dict/tsv.h>
 
@@ -37,6 +38,10 @@ struct TextFormat {
   string file_description;
 };
 
+// Updates to a db opened for writing are appended to a journal next to the
+// file, <file>.journal, which is replayed on top of the file when the db is
+// opened again. The file is rewritten, and the journal discarded, only once
+// the journal has grown large compared to the db.
 class TextDb : public Db {
  public:
   TextDb(const path& file_path,
@@ -48,6 +53,7 @@ class TextDb : public Db {
   RIME_API bool Open() override;
   RIME_API bool OpenReadOnly() override;
   RIME_API bool Close() override;
+  RIME_API bool Remove() override;
 
   RIME_API bool Backup(const path& snapshot_file) override;
   RIME_API bool Restore(const path& snapshot_file) override;
@@ -67,12 +73,30 @@ class TextDb : public Db {
   void Clear();
   bool LoadFromFile(const path& file);
   bool SaveToFile(const path& file);
+  path journal_path() const;
+  bool ReplayJournal();
+  // returns false if the update could not be journaled.
+  bool Journal(char op, const string& key, const string& value = string());
+  // rewrites the file with the contents of the db and discards the journal.
+  bool Compact();
+
+  // a journal has this many records at least before it is compacted.
+  static const size_t kMinJournalRecords = 1024;
+  // ... and holds more records than 1/kCompactionRatio of the db.
+  static const size_t kCompactionRatio = 4;
 
   string db_type_;
   TextFormat format_;
   TextDbData metadata_;
   TextDbData data_;
   bool modified_ = false;
+  // whether updates are journaled; off while the db is being loaded.
+  bool journaling_ = false;
+  // the contents of the db may differ from the file and its journal, which
+  // must be rewritten.
+  bool needs_compaction_ = false;
+  size_t journal_records_ = 0;
+  the<std::ofstream> journal_;
 };
 
 }  // namespace rime
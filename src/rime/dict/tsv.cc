@@ -4,37 +4,111 @@
 //
 // 2013-04-14 GONG Chen <chen.sst@gmail.com>
 //
+#include <cctype>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <boost/algorithm/string.hpp>
 #include <rime/common.h>
 #include <rime/dict/db_utils.h>
+#include <rime/dict/mapped_file.h>
 #include <rime/dict/tsv.h>
 
 namespace rime {
 
+class MappedTextFile : public MappedFile {
+ public:
+  explicit MappedTextFile(const path& file_path) : MappedFile(file_path) {}
+  using MappedFile::address;
+  using MappedFile::OpenReadOnly;
+};
+
+TsvLineReader::TsvLineReader(const path& file_path) : file_path_(file_path) {}
+
+TsvLineReader::~TsvLineReader() {}
+
+bool TsvLineReader::Open() {
+  std::error_code ec;
+  auto file_size = std::filesystem::file_size(file_path_, ec);
+  if (ec) {
+    LOG(ERROR) << "error reading file '" << file_path_ << "'.";
+    return false;
+  }
+  line_number_ = 0;
+  if (file_size == 0) {  // there is nothing to map.
+    pos_ = end_ = nullptr;
+    return true;
+  }
+  file_.reset(new MappedTextFile(file_path_));
+  try {
+    if (!file_->OpenReadOnly()) {
+      file_.reset();
+      return false;
+    }
+  } catch (const std::exception& ex) {
+    LOG(ERROR) << "error mapping file '" << file_path_ << "': " << ex.what();
+    file_.reset();
+    return false;
+  }
+  pos_ = file_->address();
+  end_ = pos_ + file_->file_size();
+  return true;
+}
+
+bool TsvLineReader::ReadLine(std::string_view* line) {
+  if (pos_ == end_)
+    return false;
+  const char* eol =
+      static_cast<const char*>(std::memchr(pos_, '\n', end_ - pos_));
+  if (!eol)
+    eol = end_;
+  const char* begin = pos_;
+  pos_ = eol != end_ ? eol + 1 : end_;
+  while (eol != begin && std::isspace(static_cast<unsigned char>(eol[-1])))
+    --eol;
+  *line = std::string_view(begin, eol - begin);
+  ++line_number_;
+  return true;
+}
+
+void TsvLineReader::Split(std::string_view line, TsvFields* fields) {
+  fields->clear();
+  size_t start = 0;
+  while (true) {
+    size_t tab = line.find('\t', start);
+    if (tab == std::string_view::npos) {
+      fields->push_back(line.substr(start));
+      return;
+    }
+    fields->push_back(line.substr(start, tab - start));
+    start = tab + 1;
+  }
+}
+
 int TsvReader::operator()(Sink* sink) {
   if (!sink)
     return 0;
   LOG(INFO) << "reading tsv file: " << file_path_;
-  std::ifstream fin(file_path_.c_str());
-  string line, key, value;
-  Tsv row;
-  int line_no = 0;
+  TsvLineReader reader(file_path_);
+  if (!reader.Open()) {
+    return 0;
+  }
+  std::string_view line;
+  string key, value;
+  TsvFields row;
   int num_entries = 0;
   bool enable_comment = true;
-  while (getline(fin, line)) {
-    ++line_no;
-    boost::algorithm::trim_right(line);
+  while (reader.ReadLine(&line)) {
     // skip empty lines and comments
     if (line.empty())
       continue;
     if (enable_comment && line[0] == '#') {
       if (boost::starts_with(line, "#@")) {
         // metadata
-        line.erase(0, 2);
-        boost::algorithm::split(row, line, boost::algorithm::is_any_of("\t"));
-        if (row.size() != 2 || !sink->MetaPut(row[0], row[1])) {
-          LOG(WARNING) << "invalid metadata at line " << line_no
+        TsvLineReader::Split(line.substr(2), &row);
+        if (row.size() != 2 ||
+            !sink->MetaPut(string(row[0]), string(row[1]))) {
+          LOG(WARNING) << "invalid metadata at line " << reader.line_number()
                        << " in file: " << file_path_ << ".";
         }
       } else if (line == "# no comment") {
@@ -44,15 +118,15 @@ int TsvReader::operator()(Sink* sink) {
       continue;
     }
     // read a tsv entry
-    boost::algorithm::split(row, line, boost::algorithm::is_any_of("\t"));
+    TsvLineReader::Split(line, &row);
     if (!parser_(row, &key, &value) || !sink->Put(key, value)) {
-      LOG(WARNING) << "invalid entry at line " << line_no
+      LOG(WARNING) << "invalid entry at line " << reader.line_number()
                    << " in file: " << file_path_ << ".";
       continue;
     }
-    ++num_entries;
+    if (++num_entries % kProgressInterval == 0 && progress)
+      progress(num_entries);
   }
-  fin.close();
   return num_entries;
 }
 
@@ -60,13 +134,16 @@ int TsvWriter::operator()(Source* source) {
   if (!source)
     return 0;
   LOG(INFO) << "writing tsv file: " << file_path_;
-  std::ofstream fout(file_path_.c_str());
+  vector<char> buffer(kBufferSize);
+  std::ofstream fout;
+  fout.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+  fout.open(file_path_.c_str());
   if (!file_description.empty()) {
-    fout << "# " << file_description << std::endl;
+    fout << "# " << file_description << '\n';
   }
   string key, value;
   while (source->MetaGet(&key, &value)) {
-    fout << "#@" << key << '\t' << value << std::endl;
+    fout << "#@" << key << '\t' << value << '\n';
   }
   Tsv row;
   int num_entries = 0;
@@ -78,8 +155,9 @@ int TsvWriter::operator()(Source* source) {
           fout << '\t';
         fout << *it;
       }
-      fout << std::endl;
-      ++num_entries;
+      fout << '\n';
+      if (++num_entries % kProgressInterval == 0 && progress)
+        progress(num_entries);
     }
   }
   fout.close();
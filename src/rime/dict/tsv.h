@@ -7,19 +7,52 @@
 #ifndef RIME_TSV_H_
 #define RIME_TSV_H_
 
+#include <string_view>
 #include <rime/common.h>
 
 namespace rime {
 
 using Tsv = vector<string>;
 
-using TsvParser = function<bool(const Tsv& row, string* key, string* value)>;
+// fields of a line, referring to the text read by a TsvLineReader.
+using TsvFields = vector<std::string_view>;
+
+using TsvParser =
+    function<bool(const TsvFields& row, string* key, string* value)>;
 
 using TsvFormatter =
     function<bool(const string& key, const string& value, Tsv* row)>;
 
+// called with the number of records read or written so far.
+using TsvProgress = function<void(int num_entries)>;
+
 class Sink;
 class Source;
+class MappedTextFile;
+
+// reads lines of a text file mapped into memory, without copying them.
+// the lines are valid as long as the reader is.
+class TsvLineReader {
+ public:
+  explicit TsvLineReader(const path& file_path);
+  ~TsvLineReader();
+
+  bool Open();
+  // reads the next line, with trailing white space trimmed.
+  bool ReadLine(std::string_view* line);
+  // the number of the last line read, starting from 1.
+  int line_number() const { return line_number_; }
+
+  // splits a line into tab separated fields.
+  static void Split(std::string_view line, TsvFields* fields);
+
+ protected:
+  path file_path_;
+  the<MappedTextFile> file_;
+  const char* pos_ = nullptr;
+  const char* end_ = nullptr;
+  int line_number_ = 0;
+};
 
 class TsvReader {
  public:
@@ -31,6 +64,11 @@ class TsvReader {
  protected:
   path file_path_;
   TsvParser parser_;
+
+ public:
+  // reported every kProgressInterval records, if set.
+  TsvProgress progress;
+  static const int kProgressInterval = 10000;
 };
 
 class TsvWriter {
@@ -46,6 +84,11 @@ class TsvWriter {
 
  public:
   string file_description;
+  // reported every kProgressInterval records, if set.
+  TsvProgress progress;
+  static const int kProgressInterval = 10000;
+  // the file is written in blocks of this size.
+  static const size_t kBufferSize = 1 << 20;
 };
 
 template <class SinkType>
@@ -4,10 +4,17 @@
 //
 // 2011-11-02 GONG Chen <chen.sst@gmail.com>
 //
+#include <algorithm>
+#include <cerrno>
 #include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <queue>
 #include <sstream>
 #include <boost/algorithm/string.hpp>
 #include <rime/service.h>
+#include <rime/worker_pool.h>
 #include <rime/algo/dynamics.h>
 #include <rime/dict/text_db.h>
 #include <rime/dict/user_db.h>
@@ -24,26 +31,113 @@ string UserDbValue::Pack() const {
   return packed.str();
 }
 
+// binary encoding, version 1:
+//   '\0' '\x01' varint(zigzag(commits)) float32(dee) varint(tick)
+// text values never begin with a null character.
+static const char kBinaryValueVersion = '\x01';
+
+static void put_varint(uint64_t x, string* out) {
+  while (x >= 0x80) {
+    out->push_back(static_cast<char>((x & 0x7f) | 0x80));
+    x >>= 7;
+  }
+  out->push_back(static_cast<char>(x));
+}
+
+static bool get_varint(const char*& p, const char* end, uint64_t* x) {
+  *x = 0;
+  for (int shift = 0; p < end && shift < 64; shift += 7) {
+    uint8_t byte = static_cast<uint8_t>(*p++);
+    *x |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+  return false;
+}
+
+string UserDbValue::PackBinary() const {
+  string packed{'\0', kBinaryValueVersion};
+  int64_t c = commits;
+  put_varint((static_cast<uint64_t>(c) << 1) ^ static_cast<uint64_t>(c >> 63),
+             &packed);
+  float d = static_cast<float>(dee);
+  uint32_t bits;
+  std::memcpy(&bits, &d, sizeof(bits));
+  for (int i = 0; i < 4; ++i) {  // little endian
+    packed.push_back(static_cast<char>(bits >> (8 * i)));
+  }
+  put_varint(tick, &packed);
+  return packed;
+}
+
+string UserDbValue::PackFor(const Db* db) const {
+  return db && db->binary_safe() ? PackBinary() : Pack();
+}
+
+bool UserDbValue::IsBinary(const string& value) {
+  return value.length() >= 2 && value[0] == '\0';
+}
+
+static bool unpack_binary(const string& value, UserDbValue* v) {
+  if (value[1] != kBinaryValueVersion) {
+    LOG(ERROR) << "unknown version of binary userdb value: " << int(value[1]);
+    return false;
+  }
+  const char* p = value.data() + 2;
+  const char* end = value.data() + value.length();
+  uint64_t c;
+  if (!get_varint(p, end, &c) || end - p < 4)
+    return false;
+  uint32_t bits = 0;
+  for (int i = 0; i < 4; ++i) {
+    bits |= static_cast<uint32_t>(static_cast<uint8_t>(*p++)) << (8 * i);
+  }
+  float d;
+  std::memcpy(&d, &bits, sizeof(d));
+  uint64_t t;
+  if (!get_varint(p, end, &t))
+    return false;
+  v->commits = static_cast<int>(static_cast<int64_t>(c >> 1) ^
+                                -static_cast<int64_t>(c & 1));
+  v->dee = (std::min)(10000.0, static_cast<double>(d));
+  v->tick = t;
+  return true;
+}
+
 bool UserDbValue::Unpack(const string& value) {
-  vector<string> kv;
-  boost::split(kv, value, boost::is_any_of(" "));
-  for (const string& k_eq_v : kv) {
-    size_t eq = k_eq_v.find('=');
-    if (eq == string::npos)
+  if (IsBinary(value)) {
+    return unpack_binary(value, this);
+  }
+  const char* p = value.c_str();
+  while (*p) {
+    const char* token = p;
+    while (*p && *p != ' ')
+      ++p;
+    const char* token_end = p;
+    if (*p)
+      ++p;
+    const char* eq = std::find(token, token_end, '=');
+    if (eq == token_end || eq - token != 1)
       continue;
-    string k(k_eq_v.substr(0, eq));
-    string v(k_eq_v.substr(eq + 1));
-    try {
-      if (k == "c") {
-        commits = std::stoi(v);
-      } else if (k == "d") {
-        dee = (std::min)(10000.0, std::stod(v));
-      } else if (k == "t") {
-        tick = std::stoul(v);
-      }
-    } catch (...) {
-      LOG(ERROR) << "failed in parsing key-value from userdb entry '" << k_eq_v
-                 << "'.";
+    const char* v = eq + 1;
+    char* parsed_end = nullptr;
+    errno = 0;
+    switch (*token) {
+      case 'c':
+        commits = static_cast<int>(std::strtol(v, &parsed_end, 10));
+        break;
+      case 'd':
+        dee = (std::min)(10000.0, std::strtod(v, &parsed_end));
+        break;
+      case 't':
+        tick = std::strtoull(v, &parsed_end, 10);
+        break;
+      default:
+        continue;
+    }
+    if (parsed_end == v || errno == ERANGE) {
+      LOG(ERROR) << "failed in parsing key-value from userdb entry '"
+                 << string(token, token_end) << "'.";
       return false;
     }
   }
@@ -61,9 +155,15 @@ string UserDb::snapshot_extension() {
   return plain_userdb_extension;
 }
 
+string UserDb::delta_snapshot_extension() {
+  return ".userdb.delta.txt";
+}
+
 // key ::= code <space> <Tab> phrase
 
-static bool userdb_entry_parser(const Tsv& row, string* key, string* value) {
+static bool userdb_entry_parser(const TsvFields& row,
+                                string* key,
+                                string* value) {
   if (row.size() < 2 || row[0].empty() || row[1].empty()) {
     return false;
   }
@@ -71,7 +171,8 @@ static bool userdb_entry_parser(const Tsv& row, string* key, string* value) {
   // fix invalid keys created by a buggy version
   if (code[code.length() - 1] != ' ')
     code += ' ';
-  *key = code + "\t" + row[1];
+  *key = code + "\t";
+  key->append(row[1]);
   if (row.size() >= 3)
     *value = row[2];
   else
@@ -86,7 +187,9 @@ static bool userdb_entry_formatter(const string& key,
   boost::algorithm::split(row, key, boost::algorithm::is_any_of("\t"));
   if (row.size() != 2 || row[0].empty() || row[1].empty())
     return false;
-  row.push_back(value);
+  // snapshots keep the text encoding
+  row.push_back(UserDbValue::IsBinary(value) ? UserDbValue(value).Pack()
+                                             : value);
   return true;
 }
 
@@ -125,17 +228,176 @@ bool UserDbHelper::UniformBackup(const path& snapshot_file) {
   return true;
 }
 
+// writes the entries as they are, in transactions of batch_size entries
+// where the db supports them.
+class BatchedDbSink : public DbSink {
+ public:
+  BatchedDbSink(Db* db, size_t batch_size)
+      : DbSink(db),
+        transactional_(dynamic_cast<Transactional*>(db)),
+        max_batch_size_(batch_size) {}
+  ~BatchedDbSink() override { Commit(); }
+
+  bool Put(const string& key, const string& value) override {
+    if (transactional_ && !transactional_->in_transaction())
+      transactional_->BeginTransaction();
+    bool updated = DbSink::Put(key, value);
+    if (transactional_ && ++batch_size_ >= max_batch_size_)
+      Commit();
+    return updated;
+  }
+
+  void Commit() {
+    if (transactional_ && transactional_->in_transaction())
+      transactional_->CommitTransaction();
+    batch_size_ = 0;
+  }
+
+ private:
+  Transactional* transactional_;
+  size_t max_batch_size_;
+  size_t batch_size_ = 0;
+};
+
 bool UserDbHelper::UniformRestore(const path& snapshot_file) {
   LOG(INFO) << "restoring userdb '" << db_->name() << "' from "
             << snapshot_file;
   TsvReader reader(snapshot_file, plain_userdb_format.parser);
-  DbSink sink(db_);
+  BatchedDbSink sink(db_, UserDbSyncMerger::kBatchSize);
   try {
     reader >> sink;
   } catch (std::exception& ex) {
     LOG(ERROR) << ex.what();
     return false;
   }
+  sink.Commit();
+  return true;
+}
+
+static TickCount get_tick_count(Db* db) {
+  string tick;
+  if (db && db->MetaFetch("/tick", &tick)) {
+    try {
+      return std::stoul(tick);
+    } catch (...) {
+    }
+  }
+  return 1;
+}
+
+static TickCount parse_tick(const string& tick) {
+  try {
+    return std::stoul(tick);
+  } catch (...) {
+    return 0;
+  }
+}
+
+// reads the metadata lines at the head of a snapshot file.
+static map<string, string> read_snapshot_metadata(const path& snapshot_file) {
+  map<string, string> metadata;
+  std::ifstream fin(snapshot_file.c_str());
+  string line;
+  while (getline(fin, line)) {
+    boost::algorithm::trim_right(line);
+    if (line.empty())
+      continue;
+    if (line[0] != '#')
+      break;
+    if (!boost::starts_with(line, "#@"))
+      continue;
+    size_t separator_pos = line.find('\t');
+    if (separator_pos == string::npos)
+      continue;
+    metadata[line.substr(2, separator_pos - 2)] =
+        line.substr(separator_pos + 1);
+  }
+  return metadata;
+}
+
+// the entries of a db updated after the tick of the base snapshot.
+class DeltaSource : public DbSource {
+ public:
+  DeltaSource(Db* db, TickCount base_tick)
+      : DbSource(db), base_tick_(base_tick) {}
+
+  bool MetaGet(string* key, string* value) override {
+    if (DbSource::MetaGet(key, value))
+      return true;
+    if (base_tick_written_)
+      return false;
+    *key = kDeltaBaseKey;
+    *value = std::to_string(base_tick_);
+    base_tick_written_ = true;
+    return true;
+  }
+  bool Get(string* key, string* value) override {
+    while (DbSource::Get(key, value)) {
+      if (UserDbValue(*value).tick > base_tick_)
+        return true;
+    }
+    return false;
+  }
+
+  static const char* kDeltaBaseKey;
+
+ private:
+  TickCount base_tick_;
+  bool base_tick_written_ = false;
+};
+
+const char* DeltaSource::kDeltaBaseKey = "/delta_base";
+
+// a full snapshot is written when the delta would hold more than this share
+// of the entries.
+static const int kCompactionRatio = 4;
+
+bool UserDbHelper::IncrementalBackup(const path& snapshot_file,
+                                     const path& delta_file) {
+  TickCount tick = get_tick_count(db_);
+  TickCount base_tick = 0;
+  if (std::filesystem::exists(snapshot_file)) {
+    auto base = read_snapshot_metadata(snapshot_file);
+    if (base["/db_name"] == db_->name() && base["/user_id"] == GetUserId())
+      base_tick = parse_tick(base["/tick"]);
+  }
+  bool compact = base_tick == 0 || base_tick > tick;
+  if (!compact) {
+    if (base_tick == tick) {
+      // nothing changed since the base snapshot; any delta is empty or stale.
+      if (std::filesystem::exists(delta_file))
+        std::filesystem::remove(delta_file);
+      return true;
+    }
+    int num_entries = 0;
+    int num_delta_entries = 0;
+    auto accessor = db_->QueryAll();
+    string key, value;
+    while (accessor && accessor->GetNextRecord(&key, &value)) {
+      ++num_entries;
+      if (UserDbValue(value).tick > base_tick)
+        ++num_delta_entries;
+    }
+    compact = num_delta_entries * kCompactionRatio > num_entries;
+  }
+  if (compact) {
+    if (!UniformBackup(snapshot_file))
+      return false;
+    if (std::filesystem::exists(delta_file))
+      std::filesystem::remove(delta_file);
+    return true;
+  }
+  LOG(INFO) << "backing up changes to userdb '" << db_->name()
+            << "' since tick " << base_tick << " to " << delta_file;
+  TsvWriter writer(delta_file, plain_userdb_format.formatter);
+  writer.file_description = plain_userdb_format.file_description;
+  DeltaSource source(db_, base_tick);
+  try {
+    writer << source;
+  } catch (std::exception& ex) {
+    LOG(ERROR) << ex.what();
+    return false;
+  }
   return true;
 }
 
@@ -168,18 +430,8 @@ string UserDbHelper::GetRimeVersion() {
   return version;
 }
 
-static TickCount get_tick_count(Db* db) {
-  string tick;
-  if (db && db->MetaFetch("/tick", &tick)) {
-    try {
-      return std::stoul(tick);
-    } catch (...) {
-    }
-  }
-  return 1;
-}
-
-UserDbMerger::UserDbMerger(Db* db) : db_(db) {
+UserDbMerger::UserDbMerger(Db* db)
+    : db_(db), transactional_(dynamic_cast<Transactional*>(db)) {
   our_tick_ = get_tick_count(db);
   their_tick_ = 0;
   max_tick_ = our_tick_;
@@ -219,10 +471,21 @@ bool UserDbMerger::Put(const string& key, const string& value) {
     o.commits = v.commits;
   o.dee = (std::max)(o.dee, v.dee);
   o.tick = max_tick_;
-  return db_->Update(key, o.Pack()) && ++merged_entries_;
+  if (transactional_ && !transactional_->in_transaction())
+    transactional_->BeginTransaction();
+  bool updated = db_->Update(key, o.PackFor(db_)) && ++merged_entries_;
+  if (transactional_ && ++batch_size_ == UserDbSyncMerger::kBatchSize) {
+    transactional_->CommitTransaction();
+    batch_size_ = 0;
+  }
+  return updated;
 }
 
 void UserDbMerger::CloseMerge() {
+  if (transactional_ && transactional_->in_transaction()) {
+    transactional_->CommitTransaction();
+    batch_size_ = 0;
+  }
   if (!db_ || !merged_entries_)
     return;
   Deployer& deployer(Service::instance().deployer());
@@ -238,7 +501,235 @@ void UserDbMerger::CloseMerge() {
   merged_entries_ = 0;
 }
 
-UserDbImporter::UserDbImporter(Db* db) : db_(db) {}
+// UserDbSyncMerger members
+
+static const char* kSyncTickKeyPrefix = "/sync_tick/";
+
+// entries of a snapshot file, sorted by key, with the dee of each value
+// decayed to the tick of the snapshot.
+struct UserDbSyncMerger::Snapshot : public Sink {
+  map<string, string> metadata;
+  vector<pair<string, UserDbValue>> entries;
+  string user_id;
+  TickCount tick = 0;
+  // entries written at or before this tick were merged in the last sync.
+  TickCount watermark = 0;
+  bool loaded = false;
+
+  bool MetaPut(const string& key, const string& value) override {
+    metadata[key] = value;
+    return true;
+  }
+  bool Put(const string& key, const string& value) override {
+    entries.emplace_back(key, UserDbValue(value));
+    return true;
+  }
+
+  bool Load(const path& snapshot_file,
+            const path& delta_file,
+            const string& db_name);
+  // the position of the first entry at or after pos changed since the
+  // watermark.
+  size_t Next(size_t pos) const {
+    if (watermark == 0 || tick < watermark)
+      return pos;
+    while (pos < entries.size() && entries[pos].second.tick <= watermark)
+      ++pos;
+    return pos;
+  }
+};
+
+bool UserDbSyncMerger::Snapshot::Load(const path& snapshot_file,
+                                      const path& delta_file,
+                                      const string& db_name) {
+  TsvReader reader(snapshot_file, plain_userdb_format.parser);
+  try {
+    reader >> *this;
+  } catch (std::exception& ex) {
+    LOG(ERROR) << ex.what();
+    return false;
+  }
+  // a delta written against an older full snapshot is left out; entries of
+  // the delta follow those of the full snapshot and win over them.
+  if (!delta_file.empty() && std::filesystem::exists(delta_file)) {
+    auto delta_metadata = read_snapshot_metadata(delta_file);
+    if (delta_metadata[DeltaSource::kDeltaBaseKey] != metadata["/tick"]) {
+      LOG(WARNING) << "ignoring stale delta snapshot: " << delta_file;
+    } else {
+      TsvReader delta_reader(delta_file, plain_userdb_format.parser);
+      try {
+        delta_reader >> *this;
+      } catch (std::exception& ex) {
+        LOG(ERROR) << ex.what();
+        return false;
+      }
+    }
+  }
+  if (metadata["/db_type"] != "userdb") {
+    LOG(ERROR) << "not a userdb snapshot: " << snapshot_file;
+    return false;
+  }
+  string name = metadata["/db_name"];
+  auto ext = boost::find_last(name, ".userdb");
+  if (!ext.empty()) {
+    name.erase(ext.begin(), name.end());
+  }
+  if (name != db_name) {
+    LOG(ERROR) << "snapshot of userdb '" << name << "' does not belong to '"
+               << db_name << "': " << snapshot_file;
+    return false;
+  }
+  user_id = metadata.count("/user_id") ? metadata["/user_id"] : "unknown";
+  tick = parse_tick(metadata["/tick"]);
+  // snapshots are written in the order of keys, but do not count on it.
+  // where a key occurs more than once, the last entry wins.
+  std::stable_sort(entries.begin(), entries.end(),
+                   [](const pair<string, UserDbValue>& a,
+                      const pair<string, UserDbValue>& b) {
+                     return a.first < b.first;
+                   });
+  size_t size = 0;
+  for (auto& entry : entries) {
+    if (size > 0 && entries[size - 1].first == entry.first) {
+      entries[size - 1] = std::move(entry);
+      continue;
+    }
+    if (&entries[size] != &entry)
+      entries[size] = std::move(entry);
+    ++size;
+  }
+  entries.resize(size);
+  for (auto& entry : entries) {
+    UserDbValue& v(entry.second);
+    if (v.tick < tick) {
+      v.dee = algo::formula_d(0, (double)tick, v.dee, (double)v.tick);
+    }
+  }
+  return true;
+}
+
+bool UserDbSyncMerger::Merge() {
+  if (!db_ || !db_->loaded() || db_->readonly())
+    return false;
+  // parse snapshot files in parallel
+  vector<Snapshot> snapshots(snapshot_files_.size());
+  vector<std::future<void>> loading;
+  for (size_t i = 0; i < snapshots.size(); ++i) {
+    loading.push_back(WorkerPool::Shared().Submit(
+        [this, &snapshots, i] {
+          snapshots[i].loaded =
+              snapshots[i].Load(snapshot_files_[i].first,
+                                snapshot_files_[i].second, db_->name());
+        }));
+  }
+  for (auto& done : loading) {
+    done.wait();
+  }
+
+  bool success = true;
+  TickCount our_tick = get_tick_count(db_);
+  TickCount max_tick = our_tick;
+  for (size_t i = 0; i < snapshots.size(); ++i) {
+    Snapshot& snapshot(snapshots[i]);
+    if (!snapshot.loaded) {
+      LOG(ERROR) << "failed to merge snapshot file: "
+                 << snapshot_files_[i].first;
+      success = false;
+      continue;
+    }
+    string watermark;
+    if (db_->MetaFetch(kSyncTickKeyPrefix + snapshot.user_id, &watermark)) {
+      try {
+        snapshot.watermark = std::stoul(watermark);
+      } catch (...) {
+      }
+    }
+    max_tick = (std::max)(max_tick, snapshot.tick);
+  }
+
+  // k-way merge of the sorted snapshot entries; for a key found in several
+  // snapshots, they are taken in the order the snapshots were added.
+  using Head = pair<size_t, size_t>;  // (snapshot, position)
+  auto later = [&snapshots](const Head& a, const Head& b) {
+    const string& a_key = snapshots[a.first].entries[a.second].first;
+    const string& b_key = snapshots[b.first].entries[b.second].first;
+    int c = a_key.compare(b_key);
+    return c != 0 ? c > 0 : a.first > b.first;
+  };
+  std::priority_queue<Head, vector<Head>, decltype(later)> heads(later);
+  auto advance = [&snapshots, &heads](size_t i, size_t pos) {
+    pos = snapshots[i].Next(pos);
+    if (pos < snapshots[i].entries.size())
+      heads.push({i, pos});
+  };
+  for (size_t i = 0; i < snapshots.size(); ++i) {
+    if (snapshots[i].loaded)
+      advance(i, 0);
+  }
+
+  // write in batches of transactions where the db supports them
+  auto transactional = dynamic_cast<Transactional*>(db_);
+  size_t batch_size = 0;
+  string key;
+  string our_value;
+  while (!heads.empty()) {
+    key = snapshots[heads.top().first].entries[heads.top().second].first;
+    UserDbValue o;
+    if (db_->Fetch(key, &our_value)) {
+      o.Unpack(our_value);
+    }
+    if (o.tick < our_tick) {
+      o.dee = algo::formula_d(0, (double)our_tick, o.dee, (double)o.tick);
+    }
+    while (!heads.empty()) {
+      Head head = heads.top();
+      const auto& entry = snapshots[head.first].entries[head.second];
+      if (entry.first != key)
+        break;
+      const UserDbValue& v(entry.second);
+      if (std::abs(o.commits) < std::abs(v.commits))
+        o.commits = v.commits;
+      o.dee = (std::max)(o.dee, v.dee);
+      heads.pop();
+      advance(head.first, head.second + 1);
+    }
+    o.tick = max_tick;
+    if (transactional && !transactional->in_transaction())
+      transactional->BeginTransaction();
+    if (db_->Update(key, o.PackFor(db_)))
+      ++merged_entries_;
+    if (transactional && ++batch_size == kBatchSize) {
+      transactional->CommitTransaction();
+      batch_size = 0;
+    }
+  }
+  if (transactional && transactional->in_transaction())
+    transactional->CommitTransaction();
+
+  if (merged_entries_) {
+    Deployer& deployer(Service::instance().deployer());
+    db_->MetaUpdate("/tick", std::to_string(max_tick));
+    db_->MetaUpdate("/user_id", deployer.user_id);
+  }
+  for (const auto& snapshot : snapshots) {
+    if (snapshot.loaded) {
+      db_->MetaUpdate(kSyncTickKeyPrefix + snapshot.user_id,
+                      std::to_string(snapshot.tick));
+    }
+  }
+  LOG(INFO) << "total " << merged_entries_ << " entries merged from "
+            << snapshots.size() << " snapshots, tick = " << max_tick;
+  return success;
+}
+
+UserDbImporter::UserDbImporter(Db* db, size_t batch_size)
+    : db_(db),
+      transactional_(dynamic_cast<Transactional*>(db)),
+      max_batch_size_(batch_size) {}
+
+UserDbImporter::~UserDbImporter() {
+  CloseImport();
+}
 
 bool UserDbImporter::MetaPut(const string& key, const string& value) {
   return true;
@@ -259,7 +750,21 @@ bool UserDbImporter::Put(const string& key, const string& value) {
   } else if (v.commits < 0) {  // mark as deleted
     o.commits = (std::min)(v.commits, -std::abs(o.commits));
   }
-  return db_->Update(key, o.Pack());
+  if (transactional_ && !transactional_->in_transaction())
+    transactional_->BeginTransaction();
+  bool updated = db_->Update(key, o.PackFor(db_));
+  if (transactional_ && ++batch_size_ >= max_batch_size_) {
+    transactional_->CommitTransaction();
+    batch_size_ = 0;
+  }
+  return updated;
+}
+
+void UserDbImporter::CloseImport() {
+  if (transactional_ && transactional_->in_transaction()) {
+    transactional_->CommitTransaction();
+    batch_size_ = 0;
+  }
 }
 
 }  // namespace rime
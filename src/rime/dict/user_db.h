@@ -25,8 +25,16 @@ struct UserDbValue {
   UserDbValue() = default;
   UserDbValue(const string& value);
 
+  /// Packs as text: "c=<commits> d=<dee> t=<tick>".
   string Pack() const;
+  /// Packs in the compact binary encoding, for dbs that can store it.
+  string PackBinary() const;
+  /// Packs in binary if the db is binary safe, otherwise as text.
+  string PackFor(const Db* db) const;
+  /// Reads values in either encoding.
   bool Unpack(const string& value);
+
+  static bool IsBinary(const string& value);
 };
 
 /**
@@ -39,6 +47,7 @@ struct UserDbValue {
 class UserDb {
  public:
   static string snapshot_extension();
+  static string delta_snapshot_extension();
 
   /// Abstract class for a user db component.
   class Component : public Db::Component {
@@ -64,6 +73,10 @@ class UserDbHelper {
   RIME_API bool UpdateUserInfo();
   RIME_API static bool IsUniformFormat(const path& file_path);
   RIME_API bool UniformBackup(const path& snapshot_file);
+  /// Writes the entries changed since the full snapshot to the delta file,
+  /// or a new full snapshot if there is none or the delta grows too large.
+  RIME_API bool IncrementalBackup(const path& snapshot_file,
+                                  const path& delta_file);
   RIME_API bool UniformRestore(const path& snapshot_file);
 
   bool IsUserDb();
@@ -124,17 +137,63 @@ class UserDbMerger : public Sink {
   TickCount their_tick_;
   TickCount max_tick_;
   int merged_entries_;
+  // entries are written in batches of transactions where the db supports
+  // them.
+  Transactional* transactional_;
+  size_t batch_size_ = 0;
+};
+
+/**
+ * Merges the snapshots of a user db from all synced devices in one pass.
+ *
+ * Snapshot files are read in parallel into sorted streams, which are then
+ * merged in the order of keys and written to the db in batches.
+ * The tick of each snapshot is recorded in the db as a watermark, so that
+ * the next sync skips entries that have not changed since.
+ */
+class UserDbSyncMerger {
+ public:
+  explicit UserDbSyncMerger(Db* db) : db_(db) {}
+
+  /// Snapshots are merged in the order they are added.
+  /// The changes in a delta snapshot, if any, apply on top of the full one.
+  void AddSnapshot(const path& snapshot_file, const path& delta_file = path()) {
+    snapshot_files_.push_back({snapshot_file, delta_file});
+  }
+  /// Returns false if any snapshot failed to merge.
+  RIME_API bool Merge();
+
+  int merged_entries() const { return merged_entries_; }
+
+  static const size_t kBatchSize = 1024;
+
+ protected:
+  struct Snapshot;
+
+  Db* db_;
+  vector<pair<path, path>> snapshot_files_;
+  int merged_entries_ = 0;
 };
 
 class UserDbImporter : public Sink {
  public:
-  explicit UserDbImporter(Db* db);
+  // entries are written in transactions of batch_size entries where the db
+  // supports them.
+  explicit UserDbImporter(Db* db,
+                          size_t batch_size = UserDbSyncMerger::kBatchSize);
+  virtual ~UserDbImporter();
 
   virtual bool MetaPut(const string& key, const string& value);
   virtual bool Put(const string& key, const string& value);
 
+  // commits the entries of the last batch.
+  void CloseImport();
+
  protected:
   Db* db_;
+  Transactional* transactional_;
+  size_t max_batch_size_;
+  size_t batch_size_ = 0;
 };
 
 }  // namespace rime
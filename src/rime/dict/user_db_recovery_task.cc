@@ -7,6 +7,7 @@
 #include <boost/algorithm/string.hpp>
 #include <filesystem>
 #include <boost/scope_exit.hpp>
+#include <typeinfo>
 #include <rime/deployer.h>
 #include <rime/dict/db.h>
 #include <rime/dict/user_db.h>
@@ -14,6 +15,8 @@
 
 namespace rime {
 
+static const char kSideBySideSuffix[] = ".recovery";
+
 UserDbRecoveryTask::UserDbRecoveryTask(an<Db> db) : db_(db) {
   if (db_) {
     db_->disable();
@@ -35,31 +38,64 @@ bool UserDbRecoveryTask::Run(Deployer* deployer) {
   }
   auto r = As<Recoverable>(db_);
   if (r && r->Recover()) {
-    return true;
+    // takes over from the snapshot serving lookups in the meantime.
+    return db_->Open();
   }
-  // repair didn't work on the damaged db file; remove and recreate it
+  // repair didn't work on the damaged db file; recreate the db next to it
+  // from the snapshot, then swap it in place of the damaged one.
   LOG(INFO) << "recreating db file.";
+  auto rebuilt = CreateSideBySideDb();
+  if (!rebuilt || !rebuilt->Open()) {
+    LOG(ERROR) << "Error creating db '" << db_->name() << "'.";
+    return false;
+  }
+  RestoreUserDataFromSnapshot(deployer, rebuilt);
+  // the side-by-side db is named after the damaged one.
+  rebuilt->MetaUpdate("/db_name", db_->name());
+  rebuilt->Close();
   if (db_->Exists()) {
     std::error_code ec;
     std::filesystem::rename(db_->file_path(),
                             path(db_->file_path()).concat(".old"), ec);
     if (ec && !db_->Remove()) {
       LOG(ERROR) << "Error removing db file '" << db_->file_path() << "'.";
+      rebuilt->Remove();
       return false;
     }
   }
+  std::error_code ec;
+  std::filesystem::rename(rebuilt->file_path(), db_->file_path(), ec);
+  if (ec) {
+    LOG(ERROR) << "Error replacing db file '" << db_->file_path()
+               << "': " << ec.message();
+    return false;
+  }
   if (!db_->Open()) {
-    LOG(ERROR) << "Error creating db '" << db_->name() << "'.";
+    LOG(ERROR) << "Error opening recovered db '" << db_->name() << "'.";
     return false;
   }
-  RestoreUserDataFromSnapshot(deployer);
   LOG(INFO) << "recovery successful.";
   return true;
 }
 
-void UserDbRecoveryTask::RestoreUserDataFromSnapshot(Deployer* deployer) {
+an<Db> UserDbRecoveryTask::CreateSideBySideDb() {
+  UserDb::Component* component = UserDb::Require("userdb");
+  if (!component)
+    return nullptr;
+  an<Db> db(component->Create(db_->name() + kSideBySideSuffix));
+  // a db of another class cannot take the place of the damaged one.
+  if (!db || typeid(*db) != typeid(*db_))
+    return nullptr;
+  // left over by an interrupted recovery
+  if (db->Exists())
+    db->Remove();
+  return db;
+}
+
+void UserDbRecoveryTask::RestoreUserDataFromSnapshot(Deployer* deployer,
+                                                     const an<Db>& db) {
   UserDb::Component* component = UserDb::Require("userdb");
-  if (!component || !UserDbHelper(db_).IsUserDb())
+  if (!component || !UserDbHelper(db).IsUserDb())
     return;
   string dict_name(db_->name());
   boost::erase_last(dict_name, component->extension());
@@ -77,7 +113,7 @@ void UserDbRecoveryTask::RestoreUserDataFromSnapshot(Deployer* deployer) {
     }
   }
   LOG(INFO) << "snapshot exists, trying to restore db '" << dict_name << "'.";
-  if (db_->Restore(snapshot_path)) {
+  if (db->Restore(snapshot_path)) {
     LOG(INFO) << "restored db '" << dict_name << "' from snapshot.";
   }
 }
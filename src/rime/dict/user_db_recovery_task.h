@@ -20,7 +20,9 @@ class UserDbRecoveryTask : public DeploymentTask {
   bool Run(Deployer* deployer);
 
  protected:
-  void RestoreUserDataFromSnapshot(Deployer* deployer);
+  // a db of the same class to be rebuilt next to the damaged one.
+  an<Db> CreateSideBySideDb();
+  void RestoreUserDataFromSnapshot(Deployer* deployer, const an<Db>& db);
 
   an<Db> db_;
 };
@@ -0,0 +1,130 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <algorithm>
+#include <mutex>
+#include <rime/algo/strings.h>
+#include <rime/dict/db.h>
+#include <rime/dict/user_dict_index.h>
+
+namespace rime {
+
+UserDictIndex::UserDictIndex(const Syllabary& syllabary)
+    : UserDictIndex(New<DenseSyllabary>(syllabary)) {}
+
+UserDictIndex::UserDictIndex(an<const DenseSyllabary> syllabary)
+    : syllabary_(std::move(syllabary)), nodes_(1) {}
+
+bool UserDictIndex::Load(Db* db) {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  if (loaded_)
+    return true;
+  auto accessor = db ? db->QueryAll() : nullptr;
+  if (!accessor)
+    return false;
+  nodes_.assign(1, Node());
+  num_records_ = 0;
+  string key;
+  string value;
+  Code code;
+  // records come in the order of keys, so simply append them to the nodes.
+  while (accessor->GetNextRecord(&key, &value)) {
+    if (!ParseCode(key, &code))
+      continue;
+    Insert(code)->records.push_back({key, value});
+    ++num_records_;
+  }
+  loaded_ = true;
+  DLOG(INFO) << "indexed " << num_records_ << " user dict records.";
+  return true;
+}
+
+void UserDictIndex::Update(const string& key, const string& value) {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  Code code;
+  if (!loaded_ || !ParseCode(key, &code))
+    return;
+  auto& records = Insert(code)->records;
+  auto found = std::lower_bound(
+      records.begin(), records.end(), key,
+      [](const Record& record, const string& key) { return record.key < key; });
+  if (found != records.end() && found->key == key) {
+    found->value = value;
+  } else {
+    records.insert(found, {key, value});
+    ++num_records_;
+  }
+}
+
+void UserDictIndex::Invalidate() {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  nodes_.assign(1, Node());
+  num_records_ = 0;
+  loaded_ = false;
+}
+
+const UserDictIndex::Node* UserDictIndex::Find(const Node* node,
+                                               SyllableId syllable_id) const {
+  auto found = std::lower_bound(
+      node->children.begin(), node->children.end(), syllable_id,
+      [](const pair<SyllableId, uint32_t>& child, SyllableId syllable_id) {
+        return child.first < syllable_id;
+      });
+  if (found == node->children.end() || found->first != syllable_id)
+    return nullptr;
+  return &nodes_[found->second];
+}
+
+void UserDictIndex::CollectDescendants(const Node* node,
+                                       vector<const Record*>* records) const {
+  for (const auto& child : node->children) {
+    const Node* descendant = &nodes_[child.second];
+    for (const auto& record : descendant->records) {
+      records->push_back(&record);
+    }
+    CollectDescendants(descendant, records);
+  }
+}
+
+// a user db key is the code, spelled in syllables each followed by a space,
+// then a tab and the text: 'ni hao \t你好'
+bool UserDictIndex::ParseCode(const string& key, Code* code) const {
+  size_t separator_pos = key.find('\t');
+  if (separator_pos == string::npos)
+    return false;
+  code->clear();
+  for (const auto& syllable :
+       strings::split(key.substr(0, separator_pos), " ",
+                      strings::SplitBehavior::SkipToken)) {
+    SyllableId syllable_id = syllabary_->Find(syllable);
+    if (syllable_id < 0)
+      return false;
+    code->push_back(syllable_id);
+  }
+  return !code->empty();
+}
+
+UserDictIndex::Node* UserDictIndex::Insert(const Code& code) {
+  uint32_t node_id = 0;
+  for (SyllableId syllable_id : code) {
+    auto& children = nodes_[node_id].children;
+    auto found = std::lower_bound(
+        children.begin(), children.end(), syllable_id,
+        [](const pair<SyllableId, uint32_t>& child, SyllableId syllable_id) {
+          return child.first < syllable_id;
+        });
+    if (found != children.end() && found->first == syllable_id) {
+      node_id = found->second;
+      continue;
+    }
+    uint32_t child_id = static_cast<uint32_t>(nodes_.size());
+    children.insert(found, {syllable_id, child_id});
+    // may reallocate nodes_, invalidating `children`
+    nodes_.emplace_back();
+    node_id = child_id;
+  }
+  return &nodes_[node_id];
+}
+
+}  // namespace rime
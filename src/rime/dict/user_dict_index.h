@@ -0,0 +1,73 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#ifndef RIME_USER_DICT_INDEX_H_
+#define RIME_USER_DICT_INDEX_H_
+
+#include <atomic>
+#include <shared_mutex>
+#include <rime_api.h>
+#include <rime/common.h>
+#include <rime/dict/vocabulary.h>
+
+namespace rime {
+
+class Db;
+
+// An in-memory trie of the records in a user db, keyed by syllable ids.
+// Lookups walk the trie nodes instead of seeking db cursors by string prefix.
+// Syllable ids are those of the syllabary of the table the index is built
+// for; records with syllables not in the syllabary are left out.
+class RIME_API UserDictIndex {
+ public:
+  struct Record {
+    string key;
+    string value;
+  };
+  struct Node {
+    // sorted by syllable id
+    vector<pair<SyllableId, uint32_t>> children;
+    // records whose code ends at this node, sorted by key
+    vector<Record> records;
+  };
+
+  explicit UserDictIndex(const Syllabary& syllabary);
+  explicit UserDictIndex(an<const DenseSyllabary> syllabary);
+
+  // loads all records from the db, unless it is already done.
+  bool Load(Db* db);
+  // adds or replaces a record after it is written to the db.
+  void Update(const string& key, const string& value);
+  // drops the contents, to be loaded again before the next lookup.
+  void Invalidate();
+
+  const Node* root() const { return &nodes_[0]; }
+  const Node* Find(const Node* node, SyllableId syllable_id) const;
+  // appends the records found under the node, excluding its own.
+  void CollectDescendants(const Node* node,
+                          vector<const Record*>* records) const;
+
+  bool loaded() const { return loaded_; }
+  size_t size() const { return num_records_; }
+  const DenseSyllabary& syllabary() const { return *syllabary_; }
+
+  // readers hold a shared lock during lookups; the modifiers above take an
+  // exclusive one.
+  std::shared_mutex& mutex() { return mutex_; }
+
+ private:
+  bool ParseCode(const string& key, Code* code) const;
+  Node* Insert(const Code& code);
+
+  an<const DenseSyllabary> syllabary_;
+  vector<Node> nodes_;
+  size_t num_records_ = 0;
+  // read without the lock, to skip loading once done.
+  std::atomic<bool> loaded_{false};
+  std::shared_mutex mutex_;
+};
+
+}  // namespace rime
+
+#endif  // RIME_USER_DICT_INDEX_H_
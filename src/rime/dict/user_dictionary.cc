@@ -6,19 +6,33 @@
 //
 #include <algorithm>
 #include <cfloat>
+#include <chrono>
 #include <cmath>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <queue>
 #include <boost/algorithm/string.hpp>
 #include <boost/scope_exit.hpp>
+#include <rime/cancellation.h>
 #include <rime/common.h>
+#include <rime/deployer.h>
+#include <rime/hot_log.h>
 #include <rime/language.h>
+#include <rime/memory_budget.h>
+#include <rime/memory_stats.h>
+#include <rime/perf_counters.h>
 #include <rime/schema.h>
 #include <rime/service.h>
 #include <rime/ticket.h>
+#include <rime/worker_pool.h>
 #include <rime/algo/dynamics.h>
 #include <rime/algo/syllabifier.h>
 #include <rime/algo/strings.h>
 #include <rime/dict/db.h>
 #include <rime/dict/table.h>
+#include <rime/dict/text_db.h>
+#include <rime/dict/user_db.h>
 #include <rime/dict/user_dictionary.h>
 #include <rime/dict/vocabulary.h>
 
@@ -27,16 +41,46 @@ namespace rime {
 struct DfsState {
   size_t depth_limit;
   size_t predict_word_from_depth;
+  // branches to visit at most; 0 for no limit.
+  size_t node_budget = 0;
+  size_t nodes_visited = 0;
+  bool has_deadline = false;
+  std::chrono::steady_clock::time_point deadline;
+  // whether the budget has run out before all branches were visited.
+  bool pruned = false;
   TickCount present_tick;
   Code code;
   vector<double> credibility;
-  hash_map<int, DictEntryList> query_result;
+  // whether a syllable of the code is spelt with a correction.
+  vector<bool> is_correction;
+  EndPosMap<DictEntryList> query_result;
   an<DbAccessor> accessor;
   string key;
   string value;
+  an<Arena> arena;
 
   size_t depth() const { return code.size(); }
 
+  // counts a branch to visit, or returns true if the budget is used up or
+  // the lookup is cancelled.
+  bool OutOfBudget() {
+    if (pruned)
+      return true;
+    if (node_budget && nodes_visited >= node_budget) {
+      pruned = true;
+    } else if (nodes_visited % kNodesPerClockCheck == 0 &&
+               (PastDeadline() || Cancellation::Requested())) {
+      pruned = true;
+    }
+    ++nodes_visited;
+    return pruned;
+  }
+  static const size_t kNodesPerClockCheck = 16;
+
+  bool PastDeadline() const {
+    return has_deadline && std::chrono::steady_clock::now() >= deadline;
+  }
+
   bool IsExactMatch(const string& prefix) {
     return boost::starts_with(key, prefix + '\t');
   }
@@ -44,7 +88,13 @@ struct DfsState {
     return boost::starts_with(key, prefix);
   }
   void RecruitEntry(size_t pos,
-                    hash_map<string, SyllableId>* syllabary = nullptr);
+                    const DenseSyllabary* syllabary = nullptr) {
+    RecruitEntry(pos, key, value, syllabary);
+  }
+  void RecruitEntry(size_t pos,
+                    const string& record_key,
+                    const string& record_value,
+                    const DenseSyllabary* syllabary);
   bool NextEntry() {
     if (!accessor->GetNextRecord(&key, &value)) {
       key.clear();
@@ -54,6 +104,7 @@ struct DfsState {
     return true;
   }
   bool ForwardScan(const string& prefix) {
+    PerfCounters::Count(PerfCounters::kUserDbSeeks);
     if (!accessor->Jump(prefix)) {
       return false;
     }
@@ -61,6 +112,7 @@ struct DfsState {
   }
   bool Backdate(const string& prefix) {
     DLOG(INFO) << "backdate; prefix: " << prefix;
+    PerfCounters::Count(PerfCounters::kUserDbSeeks);
     if (!accessor->Reset()) {
       LOG(WARNING) << "backdating failed for '" << prefix << "'.";
       return false;
@@ -70,24 +122,29 @@ struct DfsState {
 };
 
 void DfsState::RecruitEntry(size_t pos,
-                            hash_map<string, SyllableId>* syllabary) {
+                            const string& record_key,
+                            const string& record_value,
+                            const DenseSyllabary* syllabary) {
   string full_code;
-  auto e = UserDictionary::CreateDictEntry(key, value, present_tick,
+  auto e = UserDictionary::CreateDictEntry(record_key, record_value,
+                                           present_tick,
                                            credibility.back(),
-                                           syllabary ? &full_code : nullptr);
+                                           syllabary ? &full_code : nullptr,
+                                           arena);
   if (e) {
+    e->is_correction = is_correction.back();
     if (syllabary) {
       vector<string> syllables =
           strings::split(full_code, " ", strings::SplitBehavior::SkipToken);
       Code numeric_code;
       for (auto s = syllables.begin(); s != syllables.end(); ++s) {
-        auto found = syllabary->find(*s);
-        if (found == syllabary->end()) {
+        SyllableId syllable_id = syllabary->Find(*s);
+        if (syllable_id < 0) {
           LOG(ERROR) << "failed to recruit dict entry '" << e->text
                      << "', unrecognized syllable: " << *s;
           return;
         }
-        numeric_code.push_back(found->second);
+        numeric_code.push_back(syllable_id);
       }
       e->code = numeric_code;
       e->matching_code_size = code.size();
@@ -107,10 +164,33 @@ void UserDictEntryIterator::Add(an<DictEntry>&& entry) {
 
 void UserDictEntryIterator::SetEntries(DictEntryList&& entries) {
   cache_ = std::move(entries);
+  unordered_ranges_.clear();
 }
 
 void UserDictEntryIterator::SortRange(size_t start, size_t count) {
-  cache_.SortRange(start, count);
+  size_t end = (std::min)(start + count, cache_.size());
+  if (start + 1 >= end)
+    return;
+  unordered_ranges_.push_back({start, end});
+  OrderUpTo(index_);
+}
+
+void UserDictEntryIterator::OrderUpTo(size_t index) {
+  for (auto& range : unordered_ranges_) {
+    if (index < range.sorted_end || index >= range.end)
+      continue;
+    size_t sorted_end =
+        (std::max)(index + 1, range.sorted_end + kSortBatchSize);
+    cache_.PartialSortRange(range.sorted_end, range.end - range.sorted_end,
+                            sorted_end - range.sorted_end);
+    range.sorted_end = (std::min)(sorted_end, range.end);
+  }
+  unordered_ranges_.erase(
+      std::remove_if(unordered_ranges_.begin(), unordered_ranges_.end(),
+                     [](const UnorderedRange& range) {
+                       return range.sorted_end >= range.end;
+                     }),
+      unordered_ranges_.end());
 }
 
 void UserDictEntryIterator::AddFilter(DictEntryFilter filter) {
@@ -126,6 +206,8 @@ an<DictEntry> UserDictEntryIterator::Peek() {
   if (exhausted()) {
     return nullptr;
   }
+  if (!unordered_ranges_.empty())
+    OrderUpTo(index_);
   return cache_[index_];
 }
 
@@ -151,24 +233,88 @@ bool UserDictEntryIterator::Next() {
 
 // UserDictionary members
 
+// updates to a user dictionary, run in the order they are posted on the
+// shared worker pool, or by a thread waiting for them to be done.
+class UserDictWriter : public std::enable_shared_from_this<UserDictWriter> {
+ public:
+  void Post(function<void()> task) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tasks_.push(std::move(task));
+      if (running_ || scheduled_)
+        return;
+      scheduled_ = true;
+    }
+    WorkerPool::Shared().Submit([self = shared_from_this()] {
+      std::unique_lock<std::mutex> lock(self->mutex_);
+      self->scheduled_ = false;
+      self->Run(lock);
+    });
+  }
+
+  void Sync() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return !running_; });
+    // rather than waiting for a worker to pick them up
+    Run(lock);
+  }
+
+ private:
+  void Run(std::unique_lock<std::mutex>& lock) {
+    if (running_)
+      return;
+    running_ = true;
+    while (!tasks_.empty()) {
+      auto task = std::move(tasks_.front());
+      tasks_.pop();
+      lock.unlock();
+      task();
+      lock.lock();
+    }
+    running_ = false;
+    done_.notify_all();
+  }
+
+  std::mutex mutex_;
+  std::condition_variable done_;
+  std::queue<function<void()>> tasks_;
+  bool running_ = false;
+  bool scheduled_ = false;
+};
+
+static void release_shared_data(const string& db_name);
+
 UserDictionary::UserDictionary(const string& name, an<Db> db)
-    : name_(name), db_(db) {}
+    : name_(name), db_(db), writer_(New<UserDictWriter>()) {}
 
 UserDictionary::~UserDictionary() {
-  if (loaded()) {
-    CommitPendingTransaction();
+  CommitPendingTransaction();
+  // queued updates refer to this dictionary
+  Flush();
+  if (db_) {
+    index_.reset();
+    cache_.reset();
+    release_shared_data(db_->name());
   }
 }
 
 void UserDictionary::Attach(const an<Table>& table, const an<Prism>& prism) {
   table_ = table;
   prism_ = prism;
+  // decoded up front, rather than in the middle of the first lookup.
+  syllabary_ = table ? table->dense_syllabary() : nullptr;
 }
 
 bool UserDictionary::Load() {
-  if (!db_ || db_->disabled())
+  if (!db_)
     return false;
+  if (db_->disabled())
+    return OpenStandbyDb();
+  // the db is shared with dictionaries being loaded on other threads.
+  static std::mutex load_mutex;
+  std::unique_lock<std::mutex> lock(load_mutex);
   if (!db_->loaded() && !db_->Open()) {
+    lock.unlock();
     // try to recover managed db in available work thread
     Deployer& deployer(Service::instance().deployer());
     auto task = DeploymentTask::Require("userdb_recovery_task");
@@ -176,17 +322,48 @@ bool UserDictionary::Load() {
       deployer.ScheduleTask(an<DeploymentTask>(task->Create(db_)));
       deployer.StartWork();
     }
-    return false;
+    return db_->disabled() && OpenStandbyDb();
   }
   return FetchTickCount() || Initialize();
 }
 
+bool UserDictionary::OpenStandbyDb() {
+  if (!standby_db_) {
+    Deployer& deployer(Service::instance().deployer());
+    path snapshot_path = deployer.user_data_sync_dir() /
+                         (db_->name() + UserDb::snapshot_extension());
+    if (!std::filesystem::exists(snapshot_path))
+      return false;
+    auto db = New<UserDbWrapper<TextDb>>(snapshot_path, db_->name());
+    if (!db->OpenReadOnly())
+      return false;
+    LOG(INFO) << "serving user dict '" << name_ << "' from snapshot "
+              << snapshot_path << " while the db is recovered.";
+    standby_db_ = db;
+  }
+  FetchTickCount();
+  return true;
+}
+
+Db* UserDictionary::serving_db() const {
+  if (standby_db_ && db_->disabled())
+    return standby_db_.get();
+  return db_.get();
+}
+
+void UserDictionary::WarmUp() {
+  if (table_ && loaded())
+    AcquireIndex();
+}
+
 bool UserDictionary::loaded() const {
-  return db_ && !db_->disabled() && db_->loaded();
+  Db* db = serving_db();
+  return db && !db->disabled() && db->loaded();
 }
 
 bool UserDictionary::readonly() const {
-  return db_ && db_->readonly();
+  Db* db = serving_db();
+  return db && db->readonly();
 }
 
 // this is a one-pass scan for the user db which supports sequential access
@@ -220,12 +397,13 @@ void UserDictionary::DfsLookup(const SyllableGraph& syll_graph,
   if (index == syll_graph.indices.end()) {
     return;
   }
-  DLOG(INFO) << "dfs lookup starts from " << current_pos;
+  RIME_HOT_LOG(UserDictionary) << "dfs lookup starts from " << current_pos;
   string prefix;
   for (const auto& spelling : index->second) {
-    DLOG(INFO) << "prefix: '" << current_prefix << "'"
-               << ", syll_id: " << spelling.first
-               << ", num_spellings: " << spelling.second.size();
+    RIME_HOT_LOG(UserDictionary) << "prefix: '" << current_prefix << "'"
+                                 << ", syll_id: " << spelling.first
+                                 << ", num_spellings: "
+                                 << spelling.second.size();
     state->code.push_back(spelling.first);
     BOOST_SCOPE_EXIT((&state)) {
       state->code.pop_back();
@@ -237,21 +415,28 @@ void UserDictionary::DfsLookup(const SyllableGraph& syll_graph,
       auto props = spelling.second[i];
       if (i > 0 && props->type >= kAbbreviation)
         continue;
+      if (state->OutOfBudget())
+        return;
       state->credibility.push_back(state->credibility.back() +
                                    props->credibility);
+      state->is_correction.push_back(state->is_correction.back() ||
+                                     props->is_correction);
       BOOST_SCOPE_EXIT((&state)) {
         state->credibility.pop_back();
+        state->is_correction.pop_back();
       }
       BOOST_SCOPE_EXIT_END
       size_t end_pos = props->end_pos;
-      DLOG(INFO) << "edge: [" << current_pos << ", " << end_pos << ")";
+      RIME_HOT_LOG(UserDictionary) << "edge: [" << current_pos << ", "
+                                   << end_pos << ")";
       if (prefix != state->key) {  // 'a b c |d ' > 'a b c \tabracadabra'
-        DLOG(INFO) << "forward scanning for '" << prefix << "'.";
+        RIME_HOT_LOG(UserDictionary) << "forward scanning for '" << prefix
+                                     << "'.";
         if (!state->ForwardScan(prefix))  // reached the end of db
           continue;
       }
       while (state->IsExactMatch(prefix)) {  // 'b |e ' vs. 'b e \tBe'
-        DLOG(INFO) << "match found for '" << prefix << "'.";
+        RIME_HOT_LOG(UserDictionary) << "match found for '" << prefix << "'.";
         state->RecruitEntry(end_pos);
         if (!state->NextEntry())  // reached the end of db
           break;
@@ -263,19 +448,12 @@ void UserDictionary::DfsLookup(const SyllableGraph& syll_graph,
             state->depth() >= state->predict_word_from_depth) {
           while (state->IsPrefixMatch(prefix)) {
             DLOG(INFO) << "prefix match found for '" << prefix << "'.";
-            if (syllabary_.empty()) {
-              Syllabary syllabary;
-              if (!table_->GetSyllabary(&syllabary)) {
-                LOG(ERROR) << "failed to get syllabary for user dict: "
-                           << name();
-                break;
-              }
-              SyllableId syllable_id = 0;
-              for (auto s = syllabary.begin(); s != syllabary.end(); ++s) {
-                syllabary_[*s] = syllable_id++;
-              }
+            if (!syllabary_) {
+              LOG(ERROR) << "failed to get syllabary for user dict: "
+                         << name();
+              break;
             }
-            state->RecruitEntry(end_pos, &syllabary_);
+            state->RecruitEntry(end_pos, syllabary_.get());
             if (!state->NextEntry())  // reached the end of db
               break;
           }
@@ -294,13 +472,277 @@ void UserDictionary::DfsLookup(const SyllableGraph& syll_graph,
   }
 }
 
-static an<UserDictEntryCollector> collect(
-    hash_map<int, DictEntryList>* source) {
-  auto result = New<UserDictEntryCollector>();
-  for (auto& x : *source) {
-    (*result)[x.first].SetEntries(std::move(x.second));
+// a path in the in-memory index of the user db, yet to be followed.
+struct LookupBranch {
+  double credibility;
+  size_t end_pos;
+  const UserDictIndex::Node* node;
+  Code code;
+  bool is_correction;
+
+  // the most credible branch is the greatest, to be followed first.
+  bool operator<(const LookupBranch& other) const {
+    return credibility < other.credibility;
   }
-  return result;
+};
+
+// walks the in-memory index of the user db instead; being a trie keyed by
+// syllable ids, it needs neither forward scanning nor backdating, and finds
+// phrases of abbreviated paths such as 'sh(a) s(hi) h(ou)' as well.
+// branches are followed in order of their credibility, so that when the
+// lookup runs out of budget, it is the least likely phrases that are left.
+void UserDictionary::BestFirstLookup(const SyllableGraph& syll_graph,
+                                     size_t start_pos,
+                                     const UserDictIndex& index,
+                                     DfsState* state) {
+  std::priority_queue<LookupBranch> branches;
+  auto branch_out = [&](size_t current_pos, const LookupBranch& from) {
+    auto spellings = syll_graph.indices.find(current_pos);
+    if (spellings == syll_graph.indices.end()) {
+      return;
+    }
+    for (const auto& spelling : spellings->second) {
+      const UserDictIndex::Node* node = index.Find(from.node, spelling.first);
+      if (!node)
+        continue;
+      for (size_t i = 0; i < spelling.second.size(); ++i) {
+        auto props = spelling.second[i];
+        if (i > 0 && props->type >= kAbbreviation)
+          continue;
+        LookupBranch branch{from.credibility + props->credibility,
+                            props->end_pos, node, from.code,
+                            from.is_correction || props->is_correction};
+        branch.code.push_back(spelling.first);
+        branches.push(std::move(branch));
+      }
+    }
+  };
+  branch_out(start_pos, LookupBranch{state->credibility.back(), start_pos,
+                                     index.root(), {}, false});
+  while (!branches.empty() && !state->OutOfBudget()) {
+    LookupBranch branch = branches.top();
+    branches.pop();
+    state->code = branch.code;
+    state->credibility.push_back(branch.credibility);
+    state->is_correction.push_back(branch.is_correction);
+    BOOST_SCOPE_EXIT((&state)) {
+      state->credibility.pop_back();
+      state->is_correction.pop_back();
+    }
+    BOOST_SCOPE_EXIT_END
+    size_t end_pos = branch.end_pos;
+    for (const auto& record : branch.node->records) {
+      state->RecruitEntry(end_pos, record.key, record.value, nullptr);
+    }
+    if (syll_graph.indices.find(end_pos) == syll_graph.indices.end()) {
+      // reached the end of input, predict word if requested
+      if (state->predict_word_from_depth != 0 &&
+          state->depth() >= state->predict_word_from_depth) {
+        vector<const UserDictIndex::Record*> records;
+        index.CollectDescendants(branch.node, &records);
+        for (const auto* record : records) {
+          state->RecruitEntry(end_pos, record->key, record->value,
+                              &index.syllabary());
+        }
+      }
+    } else if ((!state->depth_limit ||
+                state->depth() < state->depth_limit) &&
+               !branch.node->children.empty()) {
+      branch_out(end_pos, branch);
+    }
+  }
+  state->code.clear();
+}
+
+// decoded records found by recent exact lookups, keyed by code; shared by
+// the user dictionaries of a db and bounded by an approximate memory budget.
+class UserDictCache {
+ public:
+  struct Lookup {
+    vector<pair<string, UserDbValue>> records;
+    string resume_key;
+  };
+
+  UserDictCache(const string& name, size_t budget)
+      : budget_(budget),
+        memory_stats_([this, name](vector<MemoryUsage>* usages) {
+          MemoryUsage usage;
+          usage.category = "user_dict_cache";
+          usage.name = name;
+          std::lock_guard<std::mutex> lock(mutex_);
+          usage.heap_bytes = size_;
+          usage.count = items_.size();
+          usages->push_back(std::move(usage));
+        }),
+        memory_budget_("user_dict_cache: " + name,
+                       {[this] {
+                          std::lock_guard<std::mutex> lock(mutex_);
+                          return size_;
+                        },
+                        [this] {
+                          // hits per kilobyte since last asked
+                          std::lock_guard<std::mutex> lock(mutex_);
+                          double benefit = size_ ? hits_ * 1024.0 / size_ : 0;
+                          hits_ = 0;
+                          return benefit;
+                        },
+                        [this](size_t bytes) {
+                          std::lock_guard<std::mutex> lock(mutex_);
+                          while (size_ > bytes) {
+                            Erase(items_.back().code);
+                          }
+                        }}) {}
+
+  an<const Lookup> Find(const string& code) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = index_.find(code);
+    if (found == index_.end())
+      return nullptr;
+    items_.splice(items_.begin(), items_, found->second);
+    ++hits_;
+    return found->second->lookup;
+  }
+
+  void Insert(const string& code, an<const Lookup> lookup) {
+    size_t size = SizeOf(code, *lookup);
+    if (size > budget_)
+      return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    Erase(code);
+    items_.push_front({code, std::move(lookup), size});
+    index_[code] = items_.begin();
+    size_ += size;
+    while (size_ > budget_) {
+      Erase(items_.back().code);
+    }
+  }
+
+  void Invalidate(const string& code) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Erase(code);
+  }
+
+  void Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    items_.clear();
+    index_.clear();
+    size_ = 0;
+  }
+
+ private:
+  struct Item {
+    string code;
+    an<const Lookup> lookup;
+    size_t size;
+  };
+
+  static size_t SizeOf(const string& code, const Lookup& lookup) {
+    size_t size = sizeof(Item) + 2 * code.length() + lookup.resume_key.length();
+    for (const auto& record : lookup.records) {
+      size += sizeof(record) + record.first.length();
+    }
+    return size;
+  }
+
+  void Erase(const string& code) {
+    auto found = index_.find(code);
+    if (found == index_.end())
+      return;
+    size_ -= found->second->size;
+    items_.erase(found->second);
+    index_.erase(found);
+  }
+
+  size_t budget_;
+  size_t size_ = 0;
+  uint64_t hits_ = 0;
+  std::mutex mutex_;
+  // most recently used first
+  list<Item> items_;
+  hash_map<string, list<Item>::iterator> index_;
+  // dropped before the items they report on.
+  MemoryStatsRegistration memory_stats_;
+  MemoryBudgetRegistration memory_budget_;
+};
+
+// user dictionaries sharing a db, as do those of all sessions with the same
+// schema, share its index and cache. the index is built for the syllabary of
+// the table attached to the first one; others fall back to scanning the db.
+// the data is kept by db name, which names the files of the db, while any
+// dictionary uses it; a db opened again after that starts over.
+struct SharedUserDictData {
+  const Table* table = nullptr;
+  weak<UserDictIndex> index;
+  weak<UserDictCache> cache;
+};
+
+static std::mutex shared_data_mutex;
+static map<string, SharedUserDictData> shared_data;
+
+static void release_shared_data(const string& db_name) {
+  std::lock_guard<std::mutex> lock(shared_data_mutex);
+  auto found = shared_data.find(db_name);
+  if (found != shared_data.end() && found->second.index.expired() &&
+      found->second.cache.expired()) {
+    shared_data.erase(found);
+  }
+}
+
+static an<UserDictIndex> find_shared_index(const string& db_name) {
+  std::lock_guard<std::mutex> lock(shared_data_mutex);
+  auto found = shared_data.find(db_name);
+  return found != shared_data.end() ? found->second.index.lock() : nullptr;
+}
+
+static an<UserDictCache> find_shared_cache(const string& db_name) {
+  std::lock_guard<std::mutex> lock(shared_data_mutex);
+  auto found = shared_data.find(db_name);
+  return found != shared_data.end() ? found->second.cache.lock() : nullptr;
+}
+
+an<UserDictCache> UserDictionary::AcquireCache() {
+  // the standby db is looked up as it is, without a cache.
+  if (serving_db() != db_.get())
+    return nullptr;
+  if (!cache_ && cache_budget_ > 0) {
+    std::lock_guard<std::mutex> lock(shared_data_mutex);
+    auto& shared = shared_data[db_->name()];
+    cache_ = shared.cache.lock();
+    if (!cache_) {
+      cache_ = New<UserDictCache>(db_->name(), cache_budget_);
+      shared.cache = cache_;
+    }
+  }
+  return cache_;
+}
+
+an<UserDictIndex> UserDictionary::AcquireIndex() {
+  if (serving_db() != db_.get())
+    return nullptr;
+  if (!index_) {
+    std::lock_guard<std::mutex> lock(shared_data_mutex);
+    auto& shared = shared_data[db_->name()];
+    if (auto index = shared.index.lock()) {
+      if (shared.table != table_.get())
+        return nullptr;
+      index_ = index;
+    } else {
+      if (!syllabary_) {
+        LOG(ERROR) << "failed to get syllabary for user dict: " << name();
+        return nullptr;
+      }
+      index_ = New<UserDictIndex>(syllabary_);
+      shared.table = table_.get();
+      shared.index = index_;
+    }
+  }
+  // loaded once, by the first to get here; the others wait for it on the
+  // lock of the index rather than shared_data_mutex.
+  if (!index_->loaded() && !index_->Load(db_.get())) {
+    LOG(ERROR) << "failed to index user dict: " << name();
+    return nullptr;
+  }
+  return index_;
 }
 
 an<UserDictEntryCollector> UserDictionary::Lookup(
@@ -308,42 +750,98 @@ an<UserDictEntryCollector> UserDictionary::Lookup(
     size_t start_pos,
     size_t depth_limit,
     size_t predict_word_from_depth,
-    double initial_credibility) {
+    double initial_credibility,
+    an<Arena> arena) {
   if (!table_ || !prism_ || !loaded() ||
       start_pos >= syll_graph.interpreted_length)
     return nullptr;
+  Sync();
   DfsState state;
+  state.arena = std::move(arena);
   state.depth_limit = depth_limit;
   state.predict_word_from_depth = predict_word_from_depth;
+  state.node_budget = lookup_budget_;
+  if (lookup_time_limit_ > 0) {
+    state.has_deadline = true;
+    state.deadline = std::chrono::steady_clock::now() +
+                     std::chrono::microseconds(lookup_time_limit_);
+  }
   FetchTickCount();
   state.present_tick = tick_ + 1;
   state.credibility.push_back(initial_credibility);
-  state.accessor = db_->Query("");
-  state.accessor->Jump(" ");  // skip metadata
-  string prefix;
-  DfsLookup(syll_graph, start_pos, prefix, &state);
+  state.is_correction.push_back(false);
+  state.query_result.reserve(syll_graph.interpreted_length + 1);
+  if (auto index = AcquireIndex()) {
+    std::shared_lock<std::shared_mutex> lock(index->mutex());
+    BestFirstLookup(syll_graph, start_pos, *index, &state);
+  } else {
+    state.accessor = serving_db()->Query("");
+    state.accessor->Jump(" ");  // skip metadata
+    PerfCounters::Count(PerfCounters::kUserDbSeeks);
+    string prefix;
+    DfsLookup(syll_graph, start_pos, prefix, &state);
+  }
+  if (state.pruned) {
+    DLOG(INFO) << "user dict lookup pruned after " << state.nodes_visited
+               << " branches.";
+    PerfCounters::Count(PerfCounters::kUserDictLookupsPruned);
+  }
   if (state.query_result.empty())
     return nullptr;
-  // sort each group of homophones by weight
+  auto result = New<UserDictEntryCollector>();
+  result->reserve(syll_graph.interpreted_length + 1);
   for (auto& v : state.query_result) {
     auto& entries = v.second;
-    entries.Sort();
+    size_t unordered_start = 0;
     if (state.predict_word_from_depth) {
-      if (!entries.empty() && entries.front()->IsPredictiveMatch()) {
-        DLOG(INFO) << "front entry is predictive match: "
-                   << entries.front()->text;
-        auto found =
-            std::find_if(entries.begin(), entries.end(),
-                         [](const auto& e) { return e->IsExactMatch(); });
-        if (found != entries.end()) {
-          DLOG(INFO) << "rotating exact match entry to front: "
-                     << (*found)->text;
-          std::rotate(entries.begin(), found, found + 1);
+      // an exact match goes before predictive matches of greater weight.
+      auto best = std::min_element(
+          entries.begin(), entries.end(),
+          [](const auto& x, const auto& y) { return *x < *y; });
+      if (best != entries.end() && (*best)->IsPredictiveMatch()) {
+        DLOG(INFO) << "front entry is predictive match: " << (*best)->text;
+        auto best_exact = entries.end();
+        for (auto e = entries.begin(); e != entries.end(); ++e) {
+          if ((*e)->IsExactMatch() &&
+              (best_exact == entries.end() || **e < **best_exact)) {
+            best_exact = e;
+          }
+        }
+        if (best_exact != entries.end()) {
+          DLOG(INFO) << "moving exact match entry to front: "
+                     << (*best_exact)->text;
+          std::iter_swap(entries.begin(), best_exact);
+          unordered_start = 1;
         }
       }
     }
+    auto& iter = (*result)[v.first];
+    iter.SetEntries(std::move(entries));
+    // homophones are sorted by weight as they are iterated.
+    iter.SortRange(unordered_start, iter.cache_size() - unordered_start);
   }
-  return collect(&state.query_result);
+  return result;
+}
+
+// adds an entry found by UserDictionary::LookupWords.
+static bool add_word(UserDictEntryIterator* result,
+                     const string& key,
+                     const UserDbValue& value,
+                     size_t input_length,
+                     TickCount present_tick) {
+  string full_code;
+  auto e = UserDictionary::CreateDictEntry(key, value, present_tick, 1.0,
+                                           &full_code);
+  if (!e)
+    return false;
+  e->custom_code = full_code;
+  boost::trim_right(full_code);  // remove trailing space a user dict key has
+  if (full_code.length() > input_length) {
+    e->comment = "~" + full_code.substr(input_length);
+    e->remaining_code_length = full_code.length() - input_length;
+  }
+  result->Add(std::move(e));
+  return true;
 }
 
 size_t UserDictionary::LookupWords(UserDictEntryIterator* result,
@@ -351,22 +849,47 @@ size_t UserDictionary::LookupWords(UserDictEntryIterator* result,
                                    bool predictive,
                                    size_t limit,
                                    string* resume_key) {
+  Sync();
   TickCount present_tick = tick_ + 1;
   size_t len = input.length();
   size_t start = result->cache_size();
   size_t count = 0;
   size_t exact_match_count = 0;
+  // exact lookups from the beginning are served by the cache
+  bool cacheable = !predictive && (!resume_key || resume_key->empty());
+  auto cache = cacheable ? AcquireCache() : nullptr;
+  if (cache) {
+    if (auto cached = cache->Find(input)) {
+      for (const auto& record : cached->records) {
+        if (add_word(result, record.first, record.second, len, present_tick))
+          ++count;
+      }
+      if (count > 0) {
+        result->SortRange(start, count);
+      }
+      if (resume_key) {
+        *resume_key = cached->resume_key;
+      }
+      return count;
+    }
+  }
+  auto lookup = cache ? New<UserDictCache::Lookup>() : nullptr;
   const string kEnd = "\xff";
   string key;
   string value;
-  string full_code;
-  auto accessor = db_->Query(input);
+  auto accessor = serving_db()->Query(input);
+  PerfCounters::Count(PerfCounters::kUserDbSeeks);
   if (!accessor || accessor->exhausted()) {
+    if (lookup) {
+      lookup->resume_key = kEnd;
+      cache->Insert(input, lookup);
+    }
     if (resume_key)
       *resume_key = kEnd;
     return 0;
   }
   if (resume_key && !resume_key->empty()) {
+    PerfCounters::Count(PerfCounters::kUserDbSeeks);
     if (!accessor->Jump(*resume_key) ||
         !accessor->GetNextRecord(&key, &value)) {
       *resume_key = kEnd;
@@ -383,16 +906,14 @@ size_t UserDictionary::LookupWords(UserDictEntryIterator* result,
       break;
     }
     last_key = key;
-    auto e = CreateDictEntry(key, value, present_tick, 1.0, &full_code);
-    if (!e)
+    UserDbValue v;
+    if (!v.Unpack(value))
       continue;
-    e->custom_code = full_code;
-    boost::trim_right(full_code);  // remove trailing space a user dict key has
-    if (full_code.length() > len) {
-      e->comment = "~" + full_code.substr(len);
-      e->remaining_code_length = full_code.length() - len;
+    if (lookup && v.commits >= 0) {
+      lookup->records.emplace_back(key, v);
     }
-    result->Add(std::move(e));
+    if (!add_word(result, key, v, len, present_tick))
+      continue;
     ++count;
     if (is_exact_match)
       ++exact_match_count;
@@ -402,6 +923,10 @@ size_t UserDictionary::LookupWords(UserDictEntryIterator* result,
   if (exact_match_count > 0) {
     result->SortRange(start, exact_match_count);
   }
+  if (lookup) {
+    lookup->resume_key = key;
+    cache->Insert(input, lookup);
+  }
   if (resume_key) {
     *resume_key = key;
     DLOG(INFO) << "resume key reset to: " << *resume_key;
@@ -416,19 +941,42 @@ bool UserDictionary::UpdateEntry(const DictEntry& entry, int commits) {
 bool UserDictionary::UpdateEntry(const DictEntry& entry,
                                  int commits,
                                  const string& new_entry_prefix) {
+  if (!loaded() || readonly())
+    return false;
+  ++revision_;
+  // failures to write are reported by the next Sync().
+  writer_->Post([this, entry, commits, new_entry_prefix] {
+    if (!WriteEntry(entry, commits, new_entry_prefix)) {
+      LOG(ERROR) << "failed to update entry '" << entry.text
+                 << "' in user dictionary: " << name_;
+      ++failed_writes_;
+    }
+  });
+  return true;
+}
+
+bool UserDictionary::WriteEntry(const DictEntry& entry,
+                                int commits,
+                                const string& new_entry_prefix) {
   string code_str(entry.custom_code);
   if (code_str.empty() && !TranslateCodeToString(entry.code, &code_str))
     return false;
   string key(code_str + '\t' + entry.text);
   string value;
   UserDbValue v;
+  PerfCounters::Count(PerfCounters::kUserDbSeeks);
   if (db_->Fetch(key, &value)) {
+    if (recording_)
+      undo_log_.emplace(key, value);
     v.Unpack(value);
     if (v.tick > tick_) {
       v.tick = tick_;  // fix abnormal timestamp
     }
-  } else if (!new_entry_prefix.empty()) {
-    key.insert(0, new_entry_prefix);
+  } else {
+    if (!new_entry_prefix.empty())
+      key.insert(0, new_entry_prefix);
+    if (recording_)
+      undo_log_.emplace(key, std::nullopt);
   }
   if (commits > 0) {
     if (v.commits < 0)
@@ -444,13 +992,25 @@ bool UserDictionary::UpdateEntry(const DictEntry& entry,
     v.dee = algo::formula_d(0.0, (double)tick_, v.dee, (double)v.tick);
   }
   v.tick = tick_;
-  return db_->Update(key, v.Pack());
+  value = v.PackFor(db_.get());
+  if (!db_->Update(key, value))
+    return false;
+  if (auto index = find_shared_index(db_->name())) {
+    index->Update(key, value);
+  }
+  if (auto cache = find_shared_cache(db_->name())) {
+    // exact lookups are keyed by code without the trailing space
+    string code = key.substr(0, key.find('\t'));
+    boost::trim_right(code);
+    cache->Invalidate(code);
+  }
+  return true;
 }
 
 bool UserDictionary::UpdateTickCount(TickCount increment) {
   tick_ += increment;
   try {
-    return db_->MetaUpdate("/tick", std::to_string(tick_));
+    return db_->MetaUpdate("/tick", std::to_string(tick_.load()));
   } catch (...) {
     return false;
   }
@@ -464,7 +1024,8 @@ bool UserDictionary::FetchTickCount() {
   string value;
   try {
     // an earlier version mistakenly wrote tick count into an empty key
-    if (!db_->MetaFetch("/tick", &value) && !db_->Fetch("", &value))
+    Db* db = serving_db();
+    if (!db->MetaFetch("/tick", &value) && !db->Fetch("", &value))
       return false;
     tick_ = std::stoul(value);
     return true;
@@ -474,41 +1035,85 @@ bool UserDictionary::FetchTickCount() {
   }
 }
 
+// transactions are kept by the dictionary rather than the db, whose
+// uncommitted writes are only seen by the thread making them.
 bool UserDictionary::NewTransaction() {
-  auto db = As<Transactional>(db_);
-  if (!db)
+  if (!loaded() || readonly())
     return false;
   CommitPendingTransaction();
+  in_transaction_ = true;
   transaction_time_ = time(NULL);
-  return db->BeginTransaction();
+  writer_->Post([this] { BeginRecording(); });
+  return true;
 }
 
 bool UserDictionary::RevertRecentTransaction() {
-  auto db = As<Transactional>(db_);
-  if (!db || !db->in_transaction())
+  if (!in_transaction_)
     return false;
   if (time(NULL) - transaction_time_ > 3 /*seconds*/)
     return false;
-  return db->AbortTransaction();
+  in_transaction_ = false;
+  Sync();
+  bool success = true;
+  for (const auto& record : undo_log_) {
+    if (record.second ? !db_->Update(record.first, *record.second)
+                      : !db_->Erase(record.first))
+      success = false;
+  }
+  tick_ = transaction_tick_;
+  UpdateTickCount(0);
+  EndRecording();
+  ++revision_;
+  // the index and cache have seen the reverted updates
+  if (auto index = find_shared_index(db_->name())) {
+    index->Invalidate();
+  }
+  if (auto cache = find_shared_cache(db_->name())) {
+    cache->Clear();
+  }
+  return success;
 }
 
 bool UserDictionary::CommitPendingTransaction() {
-  auto db = As<Transactional>(db_);
-  if (db && db->in_transaction()) {
-    return db->CommitTransaction();
+  if (!in_transaction_)
+    return false;
+  in_transaction_ = false;
+  writer_->Post([this] { EndRecording(); });
+  return true;
+}
+
+bool UserDictionary::Sync() {
+  writer_->Sync();
+  return failed_writes_.exchange(0) == 0;
+}
+
+bool UserDictionary::Flush() {
+  bool success = Sync();
+  if (loaded()) {
+    if (auto db = As<Transactional>(db_)) {
+      success = db->FlushPendingWrites() && success;
+    }
   }
-  return false;
+  return success;
+}
+
+void UserDictionary::BeginRecording() {
+  recording_ = true;
+  undo_log_.clear();
+  transaction_tick_ = tick_;
+}
+
+void UserDictionary::EndRecording() {
+  recording_ = false;
+  undo_log_.clear();
 }
 
 bool UserDictionary::TranslateCodeToString(const Code& code, string* result) {
-  if (!table_ || !result)
+  if (!syllabary_ || !result)
     return false;
   result->clear();
   for (const SyllableId& syllable_id : code) {
-    string spelling = rev_syllabary_.count(syllable_id)
-                          ? rev_syllabary_[syllable_id]
-                          : (rev_syllabary_[syllable_id] =
-                                 table_->GetSyllableById(syllable_id));
+    const string& spelling = syllabary_->spelling(syllable_id);
     if (spelling.empty()) {
       LOG(ERROR) << "Error translating syllable_id '" << syllable_id << "'.";
       result->clear();
@@ -524,20 +1129,30 @@ an<DictEntry> UserDictionary::CreateDictEntry(const string& key,
                                               const string& value,
                                               TickCount present_tick,
                                               double credibility,
-                                              string* full_code) {
+                                              string* full_code,
+                                              const an<Arena>& arena) {
+  UserDbValue v;
+  if (!v.Unpack(value))
+    return nullptr;
+  return CreateDictEntry(key, v, present_tick, credibility, full_code, arena);
+}
+
+an<DictEntry> UserDictionary::CreateDictEntry(const string& key,
+                                              UserDbValue v,
+                                              TickCount present_tick,
+                                              double credibility,
+                                              string* full_code,
+                                              const an<Arena>& arena) {
   an<DictEntry> e;
   size_t separator_pos = key.find('\t');
   if (separator_pos == string::npos)
     return e;
-  UserDbValue v;
-  if (!v.Unpack(value))
-    return e;
   if (v.commits < 0)  // deleted entry
     return e;
   if (v.tick < present_tick)
     v.dee = algo::formula_d(0, (double)present_tick, v.dee, (double)v.tick);
   // create!
-  e = New<DictEntry>();
+  e = NewIn<DictEntry>(arena);
   e->text = key.substr(separator_pos + 1);
   e->commit_count = v.commits;
   // TODO: argument s not defined...
@@ -560,6 +1175,7 @@ UserDictionaryComponent::UserDictionaryComponent() {}
 
 UserDictionary* UserDictionaryComponent::Create(const string& dict_name,
                                                 const string& db_class) {
+  std::lock_guard<std::mutex> lock(db_pool_mutex_);
   auto db = db_pool_[dict_name].lock();
   if (!db) {
     auto component = Db::Require(db_class);
@@ -597,7 +1213,26 @@ UserDictionary* UserDictionaryComponent::Create(const Ticket& ticket) {
     // user specified db class
   }
   // obtain userdb object
-  return Create(dict_name, db_class);
+  UserDictionary* user_dict = Create(dict_name, db_class);
+  int cache_budget = 0;
+  if (user_dict && config->GetInt(ticket.name_space + "/user_dict_cache_size",
+                                  &cache_budget)) {
+    user_dict->set_cache_budget(cache_budget > 0 ? cache_budget : 0);
+  }
+  int lookup_budget = 0;
+  if (user_dict &&
+      config->GetInt(ticket.name_space + "/user_dict_lookup_budget",
+                     &lookup_budget)) {
+    user_dict->set_lookup_budget(lookup_budget > 0 ? lookup_budget : 0);
+  }
+  int lookup_time_limit = 0;
+  if (user_dict &&
+      config->GetInt(ticket.name_space + "/user_dict_lookup_time_limit",
+                     &lookup_time_limit)) {
+    user_dict->set_lookup_time_limit(
+        lookup_time_limit > 0 ? lookup_time_limit : 0);
+  }
+  return user_dict;
 }
 
 }  // namespace rime
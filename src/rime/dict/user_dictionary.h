@@ -8,9 +8,14 @@
 #define RIME_USER_DICTIONARY_H_
 
 #include <time.h>
+#include <atomic>
+#include <mutex>
+#include <optional>
+#include <rime/arena.h>
 #include <rime/common.h>
 #include <rime/component.h>
 #include <rime/dict/user_db.h>
+#include <rime/dict/user_dict_index.h>
 #include <rime/dict/vocabulary.h>
 
 namespace rime {
@@ -21,6 +26,8 @@ class UserDictEntryIterator : public DictEntryFilterBinder {
 
   void Add(an<DictEntry>&& entry);
   void SetEntries(DictEntryList&& entries);
+  // the entries in range are put in order as the iterator moves to them,
+  // a page at a time; most of them are never shown.
   void SortRange(size_t start, size_t count);
 
   void AddFilter(DictEntryFilter filter) override;
@@ -31,12 +38,24 @@ class UserDictEntryIterator : public DictEntryFilterBinder {
 
  protected:
   bool FindNextEntry();
+  // makes sure the entries up to index are in order.
+  void OrderUpTo(size_t index);
+
+  // entries ordered at a time, as many as a page or two.
+  static const size_t kSortBatchSize = 16;
+
+  struct UnorderedRange {
+    // entries before sorted_end are in order.
+    size_t sorted_end;
+    size_t end;
+  };
 
   DictEntryList cache_;
   size_t index_ = 0;
+  vector<UnorderedRange> unordered_ranges_;
 };
 
-using UserDictEntryCollector = map<size_t, UserDictEntryIterator>;
+using UserDictEntryCollector = EndPosMap<UserDictEntryIterator>;
 
 class Schema;
 class Table;
@@ -44,15 +63,22 @@ class Prism;
 class Db;
 struct SyllableGraph;
 struct DfsState;
+class UserDictCache;
+class UserDictWriter;
 struct Ticket;
 
 class UserDictionary : public Class<UserDictionary, const Ticket&> {
  public:
+  static const size_t kDefaultCacheBudget = 1024 * 1024;
+  static const size_t kDefaultLookupBudget = 4096;
+
   UserDictionary(const string& name, an<Db> db);
   virtual ~UserDictionary();
 
   void Attach(const an<Table>& table, const an<Prism>& prism);
   bool Load();
+  // builds the index of the loaded user dict ahead of the first lookup.
+  void WarmUp();
   bool loaded() const;
   bool readonly() const;
 
@@ -60,12 +86,15 @@ class UserDictionary : public Class<UserDictionary, const Ticket&> {
                                     size_t start_pos,
                                     size_t depth_limit = 0,
                                     size_t predict_word_from_depth = 0,
-                                    double initial_credibility = 0.0);
+                                    double initial_credibility = 0.0,
+                                    an<Arena> arena = nullptr);
   size_t LookupWords(UserDictEntryIterator* result,
                      const string& input,
                      bool predictive,
                      size_t limit = 0,
                      string* resume_key = NULL);
+  // updates are queued and written to the db in order on a worker thread;
+  // lookups wait for those still being written.
   bool UpdateEntry(const DictEntry& entry, int commits);
   bool UpdateEntry(const DictEntry& entry,
                    int commits,
@@ -75,34 +104,92 @@ class UserDictionary : public Class<UserDictionary, const Ticket&> {
   bool NewTransaction();
   bool RevertRecentTransaction();
   bool CommitPendingTransaction();
+  // waits for the queued updates to be written; returns false if any of
+  // them has failed since last synced.
+  bool Sync();
+  // writes the queued updates through to storage.
+  bool Flush();
 
   const string& name() const { return name_; }
   TickCount tick() const { return tick_; }
+  // counts the changes made through the dictionary, by which callers tell
+  // whether lookup results they keep are still current.
+  uint64_t revision() const { return revision_; }
 
   static an<DictEntry> CreateDictEntry(const string& key,
                                        const string& value,
                                        TickCount present_tick,
                                        double credibility = 0.0,
-                                       string* full_code = nullptr);
+                                       string* full_code = nullptr,
+                                       const an<Arena>& arena = nullptr);
+  static an<DictEntry> CreateDictEntry(const string& key,
+                                       UserDbValue value,
+                                       TickCount present_tick,
+                                       double credibility = 0.0,
+                                       string* full_code = nullptr,
+                                       const an<Arena>& arena = nullptr);
+
+  // memory budget in bytes for the cache of exact word lookups, shared by
+  // the user dictionaries of the db; 0 disables the cache.
+  void set_cache_budget(size_t budget) { cache_budget_ = budget; }
+  // branches of the syllable graph to follow in each lookup of phrases,
+  // the most credible first; 0 for no limit.
+  void set_lookup_budget(size_t budget) { lookup_budget_ = budget; }
+  // time in microseconds each lookup of phrases may take; 0 for no limit.
+  void set_lookup_time_limit(int64_t microseconds) {
+    lookup_time_limit_ = microseconds;
+  }
 
  protected:
   bool Initialize();
   bool FetchTickCount();
+  // opens the last snapshot of the db read-only, to serve lookups while the
+  // db is being recovered.
+  bool OpenStandbyDb();
+  // the db serving lookups: the standby db while the db is being recovered.
+  Db* serving_db() const;
   bool TranslateCodeToString(const Code& code, string* result);
   void DfsLookup(const SyllableGraph& syll_graph,
                  size_t current_pos,
                  const string& current_prefix,
                  DfsState* state);
+  void BestFirstLookup(const SyllableGraph& syll_graph,
+                       size_t start_pos,
+                       const UserDictIndex& index,
+                       DfsState* state);
+  an<UserDictIndex> AcquireIndex();
+  an<UserDictCache> AcquireCache();
+  // the following run on the writer.
+  bool WriteEntry(const DictEntry& entry,
+                  int commits,
+                  const string& new_entry_prefix);
+  void BeginRecording();
+  void EndRecording();
 
  private:
   string name_;
   an<Db> db_;
+  an<Db> standby_db_;
   an<Table> table_;
   an<Prism> prism_;
-  hash_map<string, SyllableId> syllabary_;
-  hash_map<SyllableId, string> rev_syllabary_;
-  TickCount tick_ = 0;
+  an<const DenseSyllabary> syllabary_;
+  an<UserDictIndex> index_;
+  an<UserDictCache> cache_;
+  size_t cache_budget_ = kDefaultCacheBudget;
+  size_t lookup_budget_ = kDefaultLookupBudget;
+  int64_t lookup_time_limit_ = 0;
+  // advanced by the writer, and read by lookups on the input thread.
+  std::atomic<TickCount> tick_{0};
+  uint64_t revision_ = 0;
+  an<UserDictWriter> writer_;
+  std::atomic<int> failed_writes_{0};
+  bool in_transaction_ = false;
   time_t transaction_time_ = 0;
+  // previous values of the records written in the current transaction, so
+  // that it can be reverted; nullopt for records that did not exist.
+  bool recording_ = false;
+  map<string, std::optional<string>> undo_log_;
+  TickCount transaction_tick_ = 0;
 };
 
 class UserDictionaryComponent : public UserDictionary::Component {
@@ -112,6 +199,8 @@ class UserDictionaryComponent : public UserDictionary::Component {
   UserDictionary* Create(const string& dict_name, const string& db_class);
 
  private:
+  // sessions on different threads share the dbs
+  std::mutex db_pool_mutex_;
   hash_map<string, weak<Db>> db_pool_;
 };
 
@@ -12,6 +12,28 @@
 
 namespace rime {
 
+DenseSyllabary::DenseSyllabary(const Syllabary& syllabary)
+    : spellings_(syllabary.begin(), syllabary.end()) {}
+
+DenseSyllabary::DenseSyllabary(vector<string>&& spellings)
+    : spellings_(std::move(spellings)) {}
+
+SyllableId DenseSyllabary::Find(const string& spelling) const {
+  auto found =
+      std::lower_bound(spellings_.begin(), spellings_.end(), spelling);
+  if (found == spellings_.end() || *found != spelling)
+    return -1;
+  return static_cast<SyllableId>(found - spellings_.begin());
+}
+
+const string& DenseSyllabary::spelling(SyllableId syllable_id) const {
+  static const string kNoSpelling;
+  if (syllable_id < 0 ||
+      static_cast<size_t>(syllable_id) >= spellings_.size())
+    return kNoSpelling;
+  return spellings_[syllable_id];
+}
+
 bool Code::operator<(const Code& other) const {
   if (size() != other.size())
     return size() < other.size();
@@ -109,6 +131,17 @@ void DictEntryList::SortRange(size_t start, size_t count) {
   sort_range(*this, start, count);
 }
 
+void DictEntryList::PartialSortRange(size_t start,
+                                     size_t count,
+                                     size_t sorted_count) {
+  if (start >= size())
+    return;
+  auto i(begin() + start);
+  auto k(start + count >= size() ? end() : i + count);
+  auto j(sorted_count >= size_t(k - i) ? k : i + sorted_count);
+  std::partial_sort(i, j, k, dereference_less<value_type>);
+}
+
 void DictEntryFilterBinder::AddFilter(DictEntryFilter filter) {
   if (!filter_) {
     filter_.swap(filter);
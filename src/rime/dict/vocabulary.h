@@ -9,6 +9,8 @@
 #define RIME_VOCABULARY_H_
 
 #include <stdint.h>
+#include <iterator>
+#include <boost/container/small_vector.hpp>
 #include <rime_api.h>
 #include <rime/common.h>
 
@@ -18,11 +20,40 @@ using Syllabary = set<string>;
 
 using SyllableId = int32_t;
 
-class Code : public vector<SyllableId> {
+// the spellings of a syllabary in a vector indexed by syllable id.
+// syllable ids being the ranks of the spellings in the sorted syllabary,
+// the id of a spelling is found by binary search, without hashing.
+class RIME_API DenseSyllabary {
  public:
+  DenseSyllabary() = default;
+  explicit DenseSyllabary(const Syllabary& syllabary);
+  // spellings in the order of syllable ids.
+  explicit DenseSyllabary(vector<string>&& spellings);
+
+  // returns -1 if the spelling is not in the syllabary.
+  SyllableId Find(const string& spelling) const;
+  // returns an empty string for an invalid syllable id.
+  const string& spelling(SyllableId syllable_id) const;
+
+  size_t size() const { return spellings_.size(); }
+  bool empty() const { return spellings_.empty(); }
+
+ private:
+  vector<string> spellings_;
+};
+
+// codes of up to this many syllables, which are most of them, are stored
+// in place; longer codes are allocated on the heap.
+constexpr size_t kCodeInlineSize = 4;
+
+class Code
+    : public boost::container::small_vector<SyllableId, kCodeInlineSize> {
+ public:
+  using Base = boost::container::small_vector<SyllableId, kCodeInlineSize>;
+
   Code() = default;
   Code(const Code::const_iterator& begin, const Code::const_iterator& end)
-      : vector<SyllableId>(begin, end) {}
+      : Base(begin, end) {}
 
   static const size_t kIndexCodeMaxLength = 3;
 
@@ -53,6 +84,8 @@ struct DictEntry {
   int commit_count = 0;
   int remaining_code_length = 0;
   int matching_code_size = 0;
+  // found by way of a corrected spelling in the syllable graph.
+  bool is_correction = false;
 
   DictEntry() = default;
   ShortDictEntry ToShort() const { return {text, code, weight}; }
@@ -75,6 +108,9 @@ class DictEntryList : public vector<of<DictEntry>> {
  public:
   void Sort();
   void SortRange(size_t start, size_t count);
+  // puts the first sorted_count entries of the range in order, leaving the
+  // rest of the range unordered.
+  void PartialSortRange(size_t start, size_t count, size_t sorted_count);
 };
 
 using DictEntryFilter = function<bool(an<DictEntry> entry)>;
@@ -88,6 +124,139 @@ class RIME_API DictEntryFilterBinder {
   DictEntryFilter filter_;
 };
 
+// Results of a lookup keyed by the end position of their codes in the
+// input. The positions are few and small, so the results are stored in a
+// vector indexed by the position, and iterated in order of the positions
+// that have results, as in a map.
+template <class T>
+class EndPosMap {
+ public:
+  using value_type = std::pair<size_t, T>;
+
+  template <class Map, class Value>
+  class basic_iterator {
+   public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = std::pair<size_t, T>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = Value*;
+    using reference = Value&;
+
+    basic_iterator() = default;
+    basic_iterator(Map* map, size_t pos) : map_(map), pos_(pos) {}
+
+    reference operator*() const { return map_->slots_[pos_]; }
+    pointer operator->() const { return &map_->slots_[pos_]; }
+    basic_iterator& operator++() {
+      do {
+        ++pos_;
+      } while (pos_ < map_->slots_.size() && !map_->occupied_[pos_]);
+      return *this;
+    }
+    basic_iterator operator++(int) {
+      basic_iterator x = *this;
+      ++*this;
+      return x;
+    }
+    basic_iterator& operator--() {
+      do {
+        --pos_;
+      } while (!map_->occupied_[pos_]);
+      return *this;
+    }
+    basic_iterator operator--(int) {
+      basic_iterator x = *this;
+      --*this;
+      return x;
+    }
+    bool operator==(const basic_iterator& other) const {
+      return pos_ == other.pos_;
+    }
+    bool operator!=(const basic_iterator& other) const {
+      return pos_ != other.pos_;
+    }
+
+   private:
+    Map* map_ = nullptr;
+    size_t pos_ = 0;
+  };
+
+  using iterator = basic_iterator<EndPosMap, value_type>;
+  using const_iterator = basic_iterator<const EndPosMap, const value_type>;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  // makes room for results ending before end_pos.
+  void reserve(size_t end_pos) {
+    slots_.reserve(end_pos);
+    occupied_.reserve(end_pos);
+  }
+
+  T& operator[](size_t pos) {
+    while (slots_.size() <= pos) {
+      slots_.emplace_back(slots_.size(), T());
+    }
+    occupied_.resize(slots_.size(), false);
+    if (!occupied_[pos]) {
+      occupied_[pos] = true;
+      ++size_;
+    }
+    return slots_[pos].second;
+  }
+
+  iterator find(size_t pos) {
+    return count(pos) ? iterator(this, pos) : end();
+  }
+  const_iterator find(size_t pos) const {
+    return count(pos) ? const_iterator(this, pos) : end();
+  }
+  size_t count(size_t pos) const {
+    return pos < occupied_.size() && occupied_[pos] ? 1 : 0;
+  }
+
+  size_t erase(size_t pos) {
+    if (!count(pos))
+      return 0;
+    occupied_[pos] = false;
+    slots_[pos].second = T();
+    --size_;
+    return 1;
+  }
+  void clear() {
+    slots_.clear();
+    occupied_.clear();
+    size_ = 0;
+  }
+
+  bool empty() const { return size_ == 0; }
+  size_t size() const { return size_; }
+
+  iterator begin() { return iterator(this, first_pos()); }
+  iterator end() { return iterator(this, slots_.size()); }
+  const_iterator begin() const { return const_iterator(this, first_pos()); }
+  const_iterator end() const { return const_iterator(this, slots_.size()); }
+  reverse_iterator rbegin() { return reverse_iterator(end()); }
+  reverse_iterator rend() { return reverse_iterator(begin()); }
+  const_reverse_iterator rbegin() const {
+    return const_reverse_iterator(end());
+  }
+  const_reverse_iterator rend() const {
+    return const_reverse_iterator(begin());
+  }
+
+ private:
+  size_t first_pos() const {
+    size_t pos = 0;
+    while (pos < occupied_.size() && !occupied_[pos])
+      ++pos;
+    return pos;
+  }
+
+  vector<value_type> slots_;
+  vector<bool> occupied_;
+  size_t size_ = 0;
+};
+
 class Vocabulary;
 
 struct VocabularyPage {
@@ -4,13 +4,17 @@
 //
 // 2011-04-24 GONG Chen <chen.sst@gmail.com>
 //
+#include <algorithm>
 #include <cctype>
+#include <mutex>
+#include <rime/cancellation.h>
 #include <rime/common.h>
 #include <rime/composition.h>
 #include <rime/context.h>
 #include <rime/engine.h>
 #include <rime/filter.h>
 #include <rime/formatter.h>
+#include <rime/hot_log.h>
 #include <rime/key_event.h>
 #include <rime/menu.h>
 #include <rime/processor.h>
@@ -20,25 +24,58 @@
 #include <rime/switcher.h>
 #include <rime/switches.h>
 #include <rime/ticket.h>
+#include <rime/trace.h>
 #include <rime/translation.h>
 #include <rime/translator.h>
 
 namespace rime {
 
+static const SegmentTags::TagId kPlaceholderTag =
+    SegmentTags::Intern("placeholder");
+
 class ConcreteEngine : public Engine {
  public:
-  ConcreteEngine();
+  explicit ConcreteEngine(Schema* schema = nullptr);
   virtual ~ConcreteEngine();
   virtual bool ProcessKey(const KeyEvent& key_event);
+  virtual size_t ProcessKeys(const KeySequence& key_sequence,
+                             vector<bool>* results);
   virtual void ApplySchema(Schema* schema);
   virtual void CommitText(string text);
   virtual void Compose(Context* ctx);
+  virtual void Restart();
+  virtual void Hibernate();
+  virtual void FlushUserData();
+  virtual void WarmUp();
+  virtual bool AmendTranslations();
+  virtual int ProbeCandidates(const Segment& segment, int limit);
 
  protected:
+  // components made for a schema, kept for the session to switch back to.
+  struct ComponentSet {
+    // signals of the context with the slots connected by the components.
+    Context notifiers;
+    the<Schema> schema;
+    vector<of<Processor>> processors;
+    vector<of<Segmentor>> segmentors;
+    vector<of<Translator>> translators;
+    vector<of<Filter>> filters;
+    vector<of<Formatter>> formatters;
+    vector<of<Processor>> post_processors;
+  };
+
+  void ConnectContext();
+  void ActivateSchema(the<Schema> schema);
+  void SuspendComponents();
+  bool ResumeComponents(const string& schema_id);
   void InitializeComponents();
   void InitializeOptions();
   void CalculateSegmentation(Segmentation* segments);
   void TranslateSegments(Segmentation* segments);
+  // adds the translations of the segment and the filters applied to it.
+  // returns false if the translation was cut short by a newer key.
+  bool FillMenu(Menu* menu, const string& input, Segment* segment);
+  void ReportDegradation(Context* ctx);
   void FormatText(string* text);
   void OnCommit(Context* ctx);
   void OnSelect(Context* ctx);
@@ -53,14 +90,150 @@ class ConcreteEngine : public Engine {
   vector<of<Formatter>> formatters_;
   vector<of<Processor>> post_processors_;
   an<Switcher> switcher_;
+  // least recently used first.
+  vector<the<ComponentSet>> suspended_components_;
+  // menus of segments translated while editing the current composition,
+  // oldest first, to be reused for a segment of the same input and tags.
+  struct TranslatedSegment {
+    size_t start;
+    size_t end;
+    string input;
+    SegmentTags tags;
+    an<Menu> menu;
+  };
+  vector<TranslatedSegment> translated_segments_;
+  // the input and caret position last composed.
+  string composed_input_;
+  size_t composed_caret_pos_ = 0;
+  // while processing a batch of keys, the input is composed only when the
+  // composition is accessed.
+  bool deferring_compose_ = false;
+  bool composing_after_selection_ = false;
 };
 
 // implementations
 
+// engines may be built on the background thread of the engine pool;
+// the creation of components is serialized.
+static std::mutex& components_mutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+// component sets of schemas other than the active one kept per session.
+static const size_t kMaxSuspendedComponentSets = 3;
+
+// menus of earlier segments kept for reuse while editing a composition.
+static const size_t kMaxTranslatedSegments = 8;
+
+// tags given to a component in the schema, if it only works on segments of
+// these tags. components working on "abc" segments are needed right away.
+static vector<string> GetComponentTags(Config* config,
+                                       const Ticket& ticket,
+                                       bool tag_and_tags) {
+  vector<string> tags;
+  // the default name space is shared with other components.
+  if (!config || ticket.name_space == ticket.klass ||
+      ticket.name_space == "translator" || ticket.name_space == "filter")
+    return tags;
+  string tag;
+  if (tag_and_tags && config->GetString(ticket.name_space + "/tag", &tag)) {
+    tags.push_back(tag);
+  }
+  if (auto list = config->GetList(ticket.name_space + "/tags")) {
+    for (size_t i = 0; i < list->size(); ++i) {
+      if (auto value = As<ConfigValue>(list->GetAt(i)))
+        tags.push_back(value->str());
+    }
+  }
+  if (std::find(tags.begin(), tags.end(), "abc") != tags.end())
+    tags.clear();
+  return tags;
+}
+
+// a translator of segments of certain tags, created for the first of them.
+class DeferredTranslator : public Translator {
+ public:
+  DeferredTranslator(const Ticket& ticket,
+                     Translator::Component* component,
+                     const vector<string>& tags)
+      : Translator(ticket),
+        ticket_(ticket),
+        component_(component),
+        tags_(tags) {}
+
+  an<Translation> Query(const string& input, const Segment& segment) override {
+    if (!segment.HasAnyTagIn(tags_))
+      return nullptr;
+    if (!component_) {
+      return translator_ ? translator_->Query(input, segment) : nullptr;
+    }
+    {
+      std::lock_guard<std::mutex> lock(components_mutex());
+      LOG(INFO) << "creating deferred translator: " << ticket_.klass << "@"
+                << ticket_.name_space;
+      translator_.reset(component_->Create(ticket_));
+      component_ = nullptr;  // no retry
+    }
+    return translator_ ? translator_->Query(input, segment) : nullptr;
+  }
+
+ private:
+  Ticket ticket_;
+  Translator::Component* component_;
+  SegmentTags tags_;
+  the<Translator> translator_;
+};
+
+// a filter of segments of certain tags, created for the first of them.
+class DeferredFilter : public Filter {
+ public:
+  DeferredFilter(const Ticket& ticket,
+                 Filter::Component* component,
+                 const vector<string>& tags)
+      : Filter(ticket),
+        ticket_(ticket),
+        component_(component),
+        tags_(tags) {}
+
+  bool AppliesToSegment(Segment* segment) override {
+    if (!segment->HasAnyTagIn(tags_))
+      return false;
+    if (component_) {
+      std::lock_guard<std::mutex> lock(components_mutex());
+      LOG(INFO) << "creating deferred filter: " << ticket_.klass << "@"
+                << ticket_.name_space;
+      filter_.reset(component_->Create(ticket_));
+      component_ = nullptr;  // no retry
+    }
+    return filter_ && filter_->AppliesToSegment(segment);
+  }
+
+  an<Translation> Apply(an<Translation> translation,
+                        CandidateList* candidates) override {
+    return filter_ ? filter_->Apply(translation, candidates) : translation;
+  }
+
+  CandidateTransform GetCandidateTransform(
+      CandidateList* candidates) override {
+    return filter_ ? filter_->GetCandidateTransform(candidates) : nullptr;
+  }
+
+ private:
+  Ticket ticket_;
+  Filter::Component* component_;
+  SegmentTags tags_;
+  the<Filter> filter_;
+};
+
 Engine* Engine::Create() {
   return new ConcreteEngine;
 }
 
+Engine* Engine::Create(Schema* schema) {
+  return new ConcreteEngine(schema);
+}
+
 Engine::Engine() : schema_(new Schema), context_(new Context) {}
 
 Engine::~Engine() {
@@ -68,8 +241,39 @@ Engine::~Engine() {
   schema_.reset();
 }
 
-ConcreteEngine::ConcreteEngine() {
+size_t Engine::ProcessKeys(const KeySequence& key_sequence,
+                           vector<bool>* results) {
+  size_t handled = 0;
+  for (const KeyEvent& key_event : key_sequence) {
+    bool ret = ProcessKey(key_event);
+    if (ret)
+      ++handled;
+    if (results)
+      results->push_back(ret);
+  }
+  return handled;
+}
+
+ConcreteEngine::ConcreteEngine(Schema* schema) {
   LOG(INFO) << "starting engine.";
+  if (schema) {
+    schema_.reset(schema);
+  }
+  ConnectContext();
+
+  switcher_ = New<Switcher>(this);
+  // saved options should be loaded only once per input session
+  switcher_->RestoreSavedOptions();
+
+  InitializeComponents();
+  InitializeOptions();
+}
+
+ConcreteEngine::~ConcreteEngine() {
+  LOG(INFO) << "engine disposed.";
+}
+
+void ConcreteEngine::ConnectContext() {
   // receive context notifications
   context_->commit_notifier().connect([this](Context* ctx) { OnCommit(ctx); });
   context_->select_notifier().connect([this](Context* ctx) { OnSelect(ctx); });
@@ -83,47 +287,71 @@ ConcreteEngine::ConcreteEngine() {
       [this](Context* ctx, const string& property) {
         OnPropertyUpdate(ctx, property);
       });
-
-  switcher_ = New<Switcher>(this);
-  // saved options should be loaded only once per input session
-  switcher_->RestoreSavedOptions();
-
-  InitializeComponents();
-  InitializeOptions();
 }
 
-ConcreteEngine::~ConcreteEngine() {
-  LOG(INFO) << "engine disposed.";
+// the state a processor should be interested in to be passed a key.
+static int processing_state(Context* ctx) {
+  bool composing = ctx->IsComposing();
+  if (ctx->get_option("ascii_mode"))
+    return composing ? kComposingInAsciiMode : kIdleInAsciiMode;
+  return composing ? kComposing : kIdle;
 }
 
 bool ConcreteEngine::ProcessKey(const KeyEvent& key_event) {
   DLOG(INFO) << "process key: " << key_event;
   ProcessResult ret = kNoop;
+  int state = processing_state(context_.get());
   for (auto& processor : processors_) {
-    ret = processor->ProcessKeyEvent(key_event);
+    if (!(processor->interests() & state))
+      continue;
+    {
+      RIME_TRACE_SCOPE("processor", processor->name_space());
+      ret = processor->ProcessKeyEvent(key_event);
+    }
     if (ret == kRejected)
       break;
     if (ret == kAccepted)
       return true;
+    // it may have changed the state without handling the key.
+    state = processing_state(context_.get());
   }
   // record unhandled keys, eg. spaces, numbers, bksp's.
   context_->commit_history().Push(key_event);
   // post-processing
+  state = processing_state(context_.get());
   for (auto& processor : post_processors_) {
+    if (!(processor->interests() & state))
+      continue;
     ret = processor->ProcessKeyEvent(key_event);
     if (ret == kRejected)
       break;
     if (ret == kAccepted)
       return true;
+    state = processing_state(context_.get());
   }
   // notify interested parties
   context_->unhandled_key_notifier()(context_.get(), key_event);
   return false;
 }
 
+size_t ConcreteEngine::ProcessKeys(const KeySequence& key_sequence,
+                                   vector<bool>* results) {
+  deferring_compose_ = true;
+  size_t handled = Engine::ProcessKeys(key_sequence, results);
+  deferring_compose_ = false;
+  context_->ComposePending();
+  return handled;
+}
+
 void ConcreteEngine::OnContextUpdate(Context* ctx) {
   if (!ctx)
     return;
+  if (deferring_compose_ && ctx == context_.get()) {
+    // processors reading the composition before the end of the batch have
+    // it composed on demand.
+    ctx->DeferCompose([this](Context* pending) { Compose(pending); });
+    return;
+  }
   Compose(ctx);
 }
 
@@ -154,7 +382,28 @@ void ConcreteEngine::OnPropertyUpdate(Context* ctx, const string& property) {
 void ConcreteEngine::Compose(Context* ctx) {
   if (!ctx)
     return;
+  RIME_TRACE_SCOPE("engine", "compose");
+  // the composition is to be redone; segments left untranslated by a
+  // deferred update are translated along with the new ones.
+  ctx->DeferCompose(nullptr);
+  if (ctx->input().empty() ||
+      (!composing_after_selection_ && ctx->input() == composed_input_ &&
+       ctx->caret_pos() == composed_caret_pos_)) {
+    // a new composition, or one redone without editing the input, eg. when
+    // an option is changed or a candidate is deleted; translations are
+    // made anew.
+    translated_segments_.clear();
+  }
+  composed_input_ = ctx->input();
+  composed_caret_pos_ = ctx->caret_pos();
+  std::chrono::milliseconds latency_budget(schema_->latency_budget());
+  ctx->StartLatencyBudget(latency_budget);
   Composition& comp = ctx->composition();
+  // candidates are no longer fetched for a composition about to change.
+  for (Segment& segment : comp) {
+    if (segment.menu)
+      segment.menu->CancelPrefetch();
+  }
   const string active_input = ctx->input().substr(0, ctx->caret_pos());
   DLOG(INFO) << "active input: " << active_input;
   comp.Reset(active_input);
@@ -164,24 +413,39 @@ void ConcreteEngine::Compose(Context* ctx) {
     comp.Reset(ctx->input());
   }
   CalculateSegmentation(&comp);
+  if (schema_->deferred_translation()) {
+    // translated when the menu or the selected candidate is asked for.
+    ctx->DeferCompose([this, latency_budget](Context* pending) {
+      // the budget is counted from when the candidates are asked for.
+      pending->StartLatencyBudget(latency_budget);
+      TranslateSegments(&pending->composition());
+      ReportDegradation(pending);
+    });
+    return;
+  }
   TranslateSegments(&comp);
-  DLOG(INFO) << "composition: [" << comp.GetDebugText() << "]";
+  ReportDegradation(ctx);
+  RIME_HOT_LOG(Engine) << "composition: [" << comp.GetDebugText() << "]";
 }
 
 void ConcreteEngine::CalculateSegmentation(Segmentation* segments) {
-  DLOG(INFO) << "CalculateSegmentation, segments: " << segments->size()
-             << ", finished? " << segments->HasFinishedSegmentation();
+  // segments ending before the edited position have been kept by Reset();
+  // segmentation resumes from the first segment touched by the edit.
+  RIME_HOT_LOG(Engine) << "CalculateSegmentation, segments: "
+                       << segments->size() << ", finished? "
+                       << segments->HasFinishedSegmentation();
   while (!segments->HasFinishedSegmentation()) {
     size_t start_pos = segments->GetCurrentStartPosition();
     size_t end_pos = segments->GetCurrentEndPosition();
-    DLOG(INFO) << "start pos: " << start_pos;
-    DLOG(INFO) << "end pos: " << end_pos;
+    RIME_HOT_LOG(Engine) << "start pos: " << start_pos;
+    RIME_HOT_LOG(Engine) << "end pos: " << end_pos;
     // recognize a segment by calling the segmentors in turn
     for (auto& segmentor : segmentors_) {
+      RIME_TRACE_SCOPE("segmentor", segmentor->name_space());
       if (!segmentor->Proceed(segments))
         break;
     }
-    DLOG(INFO) << "segmentation: " << *segments;
+    RIME_HOT_LOG(Engine) << "segmentation: " << *segments;
     // no advancement
     if (start_pos == segments->GetCurrentEndPosition())
       break;
@@ -194,42 +458,130 @@ void ConcreteEngine::CalculateSegmentation(Segmentation* segments) {
       segments->Forward();
   }
   // start an empty segment only at the end of a confirmed composition.
-  if (!segments->empty() && !segments->back().HasTag("placeholder"))
+  if (!segments->empty() && !segments->back().HasTag(kPlaceholderTag))
     segments->Trim();
   if (!segments->empty() && segments->back().status >= Segment::kSelected)
     segments->Forward();
 }
 
+bool ConcreteEngine::AmendTranslations() {
+  bool arrived = false;
+  for (auto& translator : translators_) {
+    arrived = translator->TakeArrivals() || arrived;
+  }
+  if (arrived)
+    context_->RefreshNonConfirmedComposition();
+  return arrived;
+}
+
+int ConcreteEngine::ProbeCandidates(const Segment& segment, int limit) {
+  Segment probed(segment);
+  for (auto& filter : filters_) {
+    if (filter->AppliesToSegment(&probed) && !filter->KeepsCandidateCount())
+      return -1;
+  }
+  string input =
+      context_->input().substr(segment.start, segment.end - segment.start);
+  int count = 0;
+  for (auto& translator : translators_) {
+    int n = translator->ProbeCandidates(input, segment, limit);
+    if (n < 0)
+      return -1;
+    // candidates of different translators may turn out to be the same.
+    if (n > 0 && count > 0)
+      return -1;
+    count += n;
+  }
+  return count;
+}
+
+void ConcreteEngine::ReportDegradation(Context* ctx) {
+  // for the frontend to tell whether the candidates could be refined later.
+  string degraded = ctx->degraded() ? "1" : "";
+  if (ctx->get_property("_degraded") != degraded)
+    ctx->set_property("_degraded", degraded);
+}
+
 void ConcreteEngine::TranslateSegments(Segmentation* segments) {
-  DLOG(INFO) << "TranslateSegments: " << *segments;
+  RIME_HOT_LOG(Engine) << "TranslateSegments: " << *segments;
   for (Segment& segment : *segments) {
-    DLOG(INFO) << "segment [" << segment.start << ", " << segment.end
-               << "), status: " << segment.status;
+    RIME_HOT_LOG(Engine) << "segment [" << segment.start << ", " << segment.end
+                         << "), status: " << segment.status;
     if (segment.status >= Segment::kGuess)
       continue;
     size_t len = segment.end - segment.start;
     string input = segments->input().substr(segment.start, len);
-    DLOG(INFO) << "translating segment: [" << input << "]";
-    auto menu = New<Menu>();
-    for (auto& translator : translators_) {
-      auto translation = translator->Query(input, segment);
-      if (!translation)
-        continue;
-      if (translation->exhausted()) {
-        DLOG(INFO) << translator->name_space() << " made a futile translation.";
-        continue;
-      }
-      menu->AddTranslation(translation);
+    auto reusable = std::find_if(
+        translated_segments_.begin(), translated_segments_.end(),
+        [&](const TranslatedSegment& x) {
+          return x.start == segment.start && x.end == segment.end &&
+                 x.input == input && x.tags == segment.tags;
+        });
+    if (reusable != translated_segments_.end()) {
+      RIME_HOT_LOG(Engine) << "reusing translations of segment: [" << input
+                           << "]";
+      segment.status = Segment::kGuess;
+      segment.menu = reusable->menu;
+      segment.selected_index = 0;
+      continue;
     }
-    for (auto& filter : filters_) {
-      if (filter->AppliesToSegment(&segment)) {
-        menu->AddFilter(filter.get());
-      }
+    RIME_HOT_LOG(Engine) << "translating segment: [" << input << "]";
+    auto menu = New<Menu>();
+    menu->set_prefetch_next_page(schema_->prefetch_next_page());
+    // translations that fill none of the pages to be shown are released.
+    menu->set_dormancy_threshold(schema_->page_size() * schema_->max_pages());
+    bool complete = FillMenu(menu.get(), input, &segment);
+    if (int retained_pages = schema_->retained_pages()) {
+      // menus live no longer than the context of the engine.
+      Segment query = segment;
+      query.menu.reset();
+      menu->set_retention(retained_pages,
+                          [this, input, query](Menu* menu) mutable {
+                            FillMenu(menu, input, &query);
+                          });
     }
     segment.status = Segment::kGuess;
     segment.menu = menu;
     segment.selected_index = 0;
+    if (!complete) {
+      // the menu is not to be reused, for the newer key to translate anew.
+      continue;
+    }
+    if (translated_segments_.size() >= kMaxTranslatedSegments) {
+      translated_segments_.erase(translated_segments_.begin());
+    }
+    translated_segments_.push_back(
+        {segment.start, segment.end, input, segment.tags, menu});
+  }
+}
+
+bool ConcreteEngine::FillMenu(Menu* menu,
+                              const string& input,
+                              Segment* segment) {
+  for (auto& translator : translators_) {
+    if (Cancellation::Requested()) {
+      RIME_HOT_LOG(Engine) << "translation cancelled by a newer key.";
+      break;
+    }
+    RIME_TRACE_SCOPE("translator", translator->name_space());
+    auto translation = translator->Query(input, *segment);
+    if (!translation)
+      continue;
+    if (translation->exhausted()) {
+      RIME_HOT_LOG(Engine) << translator->name_space()
+                           << " made a futile translation.";
+      continue;
+    }
+    menu->AddTranslation(translation);
+  }
+  for (auto& filter : filters_) {
+    if (filter->AppliesToSegment(segment)) {
+      RIME_TRACE_SCOPE("filter", filter->name_space());
+      menu->AddFilter(filter.get());
+    }
   }
+  // translators may also have left out part of their work.
+  return !Cancellation::Requested();
 }
 
 void ConcreteEngine::FormatText(string* text) {
@@ -249,6 +601,8 @@ void ConcreteEngine::CommitText(string text) {
 }
 
 void ConcreteEngine::OnCommit(Context* ctx) {
+  // the user dictionaries learn from the committed text.
+  translated_segments_.clear();
   context_->commit_history().Push(ctx->composition(), ctx->input());
   string text = ctx->GetCommitText();
   FormatText(&text);
@@ -276,7 +630,11 @@ void ConcreteEngine::OnSelect(Context* ctx) {
       // move caret to the end of input
       ctx->set_caret_pos(ctx->input().length());
     } else {
+      // the segments selected are kept with their menus; the rest of the
+      // input is segmented anew, reusing the translations made before.
+      composing_after_selection_ = true;
       Compose(ctx);
+      composing_after_selection_ = false;
     }
   }
 }
@@ -284,20 +642,128 @@ void ConcreteEngine::OnSelect(Context* ctx) {
 void ConcreteEngine::ApplySchema(Schema* schema) {
   if (!schema)
     return;
-  schema_.reset(schema);
   context_->Clear();
   context_->ClearTransientOptions();
-  InitializeComponents();
+  ActivateSchema(the<Schema>(schema));
   InitializeOptions();
   switcher_->SetActiveSchema(schema_->schema_id());
   message_sink_("schema", schema_->schema_id() + "/" + schema_->schema_name());
 }
 
+void ConcreteEngine::Restart() {
+  if (switcher_->active()) {
+    switcher_->Deactivate();
+  }
+  context_->Reset();
+  the<Schema> schema(switcher_->CreateSchema());
+  if (schema && schema->schema_id() != schema_->schema_id()) {
+    LOG(INFO) << "restarting engine with schema: " << schema->schema_id();
+    context_->ClearTransientOptions();
+    ActivateSchema(std::move(schema));
+  }
+  switcher_->RestoreSavedOptions();
+  InitializeOptions();
+}
+
+void ConcreteEngine::Hibernate() {
+  // components of other schemas are created again if switched back to.
+  suspended_components_.clear();
+  translated_segments_.clear();
+  for (auto& translator : translators_) {
+    translator->Hibernate();
+  }
+  context_->Hibernate(
+      [this](Context* ctx) { TranslateSegments(&ctx->composition()); });
+}
+
+void ConcreteEngine::FlushUserData() {
+  for (auto& translator : translators_) {
+    translator->FlushUserData();
+  }
+  for (auto& set : suspended_components_) {
+    for (auto& translator : set->translators) {
+      translator->FlushUserData();
+    }
+  }
+}
+
+void ConcreteEngine::WarmUp() {
+  for (auto& translator : translators_) {
+    translator->WarmUp();
+  }
+}
+
+void ConcreteEngine::ActivateSchema(the<Schema> schema) {
+  translated_segments_.clear();
+  // the active schema is reloaded.
+  if (schema_ && schema_->schema_id() == schema->schema_id()) {
+    schema_ = std::move(schema);
+    InitializeComponents();
+    return;
+  }
+  SuspendComponents();
+  if (ResumeComponents(schema->schema_id())) {
+    LOG(INFO) << "resumed components of schema: " << schema_->schema_id();
+    return;
+  }
+  schema_ = std::move(schema);
+  ConnectContext();
+  InitializeComponents();
+}
+
+void ConcreteEngine::SuspendComponents() {
+  auto set = std::make_unique<ComponentSet>();
+  // the suspended components no longer hear from the context.
+  context_->SwapNotifiers(&set->notifiers);
+  set->schema = std::move(schema_);
+  set->processors.swap(processors_);
+  set->segmentors.swap(segmentors_);
+  set->translators.swap(translators_);
+  set->filters.swap(filters_);
+  set->formatters.swap(formatters_);
+  set->post_processors.swap(post_processors_);
+  // a schema is only cached by its last components.
+  auto found = std::find_if(suspended_components_.begin(),
+                            suspended_components_.end(), [&](const auto& x) {
+                              return x->schema->schema_id() ==
+                                     set->schema->schema_id();
+                            });
+  if (found != suspended_components_.end()) {
+    suspended_components_.erase(found);
+  }
+  suspended_components_.push_back(std::move(set));
+  if (suspended_components_.size() > kMaxSuspendedComponentSets) {
+    suspended_components_.erase(suspended_components_.begin());
+  }
+}
+
+bool ConcreteEngine::ResumeComponents(const string& schema_id) {
+  auto found = std::find_if(
+      suspended_components_.begin(), suspended_components_.end(),
+      [&](const auto& x) { return x->schema->schema_id() == schema_id; });
+  if (found == suspended_components_.end())
+    return false;
+  auto set = std::move(*found);
+  suspended_components_.erase(found);
+  context_->SwapNotifiers(&set->notifiers);
+  schema_ = std::move(set->schema);
+  processors_.swap(set->processors);
+  segmentors_.swap(set->segmentors);
+  translators_.swap(set->translators);
+  filters_.swap(set->filters);
+  formatters_.swap(set->formatters);
+  post_processors_.swap(set->post_processors);
+  return true;
+}
+
 void ConcreteEngine::InitializeComponents() {
+  std::lock_guard<std::mutex> lock(components_mutex());
   processors_.clear();
   segmentors_.clear();
   translators_.clear();
   filters_.clear();
+  formatters_.clear();
+  post_processors_.clear();
 
   if (switcher_) {
     processors_.push_back(switcher_);
@@ -311,6 +777,10 @@ void ConcreteEngine::InitializeComponents() {
   Config* config = schema_->config();
   if (!config)
     return;
+  // translators and filters of segments of certain tags are created when
+  // such a segment is first seen.
+  bool lazy_components = true;
+  config->GetBool("engine/lazy_components", &lazy_components);
   // create processors
   if (auto processor_list = config->GetList("engine/processors")) {
     size_t n = processor_list->size();
@@ -352,7 +822,11 @@ void ConcreteEngine::InitializeComponents() {
         continue;
       Ticket ticket{this, "translator", prescription->str()};
       if (auto c = Translator::Require(ticket.klass)) {
-        an<Translator> t(c->Create(ticket));
+        auto tags = lazy_components ? GetComponentTags(config, ticket, true)
+                                    : vector<string>();
+        an<Translator> t(tags.empty()
+                             ? c->Create(ticket)
+                             : new DeferredTranslator(ticket, c, tags));
         translators_.push_back(t);
       } else {
         LOG(ERROR) << "error creating translator: '" << ticket.klass << "'";
@@ -368,7 +842,10 @@ void ConcreteEngine::InitializeComponents() {
         continue;
       Ticket ticket{this, "filter", prescription->str()};
       if (auto c = Filter::Require(ticket.klass)) {
-        an<Filter> f(c->Create(ticket));
+        auto tags = lazy_components ? GetComponentTags(config, ticket, false)
+                                    : vector<string>();
+        an<Filter> f(tags.empty() ? c->Create(ticket)
+                                  : new DeferredFilter(ticket, c, tags));
         filters_.push_back(f);
       } else {
         LOG(ERROR) << "error creating filter: '" << ticket.klass << "'";
@@ -394,9 +871,7 @@ void ConcreteEngine::InitializeComponents() {
 void ConcreteEngine::InitializeOptions() {
   LOG(INFO) << "ConcreteEngine::InitializeOptions";
   // reset custom switches
-  Config* config = schema_->config();
-  Switches switches(config);
-  switches.FindOption([this](Switches::SwitchOption option) {
+  for (const auto& option : schema_->switch_index().options()) {
     LOG(INFO) << "found switch option: " << option.option_name
               << ", reset: " << option.reset_value;
     if (option.reset_value >= 0) {
@@ -408,8 +883,7 @@ void ConcreteEngine::InitializeOptions() {
             static_cast<int>(option.option_index) == option.reset_value);
       }
     }
-    return Switches::kContinue;
-  });
+  }
 }
 
 }  // namespace rime
@@ -14,8 +14,10 @@
 namespace rime {
 
 class KeyEvent;
+class KeySequence;
 class Schema;
 class Context;
+struct Segment;
 
 class Engine : public Messenger {
  public:
@@ -23,9 +25,30 @@ class Engine : public Messenger {
 
   virtual ~Engine();
   virtual bool ProcessKey(const KeyEvent& key_event) { return false; }
+  // processes a batch of key events, returning the number of keys handled.
+  // whether each key is handled is recorded in results if given.
+  virtual size_t ProcessKeys(const KeySequence& key_sequence,
+                             vector<bool>* results);
   virtual void ApplySchema(Schema* schema) {}
   virtual void CommitText(string text) { sink_(text); }
   virtual void Compose(Context* ctx) {}
+  // starts over for a new session, as if the engine were newly created.
+  virtual void Restart() {}
+  // releases transient state such as menus and caches, which is made anew
+  // when next needed; the schema, options and input are kept.
+  virtual void Hibernate() {}
+  // writes through the user data of the translators, before the engine is
+  // left idle in the pool.
+  virtual void FlushUserData() {}
+  // pages in the resources of the schema's components, so that the first
+  // keystrokes need not wait for them; called off the input thread.
+  virtual void WarmUp() {}
+  // composes anew if candidates made off the input thread have arrived;
+  // returns true if so.
+  virtual bool AmendTranslations() { return false; }
+  // counts the candidates of a segment, up to limit, as the translators
+  // tell without making them; -1 if the count is not known in advance.
+  virtual int ProbeCandidates(const Segment& segment, int limit) { return -1; }
 
   Schema* schema() const { return schema_.get(); }
   Context* context() const { return context_.get(); }
@@ -35,6 +58,9 @@ class Engine : public Messenger {
   void set_active_engine(Engine* engine = nullptr) { active_engine_ = engine; }
 
   RIME_API static Engine* Create();
+  // creates an engine with the given schema instead of the one the switcher
+  // would choose, which is to be checked by Restart() before use.
+  RIME_API static Engine* Create(Schema* schema);
 
  protected:
   Engine();
@@ -0,0 +1,190 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <rime/context.h>
+#include <rime/engine.h>
+#include <rime/engine_pool.h>
+#include <rime/schema.h>
+#include <rime/service.h>
+
+namespace rime {
+
+EnginePool::~EnginePool() {
+  Stop();
+}
+
+the<Engine> EnginePool::Acquire() {
+  the<Engine> engine;
+  if (size_ > 0) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& engines = idle_engines_[default_schema_id_];
+    if (!engines.empty()) {
+      engine = std::move(engines.back());
+      engines.pop_back();
+    }
+  }
+  if (engine) {
+    // the default schema or saved options may have changed since.
+    engine->Restart();
+  } else {
+    engine.reset(Engine::Create());
+  }
+  if (size_ > 0) {
+    string schema_id = engine->schema()->schema_id();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      default_schema_id_ = schema_id;
+    }
+    Refill(schema_id);
+  }
+  return engine;
+}
+
+void EnginePool::Release(the<Engine> engine) {
+  if (!engine || size_ == 0)
+    return;
+  engine->context()->Reset();
+  string schema_id = engine->schema()->schema_id();
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& engines = idle_engines_[schema_id];
+  if (engines.size() < size_) {
+    engines.push_back(std::move(engine));
+  }
+}
+
+void EnginePool::Clear() {
+  map<string, vector<the<Engine>>> engines;
+  map<string, the<Engine>> warm_engines;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    engines.swap(idle_engines_);
+    warm_engines.swap(warm_engines_);
+    refills_.clear();
+    warmups_.clear();
+    ++generation_;
+  }
+  // waits for the engine being built, which is not kept.
+  Stop();
+}
+
+void EnginePool::set_size(size_t size) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_ = size;
+    for (auto& x : idle_engines_) {
+      if (x.second.size() > size)
+        x.second.resize(size);
+    }
+  }
+  if (size == 0) {
+    Clear();
+  }
+}
+
+size_t EnginePool::idle_count(const string& schema_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = idle_engines_.find(schema_id);
+  return it != idle_engines_.end() ? it->second.size() : 0;
+}
+
+void EnginePool::Refill(const string& schema_id) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (idle_engines_[schema_id].size() >= size_)
+      return;
+    refills_.insert(schema_id);
+    StartThread();
+  }
+  refill_requested_.notify_one();
+}
+
+void EnginePool::WarmUp(const string& schema_id, bool keep) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (warm_engines_.count(schema_id))
+      return;
+    warmups_[schema_id] |= keep;
+    StartThread();
+  }
+  refill_requested_.notify_one();
+}
+
+bool EnginePool::warmed_up(const string& schema_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return warm_engines_.count(schema_id) != 0;
+}
+
+void EnginePool::StartThread() {
+  if (!thread_.joinable()) {
+    stopping_ = false;
+    thread_ = std::thread([this] { Work(); });
+  }
+}
+
+void EnginePool::Work() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    refill_requested_.wait(lock, [this] {
+      return stopping_ || !refills_.empty() || !warmups_.empty();
+    });
+    if (stopping_)
+      return;
+    // sessions waiting for engines come before warm-ups.
+    if (refills_.empty()) {
+      WarmUpNext(lock);
+      continue;
+    }
+    string schema_id = *refills_.begin();
+    uint64_t generation = generation_;
+    if (idle_engines_[schema_id].size() >= size_ ||
+        Service::instance().disabled()) {
+      refills_.erase(refills_.begin());
+      continue;
+    }
+    lock.unlock();
+    the<Engine> engine(Engine::Create(new Schema(schema_id)));
+    lock.lock();
+    if (generation != generation_)
+      continue;
+    auto& engines = idle_engines_[schema_id];
+    if (engines.size() < size_)
+      engines.push_back(std::move(engine));
+  }
+}
+
+void EnginePool::WarmUpNext(std::unique_lock<std::mutex>& lock) {
+  string schema_id = warmups_.begin()->first;
+  bool keep = warmups_.begin()->second;
+  warmups_.erase(warmups_.begin());
+  uint64_t generation = generation_;
+  if (warm_engines_.count(schema_id) || Service::instance().disabled())
+    return;
+  lock.unlock();
+  the<Engine> engine(schema_id.empty()
+                         ? Engine::Create()
+                         : Engine::Create(new Schema(schema_id)));
+  engine->WarmUp();
+  schema_id = engine->schema()->schema_id();
+  DLOG(INFO) << "warmed up schema: " << schema_id;
+  // the session that asked for the warm-up holds the resources loaded.
+  if (!keep)
+    engine.reset();
+  lock.lock();
+  // the schema may have been warmed up since, if it was not named.
+  if (engine && generation == generation_ && !warm_engines_.count(schema_id))
+    warm_engines_[schema_id] = std::move(engine);
+}
+
+void EnginePool::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  refill_requested_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+}  // namespace rime
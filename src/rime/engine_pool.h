@@ -0,0 +1,87 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#ifndef RIME_ENGINE_POOL_H_
+#define RIME_ENGINE_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <rime_api.h>
+#include <rime/common.h>
+
+namespace rime {
+
+class Engine;
+
+// Engines built ahead of the sessions that use them, so that creating a
+// session does not wait for the components of its schema to be created.
+//
+// The pool keeps up to size() idle engines per schema. Engines are handed
+// out for the schema new sessions start with, and the pool is refilled for
+// that schema on a background thread. Engines of destroyed sessions are
+// returned to the pool with a cleared context.
+//
+// Schemas can also be warmed up on the background thread: an engine is
+// built for the schema and its resources are paged in, so that the first
+// keystrokes of a session do not wait for the disk.
+class RIME_API EnginePool {
+ public:
+  EnginePool() = default;
+  ~EnginePool();
+  EnginePool(const EnginePool&) = delete;
+  EnginePool& operator=(const EnginePool&) = delete;
+
+  // an engine for a new session, as if it were newly created.
+  the<Engine> Acquire();
+  // keeps the engine for another session if there is room for its schema.
+  void Release(the<Engine> engine);
+  // drops all idle engines, eg. when schemas are to be redeployed, and
+  // stops refilling until the next engine is acquired.
+  void Clear();
+
+  // idle engines kept per schema; 0 (the default) disables pooling.
+  size_t size() const { return size_; }
+  void set_size(size_t size);
+  size_t idle_count(const string& schema_id);
+
+  // warms up the schema in the background. if keep is true, the engine
+  // built is kept until the pool is cleared, holding the shared resources
+  // of the schema loaded for sessions to come; otherwise the resources
+  // stay loaded only as long as a session uses them. an empty schema id
+  // stands for the schema new sessions start with.
+  void WarmUp(const string& schema_id, bool keep = true);
+  // whether a warm engine is kept for the schema.
+  bool warmed_up(const string& schema_id);
+
+ private:
+  void Refill(const string& schema_id);
+  void StartThread();
+  void WarmUpNext(std::unique_lock<std::mutex>& lock);
+  void Work();
+  void Stop();
+
+  std::atomic<size_t> size_ = 0;
+  std::mutex mutex_;
+  std::condition_variable refill_requested_;
+  map<string, vector<the<Engine>>> idle_engines_;
+  // the schema of the last session started; new sessions are likely to
+  // start with it again.
+  string default_schema_id_;
+  // schemas to refill on the background thread.
+  set<string> refills_;
+  // schemas to warm up on the background thread, and whether to keep the
+  // engines built for them.
+  map<string, bool> warmups_;
+  map<string, the<Engine>> warm_engines_;
+  // engines built before the pool was cleared are not kept.
+  uint64_t generation_ = 0;
+  bool stopping_ = false;
+  std::thread thread_;
+};
+
+}  // namespace rime
+
+#endif  // RIME_ENGINE_POOL_H_
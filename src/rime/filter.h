@@ -12,12 +12,12 @@
 #include <rime/common.h>
 #include <rime/component.h>
 #include <rime/ticket.h>
+#include <rime/translation.h>
 
 namespace rime {
 
 class Engine;
 struct Segment;
-class Translation;
 
 class Filter : public Class<Filter, const Ticket&> {
  public:
@@ -28,7 +28,18 @@ class Filter : public Class<Filter, const Ticket&> {
   virtual an<Translation> Apply(an<Translation> translation,
                                 CandidateList* candidates) = 0;
 
+  // a filter that takes candidates one at a time, in order, may return a
+  // transform to run on each of them instead of wrapping the translation
+  // in Apply(). the menu runs the transforms of consecutive filters in a
+  // single pass. an empty transform has the translation passed to Apply().
+  virtual CandidateTransform GetCandidateTransform(CandidateList* candidates) {
+    return nullptr;
+  }
+
   virtual bool AppliesToSegment(Segment* segment) { return true; }
+  // whether each candidate is passed on, none being dropped or added, so
+  // that the candidates counted before filtering are all shown.
+  virtual bool KeepsCandidateCount() { return false; }
 
   string name_space() const { return name_space_; }
 
@@ -14,6 +14,8 @@ static const char kRimeAlphabet[] = "zyxwvutsrqponmlkjihgfedcba";
 
 namespace rime {
 
+static const SegmentTags::TagId kAbcTag = SegmentTags::Intern("abc");
+
 AbcSegmentor::AbcSegmentor(const Ticket& ticket)
     : Segmentor(ticket), alphabet_(kRimeAlphabet) {
   if (!ticket.schema)
@@ -42,6 +44,13 @@ bool AbcSegmentor::Proceed(Segmentation* segmentation) {
   size_t j = segmentation->GetCurrentStartPosition();
   size_t k = j;
   bool expecting_an_initial = true;
+  if (j == scan_start_ && scanned_input_.length() > j &&
+      input.length() >= scanned_input_.length() &&
+      input.compare(0, scanned_input_.length(), scanned_input_) == 0) {
+    // the characters typed earlier are still valid spelling.
+    k = scanned_input_.length();
+    expecting_an_initial = scan_expecting_an_initial_;
+  }
   for (; k < input.length(); ++k) {
     bool is_letter = alphabet_.find(input[k]) != string::npos;
     bool is_delimiter = (k != j) && (delimiter_.find(input[k]) != string::npos);
@@ -55,13 +64,18 @@ bool AbcSegmentor::Proceed(Segmentation* segmentation) {
     // for the next character.
     expecting_an_initial = is_final || is_delimiter;
   }
+  if (k == input.length()) {
+    scanned_input_ = input;
+    scan_start_ = j;
+    scan_expecting_an_initial_ = expecting_an_initial;
+  } else {
+    scanned_input_.clear();
+  }
   DLOG(INFO) << "[" << j << ", " << k << ")";
   if (j < k) {
     Segment segment(j, k);
-    segment.tags.insert("abc");
-    for (const string& tag : extra_tags_) {
-      segment.tags.insert(tag);
-    }
+    segment.tags.Add(kAbcTag);
+    segment.tags |= extra_tags_;
     segmentation->AddSegment(segment);
   }
   // continue this round
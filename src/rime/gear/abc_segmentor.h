@@ -7,6 +7,7 @@
 #ifndef RIME_ABC_SEGMENTOR_H_
 #define RIME_ABC_SEGMENTOR_H_
 
+#include <rime/segmentation.h>
 #include <rime/segmentor.h>
 
 namespace rime {
@@ -22,7 +23,12 @@ class AbcSegmentor : public Segmentor {
   string delimiter_;
   string initials_;
   string finals_;
-  set<string> extra_tags_;
+  SegmentTags extra_tags_;
+  // the input scanned to the end by the last call, to be resumed if the
+  // input is extended while the segment starts at the same position.
+  string scanned_input_;
+  size_t scan_start_ = 0;
+  bool scan_expecting_an_initial_ = true;
 };
 
 }  // namespace rime
@@ -12,11 +12,13 @@
 
 namespace rime {
 
+static const SegmentTags::TagId kPartialTag = SegmentTags::Intern("partial");
+static const SegmentTags::TagId kAbcTag = SegmentTags::Intern("abc");
+static const SegmentTags::TagId kPhonyTag = SegmentTags::Intern("phony");
+
 AffixSegmentor::AffixSegmentor(const Ticket& ticket)
     : Segmentor(ticket), tag_("abc") {
-  if (!ticket.schema)
-    return;
-  if (Config* config = ticket.schema->config()) {
+  if (Config* config = ticket.schema ? ticket.schema->config() : nullptr) {
     config->GetString(name_space_ + "/tag", &tag_);
     config->GetString(name_space_ + "/prefix", &prefix_);
     config->GetString(name_space_ + "/suffix", &suffix_);
@@ -30,20 +32,24 @@ AffixSegmentor::AffixSegmentor(const Ticket& ticket)
       }
     }
   }
+  tag_id_ = SegmentTags::Intern(tag_);
+  prefix_tag_id_ = SegmentTags::Intern(tag_ + "_prefix");
+  suffix_tag_id_ = SegmentTags::Intern(tag_ + "_suffix");
 }
 
 bool AffixSegmentor::Proceed(Segmentation* segmentation) {
   if (segmentation->empty())
     return true;
-  if (!segmentation->back().HasTag(tag_)) {
+  if (!segmentation->back().HasTag(tag_id_)) {
     if (segmentation->size() >= 2) {
       Segment& previous_segment(*(segmentation->rbegin() + 1));
-      if (previous_segment.HasTag("partial") && previous_segment.HasTag(tag_)) {
+      if (previous_segment.HasTag(kPartialTag) &&
+          previous_segment.HasTag(tag_id_)) {
         // the remaining part of a partial selection should inherit the tag
-        segmentation->back().tags.insert(tag_);
+        segmentation->back().tags.Add(tag_id_);
         // without adding new tag "abc"
-        if (!previous_segment.HasTag("abc")) {
-          segmentation->back().tags.erase("abc");
+        if (!previous_segment.HasTag(kAbcTag)) {
+          segmentation->back().tags.Remove(kAbcTag);
         }
       }
     }
@@ -60,9 +66,9 @@ bool AffixSegmentor::Proceed(Segmentation* segmentation) {
   // just prefix
   if (active_input.length() == prefix_.length()) {
     Segment& prefix_segment(segmentation->back());
-    prefix_segment.tags.erase(tag_);
+    prefix_segment.tags.Remove(tag_id_);
     prefix_segment.prompt = tips_;
-    prefix_segment.tags.insert(tag_ + "_prefix");
+    prefix_segment.tags.Add(prefix_tag_id_);
     DLOG(INFO) << "prefix: " << *segmentation;
     // continue this round
     return true;
@@ -72,17 +78,15 @@ bool AffixSegmentor::Proceed(Segmentation* segmentation) {
   Segment prefix_segment(j, j + prefix_.length());
   prefix_segment.status = Segment::kGuess;
   prefix_segment.prompt = tips_;
-  prefix_segment.tags.insert(tag_ + "_prefix");
-  prefix_segment.tags.insert("phony");  // do not commit raw input
+  prefix_segment.tags.Add(prefix_tag_id_);
+  prefix_segment.tags.Add(kPhonyTag);  // do not commit raw input
   segmentation->pop_back();
   segmentation->Forward();
   segmentation->AddSegment(prefix_segment);
   j += prefix_.length();
   Segment code_segment(j, k);
-  code_segment.tags.insert(tag_);
-  for (const string& tag : extra_tags_) {
-    code_segment.tags.insert(tag);
-  }
+  code_segment.tags.Add(tag_id_);
+  code_segment.tags |= extra_tags_;
   segmentation->Forward();
   segmentation->AddSegment(code_segment);
   DLOG(INFO) << "prefix+code: " << *segmentation;
@@ -97,8 +101,8 @@ bool AffixSegmentor::Proceed(Segmentation* segmentation) {
     Segment suffix_segment(k, k + suffix_.length());
     suffix_segment.status = Segment::kGuess;
     suffix_segment.prompt = closing_tips_.empty() ? tips_ : closing_tips_;
-    suffix_segment.tags.insert(tag_ + "_suffix");
-    suffix_segment.tags.insert("phony");  // do not commit raw input
+    suffix_segment.tags.Add(suffix_tag_id_);
+    suffix_segment.tags.Add(kPhonyTag);  // do not commit raw input
     segmentation->Forward();
     segmentation->AddSegment(suffix_segment);
     DLOG(INFO) << "prefix+suffix: " << *segmentation;
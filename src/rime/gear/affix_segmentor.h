@@ -7,6 +7,7 @@
 #ifndef RIME_AFFIX_SEGMENTOR_H_
 #define RIME_AFFIX_SEGMENTOR_H_
 
+#include <rime/segmentation.h>
 #include <rime/segmentor.h>
 
 namespace rime {
@@ -19,11 +20,14 @@ class AffixSegmentor : public Segmentor {
 
  protected:
   string tag_;
+  SegmentTags::TagId tag_id_ = 0;
+  SegmentTags::TagId prefix_tag_id_ = 0;
+  SegmentTags::TagId suffix_tag_id_ = 0;
   string prefix_;
   string suffix_;
   string tips_;
   string closing_tips_;
-  set<string> extra_tags_;
+  SegmentTags extra_tags_;
 };
 
 }  // namespace rime
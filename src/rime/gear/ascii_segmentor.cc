@@ -14,6 +14,8 @@
 
 namespace rime {
 
+static const SegmentTags::TagId kRawTag = SegmentTags::Intern("raw");
+
 AsciiSegmentor::AsciiSegmentor(const Ticket& ticket) : Segmentor(ticket) {}
 
 bool AsciiSegmentor::Proceed(Segmentation* segmentation) {
@@ -23,7 +25,7 @@ bool AsciiSegmentor::Proceed(Segmentation* segmentation) {
   size_t j = segmentation->GetCurrentStartPosition();
   if (j < input.length()) {
     Segment segment(j, input.length());
-    segment.tags.insert("raw");
+    segment.tags.Add(kRawTag);
     segmentation->AddSegment(segment);
   }
   return false;  // end of segmentation
@@ -0,0 +1,161 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <algorithm>
+#include <functional>
+#include <typeinfo>
+#include <rime/config.h>
+#include <rime/gear/caching_grammar.h>
+#include <rime/gear/shared_grammar.h>
+
+namespace rime {
+
+GrammarCache::GrammarCache(size_t capacity)
+    : slots_((std::max)(capacity, size_t(1))) {}
+
+GrammarCache::Key GrammarCache::MakeKey(const string& context,
+                                        const string& word,
+                                        bool is_rear) {
+  return {std::hash<string>()(context), std::hash<string>()(word), is_rear};
+}
+
+size_t GrammarCache::SlotIndex(const Key& key) const {
+  size_t seed = key.context;
+  seed ^= key.word + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+  seed ^= key.is_rear ? 1 : 0;
+  return seed % slots_.size();
+}
+
+bool GrammarCache::Find(const Key& key, double* score) {
+  size_t index = SlotIndex(key);
+  {
+    std::lock_guard<std::mutex> lock(mutexes_[index % kNumStripes]);
+    const Slot& slot = slots_[index];
+    if (slot.used && slot.key == key) {
+      *score = slot.score;
+      hits_.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  misses_.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+void GrammarCache::Insert(const Key& key, double score) {
+  size_t index = SlotIndex(key);
+  std::lock_guard<std::mutex> lock(mutexes_[index % kNumStripes]);
+  Slot& slot = slots_[index];
+  slot.key = key;
+  slot.score = score;
+  slot.used = true;
+}
+
+GrammarCache::Stats GrammarCache::stats() const {
+  Stats stats;
+  stats.hits = hits_.load(std::memory_order_relaxed);
+  stats.misses = misses_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+static std::mutex shared_caches_mutex;
+static map<string, weak<GrammarCache>> shared_caches;
+
+an<GrammarCache> GrammarCache::Shared(const string& identity,
+                                      size_t capacity) {
+  std::lock_guard<std::mutex> lock(shared_caches_mutex);
+  auto& shared = shared_caches[identity];
+  auto cache = shared.lock();
+  if (!cache) {
+    cache = New<GrammarCache>(capacity);
+    shared = cache;
+  }
+  return cache;
+}
+
+CachingGrammar::CachingGrammar(Grammar* grammar, an<GrammarCache> cache)
+    : grammar_(grammar), cache_(std::move(cache)) {}
+
+CachingGrammar::CachingGrammar(an<Grammar> grammar, an<GrammarCache> cache)
+    : grammar_(std::move(grammar)), cache_(std::move(cache)) {}
+
+double CachingGrammar::Query(const string& context,
+                             const string& word,
+                             bool is_rear) {
+  auto key = GrammarCache::MakeKey(context, word, is_rear);
+  double score;
+  if (cache_->Find(key, &score))
+    return score;
+  score = grammar_->Query(context, word, is_rear);
+  cache_->Insert(key, score);
+  return score;
+}
+
+void CachingGrammar::QueryBatch(const string& context,
+                                const vector<const string*>& words,
+                                bool is_rear,
+                                vector<double>* scores) {
+  scores->resize(words.size());
+  missed_.clear();
+  missed_keys_.clear();
+  missed_words_.clear();
+  size_t context_hash = std::hash<string>()(context);
+  for (size_t i = 0; i < words.size(); ++i) {
+    GrammarCache::Key key{context_hash, std::hash<string>()(*words[i]),
+                          is_rear};
+    if (!cache_->Find(key, &(*scores)[i])) {
+      missed_.push_back(i);
+      missed_keys_.push_back(key);
+      missed_words_.push_back(words[i]);
+    }
+  }
+  if (missed_.empty())
+    return;
+  // leave the words that are not cached to the model in one batch.
+  grammar_->QueryBatch(context, missed_words_, is_rear, &missed_scores_);
+  for (size_t j = 0; j < missed_.size(); ++j) {
+    (*scores)[missed_[j]] = missed_scores_[j];
+    cache_->Insert(missed_keys_[j], missed_scores_[j]);
+  }
+}
+
+void CachingGrammar::QueryBatch(const vector<const string*>& contexts,
+                                const vector<const string*>& words,
+                                bool is_rear,
+                                vector<double>* scores) {
+  scores->resize(contexts.size() * words.size());
+  for (size_t i = 0; i < contexts.size(); ++i) {
+    QueryBatch(*contexts[i], words, is_rear, &row_scores_);
+    std::copy(row_scores_.begin(), row_scores_.end(),
+              scores->begin() + i * words.size());
+  }
+}
+
+static an<GrammarCache> shared_cache_for(Grammar* grammar, Config* config) {
+  if (!grammar || !config)
+    return nullptr;
+  int capacity = GrammarCache::kDefaultCapacity;
+  config->GetInt("grammar/cache_size", &capacity);
+  if (capacity <= 0)
+    return nullptr;
+  // scores depend on the model and its settings.
+  if (auto* shared = dynamic_cast<SharedGrammar*>(grammar))
+    grammar = shared->model();
+  string identity = typeid(*grammar).name() + SharedGrammar::Signature(config);
+  DLOG(INFO) << "grammar cache of " << capacity << " slots.";
+  return GrammarCache::Shared(identity, capacity);
+}
+
+Grammar* CachingGrammar::Wrap(Grammar* grammar, Config* config) {
+  if (auto cache = shared_cache_for(grammar, config))
+    return new CachingGrammar(grammar, cache);
+  return grammar;
+}
+
+an<Grammar> CachingGrammar::Wrap(an<Grammar> grammar, Config* config) {
+  if (auto cache = shared_cache_for(grammar.get(), config))
+    return New<CachingGrammar>(grammar, cache);
+  return grammar;
+}
+
+}  // namespace rime
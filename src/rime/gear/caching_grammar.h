@@ -0,0 +1,114 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#ifndef RIME_CACHING_GRAMMAR_H_
+#define RIME_CACHING_GRAMMAR_H_
+
+#include <stdint.h>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <rime/gear/grammar.h>
+
+namespace rime {
+
+// A bounded cache of grammar scores, safe to share between sessions.
+// Each (context, word) pair is mapped to one slot, which keeps the score
+// last stored there.
+class GrammarCache {
+ public:
+  static constexpr size_t kDefaultCapacity = 1 << 16;
+
+  struct Key {
+    // hashes of the texts, so that keys take a fixed size.
+    size_t context;
+    size_t word;
+    bool is_rear;
+
+    bool operator==(const Key& other) const {
+      return context == other.context && word == other.word &&
+             is_rear == other.is_rear;
+    }
+  };
+
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+
+    double hit_rate() const {
+      return hits + misses ? double(hits) / (hits + misses) : 0.0;
+    }
+  };
+
+  explicit GrammarCache(size_t capacity);
+
+  static Key MakeKey(const string& context, const string& word, bool is_rear);
+
+  bool Find(const Key& key, double* score);
+  void Insert(const Key& key, double score);
+
+  size_t capacity() const { return slots_.size(); }
+  Stats stats() const;
+
+  // returns the cache shared by grammars of the same identity.
+  // the capacity is used when there is none yet.
+  static an<GrammarCache> Shared(const string& identity, size_t capacity);
+
+ private:
+  struct Slot {
+    Key key;
+    double score;
+    bool used = false;
+  };
+
+  static const size_t kNumStripes = 64;
+
+  size_t SlotIndex(const Key& key) const;
+
+  vector<Slot> slots_;
+  std::array<std::mutex, kNumStripes> mutexes_;
+  std::atomic<uint64_t> hits_{0};
+  std::atomic<uint64_t> misses_{0};
+};
+
+// Decorates a grammar with a cache of its scores.
+class CachingGrammar : public Grammar {
+ public:
+  CachingGrammar(Grammar* grammar, an<GrammarCache> cache);
+  CachingGrammar(an<Grammar> grammar, an<GrammarCache> cache);
+
+  double Query(const string& context,
+               const string& word,
+               bool is_rear) override;
+  void QueryBatch(const string& context,
+                  const vector<const string*>& words,
+                  bool is_rear,
+                  vector<double>* scores) override;
+  void QueryBatch(const vector<const string*>& contexts,
+                  const vector<const string*>& words,
+                  bool is_rear,
+                  vector<double>* scores) override;
+
+  // wraps the grammar with the cache shared by grammars of the same class
+  // and settings, sized by 'grammar/cache_size'; 0 disables the cache.
+  static Grammar* Wrap(Grammar* grammar, Config* config);
+  static an<Grammar> Wrap(an<Grammar> grammar, Config* config);
+
+  GrammarCache* cache() const { return cache_.get(); }
+
+ private:
+  // the grammar may be shared; the cache buffers below are not.
+  an<Grammar> grammar_;
+  an<GrammarCache> cache_;
+  // buffers reused to query the words missing in the cache.
+  vector<size_t> missed_;
+  vector<GrammarCache::Key> missed_keys_;
+  vector<const string*> missed_words_;
+  vector<double> missed_scores_;
+  vector<double> row_scores_;
+};
+
+}  // namespace rime
+
+#endif  // RIME_CACHING_GRAMMAR_H_
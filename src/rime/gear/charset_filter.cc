@@ -5,46 +5,111 @@
 // 2014-03-31 Chongyu Zhu <i@lembacon.com>
 //
 #include <stdint.h>  // for uint32_t
+#include <array>
 #include <utf8.h>
 #include <rime/candidate.h>
 #include <rime/common.h>
 #include <rime/context.h>
 #include <rime/engine.h>
+#include <rime/algo/strings.h>
+#include <rime/dict/dictionary.h>
 #include <rime/dict/vocabulary.h>
 #include <rime/gear/charset_filter.h>
 
 namespace rime {
 
-bool is_extended_cjk(uint32_t ch) {
-  if ((ch >= 0x3400 && ch <= 0x4DBF) ||    // CJK Unified Ideographs Extension A
-      (ch >= 0x20000 && ch <= 0x2A6DF) ||  // CJK Unified Ideographs Extension B
-      (ch >= 0x2A700 && ch <= 0x2B73F) ||  // CJK Unified Ideographs Extension C
-      (ch >= 0x2B740 && ch <= 0x2B81F) ||  // CJK Unified Ideographs Extension D
-      (ch >= 0x2B820 && ch <= 0x2CEAF) ||  // CJK Unified Ideographs Extension E
-      (ch >= 0x2CEB0 && ch <= 0x2EBEF) ||  // CJK Unified Ideographs Extension F
-      (ch >= 0x30000 && ch <= 0x3134F) ||  // CJK Unified Ideographs Extension G
-      (ch >= 0x31350 && ch <= 0x323AF) ||  // CJK Unified Ideographs Extension H
-      (ch >= 0x2EBF0 && ch <= 0x2EE5D) ||  // CJK Unified Ideographs Extension I
-      (ch >= 0x3300 && ch <= 0x33FF) ||    // CJK Compatibility
-      (ch >= 0xFE30 && ch <= 0xFE4F) ||    // CJK Compatibility Forms
-      (ch >= 0xF900 && ch <= 0xFAFF) ||    // CJK Compatibility Ideographs
-      (ch >= 0x2F800 &&
-       ch <= 0x2FA1F))  // CJK Compatibility Ideographs Supplement
-    return true;
+namespace {
+
+struct CodePointRange {
+  uint32_t first;
+  uint32_t last;
+};
+
+const CodePointRange kExtendedCjk[] = {
+    {0x3400, 0x4DBF},    // CJK Unified Ideographs Extension A
+    {0x20000, 0x2A6DF},  // CJK Unified Ideographs Extension B
+    {0x2A700, 0x2B73F},  // CJK Unified Ideographs Extension C
+    {0x2B740, 0x2B81F},  // CJK Unified Ideographs Extension D
+    {0x2B820, 0x2CEAF},  // CJK Unified Ideographs Extension E
+    {0x2CEB0, 0x2EBEF},  // CJK Unified Ideographs Extension F
+    {0x30000, 0x3134F},  // CJK Unified Ideographs Extension G
+    {0x31350, 0x323AF},  // CJK Unified Ideographs Extension H
+    {0x2EBF0, 0x2EE5D},  // CJK Unified Ideographs Extension I
+    {0x3300, 0x33FF},    // CJK Compatibility
+    {0xFE30, 0xFE4F},    // CJK Compatibility Forms
+    {0xF900, 0xFAFF},    // CJK Compatibility Ideographs
+    {0x2F800, 0x2FA1F},  // CJK Compatibility Ideographs Supplement
+};
+
+// A two-level bitmap over the Unicode range: an index of blocks of 256 code
+// points, where equal blocks, mostly empty or full ones, are stored once.
+class CodePointSet {
+ public:
+  static const uint32_t kMaxCodePoint = 0x10FFFF;
+  static const uint32_t kBlockBits = 8;
+
+  template <size_t N>
+  explicit CodePointSet(const CodePointRange (&ranges)[N]);
+
+  bool Contains(uint32_t ch) const {
+    if (ch > kMaxCodePoint)
+      return false;
+    const Block& block = blocks_[index_[ch >> kBlockBits]];
+    uint32_t bit = ch & ((1 << kBlockBits) - 1);
+    return (block[bit / 64] >> (bit % 64)) & 1;
+  }
 
-  return false;
+ private:
+  using Block = std::array<uint64_t, (1 << kBlockBits) / 64>;
+
+  vector<uint16_t> index_;
+  vector<Block> blocks_;
+};
+
+template <size_t N>
+CodePointSet::CodePointSet(const CodePointRange (&ranges)[N]) {
+  const size_t kNumBlocks = (kMaxCodePoint >> kBlockBits) + 1;
+  vector<Block> dense(kNumBlocks, Block{});
+  for (const auto& range : ranges) {
+    for (uint32_t ch = range.first; ch <= range.last; ++ch) {
+      uint32_t bit = ch & ((1 << kBlockBits) - 1);
+      dense[ch >> kBlockBits][bit / 64] |= uint64_t(1) << (bit % 64);
+    }
+  }
+  map<Block, uint16_t> block_ids;
+  index_.resize(kNumBlocks);
+  for (size_t i = 0; i < kNumBlocks; ++i) {
+    auto found = block_ids.find(dense[i]);
+    if (found == block_ids.end()) {
+      found = block_ids.emplace(dense[i], blocks_.size()).first;
+      blocks_.push_back(dense[i]);
+    }
+    index_[i] = found->second;
+  }
+}
+
+// built on first use and shared by all filters.
+const CodePointSet& extended_cjk() {
+  static const CodePointSet charset(kExtendedCjk);
+  return charset;
+}
+
+}  // namespace
+
+bool is_extended_cjk(uint32_t ch) {
+  return extended_cjk().Contains(ch);
 }
 
 bool contains_extended_cjk(const string& text) {
+  const CodePointSet& charset = extended_cjk();
   const char* p = text.c_str();
-  uint32_t ch;
-
-  while ((ch = utf8::unchecked::next(p)) != 0) {
-    if (is_extended_cjk(ch)) {
+  const char* end = p + text.length();
+  while (p < end) {
+    // none of the extended CJK characters is ASCII
+    p += strings::ascii_prefix_length(p, end);
+    if (p < end && charset.Contains(utf8::unchecked::next(p)))
       return true;
-    }
   }
-
   return false;
 }
 
@@ -94,6 +159,10 @@ bool CharsetFilter::FilterDictEntry(an<DictEntry> entry) {
   return entry && FilterText(entry->text);
 }
 
+bool CharsetFilter::FilterDictEntryView(const DictEntryView& entry) {
+  return FilterText(entry.text());
+}
+
 CharsetFilter::CharsetFilter(const Ticket& ticket)
     : Filter(ticket), TagMatching(ticket) {}
 
@@ -109,4 +178,15 @@ an<Translation> CharsetFilter::Apply(an<Translation> translation,
   return translation;
 }
 
+CandidateTransform CharsetFilter::GetCandidateTransform(
+    CandidateList* candidates) {
+  if (!name_space_.empty() ||
+      engine_->context()->get_option("extended_charset")) {
+    return nullptr;  // left to Apply()
+  }
+  return [](const an<Candidate>& cand) {
+    return FilterText(cand->text()) ? cand : nullptr;
+  };
+}
+
 }  // namespace rime
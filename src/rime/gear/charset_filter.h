@@ -30,6 +30,7 @@ class CharsetFilterTranslation : public Translation {
 };
 
 struct DictEntry;
+class DictEntryView;
 
 class CharsetFilter : public Filter, TagMatching {
  public:
@@ -37,12 +38,14 @@ class CharsetFilter : public Filter, TagMatching {
 
   virtual an<Translation> Apply(an<Translation> translation,
                                 CandidateList* candidates);
+  CandidateTransform GetCandidateTransform(CandidateList* candidates) override;
 
   virtual bool AppliesToSegment(Segment* segment) { return TagsMatch(segment); }
 
   // return true to accept, false to reject the tested item
   static bool FilterText(const string& text);
   static bool FilterDictEntry(an<DictEntry> entry);
+  static bool FilterDictEntryView(const DictEntryView& entry);
 };
 
 }  // namespace rime
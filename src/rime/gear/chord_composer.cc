@@ -16,6 +16,10 @@
 
 namespace rime {
 
+static const SegmentTags::TagId kPhonyTag = SegmentTags::Intern("phony");
+static const SegmentTags::TagId kChordPromptTag =
+    SegmentTags::Intern("chord_prompt");
+
 static ChordComposer::ActionDef action_definitions[] = {
     {"commit_raw_input", &ChordComposer::CommitRawInput},
     ChordComposer::kActionNoop,
@@ -24,12 +28,14 @@ static ChordComposer::ActionDef action_definitions[] = {
 ChordComposer::ChordComposer(const Ticket& ticket)
     : Processor(ticket),
       KeyBindingProcessor<ChordComposer>(action_definitions) {
+  interests_ = kIdle | kComposing;
   if (!engine_)
     return;
   if (Config* config = engine_->schema()->config()) {
     string alphabet;
     config->GetString("chord_composer/alphabet", &alphabet);
     chording_keys_.Parse(alphabet);
+    CompileAlphabet();
     KeyBindingProcessor::LoadConfig(config, "chord_composer");
     config->GetBool("chord_composer/use_control", &use_control_);
     config->GetBool("chord_composer/use_alt", &use_alt_);
@@ -56,6 +62,33 @@ ChordComposer::~ChordComposer() {
   unhandled_key_connection_.disconnect();
 }
 
+void ChordComposer::CompileAlphabet() {
+  const size_t kMaxChordingKeys = sizeof(Chord) * 8;
+  size_t num_keys = 0;
+  for (const KeyEvent& key : chording_keys_) {
+    int ch = key.keycode();
+    if (key.modifier() != 0 || ChordKey(ch))
+      continue;
+    if (num_keys == kMaxChordingKeys) {
+      LOG(ERROR) << "too many chording keys; at most " << kMaxChordingKeys
+                 << " are supported.";
+      break;
+    }
+    Chord bit = Chord(1) << num_keys++;
+    if (ch >= 0 && ch < 0x80)
+      ascii_chord_keys_[ch] = bit;
+    else
+      other_chord_keys_[ch] = bit;
+  }
+}
+
+Chord ChordComposer::ChordKey(int ch) const {
+  if (ch >= 0 && ch < 0x80)
+    return ascii_chord_keys_[ch];
+  auto found = other_chord_keys_.find(ch);
+  return found != other_chord_keys_.end() ? found->second : 0;
+}
+
 bool ChordComposer::CommitRawInput(Context* ctx) {
   if (raw_sequence_.empty()) {
     return false;
@@ -104,7 +137,7 @@ inline static int get_base_layer_key_code(const KeyEvent& key_event) {
 
 inline static bool finish_chord_on_all_keys_released(
     const ChordingState& state) {
-  return state.pressed_keys.empty();
+  return state.pressed_keys == 0;
 }
 
 bool ChordComposer::FinishChordConditionIsMet() const {
@@ -120,10 +153,9 @@ ProcessResult ChordComposer::ProcessChordingKey(const KeyEvent& key_event) {
     state_.Clear();
     return kNoop;
   }
-  int ch = get_base_layer_key_code(key_event);
+  Chord key = ChordKey(get_base_layer_key_code(key_event));
   // non chording key
-  if (std::find(chording_keys_.begin(), chording_keys_.end(),
-                KeyEvent{ch, 0}) == chording_keys_.end()) {
+  if (!key) {
     ClearChord();
     state_.Clear();
     return kNoop;
@@ -132,13 +164,13 @@ ProcessResult ChordComposer::ProcessChordingKey(const KeyEvent& key_event) {
   editing_chord_ = true;
   bool is_key_up = key_event.release();
   if (is_key_up) {
-    if (state_.ReleaseKey(ch) && FinishChordConditionIsMet() &&
-        !state_.recognized_chord.empty()) {
+    if (state_.ReleaseKey(key) && FinishChordConditionIsMet() &&
+        state_.recognized_chord) {
       FinishChord(state_.recognized_chord);
-      state_.recognized_chord.clear();
+      state_.recognized_chord = 0;
     }
   } else {  // key down, ignore repeated key down events
-    if (state_.PressKey(ch) && state_.AddKeyToChord(ch)) {
+    if (state_.PressKey(key) && state_.AddKeyToChord(key)) {
       UpdateChord(state_.recognized_chord);
     }
   }
@@ -173,10 +205,10 @@ ProcessResult ChordComposer::ProcessKeyEvent(const KeyEvent& key_event) {
   return ProcessFunctionKey(key_event);
 }
 
-string ChordComposer::SerializeChord(const Chord& chord) {
+string ChordComposer::SerializeChord(Chord chord) {
   KeySequence key_sequence;
   for (KeyEvent key : chording_keys_) {
-    if (chord.find(key.keycode()) != chord.end())
+    if (chord & ChordKey(key.keycode()))
       key_sequence.push_back(key);
   }
   string code = key_sequence.repr();
@@ -184,40 +216,63 @@ string ChordComposer::SerializeChord(const Chord& chord) {
   return code;
 }
 
-void ChordComposer::UpdateChord(const Chord& chord) {
+const string& ChordComposer::FormatPrompt(Chord chord) {
+  auto found = prompts_.find(chord);
+  if (found != prompts_.end())
+    return found->second;
+  if (prompts_.size() >= kMaxFormattedChords)
+    prompts_.clear();
+  string code = SerializeChord(chord);
+  prompt_format_.Apply(&code);
+  return prompts_[chord] = std::move(code);
+}
+
+const KeySequence& ChordComposer::FormatOutput(Chord chord) {
+  auto found = outputs_.find(chord);
+  if (found != outputs_.end())
+    return found->second;
+  if (outputs_.size() >= kMaxFormattedChords)
+    outputs_.clear();
+  string code = SerializeChord(chord);
+  output_format_.Apply(&code);
+  KeySequence key_sequence;
+  if (!key_sequence.Parse(code))
+    key_sequence.clear();
+  return outputs_[chord] = std::move(key_sequence);
+}
+
+void ChordComposer::UpdateChord(Chord chord) {
   if (!engine_)
     return;
   Context* ctx = engine_->context();
   Composition& comp = ctx->composition();
   // do not show chord prompt if the chord is empty or only contains space.
-  if (chord.empty() || (chord.size() == 1 && chord.count(' ') > 0)) {
+  if (!chord || chord == ChordKey(' ')) {
     ClearChord();
     return;
   }
-  string code = SerializeChord(chord);
-  prompt_format_.Apply(&code);
+  const string& code = FormatPrompt(chord);
   if (comp.empty()) {
     // add a placeholder segment
     // 1. to cheat ctx->IsComposing() == true
     // 2. to attach chord prompt to while chording
     Segment placeholder(0, ctx->input().length());
-    placeholder.tags.insert("phony");
+    placeholder.tags.Add(kPhonyTag);
     ctx->composition().AddSegment(placeholder);
   }
   auto& last_segment = comp.back();
-  last_segment.tags.insert("chord_prompt");
+  last_segment.tags.Add(kChordPromptTag);
   last_segment.prompt = code;
 }
 
-void ChordComposer::FinishChord(const Chord& chord) {
+void ChordComposer::FinishChord(Chord chord) {
   if (!engine_)
     return;
-  string code = SerializeChord(chord);
-  output_format_.Apply(&code);
+  // keys are sent to the engine, and may finish chords of their own.
+  KeySequence key_sequence = FormatOutput(chord);
   ClearChord();
 
-  KeySequence key_sequence;
-  if (key_sequence.Parse(code) && !key_sequence.empty()) {
+  if (!key_sequence.empty()) {
     sending_chord_ = true;
     for (const KeyEvent& key : key_sequence) {
       if (!engine_->ProcessKey(key)) {
@@ -239,11 +294,11 @@ void ChordComposer::ClearChord() {
   if (comp.empty())
     return;
   auto& last_segment = comp.back();
-  if (comp.size() == 1 && last_segment.HasTag("phony")) {
+  if (comp.size() == 1 && last_segment.HasTag(kPhonyTag)) {
     ctx->Clear();
-  } else if (last_segment.HasTag("chord_prompt")) {
+  } else if (last_segment.HasTag(kChordPromptTag)) {
     last_segment.prompt.clear();
-    last_segment.tags.erase("chord_prompt");
+    last_segment.tags.Remove(kChordPromptTag);
   }
 }
 
@@ -16,26 +16,34 @@
 
 namespace rime {
 
-using Chord = set<int>;
+// chording keys, one bit for each key of the alphabet.
+using Chord = uint64_t;
 
 struct ChordingState {
-  Chord pressed_keys;
-  Chord recognized_chord;
+  Chord pressed_keys = 0;
+  Chord recognized_chord = 0;
 
-  bool IsPressed(int ch) const {
-    return pressed_keys.find(ch) != pressed_keys.end();
-  }
-
-  bool PressKey(int ch) { return pressed_keys.insert(ch).second; }
+  bool IsPressed(Chord key) const { return (pressed_keys & key) != 0; }
 
-  bool ReleaseKey(int ch) { return pressed_keys.erase(ch) != 0; }
+  bool PressKey(Chord key) {
+    bool pressed = IsPressed(key);
+    pressed_keys |= key;
+    return !pressed;
+  }
 
-  bool AddKeyToChord(int ch) { return recognized_chord.insert(ch).second; }
+  bool ReleaseKey(Chord key) {
+    bool pressed = IsPressed(key);
+    pressed_keys &= ~key;
+    return pressed;
+  }
 
-  void Clear() {
-    pressed_keys.clear();
-    recognized_chord.clear();
+  bool AddKeyToChord(Chord key) {
+    bool added = (recognized_chord & key) == 0;
+    recognized_chord |= key;
+    return added;
   }
+
+  void Clear() { pressed_keys = recognized_chord = 0; }
 };
 
 class ChordComposer : public Processor,
@@ -52,15 +60,22 @@ class ChordComposer : public Processor,
   bool FinishChordConditionIsMet() const;
   ProcessResult ProcessChordingKey(const KeyEvent& key_event);
   ProcessResult ProcessFunctionKey(const KeyEvent& key_event);
-  string SerializeChord(const Chord& chord);
-  void UpdateChord(const Chord& chord);
-  void FinishChord(const Chord& chord);
+  void CompileAlphabet();
+  // the bit of a chording key; 0 for other keys.
+  Chord ChordKey(int ch) const;
+  string SerializeChord(Chord chord);
+  const string& FormatPrompt(Chord chord);
+  const KeySequence& FormatOutput(Chord chord);
+  void UpdateChord(Chord chord);
+  void FinishChord(Chord chord);
   void ClearChord();
   bool DeleteLastSyllable();
   void OnContextUpdate(Context* ctx);
   void OnUnhandledKey(Context* ctx, const KeyEvent& key);
 
   KeySequence chording_keys_;
+  Chord ascii_chord_keys_[0x80] = {};
+  hash_map<int, Chord> other_chord_keys_;
   string delimiter_;
   Projection algebra_;
   Projection output_format_;
@@ -72,6 +87,11 @@ class ChordComposer : public Processor,
   bool use_caps_ = false;
   bool finish_chord_on_first_key_release_ = false;
 
+  // formatted chords, as the formulas apply to chords typed over and over.
+  static const size_t kMaxFormattedChords = 4096;
+  hash_map<Chord, string> prompts_;
+  hash_map<Chord, KeySequence> outputs_;
+
   ChordingState state_;
   bool editing_chord_ = false;
   bool sending_chord_ = false;
@@ -1,61 +1,116 @@
 #include <algorithm>
+#include <atomic>
 #include <iterator>
 #include <rime/gear/contextual_translation.h>
 #include <rime/gear/grammar.h>
 #include <rime/gear/translator_commons.h>
+#include <rime/hot_log.h>
 
 namespace rime {
 
 const int kContextualSearchLimit = 32;
 
+static std::atomic<uint64_t> replenish_count{0};
+static std::atomic<uint64_t> over_budget_count{0};
+
+ContextualTranslation::Stats ContextualTranslation::stats() {
+  Stats stats;
+  stats.replenish_count = replenish_count.load(std::memory_order_relaxed);
+  stats.over_budget_count = over_budget_count.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void ContextualTranslation::set_time_budget(int milliseconds,
+                                            size_t page_size) {
+  time_budget_ = std::chrono::milliseconds(milliseconds);
+  page_size_ = (std::max)(page_size, size_t(1));
+}
+
+bool ContextualTranslation::OverBudget(size_t num_candidates) const {
+  return time_budget_.count() > 0 && num_candidates >= page_size_ &&
+         std::chrono::steady_clock::now() - start_time_ > time_budget_;
+}
+
 bool ContextualTranslation::Replenish() {
+  replenish_count.fetch_add(1, std::memory_order_relaxed);
   vector<of<Phrase>> queue;
+  size_t scored = 0;
   size_t end_pos = 0;
   std::string last_type;
   while (!translation_->exhausted() &&
          cache_.size() + queue.size() < kContextualSearchLimit) {
+    // with a time budget, show a page at least, and leave the rest to
+    // later pages once the budget for this keystroke is used up.
+    if (OverBudget(cache_.size() + queue.size())) {
+      over_budget_count.fetch_add(1, std::memory_order_relaxed);
+      RIME_HOT_LOG(ContextualTranslation)
+          << "contextual suggestions over time budget, with "
+          << cache_.size() + queue.size() << " candidates.";
+      break;
+    }
     auto cand = translation_->Peek();
-    DLOG(INFO) << cand->text() << " cache/queue: " << cache_.size() << "/"
-               << queue.size();
+    RIME_HOT_LOG(ContextualTranslation) << cand->text() << " cache/queue: "
+                                        << cache_.size() << "/" << queue.size();
     if (cand->type() == "phrase" || cand->type() == "user_phrase" ||
         cand->type() == "table" || cand->type() == "user_table" ||
         cand->type() == "completion") {
       if (end_pos != cand->end() || last_type != cand->type()) {
         end_pos = cand->end();
         last_type = cand->type();
-        AppendToCache(queue);
+        AppendToCache(queue, scored);
+      }
+      queue.push_back(As<Phrase>(cand));
+      // score a page at a time to keep track of the time spent.
+      if (time_budget_.count() > 0 && queue.size() - scored >= page_size_) {
+        Evaluate(queue, scored);
+        scored = queue.size();
       }
-      queue.push_back(Evaluate(As<Phrase>(cand)));
     } else {
-      AppendToCache(queue);
+      AppendToCache(queue, scored);
       cache_.push_back(cand);
     }
     if (!translation_->Next()) {
       break;
     }
   }
-  AppendToCache(queue);
+  AppendToCache(queue, scored);
   return !cache_.empty();
 }
 
-an<Phrase> ContextualTranslation::Evaluate(an<Phrase> phrase) {
-  bool is_rear = phrase->end() == input_.length();
-  double weight = Grammar::Evaluate(preceding_text_, phrase->text(),
-                                    phrase->weight(), is_rear, grammar_);
-  phrase->set_weight(weight);
-  DLOG(INFO) << "contextual suggestion: " << phrase->text()
-             << " weight: " << phrase->weight();
-  return phrase;
+void ContextualTranslation::Evaluate(vector<of<Phrase>>& queue, size_t from) {
+  if (from >= queue.size())
+    return;
+  // phrases in the queue end at the same position.
+  bool is_rear = queue.front()->end() == input_.length();
+  vector<const string*> words;
+  words.reserve(queue.size() - from);
+  for (size_t i = from; i < queue.size(); ++i) {
+    words.push_back(&queue[i]->text());
+  }
+  vector<double> scores;
+  Grammar::EvaluateBatch({&preceding_text_}, words, is_rear, grammar_,
+                         &scores);
+  for (size_t i = from; i < queue.size(); ++i) {
+    auto& phrase = queue[i];
+    phrase->set_weight(phrase->weight() + scores[i - from]);
+    RIME_HOT_LOG(ContextualTranslation) << "contextual suggestion: "
+                                        << phrase->text() << " weight: "
+                                        << phrase->weight();
+  }
 }
 
 static bool compare_by_weight_desc(const an<Phrase>& a, const an<Phrase>& b) {
   return a->weight() > b->weight();
 }
 
-void ContextualTranslation::AppendToCache(vector<of<Phrase>>& queue) {
+void ContextualTranslation::AppendToCache(vector<of<Phrase>>& queue,
+                                          size_t& scored) {
   if (queue.empty())
     return;
-  DLOG(INFO) << "appending to cache " << queue.size() << " candidates.";
+  RIME_HOT_LOG(ContextualTranslation) << "appending to cache " << queue.size()
+                                      << " candidates.";
+  Evaluate(queue, scored);
+  scored = 0;
   std::sort(queue.begin(), queue.end(), compare_by_weight_desc);
   std::copy(queue.begin(), queue.end(), std::back_inserter(cache_));
   queue.clear();
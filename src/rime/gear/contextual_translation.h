@@ -3,6 +3,8 @@
 // Distributed under the BSD License
 //
 
+#include <stdint.h>
+#include <chrono>
 #include <rime/common.h>
 #include <rime/translation.h>
 
@@ -21,18 +23,35 @@ class ContextualTranslation : public PrefetchTranslation {
       : PrefetchTranslation(translation),
         input_(input),
         preceding_text_(preceding_text),
-        grammar_(grammar) {}
+        grammar_(grammar),
+        start_time_(std::chrono::steady_clock::now()) {}
+
+  // limits the time spent on scoring candidates since the translation was
+  // made, once a page of candidates is ready; 0 for no limit.
+  void set_time_budget(int milliseconds, size_t page_size);
+
+  struct Stats {
+    uint64_t replenish_count = 0;
+    // the number of times candidates were left to score for later pages.
+    uint64_t over_budget_count = 0;
+  };
+  // counts of all contextual translations.
+  static Stats stats();
 
  protected:
   bool Replenish() override;
 
  private:
-  an<Phrase> Evaluate(an<Phrase> phrase);
-  void AppendToCache(vector<of<Phrase>>& queue);
+  bool OverBudget(size_t num_candidates) const;
+  void Evaluate(vector<of<Phrase>>& queue, size_t from);
+  void AppendToCache(vector<of<Phrase>>& queue, size_t& scored);
 
   string input_;
   string preceding_text_;
   Grammar* grammar_;
+  std::chrono::steady_clock::time_point start_time_;
+  std::chrono::milliseconds time_budget_{0};
+  size_t page_size_ = 1;
 };
 
 }  // namespace rime
@@ -10,6 +10,8 @@
 
 namespace rime {
 
+static const SegmentTags::TagId kRawTag = SegmentTags::Intern("raw");
+
 FallbackSegmentor::FallbackSegmentor(const Ticket& ticket)
     : Segmentor(ticket) {}
 
@@ -34,13 +36,13 @@ bool FallbackSegmentor::Proceed(Segmentation* segmentation) {
   if (!segmentation->empty()) {
     Segment& last(segmentation->back());
     // append one character to the last raw segment
-    if (last.HasTag("raw")) {
+    if (last.HasTag(kRawTag)) {
       last.end = k + 1;
       DLOG(INFO) << "extend previous raw segment to [" << last.start << ", "
                  << last.end << ")";
       // mark redo translation (in case it's been previously translated)
       last.Clear();
-      last.tags.insert("raw");
+      last.tags.Add(kRawTag);
       return false;
     }
   }
@@ -48,7 +50,7 @@ bool FallbackSegmentor::Proceed(Segmentation* segmentation) {
     Segment segment(k, k + 1);
     DLOG(INFO) << "add a raw segment [" << segment.start << ", " << segment.end
                << ")";
-    segment.tags.insert("raw");
+    segment.tags.Add(kRawTag);
     segmentation->Forward();
     segmentation->AddSegment(segment);
   }
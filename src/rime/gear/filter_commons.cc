@@ -18,7 +18,7 @@ TagMatching::TagMatching(const Ticket& ticket) {
   if (auto tags = config->GetList(ticket.name_space + "/tags")) {
     for (auto it = tags->begin(); it != tags->end(); ++it) {
       if (Is<ConfigValue>(*it)) {
-        tags_.push_back(As<ConfigValue>(*it)->str());
+        tags_.insert(As<ConfigValue>(*it)->str());
       }
     }
   }
@@ -29,11 +29,7 @@ bool TagMatching::TagsMatch(Segment* segment) {
     return false;
   if (tags_.empty())  // match any
     return true;
-  for (const string& tag : tags_) {
-    if (segment->HasTag(tag))
-      return true;
-  }
-  return false;
+  return segment->HasAnyTagIn(tags_);
 }
 
 }  // namespace rime
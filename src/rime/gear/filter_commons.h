@@ -7,9 +7,10 @@
 #ifndef RIME_FILTER_COMMONS_H_
 #define RIME_FILTER_COMMONS_H_
 
+#include <rime/segmentation.h>
+
 namespace rime {
 
-struct Segment;
 struct Ticket;
 
 class TagMatching {
@@ -18,7 +19,7 @@ class TagMatching {
   bool TagsMatch(Segment* segment);
 
  protected:
-  vector<string> tags_;
+  SegmentTags tags_;
 };
 
 }  // namespace rime
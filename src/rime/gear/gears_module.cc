@@ -19,6 +19,7 @@
 #include <rime/gear/key_binder.h>
 #include <rime/gear/matcher.h>
 #include <rime/gear/navigator.h>
+#include <rime/gear/next_word_translator.h>
 #include <rime/gear/punctuator.h>
 #include <rime/gear/recognizer.h>
 #include <rime/gear/reverse_lookup_filter.h>
@@ -75,6 +76,7 @@ static void rime_gears_initialize() {
   r.Register("schema_list_translator", new Component<SchemaListTranslator>);
   r.Register("switch_translator", new Component<SwitchTranslator>);
   r.Register("history_translator", new Component<HistoryTranslator>);
+  r.Register("next_word_translator", new Component<NextWordTranslator>);
 
   // filters
   r.Register("simplifier", new Component<Simplifier>);
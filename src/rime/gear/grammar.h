@@ -3,6 +3,7 @@
 
 #include <rime/common.h>
 #include <rime/component.h>
+#include <rime/perf_counters.h>
 
 namespace rime {
 
@@ -10,20 +11,74 @@ class Config;
 
 class Grammar : public Class<Grammar, Config*> {
  public:
+  static constexpr double kPenalty = -18.420680743952367;  // log(1e-8)
+
   virtual ~Grammar() {}
+
+  // models that answer queries from several threads at a time can be
+  // shared between sessions without serializing the queries.
+  virtual bool is_thread_safe() const { return false; }
+
   virtual double Query(const string& context,
                        const string& word,
                        bool is_rear) = 0;
 
+  // scores each of the words following the same context.
+  // models can override the batch queries to share the work on the context;
+  // by default, words are queried one by one.
+  virtual void QueryBatch(const string& context,
+                          const vector<const string*>& words,
+                          bool is_rear,
+                          vector<double>* scores) {
+    scores->resize(words.size());
+    for (size_t i = 0; i < words.size(); ++i) {
+      (*scores)[i] = Query(context, *words[i], is_rear);
+    }
+  }
+
+  // scores the words following each of the contexts, in a row per context.
+  virtual void QueryBatch(const vector<const string*>& contexts,
+                          const vector<const string*>& words,
+                          bool is_rear,
+                          vector<double>* scores) {
+    scores->resize(contexts.size() * words.size());
+    auto score = scores->begin();
+    for (const auto* context : contexts) {
+      for (const auto* word : words) {
+        *score++ = Query(*context, *word, is_rear);
+      }
+    }
+  }
+
   inline static double Evaluate(const string& context,
                                 const string& entry_text,
                                 double entry_weight,
                                 bool is_rear,
                                 Grammar* grammar) {
-    const double kPenalty = -18.420680743952367;  // log(1e-8)
+    if (grammar)
+      PerfCounters::Count(PerfCounters::kGrammarQueries);
     return entry_weight +
            (grammar ? grammar->Query(context, entry_text, is_rear) : kPenalty);
   }
+
+  // scores the words without their own weights, in a row per context.
+  inline static void EvaluateBatch(const vector<const string*>& contexts,
+                                   const vector<const string*>& words,
+                                   bool is_rear,
+                                   Grammar* grammar,
+                                   vector<double>* scores) {
+    if (!grammar) {
+      scores->assign(contexts.size() * words.size(), kPenalty);
+      return;
+    }
+    PerfCounters::Count(PerfCounters::kGrammarQueries,
+                        contexts.size() * words.size());
+    if (contexts.size() == 1) {
+      grammar->QueryBatch(*contexts[0], words, is_rear, scores);
+    } else {
+      grammar->QueryBatch(contexts, words, is_rear, scores);
+    }
+  }
 };
 
 }  // namespace rime
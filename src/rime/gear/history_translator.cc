@@ -20,18 +20,19 @@ HistoryTranslator::HistoryTranslator(const Ticket& ticket)
   if (ticket.name_space == "translator") {
     name_space_ = "history";
   }
-  if (!ticket.schema)
-    return;
-  Config* config = ticket.schema->config();
-  config->GetString(name_space_ + "/tag", &tag_);
-  config->GetString(name_space_ + "/input", &input_);
-  config->GetInt(name_space_ + "/size", &size_);
-  config->GetDouble(name_space_ + "/initial_quality", &initial_quality_);
+  if (ticket.schema) {
+    Config* config = ticket.schema->config();
+    config->GetString(name_space_ + "/tag", &tag_);
+    config->GetString(name_space_ + "/input", &input_);
+    config->GetInt(name_space_ + "/size", &size_);
+    config->GetDouble(name_space_ + "/initial_quality", &initial_quality_);
+  }
+  tag_id_ = SegmentTags::Intern(tag_);
 }
 
 an<Translation> HistoryTranslator::Query(const string& input,
                                          const Segment& segment) {
-  if (!segment.HasTag(tag_))
+  if (!segment.HasTag(tag_id_))
     return nullptr;
   if (input_.empty() || input_ != input)
     return nullptr;
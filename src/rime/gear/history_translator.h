@@ -7,6 +7,7 @@
 #ifndef RIME_HISTORY_TRANSLATOR_H_
 #define RIME_HISTORY_TRANSLATOR_H_
 
+#include <rime/segmentation.h>
 #include <rime/translator.h>
 
 namespace rime {
@@ -19,6 +20,7 @@ class HistoryTranslator : public Translator {
 
  protected:
   string tag_;
+  SegmentTags::TagId tag_id_ = 0;
   string input_;
   int size_;
   double initial_quality_;
@@ -18,6 +18,10 @@
 
 namespace rime {
 
+static const SegmentTags::TagId kPagingTag = SegmentTags::Intern("paging");
+static const SegmentTags::TagId kPredictionTag =
+    SegmentTags::Intern("prediction");
+
 enum KeyBindingCondition {
   kNever,
   kWhenPredicting,  // showing prediction candidates
@@ -53,7 +57,7 @@ struct KeyBinding {
   bool operator<(const KeyBinding& o) const { return whence < o.whence; }
 };
 
-class KeyBindings : public map<KeyEvent, vector<KeyBinding>> {
+class KeyBindings : public hash_map<KeyEvent, vector<KeyBinding>> {
  public:
   void LoadBindings(const an<ConfigList>& bindings);
   void Bind(const KeyEvent& key, const KeyBinding& binding);
@@ -240,32 +244,35 @@ KeyBinder::KeyBinder(const Ticket& ticket)
   LoadConfig();
 }
 
-class KeyBindingConditions : public set<KeyBindingCondition> {
- public:
-  explicit KeyBindingConditions(Context* ctx);
-};
+// a set of conditions in bits.
+using KeyBindingConditions = uint32_t;
 
-KeyBindingConditions::KeyBindingConditions(Context* ctx) {
-  insert(kAlways);
+inline static KeyBindingConditions bit(KeyBindingCondition condition) {
+  return 1u << condition;
+}
 
-  if (ctx->IsComposing()) {
-    insert(kWhenComposing);
+// checks the conditions of the bindings of a key, only as many as needed.
+static KeyBindingConditions check_conditions(Context* ctx,
+                                             KeyBindingConditions wanted) {
+  KeyBindingConditions conditions = bit(kAlways);
+  if ((wanted & bit(kWhenComposing)) && ctx->IsComposing()) {
+    conditions |= bit(kWhenComposing);
   }
-
-  if (ctx->HasMenu() && !ctx->get_option("ascii_mode")) {
-    insert(kWhenHasMenu);
+  if ((wanted & bit(kWhenHasMenu)) && ctx->HasMenu() &&
+      !ctx->get_option("ascii_mode")) {
+    conditions |= bit(kWhenHasMenu);
   }
-
   Composition& comp = ctx->composition();
-  if (!comp.empty()) {
+  if ((wanted & (bit(kWhenPaging) | bit(kWhenPredicting))) && !comp.empty()) {
     const Segment& last_seg = comp.back();
-    if (last_seg.HasTag("paging")) {
-      insert(kWhenPaging);
+    if (last_seg.HasTag(kPagingTag)) {
+      conditions |= bit(kWhenPaging);
     }
-    if (last_seg.HasTag("prediction")) {
-      insert(kWhenPredicting);
+    if (last_seg.HasTag(kPredictionTag)) {
+      conditions |= bit(kWhenPredicting);
     }
   }
+  return conditions;
 }
 
 ProcessResult KeyBinder::ProcessKeyEvent(const KeyEvent& key_event) {
@@ -273,11 +280,18 @@ ProcessResult KeyBinder::ProcessKeyEvent(const KeyEvent& key_event) {
     return kNoop;
   if (ReinterpretPagingKey(key_event))
     return kNoop;
-  if (key_bindings_->find(key_event) == key_bindings_->end())
+  auto found = key_bindings_->find(key_event);
+  if (found == key_bindings_->end())
     return kNoop;
-  KeyBindingConditions conditions(engine_->context());
-  for (const KeyBinding& binding : (*key_bindings_)[key_event]) {
-    if (conditions.find(binding.whence) == conditions.end())
+  const auto& bindings = found->second;
+  KeyBindingConditions wanted = 0;
+  for (const KeyBinding& binding : bindings) {
+    wanted |= bit(binding.whence);
+  }
+  KeyBindingConditions conditions =
+      check_conditions(engine_->context(), wanted);
+  for (const KeyBinding& binding : bindings) {
+    if (!(conditions & bit(binding.whence)))
       continue;
     PerformKeyBinding(binding);
     return kAccepted;
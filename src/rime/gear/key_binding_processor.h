@@ -45,7 +45,7 @@ class KeyBindingProcessor {
                   int kemap_selector = 0);
 
  protected:
-  struct Keymap : map<KeyEvent, HandlerPtr> {
+  struct Keymap : hash_map<KeyEvent, HandlerPtr> {
     void Bind(KeyEvent key_event, HandlerPtr action);
   };
 
@@ -86,6 +86,13 @@ Memory::~Memory() {
   unhandled_key_connection_.disconnect();
 }
 
+void Memory::WarmUpDictionaries() {
+  if (dict_ && dict_->loaded())
+    dict_->WarmUp();
+  if (user_dict_ && user_dict_->loaded())
+    user_dict_->WarmUp();
+}
+
 bool Memory::StartSession() {
   return user_dict_ && user_dict_->NewTransaction();
 }
@@ -99,6 +106,10 @@ bool Memory::DiscardSession() {
 }
 
 void Memory::OnCommit(Context* ctx) {
+  // between compositions, the dictionary switches to the files deployed
+  // since it was loaded.
+  if (dict_ && dict_->Refresh())
+    OnDictionaryRefreshed();
   if (!user_dict_ || user_dict_->readonly())
     return;
   StartSession();
@@ -42,6 +42,8 @@ class Memory {
   bool StartSession();
   bool FinishSession();
   bool DiscardSession();
+  // pages in the loaded dictionaries and builds their lazy caches.
+  void WarmUpDictionaries();
 
   Dictionary* dict() const { return dict_.get(); }
   UserDictionary* user_dict() const { return user_dict_.get(); }
@@ -52,6 +54,8 @@ class Memory {
   void OnCommit(Context* ctx);
   void OnDeleteEntry(Context* ctx);
   void OnUnhandledKey(Context* ctx, const KeyEvent& key);
+  // the dictionary has switched to files deployed again.
+  virtual void OnDictionaryRefreshed() {}
 
   the<Dictionary> dict_;
   the<UserDictionary> user_dict_;
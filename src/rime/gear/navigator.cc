@@ -29,6 +29,7 @@ static Navigator::ActionDef navigation_actions[] = {
 
 Navigator::Navigator(const Ticket& ticket)
     : Processor(ticket), KeyBindingProcessor(navigation_actions) {
+  interests_ = kComposing | kComposingInAsciiMode;
   // default key bindings
   {
     auto& keymap = get_keymap(Horizontal);
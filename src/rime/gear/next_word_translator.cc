@@ -0,0 +1,110 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <boost/algorithm/string.hpp>
+#include <rime/candidate.h>
+#include <rime/context.h>
+#include <rime/engine.h>
+#include <rime/schema.h>
+#include <rime/ticket.h>
+#include <rime/translation.h>
+#include <rime/dict/next_word_index.h>
+#include <rime/gear/next_word_translator.h>
+#include <rime/gear/translator_commons.h>
+
+namespace rime {
+
+NextWordTranslator::NextWordTranslator(const Ticket& ticket)
+    : Translator(ticket) {
+  if (ticket.name_space == "translator") {
+    name_space_ = "next_word";
+  }
+  if (!ticket.engine || !ticket.schema) {
+    tag_id_ = SegmentTags::Intern(tag_);
+    return;
+  }
+  Config* config = ticket.schema->config();
+  config->GetString(name_space_ + "/tag", &tag_);
+  tag_id_ = SegmentTags::Intern(tag_);
+  config->GetInt(name_space_ + "/size", &size_);
+  config->GetDouble(name_space_ + "/initial_quality", &initial_quality_);
+  if (auto component = NextWordIndex::Require("next_word_index")) {
+    Ticket index_ticket(ticket);
+    index_ticket.name_space = name_space_;
+    index_.reset(component->Create(index_ticket));
+    if (index_ && !index_->Load()) {
+      LOG(ERROR) << "failed to load next word index '" << index_->name()
+                 << "'.";
+      index_.reset();
+    }
+  }
+  if (!index_)
+    return;
+  // the words of a commit are learned before the engine records it in the
+  // commit history, which then holds the words committed before them.
+  commit_connection_ = engine_->context()->commit_notifier().connect(
+      [this](Context* ctx) { OnCommit(ctx); }, boost::signals2::at_front);
+}
+
+NextWordTranslator::~NextWordTranslator() {
+  commit_connection_.disconnect();
+}
+
+vector<string> NextWordTranslator::RecentWords() const {
+  const auto& history(engine_->context()->commit_history());
+  if (recent_words_.empty() || history.empty() ||
+      !boost::ends_with(history.back().text, recent_words_.back()))
+    return {};
+  return recent_words_;
+}
+
+void NextWordTranslator::OnCommit(Context* ctx) {
+  vector<string> context = RecentWords();
+  vector<string> words;
+  for (const Segment& seg : ctx->composition()) {
+    auto cand = Candidate::GetGenuineCandidate(seg.GetSelectedCandidate());
+    if (!cand) {
+      // untranslated input breaks the chain of words.
+      words.push_back(string());
+      continue;
+    }
+    if (auto sentence = As<Sentence>(cand)) {
+      for (const DictEntry& e : sentence->components()) {
+        words.push_back(e.text);
+      }
+    } else {
+      words.push_back(cand->text());
+    }
+  }
+  index_->Learn(context, words);
+  context.insert(context.end(), words.begin(), words.end());
+  recent_words_.clear();
+  for (auto it = context.rbegin(); it != context.rend(); ++it) {
+    if (it->empty() || recent_words_.size() == 2)
+      break;
+    recent_words_.insert(recent_words_.begin(), *it);
+  }
+}
+
+an<Translation> NextWordTranslator::Query(const string& input,
+                                          const Segment& segment) {
+  if (!index_ || !segment.HasTag(tag_id_))
+    return nullptr;
+  vector<string> context = RecentWords();
+  if (context.empty())
+    return nullptr;
+  auto predictions = index_->Predict(context, size_ > 0 ? size_ : 0);
+  if (predictions.empty())
+    return nullptr;
+  auto translation = New<FifoTranslation>();
+  for (const auto& prediction : predictions) {
+    auto candidate = New<SimpleCandidate>("prediction", segment.start,
+                                          segment.end, prediction.text);
+    candidate->set_quality(initial_quality_);
+    translation->Append(candidate);
+  }
+  return translation;
+}
+
+}  // namespace rime
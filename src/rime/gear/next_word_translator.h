@@ -0,0 +1,45 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#ifndef RIME_NEXT_WORD_TRANSLATOR_H_
+#define RIME_NEXT_WORD_TRANSLATOR_H_
+
+#include <rime/segmentation.h>
+#include <rime/translator.h>
+
+namespace rime {
+
+class Context;
+class NextWordIndex;
+
+// Learns the words committed in a row into a NextWordIndex, and offers the
+// words likely to come next in the segments having the tag, which are opened
+// after a commit with no input of their own, eg. by a predict processor.
+class NextWordTranslator : public Translator {
+ public:
+  explicit NextWordTranslator(const Ticket& ticket);
+  virtual ~NextWordTranslator();
+
+  an<Translation> Query(const string& input, const Segment& segment) override;
+
+ protected:
+  void OnCommit(Context* ctx);
+  // the last words learned, if they are still the latest text committed.
+  vector<string> RecentWords() const;
+
+  the<NextWordIndex> index_;
+  string tag_ = "prediction";
+  SegmentTags::TagId tag_id_ = 0;
+  int size_ = 5;
+  double initial_quality_ = 1000;
+  // the last two words learned.
+  vector<string> recent_words_;
+
+ private:
+  connection commit_connection_;
+};
+
+}  // namespace rime
+
+#endif  // RIME_NEXT_WORD_TRANSLATOR_H_
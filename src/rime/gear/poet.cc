@@ -7,25 +7,36 @@
 // 2011-10-06 GONG Chen <chen.sst@gmail.com>
 //
 #include <algorithm>
+#include <array>
 #include <functional>
+#include <rime/cancellation.h>
 #include <rime/candidate.h>
 #include <rime/config.h>
 #include <rime/dict/vocabulary.h>
+#include <rime/gear/caching_grammar.h>
 #include <rime/gear/grammar.h>
+#include <rime/gear/shared_grammar.h>
 #include <rime/gear/poet.h>
 
 namespace rime {
 
+// interned text of the last word of a line.
+using WordId = int;
+
+static const WordId kNoWord = -1;
+
 // internal data structure used during the sentence making process.
 // the output line of the algorithm is transformed to an<Sentence>.
 struct Line {
   // be sure the pointer to predecessor Line object is stable. it works since
-  // pointer to values stored in std::map and std::unordered_map are stable.
+  // a state is no longer modified once lines have been extended from it.
   const Line* predecessor;
   // as long as the word graph lives, pointers to entries are valid.
   const DictEntry* entry;
   size_t end_pos;
   double weight;
+  WordId word_id;
+  size_t word_count;
 
   static const Line kEmpty;
 
@@ -49,32 +60,23 @@ struct Line {
 
   Components components() const { return Components(this); }
 
-  string context() const {
-    // look back 2 words
-    return empty() ? string()
-           : !predecessor || predecessor->empty()
-               ? last_word()
-               : predecessor->last_word() + last_word();
-  }
-
-  vector<size_t> word_lengths() const {
-    vector<size_t> lengths;
-    size_t last_end_pos = 0;
-    for (const auto* c : components()) {
-      lengths.push_back(c->end_pos - last_end_pos);
-      last_end_pos = c->end_pos;
-    }
-    return lengths;
+  // looks back 2 words. the buffer is reused to save allocations.
+  const string& context(string* buffer) const {
+    buffer->clear();
+    if (predecessor && !predecessor->empty())
+      buffer->append(predecessor->entry->text);
+    if (entry)
+      buffer->append(entry->text);
+    return *buffer;
   }
 };
 
-const Line Line::kEmpty{nullptr, nullptr, 0, 0.0};
+const Line Line::kEmpty{nullptr, nullptr, 0, 0.0, kNoWord, 0};
 
-inline static Grammar* create_grammar(Config* config) {
-  if (auto* grammar = Grammar::Require("grammar")) {
-    return grammar->Create(config);
-  }
-  return nullptr;
+inline static an<Grammar> create_grammar(Config* config) {
+  // the model is shared by all poets configured alike.
+  return CachingGrammar::Wrap(SharedGrammar::Require("grammar", config),
+                              config);
 }
 
 Poet::Poet(const Language* language, Config* config, Compare compare)
@@ -93,76 +95,87 @@ bool Poet::LeftAssociateCompare(const Line& one, const Line& other) {
   if (one.weight < other.weight)
     return true;
   if (one.weight == other.weight) {
-    auto one_word_lens = one.word_lengths();
-    auto other_word_lens = other.word_lengths();
     // less words is more favorable
-    if (one_word_lens.size() > other_word_lens.size())
+    if (one.word_count > other.word_count)
       return true;
-    if (one_word_lens.size() == other_word_lens.size()) {
-      return std::lexicographical_compare(
-          one_word_lens.begin(), one_word_lens.end(), other_word_lens.begin(),
-          other_word_lens.end());
+    if (one.word_count == other.word_count) {
+      // compare word lengths from the left. it's the same as comparing the
+      // end positions of words, of which the first difference is the last
+      // one found walking back the lines.
+      bool less = false;
+      for (const Line *a = &one, *b = &other; a != b && !a->empty();
+           a = a->predecessor, b = b->predecessor) {
+        if (a->end_pos != b->end_pos)
+          less = a->end_pos < b->end_pos;
+      }
+      return less;
     }
   }
   return false;
 }
 
-// keep the best line candidate per last phrase
-using LineCandidates = hash_map<string, Line>;
+// keep the best line candidate per last phrase.
+// there are only a few of them per position, so a linear search will do.
+using LineCandidates = vector<Line>;
 
 template <int N>
-static vector<const Line*> find_top_candidates(const LineCandidates& candidates,
-                                               Poet::Compare compare) {
-  vector<const Line*> top;
-  top.reserve(N + 1);
+struct TopCandidates {
+  std::array<const Line*, N> lines;
+  size_t size = 0;
+
+  const Line* const* begin() const { return lines.data(); }
+  const Line* const* end() const { return lines.data() + size; }
+};
+
+template <int N>
+static TopCandidates<N> find_top_candidates(const LineCandidates& candidates,
+                                            Poet::Compare compare) {
+  TopCandidates<N> top;
   for (const auto& candidate : candidates) {
-    auto pos = std::upper_bound(
-        top.begin(), top.end(), &candidate.second,
+    auto* pos = std::upper_bound(
+        top.lines.data(), top.lines.data() + top.size, &candidate,
         [&](const Line* a, const Line* b) { return compare(*b, *a); });  // desc
-    if (pos - top.begin() >= N)
+    size_t index = pos - top.lines.data();
+    if (index >= N)
       continue;
-    top.insert(pos, &candidate.second);
-    if (top.size() > N)
-      top.pop_back();
+    if (top.size < N)
+      ++top.size;
+    std::move_backward(pos, top.lines.data() + top.size - 1,
+                       top.lines.data() + top.size);
+    *pos = &candidate;
   }
   return top;
 }
 
-using UpdateLineCandidate = function<void(const Line& candidate)>;
-
 struct BeamSearch {
   using State = LineCandidates;
 
   static constexpr int kMaxLineCandidates = 7;
 
   static void Initiate(State& initial_state) {
-    initial_state.emplace("", Line::kEmpty);
+    initial_state.push_back(Line::kEmpty);
   }
 
-  static void ForEachCandidate(const State& state,
-                               Poet::Compare compare,
-                               UpdateLineCandidate update) {
-    auto top_candidates =
-        find_top_candidates<kMaxLineCandidates>(state, compare);
-    for (const auto* candidate : top_candidates) {
-      update(*candidate);
-    }
+  static TopCandidates<kMaxLineCandidates> LinesToExtend(
+      const State& state,
+      Poet::Compare compare) {
+    return find_top_candidates<kMaxLineCandidates>(state, compare);
   }
 
   static Line& BestLineToUpdate(State& state, const Line& new_line) {
-    const auto& key = new_line.last_word();
-    return state[key];
+    for (auto& line : state) {
+      if (line.word_id == new_line.word_id)
+        return line;
+    }
+    state.push_back(Line::kEmpty);
+    return state.back();
   }
 
-  static const Line& BestLineInState(const State& final_state,
-                                     Poet::Compare compare) {
-    const Line* best = nullptr;
-    for (const auto& candidate : final_state) {
-      if (!best || compare(*best, candidate.second)) {
-        best = &candidate.second;
-      }
-    }
-    return best ? *best : Line::kEmpty;
+  // the best first.
+  static TopCandidates<kMaxLineCandidates> BestLinesInState(
+      const State& final_state,
+      Poet::Compare compare) {
+    return find_top_candidates<kMaxLineCandidates>(final_state, compare);
   }
 };
 
@@ -171,52 +184,210 @@ struct DynamicProgramming {
 
   static void Initiate(State& initial_state) { initial_state = Line::kEmpty; }
 
-  static void ForEachCandidate(const State& state,
-                               Poet::Compare compare,
-                               UpdateLineCandidate update) {
-    update(state);
+  static TopCandidates<1> LinesToExtend(const State& state,
+                                        Poet::Compare compare) {
+    TopCandidates<1> top;
+    top.lines[0] = &state;
+    top.size = 1;
+    return top;
   }
 
   static Line& BestLineToUpdate(State& state, const Line& new_line) {
     return state;
   }
 
-  static const Line& BestLineInState(const State& final_state,
-                                     Poet::Compare compare) {
-    return final_state;
+  static TopCandidates<1> BestLinesInState(const State& final_state,
+                                           Poet::Compare compare) {
+    return LinesToExtend(final_state, compare);
+  }
+};
+
+static inline void hash_combine(size_t& seed, size_t value) {
+  seed ^= value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+}
+
+static size_t hash_entry(const DictEntry& entry) {
+  size_t seed = std::hash<string>()(entry.text);
+  hash_combine(seed, std::hash<string>()(entry.comment));
+  hash_combine(seed, std::hash<string>()(entry.preedit));
+  hash_combine(seed, std::hash<double>()(entry.weight));
+  for (SyllableId syllable_id : entry.code) {
+    hash_combine(seed, syllable_id);
+  }
+  return seed;
+}
+
+struct Poet::Lattice {
+  string preceding_text;
+  size_t total_length = 0;
+  // hash of all edges of the word graph ending at or before each position.
+  map<int, size_t> prefix_hashes;
+  // keeps alive the entries of the last word of lines ending at each position.
+  map<int, DictEntryList> entries;
+  hash_map<string, WordId> word_ids;
+  // buffers reused in the search, to save allocations.
+  vector<string> context_buffers;
+  vector<const string*> contexts;
+  vector<const string*> words;
+  vector<WordId> edge_word_ids;
+  vector<double> scores;
+
+  virtual ~Lattice() = default;
+
+  // returns the position from which on the states should be rebuilt.
+  size_t Update(const WordGraph& graph,
+                size_t total_length,
+                const string& preceding_text);
+
+  WordId Intern(const string& word) {
+    auto found = word_ids.find(word);
+    if (found != word_ids.end())
+      return found->second;
+    WordId word_id = static_cast<WordId>(word_ids.size());
+    word_ids.emplace(word, word_id);
+    return word_id;
   }
 };
 
+size_t Poet::Lattice::Update(const WordGraph& graph,
+                             size_t total_length,
+                             const string& preceding_text) {
+  map<int, size_t> edge_hashes;
+  for (const auto& sv : graph) {
+    for (const auto& ev : sv.second) {
+      size_t& seed = edge_hashes[ev.first];
+      hash_combine(seed, sv.first);
+      for (const auto& entry : ev.second) {
+        hash_combine(seed, hash_entry(*entry));
+      }
+    }
+  }
+  map<int, size_t> new_prefix_hashes;
+  size_t prefix_hash = 0;
+  for (const auto& x : edge_hashes) {
+    hash_combine(prefix_hash, x.first);
+    hash_combine(prefix_hash, x.second);
+    new_prefix_hashes.emplace_hint(new_prefix_hashes.end(), x.first,
+                                   prefix_hash);
+  }
+  // the line ending at the total length is weighed as the rear of sentence,
+  // so the state there is never reused for a different total length.
+  size_t rebuild_from =
+      preceding_text == this->preceding_text
+          ? (std::min)(this->total_length, total_length)
+          : 0;
+  auto x = prefix_hashes.cbegin();
+  auto y = new_prefix_hashes.cbegin();
+  while (x != prefix_hashes.cend() && y != new_prefix_hashes.cend() &&
+         *x == *y) {
+    ++x;
+    ++y;
+  }
+  if (x != prefix_hashes.cend())
+    rebuild_from = (std::min)(rebuild_from, static_cast<size_t>(x->first));
+  if (y != new_prefix_hashes.cend())
+    rebuild_from = (std::min)(rebuild_from, static_cast<size_t>(y->first));
+
+  entries.erase(entries.lower_bound(rebuild_from), entries.end());
+  if (rebuild_from == 0)
+    word_ids.clear();
+  for (const auto& sv : graph) {
+    for (const auto& ev : sv.second) {
+      if (static_cast<size_t>(ev.first) < rebuild_from)
+        continue;
+      auto& kept = entries[ev.first];
+      kept.insert(kept.end(), ev.second.begin(), ev.second.end());
+    }
+  }
+  prefix_hashes.swap(new_prefix_hashes);
+  this->total_length = total_length;
+  this->preceding_text = preceding_text;
+  return rebuild_from;
+}
+
+template <class State>
+struct Poet::StrategyLattice : Poet::Lattice {
+  // lines refer to their predecessors in states at lower positions, which are
+  // kept in place as long as they are reused.
+  map<int, State> states;
+};
+
+void Poet::ReleaseLattice() {
+  lattice_.reset();
+}
+
 template <class Strategy>
-an<Sentence> Poet::MakeSentenceWithStrategy(const WordGraph& graph,
-                                            size_t total_length,
-                                            const string& preceding_text) {
-  map<int, typename Strategy::State> states;
-  Strategy::Initiate(states[0]);
+vector<of<Sentence>> Poet::MakeSentencesWithStrategy(
+    const WordGraph& graph,
+    size_t total_length,
+    const string& preceding_text,
+    size_t max_sentences) {
+  using CachedLattice = StrategyLattice<typename Strategy::State>;
+  if (!lattice_)
+    lattice_.reset(new CachedLattice);
+  auto& lattice = static_cast<CachedLattice&>(*lattice_);
+  size_t rebuild_from = lattice.Update(graph, total_length, preceding_text);
+  DLOG(INFO) << "rebuild states from pos: " << rebuild_from;
+  auto& states = lattice.states;
+  states.erase(states.lower_bound(rebuild_from), states.end());
+  if (states.empty())
+    Strategy::Initiate(states[0]);
   for (const auto& sv : graph) {
+    if (Cancellation::Requested()) {
+      // states left half made are not to be reused.
+      lattice_.reset();
+      return {};
+    }
     size_t start_pos = sv.first;
+    if (sv.second.empty() ||
+        static_cast<size_t>(sv.second.rbegin()->first) < rebuild_from)
+      continue;  // all edges end at reused states
     if (states.find(start_pos) == states.end())
       continue;
     DLOG(INFO) << "start pos: " << start_pos;
     const auto& source_state = states[start_pos];
-    const auto update = [this, &states, &sv, start_pos, total_length,
-                         &preceding_text](const Line& candidate) {
-      for (const auto& ev : sv.second) {
-        size_t end_pos = ev.first;
-        if (start_pos == 0 && end_pos == total_length)
-          continue;  // exclude single word from the result
-        DLOG(INFO) << "end pos: " << end_pos;
-        bool is_rear = end_pos == total_length;
-        auto& target_state = states[end_pos];
-        // extend candidates with dict entries on a valid edge.
-        const DictEntryList& entries = ev.second;
-        for (const auto& entry : entries) {
-          const string& context =
-              candidate.empty() ? preceding_text : candidate.context();
-          double weight = candidate.weight +
-                          Grammar::Evaluate(context, entry->text, entry->weight,
-                                            is_rear, grammar_.get());
-          Line new_line{&candidate, entry.get(), end_pos, weight};
+    const auto candidates = Strategy::LinesToExtend(source_state, compare_);
+    if (candidates.size == 0)
+      continue;
+    if (lattice.context_buffers.size() < candidates.size)
+      lattice.context_buffers.resize(candidates.size);
+    auto& contexts = lattice.contexts;
+    contexts.clear();
+    for (const auto* candidate : candidates) {
+      contexts.push_back(
+          candidate->empty()
+              ? &preceding_text
+              : &candidate->context(&lattice.context_buffers[contexts.size()]));
+    }
+    for (const auto& ev : sv.second) {
+      size_t end_pos = ev.first;
+      if (end_pos < rebuild_from)
+        continue;
+      if (start_pos == 0 && end_pos == total_length)
+        continue;  // exclude single word from the result
+      DLOG(INFO) << "end pos: " << end_pos;
+      bool is_rear = end_pos == total_length;
+      // extend candidates with dict entries on a valid edge.
+      const DictEntryList& entries = ev.second;
+      auto& words = lattice.words;
+      auto& word_ids = lattice.edge_word_ids;
+      words.clear();
+      word_ids.clear();
+      for (const auto& entry : entries) {
+        words.push_back(&entry->text);
+        word_ids.push_back(lattice.Intern(entry->text));
+      }
+      // score all the words after each candidate in one go.
+      Grammar::EvaluateBatch(contexts, words, is_rear, grammar_.get(),
+                             &lattice.scores);
+      auto score = lattice.scores.cbegin();
+      auto& target_state = states[end_pos];
+      for (const auto* candidate : candidates) {
+        for (size_t i = 0; i < entries.size(); ++i) {
+          const auto& entry = entries[i];
+          double weight = candidate->weight + (entry->weight + *score++);
+          Line new_line{candidate, entry.get(), end_pos, weight, word_ids[i],
+                        candidate->word_count + 1};
           Line& best = Strategy::BestLineToUpdate(target_state, new_line);
           if (best.empty() || compare_(best, new_line)) {
             DLOG(INFO) << "updated line ending at " << end_pos
@@ -226,15 +397,24 @@ an<Sentence> Poet::MakeSentenceWithStrategy(const WordGraph& graph,
           }
         }
       }
-    };
-    Strategy::ForEachCandidate(source_state, compare_, update);
+    }
   }
+  vector<of<Sentence>> sentences;
   auto found = states.find(total_length);
-  if (found == states.end() || found->second.empty())
-    return nullptr;
-  const Line& best = Strategy::BestLineInState(found->second, compare_);
+  if (found == states.end())
+    return sentences;
+  for (const Line* line : Strategy::BestLinesInState(found->second, compare_)) {
+    if (sentences.size() >= max_sentences)
+      break;
+    if (!line->empty())
+      sentences.push_back(ToSentence(*line));
+  }
+  return sentences;
+}
+
+an<Sentence> Poet::ToSentence(const Line& line) const {
   auto sentence = New<Sentence>(language_);
-  for (const auto* c : best.components()) {
+  for (const auto* c : line.components()) {
     if (!c->entry)
       continue;
     sentence->Extend(*c->entry, c->end_pos, c->weight);
@@ -245,10 +425,18 @@ an<Sentence> Poet::MakeSentenceWithStrategy(const WordGraph& graph,
 an<Sentence> Poet::MakeSentence(const WordGraph& graph,
                                 size_t total_length,
                                 const string& preceding_text) {
-  return grammar_ ? MakeSentenceWithStrategy<BeamSearch>(graph, total_length,
-                                                         preceding_text)
-                  : MakeSentenceWithStrategy<DynamicProgramming>(
-                        graph, total_length, preceding_text);
+  auto sentences = MakeSentences(graph, total_length, preceding_text, 1);
+  return sentences.empty() ? nullptr : sentences.front();
+}
+
+vector<of<Sentence>> Poet::MakeSentences(const WordGraph& graph,
+                                         size_t total_length,
+                                         const string& preceding_text,
+                                         size_t max_sentences) {
+  return grammar_ ? MakeSentencesWithStrategy<BeamSearch>(
+                        graph, total_length, preceding_text, max_sentences)
+                  : MakeSentencesWithStrategy<DynamicProgramming>(
+                        graph, total_length, preceding_text, max_sentences);
 }
 
 }  // namespace rime
@@ -39,6 +39,17 @@ class Poet {
   an<Sentence> MakeSentence(const WordGraph& graph,
                             size_t total_length,
                             const string& preceding_text);
+  // the best sentences, at most max_sentences of them and the best first,
+  // made in the same pass as the one from MakeSentence().
+  // the alternatives are the lines kept by the beam search at the end of the
+  // input, which end in different words; without a grammar, there is only
+  // the best sentence.
+  vector<of<Sentence>> MakeSentences(const WordGraph& graph,
+                                     size_t total_length,
+                                     const string& preceding_text,
+                                     size_t max_sentences);
+  // forgets the states of the last sentence made.
+  void ReleaseLattice();
 
   template <class TranslatorT>
   an<Translation> ContextualWeighted(an<Translation> translation,
@@ -52,19 +63,33 @@ class Poet {
     if (preceding_text.empty()) {
       return translation;
     }
-    return New<ContextualTranslation>(translation, input, preceding_text,
-                                      grammar_.get());
+    auto contextual = New<ContextualTranslation>(
+        translation, input, preceding_text, grammar_.get());
+    if (translator->contextual_time_budget() > 0) {
+      contextual->set_time_budget(translator->contextual_time_budget(),
+                                  translator->page_size());
+    }
+    return contextual;
   }
 
  private:
   template <class Strategy>
-  an<Sentence> MakeSentenceWithStrategy(const WordGraph& graph,
-                                        size_t total_length,
-                                        const string& preceding_text);
+  vector<of<Sentence>> MakeSentencesWithStrategy(const WordGraph& graph,
+                                                 size_t total_length,
+                                                 const string& preceding_text,
+                                                 size_t max_sentences);
+  an<Sentence> ToSentence(const Line& line) const;
+
+  // states of the last sentence made, which are reused for the next one as
+  // far as the word graph has not changed.
+  struct Lattice;
+  template <class State>
+  struct StrategyLattice;
 
   const Language* language_;
-  the<Grammar> grammar_;
+  an<Grammar> grammar_;
   Compare compare_;
+  the<Lattice> lattice_;
 };
 
 }  // namespace rime
@@ -20,25 +20,156 @@
 
 namespace rime {
 
+static const SegmentTags::TagId kPunctTag = SegmentTags::Intern("punct");
+
+// the comment on the shape of a single character mark.
+static string punct_shape(const string& punct) {
+  const char half_shape[] =
+      "\xe3\x80\x94\xe5\x8d\x8a\xe8\xa7\x92\xe3\x80\x95";  // 〔半角〕
+  const char full_shape[] =
+      "\xe3\x80\x94\xe5\x85\xa8\xe8\xa7\x92\xe3\x80\x95";  // 〔全角〕
+  bool is_half_shape = false;
+  bool is_full_shape = false;
+  const char* p = punct.c_str();
+  uint32_t ch = utf8::unchecked::next(p);
+  if (*p == '\0') {  // length == 1 unicode character
+    bool is_ascii = (ch >= 0x20 && ch < 0x7F);
+    bool is_ideographic_space = (ch == 0x3000);
+    bool is_full_shape_ascii = (ch >= 0xFF01 && ch <= 0xFF5E);
+    bool is_kana =
+        ((ch >= 0x30A1 && ch <= 0x30FC) || ch == 0x3001 || ch == 0x3002 ||
+         ch == 0x300C || ch == 0x300D || ch == 0x309B || ch == 0x309C);
+    bool is_half_shape_kana = (ch >= 0xFF61 && ch <= 0xFF9F);
+    bool is_hangul = (ch >= 0x3131 && ch <= 0x3164);
+    bool is_half_shape_hangul = (ch >= 0xFFA0 && ch <= 0xFFDC);
+    bool is_full_shape_narrow_symbol =
+        (ch == 0xFF5F || ch == 0xFF60 || (ch >= 0xFFE0 && ch <= 0xFFE6));
+    bool is_narrow_symbol =
+        (ch == 0x00A2 || ch == 0x00A3 || ch == 0x00A5 || ch == 0x00A6 ||
+         ch == 0x00AC || ch == 0x00AF || ch == 0x2985 || ch == 0x2986);
+    bool is_half_shape_wide_symbol = (ch >= 0xFFE8 && ch <= 0xFFEE);
+    bool is_wide_symbol = ((ch >= 0x2190 && ch <= 0x2193) || ch == 0x2502 ||
+                           ch == 0x25A0 || ch == 0x25CB);
+    is_half_shape = is_ascii || is_half_shape_kana || is_half_shape_hangul ||
+                    is_narrow_symbol || is_half_shape_wide_symbol;
+    is_full_shape = is_ideographic_space || is_full_shape_ascii || is_kana ||
+                    is_hangul || is_full_shape_narrow_symbol || is_wide_symbol;
+  }
+  return is_half_shape ? half_shape : is_full_shape ? full_shape : "";
+}
+
+static void add_punct(PunctDefinition* definition, const string& punct) {
+  definition->puncts.push_back(punct);
+  definition->comments.push_back(punct_shape(punct));
+}
+
+static void compile_punct(const string& key,
+                          const an<ConfigItem>& item,
+                          PunctDefinition* definition) {
+  if (auto value = As<ConfigValue>(item)) {
+    definition->type = PunctDefinition::kUnique;
+    add_punct(definition, value->str());
+  } else if (auto list = As<ConfigList>(item)) {
+    definition->type = PunctDefinition::kAlternating;
+    for (size_t i = 0; i < list->size(); ++i) {
+      auto value = list->GetValueAt(i);
+      if (!value) {
+        LOG(WARNING) << "invalid alternating punct at index " << i
+                     << " for '" << key << "'.";
+        continue;
+      }
+      add_punct(definition, value->str());
+    }
+    if (definition->puncts.empty()) {
+      LOG(WARNING) << "empty candidate list for alternating punct '" << key
+                   << "'.";
+    }
+  } else if (auto map = As<ConfigMap>(item)) {
+    if (map->HasKey("commit")) {
+      definition->type = PunctDefinition::kAutoCommit;
+      if (auto value = map->GetValue("commit")) {
+        add_punct(definition, value->str());
+      } else {
+        LOG(WARNING) << "unrecognized punct definition for '" << key << "'.";
+      }
+    } else if (map->HasKey("pair")) {
+      definition->type = PunctDefinition::kPaired;
+      auto list = As<ConfigList>(map->Get("pair"));
+      for (size_t i = 0; list && i < list->size(); ++i) {
+        if (auto value = list->GetValueAt(i))
+          add_punct(definition, value->str());
+      }
+      if (definition->puncts.size() != 2) {
+        LOG(WARNING) << "unrecognized pair definition for '" << key << "'.";
+        definition->puncts.clear();
+        definition->comments.clear();
+      }
+    } else {
+      definition->type = PunctDefinition::kUnknown;
+    }
+  } else {
+    definition->type = PunctDefinition::kUnknown;
+  }
+}
+
+static an<const PunctTable> compile_punct_table(const an<ConfigMap>& mapping,
+                                                const an<ConfigMap>& symbols) {
+  auto table = New<PunctTable>();
+  for (const auto& source : {mapping, symbols}) {
+    if (!source)
+      continue;
+    for (const auto& x : *source) {
+      if (table->definitions.count(x.first))
+        continue;  // symbols do not override the mapping
+      compile_punct(x.first, x.second, &table->definitions[x.first]);
+    }
+  }
+  for (const auto& x : table->definitions) {
+    const string& key = x.first;
+    if (key.length() == 1 && key[0] >= 0x20 && key[0] < 0x7f)
+      table->key_definitions[int(key[0])] = &x.second;
+  }
+  return table;
+}
+
 void PunctConfig::LoadConfig(Engine* engine, bool load_symbols) {
+  if (!loaded_) {
+    loaded_ = true;
+    Config* config = engine->schema()->config();
+    auto symbols = load_symbols ? config->GetMap("punctuator/symbols")
+                                : nullptr;
+    auto half_shape = config->GetMap("punctuator/half_shape");
+    auto full_shape = config->GetMap("punctuator/full_shape");
+    half_shape_ = compile_punct_table(half_shape, symbols);
+    full_shape_ = compile_punct_table(full_shape, symbols);
+  }
   bool full_shape = engine->context()->get_option("full_shape");
-  string shape(full_shape ? "full_shape" : "half_shape");
-  if (shape_ == shape)
+  auto& table = full_shape ? full_shape_ : half_shape_;
+  if (table_ == table)
     return;
-  shape_ = shape;
-  Config* config = engine->schema()->config();
-  mapping_ = config->GetMap("punctuator/" + shape);
-  if (!mapping_) {
+  table_ = table;
+  if (table_->definitions.empty()) {
     LOG(WARNING) << "missing punctuation mapping.";
   }
-  if (load_symbols) {
-    symbols_ = config->GetMap("punctuator/symbols");
-  }
 }
 
-an<ConfigItem> PunctConfig::GetPunctDefinition(const string key) {
-  an<ConfigItem> result = mapping_ ? mapping_->Get(key) : nullptr;
-  return result ? result : symbols_ ? symbols_->Get(key) : nullptr;
+const PunctDefinition* PunctConfig::GetPunctDefinition(
+    const string& key) const {
+  if (!table_)
+    return nullptr;
+  if (key.length() == 1)
+    return GetPunctDefinition(key[0]);
+  auto found = table_->definitions.find(key);
+  return found != table_->definitions.end() ? &found->second : nullptr;
+}
+
+const PunctDefinition* PunctConfig::GetPunctDefinition(int ch) const {
+  if (!table_)
+    return nullptr;
+  if (ch >= 0x20 && ch < 0x7f)
+    return table_->key_definitions[ch];
+  auto found = table_->definitions.find(string(1, char(ch)));
+  return found != table_->definitions.end() ? &found->second : nullptr;
 }
 
 Punctuator::Punctuator(const Ticket& ticket) : Processor(ticket) {
@@ -51,7 +182,7 @@ Punctuator::Punctuator(const Ticket& ticket) : Processor(ticket) {
 
 static bool punctuation_is_translated(Context* ctx) {
   Composition& comp = ctx->composition();
-  if (comp.empty() || !comp.back().HasTag("punct")) {
+  if (comp.empty() || !comp.back().HasTag(kPunctTag)) {
     return false;
   }
   auto cand = comp.back().GetSelectedCandidate();
@@ -82,10 +213,10 @@ ProcessResult Punctuator::ProcessKeyEvent(const KeyEvent& key_event) {
     }
   }
   config_.LoadConfig(engine_);
-  string punct_key(1, ch);
-  auto punct_definition = config_.GetPunctDefinition(punct_key);
+  auto punct_definition = config_.GetPunctDefinition(ch);
   if (!punct_definition)
     return kNoop;
+  string punct_key(1, ch);
   DLOG(INFO) << "punct key: '" << punct_key << "'";
   if (!AlternatePunct(punct_key, punct_definition)) {
     ctx->PushInput(ch) && punctuation_is_translated(ctx) &&
@@ -96,15 +227,15 @@ ProcessResult Punctuator::ProcessKeyEvent(const KeyEvent& key_event) {
 }
 
 bool Punctuator::AlternatePunct(const string& key,
-                                const an<ConfigItem>& definition) {
-  if (!As<ConfigList>(definition))
+                                const PunctDefinition* definition) {
+  if (definition->type != PunctDefinition::kAlternating)
     return false;
   Context* ctx = engine_->context();
   Composition& comp = ctx->composition();
   if (comp.empty())
     return false;
   Segment& segment(comp.back());
-  if (segment.status > Segment::kVoid && segment.HasTag("punct") &&
+  if (segment.status > Segment::kVoid && segment.HasTag(kPunctTag) &&
       key == ctx->input().substr(segment.start, segment.end - segment.start)) {
     if (!segment.menu ||
         segment.menu->Prepare(segment.selected_index + 2) == 0) {
@@ -119,31 +250,29 @@ bool Punctuator::AlternatePunct(const string& key,
   return false;
 }
 
-bool Punctuator::ConfirmUniquePunct(const an<ConfigItem>& definition) {
-  if (!As<ConfigValue>(definition))
+bool Punctuator::ConfirmUniquePunct(const PunctDefinition* definition) {
+  if (definition->type != PunctDefinition::kUnique)
     return false;
   engine_->context()->ConfirmCurrentSelection();
   return true;
 }
 
-bool Punctuator::AutoCommitPunct(const an<ConfigItem>& definition) {
-  auto map = As<ConfigMap>(definition);
-  if (!map || !map->HasKey("commit"))
+bool Punctuator::AutoCommitPunct(const PunctDefinition* definition) {
+  if (definition->type != PunctDefinition::kAutoCommit)
     return false;
   engine_->context()->Commit();
   return true;
 }
 
-bool Punctuator::PairPunct(const an<ConfigItem>& definition) {
-  auto map = As<ConfigMap>(definition);
-  if (!map || !map->HasKey("pair"))
+bool Punctuator::PairPunct(const PunctDefinition* definition) {
+  if (definition->type != PunctDefinition::kPaired)
     return false;
   Context* ctx = engine_->context();
   Composition& comp = ctx->composition();
   if (comp.empty())
     return false;
   Segment& segment(comp.back());
-  if (segment.status > Segment::kVoid && segment.HasTag("punct")) {
+  if (segment.status > Segment::kVoid && segment.HasTag(kPunctTag)) {
     if (!segment.menu || segment.menu->Prepare(2) < 2) {
       LOG(ERROR) << "missing candidate for paired punctuation.";
       return false;
@@ -171,15 +300,13 @@ bool PunctSegmentor::Proceed(Segmentation* segmentation) {
   if (ch < 0x20 || ch >= 0x7f)
     return true;
   config_.LoadConfig(engine_);
-  string punct_key(1, ch);
-  auto punct_definition = config_.GetPunctDefinition(punct_key);
-  if (!punct_definition)
+  if (!config_.GetPunctDefinition(ch))
     return true;
   {
     Segment segment(k, k + 1);
     DLOG(INFO) << "add a punctuation segment [" << segment.start << ", "
                << segment.end << ")";
-    segment.tags.insert("punct");
+    segment.tags.Add(kPunctTag);
     segmentation->AddSegment(segment);
   }
   return false;  // exclusive
@@ -190,150 +317,67 @@ PunctTranslator::PunctTranslator(const Ticket& ticket) : Translator(ticket) {
   config_.LoadConfig(engine_, load_symbols);
 }
 
-an<Candidate> CreatePunctCandidate(const string& punct,
-                                   const Segment& segment) {
-  const char half_shape[] =
-      "\xe3\x80\x94\xe5\x8d\x8a\xe8\xa7\x92\xe3\x80\x95";  // 〔半角〕
-  const char full_shape[] =
-      "\xe3\x80\x94\xe5\x85\xa8\xe8\xa7\x92\xe3\x80\x95";  // 〔全角〕
-  bool is_half_shape = false;
-  bool is_full_shape = false;
-  const char* p = punct.c_str();
-  uint32_t ch = utf8::unchecked::next(p);
-  if (*p == '\0') {  // length == 1 unicode character
-    bool is_ascii = (ch >= 0x20 && ch < 0x7F);
-    bool is_ideographic_space = (ch == 0x3000);
-    bool is_full_shape_ascii = (ch >= 0xFF01 && ch <= 0xFF5E);
-    bool is_kana =
-        ((ch >= 0x30A1 && ch <= 0x30FC) || ch == 0x3001 || ch == 0x3002 ||
-         ch == 0x300C || ch == 0x300D || ch == 0x309B || ch == 0x309C);
-    bool is_half_shape_kana = (ch >= 0xFF61 && ch <= 0xFF9F);
-    bool is_hangul = (ch >= 0x3131 && ch <= 0x3164);
-    bool is_half_shape_hangul = (ch >= 0xFFA0 && ch <= 0xFFDC);
-    bool is_full_shape_narrow_symbol =
-        (ch == 0xFF5F || ch == 0xFF60 || (ch >= 0xFFE0 && ch <= 0xFFE6));
-    bool is_narrow_symbol =
-        (ch == 0x00A2 || ch == 0x00A3 || ch == 0x00A5 || ch == 0x00A6 ||
-         ch == 0x00AC || ch == 0x00AF || ch == 0x2985 || ch == 0x2986);
-    bool is_half_shape_wide_symbol = (ch >= 0xFFE8 && ch <= 0xFFEE);
-    bool is_wide_symbol = ((ch >= 0x2190 && ch <= 0x2193) || ch == 0x2502 ||
-                           ch == 0x25A0 || ch == 0x25CB);
-    is_half_shape = is_ascii || is_half_shape_kana || is_half_shape_hangul ||
-                    is_narrow_symbol || is_half_shape_wide_symbol;
-    is_full_shape = is_ideographic_space || is_full_shape_ascii || is_kana ||
-                    is_hangul || is_full_shape_narrow_symbol || is_wide_symbol;
+// candidates for the marks of a definition, made as they are asked for.
+class PunctTranslation : public Translation {
+ public:
+  PunctTranslation(an<const PunctTable> table,
+                   const PunctDefinition* definition,
+                   const Segment& segment)
+      : table_(std::move(table)),
+        definition_(definition),
+        start_(segment.start),
+        end_(segment.end) {
+    set_exhausted(definition_->puncts.empty());
   }
-  bool one_key = (segment.end - segment.start == 1);
-  return New<SimpleCandidate>("punct", segment.start, segment.end, punct,
-                              (is_half_shape   ? half_shape
-                               : is_full_shape ? full_shape
-                                               : ""),
-                              one_key ? punct : "");
+
+  bool Next() override {
+    if (exhausted())
+      return false;
+    if (++index_ == definition_->puncts.size())
+      set_exhausted(true);
+    return true;
+  }
+
+  an<Candidate> Peek() override {
+    if (exhausted())
+      return nullptr;
+    const string& punct = definition_->puncts[index_];
+    bool one_key = (end_ - start_ == 1);
+    return New<SimpleCandidate>("punct", start_, end_, punct,
+                                definition_->comments[index_],
+                                one_key ? punct : "");
+  }
+
+ private:
+  // keeps the definition alive
+  an<const PunctTable> table_;
+  const PunctDefinition* definition_;
+  size_t start_;
+  size_t end_;
+  size_t index_ = 0;
+};
+
+int PunctTranslator::ProbeCandidates(const string& input,
+                                     const Segment& segment,
+                                     int limit) {
+  return segment.HasTag(kPunctTag) ? -1 : 0;
 }
 
 an<Translation> PunctTranslator::Query(const string& input,
                                        const Segment& segment) {
-  if (!segment.HasTag("punct"))
+  if (!segment.HasTag(kPunctTag))
     return nullptr;
   config_.LoadConfig(engine_);
   auto definition = config_.GetPunctDefinition(input);
-  if (!definition)
+  if (!definition || definition->puncts.empty())
     return nullptr;
   DLOG(INFO) << "populating punctuation candidates for '" << input << "'.";
-  auto translation =
-      TranslateUniquePunct(input, segment, As<ConfigValue>(definition));
-  if (!translation)
-    translation =
-        TranslateAlternatingPunct(input, segment, As<ConfigList>(definition));
-  if (!translation)
-    translation =
-        TranslateAutoCommitPunct(input, segment, As<ConfigMap>(definition));
-  if (!translation)
-    translation =
-        TranslatePairedPunct(input, segment, As<ConfigMap>(definition));
   // if (translation) {
   //   const char tips[] =
   //       "\xe3\x80\x94\xe7\xac\xa6\xe8\x99\x9f\xe3\x80\x95";  // 〔符號〕
   //   const_cast<Segment*>(&segment)->prompt = tips;
   // }
-  return translation;
-}
-
-an<Translation> PunctTranslator::TranslateUniquePunct(
-    const string& key,
-    const Segment& segment,
-    const an<ConfigValue>& definition) {
-  if (!definition)
-    return nullptr;
-  return New<UniqueTranslation>(
-      CreatePunctCandidate(definition->str(), segment));
-}
-
-an<Translation> PunctTranslator::TranslateAlternatingPunct(
-    const string& key,
-    const Segment& segment,
-    const an<ConfigList>& definition) {
-  if (!definition)
-    return nullptr;
-  auto translation = New<FifoTranslation>();
-  for (size_t i = 0; i < definition->size(); ++i) {
-    auto value = definition->GetValueAt(i);
-    if (!value) {
-      LOG(WARNING) << "invalid alternating punct at index " << i << " for '"
-                   << key << "'.";
-      continue;
-    }
-    translation->Append(CreatePunctCandidate(value->str(), segment));
-  }
-  if (!translation->size()) {
-    LOG(WARNING) << "empty candidate list for alternating punct '" << key
-                 << "'.";
-    translation.reset();
-  }
-  return translation;
-}
-
-an<Translation> PunctTranslator::TranslateAutoCommitPunct(
-    const string& key,
-    const Segment& segment,
-    const an<ConfigMap>& definition) {
-  if (!definition || !definition->HasKey("commit"))
-    return nullptr;
-  auto value = definition->GetValue("commit");
-  if (!value) {
-    LOG(WARNING) << "unrecognized punct definition for '" << key << "'.";
-    return nullptr;
-  }
-  return New<UniqueTranslation>(CreatePunctCandidate(value->str(), segment));
-}
-
-an<Translation> PunctTranslator::TranslatePairedPunct(
-    const string& key,
-    const Segment& segment,
-    const an<ConfigMap>& definition) {
-  if (!definition || !definition->HasKey("pair"))
-    return nullptr;
-  auto list = As<ConfigList>(definition->Get("pair"));
-  if (!list || list->size() != 2) {
-    LOG(WARNING) << "unrecognized pair definition for '" << key << "'.";
-    return nullptr;
-  }
-  auto translation = New<FifoTranslation>();
-  for (size_t i = 0; i < list->size(); ++i) {
-    auto value = list->GetValueAt(i);
-    if (!value) {
-      LOG(WARNING) << "invalid paired punct at index " << i << " for '" << key
-                   << "'.";
-      continue;
-    }
-    translation->Append(CreatePunctCandidate(value->str(), segment));
-  }
-  if (translation->size() != 2) {
-    LOG(WARNING) << "invalid num of candidate for paired punct '" << key
-                 << "'.";
-    translation.reset();
-  }
-  return translation;
+  return New<PunctTranslation>(config_.table(), definition, segment);
 }
 
 }  // namespace rime
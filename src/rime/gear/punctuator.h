@@ -18,15 +18,43 @@ namespace rime {
 
 class Engine;
 
+// a punctuation mapping, compiled from its definition in the config.
+struct PunctDefinition {
+  enum Type {
+    kUnique,       // a single mark
+    kAlternating,  // marks alternating on repeated keys
+    kAutoCommit,   // a mark committed right away
+    kPaired,       // a pair of marks used in turn
+    kUnknown,      // taken as a punctuation key, but not translated
+  };
+  Type type = kUnique;
+  // the marks to choose from, and the comments on their shapes; left empty
+  // if the definition is invalid.
+  vector<string> puncts;
+  vector<string> comments;
+};
+
+// definitions of a shape keyed by input; those of single printable keys
+// are also indexed by keycode.
+struct PunctTable {
+  hash_map<string, PunctDefinition> definitions;
+  const PunctDefinition* key_definitions[0x80] = {};
+};
+
 class PunctConfig {
  public:
+  // compiles the mappings of both shapes once, and picks the one for the
+  // current shape.
   void LoadConfig(Engine* engine, bool load_symbols = false);
-  an<ConfigItem> GetPunctDefinition(const string key);
+  const PunctDefinition* GetPunctDefinition(const string& key) const;
+  const PunctDefinition* GetPunctDefinition(int ch) const;
+  const an<const PunctTable>& table() const { return table_; }
 
  protected:
-  string shape_;
-  an<ConfigMap> mapping_;
-  an<ConfigMap> symbols_;
+  bool loaded_ = false;
+  an<const PunctTable> half_shape_;
+  an<const PunctTable> full_shape_;
+  an<const PunctTable> table_;
 };
 
 class Punctuator : public Processor {
@@ -35,14 +63,14 @@ class Punctuator : public Processor {
   virtual ProcessResult ProcessKeyEvent(const KeyEvent& key_event);
 
  protected:
-  bool ConfirmUniquePunct(const an<ConfigItem>& definition);
-  bool AlternatePunct(const string& key, const an<ConfigItem>& definition);
-  bool AutoCommitPunct(const an<ConfigItem>& definition);
-  bool PairPunct(const an<ConfigItem>& definition);
+  bool ConfirmUniquePunct(const PunctDefinition* definition);
+  bool AlternatePunct(const string& key, const PunctDefinition* definition);
+  bool AutoCommitPunct(const PunctDefinition* definition);
+  bool PairPunct(const PunctDefinition* definition);
 
   PunctConfig config_;
   bool use_space_ = false;
-  map<an<ConfigItem>, int> oddness_;
+  map<const PunctDefinition*, int> oddness_;
 };
 
 class PunctSegmentor : public Segmentor {
@@ -58,21 +86,11 @@ class PunctTranslator : public Translator {
  public:
   PunctTranslator(const Ticket& ticket);
   virtual an<Translation> Query(const string& input, const Segment& segment);
+  virtual int ProbeCandidates(const string& input,
+                              const Segment& segment,
+                              int limit);
 
  protected:
-  an<Translation> TranslateUniquePunct(const string& key,
-                                       const Segment& segment,
-                                       const an<ConfigValue>& definition);
-  an<Translation> TranslateAlternatingPunct(const string& key,
-                                            const Segment& segment,
-                                            const an<ConfigList>& definition);
-  an<Translation> TranslateAutoCommitPunct(const string& key,
-                                           const Segment& segment,
-                                           const an<ConfigMap>& definition);
-  an<Translation> TranslatePairedPunct(const string& key,
-                                       const Segment& segment,
-                                       const an<ConfigMap>& definition);
-
   PunctConfig config_;
 };
 
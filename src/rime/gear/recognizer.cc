@@ -4,6 +4,7 @@
 //
 // 2012-01-01 GONG Chen <chen.sst@gmail.com>
 //
+#include <algorithm>
 #include <rime/common.h>
 #include <rime/composition.h>
 #include <rime/config.h>
@@ -34,6 +35,38 @@ static void load_patterns(RecognizerPatterns* patterns, an<ConfigMap> map) {
 
 void RecognizerPatterns::LoadConfig(Config* config, const string& name_space) {
   load_patterns(this, config->GetMap(name_space + "/patterns"));
+  Compile();
+}
+
+// numbered groups are renumbered in the combined regex.
+static const boost::regex kBackReference("\\\\(\\d|g|k)");
+
+void RecognizerPatterns::Compile() {
+  combined_ = boost::regex();
+  tags_.clear();
+  dead_starts_.clear();
+  if (empty())
+    return;
+  string combined;
+  vector<pair<size_t, string>> tags;
+  size_t group = 1;
+  for (const auto& v : *this) {
+    if (boost::regex_search(v.second.str(), kBackReference)) {
+      LOG(INFO) << "pattern " << v.first << " is matched on its own.";
+      return;
+    }
+    combined += (combined.empty() ? "(?:(" : "|(") + v.second.str() + ")";
+    tags.emplace_back(group, v.first);
+    group += v.second.mark_count() + 1;
+  }
+  // a match ends with the input.
+  combined += ")\\z";
+  try {
+    combined_ = boost::regex(combined);
+    tags_.swap(tags);
+  } catch (boost::regex_error& e) {
+    LOG(ERROR) << "error combining patterns: " << e.what();
+  }
 }
 
 RecognizerMatch RecognizerPatterns::GetMatch(
@@ -41,29 +74,64 @@ RecognizerMatch RecognizerPatterns::GetMatch(
     const Segmentation& segmentation) const {
   size_t j = segmentation.GetCurrentEndPosition();
   size_t k = segmentation.GetConfirmedPosition();
-  string active_input = input.substr(k);
+  const string active_input = input.substr(k);
   DLOG(INFO) << "matching active input '" << active_input << "' at pos " << k;
-  for (const auto& v : *this) {
+  // a match starts at the current segment or any segment before it.
+  set<size_t> starts{j};
+  for (const Segment& seg : segmentation) {
+    starts.insert(seg.start);
+  }
+  const size_t end = input.length();
+  if (k != last_confirmed_pos_) {
+    dead_starts_.clear();
+    last_confirmed_pos_ = k;
+  }
+  auto changed = std::mismatch(input.begin(), input.end(), last_input_.begin(),
+                               last_input_.end());
+  size_t unchanged_length = changed.first - input.begin();
+  for (auto it = dead_starts_.begin(); it != dead_starts_.end();) {
+    if (it->second > unchanged_length)
+      it = dead_starts_.erase(it);
+    else
+      ++it;
+  }
+  last_input_ = input;
+  for (size_t start : starts) {
+    if (start < k || start >= end)
+      continue;
+    auto begin = active_input.cbegin() + (start - k);
+    // the input before start is not seen as the beginning of a line.
+    auto flags = boost::match_continuous |
+                 (start > k ? boost::match_prev_avail : boost::match_default);
     boost::smatch m;
-    if (boost::regex_search(active_input, m, v.second)) {
-      size_t start = k + m.position();
-      size_t end = start + m.length();
-      if (end != input.length())
+    if (!combined_.empty()) {
+      if (dead_starts_.find(start) != dead_starts_.end())
+        continue;
+      if (!boost::regex_search(begin, active_input.cend(), m, combined_,
+                               flags | boost::match_partial)) {
+        dead_starts_[start] = end;
         continue;
-      if (start == j) {
+      }
+      // a partial match may be completed with more input.
+      if (m[0].matched) {
+        for (const auto& x : tags_) {
+          if (m[x.first].matched) {
+            DLOG(INFO) << "input [" << start << ", " << end << ") '"
+                       << m.str() << "' matches pattern: " << x.second;
+            return {x.second, start, end};
+          }
+        }
+      }
+      continue;
+    }
+    for (const auto& v : *this) {
+      if (boost::regex_search(begin, active_input.cend(), m, v.second,
+                              flags) &&
+          m[0].second == active_input.cend()) {
         DLOG(INFO) << "input [" << start << ", " << end << ") '" << m.str()
                    << "' matches pattern: " << v.first;
         return {v.first, start, end};
       }
-      for (const Segment& seg : segmentation) {
-        if (start < seg.start)
-          break;
-        if (start == seg.start) {
-          DLOG(INFO) << "input [" << start << ", " << end << ") '" << m.str()
-                     << "' matches pattern: " << v.first;
-          return {v.first, start, end};
-        }
-      }
     }
   }
   return RecognizerMatch();
@@ -27,11 +27,31 @@ struct RecognizerMatch {
   bool found() const { return start < end; }
 };
 
+// The input is matched against all patterns at once, at the start of each
+// segment in turn. The first segment where any pattern matches the rest of
+// the input wins, and ties are resolved by tag order.
 class RecognizerPatterns : public map<string, boost::regex> {
  public:
   void LoadConfig(Config* config, const string& name_space);
+  // combines the patterns into one regex; to be called again after the
+  // patterns are changed.
+  void Compile();
   RecognizerMatch GetMatch(const string& input,
                            const Segmentation& segmentation) const;
+
+ private:
+  // alternatives of all patterns, each in a marked sub-expression.
+  // empty if the patterns cannot be combined, eg. with back references.
+  boost::regex combined_;
+  // the sub-expression of each pattern in combined_.
+  vector<pair<size_t, string>> tags_;
+  // as the input grows a character at a time, starts where nothing matches
+  // the input or any longer input are skipped. each is kept with the length
+  // of the input found not to match, and dropped when that part of the
+  // input is changed, eg. by a backspace.
+  mutable string last_input_;
+  mutable size_t last_confirmed_pos_ = 0;
+  mutable map<size_t, size_t> dead_starts_;
 };
 
 class Recognizer : public Processor {
@@ -14,23 +14,35 @@
 
 namespace rime {
 
-class ReverseLookupFilterTranslation : public CacheTranslation {
+// candidates are looked up a page at a time.
+class ReverseLookupFilterTranslation : public PrefetchTranslation {
  public:
   ReverseLookupFilterTranslation(an<Translation> translation,
-                                 ReverseLookupFilter* filter)
-      : CacheTranslation(translation), filter_(filter) {}
-  virtual an<Candidate> Peek();
+                                 ReverseLookupFilter* filter,
+                                 size_t batch_size)
+      : PrefetchTranslation(translation),
+        filter_(filter),
+        batch_size_(batch_size) {}
 
  protected:
+  virtual bool Replenish();
+
   ReverseLookupFilter* filter_;
+  size_t batch_size_;
 };
 
-an<Candidate> ReverseLookupFilterTranslation::Peek() {
-  auto cand = CacheTranslation::Peek();
-  if (cand) {
-    filter_->Process(cand);
+bool ReverseLookupFilterTranslation::Replenish() {
+  vector<an<Candidate>> batch;
+  while (batch.size() < batch_size_ && !translation_->exhausted()) {
+    if (auto cand = translation_->Peek())
+      batch.push_back(cand);
+    translation_->Next();
+  }
+  filter_->Process(batch);
+  for (auto& cand : batch) {
+    cache_.push_back(cand);
   }
-  return cand;
+  return !cache_.empty();
 }
 
 ReverseLookupFilter::ReverseLookupFilter(const Ticket& ticket)
@@ -54,8 +66,11 @@ void ReverseLookupFilter::Initialize() {
   if (Config* config = engine_->schema()->config()) {
     config->GetBool(name_space_ + "/overwrite_comment", &overwrite_comment_);
     config->GetBool(name_space_ + "/append_comment", &append_comment_);
-    comment_formatter_.Load(config->GetList(name_space_ + "/comment_format"));
+    config->GetBool(name_space_ + "/phrase_from_chars", &phrase_from_chars_);
+    comment_formatter_ =
+        Projection::Shared(config->GetList(name_space_ + "/comment_format"));
   }
+  batch_size_ = engine_->schema()->page_size();
 }
 
 an<Translation> ReverseLookupFilter::Apply(an<Translation> translation,
@@ -66,23 +81,42 @@ an<Translation> ReverseLookupFilter::Apply(an<Translation> translation,
   if (!rev_dict_) {
     return translation;
   }
-  return New<ReverseLookupFilterTranslation>(translation, this);
+  return New<ReverseLookupFilterTranslation>(translation, this, batch_size_);
 }
 
-void ReverseLookupFilter::Process(const an<Candidate>& cand) {
-  if (!cand->comment().empty() && !(overwrite_comment_ || append_comment_))
+void ReverseLookupFilter::Process(const vector<an<Candidate>>& cands) {
+  vector<an<Candidate>> targets;
+  vector<an<Phrase>> phrases;
+  vector<string> texts;
+  for (const auto& cand : cands) {
+    if (!cand->comment().empty() && !(overwrite_comment_ || append_comment_))
+      continue;
+    auto phrase = As<Phrase>(Candidate::GetGenuineCandidate(cand));
+    if (!phrase)
+      continue;
+    targets.push_back(cand);
+    phrases.push_back(phrase);
+    texts.push_back(phrase->text());
+  }
+  if (texts.empty())
     return;
-  auto phrase = As<Phrase>(Candidate::GetGenuineCandidate(cand));
-  if (!phrase)
+  vector<string> results;
+  if (!rev_dict_->ReverseLookup(texts, &results) && !phrase_from_chars_)
     return;
-  string codes;
-  if (rev_dict_->ReverseLookup(phrase->text(), &codes)) {
-    comment_formatter_.Apply(&codes);
+  for (size_t i = 0; i < texts.size(); ++i) {
+    string& codes(results[i]);
+    if (codes.empty() && phrase_from_chars_) {
+      // phrases missing from the dictionary are spelt by characters.
+      rev_dict_->ReverseLookupChars(texts[i], &codes);
+    }
+    if (codes.empty())
+      continue;
+    comment_formatter_->Apply(&codes);
     if (!codes.empty()) {
-      if (overwrite_comment_ || cand->comment().empty()) {
-        phrase->set_comment(codes);
+      if (overwrite_comment_ || targets[i]->comment().empty()) {
+        phrases[i]->set_comment(codes);
       } else {
-        phrase->set_comment(cand->comment() + " " + codes);
+        phrases[i]->set_comment(targets[i]->comment() + " " + codes);
       }
     }
   }
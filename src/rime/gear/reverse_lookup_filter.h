@@ -24,18 +24,23 @@ class ReverseLookupFilter : public Filter, TagMatching {
                                 CandidateList* candidates);
 
   virtual bool AppliesToSegment(Segment* segment) { return TagsMatch(segment); }
+  // candidates are annotated only.
+  virtual bool KeepsCandidateCount() { return true; }
 
-  void Process(const an<Candidate>& cand);
+  // looks up the candidates in one go.
+  void Process(const vector<an<Candidate>>& cands);
 
  protected:
   void Initialize();
 
   bool initialized_ = false;
   the<ReverseLookupDictionary> rev_dict_;
+  size_t batch_size_ = 1;
   // settings
   bool overwrite_comment_ = false;
   bool append_comment_ = false;
-  Projection comment_formatter_;
+  bool phrase_from_chars_ = false;
+  an<Projection> comment_formatter_ = New<Projection>();
 };
 
 }  // namespace rime
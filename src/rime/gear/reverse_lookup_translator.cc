@@ -5,7 +5,9 @@
 // 2012-01-03 GONG Chen <chen.sst@gmail.com>
 //
 #include <boost/algorithm/string.hpp>
+#include <rime/arena.h>
 #include <rime/candidate.h>
+#include <rime/context.h>
 #include <rime/engine.h>
 #include <rime/schema.h>
 #include <rime/segmentation.h>
@@ -45,6 +47,9 @@ class ReverseLookupTranslation : public TableTranslation {
         options_(options),
         quality_(quality) {}
   virtual an<Candidate> Peek();
+  size_t Fill(CandidateList* out, size_t n) override {
+    return Translation::Fill(out, n);
+  }
   virtual int Compare(an<Translation> other, const CandidateList& candidates);
 
  protected:
@@ -68,8 +73,9 @@ an<Candidate> ReverseLookupTranslation::Peek() {
     // }
   }
   an<Candidate> cand =
-      New<SimpleCandidate>("reverse_lookup", start_, end_, entry->text,
-                           !tips.empty() ? tips : entry->comment, preedit_);
+      NewIn<SimpleCandidate>(arena_, "reverse_lookup", start_, end_,
+                             entry->text, !tips.empty() ? tips : entry->comment,
+                             preedit_);
   return cand;
 }
 
@@ -94,10 +100,11 @@ ReverseLookupTranslator::ReverseLookupTranslator(const Ticket& ticket)
   if (ticket.name_space == "translator") {
     name_space_ = "reverse_lookup";
   }
-  if (!ticket.schema)
-    return;
-  Config* config = ticket.schema->config();
-  config->GetString(name_space_ + "/tag", &tag_);
+  if (ticket.schema) {
+    Config* config = ticket.schema->config();
+    config->GetString(name_space_ + "/tag", &tag_);
+  }
+  tag_id_ = SegmentTags::Intern(tag_);
 }
 
 void ReverseLookupTranslator::Initialize() {
@@ -140,9 +147,15 @@ void ReverseLookupTranslator::Initialize() {
   }
 }
 
+int ReverseLookupTranslator::ProbeCandidates(const string& input,
+                                             const Segment& segment,
+                                             int limit) {
+  return segment.HasTag(tag_id_) ? -1 : 0;
+}
+
 an<Translation> ReverseLookupTranslator::Query(const string& input,
                                                const Segment& segment) {
-  if (!segment.HasTag(tag_))
+  if (!segment.HasTag(tag_id_))
     return nullptr;
   if (!initialized_)
     Initialize();  // load reverse dict at first use
@@ -192,9 +205,11 @@ an<Translation> ReverseLookupTranslator::Query(const string& input,
     }
   }
   if (!iter.exhausted()) {
-    return Cached<ReverseLookupTranslation>(rev_dict_.get(), options_.get(),
-                                            code, segment.start, segment.end,
-                                            preedit, std::move(iter), quality);
+    auto translation = New<ReverseLookupTranslation>(
+        rev_dict_.get(), options_.get(), code, segment.start, segment.end,
+        preedit, std::move(iter), quality);
+    translation->set_arena(engine_->context()->arena());
+    return New<CacheTranslation>(translation);
   }
   return nullptr;
 }
@@ -8,6 +8,7 @@
 #define RIME_REVERSE_LOOKUP_TRANSLATOR_H_
 
 #include <rime/common.h>
+#include <rime/segmentation.h>
 #include <rime/translator.h>
 #include <rime/algo/algebra.h>
 
@@ -22,11 +23,15 @@ class ReverseLookupTranslator : public Translator {
   ReverseLookupTranslator(const Ticket& ticket);
 
   virtual an<Translation> Query(const string& input, const Segment& segment);
+  virtual int ProbeCandidates(const string& input,
+                              const Segment& segment,
+                              int limit);
 
  protected:
   void Initialize();
 
   string tag_;
+  SegmentTags::TagId tag_id_ = 0;
   bool initialized_ = false;
   the<Dictionary> dict_;
   the<ReverseLookupDictionary> rev_dict_;
@@ -10,6 +10,7 @@
 #include <rime/common.h>
 #include <rime/config.h>
 #include <rime/schema.h>
+#include <rime/schema_index.h>
 #include <rime/switcher.h>
 #include <rime/translation.h>
 #include <rime/gear/schema_list_translator.h>
@@ -19,8 +20,10 @@ namespace rime {
 class SchemaSelection : public SimpleCandidate, public SwitcherCommand {
  public:
   SchemaSelection(Schema* schema)
-      : SimpleCandidate("schema", 0, 0, schema->schema_name()),
-        SwitcherCommand(schema->schema_id()) {}
+      : SchemaSelection(schema->schema_id(), schema->schema_name()) {}
+  SchemaSelection(const string& schema_id, const string& schema_name)
+      : SimpleCandidate("schema", 0, 0, schema_name),
+        SwitcherCommand(schema_id) {}
   virtual void Apply(Switcher* switcher);
 };
 
@@ -97,13 +100,20 @@ void SchemaListTranslation::LoadSchemaList(Switcher* switcher) {
   Config* user_config = switcher->user_config();
   size_t fixed = candies_.size();
   time_t now = time(NULL);
+  auto index = SchemaIndex::Get();
   // load the rest schema list
   Switcher::ForEachSchemaListEntry(config, [this, current_schema, user_config,
-                                            now](const string& schema_id) {
+                                            now,
+                                            &index](const string& schema_id) {
     if (current_schema && schema_id == current_schema->schema_id())
       return /* continue = */ true;
-    Schema schema(schema_id);
-    auto cand = New<SchemaSelection>(&schema);
+    an<SchemaSelection> cand;
+    if (auto info = index ? index->Find(schema_id) : nullptr) {
+      cand = New<SchemaSelection>(schema_id, info->name);
+    } else {
+      Schema schema(schema_id);
+      cand = New<SchemaSelection>(&schema);
+    }
     int timestamp = 0;
     if (user_config && user_config->GetInt(
                            "var/schema_access_time/" + schema_id, &timestamp)) {
@@ -7,10 +7,14 @@
 // 2011-07-10 GONG Chen <chen.sst@gmail.com>
 //
 #include <algorithm>
+#include <future>
 #include <stack>
+#include <tuple>
 #include <cmath>
 #include <boost/algorithm/string/join.hpp>
 #include <boost/range/adaptor/reversed.hpp>
+#include <rime/arena.h>
+#include <rime/cancellation.h>
 #include <rime/composition.h>
 #include <rime/candidate.h>
 #include <rime/config.h>
@@ -18,6 +22,7 @@
 #include <rime/engine.h>
 #include <rime/schema.h>
 #include <rime/translation.h>
+#include <rime/worker_pool.h>
 #include <rime/algo/syllabifier.h>
 #include <rime/dict/corrector.h>
 #include <rime/dict/dictionary.h>
@@ -73,6 +78,103 @@ static bool syllabify_dfs(SyllabifyTask* task,
 
 }  // anonymous namespace
 
+// syllable graphs and dictionary lookups of the current composition, shared
+// by the script translators working on the same input, e.g. those of a
+// secondary namespace over the same prism and dictionary.
+class SharedLookups {
+ public:
+  // results of another input are let go once there are this many graphs.
+  static const size_t kMaxGraphs = 16;
+
+  // prism, delimiters, completion, strict spelling, corrector, input.
+  using GraphKey =
+      std::tuple<const Prism*, string, bool, bool, const Corrector*, string>;
+  struct Graph {
+    an<SyllableGraph> graph;
+    size_t consumed = 0;
+  };
+
+  // the context of the engine keeps them for the composition.
+  static SharedLookups* Of(Context* ctx) {
+    auto& results = ctx->shared_results("script_lookups");
+    if (!results) {
+      results = New<SharedLookups>();
+    }
+    return static_cast<SharedLookups*>(results.get());
+  }
+
+  const Graph* FindGraph(const GraphKey& key) const {
+    auto found = graphs_.find(key);
+    return found != graphs_.end() ? &found->second : nullptr;
+  }
+  void AddGraph(const GraphKey& key, const Graph& graph) {
+    if (graphs_.size() >= kMaxGraphs) {
+      graphs_.clear();
+      lookups_.clear();
+    }
+    graphs_[key] = graph;
+  }
+
+  // lookups are only made on the graphs kept, whose addresses are unique.
+  struct LookupKey {
+    const Prism* prism;
+    const DictionaryOverlay* overlay;
+    vector<const Table*> tables;
+    const SyllableGraph* syllable_graph;
+    size_t start_pos;
+    bool predict_word;
+
+    LookupKey(Dictionary* dict,
+              const SyllableGraph& syllable_graph,
+              size_t start_pos,
+              bool predict_word)
+        : prism(dict->prism().get()),
+          overlay(dict->overlay().get()),
+          syllable_graph(&syllable_graph),
+          start_pos(start_pos),
+          predict_word(predict_word) {
+      for (const auto& table : dict->tables()) {
+        tables.push_back(table.get());
+      }
+    }
+    bool operator<(const LookupKey& other) const {
+      return std::tie(prism, overlay, tables, syllable_graph, start_pos,
+                      predict_word) <
+             std::tie(other.prism, other.overlay, other.tables,
+                      other.syllable_graph, other.start_pos,
+                      other.predict_word);
+    }
+  };
+
+  // gives a copy of the results of the same lookup, to be iterated
+  // independently; returns false if it is yet to be made.
+  bool FindLookup(const LookupKey& key, an<DictEntryCollector>* result) const {
+    auto found = lookups_.find(key);
+    if (found == lookups_.end())
+      return false;
+    *result = Copy(found->second);
+    return true;
+  }
+  // keeps the results of a lookup, and gives a copy of them. those of a
+  // lookup cut short by a newer key are not kept.
+  an<DictEntryCollector> AddLookup(const LookupKey& key,
+                                   an<DictEntryCollector> result) {
+    if (Cancellation::Requested())
+      return result;
+    auto& kept = lookups_[key];
+    kept = std::move(result);
+    return Copy(kept);
+  }
+
+ private:
+  static an<DictEntryCollector> Copy(const an<DictEntryCollector>& result) {
+    return result ? New<DictEntryCollector>(*result) : nullptr;
+  }
+
+  map<GraphKey, Graph> graphs_;
+  map<LookupKey, an<DictEntryCollector>> lookups_;
+};
+
 class ScriptSyllabifier : public PhraseSyllabifier {
  public:
   ScriptSyllabifier(ScriptTranslator* translator,
@@ -80,6 +182,7 @@ class ScriptSyllabifier : public PhraseSyllabifier {
                     const string& input,
                     size_t start)
       : translator_(translator),
+        corrector_(corrector),
         input_(input),
         start_(start),
         syllabifier_(translator->delimiters(),
@@ -91,19 +194,20 @@ class ScriptSyllabifier : public PhraseSyllabifier {
   }
 
   virtual Spans Syllabify(const Phrase* phrase);
-  size_t BuildSyllableGraph(Prism& prism);
+  // takes the graph built by another translator on the same input, if any.
+  size_t BuildSyllableGraph(Prism& prism, SharedLookups* shared);
   string GetPreeditString(const Phrase& cand) const;
   string GetOriginalSpelling(const Phrase& cand) const;
-  bool IsCandidateCorrection(const Phrase& cand) const;
 
-  const SyllableGraph& syllable_graph() const { return syllable_graph_; }
+  const SyllableGraph& syllable_graph() const { return *syllable_graph_; }
 
  protected:
   ScriptTranslator* translator_;
+  Corrector* corrector_;
   string input_;
   size_t start_;
   Syllabifier syllabifier_;
-  SyllableGraph syllable_graph_;
+  an<SyllableGraph> syllable_graph_ = New<SyllableGraph>();
 };
 
 class ScriptTranslation : public Translation {
@@ -113,11 +217,15 @@ class ScriptTranslation : public Translation {
                     Poet* poet,
                     const string& input,
                     size_t start,
-                    size_t end_of_input)
+                    size_t end_of_input,
+                    an<Arena> arena,
+                    SharedLookups* shared)
       : translator_(translator),
         poet_(poet),
         start_(start),
         end_of_input_(end_of_input),
+        arena_(std::move(arena)),
+        shared_(shared),
         syllabifier_(
             New<ScriptSyllabifier>(translator, corrector, input, start)),
         enable_correction_(corrector) {
@@ -126,6 +234,7 @@ class ScriptTranslation : public Translation {
   bool Evaluate(Dictionary* dict, UserDictionary* user_dict);
   virtual bool Next();
   virtual an<Candidate> Peek();
+  size_t Fill(CandidateList* out, size_t n) override;
 
  protected:
   bool CheckEmpty();
@@ -135,11 +244,17 @@ class ScriptTranslation : public Translation {
   void EnrollEntries(map<int, DictEntryList>& entries_by_end_pos,
                      const an<QueryResult>& query_result);
   an<Sentence> MakeSentence(Dictionary* dict, UserDictionary* user_dict);
+  an<DictEntryCollector> LookupDict(Dictionary* dict,
+                                    size_t start_pos,
+                                    bool predict_word);
 
   ScriptTranslator* translator_;
   Poet* poet_;
   size_t start_;
   size_t end_of_input_;
+  an<Arena> arena_;
+  // kept by the context for the composition being translated.
+  SharedLookups* shared_;
   an<ScriptSyllabifier> syllabifier_;
 
   an<DictEntryCollector> phrase_;
@@ -181,6 +296,8 @@ ScriptTranslator::ScriptTranslator(const Ticket& ticket)
       enable_word_completion_ = enable_completion_;
     }
     config->GetInt(name_space_ + "/max_homophones", &max_homophones_);
+    config->GetInt(name_space_ + "/parallel_sentence_min_length",
+                   &parallel_sentence_min_length_);
     poet_.reset(new Poet(language(), config));
   }
   if (enable_correction_) {
@@ -194,7 +311,7 @@ an<Translation> ScriptTranslator::Query(const string& input,
                                         const Segment& segment) {
   if (!dict_ || !dict_->loaded())
     return nullptr;
-  if (!segment.HasAnyTagIn(tags_))
+  if (!segment.HasAnyTagIn(matching_tags()))
     return nullptr;
   DLOG(INFO) << "input = '" << input << "', [" << segment.start << ", "
              << segment.end << ")";
@@ -204,41 +321,74 @@ an<Translation> ScriptTranslator::Query(const string& input,
   bool enable_user_dict =
       user_dict_ && user_dict_->loaded() && !IsUserDictDisabledFor(input);
 
-  size_t end_of_input = engine_->context()->input().length();
+  Context* ctx = engine_->context();
+  size_t end_of_input = ctx->input().length();
+  // spelling correction is left out once over budget.
+  Corrector* corrector =
+      corrector_ && OverLatencyBudget() ? nullptr : corrector_.get();
   // the translator should survive translations it creates
-  auto result = New<ScriptTranslation>(this, corrector_.get(), poet_.get(),
-                                       input, segment.start, end_of_input);
+  auto result = New<ScriptTranslation>(
+      this, corrector, poet_.get(), input, segment.start, end_of_input,
+      ctx->arena(), SharedLookups::Of(ctx));
   if (!result || !result->Evaluate(
                      dict_.get(), enable_user_dict ? user_dict_.get() : NULL)) {
     return nullptr;
   }
   auto deduped = New<DistinctTranslation>(result);
-  if (contextual_suggestions_) {
+  if (contextual_suggestions_ && !OverLatencyBudget()) {
     return poet_->ContextualWeighted(deduped, input, segment.start, this);
   }
   return deduped;
 }
 
 string ScriptTranslator::FormatPreedit(const string& preedit) {
-  string result = preedit;
-  preedit_formatter_.Apply(&result);
+  string result;
+  if (preedit_memo_.Lookup(preedit, &result))
+    return result;
+  result = preedit;
+  preedit_formatter_->Apply(&result);
+  preedit_memo_.Memorize(preedit, result);
   return result;
 }
 
 string ScriptTranslator::Spell(const Code& code) {
   string result;
+  if (spelling_memo_.Lookup(code, &result))
+    return result;
   vector<string> syllables;
   if (!dict_ || !dict_->Decode(code, &syllables) || syllables.empty())
     return result;
   result = boost::algorithm::join(syllables, string(1, delimiters_.at(0)));
-  comment_formatter_.Apply(&result);
+  comment_formatter_->Apply(&result);
+  spelling_memo_.Memorize(code, result);
   return result;
 }
 
 string ScriptTranslator::GetPrecedingText(size_t start) const {
   return !contextual_suggestions_ ? string()
          : start > 0 ? engine_->context()->composition().GetTextBefore(start)
-                     : engine_->context()->commit_history().latest_text();
+                     : engine_->context()->commit_history().preceding_text();
+}
+
+bool ScriptTranslator::OverLatencyBudget() const {
+  return engine_->context()->OverLatencyBudget();
+}
+
+void ScriptTranslator::Hibernate() {
+  syllabifier_cache_.Clear();
+  spelling_memo_.Clear();
+  preedit_memo_.Clear();
+  if (poet_)
+    poet_->ReleaseLattice();
+}
+
+void ScriptTranslator::FlushUserData() {
+  if (user_dict_)
+    user_dict_->Flush();
+}
+
+void ScriptTranslator::WarmUp() {
+  WarmUpDictionaries();
 }
 
 bool ScriptTranslator::Memorize(const CommitEntry& commit_entry) {
@@ -269,7 +419,7 @@ Spans ScriptSyllabifier::Syllabify(const Phrase* phrase) {
   vector<size_t> vertices;
   vertices.push_back(start_);
   SyllabifyTask task{
-      phrase->code(), syllable_graph_, phrase->end() - start_,
+      phrase->code(), *syllable_graph_, phrase->end() - start_,
       [&](SyllabifyTask* task, size_t depth, size_t current_pos,
           size_t next_pos) { vertices.push_back(start_ + next_pos); },
       [&](SyllabifyTask* task, size_t depth) { vertices.pop_back(); }};
@@ -279,51 +429,36 @@ Spans ScriptSyllabifier::Syllabify(const Phrase* phrase) {
   return result;
 }
 
-size_t ScriptSyllabifier::BuildSyllableGraph(Prism& prism) {
-  return (size_t)syllabifier_.BuildSyllableGraph(input_, prism,
-                                                 &syllable_graph_);
-}
-
-bool ScriptSyllabifier::IsCandidateCorrection(const rime::Phrase& cand) const {
-  std::stack<bool> results;
-  // Perform DFS on syllable graph to find whether this candidate is a
-  // correction
-  SyllabifyTask task{cand.code(), syllable_graph_, cand.end() - start_,
-                     [&](SyllabifyTask* task, size_t depth, size_t current_pos,
-                         size_t next_pos) {
-                       auto id = cand.code()[depth];
-                       auto it_s = syllable_graph_.edges.find(current_pos);
-                       // C++ prohibit operator [] of const map
-                       // if
-                       // (syllable_graph_.edges[current_pos][next_pos][id].type
-                       // == kCorrection)
-                       if (it_s != syllable_graph_.edges.end()) {
-                         auto it_e = it_s->second.find(next_pos);
-                         if (it_e != it_s->second.end()) {
-                           auto it_type = it_e->second.find(id);
-                           if (it_type != it_e->second.end()) {
-                             results.push(it_type->second.is_correction);
-                             return;
-                           }
-                         }
-                       }
-                       results.push(false);
-                     },
-                     [&](SyllabifyTask* task, size_t depth) { results.pop(); }};
-  if (syllabify_dfs(&task, 0, cand.start() - start_)) {
-    for (; !results.empty(); results.pop()) {
-      if (results.top())
-        return results.top();
+size_t ScriptSyllabifier::BuildSyllableGraph(Prism& prism,
+                                             SharedLookups* shared) {
+  SharedLookups::GraphKey key{&prism,
+                              translator_->delimiters(),
+                              translator_->enable_completion(),
+                              translator_->strict_spelling(),
+                              corrector_,
+                              input_};
+  if (shared) {
+    if (const auto* found = shared->FindGraph(key)) {
+      syllable_graph_ = found->graph;
+      return found->consumed;
     }
   }
-  return false;
+  auto graph = New<SyllableGraph>();
+  size_t consumed = (size_t)syllabifier_.BuildSyllableGraph(
+      input_, prism, graph.get(), translator_->syllabifier_cache());
+  syllable_graph_ = graph;
+  if (shared) {
+    shared->AddGraph(key, {graph, consumed});
+  }
+  return consumed;
 }
 
 string ScriptSyllabifier::GetPreeditString(const Phrase& cand) const {
   const auto& delimiters = translator_->delimiters();
   std::stack<size_t> lengths;
   string output;
-  SyllabifyTask task{cand.matching_code(), syllable_graph_, cand.end() - start_,
+  SyllabifyTask task{cand.matching_code(), *syllable_graph_,
+                     cand.end() - start_,
                      [&](SyllabifyTask* task, size_t depth, size_t current_pos,
                          size_t next_pos) {
                        size_t len = output.length();
@@ -363,18 +498,18 @@ static bool has_exact_match_phrase(Ptr ptr, Iter iter, size_t consumed) {
 // ScriptTranslation implementation
 
 bool ScriptTranslation::Evaluate(Dictionary* dict, UserDictionary* user_dict) {
-  size_t consumed = syllabifier_->BuildSyllableGraph(*dict->prism());
+  size_t consumed = syllabifier_->BuildSyllableGraph(*dict->prism(), shared_);
   const auto& syllable_graph = syllabifier_->syllable_graph();
   bool predict_word = translator_->enable_word_completion() &&
                       start_ + consumed == end_of_input_;
 
-  phrase_ = dict->Lookup(syllable_graph, 0, predict_word);
+  phrase_ = LookupDict(dict, 0, predict_word);
   if (user_dict) {
     const size_t kUnlimitedDepth = 0;
     const size_t kNumSyllablesToPredictWord = 4;
-    user_phrase_ =
-        user_dict->Lookup(syllable_graph, 0, kUnlimitedDepth,
-                          predict_word ? kNumSyllablesToPredictWord : 0);
+    user_phrase_ = user_dict->Lookup(
+        syllable_graph, 0, kUnlimitedDepth,
+        predict_word ? kNumSyllablesToPredictWord : 0, 0.0, arena_);
   }
   if (!phrase_ && !user_phrase_)
     return false;
@@ -384,11 +519,13 @@ bool ScriptTranslation::Evaluate(Dictionary* dict, UserDictionary* user_dict) {
   if (user_phrase_)
     user_phrase_iter_ = user_phrase_->rbegin();
 
-  // make sentences when there is no exact-matching phrase candidate
+  // make sentences when there is no exact-matching phrase candidate;
+  // the phrases will do once over budget.
   bool has_at_least_two_syllables = syllable_graph.edges.size() >= 2;
   if (has_at_least_two_syllables &&
       !has_exact_match_phrase(phrase_, phrase_iter_, consumed) &&
-      !has_exact_match_phrase(user_phrase_, user_phrase_iter_, consumed)) {
+      !has_exact_match_phrase(user_phrase_, user_phrase_iter_, consumed) &&
+      !translator_->OverLatencyBudget()) {
     sentence_ = MakeSentence(dict, user_dict);
   }
 
@@ -431,7 +568,7 @@ bool ScriptTranslation::Next() {
       }
     }
   } while (enable_correction_ &&
-           syllabifier_->IsCandidateCorrection(*candidate_) &&
+           candidate_->entry().is_correction &&
            // limit the number of correction candidates
            ++correction_count_ > max_corrections_);
   if (!CheckEmpty()) {
@@ -447,6 +584,10 @@ bool ScriptTranslation::IsNormalSpelling() const {
          (syllable_graph.vertices.rbegin()->second == kNormalSpelling);
 }
 
+size_t ScriptTranslation::Fill(CandidateList* out, size_t n) {
+  return FillWith(this, out, n);
+}
+
 an<Candidate> ScriptTranslation::Peek() {
   if (candidate_source_ == kUninitialized && !PrepareCandidate()) {
     return nullptr;
@@ -513,10 +654,10 @@ bool ScriptTranslation::PrepareCandidate() {
     DLOG(INFO) << "user phrase '" << entry->text
                << "', code length: " << user_phrase_code_length;
     candidate_source_ = kUserPhrase;
-    candidate_ =
-        New<Phrase>(translator_->language(),
-                    entry->IsPredictiveMatch() ? "completion" : "user_phrase",
-                    start_, start_ + user_phrase_code_length, entry);
+    candidate_ = NewIn<Phrase>(
+        arena_, translator_->language(),
+        entry->IsPredictiveMatch() ? "completion" : "user_phrase", start_,
+        start_ + user_phrase_code_length, entry);
     candidate_->set_quality(std::exp(entry->weight) +
                             translator_->initial_quality() +
                             (IsNormalSpelling() ? 0.5 : -0.5));
@@ -527,10 +668,10 @@ bool ScriptTranslation::PrepareCandidate() {
     DLOG(INFO) << "phrase '" << entry->text
                << "', code length: " << phrase_code_length;
     candidate_source_ = kSysPhrase;
-    candidate_ =
-        New<Phrase>(translator_->language(),
-                    entry->IsPredictiveMatch() ? "completion" : "phrase",
-                    start_, start_ + phrase_code_length, entry);
+    candidate_ = NewIn<Phrase>(
+        arena_, translator_->language(),
+        entry->IsPredictiveMatch() ? "completion" : "phrase", start_,
+        start_ + phrase_code_length, entry);
     candidate_->set_quality(std::exp(entry->weight) +
                             translator_->initial_quality() +
                             (IsNormalSpelling() ? 0 : -1));
@@ -555,30 +696,91 @@ void ScriptTranslation::EnrollEntries(
   if (query_result) {
     for (auto& y : *query_result) {
       DictEntryList& homophones = entries_by_end_pos[y.first];
-      while (homophones.size() < translator_->max_homophones() &&
-             !y.second.exhausted()) {
+      size_t max_homophones = translator_->max_homophones();
+      if (homophones.size() >= max_homophones || y.second.exhausted())
+        continue;
+      // take the top entries of the sorted iterator. it is not advanced past
+      // the last one taken, which would make it look for the next entry that
+      // passes the filters.
+      homophones.push_back(y.second.Peek());
+      while (homophones.size() < max_homophones && y.second.Next()) {
         homophones.push_back(y.second.Peek());
-        if (!y.second.Next())
-          break;
       }
     }
   }
 }
 
+an<DictEntryCollector> ScriptTranslation::LookupDict(Dictionary* dict,
+                                                     size_t start_pos,
+                                                     bool predict_word) {
+  const auto& syllable_graph = syllabifier_->syllable_graph();
+  if (!shared_) {
+    return dict->Lookup(syllable_graph, start_pos, predict_word, 0.0, arena_);
+  }
+  SharedLookups::LookupKey key(dict, syllable_graph, start_pos, predict_word);
+  an<DictEntryCollector> result;
+  if (shared_->FindLookup(key, &result))
+    return result;
+  return shared_->AddLookup(key, dict->Lookup(syllable_graph, start_pos,
+                                              predict_word, 0.0, arena_));
+}
+
 an<Sentence> ScriptTranslation::MakeSentence(Dictionary* dict,
                                              UserDictionary* user_dict) {
   const int kMaxSyllablesForUserPhraseQuery = 5;
   const auto& syllable_graph = syllabifier_->syllable_graph();
+  int parallel_min_length = translator_->parallel_sentence_min_length();
+  bool parallel = parallel_min_length > 0 &&
+                  syllable_graph.interpreted_length >=
+                      static_cast<size_t>(parallel_min_length);
+  // the dictionary is looked up at each position independently, so it can
+  // be done on worker threads, while this thread looks up the user dict.
+  // lookups shared by other translators are not made again.
+  vector<an<DictEntryCollector>> dict_results;
+  vector<std::future<void>> pending;
+  if (parallel) {
+    dict_results.resize(syllable_graph.edges.size());
+    pending.resize(syllable_graph.edges.size());
+    size_t i = 0;
+    for (const auto& x : syllable_graph.edges) {
+      size_t start_pos = x.first;
+      auto* dict_result = &dict_results[i];
+      if (!shared_ ||
+          !shared_->FindLookup({dict, syllable_graph, start_pos, false},
+                               dict_result)) {
+        pending[i] = WorkerPool::Shared().Submit(
+            [dict, dict_result, start_pos, &syllable_graph, arena = arena_] {
+              *dict_result =
+                  dict->Lookup(syllable_graph, start_pos, false, 0.0, arena);
+            });
+      }
+      ++i;
+    }
+  }
   WordGraph graph;
+  size_t i = 0;
   for (const auto& x : syllable_graph.edges) {
     auto& same_start_pos = graph[x.first];
     if (user_dict) {
       EnrollEntries(same_start_pos,
                     user_dict->Lookup(syllable_graph, x.first,
-                                      kMaxSyllablesForUserPhraseQuery));
+                                      kMaxSyllablesForUserPhraseQuery, 0,
+                                      0.0, arena_));
+    }
+    // merge lookup results in the order of positions
+    if (parallel) {
+      if (pending[i].valid()) {
+        pending[i].get();
+        if (shared_) {
+          dict_results[i] = shared_->AddLookup(
+              {dict, syllable_graph, x.first, false}, dict_results[i]);
+        }
+      }
+      EnrollEntries(same_start_pos, dict_results[i]);
+    } else {
+      EnrollEntries(same_start_pos, LookupDict(dict, x.first, false));
     }
-    // merge lookup results
-    EnrollEntries(same_start_pos, dict->Lookup(syllable_graph, x.first));
+    ++i;
   }
   if (auto sentence =
           poet_->MakeSentence(graph, syllable_graph.interpreted_length,
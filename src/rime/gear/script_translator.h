@@ -7,22 +7,65 @@
 #ifndef RIME_SCRIPT_TRANSLATOR_H_
 #define RIME_SCRIPT_TRANSLATOR_H_
 
+#include <mutex>
 #include <rime/common.h>
 #include <rime/translation.h>
 #include <rime/translator.h>
 #include <rime/algo/algebra.h>
+#include <rime/algo/syllabifier.h>
+#include <rime/dict/vocabulary.h>
 #include <rime/gear/memory.h>
 #include <rime/gear/translator_commons.h>
 
 namespace rime {
 
-class Code;
 class Corrector;
 struct DictEntry;
 class Dictionary;
 class Poet;
 class UserDictionary;
-struct SyllableGraph;
+
+// formatted strings of the recent candidates by what they were formatted
+// from, most recently used first.
+template <class Key>
+class FormatMemo {
+ public:
+  static const size_t kMaxItems = 256;
+
+  bool Lookup(const Key& key, string* value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = index_.find(key);
+    if (found == index_.end())
+      return false;
+    items_.splice(items_.begin(), items_, found->second);
+    *value = found->second->second;
+    return true;
+  }
+  void Memorize(const Key& key, const string& value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (index_.find(key) != index_.end())
+      return;
+    items_.emplace_front(key, value);
+    index_[key] = items_.begin();
+    if (items_.size() > kMaxItems) {
+      index_.erase(items_.back().first);
+      items_.pop_back();
+    }
+  }
+  void Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    index_.clear();
+    items_.clear();
+  }
+
+ private:
+  using Items = list<pair<Key, string>>;
+
+  // candidates are formatted on prefetching worker threads as well.
+  std::mutex mutex_;
+  Items items_;
+  map<Key, typename Items::iterator> index_;
+};
 
 class ScriptTranslator : public Translator,
                          public Memory,
@@ -32,25 +75,45 @@ class ScriptTranslator : public Translator,
 
   virtual an<Translation> Query(const string& input, const Segment& segment);
   virtual bool Memorize(const CommitEntry& commit_entry);
+  virtual void Hibernate();
+  virtual void FlushUserData();
+  virtual void WarmUp();
 
   string FormatPreedit(const string& preedit);
   string Spell(const Code& code);
   string GetPrecedingText(size_t start) const;
+  // an expensive stage is to be skipped to keep within the latency budget.
+  bool OverLatencyBudget() const;
 
   // options
   int max_homophones() const { return max_homophones_; }
   int spelling_hints() const { return spelling_hints_; }
   bool always_show_comments() const { return always_show_comments_; }
   bool enable_word_completion() const { return enable_word_completion_; }
+  int parallel_sentence_min_length() const {
+    return parallel_sentence_min_length_;
+  }
+
+  SyllabifierCache* syllabifier_cache() { return &syllabifier_cache_; }
 
  protected:
+  // codes may stand for other syllables in the new dictionary.
+  void OnDictionaryRefreshed() override { spelling_memo_.Clear(); }
+
   int max_homophones_ = 1;
   int spelling_hints_ = 0;
   bool always_show_comments_ = false;
   bool enable_correction_ = false;
   bool enable_word_completion_ = false;
+  // builds the word graph of sentences as long as this on worker threads;
+  // 0 disables it.
+  int parallel_sentence_min_length_ = 0;
   the<Corrector> corrector_;
   the<Poet> poet_;
+  SyllabifierCache syllabifier_cache_;
+  // spelling hints by code, and preedits by the input they are made of.
+  FormatMemo<Code> spelling_memo_;
+  FormatMemo<string> preedit_memo_;
 };
 
 }  // namespace rime
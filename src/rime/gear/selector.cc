@@ -16,6 +16,9 @@
 
 namespace rime {
 
+static const SegmentTags::TagId kRawTag = SegmentTags::Intern("raw");
+static const SegmentTags::TagId kPagingTag = SegmentTags::Intern("paging");
+
 static Selector::ActionDef selector_actions[] = {
     {"previous_candidate", &Selector::PreviousCandidate},
     {"next_candidate", &Selector::NextCandidate},
@@ -28,6 +31,7 @@ static Selector::ActionDef selector_actions[] = {
 
 Selector::Selector(const Ticket& ticket)
     : Processor(ticket), KeyBindingProcessor(selector_actions) {
+  interests_ = kComposing | kComposingInAsciiMode;
   // default key bindings
   {
     auto& keymap = get_keymap(Horizontal | Stacked);
@@ -122,7 +126,7 @@ ProcessResult Selector::ProcessKeyEvent(const KeyEvent& key_event) {
   if (ctx->composition().empty())
     return kNoop;
   Segment& current_segment(ctx->composition().back());
-  if (!current_segment.menu || current_segment.HasTag("raw"))
+  if (!current_segment.menu || current_segment.HasTag(kRawTag))
     return kNoop;
 
   TextOrientation text_orientation =
@@ -164,7 +168,7 @@ bool Selector::PreviousPage(Context* ctx) {
   int selected_index = comp.back().selected_index;
   int index = selected_index < page_size ? 0 : selected_index - page_size;
   comp.back().selected_index = index;
-  comp.back().tags.insert("paging");
+  comp.back().tags.Add(kPagingTag);
   return true;
 }
 
@@ -188,7 +192,7 @@ bool Selector::NextPage(Context* ctx) {
     index = candidate_count - 1;
   }
   comp.back().selected_index = index;
-  comp.back().tags.insert("paging");
+  comp.back().tags.Add(kPagingTag);
   return true;
 }
 
@@ -210,7 +214,7 @@ bool Selector::PreviousCandidate(Context* ctx) {
     return !is_linear_layout(ctx);
   }
   comp.back().selected_index = index - 1;
-  comp.back().tags.insert("paging");
+  comp.back().tags.Add(kPagingTag);
   return true;
 }
 
@@ -227,7 +231,7 @@ bool Selector::NextCandidate(Context* ctx) {
   if (candidate_count <= index)
     return true;
   comp.back().selected_index = index;
-  comp.back().tags.insert("paging");
+  comp.back().tags.Add(kPagingTag);
   return true;
 }
 
@@ -0,0 +1,81 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <sstream>
+#include <rime/config.h>
+#include <rime/gear/shared_grammar.h>
+
+namespace rime {
+
+SharedGrammar::SharedGrammar(Grammar* model) : model_(model) {}
+
+double SharedGrammar::Query(const string& context,
+                            const string& word,
+                            bool is_rear) {
+  if (model_->is_thread_safe())
+    return model_->Query(context, word, is_rear);
+  std::lock_guard<std::mutex> lock(mutex_);
+  return model_->Query(context, word, is_rear);
+}
+
+void SharedGrammar::QueryBatch(const string& context,
+                               const vector<const string*>& words,
+                               bool is_rear,
+                               vector<double>* scores) {
+  if (model_->is_thread_safe())
+    return model_->QueryBatch(context, words, is_rear, scores);
+  std::lock_guard<std::mutex> lock(mutex_);
+  model_->QueryBatch(context, words, is_rear, scores);
+}
+
+void SharedGrammar::QueryBatch(const vector<const string*>& contexts,
+                               const vector<const string*>& words,
+                               bool is_rear,
+                               vector<double>* scores) {
+  if (model_->is_thread_safe())
+    return model_->QueryBatch(contexts, words, is_rear, scores);
+  std::lock_guard<std::mutex> lock(mutex_);
+  model_->QueryBatch(contexts, words, is_rear, scores);
+}
+
+string SharedGrammar::Signature(Config* config) {
+  string signature;
+  if (!config)
+    return signature;
+  if (auto settings = config->GetMap("grammar")) {
+    for (const auto& setting : *settings) {
+      if (auto value = As<ConfigValue>(setting.second)) {
+        signature += "\n" + setting.first + "=" + value->str();
+      }
+    }
+  }
+  return signature;
+}
+
+static std::mutex shared_grammars_mutex;
+static map<string, weak<Grammar>> shared_grammars;
+
+an<Grammar> SharedGrammar::Require(const string& component_name,
+                                   Config* config) {
+  auto* component = Grammar::Require(component_name);
+  if (!component)
+    return nullptr;
+  // a component registered anew under the same name creates other models.
+  std::ostringstream key;
+  key << component_name << "@" << component << Signature(config);
+  std::lock_guard<std::mutex> lock(shared_grammars_mutex);
+  auto& shared = shared_grammars[key.str()];
+  if (auto grammar = shared.lock())
+    return grammar;
+  // models are created under the lock, so that each is loaded only once.
+  Grammar* model = component->Create(config);
+  if (!model)
+    return nullptr;
+  LOG(INFO) << "created shared grammar model: " << component_name;
+  an<Grammar> grammar = New<SharedGrammar>(model);
+  shared = grammar;
+  return grammar;
+}
+
+}  // namespace rime
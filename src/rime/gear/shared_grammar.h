@@ -0,0 +1,49 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#ifndef RIME_SHARED_GRAMMAR_H_
+#define RIME_SHARED_GRAMMAR_H_
+
+#include <mutex>
+#include <rime/gear/grammar.h>
+
+namespace rime {
+
+// A grammar model shared by the translators of all sessions that configure
+// the same model, so that it is loaded once.
+//
+// Queries to models that are not thread-safe are serialized.
+class SharedGrammar : public Grammar {
+ public:
+  explicit SharedGrammar(Grammar* model);
+
+  double Query(const string& context,
+               const string& word,
+               bool is_rear) override;
+  void QueryBatch(const string& context,
+                  const vector<const string*>& words,
+                  bool is_rear,
+                  vector<double>* scores) override;
+  void QueryBatch(const vector<const string*>& contexts,
+                  const vector<const string*>& words,
+                  bool is_rear,
+                  vector<double>* scores) override;
+  bool is_thread_safe() const override { return true; }
+
+  Grammar* model() const { return model_.get(); }
+
+  // returns the model created by the named grammar component with the
+  // settings under 'grammar', which is shared as long as it is in use.
+  static an<Grammar> Require(const string& component_name, Config* config);
+  // the settings under 'grammar', on which the model depends.
+  static string Signature(Config* config);
+
+ private:
+  the<Grammar> model_;
+  std::mutex mutex_;
+};
+
+}  // namespace rime
+
+#endif  // RIME_SHARED_GRAMMAR_H_
@@ -6,8 +6,9 @@
 //
 #include <boost/algorithm/string.hpp>
 #include <stdint.h>
-#include <utf8.h>
+#include <mutex>
 #include <utility>
+#include <rime/arena.h>
 #include <rime/candidate.h>
 #include <rime/common.h>
 #include <rime/config.h>
@@ -16,6 +17,7 @@
 #include <rime/schema.h>
 #include <rime/service.h>
 #include <rime/translation.h>
+#include <rime/algo/strings.h>
 #include <rime/gear/simplifier.h>
 #include <opencc/Config.hpp>  // Place OpenCC #includes here to avoid VS2015 compilation errors
 #include <opencc/Converter.hpp>
@@ -31,12 +33,14 @@ namespace rime {
 
 class Opencc {
  public:
-  Opencc(const path& config_path) {
+  // dictionaries already loaded by the config for other converters, such as
+  // those common to s2t and s2hk, are shared with this one.
+  Opencc(const path& config_path, an<opencc::Config> config)
+      : config_(std::move(config)) {
     LOG(INFO) << "initializing opencc: " << config_path;
-    opencc::Config config;
     try {
       // opencc accepts file path encoded in UTF-8.
-      converter_ = config.NewFromFile(config_path.u8string());
+      converter_ = config_->NewFromFile(config_path.u8string());
 
       const list<opencc::ConversionPtr> conversions =
           converter_->GetConversionChain()->GetConversions();
@@ -149,11 +153,134 @@ class Opencc {
     return *simplified != text;
   }
 
+  // converts each text to the forms of the word found in the dictionaries,
+  // or else to the text converted by segments; no forms if it is unchanged.
+  // texts missing from the memo are converted in a single call to OpenCC.
+  void ConvertTexts(const vector<string>& texts,
+                    vector<vector<string>>* results) {
+    results->assign(texts.size(), vector<string>());
+    vector<size_t> unknown;
+    {
+      std::lock_guard<std::mutex> lock(memo_mutex_);
+      for (size_t i = 0; i < texts.size(); ++i) {
+        if (!LookupMemo(texts[i], &(*results)[i]))
+          unknown.push_back(i);
+      }
+    }
+    if (unknown.empty())
+      return;
+    vector<size_t> unmatched;
+    for (size_t i : unknown) {
+      if (!ConvertWord(texts[i], &(*results)[i]))
+        unmatched.push_back(i);
+    }
+    ConvertUnmatched(texts, unmatched, results);
+    std::lock_guard<std::mutex> lock(memo_mutex_);
+    for (size_t i : unknown) {
+      Memorize(texts[i], (*results)[i]);
+    }
+  }
+
  private:
+  static const size_t kMaxMemorizedTexts = 1024;
+  using Memo = list<pair<string, vector<string>>>;
+
+  // joins the texts by line breaks, which no dictionary entry spans.
+  void ConvertUnmatched(const vector<string>& texts,
+                        const vector<size_t>& unmatched,
+                        vector<vector<string>>* results) {
+    if (unmatched.empty() || converter_ == nullptr)
+      return;
+    string joined;
+    bool joinable = unmatched.size() > 1;
+    for (size_t i : unmatched) {
+      if (texts[i].find('\n') != string::npos) {
+        joinable = false;
+        break;
+      }
+      if (i != unmatched.front())
+        joined += '\n';
+      joined += texts[i];
+    }
+    vector<string> converted;
+    if (joinable) {
+      const string output = converter_->Convert(joined);
+      boost::split(converted, output, boost::is_any_of("\n"));
+    }
+    if (converted.size() != unmatched.size()) {
+      converted.clear();
+      for (size_t i : unmatched) {
+        converted.push_back(converter_->Convert(texts[i]));
+      }
+    }
+    for (size_t k = 0; k < unmatched.size(); ++k) {
+      size_t i = unmatched[k];
+      if (converted[k] != texts[i])
+        (*results)[i].push_back(std::move(converted[k]));
+    }
+  }
+
+  bool LookupMemo(const string& text, vector<string>* forms) {
+    auto found = memo_index_.find(text);
+    if (found == memo_index_.end())
+      return false;
+    memo_.splice(memo_.begin(), memo_, found->second);
+    *forms = found->second->second;
+    return true;
+  }
+
+  void Memorize(const string& text, const vector<string>& forms) {
+    if (memo_index_.find(text) != memo_index_.end())
+      return;
+    memo_.emplace_front(text, forms);
+    memo_index_[text] = memo_.begin();
+    if (memo_.size() > kMaxMemorizedTexts) {
+      memo_index_.erase(memo_.back().first);
+      memo_.pop_back();
+    }
+  }
+
+  // keeps the dictionaries it has loaded.
+  an<opencc::Config> config_;
   opencc::ConverterPtr converter_;
   opencc::DictPtr dict_;
+  // conversions are deterministic, so the memo is shared by all simplifiers
+  // using this instance; most recently used first.
+  std::mutex memo_mutex_;
+  Memo memo_;
+  hash_map<string, Memo::iterator> memo_index_;
 };
 
+// simplifiers in all sessions share the instance loaded from a config file,
+// and the instances share the dictionaries loaded by one opencc config.
+// they are released with the last simplifier using them.
+static an<Opencc> LoadOpencc(const path& config_path) {
+  static std::mutex mutex;
+  static map<string, weak<Opencc>> instances;
+  static weak<opencc::Config> shared_config;
+  std::error_code ec;
+  path canonical_path = std::filesystem::weakly_canonical(config_path, ec);
+  const string key = (ec ? config_path : canonical_path).u8string();
+  std::lock_guard<std::mutex> lock(mutex);
+  for (auto i = instances.begin(); i != instances.end();) {
+    if (i->second.expired())
+      i = instances.erase(i);
+    else
+      ++i;
+  }
+  weak<Opencc>& instance = instances[key];
+  if (auto opencc = instance.lock())
+    return opencc;
+  auto config = shared_config.lock();
+  if (!config) {
+    config = New<opencc::Config>();
+    shared_config = config;
+  }
+  auto opencc = New<Opencc>(config_path, config);
+  instance = opencc;
+  return opencc;
+}
+
 // Simplifier
 
 Simplifier::Simplifier(const Ticket& ticket)
@@ -171,7 +298,8 @@ Simplifier::Simplifier(const Ticket& ticket)
     }
     config->GetBool(name_space_ + "/show_in_comment", &show_in_comment_);
     config->GetBool(name_space_ + "/inherit_comment", &inherit_comment_);
-    comment_formatter_.Load(config->GetList(name_space_ + "/comment_format"));
+    comment_formatter_ =
+        Projection::Shared(config->GetList(name_space_ + "/comment_format"));
     config->GetBool(name_space_ + "/random", &random_);
     config->GetString(name_space_ + "/option_name", &option_name_);
     config->GetString(name_space_ + "/opencc_config", &opencc_config_);
@@ -213,7 +341,7 @@ void Simplifier::Initialize() {
     }
   }
   try {
-    opencc_.reset(new Opencc(opencc_config_path));
+    opencc_ = LoadOpencc(opencc_config_path);
   } catch (opencc::Exception& e) {
     LOG(ERROR) << "Error initializing opencc: " << e.what();
   }
@@ -231,14 +359,21 @@ class SimplifiedTranslation : public PrefetchTranslation {
 };
 
 bool SimplifiedTranslation::Replenish() {
-  auto next = translation_->Peek();
-  translation_->Next();
-  if (next && !simplifier_->Convert(next, &cache_)) {
-    cache_.push_back(next);
+  vector<an<Candidate>> batch;
+  while (batch.size() < Simplifier::kConversionBatchSize &&
+         !translation_->exhausted()) {
+    if (auto next = translation_->Peek())
+      batch.push_back(next);
+    translation_->Next();
   }
+  simplifier_->Convert(batch, &cache_);
   return !cache_.empty();
 }
 
+bool Simplifier::KeepsCandidateCount() {
+  return !engine_->context()->get_option(option_name_);
+}
+
 an<Translation> Simplifier::Apply(an<Translation> translation,
                                   CandidateList* candidates) {
   if (!engine_->context()->get_option(option_name_)) {  // off
@@ -258,29 +393,28 @@ void Simplifier::PushBack(const an<Candidate>& original,
                           const string& simplified) {
   string tips;
   string text;
-  size_t length = utf8::unchecked::distance(
-      original->text().c_str(),
-      original->text().c_str() + original->text().length());
+  size_t length = strings::utf8_length(original->text());
   bool show_tips =
       (tips_level_ == kTipsChar && length == 1) || tips_level_ == kTipsAll;
   if (show_in_comment_) {
     text = original->text();
     if (show_tips) {
       tips = simplified;
-      comment_formatter_.Apply(&tips);
+      comment_formatter_->Apply(&tips);
     }
   } else {
     text = simplified;
     if (show_tips) {
       tips = original->text();
-      bool modified = comment_formatter_.Apply(&tips);
+      bool modified = comment_formatter_->Apply(&tips);
       if (!modified) {
         tips = quote_left + original->text() + quote_right;
       }
     }
   }
-  result->push_back(New<ShadowCandidate>(original, "simplified", text, tips,
-                                         inherit_comment_));
+  result->push_back(NewIn<ShadowCandidate>(engine_->context()->arena(),
+                                           original, "simplified", text, tips,
+                                           inherit_comment_));
 }
 
 bool Simplifier::Convert(const an<Candidate>& original,
@@ -288,33 +422,66 @@ bool Simplifier::Convert(const an<Candidate>& original,
   if (excluded_types_.find(original->type()) != excluded_types_.end()) {
     return false;
   }
-  bool success = false;
   if (random_) {
     string simplified;
-    success = opencc_->RandomConvertText(original->text(), &simplified);
+    bool success = opencc_->RandomConvertText(original->text(), &simplified);
     if (success) {
       PushBack(original, result, simplified);
     }
-  } else {  //! random_
-    vector<string> forms;
-    success = opencc_->ConvertWord(original->text(), &forms);
-    if (success) {
-      for (size_t i = 0; i < forms.size(); ++i) {
-        if (forms[i] == original->text()) {
-          result->push_back(original);
-        } else {
-          PushBack(original, result, forms[i]);
-        }
+    return success;
+  }
+  vector<vector<string>> forms;
+  opencc_->ConvertTexts({original->text()}, &forms);
+  if (forms[0].empty()) {
+    return false;
+  }
+  PushForms(original, result, forms[0]);
+  return true;
+}
+
+void Simplifier::Convert(const vector<an<Candidate>>& originals,
+                         CandidateQueue* result) {
+  if (random_) {
+    for (const auto& original : originals) {
+      if (!Convert(original, result)) {
+        result->push_back(original);
       }
+    }
+    return;
+  }
+  vector<string> texts;
+  for (const auto& original : originals) {
+    if (excluded_types_.find(original->type()) == excluded_types_.end()) {
+      texts.push_back(original->text());
+    }
+  }
+  vector<vector<string>> forms;
+  opencc_->ConvertTexts(texts, &forms);
+  size_t i = 0;
+  for (const auto& original : originals) {
+    if (excluded_types_.find(original->type()) != excluded_types_.end()) {
+      result->push_back(original);
+      continue;
+    }
+    const auto& converted = forms[i++];
+    if (converted.empty()) {
+      result->push_back(original);
     } else {
-      string simplified;
-      success = opencc_->ConvertText(original->text(), &simplified);
-      if (success) {
-        PushBack(original, result, simplified);
-      }
+      PushForms(original, result, converted);
+    }
+  }
+}
+
+void Simplifier::PushForms(const an<Candidate>& original,
+                           CandidateQueue* result,
+                           const vector<string>& forms) {
+  for (const auto& form : forms) {
+    if (form == original->text()) {
+      result->push_back(original);
+    } else {
+      PushBack(original, result, form);
     }
   }
-  return success;
 }
 
 }  // namespace rime
@@ -23,8 +23,16 @@ class Simplifier : public Filter, TagMatching {
                                 CandidateList* candidates);
 
   virtual bool AppliesToSegment(Segment* segment) { return TagsMatch(segment); }
+  // candidates are passed on as they are while the option is off.
+  virtual bool KeepsCandidateCount();
 
   bool Convert(const an<Candidate>& original, CandidateQueue* result);
+  // converts a batch of candidates in one call to OpenCC, keeping their order;
+  // candidates left unchanged are passed through.
+  void Convert(const vector<an<Candidate>>& originals, CandidateQueue* result);
+
+  // candidates taken from the translation per conversion.
+  static const size_t kConversionBatchSize = 10;
 
  protected:
   enum TipsLevel { kTipsNone, kTipsChar, kTipsAll };
@@ -33,9 +41,12 @@ class Simplifier : public Filter, TagMatching {
   void PushBack(const an<Candidate>& original,
                 CandidateQueue* result,
                 const string& simplified);
+  void PushForms(const an<Candidate>& original,
+                 CandidateQueue* result,
+                 const vector<string>& forms);
 
   bool initialized_ = false;
-  the<Opencc> opencc_;
+  an<Opencc> opencc_;
   // settings
   TipsLevel tips_level_ = kTipsNone;
   string option_name_;
@@ -43,7 +54,7 @@ class Simplifier : public Filter, TagMatching {
   set<string> excluded_types_;
   bool show_in_comment_ = false;
   bool inherit_comment_ = true;
-  Projection comment_formatter_;
+  an<Projection> comment_formatter_ = New<Projection>();
   bool random_ = false;
 };
 
@@ -17,6 +17,8 @@ class SingleCharFilter : public Filter {
 
   virtual an<Translation> Apply(an<Translation> translation,
                                 CandidateList* candidates);
+  // candidates are reordered only.
+  virtual bool KeepsCandidateCount() { return true; }
 };
 
 }  // namespace rime
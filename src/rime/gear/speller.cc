@@ -165,7 +165,11 @@ bool Speller::AutoSelectUniqueCandidate(Context* ctx) {
   if (!ctx->HasMenu())
     return false;
   const Segment& seg(ctx->composition().back());
-  bool unique_candidate = seg.menu->Prepare(2) == 1;
+  // counting the candidates is cheaper than making them, where possible.
+  int probed = engine_->ProbeCandidates(seg, 2);
+  if (probed == 0 || probed >= 2)
+    return false;
+  bool unique_candidate = probed == 1 || seg.menu->Prepare(2) == 1;
   if (!unique_candidate)
     return false;
   const string& input(ctx->input());
@@ -204,54 +204,47 @@ void SwitchTranslation::LoadSwitches(Switcher* switcher) {
   Engine* engine = switcher->attached_engine();
   if (!engine)
     return;
-  Config* config = engine->schema()->config();
-  if (!config)
+  if (!engine->schema()->config())
     return;
   Context* context = engine->context();
+  const auto& options = engine->schema()->switch_index().options();
   vector<an<RadioGroup>> groups;
-  Switches switches(config);
-  switches.FindOption(
-      [this, switcher, context,
-       &groups](Switches::SwitchOption option) -> Switches::FindResult {
-        if (!has_state_label(option, 0)) {
-          return Switches::kContinue;
-        }
-        if (option.type == Switches::kToggleOption) {
-          bool current_state = context->get_option(option.option_name);
-          Append(New<Switch>(option, current_state,
-                             switcher->IsAutoSave(option.option_name)));
-        } else if (option.type == Switches::kRadioGroup) {
-          an<RadioGroup> group;
-          if (option.option_index == 0) {
-            group = New<RadioGroup>(context, switcher);
-            groups.push_back(group);
-          } else {
-            group = groups.back();
-          }
-          Append(group->CreateOption(option, option.option_index));
-        }
-        return Switches::kContinue;
-      });
+  for (const auto& option : options) {
+    if (!has_state_label(option, 0)) {
+      continue;
+    }
+    if (option.type == Switches::kToggleOption) {
+      bool current_state = context->get_option(option.option_name);
+      Append(New<Switch>(option, current_state,
+                         switcher->IsAutoSave(option.option_name)));
+    } else if (option.type == Switches::kRadioGroup) {
+      an<RadioGroup> group;
+      if (option.option_index == 0) {
+        group = New<RadioGroup>(context, switcher);
+        groups.push_back(group);
+      } else {
+        group = groups.back();
+      }
+      Append(group->CreateOption(option, option.option_index));
+    }
+  }
   for (auto& group : groups) {
     group->SelectOption(group->GetSelectedOption());
   }
   if (switcher->context()->get_option("_fold_options")) {
     auto folded_options = New<FoldedOptions>(switcher->schema()->config());
-    switches.FindOption(
-        [context, &folded_options](
-            Switches::SwitchOption option) -> Switches::FindResult {
-          bool current_state = context->get_option(option.option_name);
-          if (option.type == Switches::kToggleOption) {
-            if (has_state_label(option, current_state)) {
-              folded_options->Append(option, current_state);
-            }
-          } else if (option.type == Switches::kRadioGroup) {
-            if (current_state && has_state_label(option, option.option_index)) {
-              folded_options->Append(option, option.option_index);
-            }
-          }
-          return Switches::kContinue;
-        });
+    for (const auto& option : options) {
+      bool current_state = context->get_option(option.option_name);
+      if (option.type == Switches::kToggleOption) {
+        if (has_state_label(option, current_state)) {
+          folded_options->Append(option, current_state);
+        }
+      } else if (option.type == Switches::kRadioGroup) {
+        if (current_state && has_state_label(option, option.option_index)) {
+          folded_options->Append(option, option.option_index);
+        }
+      }
+    }
     if (folded_options->size() > 1) {
       folded_options->Finish();
       candies_.clear();
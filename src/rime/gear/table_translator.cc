@@ -7,7 +7,7 @@
 #include <boost/algorithm/string.hpp>
 #include <boost/range/adaptor/reversed.hpp>
 #include <cmath>
-#include <utf8.h>
+#include <rime/arena.h>
 #include <rime/candidate.h>
 #include <rime/common.h>
 #include <rime/composition.h>
@@ -16,6 +16,7 @@
 #include <rime/engine.h>
 #include <rime/schema.h>
 #include <rime/translation.h>
+#include <rime/algo/strings.h>
 #include <rime/dict/dictionary.h>
 #include <rime/dict/user_dictionary.h>
 #include <rime/gear/charset_filter.h>
@@ -70,6 +71,10 @@ static bool is_constructed(const DictEntry* e) {
   return UnityTableEncoder::HasPrefix(e->custom_code);
 }
 
+size_t TableTranslation::Fill(CandidateList* out, size_t n) {
+  return FillWith(this, out, n);
+}
+
 an<Candidate> TableTranslation::Peek() {
   if (exhausted())
     return nullptr;
@@ -83,7 +88,7 @@ an<Candidate> TableTranslation::Peek() {
   auto type = incomplete       ? "completion"
               : is_user_phrase ? "user_table"
                                : "table";
-  auto phrase = New<Phrase>(language_, type, start_, end_, e);
+  auto phrase = NewIn<Phrase>(arena_, language_, type, start_, end_, e);
   if (phrase) {
     phrase->set_comment(comment);
     phrase->set_preedit(preedit_);
@@ -99,32 +104,40 @@ bool TableTranslation::CheckEmpty() {
   return is_empty;
 }
 
+// entries from the table and the user dict are merged in the order of these
+// ranks, and in the order of their own source within the same rank; user
+// phrases go first among entries of equal rank.
+static int merge_rank(const DictEntry* e, bool is_user_phrase) {
+  bool complete = e->remaining_code_length == 0;
+  if (is_user_phrase)
+    return complete && !is_constructed(e) ? 0 : 2;
+  return complete ? 1 : 3;
+}
+
 bool TableTranslation::PreferUserPhrase() {
   if (uter_.exhausted())
     return false;
   if (iter_.exhausted())
     return true;
-  if (iter_.Peek()->remaining_code_length == 0 &&
-      (uter_.Peek()->remaining_code_length != 0 ||
-       is_constructed(uter_.Peek().get())))
-    return false;
-  else
-    return true;
+  return merge_rank(uter_.Peek().get(), true) <=
+         merge_rank(iter_.Peek().get(), false);
 }
 
 // LazyTableTranslation
 
 class LazyTableTranslation : public TableTranslation {
  public:
-  static const size_t kInitialSearchLimit = 10;
-  static const size_t kExpandingFactor = 10;
+  // the sources are resumed for a page of entries at a time, as the merged
+  // entries are consumed, so that neither is searched ahead of need.
+  static const size_t kFetchBatchSize = 10;
 
   LazyTableTranslation(TableTranslator* translator,
                        const string& input,
                        size_t start,
                        size_t end,
                        const string& preedit,
-                       bool enable_user_dict);
+                       bool enable_user_dict,
+                       an<Arena> arena = nullptr);
   bool FetchUserPhrases(TableTranslator* translator);
   virtual bool FetchMoreUserPhrases();
   virtual bool FetchMoreTableEntries();
@@ -135,6 +148,8 @@ class LazyTableTranslation : public TableTranslation {
   size_t limit_;
   size_t user_dict_limit_;
   string user_dict_key_;
+  // resumed to find more keys in the table by each fetch.
+  an<Prism::SearchState> search_;
 };
 
 LazyTableTranslation::LazyTableTranslation(TableTranslator* translator,
@@ -142,7 +157,8 @@ LazyTableTranslation::LazyTableTranslation(TableTranslator* translator,
                                            size_t start,
                                            size_t end,
                                            const string& preedit,
-                                           bool enable_user_dict)
+                                           bool enable_user_dict,
+                                           an<Arena> arena)
     : TableTranslation(translator,
                        translator->language(),
                        input,
@@ -151,8 +167,9 @@ LazyTableTranslation::LazyTableTranslation(TableTranslator* translator,
                        preedit),
       dict_(translator->dict()),
       user_dict_(enable_user_dict ? translator->user_dict() : NULL),
-      limit_(kInitialSearchLimit),
-      user_dict_limit_(kInitialSearchLimit) {
+      limit_(kFetchBatchSize),
+      user_dict_limit_(kFetchBatchSize) {
+  set_arena(std::move(arena));
   FetchUserPhrases(translator) || FetchMoreUserPhrases();
   FetchMoreTableEntries();
   CheckEmpty();
@@ -178,8 +195,6 @@ bool LazyTableTranslation::FetchMoreUserPhrases() {
   if (count < user_dict_limit_) {
     DLOG(INFO) << "all user dict entries obtained.";
     user_dict_limit_ = 0;  // no more try
-  } else {
-    user_dict_limit_ *= kExpandingFactor;
   }
   return !uter_.exhausted();
 }
@@ -187,18 +202,16 @@ bool LazyTableTranslation::FetchMoreUserPhrases() {
 bool LazyTableTranslation::FetchMoreTableEntries() {
   if (!dict_ || limit_ == 0)
     return false;
-  size_t previous_entry_count = iter_.entry_count();
   DLOG(INFO) << "fetching more table entries: limit = " << limit_
-             << ", count = " << previous_entry_count;
+             << ", count = " << iter_.entry_count();
+  // the entries of the keys found before have been iterated over.
   DictEntryIterator more;
-  if (dict_->LookupWords(&more, input_, true, limit_) < limit_) {
+  more.set_arena(arena_);
+  if (dict_->LookupMoreWords(&more, input_, &search_, limit_) < limit_) {
     DLOG(INFO) << "all table entries obtained.";
     limit_ = 0;  // no more try
-  } else {
-    limit_ *= kExpandingFactor;
   }
-  if (more.entry_count() > previous_entry_count) {
-    more.Skip(previous_entry_count);
+  if (more.entry_count() > 0) {
     iter_ = std::move(more);
   }
   return true;
@@ -239,9 +252,56 @@ static bool starts_with_completion(an<Translation> translation) {
   return cand && cand->type() == "completion";
 }
 
+int TableTranslator::ProbeCandidates(const string& input,
+                                     const Segment& segment,
+                                     int limit) {
+  if (!segment.HasAnyTagIn(matching_tags()))
+    return 0;
+  string code = input;
+  boost::trim_right_if(code, boost::is_any_of(delimiters_));
+  bool filter_by_charset = enable_charset_filter_ &&
+                           !engine_->context()->get_option("extended_charset");
+  size_t max_texts = limit;
+  size_t search_limit = enable_completion_ ? max_texts : 0;
+  bool truncated = false;
+  set<string> texts;
+  if (dict_ && dict_->loaded()) {
+    DictEntryIterator iter;
+    size_t keys =
+        dict_->LookupWords(&iter, code, enable_completion_, search_limit);
+    truncated = truncated || (search_limit && keys >= search_limit);
+    for (; !iter.exhausted() && texts.size() < max_texts; iter.Next()) {
+      DictEntryView entry = iter.PeekView();
+      if (!filter_by_charset || CharsetFilter::FilterDictEntryView(entry))
+        texts.insert(entry.text());
+    }
+  }
+  if (user_dict_ && user_dict_->loaded() && !IsUserDictDisabledFor(input) &&
+      texts.size() < max_texts) {
+    UserDictEntryIterator uter;
+    size_t keys =
+        user_dict_->LookupWords(&uter, code, enable_completion_, search_limit);
+    truncated = truncated || (search_limit && keys >= search_limit);
+    if (encoder_ && encoder_->loaded()) {
+      encoder_->LookupPhrases(&uter, code, enable_completion_);
+    }
+    for (; !uter.exhausted() && texts.size() < max_texts; uter.Next()) {
+      const string& text = uter.Peek()->text;
+      if (!filter_by_charset || CharsetFilter::FilterText(text))
+        texts.insert(text);
+    }
+  }
+  if (texts.size() >= max_texts)
+    return limit;
+  // the words are yet to be counted, or a sentence may be made.
+  if (truncated || enable_sentence_ || sentence_over_completion_)
+    return -1;
+  return int(texts.size());
+}
+
 an<Translation> TableTranslator::Query(const string& input,
                                        const Segment& segment) {
-  if (!segment.HasAnyTagIn(tags_))
+  if (!segment.HasAnyTagIn(matching_tags()))
     return nullptr;
   DLOG(INFO) << "input = '" << input << "', [" << segment.start << ", "
              << segment.end << ")";
@@ -255,13 +315,15 @@ an<Translation> TableTranslator::Query(const string& input,
   string code = input;
   boost::trim_right_if(code, boost::is_any_of(delimiters_));
 
+  const an<Arena>& arena = engine_->context()->arena();
   an<Translation> translation;
   if (enable_completion_) {
-    translation = Cached<LazyTableTranslation>(this, code, segment.start,
-                                               segment.start + input.length(),
-                                               preedit, enable_user_dict);
+    translation = Cached<LazyTableTranslation>(
+        this, code, segment.start, segment.start + input.length(), preedit,
+        enable_user_dict, arena);
   } else {
     DictEntryIterator iter;
+    iter.set_arena(arena);
     if (dict_ && dict_->loaded()) {
       dict_->LookupWords(&iter, code, false);
     }
@@ -272,10 +334,13 @@ an<Translation> TableTranslator::Query(const string& input,
         encoder_->LookupPhrases(&uter, code, false);
       }
     }
-    if (!iter.exhausted() || !uter.exhausted())
-      translation = Cached<TableTranslation>(
+    if (!iter.exhausted() || !uter.exhausted()) {
+      auto table_translation = New<TableTranslation>(
           this, language(), code, segment.start, segment.start + input.length(),
           preedit, std::move(iter), std::move(uter));
+      table_translation->set_arena(arena);
+      translation = New<CacheTranslation>(table_translation);
+    }
   }
   if (translation) {
     bool filter_by_charset =
@@ -291,7 +356,9 @@ an<Translation> TableTranslator::Query(const string& input,
   if (enable_sentence_ && !translation) {
     translation = MakeSentence(input, segment.start,
                                /* include_prefix_phrases = */ true);
-  } else if (sentence_over_completion_ && starts_with_completion(translation)) {
+  } else if (sentence_over_completion_ &&
+             starts_with_completion(translation) &&
+             !engine_->context()->OverLatencyBudget()) {
     if (auto sentence = MakeSentence(input, segment.start)) {
       translation = sentence + translation;
     }
@@ -300,12 +367,27 @@ an<Translation> TableTranslator::Query(const string& input,
     return nullptr;
   }
   translation = New<DistinctTranslation>(translation);
-  if (contextual_suggestions_) {
+  if (contextual_suggestions_ && !engine_->context()->OverLatencyBudget()) {
     return poet_->ContextualWeighted(translation, input, segment.start, this);
   }
   return translation;
 }
 
+void TableTranslator::Hibernate() {
+  sentence_lookups_ = SentenceLookups();
+  if (poet_)
+    poet_->ReleaseLattice();
+}
+
+void TableTranslator::FlushUserData() {
+  if (user_dict_)
+    user_dict_->Flush();
+}
+
+void TableTranslator::WarmUp() {
+  WarmUpDictionaries();
+}
+
 bool TableTranslator::Memorize(const CommitEntry& commit_entry) {
   if (!user_dict_)
     return false;
@@ -340,8 +422,7 @@ bool TableTranslator::Memorize(const CommitEntry& commit_entry) {
             continue;
           }
           phrase = it->text + phrase;  // prepend another word
-          size_t phrase_length = utf8::unchecked::distance(
-              phrase.c_str(), phrase.c_str() + phrase.length());
+          size_t phrase_length = strings::utf8_length(phrase);
           if (static_cast<int>(phrase_length) > max_phrase_length_)
             break;
           DLOG(INFO) << "phrase: " << phrase;
@@ -356,7 +437,7 @@ bool TableTranslator::Memorize(const CommitEntry& commit_entry) {
 string TableTranslator::GetPrecedingText(size_t start) const {
   return !contextual_suggestions_ ? string()
          : start > 0 ? engine_->context()->composition().GetTextBefore(start)
-                     : engine_->context()->commit_history().latest_text();
+                     : engine_->context()->commit_history().preceding_text();
 }
 
 // SentenceSyllabifier
@@ -538,11 +619,34 @@ inline static void collect_entries(DictEntryList& entries,
   }
 }
 
+// the results of codes within the previous input stay valid as long as the
+// input is only extended or shortened at the end, and the user dictionary,
+// which the encoder writes to as well, has not changed since.
+TableTranslator::SentenceLookups& TableTranslator::UpdateSentenceLookups(
+    const string& input,
+    bool filter_by_charset) {
+  auto& lookups = sentence_lookups_;
+  uint64_t user_dict_revision = user_dict_ ? user_dict_->revision() : 0;
+  if ((!boost::starts_with(input, lookups.input) &&
+       !boost::starts_with(lookups.input, input)) ||
+      lookups.filter_by_charset != filter_by_charset ||
+      lookups.user_dict_revision != user_dict_revision) {
+    lookups.user_words.clear();
+    lookups.unity_words.clear();
+    lookups.table_words.clear();
+    lookups.filter_by_charset = filter_by_charset;
+    lookups.user_dict_revision = user_dict_revision;
+  }
+  lookups.input = input;
+  return lookups;
+}
+
 an<Translation> TableTranslator::MakeSentence(const string& input,
                                               size_t start,
                                               bool include_prefix_phrases) {
   bool filter_by_charset = enable_charset_filter_ &&
                            !engine_->context()->get_option("extended_charset");
+  auto& lookups = UpdateSentenceLookups(input, filter_by_charset);
   DictEntryCollector collector;
   UserDictEntryCollector user_phrase_collector;
   WordGraph graph;
@@ -564,13 +668,18 @@ an<Translation> TableTranslator::MakeSentence(const string& input,
         if (homographs.size() >= max_homographs_)
           continue;
         DLOG(INFO) << "active input: " << active_input << "[0, " << len << ")";
-        UserDictEntryIterator uter;
-        string resume_key;
         string key = active_input.substr(0, len);
-        user_dict_->LookupWords(&uter, key, false, 0, &resume_key);
-        if (filter_by_charset) {
-          uter.AddFilter(CharsetFilter::FilterDictEntry);
+        auto cached = lookups.user_words.try_emplace(key);
+        auto& words = cached.first->second;
+        if (cached.second) {
+          user_dict_->LookupWords(&words.uter, key, false, 0,
+                                  &words.resume_key);
+          if (filter_by_charset) {
+            words.uter.AddFilter(CharsetFilter::FilterDictEntry);
+          }
         }
+        UserDictEntryIterator uter(words.uter);
+        const string& resume_key = words.resume_key;
         if (!uter.exhausted()) {
           vertices.insert(end_pos);
           if (start_pos == 0 && max_homographs_ > 1) {
@@ -602,13 +711,18 @@ an<Translation> TableTranslator::MakeSentence(const string& input,
         if (!homographs.empty())
           continue;
         DLOG(INFO) << "active input: " << active_input << "[0, " << len << ")";
-        UserDictEntryIterator uter;
-        string resume_key;
         string key = active_input.substr(0, len);
-        encoder_->LookupPhrases(&uter, key, false, 0, &resume_key);
-        if (filter_by_charset) {
-          uter.AddFilter(CharsetFilter::FilterDictEntry);
+        auto cached = lookups.unity_words.try_emplace(key);
+        auto& words = cached.first->second;
+        if (cached.second) {
+          encoder_->LookupPhrases(&words.uter, key, false, 0,
+                                  &words.resume_key);
+          if (filter_by_charset) {
+            words.uter.AddFilter(CharsetFilter::FilterDictEntry);
+          }
         }
+        UserDictEntryIterator uter(words.uter);
+        const string& resume_key = words.resume_key;
         if (!uter.exhausted()) {
           vertices.insert(end_pos);
           if (start_pos == 0 && max_homographs_ > 1) {
@@ -644,11 +758,16 @@ an<Translation> TableTranslator::MakeSentence(const string& input,
         auto& homographs = same_start_pos[end_pos];
         if (homographs.size() >= max_homographs_)
           continue;
-        DictEntryIterator iter;
-        dict_->LookupWords(&iter, active_input.substr(0, m.length), false);
-        if (filter_by_charset) {
-          iter.AddFilter(CharsetFilter::FilterDictEntry);
+        string code = active_input.substr(0, m.length);
+        auto cached = lookups.table_words.try_emplace(code);
+        if (cached.second) {
+          dict_->LookupWords(&cached.first->second, code, false);
+          if (filter_by_charset) {
+            cached.first->second.AddViewFilter(
+                CharsetFilter::FilterDictEntryView);
+          }
         }
+        DictEntryIterator iter(cached.first->second);
         if (!iter.exhausted()) {
           vertices.insert(end_pos);
           if (start_pos == 0 && max_homographs_ - homographs.size() > 1) {
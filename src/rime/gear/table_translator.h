@@ -29,7 +29,15 @@ class TableTranslator : public Translator,
   TableTranslator(const Ticket& ticket);
 
   virtual an<Translation> Query(const string& input, const Segment& segment);
+  // counts the distinct words of the code in the table and the user
+  // dictionary; -1 if a sentence could be made of the input.
+  virtual int ProbeCandidates(const string& input,
+                              const Segment& segment,
+                              int limit);
   virtual bool Memorize(const CommitEntry& commit_entry);
+  virtual void Hibernate();
+  virtual void FlushUserData();
+  virtual void WarmUp();
 
   an<Translation> MakeSentence(const string& input,
                                size_t start,
@@ -38,6 +46,24 @@ class TableTranslator : public Translator,
   UnityTableEncoder* encoder() const { return encoder_.get(); }
 
  protected:
+  // lookup results of the codes making up the input, reused in making
+  // sentences while the input grows by code letters appended to it.
+  struct SentenceLookups {
+    struct UserWords {
+      UserDictEntryIterator uter;
+      string resume_key;
+    };
+    string input;
+    bool filter_by_charset = false;
+    uint64_t user_dict_revision = 0;
+    hash_map<string, UserWords> user_words;
+    hash_map<string, UserWords> unity_words;
+    hash_map<string, DictEntryIterator> table_words;
+  };
+
+  SentenceLookups& UpdateSentenceLookups(const string& input,
+                                         bool filter_by_charset);
+
   bool enable_charset_filter_ = false;
   bool enable_encoder_ = false;
   bool enable_sentence_ = true;
@@ -47,6 +73,7 @@ class TableTranslator : public Translator,
   int max_homographs_ = 1;
   the<Poet> poet_;
   the<UnityTableEncoder> encoder_;
+  SentenceLookups sentence_lookups_;
 };
 
 class TableTranslation : public Translation {
@@ -62,6 +89,9 @@ class TableTranslation : public Translation {
 
   virtual bool Next();
   virtual an<Candidate> Peek();
+  size_t Fill(CandidateList* out, size_t n) override;
+  // candidates are allocated from the arena instead of the heap.
+  void set_arena(an<Arena> arena) { arena_ = std::move(arena); }
 
  protected:
   virtual bool FetchMoreUserPhrases() { return false; }
@@ -82,6 +112,7 @@ class TableTranslation : public Translation {
   string preedit_;
   DictEntryIterator iter_;
   UserDictEntryIterator uter_;
+  an<Arena> arena_;
 };
 
 }  // namespace rime
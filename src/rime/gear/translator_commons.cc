@@ -5,6 +5,7 @@
 // 2012-04-22 GONG Chen <chen.sst@gmail.com>
 //
 #include <algorithm>
+#include <mutex>
 #include <boost/range/adaptor/reversed.hpp>
 #include <rime/config.h>
 #include <rime/schema.h>
@@ -28,6 +29,28 @@ bool Patterns::Load(an<ConfigList> patterns) {
   return true;
 }
 
+static std::mutex shared_patterns_mutex;
+static map<string, weak<const Patterns>> shared_patterns;
+
+an<const Patterns> Patterns::Shared(an<ConfigList> patterns) {
+  auto loaded = New<Patterns>();
+  if (!patterns)
+    return loaded;
+  string signature;
+  for (auto it = patterns->begin(); it != patterns->end(); ++it) {
+    if (auto value = As<ConfigValue>(*it))
+      signature += value->str();
+    signature += '\n';
+  }
+  std::lock_guard<std::mutex> lock(shared_patterns_mutex);
+  auto& shared = shared_patterns[signature];
+  if (auto found = shared.lock())
+    return found;
+  loaded->Load(patterns);
+  shared = loaded;
+  return loaded;
+}
+
 // Spans
 
 void Spans::AddVertex(size_t vertex) {
@@ -101,6 +124,7 @@ void Sentence::Extend(const DictEntry& another,
   components_.push_back(another);
   word_lengths_.push_back(end_pos - end());
   set_end(end_pos);
+  InvalidateSpans();
   DLOG(INFO) << "extend sentence " << end_pos << ") " << text()
              << " weight: " << weight();
 }
@@ -108,28 +132,35 @@ void Sentence::Extend(const DictEntry& another,
 void Sentence::Offset(size_t offset) {
   set_start(start() + offset);
   set_end(end() + offset);
+  InvalidateSpans();
 }
 
 // TranslatorOptions
 
-TranslatorOptions::TranslatorOptions(const Ticket& ticket) {
+TranslatorOptions::TranslatorOptions(const Ticket& ticket)
+    : preedit_formatter_(New<Projection>()),
+      comment_formatter_(New<Projection>()),
+      user_dict_disabling_patterns_(New<Patterns>()) {
   if (!ticket.schema)
     return;
+  page_size_ = ticket.schema->page_size();
   if (Config* config = ticket.schema->config()) {
     config->GetString(ticket.name_space + "/delimiter", &delimiters_) ||
         config->GetString("speller/delimiter", &delimiters_);
     config->GetBool(ticket.name_space + "/contextual_suggestions",
                     &contextual_suggestions_);
+    config->GetInt(ticket.name_space + "/contextual_time_budget",
+                   &contextual_time_budget_);
     config->GetBool(ticket.name_space + "/enable_completion",
                     &enable_completion_);
     config->GetBool(ticket.name_space + "/strict_spelling", &strict_spelling_);
     config->GetDouble(ticket.name_space + "/initial_quality",
                       &initial_quality_);
-    preedit_formatter_.Load(
+    preedit_formatter_ = Projection::Shared(
         config->GetList(ticket.name_space + "/preedit_format"));
-    comment_formatter_.Load(
+    comment_formatter_ = Projection::Shared(
         config->GetList(ticket.name_space + "/comment_format"));
-    user_dict_disabling_patterns_.Load(
+    user_dict_disabling_patterns_ = Patterns::Shared(
         config->GetList(ticket.name_space + "/disable_user_dict_for_patterns"));
     string tag;
     if (config->GetString(ticket.name_space + "/tag", &tag)) {
@@ -146,15 +177,16 @@ TranslatorOptions::TranslatorOptions(const Ticket& ticket) {
     if (tags_.empty())
       tags_.push_back("abc");
   }
+  matching_tags_ = SegmentTags(tags_);
   if (delimiters_.empty()) {
     delimiters_ = " ";
   }
 }
 
 bool TranslatorOptions::IsUserDictDisabledFor(const string& input) const {
-  if (user_dict_disabling_patterns_.empty())
+  if (user_dict_disabling_patterns_->empty())
     return false;
-  for (const auto& pattern : user_dict_disabling_patterns_) {
+  for (const auto& pattern : *user_dict_disabling_patterns_) {
     if (boost::regex_match(input, pattern))
       return true;
   }
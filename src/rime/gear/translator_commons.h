@@ -11,6 +11,7 @@
 #include <rime/common.h>
 #include <rime/config.h>
 #include <rime/candidate.h>
+#include <rime/segmentation.h>
 #include <rime/translation.h>
 #include <rime/algo/algebra.h>
 #include <rime/algo/syllabifier.h>
@@ -23,6 +24,8 @@ namespace rime {
 class Patterns : public vector<boost::regex> {
  public:
   bool Load(an<ConfigList> patterns);
+  // returns patterns loaded from the list, shared by all loads of the same.
+  static an<const Patterns> Shared(an<ConfigList> patterns);
 };
 
 //
@@ -75,6 +78,7 @@ class Phrase : public Candidate {
   void set_preedit(const string& preedit) { entry_->preedit = preedit; }
   void set_syllabifier(an<PhraseSyllabifier> syllabifier) {
     syllabifier_ = syllabifier;
+    spans_.reset();
   }
   double weight() const { return entry_->weight; }
   void set_weight(double weight) { entry_->weight = weight; }
@@ -99,14 +103,23 @@ class Phrase : public Candidate {
                : Code(entry_->code.begin(),
                       entry_->code.begin() + entry_->matching_code_size);
   }
-  Spans spans() {
-    return syllabifier_ ? syllabifier_->Syllabify(this) : Spans();
+  // syllabified once for the caret moves and deletions over the phrase.
+  const Spans& spans() {
+    if (!spans_) {
+      spans_ = New<Spans>(syllabifier_ ? syllabifier_->Syllabify(this)
+                                       : Spans());
+    }
+    return *spans_;
   }
 
  protected:
+  // to syllabify the phrase again once it has changed.
+  void InvalidateSpans() { spans_.reset(); }
+
   const Language* language_;
   an<DictEntry> entry_;
   an<PhraseSyllabifier> syllabifier_;
+  an<Spans> spans_;
 };
 
 //
@@ -152,32 +165,46 @@ class TranslatorOptions {
     if (tags_.size() == 0) {
       tags_.push_back("abc");
     }
+    matching_tags_ = SegmentTags(tags_);
   }
   const string& tag() const { return tags_[0]; }
-  void set_tag(const string& tag) { tags_[0] = tag; }
+  void set_tag(const string& tag) {
+    tags_[0] = tag;
+    matching_tags_ = SegmentTags(tags_);
+  }
+  // the tags interned, for matching segments.
+  const SegmentTags& matching_tags() const { return matching_tags_; }
   bool contextual_suggestions() const { return contextual_suggestions_; }
   void set_contextual_suggestions(bool enabled) {
     contextual_suggestions_ = enabled;
   }
+  // in milliseconds per keystroke, after the first page; 0 for no limit.
+  int contextual_time_budget() const { return contextual_time_budget_; }
+  size_t page_size() const { return page_size_; }
   bool enable_completion() const { return enable_completion_; }
   void set_enable_completion(bool enabled) { enable_completion_ = enabled; }
   bool strict_spelling() const { return strict_spelling_; }
   void set_strict_spelling(bool is_strict) { strict_spelling_ = is_strict; }
   double initial_quality() const { return initial_quality_; }
   void set_initial_quality(double quality) { initial_quality_ = quality; }
-  Projection& preedit_formatter() { return preedit_formatter_; }
-  Projection& comment_formatter() { return comment_formatter_; }
+  Projection& preedit_formatter() { return *preedit_formatter_; }
+  Projection& comment_formatter() { return *comment_formatter_; }
 
  protected:
   string delimiters_;
   vector<string> tags_{"abc"};  // invariant: non-empty
+  SegmentTags matching_tags_;
   bool contextual_suggestions_ = false;
+  int contextual_time_budget_ = 0;
+  size_t page_size_ = 5;
   bool enable_completion_ = true;
   bool strict_spelling_ = false;
   double initial_quality_ = 0.;
-  Projection preedit_formatter_;
-  Projection comment_formatter_;
-  Patterns user_dict_disabling_patterns_;
+  // compiled once for the same settings, and shared by translators of all
+  // sessions.
+  an<Projection> preedit_formatter_;
+  an<Projection> comment_formatter_;
+  an<const Patterns> user_dict_disabling_patterns_;
 };
 
 }  // namespace rime
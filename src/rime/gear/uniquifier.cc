@@ -4,58 +4,90 @@
 //
 // 2011-12-12 GONG Chen <chen.sst@gmail.com>
 //
+#include <rime/arena.h>
 #include <rime/candidate.h>
 #include <rime/common.h>
+#include <rime/context.h>
+#include <rime/engine.h>
 #include <rime/translation.h>
 #include <rime/gear/uniquifier.h>
 
 namespace rime {
 
+// merges candidates into the first candidate of the same text in the list.
+class CandidateMerger {
+ public:
+  CandidateMerger(CandidateList* candidates, an<Arena> arena)
+      : candidates_(candidates), arena_(std::move(arena)) {}
+  // returns true if the candidate is merged into one in the list.
+  bool Merge(const an<Candidate>& cand);
+
+ private:
+  void IndexCandidates();
+
+  CandidateList* candidates_;
+  an<Arena> arena_;
+  // positions of the first candidates of each text in the list.
+  hash_map<string, size_t> text_index_;
+  // number of candidates in the list that have been indexed.
+  size_t indexed_ = 0;
+};
+
+// candidates are only appended to the menu after those merged before.
+void CandidateMerger::IndexCandidates() {
+  if (indexed_ > candidates_->size()) {
+    text_index_.clear();
+    indexed_ = 0;
+  }
+  for (; indexed_ < candidates_->size(); ++indexed_) {
+    text_index_.emplace((*candidates_)[indexed_]->text(), indexed_);
+  }
+}
+
+bool CandidateMerger::Merge(const an<Candidate>& cand) {
+  IndexCandidates();
+  auto match = text_index_.find(cand->text());
+  if (match == text_index_.end()) {
+    // Encountered a unique candidate.
+    return false;
+  }
+  an<Candidate>& previous = (*candidates_)[match->second];
+  auto uniquified = As<UniquifiedCandidate>(previous);
+  if (!uniquified) {
+    previous = uniquified =
+        NewIn<UniquifiedCandidate>(arena_, previous, "uniquified");
+  }
+  uniquified->Append(cand);
+  return true;
+}
+
 class UniquifiedTranslation : public CacheTranslation {
  public:
-  UniquifiedTranslation(an<Translation> translation, CandidateList* candidates)
-      : CacheTranslation(translation), candidates_(candidates) {
+  UniquifiedTranslation(an<Translation> translation,
+                        CandidateList* candidates,
+                        an<Arena> arena)
+      : CacheTranslation(translation), merger_(candidates, std::move(arena)) {
     Uniquify();
   }
   virtual bool Next();
+  size_t Fill(CandidateList* out, size_t n) override {
+    return Translation::Fill(out, n);
+  }
 
  protected:
   bool Uniquify();
 
-  an<Translation> translation_;
-  CandidateList* candidates_;
+  CandidateMerger merger_;
 };
 
 bool UniquifiedTranslation::Next() {
   return CacheTranslation::Next() && Uniquify();
 }
 
-static CandidateList::iterator find_text_match(const an<Candidate>& target,
-                                               CandidateList::iterator begin,
-                                               CandidateList::iterator end) {
-  for (auto iter = begin; iter != end; ++iter) {
-    if ((*iter)->text() == target->text()) {
-      return iter;
-    }
-  }
-  return end;
-}
-
 bool UniquifiedTranslation::Uniquify() {
   while (!exhausted()) {
-    auto next = Peek();
-    CandidateList::iterator previous =
-        find_text_match(next, candidates_->begin(), candidates_->end());
-    if (previous == candidates_->end()) {
-      // Encountered a unique candidate.
+    if (!merger_.Merge(Peek()))
       return true;
-    }
-    auto uniquified = As<UniquifiedCandidate>(*previous);
-    if (!uniquified) {
-      *previous = uniquified =
-          New<UniquifiedCandidate>(*previous, "uniquified");
-    }
-    uniquified->Append(next);
     CacheTranslation::Next();
   }
   return false;
@@ -65,9 +97,21 @@ bool UniquifiedTranslation::Uniquify() {
 
 Uniquifier::Uniquifier(const Ticket& ticket) : Filter(ticket) {}
 
+an<Arena> Uniquifier::arena() {
+  return engine_ ? engine_->context()->arena() : nullptr;
+}
+
 an<Translation> Uniquifier::Apply(an<Translation> translation,
                                   CandidateList* candidates) {
-  return New<UniquifiedTranslation>(translation, candidates);
+  return New<UniquifiedTranslation>(translation, candidates, arena());
+}
+
+CandidateTransform Uniquifier::GetCandidateTransform(
+    CandidateList* candidates) {
+  auto merger = New<CandidateMerger>(candidates, arena());
+  return [merger](const an<Candidate>& cand) -> an<Candidate> {
+    return merger->Merge(cand) ? nullptr : cand;
+  };
 }
 
 }  // namespace rime
@@ -11,12 +11,21 @@
 
 namespace rime {
 
+class Arena;
+
 class Uniquifier : public Filter {
  public:
   explicit Uniquifier(const Ticket& ticket);
 
   virtual an<Translation> Apply(an<Translation> translation,
                                 CandidateList* candidates);
+  CandidateTransform GetCandidateTransform(CandidateList* candidates) override;
+  // duplicates come from different translators, whose candidates are not
+  // counted together by Engine::ProbeCandidates().
+  bool KeepsCandidateCount() override { return true; }
+
+ protected:
+  an<Arena> arena();
 };
 
 }  // namespace rime
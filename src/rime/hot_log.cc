@@ -0,0 +1,35 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <rime/hot_log.h>
+
+#ifdef RIME_ENABLE_HOT_PATH_LOGGING
+
+namespace rime {
+
+std::atomic<bool> HotLog::switches_[kNumModules] = {};
+
+static const char* kModuleNames[HotLog::kNumModules] = {
+    "engine",
+    "menu",
+    "syllabifier",
+    "user_dictionary",
+    "contextual_translation",
+};
+
+bool HotLog::set_enabled(const string& module_name, bool enabled) {
+  bool all = (module_name == "all");
+  bool found = false;
+  for (int i = 0; i < kNumModules; ++i) {
+    if (all || module_name == kModuleNames[i]) {
+      set_enabled(static_cast<Module>(i), enabled);
+      found = true;
+    }
+  }
+  return found;
+}
+
+}  // namespace rime
+
+#endif  // RIME_ENABLE_HOT_PATH_LOGGING
@@ -0,0 +1,59 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#ifndef RIME_HOT_LOG_H_
+#define RIME_HOT_LOG_H_
+
+#include <rime_api.h>
+#include <rime/common.h>
+
+#ifdef RIME_ENABLE_HOT_PATH_LOGGING
+
+#include <atomic>
+
+namespace rime {
+
+// Switches for the logs on the hot paths of input processing, which are
+// written for every key, syllable or candidate. They are compiled only with
+// ENABLE_HOT_PATH_LOGGING, and turned on at run time per module.
+class RIME_API HotLog {
+ public:
+  enum Module {
+    kEngine,
+    kMenu,
+    kSyllabifier,
+    kUserDictionary,
+    kContextualTranslation,
+    kNumModules,
+  };
+
+  static bool enabled(Module module) {
+    return switches_[module].load(std::memory_order_relaxed);
+  }
+  static void set_enabled(Module module, bool enabled) {
+    switches_[module].store(enabled, std::memory_order_relaxed);
+  }
+  // by the name of the module, eg. "syllabifier", or "all" for every module.
+  // returns false if there is no such module.
+  static bool set_enabled(const string& module_name, bool enabled);
+
+ private:
+  static std::atomic<bool> switches_[kNumModules];
+};
+
+}  // namespace rime
+
+// logs the rest of the statement if the hot path logging of the module is
+// turned on, eg. RIME_HOT_LOG(Syllabifier) << "current_pos: " << pos;
+#define RIME_HOT_LOG(module) \
+  LOG_IF(INFO, ::rime::HotLog::enabled(::rime::HotLog::k##module))
+
+#else
+
+// the statement is dead code, and is dropped by the compiler.
+#define RIME_HOT_LOG(module) LOG_IF(INFO, false)
+
+#endif  // RIME_ENABLE_HOT_PATH_LOGGING
+
+#endif  // RIME_HOT_LOG_H_
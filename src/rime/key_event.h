@@ -55,6 +55,11 @@ class KeyEvent {
   int modifier_ = 0;
 };
 
+// for key events to be looked up in a hash_map.
+inline size_t hash_value(const KeyEvent& key_event) {
+  return static_cast<size_t>(key_event.keycode()) * 31 + key_event.modifier();
+}
+
 // 按鍵序列
 class KeySequence : public vector<KeyEvent> {
  public:
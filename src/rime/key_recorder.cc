@@ -0,0 +1,149 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <cstring>
+#include <random>
+#include <rime/key_event.h>
+#include <rime/key_recorder.h>
+
+namespace rime {
+
+const char KeyRecorder::kMagic[] = "Rime::KeyLog/1.0";
+
+static const uint64_t kMaxStringLength = 1024;
+
+KeyRecorder::KeyRecorder(const path& file_path, bool hash_characters)
+    : out_(file_path.c_str(), std::ios::binary | std::ios::trunc),
+      hash_characters_(hash_characters) {
+  if (hash_characters_) {
+    std::random_device random;
+    salt_ = (uint64_t(random()) << 32) | random();
+  }
+  out_.write(kMagic, sizeof(kMagic));
+}
+
+void KeyRecorder::RecordKey(const KeyEvent& key_event) {
+  auto now = std::chrono::steady_clock::now();
+  uint64_t delay = 0;
+  if (has_recorded_key_) {
+    delay = std::chrono::duration_cast<std::chrono::milliseconds>(
+                now - last_key_time_)
+                .count();
+  }
+  has_recorded_key_ = true;
+  last_key_time_ = now;
+  int keycode = key_event.keycode();
+  if (hash_characters_)
+    keycode = HashCharacter(keycode);
+  out_.put('k');
+  WriteNumber(delay);
+  WriteNumber(uint32_t(keycode));
+  WriteNumber(uint32_t(key_event.modifier()));
+  out_.flush();
+}
+
+void KeyRecorder::RecordSchema(const string& schema_id) {
+  out_.put('s');
+  WriteString(schema_id);
+}
+
+void KeyRecorder::RecordOption(const string& option, bool value) {
+  out_.put('o');
+  WriteString(option);
+  out_.put(value ? 1 : 0);
+}
+
+int KeyRecorder::HashCharacter(int keycode) const {
+  auto pick = [this, keycode](int first, int count) {
+    uint64_t x = (salt_ ^ uint64_t(keycode)) * 0x9e3779b97f4a7c15ULL;
+    return first + int((x >> 32) % count);
+  };
+  if (keycode >= 'a' && keycode <= 'z')
+    return pick('a', 26);
+  if (keycode >= 'A' && keycode <= 'Z')
+    return pick('A', 26);
+  if (keycode >= '0' && keycode <= '9')
+    return pick('0', 10);
+  // punctuation, function keys and the like are kept, as they drive the
+  // engine rather than spell the text.
+  return keycode;
+}
+
+void KeyRecorder::WriteNumber(uint64_t value) {
+  do {
+    uint8_t byte = value & 0x7f;
+    value >>= 7;
+    out_.put(char(value ? byte | 0x80 : byte));
+  } while (value);
+}
+
+void KeyRecorder::WriteString(const string& value) {
+  WriteNumber(value.length());
+  out_.write(value.data(), value.length());
+}
+
+KeyLogReader::KeyLogReader(const path& file_path)
+    : in_(file_path.c_str(), std::ios::binary) {
+  char magic[sizeof(KeyRecorder::kMagic)] = {0};
+  good_ = in_.read(magic, sizeof(magic)) &&
+          !std::memcmp(magic, KeyRecorder::kMagic, sizeof(magic));
+}
+
+bool KeyLogReader::Next(KeyLogRecord* record) {
+  if (!good_)
+    return false;
+  char tag = 0;
+  if (!in_.get(tag))
+    return false;
+  uint64_t delay = 0, keycode = 0, mask = 0;
+  switch (tag) {
+    case 'k':
+      if (!ReadNumber(&delay) || !ReadNumber(&keycode) || !ReadNumber(&mask))
+        break;
+      record->type = KeyLogRecord::kKey;
+      record->delay = uint32_t(delay);
+      record->keycode = int(uint32_t(keycode));
+      record->mask = int(uint32_t(mask));
+      return true;
+    case 's':
+      if (!ReadString(&record->name))
+        break;
+      record->type = KeyLogRecord::kSchema;
+      return true;
+    case 'o': {
+      char value = 0;
+      if (!ReadString(&record->name) || !in_.get(value))
+        break;
+      record->type = KeyLogRecord::kOption;
+      record->value = value != 0;
+      return true;
+    }
+  }
+  LOG(ERROR) << "corrupt key log record, tag: " << int(tag);
+  good_ = false;
+  return false;
+}
+
+bool KeyLogReader::ReadNumber(uint64_t* value) {
+  *value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    char byte = 0;
+    if (!in_.get(byte))
+      return false;
+    *value |= uint64_t(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+  return false;
+}
+
+bool KeyLogReader::ReadString(string* value) {
+  uint64_t length = 0;
+  if (!ReadNumber(&length) || length > kMaxStringLength)
+    return false;
+  value->resize(length);
+  return length == 0 || bool(in_.read(&(*value)[0], length));
+}
+
+}  // namespace rime
@@ -0,0 +1,90 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#ifndef RIME_KEY_RECORDER_H_
+#define RIME_KEY_RECORDER_H_
+
+#include <stdint.h>
+#include <chrono>
+#include <fstream>
+#include <rime_api.h>
+#include <rime/common.h>
+
+namespace rime {
+
+class KeyEvent;
+
+// An entry of a key log: a key event, or the schema or an option changed
+// before the next key event.
+struct KeyLogRecord {
+  enum Type {
+    kKey,
+    kSchema,
+    kOption,
+  };
+  Type type = kKey;
+  // milliseconds since the previous key event.
+  uint32_t delay = 0;
+  int keycode = 0;
+  int mask = 0;
+  // the schema id, or the option name.
+  string name;
+  bool value = false;
+};
+
+// Records the key events of a session into a compact binary log, along with
+// the schema and options needed to replay them.
+//
+// The log starts with kMagic; each record is a tag byte followed by its
+// fields, with integers in LEB128 and strings prefixed by their length:
+//   'k' delay, keycode, mask
+//   's' schema id
+//   'o' option name, value
+class RIME_API KeyRecorder {
+ public:
+  static const char kMagic[];
+
+  // with hash_characters, a printable character is recorded as another of
+  // its kind, picked by a hash salted for each log, so that the text typed
+  // cannot be read from the log while its shape is kept.
+  KeyRecorder(const path& file_path, bool hash_characters);
+
+  bool good() const { return bool(out_); }
+
+  void RecordKey(const KeyEvent& key_event);
+  void RecordSchema(const string& schema_id);
+  void RecordOption(const string& option, bool value);
+
+ private:
+  int HashCharacter(int keycode) const;
+  void WriteNumber(uint64_t value);
+  void WriteString(const string& value);
+
+  std::ofstream out_;
+  bool hash_characters_;
+  uint64_t salt_ = 0;
+  bool has_recorded_key_ = false;
+  std::chrono::steady_clock::time_point last_key_time_;
+};
+
+// Reads back the records of a key log.
+class RIME_API KeyLogReader {
+ public:
+  explicit KeyLogReader(const path& file_path);
+
+  // false if the file is not a key log.
+  bool good() const { return good_; }
+  bool Next(KeyLogRecord* record);
+
+ private:
+  bool ReadNumber(uint64_t* value);
+  bool ReadString(string* value);
+
+  std::ifstream in_;
+  bool good_ = false;
+};
+
+}  // namespace rime
+
+#endif  // RIME_KEY_RECORDER_H_
@@ -1,6 +1,8 @@
 
 #include <stddef.h>
 #include <string.h>
+#include <string_view>
+#include <unordered_map>
 #include <X11/keysym.h>
 #include <rime_api.h>
 
@@ -2023,21 +2025,36 @@ RIME_API const char* RimeGetModifierName(int modifier) {
   return NULL;
 }
 
-RIME_API int RimeGetKeycodeByName(const char* name) {
+// the key tables are indexed on first use. of entries with the same name or
+// keycode, the first one in the table searched before is kept.
+
+static std::unordered_map<std::string_view, int> index_keycodes_by_name() {
+  std::unordered_map<std::string_view, int> index;
   for (const key_entry* p = keys_by_keyval; p->keyval != XK_VoidSymbol; ++p) {
-    if (!strcmp(name, key_names + p->offset)) {
-      return p->keyval;
-    }
+    index.emplace(key_names + p->offset, p->keyval);
   }
-  return XK_VoidSymbol;
+  return index;
 }
 
-RIME_API const char* RimeGetKeyName(int keycode) {
+static std::unordered_map<int, const char*> index_key_names_by_keycode() {
+  std::unordered_map<int, const char*> index;
   const int n = sizeof(keys_by_name) / sizeof(const key_entry);
   for (int i = 0; i < n; ++i) {
-    if (keycode == keys_by_name[i].keyval) {
-      return key_names + keys_by_name[i].offset;
-    }
+    index.emplace(keys_by_name[i].keyval, key_names + keys_by_name[i].offset);
   }
-  return NULL;
+  return index;
+}
+
+RIME_API int RimeGetKeycodeByName(const char* name) {
+  static const auto keycodes_by_name = index_keycodes_by_name();
+  if (!name)
+    return XK_VoidSymbol;
+  auto found = keycodes_by_name.find(name);
+  return found != keycodes_by_name.end() ? found->second : XK_VoidSymbol;
+}
+
+RIME_API const char* RimeGetKeyName(int keycode) {
+  static const auto key_names_by_keycode = index_key_names_by_keycode();
+  auto found = key_names_by_keycode.find(keycode);
+  return found != key_names_by_keycode.end() ? found->second : NULL;
 }
@@ -8,21 +8,32 @@
 #include <rime/build_config.h>
 
 #include <algorithm>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
 #include <boost/algorithm/string.hpp>
 #include <filesystem>
 #include <boost/uuid/random_generator.hpp>
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/uuid_io.hpp>
 #include <rime/common.h>
+#include <rime/language.h>
 #include <rime/resource.h>
 #include <rime/schema.h>
+#include <rime/schema_index.h>
 #include <rime/service.h>
 #include <rime/setup.h>
 #include <rime/ticket.h>
+#include <rime/worker_pool.h>
 #include <rime/algo/fs.h>
 #include <rime/algo/utilities.h>
+#include <rime/config/config_compiler.h>
+#include <rime/dict/build_cache.h>
 #include <rime/dict/dictionary.h>
 #include <rime/dict/dict_compiler.h>
+#include <rime/dict/level_db.h>
+#include <rime/dict/sorted_db.h>
 #include <rime/lever/deployment_tasks.h>
 #include <rime/lever/user_dict_manager.h>
 #ifdef _WIN32
@@ -110,6 +121,37 @@ bool InstallationUpdate::Run(Deployer* deployer) {
       deployer->sync_dir = user_data_path / "sync";
     }
     LOG(INFO) << "sync dir: " << deployer->sync_dir;
+    LevelDbOptions db_options;
+    int size = 0;
+    if (config.GetInt("user_db/block_cache_size", &size) && size > 0) {
+      db_options.block_cache_size = size;
+    }
+    config.GetInt("user_db/bloom_filter_bits", &db_options.bloom_filter_bits);
+    if (config.GetInt("user_db/write_buffer_size", &size) && size > 0) {
+      db_options.write_buffer_size = size;
+    }
+    config.GetBool("user_db/compression", &db_options.compression);
+    LevelDb::Configure(db_options);
+    int pool_size = 0;
+    if (config.GetInt("session_pool/size", &pool_size) && pool_size >= 0) {
+      Service::instance().engine_pool().set_size(pool_size);
+    }
+    string build_cache_dir;
+    if (config.GetString("build_cache/directory", &build_cache_dir)) {
+      BuildCache::set_directory(path(build_cache_dir));
+      LOG(INFO) << "build cache: " << BuildCache::directory();
+    }
+    int memory_limit_mb = 0;
+    if (config.GetInt("dict_compiler/memory_limit", &memory_limit_mb) &&
+        memory_limit_mb >= 0) {
+      DictCompiler::set_memory_limit(size_t(memory_limit_mb) << 20);
+    }
+    int cache_limit_mb = 0;
+    if (config.GetInt("cache/memory_limit", &cache_limit_mb) &&
+        cache_limit_mb >= 0) {
+      MemoryBudget& budget = Service::instance().memory_budget();
+      budget.set_budget(size_t(cache_limit_mb) << 20);
+    }
     if (config.GetString("distribution_code_name", &last_distro_code_name)) {
       LOG(INFO) << "previous distribution: " << last_distro_code_name;
     }
@@ -159,8 +201,15 @@ bool InstallationUpdate::Run(Deployer* deployer) {
   return config.SaveToFile(installation_info);
 }
 
+// checksums of source files, kept between deployments.
+static const char* kFileChecksumManifest = "checksums.txt";
+
 bool WorkspaceUpdate::Run(Deployer* deployer) {
   LOG(INFO) << "updating workspace.";
+  // files included by many configs are parsed once.
+  ConfigCompileSession compile_session;
+  auto& manifest = FileChecksumManifest::instance();
+  manifest.Load(deployer->staging_dir / kFileChecksumManifest);
   {
     the<DeploymentTask> t;
     t.reset(new ConfigFileUpdate("default.yaml", "config_version"));
@@ -184,22 +233,50 @@ bool WorkspaceUpdate::Run(Deployer* deployer) {
   }
 
   LOG(INFO) << "updating schemas.";
-  int success = 0;
-  int failure = 0;
-  map<string, path> schemas;
+  std::atomic<int> success = 0;
+  std::atomic<int> failure = 0;
   the<ResourceResolver> resolver(Service::instance().CreateResourceResolver(
       {"schema_source_file", "", ".schema.yaml"}));
-  auto build_schema = [&](const string& schema_id, bool as_dependency = false) {
-    if (schemas.find(schema_id) != schemas.end())  // already built
-      return;
+  auto schema_component = Config::Require("schema");
+  // builds the schema on a worker thread; a schema in the list also collects
+  // the schemas it depends on.
+  auto build_schema = [&](const string& schema_id, const path& schema_path,
+                          bool as_dependency, vector<string>* dependencies) {
     LOG(INFO) << "schema: " << schema_id;
-    path schema_path;
-    if (schemas.find(schema_id) == schemas.end()) {
-      schema_path = resolver->ResolvePath(schema_id);
-      schemas[schema_id] = schema_path;
-    } else {
-      schema_path = schemas[schema_id];
+    try {
+      the<DeploymentTask> t(new SchemaUpdate(schema_path));
+      if (t->Run(deployer))
+        ++success;
+      else
+        ++failure;
+    } catch (const std::exception& ex) {
+      ++failure;
+      LOG(ERROR) << "Error updating schema '" << schema_id
+                 << "': " << ex.what();
+    }
+    if (as_dependency)
+      return;
+    the<Config> schema_config(schema_component->Create(schema_id));
+    if (!schema_config)
+      return;
+    if (auto list = schema_config->GetList("schema/dependencies")) {
+      for (auto d = list->begin(); d != list->end(); ++d) {
+        if (auto dependency = As<ConfigValue>(*d))
+          dependencies->push_back(dependency->str());
+      }
     }
+  };
+  // schemas are updated in parallel. dictionaries shared by several schemas
+  // are compiled by one of them, while the others wait to find them ready.
+  set<string> scheduled;
+  WorkerPool pool((std::max)(1u, std::thread::hardware_concurrency()));
+  using PendingSchema = pair<std::future<void>, an<vector<string>>>;
+  std::deque<PendingSchema> pending;
+  auto schedule_schema = [&](const string& schema_id,
+                             bool as_dependency = false) {
+    if (!scheduled.insert(schema_id).second)  // already built
+      return;
+    path schema_path = resolver->ResolvePath(schema_id);
     if (schema_path.empty() || !fs::exists(schema_path)) {
       if (as_dependency) {
         LOG(WARNING) << "missing input schema; skipped unsatisfied dependency: "
@@ -210,13 +287,14 @@ bool WorkspaceUpdate::Run(Deployer* deployer) {
       }
       return;
     }
-    the<DeploymentTask> t(new SchemaUpdate(schema_path));
-    if (t->Run(deployer))
-      ++success;
-    else
-      ++failure;
+    auto dependencies = New<vector<string>>();
+    pending.emplace_back(pool.Submit([=, &build_schema] {
+                           build_schema(schema_id, schema_path, as_dependency,
+                                        dependencies.get());
+                         }),
+                         dependencies);
   };
-  auto schema_component = Config::Require("schema");
+  vector<string> schema_ids;
   for (auto it = schema_list->begin(); it != schema_list->end(); ++it) {
     auto item = As<ConfigMap>(*it);
     if (!item)
@@ -224,24 +302,29 @@ bool WorkspaceUpdate::Run(Deployer* deployer) {
     auto schema_property = item->GetValue("schema");
     if (!schema_property)
       continue;
-    const string& schema_id = schema_property->str();
-    build_schema(schema_id);
-    the<Config> schema_config(schema_component->Create(schema_id));
-    if (!schema_config)
-      continue;
-    if (auto dependencies = schema_config->GetList("schema/dependencies")) {
-      for (auto d = dependencies->begin(); d != dependencies->end(); ++d) {
-        auto dependency = As<ConfigValue>(*d);
-        if (!dependency)
-          continue;
-        const string& dependency_id = dependency->str();
-        bool as_dependency = true;
-        build_schema(dependency_id, as_dependency);
-      }
+    schema_ids.push_back(schema_property->str());
+    schedule_schema(schema_property->str());
+  }
+  while (!pending.empty()) {
+    PendingSchema next = std::move(pending.front());
+    pending.pop_front();
+    next.first.wait();
+    for (const auto& dependency_id : *next.second) {
+      bool as_dependency = true;
+      schedule_schema(dependency_id, as_dependency);
     }
   }
   LOG(INFO) << "finished updating schemas: " << success << " success, "
             << failure << " failure.";
+  if (fs::exists(deployer->staging_dir)) {
+    manifest.Save(deployer->staging_dir / kFileChecksumManifest);
+    // the schema list and the switcher read the names of the schemas here
+    // rather than opening each of them.
+    path index_path = deployer->staging_dir / SchemaIndex::kFileName;
+    if (!SchemaIndex::Build(schema_ids).Save(index_path)) {
+      LOG(ERROR) << "Error writing schema index: " << index_path;
+    }
+  }
 
   the<Config> user_config(Config::Require("user_config")->Create("user"));
   // TODO: store as 64-bit number to avoid the year 2038 problem
@@ -321,7 +404,61 @@ static bool TrashDeprecatedUserCopy(const path& shared_copy,
   return false;
 }
 
+// read-only user dicts in sorted dbs are compiled along with the schema.
+static bool CompileSortedUserDb(Config* config, const string& dict_name) {
+  string db_class;
+  if (!config->GetString("translator/db_class", &db_class) ||
+      db_class != "sorteddb") {
+    return true;
+  }
+  string user_dict_name;
+  if (!config->GetString("translator/user_dict", &user_dict_name)) {
+    user_dict_name = Language::get_language_component(dict_name);
+  }
+  auto component = Db::Require(db_class);
+  if (!component) {
+    LOG(ERROR) << "undefined db class '" << db_class << "'.";
+    return false;
+  }
+  // user dicts can be shared by schemas updated at the same time.
+  static std::mutex mutex;
+  std::lock_guard<std::mutex> lock(mutex);
+  the<Db> db(component->Create(user_dict_name));
+  auto sorted_db = dynamic_cast<SortedDb*>(db.get());
+  return sorted_db && sorted_db->Compile();
+}
+
+// schemas sharing a dictionary may be updated at the same time; its files
+// are compiled by one schema at a time, the others find them up to date.
+static vector<std::unique_lock<std::mutex>> LockDictionaryFiles(
+    Dictionary* dict) {
+  static std::mutex mutex;
+  static map<string, the<std::mutex>> file_mutexes;
+  // locked in the order of file names, so that schemas never deadlock.
+  set<string> file_names(dict->packs().begin(), dict->packs().end());
+  file_names.insert(dict->name());
+  if (dict->prism())
+    file_names.insert(dict->prism()->file_path().u8string());
+  vector<std::mutex*> mutexes;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& file_name : file_names) {
+      auto& file_mutex = file_mutexes[file_name];
+      if (!file_mutex)
+        file_mutex.reset(new std::mutex);
+      mutexes.push_back(file_mutex.get());
+    }
+  }
+  vector<std::unique_lock<std::mutex>> locks;
+  for (auto* file_mutex : mutexes) {
+    locks.emplace_back(*file_mutex);
+  }
+  return locks;
+}
+
 bool SchemaUpdate::Run(Deployer* deployer) {
+  DeploymentTimer timer(deployer, source_path_.filename().u8string(),
+                        "schema_update");
   if (!fs::exists(source_path_)) {
     LOG(ERROR) << "Error updating schema: nonexistent file '" << source_path_
                << "'.";
@@ -360,6 +497,8 @@ bool SchemaUpdate::Run(Deployer* deployer) {
   if (!MaybeCreateDirectory(deployer->staging_dir)) {
     return false;
   }
+  auto locks = LockDictionaryFiles(dict.get());
+  DeploymentTimer dict_timer(deployer, schema_id, "dict_compile");
   DictCompiler dict_compiler(dict.get());
   if (verbose_) {
     dict_compiler.set_options(DictCompiler::kRebuild | DictCompiler::kDump);
@@ -372,7 +511,13 @@ bool SchemaUpdate::Run(Deployer* deployer) {
     LOG(ERROR) << "dictionary '" << dict_name << "' failed to compile.";
     return false;
   }
+  dict_timer.Stop();
   LOG(INFO) << "dictionary '" << dict_name << "' is ready.";
+  DeploymentTimer user_db_timer(deployer, schema_id, "compile_user_db");
+  if (!CompileSortedUserDb(schema.config(), dict_name)) {
+    LOG(WARNING) << "user dict of schema '" << schema_id
+                 << "' failed to compile.";
+  }
   return true;
 }
 
@@ -425,6 +570,7 @@ static bool ConfigNeedsUpdate(Config* config) {
 }
 
 bool ConfigFileUpdate::Run(Deployer* deployer) {
+  DeploymentTimer timer(deployer, file_name_, "config_compile");
   const path shared_data_path(deployer->shared_data_dir);
   const path user_data_path(deployer->user_data_dir);
   // trash deprecated user copy created by an older version of Rime
@@ -507,12 +653,11 @@ bool UserDictUpgrade::Run(Deployer* deployer) {
   UserDictManager manager(deployer);
   UserDictList dicts;
   manager.GetUserDictList(&dicts, legacy_userdb_component);
-  bool ok = true;
-  for (auto it = dicts.cbegin(); it != dicts.cend(); ++it) {
-    if (!manager.UpgradeUserDict(*it))
-      ok = false;
-  }
-  return ok;
+  // each user dict is upgraded in a db of its own.
+  return manager.ForEachUserDict(dicts, "user_dict_upgrade",
+                                 [&manager](const string& dict_name) {
+                                   return manager.UpgradeUserDict(dict_name);
+                                 }) == 0;
 }
 
 bool UserDictSync::Run(Deployer* deployer) {
@@ -520,6 +665,36 @@ bool UserDictSync::Run(Deployer* deployer) {
   return mgr.SynchronizeAll();
 }
 
+// a phrase committed once drops below this weight after some 3,700 commits
+// of other phrases.
+static const double kDefaultPruneThreshold = 1e-8;
+static const int kDefaultPruneMaxEntries = 100000;
+
+bool UserDictPrune::Run(Deployer* deployer) {
+  double threshold = kDefaultPruneThreshold;
+  int max_entries = kDefaultPruneMaxEntries;
+  Config config;
+  if (config.LoadFromFile(deployer->user_data_dir / "installation.yaml")) {
+    config.GetDouble("user_db/prune_threshold", &threshold);
+    config.GetInt("user_db/prune_max_entries", &max_entries);
+  }
+  if (threshold <= 0 || max_entries <= 0) {
+    LOG(INFO) << "user dict pruning is disabled.";
+    return true;
+  }
+  UserDictManager manager(deployer);
+  UserDictList dicts;
+  manager.GetUserDictList(&dicts);
+  bool ok = true;
+  for (const auto& dict_name : dicts) {
+    if (manager.Prune(dict_name, threshold, max_entries) < 0) {
+      LOG(WARNING) << "user dict '" << dict_name << "' was not pruned.";
+      ok = false;
+    }
+  }
+  return ok;
+}
+
 static bool IsCustomizedCopy(const path& file_path) {
   auto file_name = file_path.filename().u8string();
   if (boost::ends_with(file_name, ".yaml") &&
@@ -96,6 +96,13 @@ class UserDictSync : public DeploymentTask {
   bool Run(Deployer* deployer);
 };
 
+// remove user phrases whose weight has long decayed, a slice per run
+class UserDictPrune : public DeploymentTask {
+ public:
+  UserDictPrune(TaskInitializer arg = TaskInitializer()) {}
+  bool Run(Deployer* deployer);
+};
+
 class BackupConfigFiles : public DeploymentTask {
  public:
   BackupConfigFiles(TaskInitializer arg = TaskInitializer()) {}
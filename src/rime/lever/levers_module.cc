@@ -26,6 +26,7 @@ static void rime_levers_initialize() {
   r.Register("user_dict_upgrade", new Component<UserDictUpgrade>);
   r.Register("cleanup_trash", new Component<CleanupTrash>);
   r.Register("user_dict_sync", new Component<UserDictSync>);
+  r.Register("user_dict_prune", new Component<UserDictPrune>);
   r.Register("backup_config_files", new Component<BackupConfigFiles>);
   r.Register("clean_old_log_files", new Component<CleanOldLogFiles>);
 }
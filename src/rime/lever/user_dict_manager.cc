@@ -4,14 +4,22 @@
 //
 // 2012-03-23 GONG Chen <chen.sst@gmail.com>
 //
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <fstream>
+#include <future>
+#include <thread>
 #include <boost/algorithm/string.hpp>
 #include <filesystem>
 #include <boost/scope_exit.hpp>
 #include <rime/common.h>
 #include <rime/deployer.h>
+#include <rime/worker_pool.h>
+#include <rime/algo/dynamics.h>
 #include <rime/algo/utilities.h>
 #include <rime/dict/db_utils.h>
+#include <rime/dict/level_db.h>
 #include <rime/dict/table_db.h>
 #include <rime/dict/user_db.h>
 #include <rime/lever/user_dict_manager.h>
@@ -48,6 +56,16 @@ void UserDictManager::GetUserDictList(UserDictList* user_dict_list,
   }
 }
 
+// user dicts processed in parallel may race to create the same directory,
+// which is no error.
+static bool MaybeCreateDirectory(const path& dir) {
+  std::error_code ec;
+  if (fs::create_directories(dir, ec) || fs::is_directory(dir))
+    return true;
+  LOG(ERROR) << "error creating directory '" << dir << "'.";
+  return false;
+}
+
 bool UserDictManager::Backup(const string& dict_name) {
   the<Db> db(user_db_component_->Create(dict_name));
   if (!db->OpenReadOnly())
@@ -60,18 +78,19 @@ bool UserDictManager::Backup(const string& dict_name) {
     }
   }
   const path& dir(deployer_->user_data_sync_dir());
-  if (!fs::exists(dir)) {
-    if (!fs::create_directories(dir)) {
-      LOG(ERROR) << "error creating directory '" << dir << "'.";
-      return false;
-    }
-  }
+  if (!MaybeCreateDirectory(dir))
+    return false;
   string snapshot_file = dict_name + UserDb::snapshot_extension();
-  return db->Backup(dir / snapshot_file);
+  string delta_file = dict_name + UserDb::delta_snapshot_extension();
+  return UserDbHelper(db).IncrementalBackup(dir / snapshot_file,
+                                            dir / delta_file);
 }
 
 bool UserDictManager::Restore(const path& snapshot_file) {
-  the<Db> temp(user_db_component_->Create(".temp"));
+  // named after the snapshot, for user dicts may be restored in parallel.
+  string temp_name = snapshot_file.filename().u8string();
+  boost::erase_last(temp_name, UserDb::snapshot_extension());
+  the<Db> temp(user_db_component_->Create(".temp." + temp_name));
   if (temp->Exists())
     temp->Remove();
   if (!temp->Open())
@@ -116,6 +135,8 @@ int UserDictManager::Export(const string& dict_name, const path& text_file) {
     return -1;
   TsvWriter writer(text_file, TableDb::format.formatter);
   writer.file_description = "Rime user dictionary export";
+  writer.progress = progress_;
+  // entries are read from a snapshot of the db.
   DbSource source(db.get());
   int num_entries = 0;
   try {
@@ -139,10 +160,12 @@ int UserDictManager::Import(const string& dict_name, const path& text_file) {
   if (!UserDbHelper(db).IsUserDb())
     return -1;
   TsvReader reader(text_file, TableDb::format.parser);
-  UserDbImporter importer(db.get());
+  reader.progress = progress_;
+  UserDbImporter importer(db.get(), import_batch_size_);
   int num_entries = 0;
   try {
     num_entries = reader >> importer;
+    importer.CloseImport();
   } catch (std::exception& ex) {
     LOG(ERROR) << ex.what();
     return -1;
@@ -162,13 +185,8 @@ bool UserDictManager::UpgradeUserDict(const string& dict_name) {
     return false;
   LOG(INFO) << "upgrading user dict '" << dict_name << "'.";
   path trash = deployer_->user_data_dir / "trash";
-  if (!fs::exists(trash)) {
-    std::error_code ec;
-    if (!fs::create_directories(trash, ec)) {
-      LOG(ERROR) << "error creating directory '" << trash << "'.";
-      return false;
-    }
-  }
+  if (!MaybeCreateDirectory(trash))
+    return false;
   string snapshot_file = dict_name + UserDb::snapshot_extension();
   path snapshot_path = trash / snapshot_file;
   return legacy_db->Backup(snapshot_path) && legacy_db->Close() &&
@@ -179,25 +197,36 @@ bool UserDictManager::Synchronize(const string& dict_name) {
   LOG(INFO) << "synchronize user dict '" << dict_name << "'.";
   bool success = true;
   path sync_dir(deployer_->sync_dir);
-  if (!fs::exists(sync_dir)) {
-    std::error_code ec;
-    if (!fs::create_directories(sync_dir, ec)) {
-      LOG(ERROR) << "error creating directory '" << sync_dir << "'.";
-      return false;
-    }
-  }
+  if (!MaybeCreateDirectory(sync_dir))
+    return false;
   // *.userdb.txt
   string snapshot_file = dict_name + UserDb::snapshot_extension();
+  string delta_file = dict_name + UserDb::delta_snapshot_extension();
+  vector<pair<path, path>> snapshots;
   for (fs::directory_iterator it(sync_dir), end; it != end; ++it) {
     if (!fs::is_directory(it->path()))
       continue;
     path file_path = path(it->path()) / snapshot_file;
     if (fs::exists(file_path)) {
-      LOG(INFO) << "merging snapshot file: " << file_path;
-      if (!Restore(file_path)) {
-        LOG(ERROR) << "failed to merge snapshot file: " << file_path;
-        success = false;
-      }
+      snapshots.push_back({file_path, path(it->path()) / delta_file});
+    }
+  }
+  if (!snapshots.empty()) {
+    the<Db> dest(user_db_component_->Create(dict_name));
+    if (!dest->Open())
+      return false;
+    BOOST_SCOPE_EXIT((&dest)) {
+      dest->Close();
+    }
+    BOOST_SCOPE_EXIT_END
+    LOG(INFO) << "merging " << snapshots.size()
+              << " snapshot files into userdb '" << dict_name << "'...";
+    UserDbSyncMerger merger(dest.get());
+    for (const auto& files : snapshots) {
+      merger.AddSnapshot(files.first, files.second);
+    }
+    if (!merger.Merge()) {
+      success = false;
     }
   }
   if (!Backup(dict_name)) {
@@ -207,15 +236,40 @@ bool UserDictManager::Synchronize(const string& dict_name) {
   return success;
 }
 
+int UserDictManager::ForEachUserDict(
+    const UserDictList& user_dicts,
+    const string& stage,
+    function<bool(const string& dict_name)> process) {
+  // the work is mostly disk I/O; more threads than this only make them
+  // compete for the disk.
+  size_t num_threads = (std::min)(
+      {user_dicts.size(), kMaxParallelUserDicts,
+       size_t(std::thread::hardware_concurrency())});
+  WorkerPool pool((std::max)(num_threads, size_t(1)));
+  std::atomic<int> failure{0};
+  vector<std::future<void>> pending;
+  for (const string& dict_name : user_dicts) {
+    pending.push_back(pool.Submit([this, &failure, &stage, &process,
+                                   dict_name] {
+      DeploymentTimer timer(deployer_, dict_name, stage);
+      if (!process(dict_name))
+        ++failure;
+    }));
+  }
+  for (auto& done : pending) {
+    done.wait();
+  }
+  return failure;
+}
+
 bool UserDictManager::SynchronizeAll() {
   UserDictList user_dicts;
   GetUserDictList(&user_dicts);
   LOG(INFO) << "synchronizing " << user_dicts.size() << " user dicts.";
-  int failure = 0;
-  for (const string& dict_name : user_dicts) {
-    if (!Synchronize(dict_name))
-      ++failure;
-  }
+  int failure =
+      ForEachUserDict(user_dicts, "user_dict_sync", [this](const string& name) {
+        return Synchronize(name);
+      });
   if (failure) {
     LOG(ERROR) << "failed synchronizing " << failure << "/" << user_dicts.size()
                << " user dicts.";
@@ -223,4 +277,78 @@ bool UserDictManager::SynchronizeAll() {
   return !failure;
 }
 
+static const size_t kPruneBatchSize = 1024;
+static const auto kPruneBatchInterval = std::chrono::milliseconds(5);
+static const char* kPruneCursorKey = "/prune_cursor";
+
+int UserDictManager::Prune(const string& dict_name,
+                           double threshold,
+                           size_t max_entries) {
+  the<Db> db(user_db_component_->Create(dict_name));
+  if (!db->Open())
+    return -1;
+  BOOST_SCOPE_EXIT((&db)) {
+    db->Close();
+  }
+  BOOST_SCOPE_EXIT_END
+  if (!UserDbHelper(db).IsUserDb())
+    return -1;
+  TickCount tick = 1;
+  string value;
+  if (db->MetaFetch("/tick", &value)) {
+    try {
+      tick = std::stoul(value);
+    } catch (...) {
+    }
+  }
+  // resume after the last key scanned by the previous run
+  string cursor;
+  db->MetaFetch(kPruneCursorKey, &cursor);
+  auto accessor = db->QueryAll();
+  if (!accessor)
+    return -1;
+  if (!cursor.empty())
+    accessor->Jump(cursor);
+  auto transactional = dynamic_cast<Transactional*>(db.get());
+  vector<string> stale_keys;
+  auto erase_stale_keys = [&] {
+    if (transactional)
+      transactional->BeginTransaction();
+    for (const auto& key : stale_keys) {
+      db->Erase(key);
+    }
+    if (transactional)
+      transactional->CommitTransaction();
+    stale_keys.clear();
+  };
+  int num_pruned = 0;
+  size_t num_scanned = 0;
+  string key;
+  while (num_scanned < max_entries &&
+         accessor->GetNextRecord(&key, &value)) {
+    if (key == cursor)
+      continue;
+    UserDbValue v(value);
+    double weight = algo::formula_d(0, (double)tick, v.dee, (double)v.tick);
+    if (weight < threshold) {
+      stale_keys.push_back(key);
+      ++num_pruned;
+    }
+    if (++num_scanned % kPruneBatchSize == 0) {
+      erase_stale_keys();
+      std::this_thread::sleep_for(kPruneBatchInterval);
+    }
+  }
+  erase_stale_keys();
+  // start over from the first key once the end is reached
+  db->MetaUpdate(kPruneCursorKey, accessor->exhausted() ? "" : key);
+  LOG(INFO) << "pruned " << num_pruned << " of " << num_scanned
+            << " entries in user dict '" << dict_name << "'.";
+  if (num_pruned > 0) {
+    if (auto level_db = dynamic_cast<LevelDb*>(db.get()))
+      level_db->Compact();
+  }
+  return num_pruned;
+}
+
 }  // namespace rime
@@ -8,6 +8,7 @@
 #define RIME_USER_DICT_MANAGER_H_
 
 #include <rime/common.h>
+#include <rime/dict/tsv.h>
 #include <rime/dict/user_db.h>
 
 namespace rime {
@@ -32,14 +33,36 @@ class RIME_API UserDictManager {
   int Export(const string& dict_name, const path& text_file);
   // returns num of imported entries, -1 denotes failure
   int Import(const string& dict_name, const path& text_file);
+  // reports the number of entries exported or imported so far.
+  void set_progress(TsvProgress progress) { progress_ = progress; }
+  // entries imported in each transaction.
+  void set_import_batch_size(size_t batch_size) {
+    import_batch_size_ = batch_size;
+  }
 
   bool Synchronize(const string& dict_name);
   bool SynchronizeAll();
 
+  // user dicts processed at the same time, each in a db of its own.
+  static constexpr size_t kMaxParallelUserDicts = 4;
+  // processes the user dicts in parallel, reporting the time spent on each
+  // to the deployer as the stage. returns the number of failures.
+  int ForEachUserDict(const UserDictList& user_dicts,
+                      const string& stage,
+                      function<bool(const string& dict_name)> process);
+
+  // removes entries whose weight has decayed below the threshold, scanning
+  // up to max_entries from where the last run stopped, and pausing between
+  // batches to leave room for other work on the db.
+  // returns num of pruned entries, -1 denotes failure
+  int Prune(const string& dict_name, double threshold, size_t max_entries);
+
  protected:
   Deployer* deployer_;
   path path_;
   UserDb::Component* user_db_component_;
+  TsvProgress progress_;
+  size_t import_batch_size_ = UserDbSyncMerger::kBatchSize;
 };
 
 }  // namespace rime
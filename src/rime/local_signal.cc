@@ -0,0 +1,49 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <algorithm>
+#include <rime/local_signal.h>
+
+namespace rime {
+
+namespace local_signal {
+
+void SlotList::Add(an<SlotBase> slot,
+                   boost::signals2::connect_position position) {
+  if (emitting) {
+    pending.emplace_back(std::move(slot), position);
+    dirty = true;
+  } else if (position == boost::signals2::at_front) {
+    slots.insert(slots.begin(), std::move(slot));
+  } else {
+    slots.push_back(std::move(slot));
+  }
+}
+
+void SlotList::Purge() {
+  dirty = false;
+  slots.erase(std::remove_if(slots.begin(), slots.end(),
+                             [](const an<SlotBase>& slot) {
+                               return !slot->connected;
+                             }),
+              slots.end());
+  vector<pair<an<SlotBase>, boost::signals2::connect_position>> added;
+  added.swap(pending);
+  for (auto& x : added) {
+    if (x.first->connected)
+      Add(std::move(x.first), x.second);
+  }
+}
+
+SlotReleaser::~SlotReleaser() {
+  slot->connected = false;
+  if (auto slots = list.lock()) {
+    slots->dirty = true;
+    slots->Update();
+  }
+}
+
+}  // namespace local_signal
+
+}  // namespace rime
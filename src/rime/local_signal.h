@@ -0,0 +1,113 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#ifndef RIME_LOCAL_SIGNAL_H_
+#define RIME_LOCAL_SIGNAL_H_
+
+#include <rime_api.h>
+#include <rime/common.h>
+
+namespace rime {
+
+namespace local_signal {
+
+struct SlotBase {
+  bool connected = true;
+};
+
+struct SlotList {
+  vector<an<SlotBase>> slots;
+  // slots connected while emitting, to be added to the list afterwards.
+  vector<pair<an<SlotBase>, boost::signals2::connect_position>> pending;
+  int emitting = 0;
+  // slots have been disconnected or are pending.
+  bool dirty = false;
+
+  RIME_API void Add(an<SlotBase> slot,
+                    boost::signals2::connect_position position);
+  // removes disconnected slots and adds pending ones, unless emitting.
+  void Update() {
+    if (dirty && !emitting)
+      Purge();
+  }
+  RIME_API void Purge();
+};
+
+template <class... Args>
+struct Slot : SlotBase {
+  explicit Slot(function<void(Args...)> call) : call(std::move(call)) {}
+  function<void(Args...)> call;
+};
+
+// held by the boost slot standing in for a slot of a LocalSignal; the slot
+// is disconnected once the boost slot is released, as its connection is
+// disconnected or the signal is gone.
+struct SlotReleaser {
+  SlotReleaser(weak<SlotList> list, an<SlotBase> slot)
+      : list(std::move(list)), slot(std::move(slot)) {}
+  RIME_API ~SlotReleaser();
+
+  weak<SlotList> list;
+  an<SlotBase> slot;
+};
+
+}  // namespace local_signal
+
+template <class Signature>
+class LocalSignal;
+
+// A signal connected to and emitted on one thread at a time, such as the
+// notifiers of a session. Unlike boost::signals2::signal, it takes no lock,
+// and emits without allocating. Slots may connect and disconnect while the
+// signal is emitted; those connected are not called until the next time.
+// connect() returns a boost::signals2::connection as signal does, so code
+// keeping the connections is unchanged; blocking one has no effect though.
+template <class... Args>
+class LocalSignal<void(Args...)> {
+ public:
+  using slot_type = function<void(Args...)>;
+
+  LocalSignal() : slots_(New<local_signal::SlotList>()) {}
+  LocalSignal(const LocalSignal&) = delete;
+  LocalSignal& operator=(const LocalSignal&) = delete;
+
+  connection connect(
+      slot_type slot,
+      boost::signals2::connect_position position = boost::signals2::at_back) {
+    auto s = New<local_signal::Slot<Args...>>(std::move(slot));
+    slots_->Add(s, position);
+    auto releaser = New<local_signal::SlotReleaser>(slots_, s);
+    return connections_.connect([releaser] {});
+  }
+
+  void operator()(Args... args) const {
+    // the slots are swapped out if the notifiers are swapped while emitting.
+    an<local_signal::SlotList> list = slots_;
+    ++list->emitting;
+    for (size_t i = 0; i < list->slots.size(); ++i) {
+      auto* slot =
+          static_cast<local_signal::Slot<Args...>*>(list->slots[i].get());
+      if (slot->connected)
+        slot->call(args...);
+    }
+    --list->emitting;
+    list->Update();
+  }
+
+  bool empty() const { return slots_->slots.empty(); }
+
+  void swap(LocalSignal& other) {
+    slots_.swap(other.slots_);
+    connections_.swap(other.connections_);
+  }
+
+ private:
+  an<local_signal::SlotList> slots_;
+  // never emitted; it keeps the connections returned by connect().
+  signal<void()> connections_;
+};
+
+}  // namespace rime
+
+#endif  // RIME_LOCAL_SIGNAL_H_
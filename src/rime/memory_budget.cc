@@ -0,0 +1,98 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <algorithm>
+#include <rime/memory_budget.h>
+
+namespace rime {
+
+void MemoryBudget::set_budget(size_t bytes) {
+  budget_ = bytes;
+  Enforce();
+}
+
+size_t MemoryBudget::usage() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t total = 0;
+  for (const auto& x : caches_) {
+    total += x.second.second.usage();
+  }
+  return total;
+}
+
+void MemoryBudget::Enforce() {
+  size_t budget = budget_;
+  if (budget == 0)
+    return;
+  struct Usage {
+    const string* name;
+    BudgetedCache* cache;
+    size_t bytes;
+    double benefit;
+  };
+  std::lock_guard<std::mutex> lock(mutex_);
+  vector<Usage> usages;
+  size_t total = 0;
+  for (auto& x : caches_) {
+    BudgetedCache& cache = x.second.second;
+    size_t bytes = cache.usage();
+    total += bytes;
+    double benefit = cache.benefit ? cache.benefit() : 0.0;
+    usages.push_back({&x.second.first, &cache, bytes, benefit});
+  }
+  if (total <= budget)
+    return;
+  DLOG(INFO) << "caches holding " << total << " bytes over budget " << budget;
+  std::stable_sort(
+      usages.begin(), usages.end(),
+      [](const Usage& a, const Usage& b) { return a.benefit < b.benefit; });
+  for (const Usage& usage : usages) {
+    if (total <= budget)
+      break;
+    size_t excess = total - budget;
+    size_t target = usage.bytes > excess ? usage.bytes - excess : 0;
+    DLOG(INFO) << "shrinking cache '" << *usage.name << "' to " << target
+               << " bytes.";
+    usage.cache->shrink(target);
+    total -= usage.bytes - target;
+  }
+}
+
+void MemoryBudget::Release() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  LOG(INFO) << "releasing the memory of " << caches_.size() << " caches.";
+  for (auto& x : caches_) {
+    x.second.second.shrink(0);
+  }
+}
+
+uint64_t MemoryBudget::Register(string name, BudgetedCache cache) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  uint64_t id = ++last_id_;
+  caches_.emplace(id, make_pair(std::move(name), std::move(cache)));
+  return id;
+}
+
+void MemoryBudget::Unregister(uint64_t id) {
+  // waits for the cache to be shrunk if it is being shrunk.
+  std::lock_guard<std::mutex> lock(mutex_);
+  caches_.erase(id);
+}
+
+MemoryBudget& MemoryBudget::instance() {
+  // never destroyed, as caches held by static objects may outlive others.
+  static MemoryBudget* s_instance = new MemoryBudget;
+  return *s_instance;
+}
+
+MemoryBudgetRegistration::MemoryBudgetRegistration(string name,
+                                                   BudgetedCache cache)
+    : id_(MemoryBudget::instance().Register(std::move(name),
+                                            std::move(cache))) {}
+
+MemoryBudgetRegistration::~MemoryBudgetRegistration() {
+  MemoryBudget::instance().Unregister(id_);
+}
+
+}  // namespace rime
@@ -0,0 +1,75 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#ifndef RIME_MEMORY_BUDGET_H_
+#define RIME_MEMORY_BUDGET_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <rime_api.h>
+#include <rime/common.h>
+
+namespace rime {
+
+// A cache whose memory counts towards the budget of the service.
+struct BudgetedCache {
+  // bytes held by the cache.
+  function<size_t()> usage;
+  // what a byte held is worth, eg. hits per kilobyte; the caches worth the
+  // least are shrunk first. defaults to 0.
+  function<double()> benefit;
+  // drops entries, the least useful first, until no more than the given
+  // bytes are held.
+  function<void(size_t bytes)> shrink;
+};
+
+// Caps the memory held by the caches of all sessions and dictionaries.
+// Caches register themselves; they are shrunk when the service cleans up
+// stale sessions, when the budget is lowered and on low memory.
+// Callbacks are made from any thread, one at a time.
+class RIME_API MemoryBudget {
+ public:
+  // bytes the caches may hold in total; 0 (the default) for no limit.
+  size_t budget() const { return budget_; }
+  void set_budget(size_t bytes);
+  // bytes held by the caches in total.
+  size_t usage();
+  // shrinks the caches worth the least until the total fits the budget.
+  void Enforce();
+  // empties the caches, eg. when the system is low on memory.
+  void Release();
+
+  static MemoryBudget& instance();
+
+ private:
+  friend class MemoryBudgetRegistration;
+
+  MemoryBudget() = default;
+  uint64_t Register(string name, BudgetedCache cache);
+  void Unregister(uint64_t id);
+
+  std::atomic<size_t> budget_{0};
+  std::mutex mutex_;
+  uint64_t last_id_ = 0;
+  map<uint64_t, pair<string, BudgetedCache>> caches_;
+};
+
+// Keeps a cache registered with the memory budget while it lives. An object
+// should drop its registration before tearing down the cache.
+class RIME_API MemoryBudgetRegistration {
+ public:
+  MemoryBudgetRegistration(string name, BudgetedCache cache);
+  ~MemoryBudgetRegistration();
+  MemoryBudgetRegistration(const MemoryBudgetRegistration&) = delete;
+  MemoryBudgetRegistration& operator=(const MemoryBudgetRegistration&) =
+      delete;
+
+ private:
+  uint64_t id_;
+};
+
+}  // namespace rime
+
+#endif  // RIME_MEMORY_BUDGET_H_
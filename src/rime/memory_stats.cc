@@ -0,0 +1,64 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <atomic>
+#include <mutex>
+#include <rime/memory_stats.h>
+
+namespace rime {
+
+static std::mutex registry_mutex;
+static uint64_t last_registration_id = 0;
+static map<uint64_t, MemoryUsageReporter>& registry() {
+  static map<uint64_t, MemoryUsageReporter> reporters;
+  return reporters;
+}
+
+MemoryStatsRegistration::MemoryStatsRegistration(MemoryUsageReporter reporter) {
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  id_ = ++last_registration_id;
+  registry().emplace(id_, std::move(reporter));
+}
+
+MemoryStatsRegistration::~MemoryStatsRegistration() {
+  // waits for the reporter to return if it is being called.
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  registry().erase(id_);
+}
+
+vector<MemoryUsage> MemoryStats::Collect() {
+  vector<MemoryUsage> usages;
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  for (const auto& x : registry()) {
+    x.second(&usages);
+  }
+  return usages;
+}
+
+AllocationCounts& AllocationCounts::current() {
+  static thread_local AllocationCounts counts;
+  return counts;
+}
+
+// constant-initialized, as allocations are counted from static
+// initialization on.
+static std::atomic<uint64_t> total_allocations{0};
+static std::atomic<uint64_t> total_bytes{0};
+
+AllocationCounts AllocationCounts::total() {
+  AllocationCounts counts;
+  counts.allocations = total_allocations.load(std::memory_order_relaxed);
+  counts.bytes = total_bytes.load(std::memory_order_relaxed);
+  return counts;
+}
+
+void AllocationCounts::Count(size_t size) {
+  AllocationCounts& counts = current();
+  ++counts.allocations;
+  counts.bytes += size;
+  total_allocations.fetch_add(1, std::memory_order_relaxed);
+  total_bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+}  // namespace rime
@@ -0,0 +1,70 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#ifndef RIME_MEMORY_STATS_H_
+#define RIME_MEMORY_STATS_H_
+
+#include <stdint.h>
+#include <rime_api.h>
+#include <rime/common.h>
+
+namespace rime {
+
+// Memory held by a part of the engine.
+struct MemoryUsage {
+  // eg. "table", "prism", "reverse_db", "string_table", "user_dict_cache",
+  // "sessions" or "session".
+  string category;
+  // the file path, the name of the dictionary or the id of the session.
+  string name;
+  // bytes of the file mapped into memory, and an estimate of how many of
+  // them are resident.
+  size_t mapped_bytes = 0;
+  size_t resident_bytes = 0;
+  // bytes allocated on the heap.
+  size_t heap_bytes = 0;
+  // the number of items held, eg. cached lookups, sessions or candidates.
+  size_t count = 0;
+};
+
+using MemoryUsageReporter = function<void(vector<MemoryUsage>* usages)>;
+
+// Keeps a reporter registered for MemoryStats::Collect() while it lives.
+// Reporters are called from any thread, one at a time, so an object should
+// drop its registration before tearing down what is reported on; reporters
+// must not register or drop registrations themselves.
+class RIME_API MemoryStatsRegistration {
+ public:
+  explicit MemoryStatsRegistration(MemoryUsageReporter reporter);
+  ~MemoryStatsRegistration();
+  MemoryStatsRegistration(const MemoryStatsRegistration&) = delete;
+  MemoryStatsRegistration& operator=(const MemoryStatsRegistration&) = delete;
+
+ private:
+  uint64_t id_;
+};
+
+class RIME_API MemoryStats {
+ public:
+  // the usage reported by the live registrations, in order of registration.
+  static vector<MemoryUsage> Collect();
+};
+
+// Heap allocations made on a thread, and by the process. They are counted
+// only where the global operator new is replaced to call Count(), as in the
+// allocation tests; the library does not replace it.
+struct RIME_API AllocationCounts {
+  uint64_t allocations = 0;
+  uint64_t bytes = 0;
+
+  // the counts of the calling thread.
+  static AllocationCounts& current();
+  // the counts of all threads, including the workers of the pools.
+  static AllocationCounts total();
+  static void Count(size_t size);
+};
+
+}  // namespace rime
+
+#endif  // RIME_MEMORY_STATS_H_
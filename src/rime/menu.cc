@@ -7,34 +7,113 @@
 #include <algorithm>
 #include <iterator>
 #include <rime/filter.h>
+#include <rime/hot_log.h>
 #include <rime/menu.h>
+#include <rime/perf_counters.h>
+#include <rime/trace.h>
 #include <rime/translation.h>
+#include <rime/worker_pool.h>
 
 namespace rime {
 
+// stands in for a released candidate, keeping what it shows and what it is
+// known by, but not the dictionary entries it was made of.
+class ReleasedCandidate : public SimpleCandidate {
+ public:
+  explicit ReleasedCandidate(const an<Candidate>& cand)
+      : SimpleCandidate(cand->type(),
+                        cand->start(),
+                        cand->end(),
+                        cand->text(),
+                        cand->comment(),
+                        cand->preedit()) {
+    set_quality(cand->quality());
+  }
+
+  bool Matches(const an<Candidate>& cand) const {
+    return cand && cand->type() == type() && cand->start() == start() &&
+           cand->end() == end() && cand->text() == text() &&
+           cand->comment() == comment();
+  }
+};
+
+static an<ReleasedCandidate> AsReleased(const an<Candidate>& cand) {
+  // the uniquifier may have merged others into a released candidate.
+  return As<ReleasedCandidate>(cand ? Candidate::GetGenuineCandidate(cand)
+                                    : cand);
+}
+
 Menu::Menu() : merged_(new MergedTranslation(candidates_)), result_(merged_) {}
 
+Menu::~Menu() {
+  CancelPrefetch();
+}
+
 void Menu::AddTranslation(an<Translation> translation) {
   *merged_ += translation;
-  DLOG(INFO) << merged_->size() << " translations added.";
+  RIME_HOT_LOG(Menu) << merged_->size() << " translations added.";
+}
+
+void Menu::set_dormancy_threshold(size_t candidate_count) {
+  merged_->set_dormancy_threshold(candidate_count);
 }
 
 void Menu::AddFilter(Filter* filter) {
+  if (auto transform = filter->GetCandidateTransform(&candidates_)) {
+    // joins the fused stage of the filters right before it.
+    if (!fused_ || result_ != fused_) {
+      fused_ = New<FusedFilterTranslation>(result_);
+      result_ = fused_;
+    }
+    fused_->AddTransform(std::move(transform));
+    return;
+  }
   result_ = filter->Apply(result_, &candidates_);
 }
 
 size_t Menu::Prepare(size_t requested) {
-  DLOG(INFO) << "preparing " << requested << " candidates.";
-  while (candidates_.size() < requested && !result_->exhausted()) {
-    if (auto cand = result_->Peek()) {
-      candidates_.push_back(cand);
+  RIME_HOT_LOG(Menu) << "preparing " << requested << " candidates.";
+  // candidates are pulled thru the filters here.
+  RIME_TRACE_SCOPE("menu", "prepare");
+  WaitForPrefetch();
+  return Fetch(requested);
+}
+
+size_t Menu::Fetch(size_t requested) {
+  size_t fetched = candidates_.size();
+  while (candidates_.size() < requested && !result_->exhausted() &&
+         !prefetch_cancelled_) {
+    if (result_->Fill(&candidates_, requested - candidates_.size()) == 0 &&
+        !result_->exhausted()) {
+      break;
     }
-    result_->Next();
   }
+  PerfCounters::Count(PerfCounters::kCandidatesMaterialized,
+                      candidates_.size() - fetched);
   return candidates_.size();
 }
 
+void Menu::Prefetch(size_t requested) {
+  if (candidates_.size() >= requested || result_->exhausted())
+    return;
+  RIME_HOT_LOG(Menu) << "prefetching " << requested << " candidates.";
+  prefetch_ =
+      WorkerPool::Shared().Submit([this, requested] { Fetch(requested); });
+}
+
+void Menu::WaitForPrefetch() const {
+  if (prefetch_.valid())
+    prefetch_.get();
+}
+
+void Menu::CancelPrefetch() {
+  prefetch_cancelled_ = true;
+  WaitForPrefetch();
+  prefetch_cancelled_ = false;
+}
+
 Page* Menu::CreatePage(size_t page_size, size_t page_no) {
+  WaitForPrefetch();
   size_t start_pos = page_size * page_no;
   size_t end_pos = start_pos + page_size;
   if (end_pos > candidates_.size()) {
@@ -46,6 +125,9 @@ Page* Menu::CreatePage(size_t page_size, size_t page_no) {
       return NULL;
     end_pos = (std::min)(start_pos + page_size, end_pos);
   }
+  if (start_pos < released_) {
+    Restore(start_pos, end_pos);
+  }
   Page* page = new Page;
   if (!page)
     return NULL;
@@ -54,17 +136,80 @@ Page* Menu::CreatePage(size_t page_size, size_t page_no) {
   page->is_last_page = result_->exhausted() && (end_pos == candidates_.size());
   std::copy(candidates_.begin() + start_pos, candidates_.begin() + end_pos,
             std::back_inserter(page->candidates));
+  PerfCounters::Count(PerfCounters::kCandidatesDisplayed,
+                      page->candidates.size());
+  Release(page_size, page_no);
+  if (prefetch_next_page_ && !page->is_last_page) {
+    Prefetch(end_pos + page_size);
+  }
   return page;
 }
 
 an<Candidate> Menu::GetCandidateAt(size_t index) {
+  WaitForPrefetch();
   if (index >= candidates_.size() && index >= Prepare(index + 1)) {
     return nullptr;
   }
+  if (index < released_ && AsReleased(candidates_[index])) {
+    Restore(index, index + 1);
+  }
   return candidates_[index];
 }
 
+size_t Menu::retained_count() const {
+  WaitForPrefetch();
+  return std::count_if(
+      candidates_.begin(), candidates_.end(),
+      [](const an<Candidate>& cand) { return !AsReleased(cand); });
+}
+
+void Menu::Release(size_t page_size, size_t page_no) {
+  if (retained_pages_ == 0 || !rebuild_ || page_no <= retained_pages_)
+    return;
+  size_t retained_begin = (page_no - retained_pages_) * page_size;
+  // also those made again for pages before, now behind the window.
+  for (size_t i = 0; i < retained_begin && i < candidates_.size(); ++i) {
+    if (!AsReleased(candidates_[i]))
+      candidates_[i] = New<ReleasedCandidate>(candidates_[i]);
+  }
+  released_ = (std::max)(released_, retained_begin);
+}
+
+void Menu::Restore(size_t begin, size_t end) {
+  if (!rebuild_)
+    return;
+  RIME_HOT_LOG(Menu) << "restoring candidates [" << begin << ", " << end
+                     << ").";
+  // translations only go forward; a new menu makes them all over again.
+  Menu menu;
+  rebuild_(&menu);
+  // with a page of slack, should others have come before them since.
+  size_t restored_count = menu.Prepare(end + (end - begin));
+  vector<bool> taken(restored_count);
+  for (size_t i = begin; i < end; ++i) {
+    auto released = AsReleased(candidates_[i]);
+    if (!released)
+      continue;
+    // the one at the same position, or else the first of the same identity.
+    size_t j = i;
+    if (j >= restored_count || taken[j] ||
+        !released->Matches(menu.candidates_[j])) {
+      for (j = 0; j < restored_count; ++j) {
+        if (!taken[j] && released->Matches(menu.candidates_[j]))
+          break;
+      }
+    }
+    // if the translations have changed, the stand-in is kept; it shows the
+    // same text, but is not learned by the user dictionary when committed.
+    if (j == restored_count)
+      continue;
+    taken[j] = true;
+    candidates_[i] = menu.candidates_[j];
+  }
+}
+
 bool Menu::empty() const {
+  WaitForPrefetch();
   return candidates_.empty() && result_->exhausted();
 }
 
@@ -7,6 +7,8 @@
 #ifndef RIME_MENU_H_
 #define RIME_MENU_H_
 
+#include <atomic>
+#include <future>
 #include <rime_api.h>
 #include <rime/candidate.h>
 #include <rime/common.h>
@@ -21,12 +23,14 @@ struct Page {
 };
 
 class Filter;
+class FusedFilterTranslation;
 class MergedTranslation;
 class Translation;
 
 class Menu {
  public:
   RIME_API Menu();
+  RIME_API ~Menu();
 
   RIME_API void AddTranslation(an<Translation> translation);
   void AddFilter(Filter* filter);
@@ -37,14 +41,56 @@ class Menu {
 
   // CAVEAT: returns the number of candidates currently obtained,
   // rather than the total number of available candidates.
-  size_t candidate_count() const { return candidates_.size(); }
+  // candidates released by the retention window are counted.
+  size_t candidate_count() const {
+    WaitForPrefetch();
+    return candidates_.size();
+  }
 
   bool empty() const;
 
+  // when enabled, candidates of the page following each created page are
+  // fetched on a worker thread. translations and filters of the menu must
+  // then be safe to run off the session's thread.
+  void set_prefetch_next_page(bool enabled) { prefetch_next_page_ = enabled; }
+  // stops fetching in the background; candidates already fetched are kept.
+  RIME_API void CancelPrefetch();
+  // translations that contribute nothing to the first `candidate_count`
+  // candidates are released; see MergedTranslation.
+  void set_dormancy_threshold(size_t candidate_count);
+  // candidates of more than this many pages before the page last created
+  // are released, and made again by a menu filled by rebuild when asked
+  // for, found by their type, range, text and comment. 0 (the default)
+  // keeps all candidates.
+  void set_retention(size_t retained_pages, function<void(Menu*)> rebuild) {
+    retained_pages_ = retained_pages;
+    rebuild_ = std::move(rebuild);
+  }
+  // number of candidates being held.
+  size_t retained_count() const;
+
  private:
+  size_t Fetch(size_t requested);
+  void Prefetch(size_t requested);
+  void WaitForPrefetch() const;
+  void Release(size_t page_size, size_t page_no);
+  // makes again the released candidates in [begin, end).
+  void Restore(size_t begin, size_t end);
+
   an<MergedTranslation> merged_;
   an<Translation> result_;
+  // the last stage of filters, if it is a fused one.
+  an<FusedFilterTranslation> fused_;
+  // released candidates are left as stand-ins of the same text, for the
+  // positions of the others and what filters see of them to stay the same.
   CandidateList candidates_;
+  // candidates before this position are released.
+  size_t released_ = 0;
+  size_t retained_pages_ = 0;
+  function<void(Menu*)> rebuild_;
+  bool prefetch_next_page_ = false;
+  std::atomic<bool> prefetch_cancelled_{false};
+  mutable std::future<void> prefetch_;
 };
 
 }  // namespace rime
@@ -16,10 +16,22 @@ class Messenger {
   using MessageSink =
       signal<void(const string& message_type, const string& message_value)>;
 
+  // delivers messages sent from other threads. it may be called after the
+  // messenger is gone, so it does not refer to it.
+  using AsyncMessageSink =
+      function<void(const string& message_type, const string& message_value)>;
+
   MessageSink& message_sink() { return message_sink_; }
+  const AsyncMessageSink& async_message_sink() const {
+    return async_message_sink_;
+  }
+  void set_async_message_sink(AsyncMessageSink sink) {
+    async_message_sink_ = std::move(sink);
+  }
 
  protected:
   MessageSink message_sink_;
+  AsyncMessageSink async_message_sink_;
 };
 
 }  // namespace rime
@@ -5,16 +5,20 @@
 // 2013-10-17 GONG Chen <chen.sst@gmail.com>
 //
 
+#include <future>
 #include <rime/module.h>
+#include <rime/registry.h>
 #include <rime_api.h>
 
 namespace rime {
 
 void ModuleManager::Register(const string& name, RimeModule* module) {
+  std::lock_guard<std::mutex> lock(mutex_);
   map_[name] = module;
 }
 
 RimeModule* ModuleManager::Find(const string& name) {
+  std::lock_guard<std::mutex> lock(mutex_);
   ModuleMap::const_iterator it = map_.find(name);
   if (it != map_.end()) {
     return it->second;
@@ -23,26 +27,134 @@ RimeModule* ModuleManager::Find(const string& name) {
 }
 
 void ModuleManager::LoadModule(RimeModule* module) {
+  std::unique_lock<std::mutex> lock(mutex_);
   if (!module || loaded_.find(module) != loaded_.end()) {
     return;
   }
+  auto loading = loading_.find(module);
+  if (loading != loading_.end()) {
+    // a module loading itself as it is initialized is taken as loaded.
+    if (loading->second != std::this_thread::get_id()) {
+      module_loaded_.wait(
+          lock, [this, module] { return loaded_.count(module) != 0; });
+    }
+    return;
+  }
   DLOG(INFO) << "loading module: " << module->module_name;
-  loaded_.insert(module);
+  loading_[module] = std::this_thread::get_id();
+  lock.unlock();
   if (module->initialize != NULL) {
     module->initialize();
   } else {
     LOG(WARNING) << "missing initialize() function in module: "
                  << module->module_name;
   }
+  lock.lock();
+  loading_.erase(module);
+  loaded_.insert(module);
+  module_loaded_.notify_all();
+}
+
+void ModuleManager::LoadModules(const vector<RimeModule*>& modules) {
+  // modules being initialized on other threads, by name
+  map<string, std::shared_future<void>> started;
+  auto wait_for_started = [&started] {
+    for (auto& x : started) {
+      x.second.get();
+    }
+    started.clear();
+  };
+  for (RimeModule* module : modules) {
+    if (!module) {
+      continue;
+    }
+    if (!RIME_PROVIDED(module, dependencies)) {
+      wait_for_started();
+      LoadModule(module);
+      continue;
+    }
+    vector<std::shared_future<void>> prerequisites;
+    for (const char** d = module->dependencies; *d; ++d) {
+      auto dependency = started.find(*d);
+      if (dependency != started.end()) {
+        prerequisites.push_back(dependency->second);
+      } else {
+        LoadModule(Find(*d));
+      }
+    }
+    started[module->module_name] =
+        std::async(std::launch::async, [this, module, prerequisites] {
+          for (const auto& prerequisite : prerequisites) {
+            prerequisite.wait();
+          }
+          LoadModule(module);
+        }).share();
+  }
+  wait_for_started();
 }
 
 void ModuleManager::UnloadModules() {
-  for (auto module : loaded_) {
+  std::unordered_set<RimeModule*> loaded;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    providers_.clear();
+    pending_.clear();
+    loaded.swap(loaded_);
+  }
+  for (auto module : loaded) {
     if (module->finalize != NULL) {
       module->finalize();
     }
   }
-  loaded_.clear();
+}
+
+void ModuleManager::LoadOnDemand(const string& module_name,
+                                 const vector<string>& components,
+                                 function<void()> load) {
+  if (!load) {
+    load = [this, module_name] { LoadModule(Find(module_name)); };
+  }
+  for (const auto& component : components) {
+    if (Registry::instance().Find(component)) {
+      DLOG(INFO) << "module '" << module_name << "' replaces component: "
+                 << component;
+      load();
+      return;
+    }
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  DLOG(INFO) << "module to be loaded on demand: " << module_name;
+  for (const auto& component : components) {
+    providers_[component] = module_name;
+  }
+  pending_[module_name] = std::move(load);
+}
+
+bool ModuleManager::LoadModuleProviding(const string& component) {
+  function<void()> load;
+  string module_name;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto provider = providers_.find(component);
+    if (provider == providers_.end()) {
+      return false;
+    }
+    module_name = provider->second;
+    auto pending = pending_.find(module_name);
+    if (pending != pending_.end()) {
+      load = std::move(pending->second);
+      pending_.erase(pending);
+    }
+  }
+  if (load) {
+    LOG(INFO) << "loading module '" << module_name
+              << "' on demand for component: " << component;
+    load();
+  } else {
+    // waits for the module if it is being loaded by another thread.
+    LoadModule(Find(module_name));
+  }
+  return true;
 }
 
 ModuleManager& ModuleManager::instance() {
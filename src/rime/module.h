@@ -7,6 +7,9 @@
 #ifndef RIME_MODULE_H_
 #define RIME_MODULE_H_
 
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include <unordered_set>
 #include <rime/common.h>
 
@@ -21,9 +24,26 @@ class ModuleManager {
   void Register(const string& name, RimeModule* module);
   RimeModule* Find(const string& name);
 
+  // returns once the module is loaded, if by another thread.
   void LoadModule(RimeModule* module);
+  // loads the modules in order, except that those declaring their
+  // dependencies are initialized in parallel on threads of their own, each
+  // as soon as the modules it depends on are loaded. modules that declare
+  // none may depend on any module before them.
+  void LoadModules(const vector<RimeModule*>& modules);
   void UnloadModules();
 
+  // defers loading the module until one of its components is looked up.
+  // the module is loaded by the given function, or else the one registered
+  // under the name. it is loaded right away if it is to replace a component
+  // already registered.
+  void LoadOnDemand(const string& module_name,
+                    const vector<string>& components,
+                    function<void()> load = nullptr);
+  // loads the module providing the component, if any. returns whether the
+  // component is provided by a module loaded on demand.
+  bool LoadModuleProviding(const string& component);
+
   static ModuleManager& instance();
 
  private:
@@ -34,6 +54,17 @@ class ModuleManager {
   ModuleMap map_;
   // set of loaded modules
   std::unordered_set<RimeModule*> loaded_;
+  // modules being initialized, by the threads initializing them
+  map<RimeModule*, std::thread::id> loading_;
+  std::condition_variable module_loaded_;
+  // names of modules loaded on demand, by the components they provide
+  map<string, string> providers_;
+  // how to load each of the modules yet to be loaded on demand
+  map<string, function<void()>> pending_;
+  // modules are loaded on demand by threads of sessions, and in parallel at
+  // startup. not held while a module is initialized, which may load other
+  // modules.
+  std::mutex mutex_;
 };
 
 }  // namespace rime
@@ -0,0 +1,35 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <rime/perf_counters.h>
+
+namespace rime {
+
+static thread_local PerfCounters* current_counters = nullptr;
+
+void PerfCounters::Reset() {
+  for (auto& value : values_) {
+    value.store(0, std::memory_order_relaxed);
+  }
+}
+
+PerfCounters& PerfCounters::Global() {
+  static PerfCounters global;
+  return global;
+}
+
+PerfCounters* PerfCounters::current() {
+  return current_counters;
+}
+
+PerfCounters::Activation::Activation(PerfCounters* counters)
+    : previous_(current_counters) {
+  current_counters = counters;
+}
+
+PerfCounters::Activation::~Activation() {
+  current_counters = previous_;
+}
+
+}  // namespace rime
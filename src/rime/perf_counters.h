@@ -0,0 +1,72 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#ifndef RIME_PERF_COUNTERS_H_
+#define RIME_PERF_COUNTERS_H_
+
+#include <stdint.h>
+#include <array>
+#include <atomic>
+#include <rime_api.h>
+#include <rime/common.h>
+
+namespace rime {
+
+// Counts the work done by the engine, cheap enough to be always on.
+// Counts go to the counters of the session served on the calling thread,
+// if any, and to the global counters of the service.
+class RIME_API PerfCounters {
+ public:
+  enum Counter {
+    kDictionaryLookups,
+    kTableChunksScanned,
+    kUserDbSeeks,
+    kGrammarQueries,
+    kCandidatesMaterialized,
+    kCandidatesDisplayed,
+    kBytesAllocated,
+    kUserDictLookupsPruned,
+    kNumCounters,
+  };
+
+  PerfCounters() { Reset(); }
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  uint64_t get(Counter counter) const {
+    return values_[counter].load(std::memory_order_relaxed);
+  }
+  void Add(Counter counter, uint64_t n) {
+    values_[counter].fetch_add(n, std::memory_order_relaxed);
+  }
+  void Reset();
+
+  // the counters of the whole service.
+  static PerfCounters& Global();
+  // the counters of the session served on the calling thread, or null.
+  static PerfCounters* current();
+
+  static void Count(Counter counter, uint64_t n = 1) {
+    Global().Add(counter, n);
+    if (auto* counters = current())
+      counters->Add(counter, n);
+  }
+
+  // makes the counters current on the calling thread within its scope.
+  class Activation {
+   public:
+    explicit Activation(PerfCounters* counters);
+    ~Activation();
+
+   private:
+    PerfCounters* previous_;
+  };
+
+ private:
+  std::array<std::atomic<uint64_t>, kNumCounters> values_;
+};
+
+}  // namespace rime
+
+#endif  // RIME_PERF_COUNTERS_H_
@@ -21,6 +21,17 @@ enum ProcessResult {
   kNoop,      // leave it to other processors
 };
 
+// states of the context in which a processor handles keys; the engine
+// does not pass keys to processors that have no interest in the current
+// state, as they would be left to other processors anyway.
+enum ProcessingState {
+  kIdle = 1 << 0,
+  kComposing = 1 << 1,
+  kIdleInAsciiMode = 1 << 2,
+  kComposingInAsciiMode = 1 << 3,
+  kAnyState = kIdle | kComposing | kIdleInAsciiMode | kComposingInAsciiMode,
+};
+
 class Processor : public Class<Processor, const Ticket&> {
  public:
   explicit Processor(const Ticket& ticket)
@@ -32,10 +43,13 @@ class Processor : public Class<Processor, const Ticket&> {
   }
 
   string name_space() const { return name_space_; }
+  // a combination of ProcessingState.
+  int interests() const { return interests_; }
 
  protected:
   Engine* engine_;
   string name_space_;
+  int interests_ = kAnyState;
 };
 
 }  // namespace rime
@@ -4,23 +4,28 @@
 //
 // 2011-03-14 GONG Chen <chen.sst@gmail.com>
 //
+#include <mutex>
 #include <rime/common.h>
 #include <rime/component.h>
+#include <rime/module.h>
 #include <rime/registry.h>
 
 namespace rime {
 
 void Registry::Register(const string& name, ComponentBase* component) {
   LOG(INFO) << "registering component: " << name;
-  if (ComponentBase* existing = Find(name)) {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  auto& registered = map_[name];
+  if (registered) {
     LOG(WARNING) << "replacing previously registered component: " << name;
-    delete existing;
+    delete registered;
   }
-  map_[name] = component;
+  registered = component;
 }
 
 void Registry::Unregister(const string& name) {
   LOG(INFO) << "unregistering component: " << name;
+  std::unique_lock<std::shared_mutex> lock(mutex_);
   ComponentMap::iterator it = map_.find(name);
   if (it == map_.end())
     return;
@@ -29,6 +34,7 @@ void Registry::Unregister(const string& name) {
 }
 
 void Registry::Clear() {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
   ComponentMap::iterator it = map_.begin();
   while (it != map_.end()) {
     delete it->second;
@@ -37,6 +43,18 @@ void Registry::Clear() {
 }
 
 ComponentBase* Registry::Find(const string& name) {
+  if (auto component = FindRegistered(name)) {
+    return component;
+  }
+  // the component may be provided by a module that is not yet loaded.
+  if (ModuleManager::instance().LoadModuleProviding(name)) {
+    return FindRegistered(name);
+  }
+  return NULL;
+}
+
+ComponentBase* Registry::FindRegistered(const string& name) {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
   ComponentMap::const_iterator it = map_.find(name);
   if (it != map_.end()) {
     return it->second;
@@ -7,6 +7,7 @@
 #ifndef RIME_REGISTRY_H_
 #define RIME_REGISTRY_H_
 
+#include <shared_mutex>
 #include <rime_api.h>
 #include <rime/common.h>
 
@@ -27,7 +28,10 @@ class Registry {
 
  private:
   Registry() = default;
+  ComponentBase* FindRegistered(const string& name);
 
+  // components are looked up by sessions on different threads.
+  std::shared_mutex mutex_;
   ComponentMap map_;
 };
 
@@ -31,11 +31,71 @@ path ResourceResolver::ResolvePath(const string& resource_id) {
                                    (type_.prefix + resource_id + type_.suffix));
 }
 
+std::atomic<uint64_t> FallbackResourceResolver::current_generation_ = 0;
+
+static std::mutex snapshot_mutex;
+static path snapshot_root_path;
+static path snapshot_path;
+static thread_local bool deploying_thread = false;
+
+void FallbackResourceResolver::InvalidateCache() {
+  ++current_generation_;
+}
+
+void FallbackResourceResolver::ServeSnapshot(const path& root_path,
+                                             const path& snapshot) {
+  {
+    std::lock_guard<std::mutex> lock(snapshot_mutex);
+    snapshot_root_path = root_path;
+    snapshot_path = snapshot;
+  }
+  InvalidateCache();
+}
+
+bool FallbackResourceResolver::deploying() {
+  return deploying_thread;
+}
+
+FallbackResourceResolver::Deploying::Deploying(bool deploying)
+    : previous_(deploying_thread) {
+  deploying_thread = deploying;
+}
+
+FallbackResourceResolver::Deploying::~Deploying() {
+  deploying_thread = previous_;
+}
+
 path FallbackResourceResolver::ResolvePath(const string& resource_id) {
-  auto default_path = ResourceResolver::ResolvePath(resource_id);
+  path root_path = root_path_;
+  bool in_snapshot = false;
+  if (!deploying_thread) {
+    std::lock_guard<std::mutex> lock(snapshot_mutex);
+    in_snapshot = !snapshot_path.empty() && root_path_ == snapshot_root_path;
+    if (in_snapshot)
+      root_path = snapshot_path;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  uint64_t generation = current_generation_;
+  if (generation_ != generation) {
+    resolved_paths_.clear();
+    snapshot_paths_.clear();
+    generation_ = generation;
+  }
+  auto& resolved = in_snapshot ? snapshot_paths_ : resolved_paths_;
+  auto found = resolved.find(resource_id);
+  if (found != resolved.end()) {
+    return found->second;
+  }
+  return resolved[resource_id] = Resolve(root_path, resource_id);
+}
+
+path FallbackResourceResolver::Resolve(const path& root_path,
+                                       const string& resource_id) {
+  auto file_name = type_.prefix + resource_id + type_.suffix;
+  auto default_path = std::filesystem::absolute(root_path / file_name);
   if (!std::filesystem::exists(default_path)) {
-    auto fallback_path = std::filesystem::absolute(
-        fallback_root_path_ / (type_.prefix + resource_id + type_.suffix));
+    auto fallback_path =
+        std::filesystem::absolute(fallback_root_path_ / file_name);
     if (std::filesystem::exists(fallback_path)) {
       return fallback_path;
     }
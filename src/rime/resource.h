@@ -6,6 +6,8 @@
 #ifndef RIME_RESOURCE_H_
 #define RIME_RESOURCE_H_
 
+#include <atomic>
+#include <mutex>
 #include <rime_api.h>
 #include <rime/common.h>
 
@@ -35,17 +37,54 @@ class RIME_API ResourceResolver {
 };
 
 // try fallback path if target file doesn't exist in root path
+//
+// resolved paths are remembered, saving the file system lookups when the
+// same resources are required again, eg. as sessions apply schemas; they
+// are forgotten by InvalidateCache() when files are deployed.
 class RIME_API FallbackResourceResolver : public ResourceResolver {
  public:
   explicit FallbackResourceResolver(const ResourceType& type)
       : ResourceResolver(type) {}
   path ResolvePath(const string& resource_id) override;
   void set_fallback_root_path(path fallback_root_path) {
+    std::lock_guard<std::mutex> lock(mutex_);
     fallback_root_path_ = fallback_root_path;
+    resolved_paths_.clear();
   }
 
+  // forgets the paths resolved by all resolvers.
+  static void InvalidateCache();
+
+  // while a deployment replaces the files under the root path, the files of
+  // the previous build are found in the snapshot path instead, but by the
+  // threads deploying. an empty snapshot path to find the new files.
+  static void ServeSnapshot(const path& root_path, const path& snapshot_path);
+
+  // whether the calling thread is deploying files, seeing them as they are
+  // written rather than the snapshot served to others.
+  static bool deploying();
+
+  // makes the calling thread deploying, or not, within its scope.
+  class Deploying {
+   public:
+    explicit Deploying(bool deploying = true);
+    ~Deploying();
+
+   private:
+    bool previous_;
+  };
+
  private:
+  path Resolve(const path& root_path, const string& resource_id);
+
   path fallback_root_path_;
+  std::mutex mutex_;
+  hash_map<string, path> resolved_paths_;
+  // paths resolved in the snapshot.
+  hash_map<string, path> snapshot_paths_;
+  // the resolved paths are valid as long as it is the current generation.
+  uint64_t generation_ = 0;
+  static std::atomic<uint64_t> current_generation_;
 };
 
 }  // namespace rime
@@ -35,6 +35,28 @@ void Schema::FetchUsefulConfigItems() {
   }
   config_->GetString("menu/alternative_select_keys", &select_keys_);
   config_->GetBool("menu/page_down_cycle", &page_down_cycle_);
+  config_->GetBool("menu/prefetch_next_page", &prefetch_next_page_);
+  config_->GetInt("menu/max_pages", &max_pages_);
+  if (max_pages_ < 0) {
+    max_pages_ = 0;
+  }
+  config_->GetInt("menu/retained_pages", &retained_pages_);
+  if (retained_pages_ < 0) {
+    retained_pages_ = 0;
+  }
+  config_->GetBool("engine/deferred_translation", &deferred_translation_);
+  config_->GetInt("engine/latency_budget", &latency_budget_);
+  if (latency_budget_ < 0) {
+    latency_budget_ = 0;
+  }
+}
+
+const SwitchIndex& Schema::switch_index() const {
+  // status bars may query the labels from other threads.
+  std::call_once(switch_index_compiled_, [this] {
+    switch_index_.reset(new SwitchIndex(config_.get()));
+  });
+  return *switch_index_;
 }
 
 Config* SchemaComponent::Create(const string& schema_id) {
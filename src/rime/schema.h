@@ -7,8 +7,10 @@
 #ifndef RIME_SCHEMA_H_
 #define RIME_SCHEMA_H_
 
+#include <mutex>
 #include <rime/common.h>
 #include <rime/config.h>  // for convenience
+#include <rime/switches.h>
 
 namespace rime {
 
@@ -27,8 +29,22 @@ class Schema {
 
   int page_size() const { return page_size_; }
   bool page_down_cycle() const { return page_down_cycle_; }
+  bool prefetch_next_page() const { return prefetch_next_page_; }
+  // number of pages users are expected to browse; 0 for no limit.
+  int max_pages() const { return max_pages_; }
+  // pages of candidates kept before the page shown, the others being made
+  // again when paged back to; 0 keeps all of them.
+  int retained_pages() const { return retained_pages_; }
+  // segments are translated when the candidates are needed, rather than as
+  // soon as the input is segmented.
+  bool deferred_translation() const { return deferred_translation_; }
+  // milliseconds a key stroke is expected to be composed in, after which
+  // expensive stages are skipped; 0 for no limit.
+  int latency_budget() const { return latency_budget_; }
   const string& select_keys() const { return select_keys_; }
   void set_select_keys(const string& keys) { select_keys_ = keys; }
+  // the switches of the schema, compiled when first needed.
+  const SwitchIndex& switch_index() const;
 
  private:
   void FetchUsefulConfigItems();
@@ -39,7 +55,14 @@ class Schema {
   // frequently used config items
   int page_size_ = 5;
   bool page_down_cycle_ = false;
+  bool prefetch_next_page_ = false;
+  int max_pages_ = 0;
+  int retained_pages_ = 0;
+  bool deferred_translation_ = false;
+  int latency_budget_ = 0;
   string select_keys_;
+  mutable std::once_flag switch_index_compiled_;
+  mutable the<SwitchIndex> switch_index_;
 };
 
 class SchemaComponent : public Config::Component {
@@ -0,0 +1,135 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <filesystem>
+#include <mutex>
+#include <rime/resource.h>
+#include <rime/schema.h>
+#include <rime/schema_index.h>
+#include <rime/service.h>
+#include <rime/switches.h>
+
+namespace rime {
+
+const char* const SchemaIndex::kFileName = "schema_index.yaml";
+
+static const ResourceType kSchemaIndexResourceType = {"schema_index", "",
+                                                      ".yaml"};
+
+an<SchemaIndex> SchemaIndex::Get() {
+  static std::mutex mutex;
+  static path loaded_path;
+  static std::filesystem::file_time_type loaded_time;
+  static an<SchemaIndex> loaded;
+  the<ResourceResolver> resolver(
+      Service::instance().CreateDeployedResourceResolver(
+          kSchemaIndexResourceType));
+  path file_path = resolver->ResolvePath("schema_index");
+  std::error_code ec;
+  auto file_time = std::filesystem::last_write_time(file_path, ec);
+  std::lock_guard<std::mutex> lock(mutex);
+  if (ec) {
+    loaded.reset();
+    return nullptr;
+  }
+  // the index is read again only when it has been deployed again.
+  if (!loaded || file_path != loaded_path || file_time != loaded_time) {
+    auto index = New<SchemaIndex>();
+    loaded = index->Load(file_path) ? index : nullptr;
+    loaded_path = file_path;
+    loaded_time = file_time;
+  }
+  return loaded;
+}
+
+SchemaIndex SchemaIndex::Build(const vector<string>& schema_ids) {
+  SchemaIndex index;
+  for (const auto& schema_id : schema_ids) {
+    if (index.by_id_.count(schema_id))
+      continue;
+    Schema schema(schema_id);
+    Config* config = schema.config();
+    if (!config)
+      continue;
+    SchemaInfo info;
+    info.schema_id = schema_id;
+    info.name = schema.schema_name();
+    config->GetString("schema/version", &info.version);
+    config->GetString("schema/icon", &info.icon);
+    Switches switches(config);
+    switches.FindOption([&info](Switches::SwitchOption option) {
+      if (!option.option_name.empty())
+        info.switches.push_back(option.option_name);
+      return Switches::kContinue;
+    });
+    index.by_id_[schema_id] = index.schemas_.size();
+    index.schemas_.push_back(std::move(info));
+  }
+  return index;
+}
+
+bool SchemaIndex::Load(const path& file_path) {
+  Config config;
+  if (!config.LoadFromFile(file_path))
+    return false;
+  auto list = config.GetList("schemas");
+  if (!list)
+    return false;
+  schemas_.clear();
+  by_id_.clear();
+  for (auto it = list->begin(); it != list->end(); ++it) {
+    auto item = As<ConfigMap>(*it);
+    if (!item)
+      continue;
+    SchemaInfo info;
+    auto get = [&item](const string& key, string* value) {
+      if (auto x = item->GetValue(key))
+        *value = x->str();
+    };
+    get("schema_id", &info.schema_id);
+    if (info.schema_id.empty())
+      continue;
+    get("name", &info.name);
+    get("version", &info.version);
+    get("icon", &info.icon);
+    if (auto switches = As<ConfigList>(item->Get("switches"))) {
+      for (auto s = switches->begin(); s != switches->end(); ++s) {
+        if (auto option = As<ConfigValue>(*s))
+          info.switches.push_back(option->str());
+      }
+    }
+    by_id_[info.schema_id] = schemas_.size();
+    schemas_.push_back(std::move(info));
+  }
+  return true;
+}
+
+bool SchemaIndex::Save(const path& file_path) const {
+  auto list = New<ConfigList>();
+  for (const auto& info : schemas_) {
+    auto item = New<ConfigMap>();
+    item->Set("schema_id", New<ConfigValue>(info.schema_id));
+    item->Set("name", New<ConfigValue>(info.name));
+    if (!info.version.empty())
+      item->Set("version", New<ConfigValue>(info.version));
+    if (!info.icon.empty())
+      item->Set("icon", New<ConfigValue>(info.icon));
+    auto switches = New<ConfigList>();
+    for (const auto& option : info.switches) {
+      switches->Append(New<ConfigValue>(option));
+    }
+    item->Set("switches", switches);
+    list->Append(item);
+  }
+  Config config;
+  config.SetItem("schemas", list);
+  return config.SaveToFile(file_path);
+}
+
+const SchemaInfo* SchemaIndex::Find(const string& schema_id) const {
+  auto it = by_id_.find(schema_id);
+  return it != by_id_.end() ? &schemas_[it->second] : nullptr;
+}
+
+}  // namespace rime
@@ -0,0 +1,51 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#ifndef RIME_SCHEMA_INDEX_H_
+#define RIME_SCHEMA_INDEX_H_
+
+#include <rime_api.h>
+#include <rime/common.h>
+
+namespace rime {
+
+// What the schema list and the switcher menu show of a schema.
+struct SchemaInfo {
+  string schema_id;
+  string name;
+  string version;
+  string icon;
+  // names of the options switched in the schema.
+  vector<string> switches;
+};
+
+// A summary of the deployed schemas, written by the deployer so that the
+// schema list is read in one go rather than by opening each schema.
+class SchemaIndex {
+ public:
+  SchemaIndex() = default;
+
+  // the index of the deployed schemas, shared until it is deployed again;
+  // nullptr if there is none, in which case callers open the schemas.
+  RIME_API static an<SchemaIndex> Get();
+
+  // summarizes the schemas by their deployed configs.
+  RIME_API static SchemaIndex Build(const vector<string>& schema_ids);
+  RIME_API bool Load(const path& file_path);
+  RIME_API bool Save(const path& file_path) const;
+
+  // nullptr if the schema was not deployed along with the index.
+  RIME_API const SchemaInfo* Find(const string& schema_id) const;
+  const vector<SchemaInfo>& schemas() const { return schemas_; }
+
+  static const char* const kFileName;
+
+ private:
+  vector<SchemaInfo> schemas_;
+  map<string, size_t> by_id_;
+};
+
+}  // namespace rime
+
+#endif  // RIME_SCHEMA_INDEX_H_
@@ -5,21 +5,154 @@
 // 2011-05-15 GONG Chen <chen.sst@gmail.com>
 //
 #include <algorithm>
-#include <iterator>
+#include <bitset>
 #include <ostream>
+#include <shared_mutex>
 #include <rime/menu.h>
 #include <rime/segmentation.h>
 
 namespace rime {
 
-static const char* kPartialSelectionTag = "partial";
+static const SegmentTags::TagId kPartialSelectionTag =
+    SegmentTags::Intern("partial");
+
+namespace {
+
+struct TagNames {
+  std::shared_mutex mutex;
+  hash_map<string, SegmentTags::TagId> ids;
+  vector<string> names;
+};
+
+}  // namespace
+
+static TagNames& tag_names() {
+  // never destroyed, as segments held by static objects may outlive it.
+  static TagNames* names = new TagNames;
+  return *names;
+}
+
+SegmentTags::TagId SegmentTags::Intern(const string& name) {
+  TagId id;
+  if (Find(name, &id))
+    return id;
+  TagNames& names(tag_names());
+  std::unique_lock<std::shared_mutex> lock(names.mutex);
+  auto inserted = names.ids.emplace(name, TagId(names.names.size()));
+  if (inserted.second)
+    names.names.push_back(name);
+  return inserted.first->second;
+}
+
+bool SegmentTags::Find(const string& name, TagId* id) {
+  TagNames& names(tag_names());
+  std::shared_lock<std::shared_mutex> lock(names.mutex);
+  auto found = names.ids.find(name);
+  if (found == names.ids.end())
+    return false;
+  *id = found->second;
+  return true;
+}
+
+string SegmentTags::NameOf(TagId id) {
+  TagNames& names(tag_names());
+  std::shared_lock<std::shared_mutex> lock(names.mutex);
+  return id < names.names.size() ? names.names[id] : string();
+}
+
+SegmentTags::SegmentTags(const vector<string>& names) {
+  for (const string& name : names) {
+    insert(name);
+  }
+}
+
+bool SegmentTags::HasAnyOf(const SegmentTags& other) const {
+  if (bits_ & other.bits_)
+    return true;
+  size_t words = (std::min)(more_bits_.size(), other.more_bits_.size());
+  for (size_t i = 0; i < words; ++i) {
+    if (more_bits_[i] & other.more_bits_[i])
+      return true;
+  }
+  return false;
+}
+
+void SegmentTags::Add(TagId id) {
+  if (id < kInlineTags) {
+    bits_ |= uint64_t(1) << id;
+    return;
+  }
+  size_t word = id / kInlineTags - 1;
+  if (word >= more_bits_.size())
+    more_bits_.resize(word + 1);
+  more_bits_[word] |= uint64_t(1) << (id % kInlineTags);
+}
+
+void SegmentTags::Remove(TagId id) {
+  if (id < kInlineTags) {
+    bits_ &= ~(uint64_t(1) << id);
+    return;
+  }
+  size_t word = id / kInlineTags - 1;
+  if (word >= more_bits_.size())
+    return;
+  more_bits_[word] &= ~(uint64_t(1) << (id % kInlineTags));
+  while (!more_bits_.empty() && !more_bits_.back())
+    more_bits_.pop_back();
+}
+
+SegmentTags& SegmentTags::operator|=(const SegmentTags& other) {
+  bits_ |= other.bits_;
+  if (more_bits_.size() < other.more_bits_.size())
+    more_bits_.resize(other.more_bits_.size());
+  for (size_t i = 0; i < other.more_bits_.size(); ++i) {
+    more_bits_[i] |= other.more_bits_[i];
+  }
+  return *this;
+}
+
+bool SegmentTags::operator==(const SegmentTags& other) const {
+  return bits_ == other.bits_ && more_bits_ == other.more_bits_;
+}
+
+set<string> SegmentTags::names() const {
+  return set<string>(begin(), end());
+}
+
+SegmentTags::const_iterator SegmentTags::find(const string& name) const {
+  TagId id;
+  if (!Find(name, &id) || !Has(id))
+    return end();
+  return const_iterator(this, id);
+}
+
+size_t SegmentTags::erase(const string& name) {
+  TagId id;
+  if (!Find(name, &id) || !Has(id))
+    return 0;
+  Remove(id);
+  return 1;
+}
+
+bool SegmentTags::empty() const {
+  // there are no trailing zero words
+  return !bits_ && more_bits_.empty();
+}
+
+size_t SegmentTags::size() const {
+  size_t size = std::bitset<64>(bits_).count();
+  for (uint64_t word : more_bits_) {
+    size += std::bitset<64>(word).count();
+  }
+  return size;
+}
 
 void Segment::Close() {
   auto cand = GetSelectedCandidate();
   if (cand && cand->end() < end) {
     // having selected a partially matched candidate, split it into 2 segments
     end = cand->end();
-    tags.insert(kPartialSelectionTag);
+    tags.Add(kPartialSelectionTag);
   }
 }
 
@@ -33,7 +166,7 @@ bool Segment::Reopen(size_t caret_pos) {
     if (end < original_end_pos) {
       // restore partial-selected segment
       end = original_end_pos;
-      tags.erase(kPartialSelectionTag);
+      tags.Remove(kPartialSelectionTag);
     }
     status = kGuess;
   } else {
@@ -102,10 +235,7 @@ bool Segmentation::AddSegment(Segment segment) {
     last = segment;
   } else {
     // rule three: with segments equal in length, merge their tags
-    set<string> result;
-    set_union(last.tags.begin(), last.tags.end(), segment.tags.begin(),
-              segment.tags.end(), std::inserter(result, result.begin()));
-    last.tags.swap(result);
+    last.tags |= segment.tags;
   }
   return true;
 }
@@ -160,7 +290,7 @@ std::ostream& operator<<(std::ostream& out, const Segmentation& segmentation) {
     if (!segment.tags.empty()) {
       out << "{";
       bool first = true;
-      for (const string& tag : segment.tags) {
+      for (const string& tag : segment.tags.names()) {
         if (first)
           first = false;
         else
@@ -7,6 +7,9 @@
 #ifndef RIME_SEGMENTATION_H_
 #define RIME_SEGMENTATION_H_
 
+#include <stddef.h>
+#include <stdint.h>
+#include <iterator>
 #include <rime_api.h>
 #include <rime/common.h>
 
@@ -15,6 +18,110 @@ namespace rime {
 class Candidate;
 class Menu;
 
+// The tags of a segment, as a set of tag names interned into small ids.
+// Names are interned once for the process, their ids shared by all schemas;
+// the first kInlineTags of them are kept in the bits of a word, so the tags
+// are copied without allocating and matched by a bitwise AND.
+// Components intern the names they check once, and test the ids after.
+class RIME_API SegmentTags {
+ public:
+  using TagId = uint32_t;
+  static const TagId kInlineTags = 64;
+
+  // iterates over the names of the tags, in the order they were interned.
+  class const_iterator {
+   public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = string;
+    using difference_type = ptrdiff_t;
+    using pointer = void;
+    using reference = string;
+
+    const_iterator(const SegmentTags* tags, TagId id) : tags_(tags), id_(id) {
+      SkipAbsent();
+    }
+    string operator*() const { return NameOf(id_); }
+    const_iterator& operator++() {
+      ++id_;
+      SkipAbsent();
+      return *this;
+    }
+    const_iterator operator++(int) {
+      const_iterator previous(*this);
+      ++*this;
+      return previous;
+    }
+    bool operator==(const const_iterator& other) const {
+      return id_ == other.id_;
+    }
+    bool operator!=(const const_iterator& other) const {
+      return id_ != other.id_;
+    }
+
+   private:
+    void SkipAbsent() {
+      while (id_ < tags_->end_id() && !tags_->Has(id_))
+        ++id_;
+    }
+
+    const SegmentTags* tags_;
+    TagId id_;
+  };
+  using iterator = const_iterator;
+
+  static TagId Intern(const string& name);
+  // returns false if the name was never interned, so no segment has it.
+  static bool Find(const string& name, TagId* id);
+  static string NameOf(TagId id);
+
+  SegmentTags() = default;
+  // interns the names.
+  explicit SegmentTags(const vector<string>& names);
+
+  bool Has(TagId id) const {
+    if (id < kInlineTags)
+      return (bits_ >> id) & 1;
+    size_t word = id / kInlineTags - 1;
+    return word < more_bits_.size() &&
+           (more_bits_[word] >> (id % kInlineTags)) & 1;
+  }
+  bool HasAnyOf(const SegmentTags& other) const;
+  void Add(TagId id);
+  void Remove(TagId id);
+  SegmentTags& operator|=(const SegmentTags& other);
+  bool operator==(const SegmentTags& other) const;
+  bool operator!=(const SegmentTags& other) const { return !(*this == other); }
+
+  // the names in alphabetical order.
+  set<string> names() const;
+
+  // compatible with the set of names the tags used to be.
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, end_id()); }
+  const_iterator find(const string& name) const;
+  void insert(const string& name) { Add(Intern(name)); }
+  size_t erase(const string& name);
+  size_t count(const string& name) const {
+    TagId id;
+    return Find(name, &id) && Has(id) ? 1 : 0;
+  }
+  bool empty() const;
+  size_t size() const;
+  void clear() {
+    bits_ = 0;
+    more_bits_.clear();
+  }
+
+ private:
+  TagId end_id() const {
+    return kInlineTags * static_cast<TagId>(more_bits_.size() + 1);
+  }
+
+  uint64_t bits_ = 0;
+  // tags of ids from kInlineTags on, with no trailing zero words.
+  vector<uint64_t> more_bits_;
+};
+
 struct Segment {
   enum Status {
     kVoid,
@@ -26,7 +133,7 @@ struct Segment {
   size_t start = 0;
   size_t end = 0;
   size_t length = 0;
-  set<string> tags;
+  SegmentTags tags;
   an<Menu> menu;
   size_t selected_index = 0;
   string prompt;
@@ -47,11 +154,15 @@ struct Segment {
   void Close();
   bool Reopen(size_t caret_pos);
 
-  bool HasTag(const string& tag) const { return tags.find(tag) != tags.end(); }
+  bool HasTag(SegmentTags::TagId tag) const { return tags.Has(tag); }
+  bool HasTag(const string& tag) const { return tags.count(tag) != 0; }
   bool HasAnyTagIn(const vector<string>& tags) const {
     return std::any_of(tags.begin(), tags.end(),
                        [this](const string& tag) { return HasTag(tag); });
   }
+  bool HasAnyTagIn(const SegmentTags& tags) const {
+    return this->tags.HasAnyOf(tags);
+  }
 
   an<Candidate> GetCandidateAt(size_t index) const;
   an<Candidate> GetSelectedCandidate() const;
@@ -4,31 +4,292 @@
 //
 // 2011-08-08 GONG Chen <chen.sst@gmail.com>
 //
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <thread>
 #include <rime/context.h>
 #include <rime/engine.h>
+#include <rime/key_event.h>
+#include <rime/menu.h>
 #include <rime/resource.h>
 #include <rime/schema.h>
 #include <rime/service.h>
+#include <rime/algo/spsc_queue.h>
 
 using namespace std::placeholders;
 
 namespace rime {
 
-Session::Session() {
-  engine_.reset(Engine::Create());
-  engine_->sink().connect([this](auto text) { OnCommit(text); });
+// Processes the keys posted to a session on a thread of its own, so that
+// the thread posting them never waits for a composition to be made.
+// Once a batch of keys is processed, the frontend is notified of whether
+// each key is handled, as process_key would return, eg. "110" for three
+// keys of which the last is not handled.
+class SessionWorker {
+ public:
+  static const size_t kMaxQueuedKeys = 256;
+
+  SessionWorker(Session* session, SessionId session_id)
+      : session_(session),
+        session_id_(session_id),
+        keys_(kMaxQueuedKeys),
+        thread_([this] { Run(); }) {}
+
+  // the keys queued are processed before the thread stops.
+  ~SessionWorker() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    wake_.notify_all();
+    thread_.join();
+  }
+
+  bool Post(const KeyEvent& key_event) {
+    if (!keys_.TryPush(key_event))
+      return false;
+    // the composition for the keys before is no longer wanted, unless the
+    // batch being processed already holds this key.
+    session_->cancellation()->RequestBefore(++num_posted_);
+    // the lock is only taken to wake up the idle thread.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping_.load(std::memory_order_relaxed)) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      wake_.notify_one();
+    }
+    return true;
+  }
+
+  void Wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this] { return sleeping_ && keys_.empty(); });
+  }
+
+ private:
+  void Run() {
+    while (true) {
+      KeySequence batch;
+      KeyEvent key_event;
+      while (keys_.TryPop(&key_event)) {
+        batch.push_back(key_event);
+      }
+      if (batch.empty()) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        sleeping_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        idle_.notify_all();
+        wake_.wait(lock, [this] { return stopping_ || !keys_.empty(); });
+        sleeping_.store(false, std::memory_order_relaxed);
+        if (stopping_ && keys_.empty())
+          return;
+        continue;
+      }
+      // keys are popped in the order they are posted.
+      num_processed_ += batch.size();
+      vector<bool> results;
+      session_->ProcessPostedKeys(batch, num_processed_, &results);
+      string handled;
+      for (bool result : results) {
+        handled += result ? '1' : '0';
+      }
+      Service::instance().Notify(session_id_, "keys", handled);
+    }
+  }
+
+  Session* session_;
+  SessionId session_id_;
+  SpscQueue<KeyEvent> keys_;
+  // keys are numbered from 1 as they are posted, to tell the batch each
+  // key is processed in.
+  uint64_t num_posted_ = 0;
+  uint64_t num_processed_ = 0;
+  std::atomic<bool> sleeping_{false};
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable idle_;
+  bool stopping_ = false;
+  std::thread thread_;
+};
+
+Session::Session() : Session(the<Engine>(Engine::Create())) {}
+
+Session::Session(the<Engine> engine) : engine_(std::move(engine)) {
+  connections_.push_back(
+      engine_->sink().connect([this](auto text) { OnCommit(text); }));
   SessionId session_id = reinterpret_cast<SessionId>(this);
-  engine_->message_sink().connect([session_id](auto type, auto value) {
-    Service::instance().Notify(session_id, type, value);
-  });
+  memory_usage_.category = "session";
+  memory_usage_.name = std::to_string(session_id);
+  connections_.push_back(engine_->message_sink().connect(
+      [session_id](auto type, auto value) {
+        Service::instance().Notify(session_id, type, value);
+      }));
+  engine_->set_async_message_sink(
+      [session_id](const string& type, const string& value) {
+        Service::instance().Notify(session_id, type, value);
+      });
+}
+
+Session::~Session() {
+  ReleaseEngine();
+}
+
+the<Engine> Session::ReleaseEngine() {
+  worker_.reset();
+  StopRecording();
+  for (auto& connection : connections_) {
+    connection.disconnect();
+  }
+  connections_.clear();
+  if (engine_) {
+    engine_->set_async_message_sink(nullptr);
+    engine_->FlushUserData();
+  }
+  return std::move(engine_);
 }
 
 bool Session::ProcessKey(const KeyEvent& key_event) {
-  return engine_->ProcessKey(key_event);
+  if (!engine_)
+    return false;
+  PerfCounters::Activation counting(&perf_counters_);
+  // cancelled only by a key arriving while this one is processed.
+  cancellation_.Reset();
+  Cancellation::Activation cancelling(&cancellation_);
+  if (recorder_)
+    recorder_->RecordKey(key_event);
+#ifdef RIME_ENABLE_TRACING
+  Tracer::Activation activation(&tracer_);
+  tracer_.BeginKeyEvent(key_event.repr());
+#endif  // RIME_ENABLE_TRACING
+  bool handled = false;
+  {
+    RIME_TRACE_SCOPE("engine", "process_key");
+    handled = engine_->ProcessKey(key_event);
+  }
+  NotifyContextChanges();
+  return handled;
+}
+
+size_t Session::ProcessKeys(const KeySequence& key_sequence,
+                            vector<bool>* results) {
+  cancellation_.Reset();
+  return ProcessKeySequence(key_sequence, results);
+}
+
+size_t Session::ProcessPostedKeys(const KeySequence& key_sequence,
+                                  uint64_t generation,
+                                  vector<bool>* results) {
+  // cancelled by the keys posted after the last of these.
+  cancellation_.Begin(generation);
+  return ProcessKeySequence(key_sequence, results);
+}
+
+size_t Session::ProcessKeySequence(const KeySequence& key_sequence,
+                                   vector<bool>* results) {
+  if (!engine_)
+    return 0;
+  PerfCounters::Activation counting(&perf_counters_);
+  Cancellation::Activation cancelling(&cancellation_);
+  if (recorder_) {
+    for (const auto& key_event : key_sequence) {
+      recorder_->RecordKey(key_event);
+    }
+  }
+#ifdef RIME_ENABLE_TRACING
+  Tracer::Activation activation(&tracer_);
+  tracer_.BeginKeyEvent(key_sequence.repr());
+#endif  // RIME_ENABLE_TRACING
+  size_t handled = 0;
+  {
+    RIME_TRACE_SCOPE("engine", "process_keys");
+    handled = engine_->ProcessKeys(key_sequence, results);
+  }
+  NotifyContextChanges();
+  return handled;
+}
+
+bool Session::PostKey(const KeyEvent& key_event) {
+  if (!engine_)
+    return false;
+  if (!worker_) {
+    worker_.reset(
+        new SessionWorker(this, reinterpret_cast<SessionId>(this)));
+  }
+  return worker_->Post(key_event);
+}
+
+void Session::WaitForPostedKeys() {
+  if (worker_)
+    worker_->Wait();
+}
+
+bool Session::StartRecording(const path& file_path, bool hash_characters) {
+  if (!engine_)
+    return false;
+  StopRecording();
+  the<KeyRecorder> recorder(new KeyRecorder(file_path, hash_characters));
+  if (!recorder->good()) {
+    LOG(ERROR) << "error creating key log: " << file_path;
+    return false;
+  }
+  // the state to start replaying from.
+  if (Schema* current = schema())
+    recorder->RecordSchema(current->schema_id());
+  if (Context* ctx = context()) {
+    for (const auto& option : ctx->options()) {
+      recorder->RecordOption(option.first, option.second);
+    }
+  }
+  recorder_ = std::move(recorder);
+  recording_connection_ = engine_->message_sink().connect(
+      [this](auto type, auto value) { RecordMessage(type, value); });
+  return true;
+}
+
+void Session::StopRecording() {
+  recording_connection_.disconnect();
+  recorder_.reset();
+}
+
+void Session::RecordMessage(const string& message_type,
+                            const string& message_value) {
+  if (!recorder_)
+    return;
+  if (message_type == "schema") {
+    // schema_id/schema_name
+    recorder_->RecordSchema(message_value.substr(0, message_value.find('/')));
+  } else if (message_type == "option") {
+    bool value = message_value.empty() || message_value[0] != '!';
+    recorder_->RecordOption(message_value.substr(value ? 0 : 1), value);
+  }
 }
 
 void Session::Activate() {
   last_active_time_ = time(NULL);
+  hibernating_ = false;
+}
+
+void Session::Hibernate() {
+  if (!engine_ || hibernating_)
+    return;
+  engine_->Hibernate();
+  hibernating_ = true;
+}
+
+void Session::UpdateMemoryUsage() {
+  memory_usage_.heap_bytes = 0;
+  memory_usage_.count = 0;
+  const Context* ctx = context();
+  if (!ctx)
+    return;
+  memory_usage_.heap_bytes = ctx->arena_capacity();
+  // menus yet to be made are not made for this.
+  if (ctx->has_pending_compose())
+    return;
+  for (const Segment& seg : ctx->composition()) {
+    if (seg.menu)
+      memory_usage_.count += seg.menu->retained_count();
+  }
 }
 
 void Session::ResetCommitText() {
@@ -39,6 +300,7 @@ bool Session::CommitComposition() {
   if (!engine_)
     return false;
   engine_->context()->Commit();
+  NotifyContextChanges();
   return !commit_text_.empty();
 }
 
@@ -46,9 +308,14 @@ void Session::ClearComposition() {
   if (!engine_)
     return;
   engine_->context()->Clear();
+  NotifyContextChanges();
 }
 
 void Session::ApplySchema(Schema* schema) {
+  if (!engine_) {
+    delete schema;
+    return;
+  }
   engine_->ApplySchema(schema);
 }
 
@@ -60,6 +327,88 @@ Context* Session::context() const {
   return engine_ ? engine_->active_engine()->context() : NULL;
 }
 
+void Session::AmendTranslations() {
+  if (engine_)
+    engine_->AmendTranslations();
+}
+
+size_t Session::context_revision() {
+  // candidates arrived since are shown along with the context.
+  AmendTranslations();
+  const Context* ctx = context();
+  size_t revision = ctx ? ctx->revision() : 0;
+  // the switcher has a context of its own.
+  if (context_revision_ == 0 || ctx != observed_context_ ||
+      revision != observed_context_revision_) {
+    observed_context_ = ctx;
+    observed_context_revision_ = revision;
+    ++context_revision_;
+  }
+  return context_revision_;
+}
+
+void Session::NotifyContextChanges() {
+  const Context* ctx = context();
+  if (!ctx || !Service::instance().has_notification_handler())
+    return;
+  vector<string> parts;
+  bool context_switched = ctx != notified_context_;
+  if (context_switched || ctx->input() != notified_input_ ||
+      ctx->caret_pos() != notified_caret_pos_) {
+    parts.push_back("input");
+  }
+  if (ctx->has_pending_compose()) {
+    // the composition is not made just for the notification.
+    parts.insert(parts.end(), {"preedit", "menu", "highlight"});
+    notified_revision_ = 0;
+    notified_segments_.clear();
+  } else if (context_switched || ctx->revision() != notified_revision_) {
+    vector<SegmentState> segments;
+    for (const Segment& seg : ctx->composition()) {
+      segments.push_back({seg.start, seg.end, seg.status, seg.selected_index,
+                          seg.menu.get()});
+    }
+    auto same_segment = [](const SegmentState& a, const SegmentState& b) {
+      return a.start == b.start && a.end == b.end && a.status == b.status &&
+             a.selected_index == b.selected_index && a.menu == b.menu;
+    };
+    bool same_preedit =
+        !context_switched && parts.empty() &&
+        segments.size() == notified_segments_.size() &&
+        std::equal(segments.begin(), segments.end(),
+                   notified_segments_.begin(), same_segment);
+    if (!same_preedit)
+      parts.push_back("preedit");
+    const SegmentState* last = segments.empty() ? nullptr : &segments.back();
+    const SegmentState* notified_last =
+        notified_segments_.empty() ? nullptr : &notified_segments_.back();
+    const Menu* menu = last ? last->menu : nullptr;
+    const Menu* notified_menu = notified_last ? notified_last->menu : nullptr;
+    if (context_switched || menu != notified_menu) {
+      parts.push_back("menu");
+    }
+    if (context_switched || menu != notified_menu ||
+        (last && notified_last &&
+         last->selected_index != notified_last->selected_index)) {
+      parts.push_back("highlight");
+    }
+    notified_revision_ = ctx->revision();
+    notified_segments_.swap(segments);
+  }
+  notified_context_ = ctx;
+  notified_input_ = ctx->input();
+  notified_caret_pos_ = ctx->caret_pos();
+  if (parts.empty())
+    return;
+  string value;
+  for (const string& part : parts) {
+    if (!value.empty())
+      value += ',';
+    value += part;
+  }
+  engine_->message_sink()("context", value);
+}
+
 Schema* Session::schema() const {
   return engine_ ? engine_->active_engine()->schema() : NULL;
 }
@@ -67,6 +416,11 @@ Schema* Session::schema() const {
 Service::Service() {
   deployer_.message_sink().connect(
       [this](auto type, auto value) { Notify(0, type, value); });
+  // engines kept for new sessions may hold the files of the previous build.
+  deployer_.message_sink().connect([this](auto type, auto value) {
+    if (type == "deploy" && value != "start")
+      engine_pool_.Clear();
+  });
 }
 
 Service::~Service() {
@@ -75,6 +429,7 @@ Service::~Service() {
 
 void Service::StartService() {
   started_ = true;
+  perf_counters().Reset();
 }
 
 void Service::StopService() {
@@ -87,10 +442,14 @@ SessionId Service::CreateSession() {
   if (disabled())
     return id;
   try {
-    auto session = New<Session>();
+    auto session = New<Session>(engine_pool_.Acquire());
     session->Activate();
+    if (Schema* schema = session->schema())
+      engine_pool_.WarmUp(schema->schema_id(), false);
     id = reinterpret_cast<uintptr_t>(session.get());
-    sessions_[id] = session;
+    auto& shard = shard_of(id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.sessions[id] = session;
   } catch (const std::exception& ex) {
     LOG(ERROR) << "Error creating session: " << ex.what();
   } catch (const string& ex) {
@@ -108,8 +467,10 @@ SessionId Service::CreateSession() {
 an<Session> Service::GetSession(SessionId session_id) {
   if (disabled())
     return nullptr;
-  SessionMap::iterator it = sessions_.find(session_id);
-  if (it != sessions_.end()) {
+  auto& shard = shard_of(session_id);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  SessionMap::iterator it = shard.sessions.find(session_id);
+  if (it != shard.sessions.end()) {
     auto& session = it->second;
     session->Activate();
     return session;
@@ -118,32 +479,100 @@ an<Session> Service::GetSession(SessionId session_id) {
 }
 
 bool Service::DestroySession(SessionId session_id) {
-  auto it = sessions_.find(session_id);
-  if (it == sessions_.end())
-    return false;
-  sessions_.erase(it);
+  an<Session> session;
+  {
+    auto& shard = shard_of(session_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.sessions.find(session_id);
+    if (it == shard.sessions.end())
+      return false;
+    session = std::move(it->second);
+    shard.sessions.erase(it);
+  }
+  // unless the session is still in use elsewhere.
+  if (session.use_count() == 1) {
+    engine_pool_.Release(session->ReleaseEngine());
+  }
   return true;
 }
 
 void Service::CleanupStaleSessions() {
   time_t now = time(NULL);
   int count = 0;
-  for (auto it = sessions_.begin(); it != sessions_.end();) {
-    if (it->second &&
-        it->second->last_active_time() < now - Session::kLifeSpan) {
-      sessions_.erase(it++);
-      ++count;
-    } else {
-      ++it;
+  int hibernated = 0;
+  // one shard at a time; stale sessions are disposed of outside the lock.
+  vector<an<Session>> stale_sessions;
+  for (auto& shard : session_shards_) {
+    {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      for (auto it = shard.sessions.begin(); it != shard.sessions.end();) {
+        auto& session = it->second;
+        if (session && session->last_active_time() < now - Session::kLifeSpan) {
+          stale_sessions.push_back(std::move(session));
+          shard.sessions.erase(it++);
+          ++count;
+          continue;
+        }
+        // a session got hold of by another thread, which has to take the
+        // lock to do so, may be in use.
+        if (session && !session->hibernating() &&
+            session->last_active_time() < now - Session::kHibernationDelay &&
+            session.use_count() == 1) {
+          session->Hibernate();
+          ++hibernated;
+        }
+        ++it;
+      }
     }
+    stale_sessions.clear();
   }
   if (count > 0) {
     LOG(INFO) << "Recycled " << count << " stale sessions.";
   }
+  if (hibernated > 0) {
+    LOG(INFO) << "Hibernated " << hibernated << " idle sessions.";
+  }
+  memory_budget().Enforce();
 }
 
 void Service::CleanupAllSessions() {
-  sessions_.clear();
+  for (auto& shard : session_shards_) {
+    SessionMap sessions;
+    {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      sessions.swap(shard.sessions);
+    }
+  }
+  // engines kept for new sessions may have outdated schemas.
+  engine_pool_.Clear();
+}
+
+void Service::ReportMemoryUsage(vector<MemoryUsage>* usages) {
+  MemoryUsage total;
+  total.category = "sessions";
+  size_t total_index = usages->size();
+  usages->push_back(total);
+  for (auto& shard : session_shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    for (auto& x : shard.sessions) {
+      auto& session = x.second;
+      if (!session)
+        continue;
+      // a session got hold of by another thread may be in use.
+      if (session.use_count() == 1)
+        session->UpdateMemoryUsage();
+      const MemoryUsage& usage = session->memory_usage();
+      total.heap_bytes += usage.heap_bytes;
+      ++total.count;
+      usages->push_back(usage);
+    }
+  }
+  (*usages)[total_index] = std::move(total);
+}
+
+Service::SessionShard& Service::shard_of(SessionId session_id) {
+  // session ids are addresses of sessions, whose lowest bits are the same.
+  return session_shards_[(session_id >> 4) % kNumSessionShards];
 }
 
 void Service::SetNotificationHandler(const NotificationHandler& handler) {
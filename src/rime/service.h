@@ -9,9 +9,18 @@
 
 #include <stdint.h>
 #include <time.h>
+#include <array>
 #include <mutex>
+#include <rime_api.h>
+#include <rime/cancellation.h>
 #include <rime/common.h>
 #include <rime/deployer.h>
+#include <rime/engine_pool.h>
+#include <rime/key_recorder.h>
+#include <rime/memory_budget.h>
+#include <rime/memory_stats.h>
+#include <rime/perf_counters.h>
+#include <rime/trace.h>
 
 namespace rime {
 
@@ -25,32 +34,140 @@ using NotificationHandler = function<void(SessionId session_id,
 
 class Context;
 class Engine;
+class Menu;
 class KeyEvent;
+class KeySequence;
 class Schema;
+class SessionWorker;
+
+// the context as last shown to the frontend, whose strings are kept by the
+// session to be lent to the frontend without copying.
+struct ContextView {
+  size_t revision = 0;
+  bool is_composing = false;
+  string preedit;
+  int cursor_pos = 0;
+  int sel_start = 0;
+  int sel_end = 0;
+  string commit_text_preview;
+  bool has_menu = false;
+  int page_size = 0;
+  int page_no = 0;
+  bool is_last_page = false;
+  int highlighted_candidate_index = 0;
+  vector<string> candidate_texts;
+  vector<string> candidate_comments;
+  vector<RimeCandidate> candidates;
+  string select_keys;
+  vector<string> select_labels;
+  vector<char*> select_label_ptrs;
+};
 
 class Session {
  public:
   static const int kLifeSpan = 5 * 60;  // seconds
+  // idle sessions release the transient state of their engines.
+  static const int kHibernationDelay = 60;  // seconds
 
   Session();
+  explicit Session(the<Engine> engine);
+  ~Session();
   bool ProcessKey(const KeyEvent& key_event);
+  // the input is composed once after the last key of the batch.
+  size_t ProcessKeys(const KeySequence& key_sequence,
+                     vector<bool>* results = nullptr);
+  // queues the key to be processed on a thread of the session, in a batch
+  // with the other keys queued by then, cancelling the key being processed.
+  // keys are posted by one thread at a time, which does not wait for them.
+  // returns false if the queue is full.
+  bool PostKey(const KeyEvent& key_event);
+  // waits for the keys posted to be processed, before other calls are made
+  // to the session.
+  void WaitForPostedKeys();
   void Activate();
   void ResetCommitText();
   bool CommitComposition();
   void ClearComposition();
   void ApplySchema(Schema* schema);
+  // disconnects the engine from the session, to be reused by another.
+  the<Engine> ReleaseEngine();
+  // releases menus and caches of the idle session, which are made anew as
+  // it is next used.
+  void Hibernate();
+  bool hibernating() const { return hibernating_; }
+  // takes account of the candidates held by menus and the arena in use.
+  // not to be called while the session is in use on another thread.
+  void UpdateMemoryUsage();
+  const MemoryUsage& memory_usage() const { return memory_usage_; }
 
   Context* context() const;
   Schema* schema() const;
+  // composes anew with the candidates arrived from slow translators.
+  void AmendTranslations();
+  // changes whenever the context of the active engine may have changed.
+  size_t context_revision();
+  ContextView& context_view() { return context_view_; }
   time_t last_active_time() const { return last_active_time_; }
   const string& commit_text() const { return commit_text_; }
+  PerfCounters* perf_counters() { return &perf_counters_; }
+  // requested from other threads to cancel the key being processed.
+  Cancellation* cancellation() { return &cancellation_; }
+  // records the keys processed, with the schema and options they are
+  // processed with, into a key log until stopped.
+  bool StartRecording(const path& file_path, bool hash_characters);
+  void StopRecording();
+#ifdef RIME_ENABLE_TRACING
+  Tracer* tracer() { return &tracer_; }
+#endif  // RIME_ENABLE_TRACING
 
  private:
+  friend class SessionWorker;
+
+  // processes a batch of posted keys, numbered by the last of them.
+  size_t ProcessPostedKeys(const KeySequence& key_sequence,
+                           uint64_t generation,
+                           vector<bool>* results);
+  size_t ProcessKeySequence(const KeySequence& key_sequence,
+                            vector<bool>* results);
   void OnCommit(const string& commit_text);
-
+  // tells the frontend which parts of the context have changed since it was
+  // last told.
+  void NotifyContextChanges();
+  void RecordMessage(const string& message_type, const string& message_value);
+
+  // outlives the engine, whose work may still be counted while tearing down.
+  PerfCounters perf_counters_;
+  Cancellation cancellation_;
   the<Engine> engine_;
+  // started by the first key posted; stopped before the engine is released.
+  the<SessionWorker> worker_;
+  vector<connection> connections_;
+  the<KeyRecorder> recorder_;
+  connection recording_connection_;
   time_t last_active_time_ = 0;
+  bool hibernating_ = false;
+  MemoryUsage memory_usage_;
   string commit_text_;
+  size_t context_revision_ = 0;
+  const Context* observed_context_ = nullptr;
+  size_t observed_context_revision_ = 0;
+  ContextView context_view_;
+  // the context as last notified.
+  struct SegmentState {
+    size_t start;
+    size_t end;
+    int status;
+    size_t selected_index;
+    const Menu* menu;
+  };
+  const Context* notified_context_ = nullptr;
+  size_t notified_revision_ = 0;
+  string notified_input_;
+  size_t notified_caret_pos_ = 0;
+  vector<SegmentState> notified_segments_;
+#ifdef RIME_ENABLE_TRACING
+  Tracer tracer_;
+#endif  // RIME_ENABLE_TRACING
 };
 
 class ResourceResolver;
@@ -68,12 +185,18 @@ class RIME_API Service {
   bool DestroySession(SessionId session_id);
   void CleanupStaleSessions();
   void CleanupAllSessions();
+  // the live sessions in total, followed by each of them; sessions in use
+  // on other threads are reported as they were last taken account of.
+  void ReportMemoryUsage(vector<MemoryUsage>* usages);
 
   void SetNotificationHandler(const NotificationHandler& handler);
   void ClearNotificationHandler();
   void Notify(SessionId session_id,
               const string& message_type,
               const string& message_value);
+  bool has_notification_handler() const {
+    return bool(notification_handler_);
+  }
 
   ResourceResolver* CreateResourceResolver(const ResourceType& type);
   ResourceResolver* CreateUserSpecificResourceResolver(
@@ -82,7 +205,16 @@ class RIME_API Service {
   ResourceResolver* CreateStagingResourceResolver(const ResourceType& type);
 
   Deployer& deployer() { return deployer_; }
-  bool disabled() { return !started_ || deployer_.IsMaintenanceMode(); }
+  EnginePool& engine_pool() { return engine_pool_; }
+  // caps the memory of caches; enforced as stale sessions are cleaned up.
+  MemoryBudget& memory_budget() { return MemoryBudget::instance(); }
+  // the totals of all sessions since the service was started.
+  PerfCounters& perf_counters() { return PerfCounters::Global(); }
+  // sessions are served during maintenance, but before the first build.
+  bool disabled() {
+    return !started_ || (deployer_.IsMaintenanceMode() &&
+                         !deployer_.serving_previous_build());
+  }
 
   static Service& instance();
 
@@ -90,9 +222,20 @@ class RIME_API Service {
   Service();
 
   using SessionMap = map<SessionId, an<Session>>;
-  SessionMap sessions_;
+  // sessions are spread over shards, each guarded by a lock of its own, so
+  // that threads working with different sessions seldom wait for each other.
+  struct SessionShard {
+    std::mutex mutex;
+    SessionMap sessions;
+  };
+  static constexpr size_t kNumSessionShards = 16;
+  SessionShard& shard_of(SessionId session_id);
+
+  std::array<SessionShard, kNumSessionShards> session_shards_;
   Deployer deployer_;
+  EnginePool engine_pool_;
   NotificationHandler notification_handler_;
+  // serializes calls to the notification handler.
   std::mutex mutex_;
   bool started_ = false;
 };
@@ -32,11 +32,24 @@ RIME_REGISTER_MODULE_GROUP(deployer, "core", "dict", "levers")
 
 RIME_API void LoadModules(const char* module_names[]) {
   ModuleManager& mm(ModuleManager::instance());
+  vector<RimeModule*> modules;
   for (const char** m = module_names; *m; ++m) {
     if (RimeModule* module = mm.Find(*m)) {
-      mm.LoadModule(module);
+      if (RIME_PROVIDED(module, components)) {
+        // it may replace components of the modules before it.
+        mm.LoadModules(modules);
+        modules.clear();
+        vector<string> components;
+        for (const char** c = module->components; *c; ++c) {
+          components.push_back(*c);
+        }
+        mm.LoadOnDemand(*m, components);
+      } else {
+        modules.push_back(module);
+      }
     }
   }
+  mm.LoadModules(modules);
 }
 
 RIME_API void SetupDeployer(RimeTraits* traits) {
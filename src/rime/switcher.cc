@@ -4,6 +4,10 @@
 //
 // 2011-12-07 GONG Chen <chen.sst@gmail.com>
 //
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include <rime/candidate.h>
 #include <rime/common.h>
 #include <rime/composition.h>
@@ -20,6 +24,68 @@
 
 namespace rime {
 
+static const SegmentTags::TagId kPagingTag = SegmentTags::Intern("paging");
+
+class DeferredSave {
+ public:
+  // toggling options in a row makes one write.
+  static constexpr std::chrono::milliseconds kDelay{500};
+
+  explicit DeferredSave(Config* config) : config_(config) {}
+  ~DeferredSave() { Flush(); }
+
+  void Schedule() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    deadline_ = std::chrono::steady_clock::now() + kDelay;
+    pending_ = true;
+    if (running_)
+      return;
+    // the thread of the previous write has finished.
+    if (thread_.joinable())
+      thread_.join();
+    running_ = true;
+    thread_ = std::thread([this] { Run(); });
+  }
+
+  // writes the pending changes now, and waits for them to be written.
+  void Flush() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      deadline_ = std::chrono::steady_clock::now();
+    }
+    wake_.notify_all();
+    if (thread_.joinable())
+      thread_.join();
+  }
+
+ private:
+  void Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (pending_) {
+      // the deadline is put off by each change made meanwhile.
+      while (std::chrono::steady_clock::now() < deadline_) {
+        wake_.wait_until(lock, deadline_);
+      }
+      pending_ = false;
+      lock.unlock();
+      // the config data is locked for writing; sessions may go on using it.
+      config_->Save();
+      lock.lock();
+    }
+    running_ = false;
+  }
+
+  Config* config_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::chrono::steady_clock::time_point deadline_;
+  bool pending_ = false;
+  bool running_ = false;
+  std::thread thread_;
+};
+
+constexpr std::chrono::milliseconds DeferredSave::kDelay;
+
 Switcher::Switcher(const Ticket& ticket) : Processor(ticket) {
   context_->set_option("dumb", true);  // not going to commit anything
 
@@ -27,6 +93,9 @@ Switcher::Switcher(const Ticket& ticket) : Processor(ticket) {
   context_->select_notifier().connect([this](Context* ctx) { OnSelect(ctx); });
 
   user_config_.reset(Config::Require("user_config")->Create("user"));
+  if (user_config_) {
+    deferred_save_.reset(new DeferredSave(user_config_.get()));
+  }
   InitializeComponents();
   LoadSettings();
 }
@@ -98,7 +167,7 @@ void Switcher::HighlightNextSchema() {
     }
   } while (!option || option->type() != "schema");
   seg.selected_index = index;
-  seg.tags.insert("paging");
+  seg.tags.Add(kPagingTag);
   return;
 }
 
@@ -167,7 +236,7 @@ void Switcher::SetActiveSchema(const string& schema_id) {
     user_config_->SetString("var/previously_selected_schema", schema_id);
     user_config_->SetInt("var/schema_access_time/" + schema_id, time(NULL));
     // persist recently used schema and options that have changed
-    user_config_->Save();
+    deferred_save_->Schedule();
   }
 }
 
@@ -15,6 +15,7 @@ namespace rime {
 
 class Config;
 class Context;
+class DeferredSave;
 class Translator;
 
 class Switcher : public Processor, public Engine {
@@ -54,6 +55,9 @@ class Switcher : public Processor, public Engine {
   void OnSelect(Context* ctx);
 
   the<Config> user_config_;
+  // writes the user config on a background thread, once the changes made in
+  // quick succession settle; flushed when the switcher is destroyed.
+  the<DeferredSave> deferred_save_;
   string caption_;
   vector<KeyEvent> hotkeys_;
   set<string> save_options_;
@@ -1,6 +1,6 @@
-#include <utf8.h>
 #include <rime/config.h>
 #include <rime/switches.h>
+#include <rime/algo/strings.h>
 
 namespace rime {
 
@@ -126,13 +126,7 @@ Switches::SwitchOption Switches::FindRadioGroupOption(
 }
 
 inline static size_t first_unicode_byte_length(const string& str) {
-  if (str.empty()) {
-    return 0;
-  }
-  const char* start = str.c_str();
-  const char* end = start;
-  utf8::unchecked::next(end);
-  return end - start;
+  return strings::utf8_offset(str, 1);
 }
 
 StringSlice Switches::GetStateLabel(an<ConfigMap> the_switch,
@@ -180,4 +174,55 @@ StringSlice Switches::GetStateLabel(const string& option_name,
   return {nullptr, 0};
 }
 
+SwitchIndex::SwitchIndex(Config* config) {
+  if (!config)
+    return;
+  Switches switches(config);
+  switches.FindOption([this](Switches::SwitchOption option) {
+    Labels labels{};
+    if (option.type == Switches::kToggleOption) {
+      for (size_t state = 0; state < 2; ++state) {
+        labels.full[state] =
+            Switches::GetStateLabel(option.the_switch, state, false);
+        labels.abbreviated[state] =
+            Switches::GetStateLabel(option.the_switch, state, true);
+      }
+    } else {
+      labels.full[1] = Switches::GetStateLabel(option.the_switch,
+                                               option.option_index, false);
+      labels.abbreviated[1] = Switches::GetStateLabel(
+          option.the_switch, option.option_index, true);
+    }
+    // the first definition of an option wins, as in Switches::OptionByName().
+    by_name_.emplace(option.option_name, options_.size());
+    options_.push_back(std::move(option));
+    labels_.push_back(labels);
+    return Switches::kContinue;
+  });
+}
+
+const Switches::SwitchOption* SwitchIndex::OptionByName(
+    const string& option_name) const {
+  auto it = by_name_.find(option_name);
+  return it != by_name_.end() ? &options_[it->second] : nullptr;
+}
+
+StringSlice SwitchIndex::GetStateLabel(const string& option_name,
+                                       int state,
+                                       bool abbreviated) const {
+  auto it = by_name_.find(option_name);
+  if (it == by_name_.end())
+    return {nullptr, 0};
+  const auto& option = options_[it->second];
+  if (option.type == Switches::kToggleOption && (state < 0 || state > 1)) {
+    return Switches::GetStateLabel(option.the_switch,
+                                   static_cast<size_t>(state), abbreviated);
+  }
+  // radio options are labeled only when selected.
+  size_t state_index = state ? 1 : 0;
+  const auto& labels = labels_[it->second];
+  return abbreviated ? labels.abbreviated[state_index]
+                     : labels.full[state_index];
+}
+
 }  // namespace rime
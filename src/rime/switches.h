@@ -82,6 +82,35 @@ class Switches {
   Config* config_;
 };
 
+// The switches of a schema compiled once, to answer queries by option name
+// without walking the config.
+class SwitchIndex {
+ public:
+  SwitchIndex() = default;
+  explicit SwitchIndex(Config* config);
+
+  // all options in the order they are defined.
+  const vector<Switches::SwitchOption>& options() const { return options_; }
+  // nullptr if there is no such option.
+  const Switches::SwitchOption* OptionByName(const string& option_name) const;
+  // same as Switches::GetStateLabel().
+  StringSlice GetStateLabel(const string& option_name,
+                            int state,
+                            bool abbreviated) const;
+
+ private:
+  // the labels of states 0 and 1 of a toggle option, or of a radio option
+  // when it is selected (1) or not (0); in full and abbreviated.
+  struct Labels {
+    StringSlice full[2];
+    StringSlice abbreviated[2];
+  };
+
+  vector<Switches::SwitchOption> options_;
+  vector<Labels> labels_;
+  hash_map<string, size_t> by_name_;
+};
+
 }  // namespace rime
 
 #endif  // RIME_SWITCHES_H_
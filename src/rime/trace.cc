@@ -0,0 +1,114 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <rime/trace.h>
+
+#ifdef RIME_ENABLE_TRACING
+
+#include <sstream>
+
+namespace rime {
+
+static thread_local Tracer* current_tracer = nullptr;
+
+Tracer* Tracer::current() {
+  return current_tracer;
+}
+
+Tracer::Activation::Activation(Tracer* tracer) : previous_(current_tracer) {
+  current_tracer = tracer;
+}
+
+Tracer::Activation::~Activation() {
+  current_tracer = previous_;
+}
+
+void Tracer::BeginKeyEvent(const string& key_repr) {
+  if (!enabled_)
+    return;
+  if (key_events_.size() < kMaxEvents) {
+    key_events_.push_back(key_repr);
+  } else {
+    key_events_[key_event_count_ % kMaxEvents] = key_repr;
+  }
+  ++key_event_count_;
+}
+
+void Tracer::Record(const char* category,
+                    string name,
+                    Clock::time_point begin,
+                    Clock::time_point end,
+                    const AllocationCounts& allocated) {
+  using std::chrono::duration_cast;
+  using std::chrono::microseconds;
+  Event event{category,
+              std::move(name),
+              duration_cast<microseconds>(begin - epoch_).count(),
+              duration_cast<microseconds>(end - begin).count(),
+              key_event_count_,
+              allocated.allocations,
+              allocated.bytes};
+  if (events_.size() < kMaxEvents) {
+    events_.push_back(std::move(event));
+  } else {
+    events_[next_event_] = std::move(event);
+    next_event_ = (next_event_ + 1) % kMaxEvents;
+  }
+}
+
+void Tracer::Clear() {
+  events_.clear();
+  next_event_ = 0;
+  key_events_.clear();
+  key_event_count_ = 0;
+}
+
+static void write_json_string(std::ostream& out, const string& str) {
+  out << '"';
+  for (unsigned char c : str) {
+    if (c == '"' || c == '\\') {
+      out << '\\' << c;
+    } else if (c < 0x20) {
+      static const char kHex[] = "0123456789abcdef";
+      out << "\\u00" << kHex[c >> 4] << kHex[c & 0xf];
+    } else {
+      out << c;
+    }
+  }
+  out << '"';
+}
+
+string Tracer::ToChromeTraceJson() const {
+  std::ostringstream out;
+  out << "{\"traceEvents\":[";
+  for (size_t i = 0; i < events_.size(); ++i) {
+    // from the oldest, if the buffer has wrapped around
+    const Event& event = events_[(next_event_ + i) % events_.size()];
+    if (i > 0)
+      out << ',';
+    out << "{\"name\":";
+    write_json_string(out, event.name);
+    out << ",\"cat\":";
+    write_json_string(out, event.category);
+    out << ",\"ph\":\"X\",\"ts\":" << event.begin
+        << ",\"dur\":" << event.duration << ",\"pid\":1,\"tid\":1";
+    out << ",\"args\":{\"key_event\":" << event.key_event;
+    if (event.key_event > 0 &&
+        event.key_event + kMaxEvents > key_event_count_) {
+      out << ",\"key\":";
+      write_json_string(out, key_events_[(event.key_event - 1) % kMaxEvents]);
+    }
+    if (event.allocations > 0) {
+      out << ",\"allocations\":" << event.allocations
+          << ",\"allocated_bytes\":" << event.allocated_bytes;
+    }
+    out << "}}";
+  }
+  out << "]}";
+  return out.str();
+}
+
+}  // namespace rime
+
+#endif  // RIME_ENABLE_TRACING
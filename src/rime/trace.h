@@ -0,0 +1,139 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#ifndef RIME_TRACE_H_
+#define RIME_TRACE_H_
+
+#include <rime_api.h>
+#include <rime/common.h>
+#include <rime/memory_stats.h>
+
+#ifdef RIME_ENABLE_TRACING
+
+#include <stdint.h>
+#include <chrono>
+
+namespace rime {
+
+// Records the wall time spent by each component of the engine on each key
+// event, and the heap allocations made if they are counted, to be exported
+// in the Chrome trace event format.
+class RIME_API Tracer {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Event {
+    // the kind of component, e.g. "processor", "translator"
+    const char* category;
+    // the name space of the component
+    string name;
+    // microseconds since the tracer was created
+    int64_t begin;
+    int64_t duration;
+    // the ordinal of the key event, from 1
+    size_t key_event;
+    // heap allocations made on the thread within the event
+    uint64_t allocations = 0;
+    uint64_t allocated_bytes = 0;
+  };
+
+  // the oldest events are dropped beyond this number.
+  static constexpr size_t kMaxEvents = 1 << 16;
+
+  Tracer() : epoch_(Clock::now()) {}
+
+  bool enabled() const { return enabled_; }
+  void set_enabled(bool enabled) { enabled_ = enabled; }
+
+  // starts counting the events of a new key event.
+  void BeginKeyEvent(const string& key_repr);
+  void Record(const char* category,
+              string name,
+              Clock::time_point begin,
+              Clock::time_point end,
+              const AllocationCounts& allocated = AllocationCounts());
+  void Clear();
+
+  const vector<Event>& events() const { return events_; }
+  size_t key_event_count() const { return key_event_count_; }
+  // {"traceEvents": [...]}, to be loaded by chrome://tracing or Perfetto.
+  string ToChromeTraceJson() const;
+
+  // the tracer of the session served on the calling thread, or null.
+  static Tracer* current();
+
+  // makes a tracer current on the calling thread within its scope.
+  class Activation {
+   public:
+    explicit Activation(Tracer* tracer);
+    ~Activation();
+
+   private:
+    Tracer* previous_;
+  };
+
+ private:
+  Clock::time_point epoch_;
+  bool enabled_ = false;
+  vector<Event> events_;
+  // events_ is a ring buffer once full
+  size_t next_event_ = 0;
+  // the keys of the latest key events, by ordinal modulo kMaxEvents
+  vector<string> key_events_;
+  size_t key_event_count_ = 0;
+};
+
+// Records the time spent and the allocations made within its scope to the
+// current tracer.
+class TraceScope {
+ public:
+  // the name is only made if the current tracer is enabled.
+  template <class MakeName>
+  TraceScope(const char* category, MakeName&& make_name)
+      : tracer_(Tracer::current()) {
+    if (!tracer_ || !tracer_->enabled()) {
+      tracer_ = nullptr;
+      return;
+    }
+    category_ = category;
+    name_ = make_name();
+    allocated_ = AllocationCounts::current();
+    begin_ = Tracer::Clock::now();
+  }
+  ~TraceScope() {
+    if (!tracer_)
+      return;
+    auto end = Tracer::Clock::now();
+    const AllocationCounts& counts = AllocationCounts::current();
+    allocated_.allocations = counts.allocations - allocated_.allocations;
+    allocated_.bytes = counts.bytes - allocated_.bytes;
+    tracer_->Record(category_, std::move(name_), begin_, end, allocated_);
+  }
+  TraceScope(const TraceScope&) = delete;
+  TraceScope& operator=(const TraceScope&) = delete;
+
+ private:
+  Tracer* tracer_;
+  const char* category_ = nullptr;
+  string name_;
+  Tracer::Clock::time_point begin_;
+  AllocationCounts allocated_;
+};
+
+}  // namespace rime
+
+#define RIME_TRACE_CONCAT_(a, b) a##b
+#define RIME_TRACE_CONCAT(a, b) RIME_TRACE_CONCAT_(a, b)
+// traces the rest of the enclosing block.
+#define RIME_TRACE_SCOPE(category, name)                        \
+  ::rime::TraceScope RIME_TRACE_CONCAT(rime_trace_, __LINE__)( \
+      category, [&]() -> ::rime::string { return name; })
+
+#else
+
+#define RIME_TRACE_SCOPE(category, name)
+
+#endif  // RIME_ENABLE_TRACING
+
+#endif  // RIME_TRACE_H_
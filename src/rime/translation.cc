@@ -4,6 +4,7 @@
 //
 // 2011-05-21 GONG Chen <chen.sst@gmail.com>
 //
+#include <algorithm>
 #include <rime/candidate.h>
 #include <rime/translation.h>
 
@@ -22,6 +23,18 @@ int Translation::Compare(an<Translation> other,
   return ours->compare(*theirs);
 }
 
+size_t Translation::Fill(CandidateList* out, size_t n) {
+  size_t filled = 0;
+  while (filled < n && !exhausted()) {
+    if (auto cand = Peek()) {
+      out->push_back(cand);
+      ++filled;
+    }
+    Next();
+  }
+  return filled;
+}
+
 bool UniqueTranslation::Next() {
   if (exhausted())
     return false;
@@ -53,6 +66,18 @@ an<Candidate> FifoTranslation::Peek() {
   return candies_[cursor_];
 }
 
+size_t FifoTranslation::Fill(CandidateList* out, size_t n) {
+  if (exhausted())
+    return 0;
+  size_t filled = (std::min)(n, candies_.size() - cursor_);
+  out->insert(out->end(), candies_.begin() + cursor_,
+              candies_.begin() + cursor_ + filled);
+  cursor_ += filled;
+  if (cursor_ >= candies_.size())
+    set_exhausted(true);
+  return filled;
+}
+
 void FifoTranslation::Append(an<Candidate> candy) {
   candies_.push_back(candy);
   set_exhausted(false);
@@ -108,9 +133,14 @@ bool MergedTranslation::Next() {
     return false;
   }
   translations_[elected_]->Next();
+  elected_ever_[elected_] = true;
+  ++yielded_;
   if (translations_[elected_]->exhausted()) {
     DLOG(INFO) << "translation #" << elected_ << " has been exhausted.";
-    translations_.erase(translations_.begin() + elected_);
+    Remove(elected_);
+  }
+  if (yielded_ == dormancy_threshold_) {
+    ReleaseDormant();
   }
   Elect();
   return !exhausted();
@@ -123,24 +153,42 @@ an<Candidate> MergedTranslation::Peek() {
   return translations_[elected_]->Peek();
 }
 
+size_t MergedTranslation::Fill(CandidateList* out, size_t n) {
+  if (exhausted())
+    return 0;
+  if (translations_.size() != 1)
+    return FillWith(this, out, n);
+  // no other translation to elect; pass the request on.
+  size_t filled = translations_[0]->Fill(out, n);
+  elected_ever_[0] = true;
+  yielded_ += filled;
+  if (translations_[0]->exhausted())
+    Remove(0);
+  Elect();
+  return filled;
+}
+
 void MergedTranslation::Elect() {
   if (translations_.empty()) {
     set_exhausted(true);
     return;
   }
   size_t k = 0;
-  for (; k < translations_.size(); ++k) {
+  while (k < translations_.size()) {
     const auto& current = translations_[k];
     const auto& next =
         k + 1 < translations_.size() ? translations_[k + 1] : nullptr;
     if (current->Compare(next, previous_candidates_) <= 0) {
       if (current->exhausted()) {
-        translations_.erase(translations_.begin() + k);
-        k = 0;
+        Remove(k);
+        // only the comparison of the preceding translation has changed.
+        if (k > 0)
+          --k;
         continue;
       }
       break;
     }
+    ++k;
   }
   elected_ = k;
   if (k >= translations_.size()) {
@@ -151,9 +199,24 @@ void MergedTranslation::Elect() {
   }
 }
 
+void MergedTranslation::Remove(size_t k) {
+  translations_.erase(translations_.begin() + k);
+  elected_ever_.erase(elected_ever_.begin() + k);
+}
+
+void MergedTranslation::ReleaseDormant() {
+  for (size_t k = translations_.size(); k-- > 0;) {
+    if (!elected_ever_[k]) {
+      DLOG(INFO) << "releasing dormant translation #" << k;
+      Remove(k);
+    }
+  }
+}
+
 MergedTranslation& MergedTranslation::operator+=(an<Translation> t) {
   if (t && !t->exhausted()) {
     translations_.push_back(t);
+    elected_ever_.push_back(false);
     Elect();
   }
   return *this;
@@ -186,6 +249,92 @@ an<Candidate> CacheTranslation::Peek() {
   return cache_;
 }
 
+size_t CacheTranslation::Fill(CandidateList* out, size_t n) {
+  if (exhausted() || n == 0)
+    return 0;
+  size_t filled = 0;
+  if (cache_) {
+    out->push_back(cache_);
+    ++filled;
+    cache_.reset();
+    translation_->Next();
+  }
+  filled += translation_->Fill(out, n - filled);
+  set_exhausted(translation_->exhausted());
+  return filled;
+}
+
+// FusedFilterTranslation
+
+FusedFilterTranslation::FusedFilterTranslation(an<Translation> translation)
+    : translation_(translation) {
+  LocateNextCandidate();
+}
+
+void FusedFilterTranslation::AddTransform(CandidateTransform transform) {
+  transforms_.push_back(std::move(transform));
+  // the current candidate has yet to pass the new transform.
+  if (cache_) {
+    cache_ = transforms_.back()(cache_);
+    if (!cache_)
+      translation_->Next();
+  }
+  LocateNextCandidate();
+}
+
+bool FusedFilterTranslation::Next() {
+  if (exhausted())
+    return false;
+  cache_.reset();
+  translation_->Next();
+  return LocateNextCandidate();
+}
+
+an<Candidate> FusedFilterTranslation::Peek() {
+  return cache_;
+}
+
+size_t FusedFilterTranslation::Fill(CandidateList* out, size_t n) {
+  if (exhausted() || n == 0)
+    return 0;
+  out->push_back(cache_);
+  size_t filled = 1;
+  cache_.reset();
+  translation_->Next();
+  // transforms see the candidates appended before in the list.
+  CandidateList batch;
+  while (filled < n && !translation_->exhausted()) {
+    batch.clear();
+    if (translation_->Fill(&batch, n - filled) == 0)
+      break;
+    for (const auto& cand : batch) {
+      if (auto result = Transform(cand)) {
+        out->push_back(result);
+        ++filled;
+      }
+    }
+  }
+  LocateNextCandidate();
+  return filled;
+}
+
+an<Candidate> FusedFilterTranslation::Transform(an<Candidate> cand) const {
+  for (auto it = transforms_.begin(); cand && it != transforms_.end(); ++it) {
+    cand = (*it)(cand);
+  }
+  return cand;
+}
+
+bool FusedFilterTranslation::LocateNextCandidate() {
+  while (!cache_ && translation_ && !translation_->exhausted()) {
+    cache_ = Transform(translation_->Peek());
+    if (!cache_)
+      translation_->Next();
+  }
+  set_exhausted(!cache_);
+  return bool(cache_);
+}
+
 // DistinctTranslation
 
 DistinctTranslation::DistinctTranslation(an<Translation> translation)
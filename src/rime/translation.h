@@ -25,6 +25,12 @@ class RIME_API Translation {
 
   virtual an<Candidate> Peek() = 0;
 
+  // appends at most n candidates to the list, as if taken one at a time by
+  // Peek() and Next(); returns the number of candidates appended.
+  // a class overriding Peek() or Next() of a base class that specializes
+  // Fill() has to override Fill() as well.
+  virtual size_t Fill(CandidateList* out, size_t n);
+
   // should it provide the next candidate (negative value, zero) or
   // should it give up the chance for other translations (positive)?
   virtual int Compare(an<Translation> other, const CandidateList& candidates);
@@ -38,6 +44,21 @@ class RIME_API Translation {
   bool exhausted_ = false;
 };
 
+// fills the list by Peek() and Next() of class T, called without virtual
+// dispatch for each candidate.
+template <class T>
+size_t FillWith(T* translation, CandidateList* out, size_t n) {
+  size_t filled = 0;
+  while (filled < n && !translation->exhausted()) {
+    if (auto cand = translation->T::Peek()) {
+      out->push_back(cand);
+      ++filled;
+    }
+    translation->T::Next();
+  }
+  return filled;
+}
+
 class UniqueTranslation : public Translation {
  public:
   UniqueTranslation(an<Candidate> candidate) : candidate_(candidate) {
@@ -57,6 +78,7 @@ class RIME_API FifoTranslation : public Translation {
 
   bool Next();
   an<Candidate> Peek();
+  size_t Fill(CandidateList* out, size_t n) override;
 
   void Append(an<Candidate> candy);
 
@@ -88,17 +110,31 @@ class MergedTranslation : public Translation {
 
   bool Next();
   an<Candidate> Peek();
+  // candidates are taken from a single translation in batches.
+  size_t Fill(CandidateList* out, size_t n) override;
 
   MergedTranslation& operator+=(an<Translation> t);
 
   size_t size() const { return translations_.size(); }
 
+  // translations not yet elected when the given number of candidates have
+  // been yielded are deemed dormant and released; 0 keeps all of them.
+  void set_dormancy_threshold(size_t threshold) {
+    dormancy_threshold_ = threshold;
+  }
+
  protected:
   void Elect();
+  void Remove(size_t k);
+  void ReleaseDormant();
 
   const CandidateList& previous_candidates_;
   vector<of<Translation>> translations_;
+  // whether each translation has been elected
+  vector<bool> elected_ever_;
   size_t elected_ = 0;
+  size_t yielded_ = 0;
+  size_t dormancy_threshold_ = 0;
 };
 
 class CacheTranslation : public Translation {
@@ -107,6 +143,7 @@ class CacheTranslation : public Translation {
 
   virtual bool Next();
   virtual an<Candidate> Peek();
+  size_t Fill(CandidateList* out, size_t n) override;
 
  protected:
   an<Translation> translation_;
@@ -122,6 +159,9 @@ class DistinctTranslation : public CacheTranslation {
  public:
   DistinctTranslation(an<Translation> translation);
   virtual bool Next();
+  size_t Fill(CandidateList* out, size_t n) override {
+    return Translation::Fill(out, n);
+  }
 
  protected:
   bool AlreadyHas(const string& text) const;
@@ -129,6 +169,34 @@ class DistinctTranslation : public CacheTranslation {
   set<string> candidate_set_;
 };
 
+// takes a candidate and returns the candidate to take its place, or nullptr
+// to drop it.
+using CandidateTransform = function<an<Candidate>(const an<Candidate>& cand)>;
+
+// Runs the transforms of several filters on each candidate in a single pass,
+// instead of a translation wrapped by each filter.
+class FusedFilterTranslation : public Translation {
+ public:
+  explicit FusedFilterTranslation(an<Translation> translation);
+
+  // the transform runs on candidates after those added before.
+  void AddTransform(CandidateTransform transform);
+
+  bool Next() override;
+  an<Candidate> Peek() override;
+  // candidates are taken from the translation in batches.
+  size_t Fill(CandidateList* out, size_t n) override;
+
+ protected:
+  an<Candidate> Transform(an<Candidate> cand) const;
+  bool LocateNextCandidate();
+
+  an<Translation> translation_;
+  vector<CandidateTransform> transforms_;
+  // the current candidate, having passed all transforms.
+  an<Candidate> cache_;
+};
+
 class PrefetchTranslation : public Translation {
  public:
   PrefetchTranslation(an<Translation> translation);
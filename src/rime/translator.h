@@ -27,6 +27,23 @@ class Translator : public Class<Translator, const Ticket&> {
 
   virtual an<Translation> Query(const string& input,
                                 const Segment& segment) = 0;
+  // releases caches kept across queries, while the session is idle.
+  virtual void Hibernate() {}
+  // writes through user data kept in memory; called as the session ends.
+  virtual void FlushUserData() {}
+  // loads and pages in resources ahead of the first query; called off the
+  // input thread.
+  virtual void WarmUp() {}
+  // whether candidates made off the input thread have arrived since last
+  // asked, for the composition to be made anew with them.
+  virtual bool TakeArrivals() { return false; }
+  // counts the distinct candidates Query() would give, up to limit, without
+  // making them; -1 if the translator cannot tell.
+  virtual int ProbeCandidates(const string& input,
+                              const Segment& segment,
+                              int limit) {
+    return -1;
+  }
 
   string name_space() const { return name_space_; }
 
@@ -0,0 +1,103 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <algorithm>
+#include <rime/cancellation.h>
+#include <rime/perf_counters.h>
+#include <rime/resource.h>
+#include <rime/worker_pool.h>
+
+namespace rime {
+
+static thread_local bool on_worker_thread = false;
+
+WorkerPool::WorkerPool(size_t num_threads) {
+  for (size_t i = 0; i < num_threads; ++i) {
+    threads_.emplace_back([this] { Work(); });
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  task_available_.notify_all();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+std::future<void> WorkerPool::Submit(function<void()> task) {
+  std::packaged_task<void()> packaged(std::move(task));
+  auto result = packaged.get_future();
+  if (on_worker_thread) {
+    packaged();
+    return result;
+  }
+  // the work is counted to the session that submits it, and cancelled
+  // along with the key it is done for; work for a deployment sees the
+  // files being deployed.
+  auto* counters = PerfCounters::current();
+  auto* cancellation = Cancellation::current();
+  bool deploying = FallbackResourceResolver::deploying();
+  if (counters || cancellation || deploying) {
+    packaged = std::packaged_task<void()>(
+        [counters, cancellation, deploying,
+         task = std::move(packaged)]() mutable {
+          PerfCounters::Activation counting(counters);
+          Cancellation::Activation cancelling(cancellation);
+          FallbackResourceResolver::Deploying deploying_files(deploying);
+          task();
+        });
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push(std::move(packaged));
+  }
+  task_available_.notify_one();
+  return result;
+}
+
+void WorkerPool::Work() {
+  on_worker_thread = true;
+  while (true) {
+    std::packaged_task<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      task_available_.wait(lock,
+                           [this] { return stopping_ || !tasks_.empty(); });
+      if (tasks_.empty())
+        return;  // stopping
+      task = std::move(tasks_.front());
+      tasks_.pop();
+      ++running_;
+    }
+    task();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (--running_ == 0 && tasks_.empty())
+        idle_.notify_all();
+    }
+  }
+}
+
+void WorkerPool::WaitUntilIdle() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_.wait(lock, [this] { return running_ == 0 && tasks_.empty(); });
+}
+
+bool WorkerPool::OnWorkerThread() {
+  return on_worker_thread;
+}
+
+WorkerPool& WorkerPool::Shared() {
+  const size_t kMaxThreads = 4;
+  static WorkerPool pool((std::max)(
+      size_t(1), (std::min)(kMaxThreads,
+                            size_t(std::thread::hardware_concurrency()))));
+  return pool;
+}
+
+}  // namespace rime
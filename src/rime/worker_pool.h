@@ -0,0 +1,54 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#ifndef RIME_WORKER_POOL_H_
+#define RIME_WORKER_POOL_H_
+
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <rime_api.h>
+#include <rime/common.h>
+
+namespace rime {
+
+// A fixed set of threads running short tasks, such as parts of a dictionary
+// lookup, on behalf of the calling thread.
+class RIME_API WorkerPool {
+ public:
+  explicit WorkerPool(size_t num_threads);
+  ~WorkerPool();
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  // tasks submitted from a worker thread run on the spot, so that waiting
+  // for them never blocks the workers.
+  std::future<void> Submit(function<void()> task);
+  size_t size() const { return threads_.size(); }
+  // waits for the tasks submitted so far, and those they submit, to finish;
+  // not to be called from a worker thread.
+  void WaitUntilIdle();
+
+  static bool OnWorkerThread();
+
+  // the pool shared by all sessions; threads are started on first use.
+  static WorkerPool& Shared();
+
+ private:
+  void Work();
+
+  std::mutex mutex_;
+  std::condition_variable task_available_;
+  std::condition_variable idle_;
+  std::queue<std::packaged_task<void()>> tasks_;
+  size_t running_ = 0;
+  bool stopping_ = false;
+  vector<std::thread> threads_;
+};
+
+}  // namespace rime
+
+#endif  // RIME_WORKER_POOL_H_
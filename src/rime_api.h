@@ -209,12 +209,57 @@ typedef struct rime_string_slice_t {
   size_t length;
 } RimeStringSlice;
 
+//! Counters of the work done by the engine
+/*!
+ *  Should be initialized by calling RIME_STRUCT_INIT(Type, var);
+ */
+typedef struct rime_perf_counters_t {
+  int data_size;
+  uint64_t dictionary_lookups;
+  uint64_t table_chunks_scanned;
+  uint64_t user_db_seeks;
+  uint64_t grammar_queries;
+  uint64_t candidates_materialized;
+  uint64_t candidates_displayed;
+  uint64_t bytes_allocated;
+  //! user dict lookups cut short by their budget
+  uint64_t user_dict_lookups_pruned;
+} RimePerfCounters;
+
+//! Memory held by a part of the engine
+typedef struct rime_memory_usage_t {
+  //! "table", "prism", "reverse_db", "string_table", "user_dict_cache",
+  //! "sessions" (all live sessions) or "session"
+  char* category;
+  //! the file path, the name of the user dict or the id of the session
+  char* name;
+  //! bytes of the file mapped into memory
+  uint64_t mapped_bytes;
+  //! estimated bytes of the mapping resident in memory
+  uint64_t resident_bytes;
+  //! bytes allocated on the heap, eg. for the arena of a session
+  uint64_t heap_bytes;
+  //! cached lookups, string table keys, sessions or candidates held by menus
+  uint64_t count;
+} RimeMemoryUsage;
+
+typedef struct rime_memory_stats_t {
+  size_t size;
+  RimeMemoryUsage* list;
+} RimeMemoryStats;
+
 /*!
  * - on loading schema:
  *   + message_type="schema", message_value="luna_pinyin/Luna Pinyin"
  * - on changing mode:
  *   + message_type="option", message_value="ascii_mode"
  *   + message_type="option", message_value="!ascii_mode"
+ * - on changing the context by processing keys, committing or clearing:
+ *   + message_type="context", message_value="input,preedit,menu,highlight"
+ *     listing only the parts that have changed.
+ * - on processing posted keys:
+ *   + message_type="keys", message_value="110"
+ *     telling whether each key is handled.
  * - on deployment:
  *   + session_id = 0, message_type="deploy", message_value="start"
  *   + session_id = 0, message_type="deploy", message_value="success"
@@ -244,6 +289,14 @@ typedef struct rime_module_t {
   void (*initialize)(void);
   void (*finalize)(void);
   RimeCustomApi* (*get_api)(void);
+  //! NULL-terminated list of component names provided by the module.
+  //! if present, the module is loaded when one of them is first looked up.
+  const char** components;
+  //! NULL-terminated list of the modules to be loaded before this one.
+  //! if present, the module is initialized on a thread of its own, in
+  //! parallel with other modules in the list being loaded, once the modules
+  //! it depends on are loaded.
+  const char** dependencies;
 } RimeModule;
 
 RIME_API Bool RimeRegisterModule(RimeModule* module);
@@ -267,6 +320,12 @@ typedef struct RIME_FLAVORED(rime_api_t) {
    *  - on changing mode:
    *    + message_type="option", message_value="ascii_mode"
    *    + message_type="option", message_value="!ascii_mode"
+   *  - on changing the context by processing keys, committing or clearing:
+   *    + message_type="context", message_value="input,preedit,menu,highlight"
+   *      listing only the parts that have changed.
+   *  - on processing posted keys:
+   *    + message_type="keys", message_value="110"
+   *      telling whether each key is handled.
    *  - on deployment:
    *    + session_id = 0, message_type="deploy", message_value="start"
    *    + session_id = 0, message_type="deploy", message_value="success"
@@ -299,6 +358,10 @@ typedef struct RIME_FLAVORED(rime_api_t) {
   Bool (*sync_user_data)(void);
 
   // session management
+  //
+  // sessions can be driven from different threads at the same time, as long
+  // as each session is used by one thread at a time. setup, initialize,
+  // maintenance and finalize are not to overlap with the use of sessions.
 
   RimeSessionId (*create_session)(void);
   Bool (*find_session)(RimeSessionId session_id);
@@ -501,6 +564,159 @@ typedef struct RIME_FLAVORED(rime_api_t) {
                                               size_t index);
 
   Bool (*change_page)(RimeSessionId session_id, Bool backward);
+
+  //! start or stop tracing the time spent by each engine component on the
+  //! key events of the session.
+  /*!
+   *  returns False if librime is built without ENABLE_TRACING.
+   */
+  Bool (*set_tracing)(RimeSessionId session_id, Bool enabled);
+  //! get the trace of the session in Chrome trace event JSON format.
+  /*!
+   *  copies at most buffer_size - 1 characters of the trace to buffer,
+   *  and returns the length of the whole trace, 0 if not traced.
+   *  the recorded events are cleared if clear is True and the whole trace
+   *  is copied.
+   */
+  size_t (*get_trace)(RimeSessionId session_id,
+                      char* buffer,
+                      size_t buffer_size,
+                      Bool clear);
+
+  //! get the counters of the work done for a session since it was created,
+  //! or for all sessions since the service was started if session_id is 0.
+  Bool (*get_perf_counters)(RimeSessionId session_id,
+                            RimePerfCounters* counters);
+
+  //! process a batch of key events, eg. relayed from a remote input source.
+  /*!
+   *  the input is composed once after the last key, rather than after each
+   *  key, unless the composition is needed to process a key in between.
+   *  if handled is not NULL, handled[i] is set to whether the i-th key is
+   *  accepted, as process_key would return for it.
+   *  returns the number of keys handled.
+   */
+  size_t (*process_keys)(RimeSessionId session_id,
+                         const int* keycodes,
+                         const int* masks,
+                         size_t count,
+                         Bool* handled);
+
+  //! get a number that changes whenever the context of the session may have
+  //! changed since it was last got, or 0 if there is no such session.
+  size_t (*get_context_revision)(RimeSessionId session_id);
+  //! get the context with strings lent by the session instead of copies.
+  /*!
+   *  the strings are kept until the session is destroyed, or until the
+   *  context is got again by this function after it has changed.
+   *  the context is not to be released by free_context.
+   *  an unchanged context is not made again, so polling the same revision
+   *  costs no copying.
+   */
+  Bool (*get_context_view)(RimeSessionId session_id,
+                           RIME_FLAVORED(RimeContext) * context);
+
+  //! serialize the status, the composition and the menu page of the session
+  //! into buffer in one go, eg. for passing to another process.
+  /*!
+   *  returns the size of the serialized context, or 0 if there is no such
+   *  session. the buffer holds the whole context only if the size returned
+   *  is not greater than buffer_size; call again with a larger buffer
+   *  otherwise.
+   *
+   *  integers are 4 bytes little-endian unless noted, strings are a length
+   *  followed by as many bytes of UTF-8 text without a terminating NUL.
+   *  format version 1:
+   *  - header: "RCTX", version, total size, revision (8 bytes)
+   *  - status: flags (bit 0 is_disabled, 1 is_composing, 2 is_ascii_mode,
+   *    3 is_full_shape, 4 is_simplified, 5 is_traditional, 6
+   *    is_ascii_punct), schema_id, schema_name
+   *  - composition: preedit, cursor_pos, sel_start, sel_end,
+   *    commit_text_preview
+   *  - menu: page_size, page_no, is_last_page, highlighted_candidate_index,
+   *    num_candidates, (text, comment) of each candidate, select_keys,
+   *    num_select_labels, each select label
+   *  fields may be appended in later versions.
+   */
+  size_t (*serialize_context)(RimeSessionId session_id,
+                              char* buffer,
+                              size_t buffer_size);
+
+  //! turn on or off the logs on the hot paths of a module, eg. "syllabifier",
+  //! "user_dictionary", "contextual_translation", "menu", "engine" or "all".
+  /*!
+   *  returns False if librime is built without ENABLE_HOT_PATH_LOGGING, or
+   *  there is no such module.
+   */
+  Bool (*set_hot_path_logging)(const char* module_name, Bool enabled);
+
+  //! get the memory held by loaded dictionary files, user dict caches and
+  //! sessions, one item for each, to be freed by free_memory_stats.
+  /*!
+   *  sessions busy on other threads are reported as they were last seen.
+   */
+  Bool (*get_memory_stats)(RimeMemoryStats* stats);
+  void (*free_memory_stats)(RimeMemoryStats* stats);
+
+  //! load the dictionaries of a schema in the background, and page in
+  //! their indexes, so that the first keystrokes do not wait for the disk.
+  /*!
+   *  the resources are kept loaded until the schemas are redeployed.
+   *  schemas are also warmed up as sessions are created or switch to them.
+   */
+  Bool (*warmup)(const char* schema_id);
+
+  //! load terms into a dictionary without deploying it again.
+  /*!
+   *  the file has a term on each line: text, code and optionally weight,
+   *  separated by tabs, as in the entries of a *.dict.yaml file.
+   *  the terms replace those loaded before into the same dictionary, and
+   *  are looked up by sessions as soon as the call returns, until the
+   *  dictionary is deployed again or librime is finalized.
+   */
+  Bool (*load_dictionary_overlay)(const char* dict_name, const char* file_path);
+
+  //! tell the key being processed for the session that a newer key arrived.
+  /*!
+   *  may be called from another thread while process_key or process_keys
+   *  is running for the session, which then leaves out the translation yet
+   *  to be done; the composition is to be made anew by the newer key.
+   */
+  Bool (*cancel_processing)(RimeSessionId session_id);
+
+  //! record the key events of a session into a key log, to be replayed.
+  /*!
+   *  the log keeps the time between key events, and the schema and options
+   *  changed between them. with hash_characters, printable characters are
+   *  replaced with others of their kind in the log.
+   *  \sa rime_replay
+   */
+  Bool (*start_key_recording)(RimeSessionId session_id,
+                              const char* file_path,
+                              Bool hash_characters);
+  Bool (*stop_key_recording)(RimeSessionId session_id);
+
+  //! queue a key event to be processed on a thread of the session.
+  /*!
+   *  returns at once, cancelling the key being processed for the session;
+   *  the keys queued by then are processed in a batch as process_keys does.
+   *  then the notification handler is called with message_type="keys" and
+   *  message_value listing whether each key is handled, eg. "110".
+   *  keys of a session are to be posted from one thread at a time, and
+   *  other calls for the session are to wait for the keys to be processed.
+   *  returns False if too many keys are queued.
+   */
+  Bool (*post_key)(RimeSessionId session_id, int keycode, int mask);
+  //! wait for the keys posted to the session to be processed.
+  Bool (*wait_for_posted_keys)(RimeSessionId session_id);
+
+  //! empty the caches of sessions and dictionaries, eg. when the system is
+  //! low on memory. they are filled again as keys are processed.
+  /*!
+   *  the memory held by caches in total is capped by cache/memory_limit
+   *  in megabytes, set in installation.yaml.
+   */
+  void (*release_memory)(void);
 } RIME_FLAVORED(RimeApi);
 
 //! API entry
@@ -571,6 +787,27 @@ RIME_API RIME_FLAVORED(RimeApi) * RIME_FLAVORED(rime_get_api)(void);
  */
 #define RIME_MODULE_LIST(var, ...) const char* var[] = {__VA_ARGS__, NULL}
 
+/*!
+ *  Register a module providing the listed components, which is loaded on
+ *  first use of any of them instead of when the module list is loaded.
+ */
+#define RIME_REGISTER_MODULE_PROVIDING(name, ...)                        \
+  static RIME_MODULE_LIST(rime_##name##_module_components, __VA_ARGS__); \
+  RIME_REGISTER_CUSTOM_MODULE(name) {                                    \
+    module->components = rime_##name##_module_components;                \
+  }
+
+/*!
+ *  Register a module depending on the listed modules only, which is
+ *  initialized in parallel with other modules once they are loaded.
+ *  Its initialize() function is called on a thread of its own.
+ */
+#define RIME_REGISTER_MODULE_DEPENDING(name, ...)                          \
+  static RIME_MODULE_LIST(rime_##name##_module_dependencies, __VA_ARGS__); \
+  RIME_REGISTER_CUSTOM_MODULE(name) {                                      \
+    module->dependencies = rime_##name##_module_dependencies;              \
+  }
+
 /*!
  *  Register a phony module which, when loaded, will load a list of modules.
  *  \sa setup.cc for an example.
@@ -6,11 +6,15 @@
 #include <rime/config.h>
 #include <rime/context.h>
 #include <rime/deployer.h>
+#include <rime/dict/dictionary.h>
+#include <rime/hot_log.h>
 #include <rime/key_event.h>
+#include <rime/memory_stats.h>
 #include <rime/menu.h>
 #include <rime/module.h>
 #include <rime/registry.h>
 #include <rime/schema.h>
+#include <rime/schema_index.h>
 #include <rime/service.h>
 #include <rime/setup.h>
 #include <rime/signature.h>
@@ -53,10 +57,14 @@ RIME_DEPRECATED void RimeInitialize(RimeTraits* traits) {
   LoadModules(RIME_PROVIDED(traits, modules) ? traits->modules
                                              : kDefaultModules);
   Service::instance().StartService();
+  // pages in the resources of the schema the first session starts with,
+  // while the frontend gets ready.
+  Service::instance().engine_pool().WarmUp(string());
 }
 
 RIME_DEPRECATED void RimeFinalize() {
   Service::instance().deployer().JoinMaintenanceThread();
+  Service::instance().engine_pool().Clear();
   Service::instance().StopService();
   Registry::instance().Clear();
   ModuleManager::instance().UnloadModules();
@@ -81,10 +89,14 @@ RIME_DEPRECATED Bool RimeStartMaintenance(Bool full_check) {
     }
     LOG(INFO) << "changes detected; starting maintenance.";
   }
+  // engines kept for new sessions would hold the schemas to be redeployed.
+  Service::instance().engine_pool().Clear();
   deployer.ScheduleTask("workspace_update");
   deployer.ScheduleTask("user_dict_upgrade");
+  deployer.ScheduleTask("user_dict_prune");
   deployer.ScheduleTask("cleanup_trash");
-  deployer.StartMaintenance();
+  // sessions keep typing with the files of the last build meanwhile.
+  deployer.StartMaintenance(true);
   return True;
 }
 
@@ -214,9 +226,15 @@ RIME_DEPRECATED Bool RimeGetContext(RimeSessionId session_id,
   an<Session> session(Service::instance().GetSession(session_id));
   if (!session)
     return False;
-  Context* ctx = session->context();
+  session->AmendTranslations();
+  const Context* ctx = session->context();
   if (!ctx)
     return False;
+  // the first page of candidates is made here.
+  PerfCounters::Activation counting(session->perf_counters());
+#ifdef RIME_ENABLE_TRACING
+  Tracer::Activation activation(session->tracer());
+#endif  // RIME_ENABLE_TRACING
   if (ctx->IsComposing()) {
     Preedit preedit = ctx->GetPreedit();
     context->composition.length = preedit.text.length();
@@ -234,7 +252,7 @@ RIME_DEPRECATED Bool RimeGetContext(RimeSessionId session_id,
     }
   }
   if (ctx->HasMenu()) {
-    Segment& seg(ctx->composition().back());
+    const Segment& seg(ctx->composition().back());
     int page_size = 5;
     Schema* schema = session->schema();
     if (schema)
@@ -374,7 +392,7 @@ RimeCandidateListFromIndex(RimeSessionId session_id,
   an<Session> session(Service::instance().GetSession(session_id));
   if (!session)
     return False;
-  Context* ctx = session->context();
+  const Context* ctx = session->context();
   if (!ctx || !ctx->HasMenu())
     return False;
   memset(iterator, 0, sizeof(RimeCandidateListIterator));
@@ -481,6 +499,7 @@ RIME_DEPRECATED Bool RimeGetSchemaList(RimeSchemaList* output) {
   if (!schema_list || schema_list->size() == 0)
     return False;
   output->list = new RimeSchemaListItem[schema_list->size()];
+  auto index = SchemaIndex::Get();
   for (size_t i = 0; i < schema_list->size(); ++i) {
     an<ConfigMap> item = As<ConfigMap>(schema_list->GetAt(i));
     if (!item)
@@ -492,9 +511,10 @@ RIME_DEPRECATED Bool RimeGetSchemaList(RimeSchemaList* output) {
     RimeSchemaListItem& x(output->list[output->size]);
     x.schema_id = new char[schema_id.length() + 1];
     strcpy(x.schema_id, schema_id.c_str());
-    Schema schema(schema_id);
-    x.name = new char[schema.schema_name().length() + 1];
-    strcpy(x.name, schema.schema_name().c_str());
+    const SchemaInfo* info = index ? index->Find(schema_id) : nullptr;
+    string name = info ? info->name : Schema(schema_id).schema_name();
+    x.name = new char[name.length() + 1];
+    strcpy(x.name, name.c_str());
     x.reserved = NULL;
     ++output->size;
   }
@@ -541,6 +561,7 @@ RIME_DEPRECATED Bool RimeSelectSchema(RimeSessionId session_id,
   if (!session)
     return False;
   session->ApplySchema(new Schema(schema_id));
+  Service::instance().engine_pool().WarmUp(schema_id, false);
   return True;
 }
 
@@ -772,9 +793,7 @@ RIME_DEPRECATED Bool RimeSimulateKeySequence(RimeSessionId session_id,
     LOG(ERROR) << "error parsing input: '" << key_sequence << "'";
     return False;
   }
-  for (const KeyEvent& key : keys) {
-    session->ProcessKey(key);
-  }
+  session->ProcessKeys(keys);
   return True;
 }
 
@@ -1103,11 +1122,11 @@ static RimeStringSlice RimeGetStateLabelAbbreviated(RimeSessionId session_id,
   an<Session> session(Service::instance().GetSession(session_id));
   if (!session)
     return {nullptr, 0};
-  Config* config = session->schema()->config();
-  if (!config)
+  Schema* schema = session->schema();
+  if (!schema || !option_name)
     return {nullptr, 0};
-  Switches switches(config);
-  StringSlice label = switches.GetStateLabel(option_name, state, abbreviated);
+  StringSlice label =
+      schema->switch_index().GetStateLabel(option_name, state, abbreviated);
   return {label.str, label.length};
 }
 
@@ -1118,6 +1137,436 @@ static const char* RimeGetStateLabel(RimeSessionId session_id,
       .str;
 }
 
+static Bool RimeSetTracing(RimeSessionId session_id, Bool enabled) {
+#ifdef RIME_ENABLE_TRACING
+  an<Session> session(Service::instance().GetSession(session_id));
+  if (!session)
+    return False;
+  session->tracer()->set_enabled(bool(enabled));
+  return True;
+#else
+  return False;
+#endif  // RIME_ENABLE_TRACING
+}
+
+static size_t RimeGetTrace(RimeSessionId session_id,
+                           char* buffer,
+                           size_t buffer_size,
+                           Bool clear) {
+#ifdef RIME_ENABLE_TRACING
+  an<Session> session(Service::instance().GetSession(session_id));
+  if (!session)
+    return 0;
+  string trace = session->tracer()->ToChromeTraceJson();
+  if (buffer && buffer_size > 0) {
+    size_t length = (std::min)(trace.length(), buffer_size - 1);
+    std::memcpy(buffer, trace.data(), length);
+    buffer[length] = '\0';
+    if (clear && length == trace.length())
+      session->tracer()->Clear();
+  }
+  return trace.length();
+#else
+  if (buffer && buffer_size > 0)
+    buffer[0] = '\0';
+  return 0;
+#endif  // RIME_ENABLE_TRACING
+}
+
+static size_t RimeGetContextRevision(RimeSessionId session_id) {
+  an<Session> session(Service::instance().GetSession(session_id));
+  if (!session)
+    return 0;
+  return session->context_revision();
+}
+
+// keeps the strings of the context in the session.
+static void update_context_view(Session* session,
+                                const Context* ctx,
+                                ContextView* view) {
+  *view = ContextView();
+  view->is_composing = ctx->IsComposing();
+  if (view->is_composing) {
+    Preedit preedit = ctx->GetPreedit();
+    view->preedit = preedit.text;
+    view->cursor_pos = preedit.caret_pos;
+    view->sel_start = preedit.sel_start;
+    view->sel_end = preedit.sel_end;
+    view->commit_text_preview = ctx->GetCommitText();
+  }
+  if (!ctx->HasMenu())
+    return;
+  const Segment& seg(ctx->composition().back());
+  int page_size = 5;
+  Schema* schema = session->schema();
+  if (schema)
+    page_size = schema->page_size();
+  int selected_index = seg.selected_index;
+  int page_no = selected_index / page_size;
+  the<Page> page(seg.menu->CreatePage(page_size, page_no));
+  if (!page)
+    return;
+  view->has_menu = true;
+  view->page_size = page_size;
+  view->page_no = page_no;
+  view->is_last_page = page->is_last_page;
+  view->highlighted_candidate_index = selected_index % page_size;
+  for (const an<Candidate>& cand : page->candidates) {
+    view->candidate_texts.push_back(cand->text());
+    view->candidate_comments.push_back(cand->comment());
+  }
+  // the strings are not to be moved once lent.
+  for (size_t i = 0; i < page->candidates.size(); ++i) {
+    RimeCandidate candidate = {0};
+    candidate.text = &view->candidate_texts[i][0];
+    if (!view->candidate_comments[i].empty())
+      candidate.comment = &view->candidate_comments[i][0];
+    view->candidates.push_back(candidate);
+  }
+  if (!schema)
+    return;
+  view->select_keys = schema->select_keys();
+  an<ConfigList> select_labels =
+      schema->config()->GetList("menu/alternative_select_labels");
+  if (select_labels && (size_t)page_size <= select_labels->size()) {
+    for (size_t i = 0; i < (size_t)page_size; ++i) {
+      an<ConfigValue> value = select_labels->GetValueAt(i);
+      view->select_labels.push_back(value->str());
+    }
+    for (string& label : view->select_labels) {
+      view->select_label_ptrs.push_back(&label[0]);
+    }
+  }
+}
+
+// the view of the context, made anew only if the context has changed.
+static ContextView* get_context_view(Session* session) {
+  const Context* ctx = session->context();
+  if (!ctx)
+    return nullptr;
+  ContextView& view(session->context_view());
+  size_t revision = session->context_revision();
+  if (view.revision != revision) {
+    // the first page of candidates is made here.
+    PerfCounters::Activation counting(session->perf_counters());
+#ifdef RIME_ENABLE_TRACING
+    Tracer::Activation activation(session->tracer());
+#endif  // RIME_ENABLE_TRACING
+    update_context_view(session, ctx, &view);
+    view.revision = revision;
+  }
+  return &view;
+}
+
+static Bool RimeGetContextView(RimeSessionId session_id,
+                               RIME_FLAVORED(RimeContext) * context) {
+  if (!context || context->data_size <= 0)
+    return False;
+  RIME_STRUCT_CLEAR(*context);
+  an<Session> session(Service::instance().GetSession(session_id));
+  if (!session)
+    return False;
+  ContextView* view = get_context_view(session.get());
+  if (!view)
+    return False;
+  if (view->is_composing) {
+    context->composition.length = view->preedit.length();
+    context->composition.preedit = &view->preedit[0];
+    context->composition.cursor_pos = view->cursor_pos;
+    context->composition.sel_start = view->sel_start;
+    context->composition.sel_end = view->sel_end;
+    if (RIME_STRUCT_HAS_MEMBER(*context, context->commit_text_preview) &&
+        !view->commit_text_preview.empty()) {
+      context->commit_text_preview = &view->commit_text_preview[0];
+    }
+  }
+  if (view->has_menu) {
+    context->menu.page_size = view->page_size;
+    context->menu.page_no = view->page_no;
+    context->menu.is_last_page = Bool(view->is_last_page);
+    context->menu.highlighted_candidate_index =
+        view->highlighted_candidate_index;
+    context->menu.num_candidates = view->candidates.size();
+    context->menu.candidates = view->candidates.data();
+    if (!view->select_keys.empty())
+      context->menu.select_keys = &view->select_keys[0];
+    if (RIME_STRUCT_HAS_MEMBER(*context, context->select_labels) &&
+        !view->select_label_ptrs.empty()) {
+      context->select_labels = view->select_label_ptrs.data();
+    }
+  }
+  return True;
+}
+
+// writes the fields of a serialized context in little-endian byte order,
+// counting the bytes needed past the end of the buffer.
+class ContextWriter {
+ public:
+  ContextWriter(char* buffer, size_t buffer_size)
+      : buffer_(buffer), capacity_(buffer ? buffer_size : 0) {}
+
+  void WriteInt(uint32_t x) {
+    char bytes[4];
+    for (int i = 0; i < 4; ++i) {
+      bytes[i] = char((x >> (8 * i)) & 0xff);
+    }
+    Write(bytes, sizeof(bytes));
+  }
+  void WriteInt64(uint64_t x) {
+    WriteInt(uint32_t(x & 0xffffffff));
+    WriteInt(uint32_t(x >> 32));
+  }
+  void WriteString(const string& str) {
+    WriteInt(uint32_t(str.length()));
+    Write(str.data(), str.length());
+  }
+  void Write(const char* data, size_t length) {
+    if (size_ + length <= capacity_)
+      std::memcpy(buffer_ + size_, data, length);
+    size_ += length;
+  }
+  void PatchInt(size_t offset, uint32_t x) {
+    if (offset + 4 > capacity_)
+      return;
+    for (int i = 0; i < 4; ++i) {
+      buffer_[offset + i] = char((x >> (8 * i)) & 0xff);
+    }
+  }
+  size_t size() const { return size_; }
+
+ private:
+  char* buffer_;
+  size_t capacity_;
+  size_t size_ = 0;
+};
+
+static const char kSerializedContextMagic[] = "RCTX";
+static const uint32_t kSerializedContextVersion = 1;
+
+static size_t RimeSerializeContext(RimeSessionId session_id,
+                                   char* buffer,
+                                   size_t buffer_size) {
+  an<Session> session(Service::instance().GetSession(session_id));
+  if (!session)
+    return 0;
+  Schema* schema = session->schema();
+  const Context* ctx = session->context();
+  if (!schema || !ctx)
+    return 0;
+  ContextView* view = get_context_view(session.get());
+  if (!view)
+    return 0;
+  ContextWriter writer(buffer, buffer_size);
+  // header
+  writer.Write(kSerializedContextMagic, 4);
+  writer.WriteInt(kSerializedContextVersion);
+  size_t total_size_offset = writer.size();
+  writer.WriteInt(0);
+  writer.WriteInt64(view->revision);
+  // status
+  uint32_t flags = 0;
+  const bool status_bits[] = {
+      Service::instance().disabled(),     ctx->IsComposing(),
+      ctx->get_option("ascii_mode"),      ctx->get_option("full_shape"),
+      ctx->get_option("simplification"), ctx->get_option("traditional"),
+      ctx->get_option("ascii_punct"),
+  };
+  for (size_t i = 0; i < sizeof(status_bits) / sizeof(bool); ++i) {
+    if (status_bits[i])
+      flags |= 1u << i;
+  }
+  writer.WriteInt(flags);
+  writer.WriteString(schema->schema_id());
+  writer.WriteString(schema->schema_name());
+  // composition
+  writer.WriteString(view->preedit);
+  writer.WriteInt(uint32_t(view->cursor_pos));
+  writer.WriteInt(uint32_t(view->sel_start));
+  writer.WriteInt(uint32_t(view->sel_end));
+  writer.WriteString(view->commit_text_preview);
+  // menu
+  writer.WriteInt(uint32_t(view->page_size));
+  writer.WriteInt(uint32_t(view->page_no));
+  writer.WriteInt(view->is_last_page ? 1 : 0);
+  writer.WriteInt(uint32_t(view->highlighted_candidate_index));
+  writer.WriteInt(uint32_t(view->candidate_texts.size()));
+  for (size_t i = 0; i < view->candidate_texts.size(); ++i) {
+    writer.WriteString(view->candidate_texts[i]);
+    writer.WriteString(view->candidate_comments[i]);
+  }
+  writer.WriteString(view->select_keys);
+  writer.WriteInt(uint32_t(view->select_labels.size()));
+  for (const string& label : view->select_labels) {
+    writer.WriteString(label);
+  }
+  writer.PatchInt(total_size_offset, uint32_t(writer.size()));
+  return writer.size();
+}
+
+static Bool RimeSetHotPathLogging(const char* module_name, Bool enabled) {
+#ifdef RIME_ENABLE_HOT_PATH_LOGGING
+  if (!module_name)
+    return False;
+  return Bool(HotLog::set_enabled(module_name, bool(enabled)));
+#else
+  return False;
+#endif  // RIME_ENABLE_HOT_PATH_LOGGING
+}
+
+static size_t RimeProcessKeys(RimeSessionId session_id,
+                              const int* keycodes,
+                              const int* masks,
+                              size_t count,
+                              Bool* handled) {
+  if (!keycodes || !masks)
+    return 0;
+  an<Session> session(Service::instance().GetSession(session_id));
+  if (!session)
+    return 0;
+  KeySequence keys;
+  keys.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    keys.push_back(KeyEvent(keycodes[i], masks[i]));
+  }
+  vector<bool> results;
+  size_t num_handled = session->ProcessKeys(keys, handled ? &results : nullptr);
+  for (size_t i = 0; handled && i < results.size(); ++i) {
+    handled[i] = Bool(results[i]);
+  }
+  return num_handled;
+}
+
+static Bool RimeGetPerfCounters(RimeSessionId session_id,
+                                RimePerfCounters* counters) {
+  if (!counters || counters->data_size <= 0)
+    return False;
+  PerfCounters* source = &Service::instance().perf_counters();
+  an<Session> session;
+  if (session_id) {
+    session = Service::instance().GetSession(session_id);
+    if (!session)
+      return False;
+    source = session->perf_counters();
+  }
+  RIME_STRUCT_CLEAR(*counters);
+  counters->dictionary_lookups =
+      source->get(PerfCounters::kDictionaryLookups);
+  counters->table_chunks_scanned =
+      source->get(PerfCounters::kTableChunksScanned);
+  counters->user_db_seeks = source->get(PerfCounters::kUserDbSeeks);
+  counters->grammar_queries = source->get(PerfCounters::kGrammarQueries);
+  counters->candidates_materialized =
+      source->get(PerfCounters::kCandidatesMaterialized);
+  counters->candidates_displayed =
+      source->get(PerfCounters::kCandidatesDisplayed);
+  counters->bytes_allocated = source->get(PerfCounters::kBytesAllocated);
+  if (RIME_STRUCT_HAS_MEMBER(*counters, counters->user_dict_lookups_pruned)) {
+    counters->user_dict_lookups_pruned =
+        source->get(PerfCounters::kUserDictLookupsPruned);
+  }
+  return True;
+}
+
+static Bool RimeGetMemoryStats(RimeMemoryStats* stats) {
+  if (!stats)
+    return False;
+  stats->size = 0;
+  stats->list = NULL;
+  vector<MemoryUsage> usages = MemoryStats::Collect();
+  Service::instance().ReportMemoryUsage(&usages);
+  if (usages.empty())
+    return True;
+  stats->list = new RimeMemoryUsage[usages.size()];
+  for (const auto& usage : usages) {
+    RimeMemoryUsage& x(stats->list[stats->size++]);
+    x.category = new char[usage.category.length() + 1];
+    std::strcpy(x.category, usage.category.c_str());
+    x.name = new char[usage.name.length() + 1];
+    std::strcpy(x.name, usage.name.c_str());
+    x.mapped_bytes = usage.mapped_bytes;
+    x.resident_bytes = usage.resident_bytes;
+    x.heap_bytes = usage.heap_bytes;
+    x.count = usage.count;
+  }
+  return True;
+}
+
+static void RimeFreeMemoryStats(RimeMemoryStats* stats) {
+  if (!stats)
+    return;
+  for (size_t i = 0; stats->list && i < stats->size; ++i) {
+    delete[] stats->list[i].category;
+    delete[] stats->list[i].name;
+  }
+  delete[] stats->list;
+  stats->size = 0;
+  stats->list = NULL;
+}
+
+static Bool RimeWarmUp(const char* schema_id) {
+  if (!schema_id || Service::instance().disabled())
+    return False;
+  Service::instance().engine_pool().WarmUp(schema_id);
+  return True;
+}
+
+static void RimeReleaseMemory() {
+  Service::instance().memory_budget().Release();
+}
+
+static Bool RimeLoadDictionaryOverlay(const char* dict_name,
+                                      const char* file_path) {
+  if (!dict_name || !file_path || Service::instance().disabled())
+    return False;
+  auto component =
+      dynamic_cast<DictionaryComponent*>(Dictionary::Require("dictionary"));
+  if (!component)
+    return False;
+  return Bool(component->LoadOverlay(dict_name, path(file_path)));
+}
+
+static Bool RimeCancelProcessing(RimeSessionId session_id) {
+  an<Session> session(Service::instance().GetSession(session_id));
+  if (!session)
+    return False;
+  session->cancellation()->Request();
+  return True;
+}
+
+static Bool RimeStartKeyRecording(RimeSessionId session_id,
+                                  const char* file_path,
+                                  Bool hash_characters) {
+  if (!file_path)
+    return False;
+  an<Session> session(Service::instance().GetSession(session_id));
+  if (!session)
+    return False;
+  return Bool(session->StartRecording(path(file_path), bool(hash_characters)));
+}
+
+static Bool RimeStopKeyRecording(RimeSessionId session_id) {
+  an<Session> session(Service::instance().GetSession(session_id));
+  if (!session)
+    return False;
+  session->StopRecording();
+  return True;
+}
+
+static Bool RimePostKey(RimeSessionId session_id, int keycode, int mask) {
+  an<Session> session(Service::instance().GetSession(session_id));
+  if (!session)
+    return False;
+  return Bool(session->PostKey(KeyEvent(keycode, mask)));
+}
+
+static Bool RimeWaitForPostedKeys(RimeSessionId session_id) {
+  an<Session> session(Service::instance().GetSession(session_id));
+  if (!session)
+    return False;
+  session->WaitForPostedKeys();
+  return True;
+}
+
 void RimeGetSharedDataDirSecure(char* dir, size_t buffer_size);
 void RimeGetUserDataDirSecure(char* dir, size_t buffer_size);
 void RimeGetPrebuiltDataDirSecure(char* dir, size_t buffer_size);
@@ -1228,6 +1677,24 @@ RIME_API RIME_FLAVORED(RimeApi) * RIME_FLAVORED(rime_get_api)() {
     s_api.highlight_candidate_on_current_page =
         &RimeHighlightCandidateOnCurrentPage;
     s_api.change_page = &RimeChangePage;
+    s_api.set_tracing = &RimeSetTracing;
+    s_api.get_trace = &RimeGetTrace;
+    s_api.get_perf_counters = &RimeGetPerfCounters;
+    s_api.process_keys = &RimeProcessKeys;
+    s_api.get_context_revision = &RimeGetContextRevision;
+    s_api.get_context_view = &RimeGetContextView;
+    s_api.serialize_context = &RimeSerializeContext;
+    s_api.set_hot_path_logging = &RimeSetHotPathLogging;
+    s_api.get_memory_stats = &RimeGetMemoryStats;
+    s_api.free_memory_stats = &RimeFreeMemoryStats;
+    s_api.warmup = &RimeWarmUp;
+    s_api.load_dictionary_overlay = &RimeLoadDictionaryOverlay;
+    s_api.cancel_processing = &RimeCancelProcessing;
+    s_api.start_key_recording = &RimeStartKeyRecording;
+    s_api.stop_key_recording = &RimeStopKeyRecording;
+    s_api.post_key = &RimePostKey;
+    s_api.wait_for_posted_keys = &RimeWaitForPostedKeys;
+    s_api.release_memory = &RimeReleaseMemory;
   }
   return &s_api;
 }
@@ -4,7 +4,9 @@
 //
 // 2012-01-19 GONG Chen <chen.sst@gmail.com>
 //
+#include <atomic>
 #include <cmath>
+#include <thread>
 #include <gtest/gtest.h>
 #include <rime/common.h>
 #include <rime/algo/algebra.h>
@@ -76,3 +78,100 @@ TEST(RimeAlgebraTest, Projection) {
   EXPECT_EQ(rime::kAbbreviation, s["sh"][0].properties.type);
   EXPECT_DOUBLE_EQ(log(0.5), s["sh"][0].properties.credibility);
 }
+
+TEST(RimeAlgebraTest, SharedProjection) {
+  auto c = rime::New<rime::ConfigList>();
+  c->Append(rime::New<rime::ConfigValue>(kTransliteration));
+  c->Append(rime::New<rime::ConfigValue>(kTransformation));
+  auto p = rime::Projection::Shared(c);
+  ASSERT_TRUE(bool(p));
+  auto same = rime::New<rime::ConfigList>();
+  same->Append(rime::New<rime::ConfigValue>(kTransliteration));
+  same->Append(rime::New<rime::ConfigValue>(kTransformation));
+  EXPECT_EQ(p, rime::Projection::Shared(same));
+  auto other = rime::New<rime::ConfigList>();
+  other->Append(rime::New<rime::ConfigValue>(kTransliteration));
+  EXPECT_NE(p, rime::Projection::Shared(other));
+
+  rime::string str("Shang");
+  EXPECT_TRUE(p->Apply(&str));
+  EXPECT_EQ("sang", str);
+}
+
+TEST(RimeAlgebraTest, MemoizedApply) {
+  auto c = rime::New<rime::ConfigList>();
+  c->Append(rime::New<rime::ConfigValue>(kTransformation));
+  rime::Projection p;
+  ASSERT_TRUE(p.Load(c));
+  for (int i = 0; i < 2; ++i) {
+    rime::string str("zhang");
+    EXPECT_TRUE(p.Apply(&str));
+    EXPECT_EQ("zang", str);
+    rime::string unchanged("bang");
+    EXPECT_FALSE(p.Apply(&unchanged));
+    EXPECT_EQ("bang", unchanged);
+  }
+  // reloading forgets the results of the former formulas.
+  auto d = rime::New<rime::ConfigList>();
+  d->Append(rime::New<rime::ConfigValue>(kTransliteration));
+  ASSERT_TRUE(p.Load(d));
+  rime::string str("zhang");
+  EXPECT_FALSE(p.Apply(&str));
+  EXPECT_EQ("zhang", str);
+}
+
+TEST(RimeAlgebraTest, MemoizedApplyFromThreads) {
+  auto c = rime::New<rime::ConfigList>();
+  c->Append(rime::New<rime::ConfigValue>(kTransformation));
+  auto p = rime::Projection::Shared(c);
+  ASSERT_TRUE(bool(p));
+  std::atomic<int> mismatches{0};
+  rime::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&p, &mismatches] {
+      for (int j = 0; j < 1000; ++j) {
+        rime::string str(j % 2 == 0 ? "zhang" : "bang");
+        bool modified = p->Apply(&str);
+        if (modified != (j % 2 == 0) || str != (j % 2 == 0 ? "zang" : "bang"))
+          ++mismatches;
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(0, mismatches);
+}
+
+class TestProjection : public rime::Projection {
+ public:
+  size_t memo_bytes() const { return *memo_bytes_; }
+  static const size_t kMemoSize = kMaxMemoSize;
+};
+
+TEST(RimeAlgebraTest, MemoUsage) {
+  auto c = rime::New<rime::ConfigList>();
+  c->Append(rime::New<rime::ConfigValue>(kTransformation));
+  TestProjection p;
+  ASSERT_TRUE(p.Load(c));
+  auto apply = [&p](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      rime::string str("zh" + std::to_string(i));
+      p.Apply(&str);
+    }
+  };
+  apply(0, TestProjection::kMemoSize);
+  size_t full = p.memo_bytes();
+  EXPECT_LT(0, full);
+  // the memo is emptied when full, and its bytes are no longer counted
+  apply(TestProjection::kMemoSize, 2 * TestProjection::kMemoSize);
+  EXPECT_GE(full, p.memo_bytes());
+  size_t before = p.memo_bytes();
+  std::thread([&apply] { apply(0, 100); }).join();
+  // the memo of the thread is gone with it
+  EXPECT_EQ(before, p.memo_bytes());
+  // reloading empties the memo of this thread on its next use
+  ASSERT_TRUE(p.Load(c));
+  apply(0, 1);
+  EXPECT_GT(before, p.memo_bytes());
+}
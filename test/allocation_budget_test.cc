@@ -0,0 +1,128 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <cstdlib>
+#include <new>
+#include <gtest/gtest.h>
+#include <rime/common.h>
+#include <rime/context.h>
+#include <rime/key_event.h>
+#include <rime/memory_stats.h>
+#include <rime/menu.h>
+#include <rime/schema.h>
+#include <rime/segmentation.h>
+#include <rime/service.h>
+#include <rime/trace.h>
+#include <rime/worker_pool.h>
+#include "dictionary_test_fixture.h"
+
+// counts the heap allocations made by the tests, and by the library if it
+// shares the operator new of the executable; built into a test executable
+// of its own, so that other tests are not affected.
+void* operator new(std::size_t size) {
+  rime::AllocationCounts::Count(size);
+  if (void* p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+  std::free(p);
+}
+
+using namespace rime;
+
+// the means per keystroke of a warm round as measured by this test, each
+// allowed kBudgetMargin over it; 0 where not yet measured, when the test
+// only reports the counts. lower them as allocations are eliminated; raise
+// them only deliberately.
+static const uint64_t kBaselineAllocationsPerKey = 0;
+static const uint64_t kBaselineBytesPerKey = 0;
+static const double kBudgetMargin = 0.25;
+
+class RimeAllocationBudgetTest : public DictionaryTestFixture {};
+
+// keys each followed by a look at the first page of candidates, as a
+// frontend updating its candidate window would take.
+static void Replay(Session* session, const KeySequence& keys) {
+  for (const KeyEvent& key : keys) {
+    session->ProcessKey(key);
+    Context* ctx = session->context();
+    if (!ctx->HasMenu())
+      continue;
+    Segment& seg = ctx->composition().back();
+    the<Page> page(seg.menu->CreatePage(session->schema()->page_size(), 0));
+  }
+}
+
+// the allocations of a replay on all threads, including the work it leaves
+// to the worker pool, such as parallel lookups and prefetching the menu.
+static AllocationCounts MeasureReplay(Session* session,
+                                      const KeySequence& keys) {
+  AllocationCounts before = AllocationCounts::total();
+  Replay(session, keys);
+  WorkerPool::Shared().WaitUntilIdle();
+  AllocationCounts after = AllocationCounts::total();
+  AllocationCounts counts;
+  counts.allocations = (after.allocations - before.allocations) / keys.size();
+  counts.bytes = (after.bytes - before.bytes) / keys.size();
+  return counts;
+}
+
+static bool WithinBudget(uint64_t measured, uint64_t baseline) {
+  return measured <= baseline * (1 + kBudgetMargin);
+}
+
+TEST_F(RimeAllocationBudgetTest, TypingAndSelecting) {
+  Service& service = Service::instance();
+  SessionId id = service.CreateSession();
+  an<Session> session = service.GetSession(id);
+  ASSERT_TRUE(bool(session));
+  session->ApplySchema(new Schema("concurrency_test"));
+  KeySequence keys("nihao{space}zhongguo{space}ni{BackSpace}{Escape}");
+  // the first round loads the dictionaries and fills the caches.
+  Replay(session.get(), keys);
+  WorkerPool::Shared().WaitUntilIdle();
+  AllocationCounts per_key = MeasureReplay(session.get(), keys);
+  RecordProperty("allocations_per_key", std::to_string(per_key.allocations));
+  RecordProperty("bytes_per_key", std::to_string(per_key.bytes));
+  if (kBaselineAllocationsPerKey > 0) {
+    EXPECT_PRED2(WithinBudget, per_key.allocations,
+                 kBaselineAllocationsPerKey);
+  }
+  if (kBaselineBytesPerKey > 0) {
+    EXPECT_PRED2(WithinBudget, per_key.bytes, kBaselineBytesPerKey);
+  }
+  // warm rounds allocate alike; more each round means a cache never stops
+  // growing.
+  AllocationCounts next_round = MeasureReplay(session.get(), keys);
+  EXPECT_PRED2(WithinBudget, next_round.allocations, per_key.allocations);
+  EXPECT_PRED2(WithinBudget, next_round.bytes, per_key.bytes);
+#ifdef RIME_ENABLE_TRACING
+  Tracer* tracer = session->tracer();
+  tracer->Clear();
+  tracer->set_enabled(true);
+  Replay(session.get(), keys);
+  WorkerPool::Shared().WaitUntilIdle();
+  // the share of each component, nested scopes included in the outer ones.
+  map<string, AllocationCounts> components;
+  for (const auto& event : tracer->events()) {
+    auto& counts = components[string(event.category) + "/" + event.name];
+    counts.allocations += event.allocations;
+    counts.bytes += event.allocated_bytes;
+  }
+  for (const auto& x : components) {
+    RecordProperty(x.first + "/allocations_per_key",
+                   std::to_string(x.second.allocations / keys.size()));
+    RecordProperty(x.first + "/bytes_per_key",
+                   std::to_string(x.second.bytes / keys.size()));
+  }
+  tracer->set_enabled(false);
+#endif  // RIME_ENABLE_TRACING
+  service.DestroySession(id);
+}
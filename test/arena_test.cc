@@ -0,0 +1,49 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <rime/arena.h>
+#include <rime/common.h>
+#include <rime/context.h>
+#include <rime/dict/vocabulary.h>
+
+using namespace rime;
+
+TEST(RimeArenaTest, AlignedAllocation) {
+  Arena arena(64);
+  for (size_t size = 1; size < 100; size += 7) {
+    void* p = arena.Allocate(size, alignof(double));
+    ASSERT_TRUE(p != nullptr);
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(p) % alignof(double));
+  }
+  // oversized allocations get their own block
+  EXPECT_TRUE(arena.Allocate(1000, 8) != nullptr);
+  EXPECT_LE(1000, arena.capacity());
+}
+
+TEST(RimeArenaTest, NewInWithoutArena) {
+  auto entry = NewIn<DictEntry>(nullptr);
+  ASSERT_TRUE(bool(entry));
+  entry->text = "heap";
+  EXPECT_EQ("heap", entry->text);
+}
+
+TEST(RimeArenaTest, ObjectsOutliveClearedComposition) {
+  Context ctx;
+  an<Arena> arena = ctx.arena();
+  ASSERT_TRUE(bool(arena));
+  EXPECT_EQ(arena, ctx.arena());
+  auto entry = NewIn<DictEntry>(arena);
+  entry->text = "a string too long to fit in the small-string buffer";
+  entry->code.push_back(1);
+  arena.reset();
+  ctx.Clear();
+  // a new arena is started for the next composition
+  EXPECT_TRUE(bool(ctx.arena()));
+  // while the old one lives on with its objects
+  EXPECT_EQ("a string too long to fit in the small-string buffer", entry->text);
+  EXPECT_EQ(1, entry->code.size());
+}
@@ -0,0 +1,60 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <chrono>
+#include <thread>
+#include <gtest/gtest.h>
+#include <rime/async_translator.h>
+#include <rime/candidate.h>
+#include <rime/segmentation.h>
+#include <rime/ticket.h>
+#include <rime/translation.h>
+
+using namespace rime;
+
+class EchoTranslator : public AsyncTranslator {
+ public:
+  explicit EchoTranslator(const Ticket& ticket) : AsyncTranslator(ticket) {}
+
+  int jobs = 0;
+
+ protected:
+  Job MakeJob(const string& input, const Segment& segment) override {
+    ++jobs;
+    size_t start = segment.start;
+    size_t end = segment.end;
+    return [input, start, end] {
+      return CandidateList{New<SimpleCandidate>("echo", start, end, input)};
+    };
+  }
+};
+
+static bool WaitForArrivals(Translator* translator) {
+  for (int i = 0; i < 100; ++i) {
+    if (translator->TakeArrivals())
+      return true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return false;
+}
+
+TEST(RimeAsyncTranslatorTest, CandidatesArriveLater) {
+  Ticket ticket;
+  EchoTranslator translator(ticket);
+  Segment segment(0, 3);
+  EXPECT_FALSE(translator.TakeArrivals());
+  EXPECT_EQ(nullptr, translator.Query("abc", segment));
+  ASSERT_TRUE(WaitForArrivals(&translator));
+  EXPECT_FALSE(translator.TakeArrivals());
+  auto translation = translator.Query("abc", segment);
+  ASSERT_TRUE(bool(translation));
+  auto cand = translation->Peek();
+  ASSERT_TRUE(bool(cand));
+  EXPECT_EQ("abc", cand->text());
+  EXPECT_EQ(1, translator.jobs);
+  // a query for other input starts another job.
+  EXPECT_EQ(nullptr, translator.Query("abcd", Segment(0, 4)));
+  ASSERT_TRUE(WaitForArrivals(&translator));
+  EXPECT_EQ(2, translator.jobs);
+}
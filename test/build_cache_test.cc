@@ -0,0 +1,52 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <gtest/gtest.h>
+#include <rime/common.h>
+#include <rime/dict/build_cache.h>
+
+using namespace rime;
+
+static void WriteFile(const path& file_path, const string& content) {
+  std::ofstream out(file_path.c_str(), std::ios::binary);
+  out << content;
+}
+
+static string ReadFile(const path& file_path) {
+  std::ifstream in(file_path.c_str(), std::ios::binary);
+  std::stringstream buffer;
+  buffer << in.rdbuf();
+  return buffer.str();
+}
+
+TEST(RimeBuildCacheTest, DisabledByDefault) {
+  const path file_path("build_cache_test.table.bin");
+  WriteFile(file_path, "built");
+  EXPECT_FALSE(BuildCache::Store(file_path, {1}));
+  EXPECT_FALSE(BuildCache::Fetch(file_path, {1}));
+}
+
+TEST(RimeBuildCacheTest, FetchesFileBuiltFromSameSources) {
+  const path cache_dir("build_cache_test");
+  std::filesystem::remove_all(cache_dir);
+  BuildCache::set_directory(cache_dir);
+  const path built("build_cache_test.table.bin");
+  WriteFile(built, "built from 1");
+  EXPECT_TRUE(BuildCache::Store(built, {1, 2}));
+  const path other_user_dir("build_cache_test_user");
+  std::filesystem::create_directories(other_user_dir);
+  const path target = other_user_dir / "build_cache_test.table.bin";
+  WriteFile(target, "outdated");
+  EXPECT_FALSE(BuildCache::Fetch(target, {1, 3}));
+  EXPECT_EQ("outdated", ReadFile(target));
+  EXPECT_TRUE(BuildCache::Fetch(target, {1, 2}));
+  EXPECT_EQ("built from 1", ReadFile(target));
+  // files of another name are not the same.
+  EXPECT_FALSE(
+      BuildCache::Fetch(other_user_dir / "build_cache_test.prism.bin", {1, 2}));
+  BuildCache::set_directory(path());
+}
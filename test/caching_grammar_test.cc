@@ -0,0 +1,82 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <gtest/gtest.h>
+#include <rime/config.h>
+#include <rime/gear/caching_grammar.h>
+
+using namespace rime;
+
+class CountingGrammar : public Grammar {
+ public:
+  explicit CountingGrammar(int* queries) : queries_(queries) {}
+
+  double Query(const string& context,
+               const string& word,
+               bool is_rear) override {
+    ++*queries_;
+    return -double(context.length() + word.length()) - (is_rear ? 0.5 : 0.0);
+  }
+
+ private:
+  int* queries_;
+};
+
+TEST(RimeCachingGrammarTest, Query) {
+  int queries = 0;
+  CachingGrammar grammar(new CountingGrammar(&queries),
+                         New<GrammarCache>(1024));
+  EXPECT_DOUBLE_EQ(-3.0, grammar.Query("a", "bc", false));
+  EXPECT_DOUBLE_EQ(-3.0, grammar.Query("a", "bc", false));
+  EXPECT_DOUBLE_EQ(-3.5, grammar.Query("a", "bc", true));
+  EXPECT_EQ(2, queries);
+  auto stats = grammar.cache()->stats();
+  EXPECT_EQ(1u, stats.hits);
+  EXPECT_EQ(2u, stats.misses);
+}
+
+TEST(RimeCachingGrammarTest, QueryBatch) {
+  int queries = 0;
+  CachingGrammar grammar(new CountingGrammar(&queries),
+                         New<GrammarCache>(1024));
+  string a("a"), b("bb"), c("ccc"), x("x"), y("yy");
+  vector<double> scores;
+  grammar.QueryBatch(x, {&a, &b}, false, &scores);
+  EXPECT_EQ((vector<double>{-2.0, -3.0}), scores);
+  EXPECT_EQ(2, queries);
+  grammar.QueryBatch(vector<const string*>{&x, &y}, {&a, &b, &c}, false,
+                     &scores);
+  EXPECT_EQ((vector<double>{-2.0, -3.0, -4.0, -3.0, -4.0, -5.0}), scores);
+  EXPECT_EQ(6, queries);
+  EXPECT_DOUBLE_EQ(2.0 / 8, grammar.cache()->stats().hit_rate());
+}
+
+TEST(RimeCachingGrammarTest, SharedCache) {
+  int queries = 0;
+  Config config;
+  config.SetInt("grammar/cache_size", 16);
+  config.SetString("grammar/language", "test");
+  the<Grammar> one(CachingGrammar::Wrap(new CountingGrammar(&queries),
+                                        &config));
+  the<Grammar> other(CachingGrammar::Wrap(new CountingGrammar(&queries),
+                                          &config));
+  auto* caching = dynamic_cast<CachingGrammar*>(one.get());
+  ASSERT_TRUE(caching != nullptr);
+  EXPECT_EQ(16u, caching->cache()->capacity());
+  EXPECT_EQ(caching->cache(),
+            dynamic_cast<CachingGrammar*>(other.get())->cache());
+  one->Query("a", "b", false);
+  other->Query("a", "b", false);
+  EXPECT_EQ(1, queries);
+  // differently configured models do not share the cache.
+  config.SetString("grammar/language", "another");
+  the<Grammar> another(CachingGrammar::Wrap(new CountingGrammar(&queries),
+                                            &config));
+  another->Query("a", "b", false);
+  EXPECT_EQ(2, queries);
+  config.SetInt("grammar/cache_size", 0);
+  the<Grammar> uncached(CachingGrammar::Wrap(new CountingGrammar(&queries),
+                                             &config));
+  EXPECT_TRUE(dynamic_cast<CachingGrammar*>(uncached.get()) == nullptr);
+}
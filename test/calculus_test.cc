@@ -77,3 +77,35 @@ TEST(RimeCalculusTest, Abbreviation) {
   EXPECT_EQ(rime::kAbbreviation, s.properties.type);
   EXPECT_DOUBLE_EQ(log(0.5), s.properties.credibility);
 }
+
+TEST(RimeCalculusTest, LiteralPatterns) {
+  // each literal rule should work the same as the regex rule next to it.
+  const char* kRules[][2] = {
+      {"xform/ng/n/", "xform/(?:ng)/n/"},
+      {"xform/^zh/z/", "xform/^(?:zh)/z/"},
+      {"xform/ng$/n/", "xform/(?:ng)$/n/"},
+      {"xform/^ng$/en/", "xform/^(?:ng)$/en/"},
+      {"derive/a/ā/", "derive/(?:a)/ā/"},
+      {"fuzz/an/ang/", "fuzz/(?:an)/ang/"},
+      {"abbrev/^sh/s/", "abbrev/^(?:sh)/s/"},
+      {"erase/^ng$/", "erase/^(?:ng)$/"},
+      {"erase/ng/", "erase/(?:ng)/"},
+  };
+  const char* kSpellings[] = {"ng",  "zhang", "ngang", "shan",
+                              "nga", "a",     "banana"};
+  rime::Calculus calc;
+  for (const auto& rule : kRules) {
+    rime::the<rime::Calculation> literal(calc.Parse(rule[0]));
+    rime::the<rime::Calculation> regex(calc.Parse(rule[1]));
+    ASSERT_TRUE(bool(literal)) << rule[0];
+    ASSERT_TRUE(bool(regex)) << rule[1];
+    for (const char* spelling : kSpellings) {
+      rime::Spelling expected(spelling);
+      rime::Spelling actual(spelling);
+      EXPECT_EQ(regex->Apply(&expected), literal->Apply(&actual))
+          << rule[0] << " " << spelling;
+      EXPECT_EQ(expected.str, actual.str) << rule[0] << " " << spelling;
+      EXPECT_EQ(expected.properties.type, actual.properties.type);
+    }
+  }
+}
@@ -0,0 +1,58 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <gtest/gtest.h>
+#include <rime/cancellation.h>
+#include <rime/worker_pool.h>
+
+using namespace rime;
+
+TEST(RimeCancellationTest, RequestedOnCurrentThread) {
+  Cancellation cancellation;
+  cancellation.Request();
+  EXPECT_FALSE(Cancellation::Requested());
+  {
+    Cancellation::Activation cancelling(&cancellation);
+    EXPECT_TRUE(Cancellation::Requested());
+    cancellation.Reset();
+    EXPECT_FALSE(Cancellation::Requested());
+  }
+  cancellation.Request();
+  EXPECT_EQ(nullptr, Cancellation::current());
+  EXPECT_FALSE(Cancellation::Requested());
+}
+
+TEST(RimeCancellationTest, CancelsWorkOnWorkerThreads) {
+  Cancellation cancellation;
+  Cancellation::Activation cancelling(&cancellation);
+  bool requested = false;
+  cancellation.Request();
+  WorkerPool::Shared()
+      .Submit([&requested] { requested = Cancellation::Requested(); })
+      .get();
+  EXPECT_TRUE(requested);
+}
+
+TEST(RimeCancellationTest, CancelsEarlierGenerationsOnly) {
+  Cancellation cancellation;
+  cancellation.Begin(1);
+  EXPECT_FALSE(cancellation.requested());
+  // a key numbered 3 is posted while the batch of keys 1 is processed.
+  cancellation.RequestBefore(3);
+  EXPECT_TRUE(cancellation.requested());
+  // the batch of keys up to 3 has begun before a request of key 3 arrives.
+  cancellation.Begin(3);
+  EXPECT_FALSE(cancellation.requested());
+  cancellation.RequestBefore(2);
+  cancellation.RequestBefore(3);
+  EXPECT_FALSE(cancellation.requested());
+  cancellation.RequestBefore(4);
+  EXPECT_TRUE(cancellation.requested());
+  cancellation.Reset();
+  EXPECT_FALSE(cancellation.requested());
+  cancellation.Request();
+  EXPECT_TRUE(cancellation.requested());
+  cancellation.Begin(4);
+  EXPECT_FALSE(cancellation.requested());
+}
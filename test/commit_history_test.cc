@@ -0,0 +1,41 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <gtest/gtest.h>
+#include <rime/commit_history.h>
+
+using namespace rime;
+
+TEST(RimeCommitHistoryTest, KeepsLatestRecords) {
+  CommitHistory history;
+  EXPECT_TRUE(history.empty());
+  for (size_t i = 0; i < CommitHistory::kMaxRecords + 2; ++i) {
+    history.Push(CommitRecord("raw", std::to_string(i)));
+  }
+  ASSERT_EQ(CommitHistory::kMaxRecords, history.size());
+  EXPECT_EQ("2", history.front().text);
+  EXPECT_EQ(std::to_string(CommitHistory::kMaxRecords + 1),
+            history.latest_text());
+  size_t i = CommitHistory::kMaxRecords + 1;
+  for (auto it = history.rbegin(); it != history.rend(); ++it, --i) {
+    EXPECT_EQ(std::to_string(i), it->text);
+  }
+  EXPECT_EQ(1, i);
+  history.clear();
+  EXPECT_TRUE(history.empty());
+  EXPECT_TRUE(history.preceding_text().empty());
+}
+
+TEST(RimeCommitHistoryTest, PrecedingText) {
+  CommitHistory history;
+  history.Push(CommitRecord("table", "\xe4\xbd\xa0\xe5\xa5\xbd"));  // 你好
+  EXPECT_EQ("\xe4\xbd\xa0\xe5\xa5\xbd", history.preceding_text());
+  history.Push(CommitRecord(','));
+  EXPECT_EQ("\xe4\xbd\xa0\xe5\xa5\xbd,", history.preceding_text());
+  history.Push(CommitRecord("raw", "abcdef"));
+  // the last 8 code points, across records.
+  EXPECT_EQ("\xe5\xa5\xbd,abcdef", history.preceding_text());
+  EXPECT_EQ("[table]\xe4\xbd\xa0\xe5\xa5\xbd[thru],[raw]abcdef",
+            history.repr());
+}
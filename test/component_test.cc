@@ -4,9 +4,12 @@
 //
 // 2011-04-07 GONG Chen <chen.sst@gmail.com>
 //
+#include <atomic>
 #include <gtest/gtest.h>
+#include <rime_api.h>
 #include <rime/common.h>
 #include <rime/component.h>
+#include <rime/module.h>
 
 using namespace rime;
 
@@ -62,3 +65,74 @@ TEST(RimeComponentTest, UnknownComponent) {
   // unregistered component class
   EXPECT_FALSE(Registry::instance().Find("test_unknown"));
 }
+
+TEST(RimeComponentTest, LoadingModuleOnDemand) {
+  Registry& r = Registry::instance();
+  int loaded = 0;
+  ModuleManager::instance().LoadOnDemand(
+      "test_greetings", {"test_evening", "test_night"}, [&] {
+        ++loaded;
+        r.Register("test_evening", new HelloComponent("good evening"));
+        r.Register("test_night", new HelloComponent("good night"));
+      });
+  EXPECT_EQ(0, loaded);
+  EXPECT_TRUE(Greeting::Require("test_missing") == NULL);
+  EXPECT_EQ(0, loaded);
+  Greeting::Component* ge = Greeting::Require("test_evening");
+  ASSERT_TRUE(ge != NULL);
+  EXPECT_EQ(1, loaded);
+  the<Greeting> g(ge->Create("michael"));
+  EXPECT_STREQ("good evening, michael!", g->Say().c_str());
+  // the module is loaded only once.
+  EXPECT_TRUE(Greeting::Require("test_night") != NULL);
+  EXPECT_EQ(1, loaded);
+
+  r.Unregister("test_evening");
+  r.Unregister("test_night");
+}
+
+static std::atomic<int> s_initialized{0};
+static std::atomic<int> s_base_order{0};
+static std::atomic<int> s_left_order{0};
+static std::atomic<int> s_right_order{0};
+
+static void test_base_initialize() {
+  s_base_order = ++s_initialized;
+}
+
+static void test_left_initialize() {
+  s_left_order = ++s_initialized;
+}
+
+static void test_right_initialize() {
+  s_right_order = ++s_initialized;
+}
+
+TEST(RimeComponentTest, LoadingModulesInParallel) {
+  static RIME_MODULE_LIST(dependencies, "test_base");
+  static RimeModule base = {0}, left = {0}, right = {0};
+  RIME_STRUCT_INIT(RimeModule, base);
+  base.module_name = "test_base";
+  base.initialize = test_base_initialize;
+  RIME_STRUCT_INIT(RimeModule, left);
+  left.module_name = "test_left";
+  left.initialize = test_left_initialize;
+  left.dependencies = dependencies;
+  RIME_STRUCT_INIT(RimeModule, right);
+  right.module_name = "test_right";
+  right.initialize = test_right_initialize;
+  right.dependencies = dependencies;
+  ModuleManager& mm(ModuleManager::instance());
+  mm.Register("test_base", &base);
+  mm.Register("test_left", &left);
+  mm.Register("test_right", &right);
+  // the dependency is loaded first, even if listed after.
+  mm.LoadModules({&left, &right, &base});
+  EXPECT_EQ(3, s_initialized);
+  EXPECT_EQ(1, s_base_order);
+  EXPECT_LT(1, s_left_order);
+  EXPECT_LT(1, s_right_order);
+  // modules are loaded only once.
+  mm.LoadModules({&base, &left, &right});
+  EXPECT_EQ(3, s_initialized);
+}
@@ -0,0 +1,57 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <thread>
+#include <gtest/gtest.h>
+#include <rime/common.h>
+#include <rime/context.h>
+#include <rime/key_event.h>
+#include <rime/schema.h>
+#include <rime/service.h>
+#include "dictionary_test_fixture.h"
+
+using namespace rime;
+
+class RimeConcurrentSessionsTest : public DictionaryTestFixture {};
+
+TEST_F(RimeConcurrentSessionsTest, TypeInSessionsOnThreads) {
+  const int kNumThreads = 4;
+  const int kRounds = 50;
+  Service& service = Service::instance();
+  vector<SessionId> sessions(kNumThreads, kInvalidSessionId);
+  vector<int> commits(kNumThreads, 0);
+  vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([&service, &sessions, &commits, i] {
+      // sessions are created and set up on the threads that use them.
+      SessionId id = service.CreateSession();
+      sessions[i] = id;
+      an<Session> session = service.GetSession(id);
+      if (!session)
+        return;
+      session->ApplySchema(new Schema("concurrency_test"));
+      KeySequence keys("nihao{space}zhongguo{space}");
+      for (int round = 0; round < kRounds; ++round) {
+        session->ResetCommitText();
+        for (const KeyEvent& key : keys) {
+          session->ProcessKey(key);
+        }
+        if (!session->commit_text().empty())
+          ++commits[i];
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  for (int i = 0; i < kNumThreads; ++i) {
+    ASSERT_NE(kInvalidSessionId, sessions[i]);
+    EXPECT_EQ(kRounds, commits[i]);
+    an<Session> session = service.GetSession(sessions[i]);
+    ASSERT_TRUE(bool(session));
+    EXPECT_EQ("concurrency_test", session->schema()->schema_id());
+    EXPECT_TRUE(session->context()->input().empty());
+    EXPECT_TRUE(service.DestroySession(sessions[i]));
+  }
+}
@@ -7,6 +7,7 @@
 #include <gtest/gtest.h>
 #include <rime/component.h>
 #include <rime/config.h>
+#include <rime/config/config_compiler.h>
 
 using namespace rime;
 
@@ -264,3 +265,21 @@ TEST_F(RimeConfigCircularDependencyTest, BestEffortResolution) {
   EXPECT_TRUE(config_->GetString(prefix + "work", &work));
   EXPECT_EQ("excited", work);
 }
+
+TEST(RimeConfigCompileSessionTest, SharesParsedSourceFiles) {
+  ConfigCompileSession session;
+  // the same files are compiled again with sources parsed the first time.
+  for (int i = 0; i < 2; ++i) {
+    the<Config::Component> component(new ConfigComponent<ConfigBuilder>);
+    the<Config> config(component->Create("config_compiler_test"));
+    const string& prefix = "include_external_file/";
+    EXPECT_TRUE(config->IsNull(prefix + "__include"));
+    int number = 0;
+    EXPECT_TRUE(config->GetInt(prefix + "terrans/supply/produced", &number));
+    EXPECT_EQ(28, number);
+    string actual;
+    EXPECT_TRUE(config->GetString(
+        "include_local_reference/@0/terrans/player", &actual));
+    EXPECT_EQ("slayers_boxer", actual);
+  }
+}
@@ -8,6 +8,7 @@
 #include <gtest/gtest.h>
 #include <rime/component.h>
 #include <rime/config.h>
+#include <rime/config/config_data.h>
 
 using namespace rime;
 
@@ -293,3 +294,102 @@ TEST(RimeConfigListKeyPathTest, Greetings) {
   EXPECT_TRUE(config->GetInt("list/@last/id", &id));
   EXPECT_EQ(6, id);
 }
+
+TEST(RimeConfigDataTest, BinaryRoundTrip) {
+  ConfigData data;
+  EXPECT_TRUE(data.TraverseWrite("greetings", New<ConfigValue>("Hello!")));
+  auto list = New<ConfigList>();
+  list->Append(New<ConfigValue>(1));
+  list->Append(nullptr);
+  list->Append(New<ConfigMap>());
+  EXPECT_TRUE(data.TraverseWrite("list", list));
+  EXPECT_TRUE(data.TraverseWrite("map/empty", New<ConfigValue>("")));
+  path yaml_file{"config_binary_test.yaml"};
+  path binary_file = ConfigData::BinaryFilePath(yaml_file);
+  EXPECT_EQ(path{"config_binary_test.bin"}, binary_file);
+  ASSERT_TRUE(data.SaveToFile(yaml_file));
+  ASSERT_TRUE(data.SaveToBinaryFile(binary_file, yaml_file));
+  ConfigData loaded;
+  ASSERT_TRUE(loaded.LoadFromBinaryFile(binary_file, yaml_file));
+  auto value = As<ConfigValue>(loaded.Traverse("greetings"));
+  ASSERT_TRUE(bool(value));
+  EXPECT_EQ("Hello!", value->str());
+  auto loaded_list = As<ConfigList>(loaded.Traverse("list"));
+  ASSERT_TRUE(bool(loaded_list));
+  ASSERT_EQ(3, loaded_list->size());
+  EXPECT_EQ("1", loaded_list->GetValueAt(0)->str());
+  EXPECT_FALSE(loaded_list->GetAt(1));
+  EXPECT_EQ(ConfigItem::kMap, loaded_list->GetAt(2)->type());
+  value = As<ConfigValue>(loaded.Traverse("map/empty"));
+  ASSERT_TRUE(bool(value));
+  EXPECT_EQ("", value->str());
+  // loaded nodes are copied on write.
+  EXPECT_TRUE(loaded.TraverseWrite("map/b", New<ConfigValue>("b")));
+  EXPECT_TRUE(loaded.TraverseWrite("map/a", New<ConfigValue>("a")));
+  auto loaded_map = As<ConfigMap>(loaded.Traverse("map"));
+  ASSERT_TRUE(bool(loaded_map));
+  vector<string> keys;
+  for (const auto& entry : *loaded_map)
+    keys.push_back(entry.first);
+  EXPECT_EQ((vector<string>{"a", "b", "empty"}), keys);
+  // loading the YAML file prefers the binary one.
+  ConfigData loaded_from_yaml;
+  ASSERT_TRUE(loaded_from_yaml.LoadFromFile(yaml_file, nullptr));
+  EXPECT_EQ(yaml_file, loaded_from_yaml.file_path());
+  EXPECT_TRUE(bool(loaded_from_yaml.Traverse("list/@2")));
+  // the binary file is outdated once the YAML file changes.
+  EXPECT_TRUE(data.TraverseWrite("greetings", New<ConfigValue>("Bye!")));
+  ASSERT_TRUE(data.SaveToFile(yaml_file));
+  ConfigData outdated;
+  EXPECT_FALSE(outdated.LoadFromBinaryFile(binary_file, yaml_file));
+}
+
+TEST(RimeConfigDataTest, CachedTraversal) {
+  auto data = New<ConfigData>();
+  data->set_cache_traversal(true);
+  Config config(data);
+  EXPECT_TRUE(config.SetString("punctuator/full_shape/a", "A"));
+  EXPECT_TRUE(config.SetString("list/@next", "first"));
+  ConfigPath full_shape_a("punctuator/full_shape/a");
+  EXPECT_EQ("punctuator/full_shape/a", full_shape_a.str());
+  EXPECT_EQ(3, full_shape_a.keys().size());
+  string value;
+  EXPECT_TRUE(config.GetString(full_shape_a, &value));
+  EXPECT_EQ("A", value);
+  EXPECT_FALSE(config.GetString("punctuator/half_shape/a", &value));
+  EXPECT_TRUE(config.GetString("list/@last", &value));
+  EXPECT_EQ("first", value);
+  // writing clears the nodes found before.
+  EXPECT_TRUE(config.SetString("punctuator/full_shape/a", "AA"));
+  EXPECT_TRUE(config.SetString("punctuator/half_shape/a", "a"));
+  EXPECT_TRUE(config.GetString(full_shape_a, &value));
+  EXPECT_EQ("AA", value);
+  EXPECT_TRUE(config.GetString("punctuator/half_shape/a", &value));
+  EXPECT_EQ("a", value);
+  EXPECT_TRUE(config.SetString("list/@next", "second"));
+  EXPECT_TRUE(config.GetString("list/@last", &value));
+  EXPECT_EQ("second", value);
+  config["punctuator"]["half_shape"]["a"] = "b";
+  EXPECT_TRUE(config.GetString("punctuator/half_shape/a", &value));
+  EXPECT_EQ("b", value);
+}
+
+TEST(RimeConfigDataTest, TraversedItemsAreSnapshots) {
+  auto data = New<ConfigData>();
+  Config config(data);
+  EXPECT_TRUE(config.SetString("menu/page_size", "5"));
+  an<ConfigItem> root = *config;
+  auto menu = As<ConfigMap>(data->Traverse("menu"));
+  ASSERT_TRUE(bool(menu));
+  auto page_size = data->Traverse("menu/page_size");
+  EXPECT_TRUE(config.SetString("menu/page_size", "9"));
+  EXPECT_TRUE(config.SetString("menu/alternative_select_keys", "ABC"));
+  // the nodes in use are left as they were
+  EXPECT_EQ("5", As<ConfigValue>(menu->Get("page_size"))->str());
+  EXPECT_FALSE(menu->HasKey("alternative_select_keys"));
+  EXPECT_EQ("5", As<ConfigValue>(page_size)->str());
+  EXPECT_NE(root, *config);
+  string value;
+  EXPECT_TRUE(config.GetString("menu/page_size", &value));
+  EXPECT_EQ("9", value);
+}
@@ -0,0 +1,129 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <thread>
+#include <gtest/gtest.h>
+#include <rime/context.h>
+#include <rime/menu.h>
+
+using namespace rime;
+
+TEST(RimeContextTest, DeferredCompose) {
+  Context ctx;
+  int composed = 0;
+  auto compose = [&composed](Context* ctx) {
+    ++composed;
+    ctx->set_composition(Composition());
+    ctx->composition().Reset(ctx->input());
+  };
+  ctx.PushInput("abc");
+  ctx.DeferCompose(compose);
+  ctx.PushInput('d');
+  ctx.DeferCompose(compose);
+  EXPECT_EQ(0, composed);
+  // reading the input does not compose.
+  EXPECT_EQ("abcd", ctx.input());
+  EXPECT_TRUE(ctx.IsComposing());
+  EXPECT_EQ(0, composed);
+  EXPECT_EQ("abcd", ctx.composition().input());
+  EXPECT_EQ(1, composed);
+  ctx.ComposePending();
+  EXPECT_EQ(1, composed);
+}
+
+TEST(RimeContextTest, ClearDropsPendingCompose) {
+  Context ctx;
+  int composed = 0;
+  ctx.PushInput("abc");
+  ctx.DeferCompose([&composed](Context* ctx) { ++composed; });
+  ctx.Clear();
+  EXPECT_FALSE(ctx.IsComposing());
+  EXPECT_EQ(0, composed);
+}
+
+TEST(RimeContextTest, Revision) {
+  Context ctx;
+  size_t revision = ctx.revision();
+  ctx.PushInput("abc");
+  EXPECT_NE(revision, ctx.revision());
+  revision = ctx.revision();
+  // reading does not change the revision.
+  const Context& const_ctx(ctx);
+  EXPECT_TRUE(const_ctx.IsComposing());
+  EXPECT_TRUE(const_ctx.composition().empty());
+  EXPECT_FALSE(const_ctx.HasMenu());
+  EXPECT_EQ(revision, ctx.revision());
+  ctx.set_option("soft_cursor", true);
+  EXPECT_NE(revision, ctx.revision());
+  revision = ctx.revision();
+  // the composition may be modified via a mutable reference.
+  ctx.composition();
+  EXPECT_NE(revision, ctx.revision());
+}
+
+TEST(RimeContextTest, Hibernate) {
+  Context ctx;
+  int translated = 0;
+  auto translate = [&translated](Context* ctx) {
+    ++translated;
+    for (Segment& seg : ctx->composition()) {
+      if (seg.status == Segment::kVoid) {
+        seg.status = Segment::kGuess;
+        seg.menu = New<Menu>();
+        seg.selected_index = 0;
+      }
+    }
+  };
+  ctx.PushInput("abcd");
+  Composition comp;
+  comp.Reset("abcd");
+  Segment selected(0, 2);
+  selected.status = Segment::kSelected;
+  selected.menu = New<Menu>();
+  comp.push_back(selected);
+  Segment guess(2, 4);
+  guess.status = Segment::kGuess;
+  guess.menu = New<Menu>();
+  guess.selected_index = 3;
+  comp.push_back(guess);
+  ctx.set_composition(std::move(comp));
+  ctx.Hibernate(translate);
+  EXPECT_TRUE(ctx.has_pending_compose());
+  EXPECT_EQ("abcd", ctx.input());
+  EXPECT_EQ(0, translated);
+  // the menu is made anew on demand, with the highlighted index restored.
+  const auto& restored = ctx.composition();
+  EXPECT_EQ(1, translated);
+  ASSERT_EQ(2, restored.size());
+  EXPECT_EQ(selected.menu, restored[0].menu);
+  EXPECT_EQ(Segment::kGuess, restored[1].status);
+  EXPECT_TRUE(bool(restored[1].menu));
+  EXPECT_EQ(3, restored[1].selected_index);
+}
+
+TEST(RimeContextTest, LatencyBudget) {
+  Context ctx;
+  EXPECT_FALSE(ctx.OverLatencyBudget());
+  ctx.StartLatencyBudget(std::chrono::milliseconds(1));
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  EXPECT_FALSE(ctx.degraded());
+  EXPECT_TRUE(ctx.OverLatencyBudget());
+  EXPECT_TRUE(ctx.degraded());
+  // no limit for the next composition.
+  ctx.StartLatencyBudget(std::chrono::milliseconds(0));
+  EXPECT_FALSE(ctx.degraded());
+  EXPECT_FALSE(ctx.OverLatencyBudget());
+}
+
+TEST(RimeContextTest, SharedResultsLastForComposition) {
+  Context ctx;
+  ctx.PushInput("abc");
+  auto results = New<int>(42);
+  ctx.shared_results("answer") = results;
+  ctx.PushInput('d');
+  EXPECT_EQ(results, ctx.shared_results("answer"));
+  EXPECT_FALSE(ctx.shared_results("question"));
+  ctx.Clear();
+  EXPECT_FALSE(ctx.shared_results("answer"));
+}
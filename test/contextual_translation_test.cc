@@ -0,0 +1,68 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <gtest/gtest.h>
+#include <chrono>
+#include <thread>
+#include <rime/dict/vocabulary.h>
+#include <rime/gear/contextual_translation.h>
+#include <rime/gear/grammar.h>
+#include <rime/gear/translator_commons.h>
+
+using namespace rime;
+
+// prefers words of higher numbers, and takes its time.
+class SlowGrammar : public Grammar {
+ public:
+  double Query(const string& context,
+               const string& word,
+               bool is_rear) override {
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    return std::stoi(word.substr(1));
+  }
+};
+
+static an<Translation> make_phrases(int count) {
+  auto translation = New<FifoTranslation>();
+  for (int i = 0; i < count; ++i) {
+    auto entry = New<DictEntry>();
+    entry->text = "w" + std::to_string(i);
+    translation->Append(New<Phrase>(nullptr, "phrase", 0, 2, entry));
+  }
+  return translation;
+}
+
+static vector<string> collect_texts(Translation* translation) {
+  vector<string> texts;
+  while (!translation->exhausted()) {
+    texts.push_back(translation->Peek()->text());
+    translation->Next();
+  }
+  return texts;
+}
+
+TEST(RimeContextualTranslationTest, Rerank) {
+  SlowGrammar grammar;
+  ContextualTranslation translation(make_phrases(10), "ab", "", &grammar);
+  auto texts = collect_texts(&translation);
+  ASSERT_EQ(10u, texts.size());
+  EXPECT_EQ("w9", texts.front());
+  EXPECT_EQ("w0", texts.back());
+}
+
+TEST(RimeContextualTranslationTest, TimeBudget) {
+  SlowGrammar grammar;
+  auto before = ContextualTranslation::stats();
+  ContextualTranslation translation(make_phrases(20), "ab", "", &grammar);
+  translation.set_time_budget(1, 5);
+  auto texts = collect_texts(&translation);
+  // each page of candidates is ranked on its own once over the budget.
+  EXPECT_EQ((vector<string>{"w4", "w3", "w2", "w1", "w0", "w9", "w8", "w7",
+                            "w6", "w5", "w14", "w13", "w12", "w11", "w10",
+                            "w19", "w18", "w17", "w16", "w15"}),
+            texts);
+  auto after = ContextualTranslation::stats();
+  EXPECT_EQ(3u, after.over_budget_count - before.over_budget_count);
+  EXPECT_EQ(4u, after.replenish_count - before.replenish_count);
+}
@@ -156,3 +156,136 @@ TEST_F(RimeCorrectorTest, CaseMultipleEdges1) {
   ASSERT_FALSE(sp2.end() == sp2.find(syllable_id_["jue"]));
   ASSERT_TRUE(sp2[syllable_id_["jue"]].type == rime::kNormalSpelling);
 }
+
+// all strings up to the length over a small alphabet with keyboard
+// neighbours.
+static rime::vector<rime::string> enumerate_strings(size_t max_length) {
+  rime::vector<rime::string> result{""};
+  for (size_t begin = 0, length = 0; length < max_length; ++length) {
+    size_t end = result.size();
+    for (size_t i = begin; i < end; ++i) {
+      for (char c : rime::string("qwea")) {
+        result.push_back(result[i] + c);
+      }
+    }
+    begin = end;
+  }
+  return result;
+}
+
+// the restricted edit distance counting each operation as 1.
+static size_t unit_distance(const rime::string& s1, const rime::string& s2) {
+  size_t len1 = s1.size(), len2 = s2.size();
+  rime::vector<rime::vector<size_t>> d(len1 + 1,
+                                       rime::vector<size_t>(len2 + 1));
+  for (size_t i = 0; i <= len1; ++i)
+    d[i][0] = i;
+  for (size_t j = 0; j <= len2; ++j)
+    d[0][j] = j;
+  for (size_t i = 1; i <= len1; ++i) {
+    for (size_t j = 1; j <= len2; ++j) {
+      d[i][j] = (std::min)({d[i - 1][j] + 1, d[i][j - 1] + 1,
+                            d[i - 1][j - 1] + (s1[i - 1] != s2[j - 1])});
+      if (i > 1 && j > 1 && s1[i - 2] == s2[j - 1] && s1[i - 1] == s2[j - 2])
+        d[i][j] = (std::min)(d[i][j], d[i - 2][j - 2] + 1);
+    }
+  }
+  return d[len1][len2];
+}
+
+TEST(RimeEditDistanceTest, BitParallelDistance) {
+  auto strings = enumerate_strings(4);
+  for (const auto& s1 : strings) {
+    for (const auto& s2 : strings) {
+      EXPECT_EQ(unit_distance(s1, s2),
+                rime::EditDistanceCorrector::BitParallelDistance(s1, s2))
+          << s1 << " " << s2;
+    }
+  }
+}
+
+// the distances cut off by the bit-parallel one never fall within the
+// threshold, so the same corrections are found.
+TEST(RimeEditDistanceTest, BoundsRestrictedDistance) {
+  rime::EditDistanceCorrector corrector(rime::path{"corrector_test.bin"});
+  auto strings = enumerate_strings(4);
+  const size_t kNoThreshold = 1000;
+  for (const auto& s1 : strings) {
+    for (const auto& s2 : strings) {
+      auto distance = corrector.RestrictedDistance(s1, s2, kNoThreshold);
+      EXPECT_LE(rime::EditDistanceCorrector::BitParallelDistance(s1, s2),
+                distance)
+          << s1 << " " << s2;
+      for (size_t threshold : {1, 2, 5}) {
+        auto bounded = corrector.RestrictedDistance(s1, s2, threshold);
+        if (bounded <= threshold) {
+          EXPECT_EQ(distance, bounded) << s1 << " " << s2;
+        }
+      }
+    }
+  }
+}
+
+TEST(RimeSymDeleteCollectorTest, CollectInShards) {
+  rime::Syllabary syllabary;
+  for (char a = 'a'; a <= 'z'; ++a) {
+    for (char b = 'a'; b <= 'z'; ++b) {
+      syllabary.insert(rime::string{a, b, 'n'});
+    }
+  }
+  ASSERT_GT(syllabary.size(), rime::SymDeleteCollector::kMinShardSize * 2);
+  rime::SymDeleteCollector collector(syllabary);
+  rime::Script script = collector.Collect(1);
+  // the same as deleting each character of the syllables in order.
+  rime::map<rime::string, rime::vector<rime::string>> expected;
+  for (const auto& syllable : syllabary) {
+    for (size_t i = 0; i < syllable.length(); ++i) {
+      rime::string deleted(syllable);
+      deleted.erase(i, 1);
+      expected[deleted].push_back(syllable);
+    }
+  }
+  ASSERT_EQ(expected.size(), script.size());
+  for (const auto& x : expected) {
+    const auto& spellings = script[x.first];
+    ASSERT_EQ(x.second.size(), spellings.size()) << x.first;
+    for (size_t i = 0; i < spellings.size(); ++i) {
+      EXPECT_EQ(x.second[i], spellings[i].str) << x.first;
+      EXPECT_EQ(x.second[i], spellings[i].properties.tips) << x.first;
+    }
+  }
+}
+
+TEST_F(RimeCorrectorSearchTest, IncrementalCorrections) {
+  const char* inputs[] = {
+      "c",         "ch",     "chs",   "chsn",      "chsng", "chsngt",
+      "chsngtyan", "chsngt", "chsng", "chabgtyan", "tyan",  "",
+  };
+  rime::Syllabifier s;
+  s.EnableCorrection(corrector_.get());
+  rime::SyllabifierCache cache;
+  for (const char* input : inputs) {
+    rime::SyllableGraph expected;
+    rime::SyllableGraph actual;
+    EXPECT_EQ(s.BuildSyllableGraph(input, *prism_, &expected),
+              s.BuildSyllableGraph(input, *prism_, &actual, &cache))
+        << "input: " << input;
+    EXPECT_EQ(expected.interpreted_length, actual.interpreted_length);
+    EXPECT_EQ(expected.vertices, actual.vertices);
+    ASSERT_EQ(expected.edges.size(), actual.edges.size());
+    for (const auto& start : expected.edges) {
+      const auto& ends = actual.edges.at(start.first);
+      ASSERT_EQ(start.second.size(), ends.size()) << "input: " << input;
+      for (const auto& end : start.second) {
+        const auto& spellings = ends.at(end.first);
+        ASSERT_EQ(end.second.size(), spellings.size());
+        for (const auto& spelling : end.second) {
+          EXPECT_EQ(spelling.second.is_correction,
+                    spellings.at(spelling.first).is_correction);
+        }
+      }
+    }
+  }
+  // corrections are kept from one input to the next.
+  EXPECT_FALSE(cache.corrections.empty());
+}
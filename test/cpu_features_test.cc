@@ -0,0 +1,52 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <gtest/gtest.h>
+#include <rime/algo/cpu_features.h>
+
+using namespace rime;
+
+using Function = int (*)();
+
+static int portable() {
+  return 0;
+}
+
+static int sse42() {
+  return 1;
+}
+
+static int avx2() {
+  return 2;
+}
+
+TEST(RimeCpuFeaturesTest, SelectKernel) {
+  Kernel<Function> kernel{portable, sse42, avx2};
+  CpuFeatures none;
+  EXPECT_EQ(0, kernel.Select(none)());
+  CpuFeatures sse42_only;
+  sse42_only.sse42 = true;
+  EXPECT_EQ(1, kernel.Select(sse42_only)());
+  CpuFeatures all;
+  all.sse42 = all.avx2 = all.neon = true;
+  EXPECT_EQ(2, kernel.Select(all)());
+}
+
+TEST(RimeCpuFeaturesTest, SkipMissingVariants) {
+  Kernel<Function> kernel{portable};
+  CpuFeatures all;
+  all.sse42 = all.avx2 = all.neon = true;
+  EXPECT_EQ(0, kernel.Select(all)());
+}
+
+TEST(RimeCpuFeaturesTest, DetectOnce) {
+  const CpuFeatures& features = cpu_features();
+  EXPECT_EQ(&features, &cpu_features());
+#if defined(RIME_KERNEL_X86)
+  EXPECT_FALSE(features.neon);
+#if defined(__AVX2__)
+  EXPECT_TRUE(features.avx2);
+#endif
+#endif
+}
@@ -5,11 +5,18 @@
 // 2011-07-05 GONG Chen <chen.sst@gmail.com>
 //
 #include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
 #include <rime/common.h>
 #include <rime/algo/encoder.h>
 #include <rime/algo/syllabifier.h>
+#include <rime/algo/utilities.h>
 #include <rime/dict/dictionary.h>
 #include <rime/dict/dict_compiler.h>
+#include <rime/deployer.h>
+#include <rime/registry.h>
+#include <rime/service.h>
+#include <rime/worker_pool.h>
 
 class RimeDictionaryTest : public ::testing::Test {
  public:
@@ -101,3 +108,297 @@ TEST_F(RimeDictionaryTest, ScriptLookup) {
   EXPECT_EQ(9, e3->text.length());
   EXPECT_FALSE(d7.Next());
 }
+
+TEST_F(RimeDictionaryTest, FilterEntryViews) {
+  ASSERT_TRUE(dict_->loaded());
+  const rime::string kRejected = "\xe5\x92\x8b";  // 咋
+  rime::DictEntryIterator expected;
+  dict_->LookupWords(&expected, "z", true);
+  expected.AddFilter([&](rime::an<rime::DictEntry> e) {
+    return e->text != kRejected;
+  });
+  rime::DictEntryIterator it;
+  dict_->LookupWords(&it, "z", true);
+  it.AddViewFilter([&](const rime::DictEntryView& e) {
+    return e.text() != kRejected;
+  });
+  ASSERT_FALSE(it.exhausted());
+  size_t count = 0;
+  do {
+    ASSERT_FALSE(expected.exhausted());
+    EXPECT_EQ(expected.Peek()->text, it.Peek()->text);
+    EXPECT_EQ(it.PeekView().text(), it.Peek()->text);
+    EXPECT_EQ(it.PeekView().weight(), it.Peek()->weight);
+    EXPECT_NE(kRejected, it.Peek()->text);
+    ++count;
+    expected.Next();
+  } while (it.Next());
+  EXPECT_TRUE(expected.exhausted());
+  EXPECT_LT(1, count);
+}
+
+TEST_F(RimeDictionaryTest, MergedEntriesByWeight) {
+  ASSERT_TRUE(dict_->loaded());
+  rime::DictEntryIterator it;
+  dict_->LookupWords(&it, "z", true);
+  ASSERT_FALSE(it.exhausted());
+  rime::DictEntryIterator copy(it);
+  // the first entry comes from the first chunk; the rest are merged by
+  // descending weight within each group of remaining code length
+  it.Next();
+  size_t count = 1;
+  auto previous = it.Peek();
+  while (it.Next()) {
+    auto e = it.Peek();
+    if (e->remaining_code_length == previous->remaining_code_length) {
+      EXPECT_GE(previous->weight, e->weight);
+    } else {
+      EXPECT_LT(previous->remaining_code_length, e->remaining_code_length);
+    }
+    previous = e;
+    ++count;
+  }
+  EXPECT_EQ(it.entry_count(), count + 1);
+  // a copy is not consumed along with the original
+  ASSERT_FALSE(copy.exhausted());
+  EXPECT_EQ("\xe5\x92\x8b", copy.Peek()->text);  // 咋
+}
+
+TEST_F(RimeDictionaryTest, ParallelPackLookup) {
+  ASSERT_TRUE(dict_->loaded());
+  auto table = dict_->primary_table();
+  // the same table serves as the primary table and two packs
+  rime::Dictionary dict("dictionary_test", {"pack1", "pack2"},
+                        {table, table, table}, dict_->prism());
+  ASSERT_TRUE(dict.loaded());
+  rime::SyllableGraph g;
+  rime::Syllabifier s;
+  ASSERT_TRUE(s.BuildSyllableGraph("shurufa", *dict.prism(), &g) > 0);
+  auto sequential = dict.Lookup(g, 0);
+  dict.set_parallel_lookup_min_length(1);
+  auto parallel = dict.Lookup(g, 0);
+  ASSERT_TRUE(bool(sequential));
+  ASSERT_TRUE(bool(parallel));
+  ASSERT_EQ(sequential->size(), parallel->size());
+  for (auto& v : *sequential) {
+    ASSERT_TRUE(parallel->find(v.first) != parallel->end());
+    auto& expected = v.second;
+    auto& actual = (*parallel)[v.first];
+    EXPECT_EQ(expected.entry_count(), actual.entry_count());
+    do {
+      ASSERT_FALSE(actual.exhausted());
+      EXPECT_EQ(expected.Peek()->text, actual.Peek()->text);
+      EXPECT_EQ(expected.Peek()->weight, actual.Peek()->weight);
+      actual.Next();
+    } while (expected.Next());
+    EXPECT_TRUE(actual.exhausted());
+  }
+}
+
+TEST_F(RimeDictionaryTest, LookupPositionsOnWorkerThreads) {
+  ASSERT_TRUE(dict_->loaded());
+  auto table = dict_->primary_table();
+  rime::Dictionary dict("dictionary_test", {"pack1"}, {table, table},
+                        dict_->prism());
+  dict.set_parallel_lookup_min_length(1);
+  rime::SyllableGraph g;
+  rime::Syllabifier s;
+  ASSERT_TRUE(s.BuildSyllableGraph("shurufashurufa", *dict.prism(), &g) > 0);
+  std::vector<rime::an<rime::DictEntryCollector>> results(g.edges.size());
+  std::vector<std::future<void>> pending;
+  size_t i = 0;
+  for (const auto& x : g.edges) {
+    size_t start_pos = x.first;
+    auto* result = &results[i++];
+    pending.push_back(rime::WorkerPool::Shared().Submit(
+        [&dict, &g, result, start_pos] {
+          *result = dict.Lookup(g, start_pos);
+        }));
+  }
+  for (auto& task : pending) {
+    task.get();
+  }
+  i = 0;
+  for (const auto& x : g.edges) {
+    auto expected = dict.Lookup(g, x.first);
+    auto& actual = results[i++];
+    ASSERT_EQ(bool(expected), bool(actual));
+    if (!expected)
+      continue;
+    ASSERT_EQ(expected->size(), actual->size());
+    for (auto& v : *expected) {
+      EXPECT_EQ(v.second.entry_count(), (*actual)[v.first].entry_count());
+      EXPECT_EQ(v.second.Peek()->text, (*actual)[v.first].Peek()->text);
+    }
+  }
+}
+
+TEST_F(RimeDictionaryTest, DeferredPackLoading) {
+  ASSERT_TRUE(dict_->loaded());
+  auto table = dict_->primary_table();
+  rime::Syllabary syll;
+  ASSERT_TRUE(table->GetSyllabary(&syll));
+  rime::SyllableId zhong = table->dense_syllabary()->Find("zhong");
+  ASSERT_LE(0, zhong);
+  rime::Vocabulary voc;
+  auto d = rime::New<rime::ShortDictEntry>();
+  d->code.push_back(zhong);
+  d->text = "\xe5\xbf\xa0";  // 忠
+  d->weight = 1.0;
+  voc[zhong].entries.push_back(d);
+  auto pack = rime::New<rime::Table>(rime::path{"deferred_pack.table.bin"});
+  pack->Remove();
+  ASSERT_TRUE(pack->Build(syll, voc, 1));
+  ASSERT_TRUE(pack->Save());
+  pack->Close();
+
+  rime::Dictionary dict("dictionary_test", {"deferred_pack"}, {table, pack},
+                        dict_->prism());
+  ASSERT_TRUE(dict.Load());
+  EXPECT_TRUE(pack->has_syllable_filter());
+  EXPECT_FALSE(pack->IsOpen());
+  rime::Syllabifier s;
+  rime::SyllableGraph g;
+  ASSERT_TRUE(s.BuildSyllableGraph("shurufa", *dict.prism(), &g) > 0);
+  EXPECT_TRUE(bool(dict.Lookup(g, 0)));
+  // not a syllable of the pack
+  EXPECT_FALSE(pack->IsOpen());
+  rime::SyllableGraph g2;
+  ASSERT_TRUE(s.BuildSyllableGraph("zhong", *dict.prism(), &g2) > 0);
+  auto found = dict.Lookup(g2, 0);
+  EXPECT_TRUE(pack->IsOpen());
+  ASSERT_TRUE(bool(found));
+  bool found_in_pack = false;
+  for (auto& it = (*found)[5]; !it.exhausted(); it.Next()) {
+    found_in_pack = found_in_pack || it.Peek()->text == "\xe5\xbf\xa0";
+  }
+  EXPECT_TRUE(found_in_pack);
+}
+
+TEST_F(RimeDictionaryTest, OverlayTerms) {
+  ASSERT_TRUE(dict_->loaded());
+  const rime::path file_path("dictionary_test.overlay.txt");
+  {
+    std::ofstream out(file_path.c_str());
+    out << "# domain terms\n"
+        << "\xe8\xbe\x93\xe5\x85\xa5\xe6\xb3\x95\xe5\xad\xa6\t"  // 输入法学
+        << "shu ru fa xue\t100000\n"
+        << "\xe6\x97\xa0\xe6\x95\x88\tnot_a_syllable\n";  // 无效
+  }
+  rime::Dictionary dict("dictionary_test", {}, {dict_->primary_table()},
+                        dict_->prism());
+  dict.set_overlay(rime::New<rime::DictionaryOverlay>("dictionary_test"));
+  ASSERT_TRUE(dict.overlay()->Load(file_path, dict.primary_table().get()));
+  std::filesystem::remove(file_path);
+  ASSERT_TRUE(bool(dict.overlay()->table(dict.primary_table().get())));
+
+  rime::SyllableGraph g;
+  rime::Syllabifier s;
+  ASSERT_TRUE(s.BuildSyllableGraph("shurufaxue", *dict.prism(), &g) > 0);
+  auto c = dict.Lookup(g, 0);
+  ASSERT_TRUE(bool(c));
+  ASSERT_TRUE(c->find(10) != c->end());
+  auto e = (*c)[10].Peek();
+  ASSERT_TRUE(bool(e));
+  EXPECT_EQ("\xe8\xbe\x93\xe5\x85\xa5\xe6\xb3\x95\xe5\xad\xa6", e->text);
+  EXPECT_EQ(4, e->code.size());
+  // without the overlay, the phrase is not in the dictionary
+  auto without_overlay = dict_->Lookup(g, 0);
+  EXPECT_TRUE(!without_overlay ||
+              without_overlay->find(10) == without_overlay->end());
+}
+
+namespace {
+
+class NoopTask : public rime::DeploymentTask {
+ public:
+  explicit NoopTask(rime::TaskInitializer) {}
+  bool Run(rime::Deployer* deployer) override { return true; }
+};
+
+}  // namespace
+
+TEST_F(RimeDictionaryTest, SwitchToFilesDeployedAgain) {
+  ASSERT_TRUE(dict_->loaded());
+  rime::DictionaryComponent component;
+  rime::the<rime::Dictionary> dict(
+      component.Create("dictionary_test", "dictionary_test", {}));
+  ASSERT_TRUE(dict->Load());
+  EXPECT_FALSE(dict->Refresh());
+  rime::DictEntryIterator found;
+  dict->LookupWords(&found, "zhong", false);
+  ASSERT_FALSE(found.exhausted());
+  rime::weak<rime::Table> old_table = dict->primary_table();
+
+  // deploy the table again
+  auto file_path = dict->primary_table()->file_path();
+  std::filesystem::last_write_time(
+      file_path,
+      std::filesystem::last_write_time(file_path) + std::chrono::seconds(1));
+  rime::Registry::instance().Register("noop_task",
+                                      new rime::Component<NoopTask>);
+  EXPECT_TRUE(rime::Service::instance().deployer().RunTask("noop_task"));
+  rime::Registry::instance().Unregister("noop_task");
+
+  EXPECT_TRUE(dict->Refresh());
+  EXPECT_TRUE(dict->loaded());
+  EXPECT_NE(old_table.lock(), dict->primary_table());
+  EXPECT_FALSE(dict->Refresh());
+  // the old table is kept for the entries found in it
+  ASSERT_FALSE(old_table.expired());
+  EXPECT_EQ("\xe4\xb8\xad", found.Peek()->text);  // 中
+  found = rime::DictEntryIterator();
+  EXPECT_TRUE(old_table.expired());
+
+  rime::DictEntryIterator it;
+  dict->LookupWords(&it, "zhong", false);
+  ASSERT_FALSE(it.exhausted());
+  EXPECT_EQ("\xe4\xb8\xad", it.Peek()->text);  // 中
+}
+
+TEST(RimeDictionaryCodeTrieTest, CompletionsOfShortCodes) {
+  rime::Syllabary syll{"a", "ab", "abc", "abd", "b"};
+  rime::Vocabulary voc;
+  const char* texts[] = {"A", "AB", "ABC", "ABD", "B"};
+  const double weights[] = {0.0, -1.0, 1.0, 2.0, 3.0};
+  for (rime::SyllableId id = 0; id < 5; ++id) {
+    auto d = rime::New<rime::ShortDictEntry>();
+    d->code.push_back(id);
+    d->text = texts[id];
+    d->weight = weights[id];
+    voc[id].entries.push_back(d);
+  }
+  auto table = rime::New<rime::Table>(rime::path{"code_trie_test.table.bin"});
+  table->Remove();
+  table->set_compact_entries(true);
+  ASSERT_TRUE(table->Build(syll, voc, 5));
+  ASSERT_TRUE(table->Save());
+  table->Close();
+  auto prism = rime::New<rime::Prism>(rime::path{"code_trie_test.prism.bin"});
+  prism->Remove();
+  // spelt by no algebra
+  prism->set_source_checksums(1, rime::ChecksumComputer().Checksum());
+  ASSERT_TRUE(prism->Build(syll));
+  ASSERT_TRUE(prism->Save());
+  prism->Close();
+
+  rime::Dictionary dict("code_trie_test", {}, {table}, prism);
+  ASSERT_TRUE(dict.Load());
+  ASSERT_TRUE(dict.prism()->spells_syllables());
+  rime::DictEntryIterator it;
+  EXPECT_EQ(3, dict.LookupWords(&it, "ab", true));
+  const char* expected[] = {"AB", "ABD", "ABC"};
+  for (const char* text : expected) {
+    ASSERT_FALSE(it.exhausted());
+    auto e = it.Peek();
+    EXPECT_EQ(text, e->text);
+    rime::RawCode raw_code;
+    ASSERT_TRUE(dict.Decode(e->code, &raw_code));
+    EXPECT_EQ(raw_code.ToString().length() - 2, e->remaining_code_length);
+    it.Next();
+  }
+  EXPECT_TRUE(it.exhausted());
+  // the prism finds the heaviest of more codes than the limit
+  rime::DictEntryIterator limited;
+  EXPECT_EQ(2, dict.LookupWords(&limited, "ab", true, 2));
+}
@@ -0,0 +1,30 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#ifndef RIME_DICTIONARY_TEST_FIXTURE_H_
+#define RIME_DICTIONARY_TEST_FIXTURE_H_
+
+#include <gtest/gtest.h>
+#include <rime/common.h>
+#include <rime/dict/dictionary.h>
+#include <rime/dict/dict_compiler.h>
+
+namespace rime {
+
+// compiles dictionary_test, the dictionary of the concurrency_test schema,
+// for the tests typing in sessions of that schema.
+class DictionaryTestFixture : public ::testing::Test {
+ public:
+  virtual void SetUp() {
+    Dictionary dict("dictionary_test", {},
+                    {New<Table>(path{"dictionary_test.table.bin"})},
+                    New<Prism>(path{"dictionary_test.prism.bin"}));
+    DictCompiler dict_compiler(&dict);
+    dict_compiler.Compile(path());  // no schema file
+  }
+};
+
+}  // namespace rime
+
+#endif  // RIME_DICTIONARY_TEST_FIXTURE_H_
@@ -0,0 +1,43 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <cmath>
+#include <gtest/gtest.h>
+#include <rime/algo/dynamics.h>
+
+using namespace rime;
+
+static double reference_formula_d(double d, double t, double da, double ta) {
+  return d + da * exp((ta - t) / 200);
+}
+
+static double reference_formula_p(double s, double u, double t, double d) {
+  const double kM = 1 / (1 - exp(-0.005));
+  double m = s - (s - u) * pow((1 - exp(-t / 10000)), 10);
+  return (d < 20) ? m + (0.5 - m) * (d / kM)
+                  : m + (1 - m) * (pow(4, (d / kM)) - 1) / 3;
+}
+
+TEST(RimeDynamicsTest, DecayAsComputed) {
+  const double t = 100000;
+  for (double delta : {0.0, 1.0, 199.0, 200.0, 2047.0, 2048.0, 50000.0,
+                       0.5, 12.25}) {
+    EXPECT_EQ(reference_formula_d(1, t, 3.5, t - delta),
+              algo::formula_d(1, t, 3.5, t - delta))
+        << "delta = " << delta;
+  }
+  // a tick in the future
+  EXPECT_EQ(reference_formula_d(0, t, 1, t + 10),
+            algo::formula_d(0, t, 1, t + 10));
+}
+
+TEST(RimeDynamicsTest, WeighAsComputed) {
+  for (double t : {1.0, 5000.0, 5000.0, 120000.0}) {
+    for (double d : {0.0, 1.5, 19.9, 20.0, 35.0}) {
+      EXPECT_DOUBLE_EQ(reference_formula_p(0, 3 / t, t, d),
+                       algo::formula_p(0, 3 / t, t, d))
+          << "t = " << t << ", d = " << d;
+    }
+  }
+}
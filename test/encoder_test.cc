@@ -128,3 +128,56 @@ TEST(RimeEncoderTest, TailAnchor) {
   EXPECT_TRUE(encoder.Encode(c, &result));
   EXPECT_EQ("zyxwuqpo", result);
 }
+
+class TestPhraseCollector : public rime::PhraseCollector {
+ public:
+  void CreateEntry(const rime::string& phrase,
+                   const rime::string& code_str,
+                   const rime::string& value) override {
+    codes.push_back(code_str);
+  }
+  bool TranslateWord(const rime::string& word,
+                     rime::vector<rime::string>* code) override {
+    ++translations[word];
+    if (word == "\xe4\xb8\xad") {  // 中
+      code->push_back("l");
+      code->push_back("xl");
+      return true;
+    }
+    if (word == "\xe6\x96\x87") {  // 文
+      code->push_back("yk");
+      return true;
+    }
+    return false;
+  }
+
+  rime::vector<rime::string> codes;
+  rime::map<rime::string, int> translations;
+};
+
+TEST(RimeEncoderTest, RemembersCharacterCodes) {
+  TestPhraseCollector collector;
+  rime::TableEncoder encoder(&collector);
+  rime::Config config;
+  config["encoder"]["rules"][0]["length_in_range"][0] = 2;
+  config["encoder"]["rules"][0]["length_in_range"][1] = 3;
+  config["encoder"]["rules"][0]["formula"] = "AaAzBaBz";
+  config["encoder"]["exclude_patterns"][0] = "^x.*$";
+  encoder.LoadSettings(&config);
+  EXPECT_TRUE(encoder.EncodePhrase("\xe4\xb8\xad\xe6\x96\x87", "1"));
+  EXPECT_TRUE(encoder.EncodePhrase("\xe6\x96\x87\xe4\xb8\xad", "1"));
+  EXPECT_TRUE(
+      encoder.EncodePhrase("\xe4\xb8\xad\xe6\x96\x87\xe6\x96\x87", "1"));
+  ASSERT_EQ(3, collector.codes.size());
+  EXPECT_EQ("lyk", collector.codes[0]);
+  EXPECT_EQ("ykl", collector.codes[1]);
+  EXPECT_EQ("lyk", collector.codes[2]);
+  EXPECT_EQ(1, collector.translations["\xe4\xb8\xad"]);
+  EXPECT_EQ(1, collector.translations["\xe6\x96\x87"]);
+  // a clone encodes for another collector
+  TestPhraseCollector other;
+  auto clone = encoder.Clone(&other);
+  EXPECT_TRUE(clone->EncodePhrase("\xe4\xb8\xad\xe6\x96\x87", "1"));
+  EXPECT_EQ(rime::vector<rime::string>{"lyk"}, other.codes);
+  EXPECT_EQ(1, other.translations["\xe4\xb8\xad"]);
+}
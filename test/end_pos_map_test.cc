@@ -0,0 +1,51 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <gtest/gtest.h>
+#include <rime/dict/vocabulary.h>
+
+using namespace rime;
+
+TEST(RimeEndPosMapTest, IterateInOrder) {
+  EndPosMap<string> m;
+  EXPECT_TRUE(m.empty());
+  EXPECT_TRUE(m.begin() == m.end());
+  EXPECT_TRUE(m.rbegin() == m.rend());
+  m[5] = "five";
+  m[2] = "two";
+  m[7] = "seven";
+  EXPECT_EQ(3, m.size());
+  vector<size_t> positions;
+  for (const auto& x : m) {
+    positions.push_back(x.first);
+  }
+  EXPECT_EQ((vector<size_t>{2, 5, 7}), positions);
+  positions.clear();
+  for (auto r = m.rbegin(); r != m.rend(); ++r) {
+    positions.push_back(r->first);
+  }
+  EXPECT_EQ((vector<size_t>{7, 5, 2}), positions);
+  EXPECT_EQ("seven", m.rbegin()->second);
+}
+
+TEST(RimeEndPosMapTest, FindAndErase) {
+  EndPosMap<string> m;
+  m[2] = "two";
+  m[7] = "seven";
+  EXPECT_EQ(1, m.count(2));
+  EXPECT_EQ(0, m.count(3));
+  EXPECT_EQ(0, m.count(100));
+  EXPECT_TRUE(m.find(3) == m.end());
+  ASSERT_TRUE(m.find(7) != m.end());
+  EXPECT_EQ("seven", m.find(7)->second);
+  EXPECT_EQ(1, m.erase(7));
+  EXPECT_EQ(0, m.erase(7));
+  EXPECT_EQ(1, m.size());
+  EXPECT_EQ(2, m.rbegin()->first);
+  EXPECT_TRUE(m[7].empty());
+  m.erase(2);
+  m.erase(7);
+  EXPECT_TRUE(m.empty());
+  EXPECT_TRUE(m.rbegin() == m.rend());
+}
@@ -0,0 +1,85 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <chrono>
+#include <thread>
+#include <gtest/gtest.h>
+#include <rime/context.h>
+#include <rime/engine.h>
+#include <rime/engine_pool.h>
+#include <rime/schema.h>
+
+using namespace rime;
+
+TEST(RimeEnginePoolTest, DisabledByDefault) {
+  EnginePool pool;
+  EXPECT_EQ(0, pool.size());
+  auto engine = pool.Acquire();
+  ASSERT_TRUE(bool(engine));
+  string schema_id = engine->schema()->schema_id();
+  pool.Release(std::move(engine));
+  EXPECT_EQ(0, pool.idle_count(schema_id));
+}
+
+TEST(RimeEnginePoolTest, ReusesReleasedEngine) {
+  EnginePool pool;
+  pool.set_size(1);
+  auto engine = pool.Acquire();
+  ASSERT_TRUE(bool(engine));
+  Engine* released = engine.get();
+  string schema_id = engine->schema()->schema_id();
+  Context* ctx = engine->context();
+  ctx->PushInput("abc");
+  ctx->set_option("ascii_mode", true);
+  ctx->set_property("client_type", "test");
+  // no engine is being built for the pool.
+  pool.Clear();
+  pool.Release(std::move(engine));
+  EXPECT_EQ(1, pool.idle_count(schema_id));
+  auto reused = pool.Acquire();
+  EXPECT_EQ(released, reused.get());
+  EXPECT_EQ(0, pool.idle_count(schema_id));
+  // the previous session has left nothing behind.
+  ctx = reused->context();
+  EXPECT_TRUE(ctx->input().empty());
+  EXPECT_FALSE(ctx->get_option("ascii_mode"));
+  EXPECT_TRUE(ctx->get_property("client_type").empty());
+  EXPECT_TRUE(ctx->commit_history().empty());
+  pool.set_size(0);
+}
+
+TEST(RimeEnginePoolTest, RefillsInBackground) {
+  EnginePool pool;
+  pool.set_size(1);
+  auto engine = pool.Acquire();
+  ASSERT_TRUE(bool(engine));
+  string schema_id = engine->schema()->schema_id();
+  for (int i = 0; i < 100 && pool.idle_count(schema_id) == 0; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  EXPECT_EQ(1, pool.idle_count(schema_id));
+  auto prebuilt = pool.Acquire();
+  ASSERT_TRUE(bool(prebuilt));
+  EXPECT_NE(engine.get(), prebuilt.get());
+  EXPECT_EQ(schema_id, prebuilt->schema()->schema_id());
+  pool.Clear();
+  EXPECT_EQ(0, pool.idle_count(schema_id));
+}
+
+TEST(RimeEnginePoolTest, WarmsUpInBackground) {
+  EnginePool pool;
+  auto engine = pool.Acquire();
+  ASSERT_TRUE(bool(engine));
+  string schema_id = engine->schema()->schema_id();
+  EXPECT_FALSE(pool.warmed_up(schema_id));
+  pool.WarmUp(schema_id);
+  for (int i = 0; i < 100 && !pool.warmed_up(schema_id); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  EXPECT_TRUE(pool.warmed_up(schema_id));
+  // warming up is not the same as pooling engines for sessions.
+  EXPECT_EQ(0, pool.idle_count(schema_id));
+  pool.Clear();
+  EXPECT_FALSE(pool.warmed_up(schema_id));
+}
@@ -0,0 +1,54 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <gtest/gtest.h>
+#include <rime/dict/entry_collector.h>
+
+using namespace rime;
+
+static const char kEntriesFile[] = "entry_collector_test.entries.bin";
+
+static an<RawDictEntry> MakeEntry(const string& text,
+                                  const vector<string>& code,
+                                  double weight) {
+  auto e = New<RawDictEntry>();
+  e->text = text;
+  e->raw_code.assign(code.begin(), code.end());
+  e->weight = weight;
+  return e;
+}
+
+TEST(RimeEntryCollectorTest, SavesAndLoadsCollectedEntries) {
+  EntryCollector collector;
+  collector.syllabary = {"a", "ba", "ma"};
+  collector.entries.push_back(MakeEntry("\xe5\x95\x8a", {"a"}, 100.0));
+  collector.entries.push_back(
+      MakeEntry("\xe7\x88\xb8\xe5\xa6\x88", {"ba", "ma"}, 0.5));
+  collector.entries.push_back(MakeEntry("", {}, 0.0));
+  collector.num_entries = collector.entries.size();
+  collector.stems["\xe5\x95\x8a"].insert("a");
+  ASSERT_TRUE(collector.Save(path{kEntriesFile}, 42));
+
+  EntryCollector loaded;
+  EXPECT_FALSE(loaded.Load(path{kEntriesFile}, 43));
+  EXPECT_TRUE(loaded.entries.empty());
+  ASSERT_TRUE(loaded.Load(path{kEntriesFile}, 42));
+  EXPECT_EQ(collector.syllabary, loaded.syllabary);
+  EXPECT_EQ(collector.num_entries, loaded.num_entries);
+  ASSERT_EQ(collector.entries.size(), loaded.entries.size());
+  for (size_t i = 0; i < collector.entries.size(); ++i) {
+    const auto& x = collector.entries[i];
+    const auto& y = loaded.entries[i];
+    EXPECT_EQ(x->text, y->text);
+    EXPECT_EQ(x->weight, y->weight);
+    EXPECT_EQ(x->raw_code.ToString(), y->raw_code.ToString());
+  }
+  ASSERT_EQ(1, loaded.stems.size());
+  EXPECT_EQ(collector.stems["\xe5\x95\x8a"], loaded.stems["\xe5\x95\x8a"]);
+}
+
+TEST(RimeEntryCollectorTest, RejectsMissingEntries) {
+  EntryCollector collector;
+  EXPECT_FALSE(collector.Load(path{"no_such_file.entries.bin"}, 0));
+}
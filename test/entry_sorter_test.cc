@@ -0,0 +1,66 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <gtest/gtest.h>
+#include <rime/dict/entry_sorter.h>
+
+using namespace rime;
+
+static ShortDictEntry MakeEntry(const string& text, const Code& code) {
+  ShortDictEntry e;
+  e.text = text;
+  e.code = code;
+  e.weight = -1.0;
+  return e;
+}
+
+static vector<string> SortEntries(size_t memory_limit, size_t* num_runs) {
+  EntrySorter sorter(path{"entry_sorter_test"}, memory_limit);
+  const int kNumEntries = 1000;
+  for (int i = 0; i < kNumEntries; ++i) {
+    Code code;
+    code.push_back(i % 7);
+    code.push_back(i % 3);
+    EXPECT_TRUE(sorter.Add(MakeEntry(std::to_string(i), code)));
+  }
+  EXPECT_FALSE(sorter.Add(MakeEntry("no code", Code())));
+  EXPECT_TRUE(sorter.Finish());
+  *num_runs = sorter.num_runs();
+  vector<string> texts;
+  ShortDictEntry e;
+  SyllableId last_head = -1;
+  int last_value = -1;
+  while (sorter.Next(&e)) {
+    EXPECT_EQ(2, e.code.size());
+    EXPECT_EQ(-1.0, e.weight);
+    int value = std::stoi(e.text);
+    EXPECT_EQ(value % 7, e.code[0]);
+    EXPECT_EQ(value % 3, e.code[1]);
+    // grouped by the first syllable, in the order they were added.
+    EXPECT_LE(last_head, e.code[0]);
+    if (e.code[0] == last_head) {
+      EXPECT_LT(last_value, value);
+    }
+    last_head = e.code[0];
+    last_value = value;
+    texts.push_back(e.text);
+  }
+  EXPECT_EQ(kNumEntries, texts.size());
+  return texts;
+}
+
+TEST(RimeEntrySorterTest, SortInMemory) {
+  size_t num_runs = 0;
+  auto texts = SortEntries(0, &num_runs);
+  EXPECT_EQ(0, num_runs);
+  EXPECT_EQ("0", texts.front());
+}
+
+TEST(RimeEntrySorterTest, MergeSortedRuns) {
+  size_t num_runs = 0;
+  auto in_memory = SortEntries(0, &num_runs);
+  auto merged = SortEntries(4096, &num_runs);
+  EXPECT_LT(1, num_runs);
+  EXPECT_EQ(in_memory, merged);
+}
@@ -0,0 +1,28 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <gtest/gtest.h>
+#include <rime/gear/script_translator.h>
+
+using namespace rime;
+
+TEST(RimeFormatMemoTest, KeepsRecentlyUsed) {
+  FormatMemo<string> memo;
+  string value;
+  EXPECT_FALSE(memo.Lookup("a", &value));
+  memo.Memorize("a", "A");
+  for (size_t i = 1; i < FormatMemo<string>::kMaxItems; ++i) {
+    memo.Memorize(std::to_string(i), "");
+  }
+  // recently used, "a" outlives the first of the others.
+  EXPECT_TRUE(memo.Lookup("a", &value));
+  EXPECT_EQ("A", value);
+  memo.Memorize("b", "B");
+  EXPECT_TRUE(memo.Lookup("a", &value));
+  EXPECT_FALSE(memo.Lookup("1", &value));
+  EXPECT_TRUE(memo.Lookup("b", &value));
+  EXPECT_EQ("B", value);
+  memo.Clear();
+  EXPECT_FALSE(memo.Lookup("a", &value));
+}
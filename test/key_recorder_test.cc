@@ -0,0 +1,75 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <fstream>
+#include <gtest/gtest.h>
+#include <rime/key_event.h>
+#include <rime/key_recorder.h>
+
+using namespace rime;
+
+TEST(RimeKeyRecorderTest, RecordAndRead) {
+  path file_path("key_recorder_test.keylog");
+  {
+    KeyRecorder recorder(file_path, false);
+    ASSERT_TRUE(recorder.good());
+    recorder.RecordSchema("luna_pinyin");
+    recorder.RecordOption("ascii_mode", false);
+    recorder.RecordKey(KeyEvent("a"));
+    recorder.RecordKey(KeyEvent("Control+grave"));
+  }
+  KeyLogReader reader(file_path);
+  ASSERT_TRUE(reader.good());
+  KeyLogRecord record;
+  ASSERT_TRUE(reader.Next(&record));
+  EXPECT_EQ(KeyLogRecord::kSchema, record.type);
+  EXPECT_EQ("luna_pinyin", record.name);
+  ASSERT_TRUE(reader.Next(&record));
+  EXPECT_EQ(KeyLogRecord::kOption, record.type);
+  EXPECT_EQ("ascii_mode", record.name);
+  EXPECT_FALSE(record.value);
+  ASSERT_TRUE(reader.Next(&record));
+  EXPECT_EQ(KeyLogRecord::kKey, record.type);
+  EXPECT_EQ(0u, record.delay);
+  EXPECT_EQ('a', record.keycode);
+  EXPECT_EQ(0, record.mask);
+  ASSERT_TRUE(reader.Next(&record));
+  EXPECT_EQ(KeyLogRecord::kKey, record.type);
+  EXPECT_EQ(KeyEvent("Control+grave").keycode(), record.keycode);
+  EXPECT_EQ(kControlMask, record.mask);
+  EXPECT_FALSE(reader.Next(&record));
+  EXPECT_TRUE(reader.good());
+}
+
+TEST(RimeKeyRecorderTest, HashCharacters) {
+  path file_path("key_recorder_test.hashed.keylog");
+  {
+    KeyRecorder recorder(file_path, true);
+    recorder.RecordKey(KeyEvent("x"));
+    recorder.RecordKey(KeyEvent("X"));
+    recorder.RecordKey(KeyEvent("7"));
+    recorder.RecordKey(KeyEvent("space"));
+  }
+  KeyLogReader reader(file_path);
+  ASSERT_TRUE(reader.good());
+  KeyLogRecord record;
+  ASSERT_TRUE(reader.Next(&record));
+  EXPECT_TRUE(record.keycode >= 'a' && record.keycode <= 'z');
+  ASSERT_TRUE(reader.Next(&record));
+  EXPECT_TRUE(record.keycode >= 'A' && record.keycode <= 'Z');
+  ASSERT_TRUE(reader.Next(&record));
+  EXPECT_TRUE(record.keycode >= '0' && record.keycode <= '9');
+  ASSERT_TRUE(reader.Next(&record));
+  EXPECT_EQ(' ', record.keycode);
+}
+
+TEST(RimeKeyRecorderTest, NotAKeyLog) {
+  path file_path("key_recorder_test.txt");
+  {
+    std::ofstream out(file_path.c_str());
+    out << "hello";
+  }
+  KeyLogReader reader(file_path);
+  EXPECT_FALSE(reader.good());
+}
@@ -0,0 +1,79 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <gtest/gtest.h>
+#include <rime/local_signal.h>
+
+using namespace rime;
+
+TEST(RimeLocalSignalTest, ConnectAndDisconnect) {
+  LocalSignal<void(int)> signal;
+  vector<int> calls;
+  connection second =
+      signal.connect([&calls](int x) { calls.push_back(x * 10); });
+  signal.connect([&calls](int x) { calls.push_back(x); },
+                 boost::signals2::at_front);
+  signal(1);
+  EXPECT_EQ((vector<int>{1, 10}), calls);
+  EXPECT_TRUE(second.connected());
+  second.disconnect();
+  EXPECT_FALSE(second.connected());
+  signal(2);
+  EXPECT_EQ((vector<int>{1, 10, 2}), calls);
+}
+
+TEST(RimeLocalSignalTest, ConnectAndDisconnectWhileEmitting) {
+  LocalSignal<void()> signal;
+  int once = 0;
+  int added = 0;
+  connection once_connection;
+  once_connection = signal.connect([&] {
+    ++once;
+    once_connection.disconnect();
+    signal.connect([&added] { ++added; });
+  });
+  signal();
+  // the slot connected while emitting is called the next time
+  EXPECT_EQ(1, once);
+  EXPECT_EQ(0, added);
+  signal();
+  EXPECT_EQ(1, once);
+  EXPECT_EQ(1, added);
+}
+
+TEST(RimeLocalSignalTest, SwapAndOutlive) {
+  connection connection;
+  int calls = 0;
+  LocalSignal<void()> swapped;
+  {
+    LocalSignal<void()> signal;
+    connection = signal.connect([&calls] { ++calls; });
+    signal.swap(swapped);
+    signal();
+    EXPECT_EQ(0, calls);
+  }
+  swapped();
+  EXPECT_EQ(1, calls);
+  EXPECT_TRUE(connection.connected());
+  {
+    LocalSignal<void()> empty;
+    swapped.swap(empty);
+  }
+  // the slots of the connection are gone
+  EXPECT_FALSE(connection.connected());
+  connection.disconnect();
+}
+
+TEST(RimeLocalSignalTest, ScopedConnection) {
+  LocalSignal<void()> signal;
+  int calls = 0;
+  {
+    boost::signals2::scoped_connection scoped =
+        signal.connect([&calls] { ++calls; });
+    signal();
+  }
+  signal();
+  EXPECT_EQ(1, calls);
+  EXPECT_TRUE(signal.empty());
+}
@@ -0,0 +1,51 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <rime/memory_budget.h>
+
+using namespace rime;
+
+struct FakeCache {
+  size_t bytes;
+  double benefit;
+
+  BudgetedCache budgeted() {
+    return {[this] { return bytes; }, [this] { return benefit; },
+            [this](size_t target) { bytes = (std::min)(bytes, target); }};
+  }
+};
+
+TEST(RimeMemoryBudgetTest, ShrinkCachesWorthLeastFirst) {
+  MemoryBudget& budget(MemoryBudget::instance());
+  // caches of other tests are emptied.
+  budget.Release();
+  size_t others = budget.usage();
+  FakeCache valuable{3000, 2.0};
+  FakeCache worthless{2000, 1.0};
+  {
+    MemoryBudgetRegistration first("valuable", valuable.budgeted());
+    MemoryBudgetRegistration second("worthless", worthless.budgeted());
+    EXPECT_EQ(others + 5000, budget.usage());
+    // no limit
+    budget.Enforce();
+    EXPECT_EQ(3000, valuable.bytes);
+    EXPECT_EQ(2000, worthless.bytes);
+    budget.set_budget(others + 4000);
+    EXPECT_EQ(3000, valuable.bytes);
+    EXPECT_EQ(1000, worthless.bytes);
+    budget.set_budget(others + 2000);
+    EXPECT_EQ(2000, valuable.bytes);
+    EXPECT_EQ(0, worthless.bytes);
+    budget.Release();
+    EXPECT_EQ(0, valuable.bytes);
+    budget.set_budget(0);
+  }
+  // no longer registered
+  valuable.bytes = 3000;
+  EXPECT_EQ(others, budget.usage());
+  budget.Release();
+  EXPECT_EQ(3000, valuable.bytes);
+}
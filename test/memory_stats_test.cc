@@ -0,0 +1,54 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <gtest/gtest.h>
+#include <rime/memory_stats.h>
+#include <rime/worker_pool.h>
+
+using namespace rime;
+
+static size_t count_usages(const string& category) {
+  size_t count = 0;
+  for (const auto& usage : MemoryStats::Collect()) {
+    if (usage.category == category)
+      ++count;
+  }
+  return count;
+}
+
+TEST(RimeMemoryStatsTest, ReportWhileRegistered) {
+  size_t reported = 0;
+  auto reporter = [&reported](vector<MemoryUsage>* usages) {
+    ++reported;
+    MemoryUsage usage;
+    usage.category = "memory_stats_test";
+    usage.heap_bytes = 42;
+    usages->push_back(usage);
+  };
+  {
+    MemoryStatsRegistration first(reporter);
+    MemoryStatsRegistration second(reporter);
+    EXPECT_EQ(2, count_usages("memory_stats_test"));
+    EXPECT_EQ(2, reported);
+  }
+  EXPECT_EQ(0, count_usages("memory_stats_test"));
+  EXPECT_EQ(2, reported);
+}
+
+TEST(RimeMemoryStatsTest, CountAllocationsOfAllThreads) {
+  AllocationCounts thread_before = AllocationCounts::current();
+  AllocationCounts total_before = AllocationCounts::total();
+  WorkerPool pool(1);
+  pool.Submit([] { AllocationCounts::Count(16); });
+  pool.WaitUntilIdle();
+  AllocationCounts::Count(8);
+  AllocationCounts thread_after = AllocationCounts::current();
+  AllocationCounts total_after = AllocationCounts::total();
+  EXPECT_EQ(1, thread_after.allocations - thread_before.allocations);
+  EXPECT_EQ(8, thread_after.bytes - thread_before.bytes);
+  // the executable of rime_test does not replace operator new; only the
+  // explicit counts are there.
+  EXPECT_EQ(2, total_after.allocations - total_before.allocations);
+  EXPECT_EQ(24, total_after.bytes - total_before.bytes);
+}
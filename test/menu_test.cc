@@ -8,6 +8,7 @@
 #include <gtest/gtest.h>
 #include <rime/candidate.h>
 #include <rime/common.h>
+#include <rime/filter.h>
 #include <rime/menu.h>
 #include <rime/translation.h>
 
@@ -77,3 +78,205 @@ TEST(RimeMenuTest, RecipeAlphaBeta) {
   the<Page> no_more_page(menu.CreatePage(5, 1));
   EXPECT_FALSE(bool(no_more_page));
 }
+
+TEST(RimeMenuTest, PrefetchNextPage) {
+  Menu menu;
+  menu.AddTranslation(New<TranslationAlpha>());
+  menu.AddTranslation(New<TranslationBeta>());
+  menu.set_prefetch_next_page(true);
+  the<Page> page(menu.CreatePage(2, 0));
+  ASSERT_TRUE(bool(page));
+  EXPECT_FALSE(page->is_last_page);
+  // waits for candidates of the next page fetched in the background
+  EXPECT_EQ(4, menu.candidate_count());
+  the<Page> next_page(menu.CreatePage(2, 1));
+  ASSERT_TRUE(bool(next_page));
+  EXPECT_TRUE(next_page->is_last_page);
+  EXPECT_EQ("Beta-3", next_page->candidates[1]->text());
+}
+
+TEST(RimeMenuTest, CancelPrefetch) {
+  Menu menu;
+  menu.AddTranslation(New<TranslationBeta>());
+  menu.set_prefetch_next_page(true);
+  the<Page> page(menu.CreatePage(1, 0));
+  ASSERT_TRUE(bool(page));
+  menu.CancelPrefetch();
+  // the menu goes on fetching candidates on demand
+  EXPECT_EQ("Beta-3", menu.GetCandidateAt(2)->text());
+  EXPECT_FALSE(menu.empty());
+}
+
+TEST(RimeMenuTest, ReleaseDormantTranslations) {
+  CandidateList candidates;
+  MergedTranslation merged(candidates);
+  merged.set_dormancy_threshold(1);
+  merged += New<TranslationAlpha>();
+  merged += New<TranslationBeta>();
+  ASSERT_EQ(2, merged.size());
+  EXPECT_EQ("Alpha", merged.Peek()->text());
+  // beta has not been elected for the first candidate
+  EXPECT_FALSE(merged.Next());
+  EXPECT_EQ(0, merged.size());
+}
+
+class TextFilter : public Filter {
+ public:
+  explicit TextFilter(const string& rejected)
+      : Filter(Ticket()), rejected_(rejected) {}
+
+  an<Translation> Apply(an<Translation> translation,
+                        CandidateList* candidates) override {
+    ++applied;
+    return translation;
+  }
+
+  CandidateTransform GetCandidateTransform(CandidateList* candidates) override {
+    return [this](const an<Candidate>& cand) -> an<Candidate> {
+      ++transformed;
+      return cand->text() != rejected_ ? cand : nullptr;
+    };
+  }
+
+  int applied = 0;
+  int transformed = 0;
+
+ private:
+  string rejected_;
+};
+
+TEST(RimeMenuTest, FusedFilters) {
+  Menu menu;
+  menu.AddTranslation(New<TranslationAlpha>());
+  menu.AddTranslation(New<TranslationBeta>());
+  TextFilter no_alpha("Alpha");
+  TextFilter no_beta_2("Beta-2");
+  menu.AddFilter(&no_alpha);
+  menu.AddFilter(&no_beta_2);
+  the<Page> page(menu.CreatePage(5, 0));
+  ASSERT_TRUE(bool(page));
+  EXPECT_TRUE(page->is_last_page);
+  ASSERT_EQ(2, page->candidates.size());
+  EXPECT_EQ("Beta-1", page->candidates[0]->text());
+  EXPECT_EQ("Beta-3", page->candidates[1]->text());
+  // the filters take the candidates in a single pass, without wrapping the
+  // translation.
+  EXPECT_EQ(0, no_alpha.applied);
+  EXPECT_EQ(0, no_beta_2.applied);
+  EXPECT_EQ(4, no_alpha.transformed);
+  EXPECT_EQ(3, no_beta_2.transformed);
+}
+
+TEST(RimeMenuTest, FillInBatches) {
+  auto fifo = New<FifoTranslation>();
+  for (const char* text : {"Fifo-1", "Fifo-2", "Fifo-3"}) {
+    fifo->Append(New<SimpleCandidate>("fifo", 0, 4, text));
+  }
+  auto cache = New<CacheTranslation>(New<TranslationBeta>());
+  CandidateList candidates;
+  EXPECT_EQ(2, fifo->Fill(&candidates, 2));
+  EXPECT_FALSE(fifo->exhausted());
+  EXPECT_EQ(1, fifo->Fill(&candidates, 2));
+  EXPECT_TRUE(fifo->exhausted());
+  EXPECT_EQ(0, fifo->Fill(&candidates, 2));
+  EXPECT_EQ(3, cache->Fill(&candidates, 5));
+  EXPECT_TRUE(cache->exhausted());
+  ASSERT_EQ(6, candidates.size());
+  EXPECT_EQ("Fifo-3", candidates[2]->text());
+  EXPECT_EQ("Beta-1", candidates[3]->text());
+  EXPECT_EQ("Beta-3", candidates[5]->text());
+  // a menu of a single translation takes its candidates in one batch.
+  Menu menu;
+  menu.AddTranslation(New<TranslationBeta>());
+  TextFilter no_beta_2("Beta-2");
+  menu.AddFilter(&no_beta_2);
+  EXPECT_EQ(2, menu.Prepare(5));
+  EXPECT_EQ("Beta-3", menu.GetCandidateAt(1)->text());
+}
+
+TEST(RimeMenuTest, RetainPagesAroundTheLastOne) {
+  int rebuilt = 0;
+  auto fill = [](Menu* menu) {
+    menu->AddTranslation(New<TranslationAlpha>());
+    menu->AddTranslation(New<TranslationBeta>());
+  };
+  Menu menu;
+  fill(&menu);
+  menu.set_retention(1, [&rebuilt, fill](Menu* menu) {
+    ++rebuilt;
+    fill(menu);
+  });
+  for (size_t page_no = 0; page_no < 4; ++page_no) {
+    the<Page> page(menu.CreatePage(1, page_no));
+    ASSERT_TRUE(bool(page));
+  }
+  // the last page and the one before it are kept.
+  EXPECT_EQ(4, menu.candidate_count());
+  EXPECT_EQ(2, menu.retained_count());
+  EXPECT_EQ(0, rebuilt);
+  EXPECT_EQ("Beta-2", menu.GetCandidateAt(2)->text());
+  EXPECT_EQ(0, rebuilt);
+  // released candidates are made again by another menu.
+  EXPECT_EQ("Alpha", menu.GetCandidateAt(0)->text());
+  EXPECT_EQ(1, rebuilt);
+  the<Page> page(menu.CreatePage(1, 1));
+  ASSERT_TRUE(bool(page));
+  EXPECT_EQ("Beta-1", page->candidates[0]->text());
+  EXPECT_EQ(2, rebuilt);
+}
+
+TEST(RimeMenuTest, RestoreReleasedCandidatesByIdentity) {
+  bool changed = false;
+  auto fill = [&changed](Menu* menu) {
+    // the translations have changed since the menu was first filled.
+    if (changed)
+      menu->AddTranslation(New<UniqueTranslation>(
+          New<SimpleCandidate>("gamma", 0, 5, "Gamma")));
+    menu->AddTranslation(New<TranslationAlpha>());
+    menu->AddTranslation(New<TranslationBeta>());
+  };
+  Menu menu;
+  fill(&menu);
+  menu.set_retention(1, fill);
+  for (size_t page_no = 0; page_no < 4; ++page_no) {
+    the<Page> page(menu.CreatePage(1, page_no));
+    ASSERT_TRUE(bool(page));
+  }
+  EXPECT_EQ(2, menu.retained_count());
+  changed = true;
+  // found after the candidate that now comes before it.
+  an<Candidate> alpha = menu.GetCandidateAt(0);
+  ASSERT_TRUE(bool(alpha));
+  EXPECT_EQ("alpha", alpha->type());
+  EXPECT_EQ("Alpha", alpha->text());
+  an<Candidate> beta = menu.GetCandidateAt(1);
+  ASSERT_TRUE(bool(beta));
+  EXPECT_EQ("Beta-1", beta->text());
+  EXPECT_EQ(4, menu.retained_count());
+}
+
+TEST(RimeMenuTest, KeepStandInOfCandidateNoLongerMade) {
+  bool changed = false;
+  auto fill = [&changed](Menu* menu) {
+    if (!changed)
+      menu->AddTranslation(New<TranslationAlpha>());
+    menu->AddTranslation(New<TranslationBeta>());
+  };
+  Menu menu;
+  fill(&menu);
+  menu.set_retention(1, fill);
+  for (size_t page_no = 0; page_no < 4; ++page_no) {
+    the<Page> page(menu.CreatePage(1, page_no));
+    ASSERT_TRUE(bool(page));
+  }
+  changed = true;
+  // neither left out nor replaced by another candidate.
+  an<Candidate> alpha = menu.GetCandidateAt(0);
+  ASSERT_TRUE(bool(alpha));
+  EXPECT_EQ("alpha", alpha->type());
+  EXPECT_EQ("Alpha", alpha->text());
+  the<Page> page(menu.CreatePage(1, 0));
+  ASSERT_TRUE(bool(page));
+  ASSERT_EQ(1, page->candidates.size());
+  EXPECT_EQ("Alpha", page->candidates[0]->text());
+}
@@ -0,0 +1,67 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <gtest/gtest.h>
+#include <rime/dict/next_word_index.h>
+#include <rime/dict/text_db.h>
+#include <rime/dict/user_db.h>
+
+using namespace rime;
+
+using TestDb = UserDbWrapper<TextDb>;
+
+class RimeNextWordIndexTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    db_ = New<TestDb>(path{"next_word_index_test.txt"}, "next_word_test");
+    if (db_->Exists())
+      db_->Remove();
+    index_.reset(new NextWordIndex("next_word_test", db_));
+    ASSERT_TRUE(index_->Load());
+  }
+  void TearDown() override {
+    index_.reset();
+    db_->Close();
+    db_->Remove();
+  }
+
+  static vector<string> Texts(
+      const vector<NextWordIndex::Prediction>& predictions) {
+    vector<string> texts;
+    for (const auto& p : predictions) {
+      texts.push_back(p.text);
+    }
+    return texts;
+  }
+
+  an<Db> db_;
+  the<NextWordIndex> index_;
+};
+
+TEST_F(RimeNextWordIndexTest, PredictWordsCommittedAfter) {
+  EXPECT_TRUE(index_->Learn({}, {"我们", "今天"}));
+  EXPECT_TRUE(index_->Learn({"我们"}, {"明天"}));
+  EXPECT_TRUE(index_->Learn({"我们"}, {"明天"}));
+  EXPECT_TRUE(index_->Learn({"你们"}, {"去"}));
+  EXPECT_EQ((vector<string>{"明天", "今天"}),
+            Texts(index_->Predict({"我们"}, 5)));
+  EXPECT_EQ((vector<string>{"明天"}), Texts(index_->Predict({"我们"}, 1)));
+  EXPECT_TRUE(index_->Predict({"他们"}, 5).empty());
+  EXPECT_TRUE(index_->Predict({}, 5).empty());
+}
+
+TEST_F(RimeNextWordIndexTest, PredictAfterTwoWordsFirst) {
+  EXPECT_TRUE(index_->Learn({}, {"我", "想", "吃"}));
+  EXPECT_TRUE(index_->Learn({}, {"不", "想", "去"}));
+  EXPECT_TRUE(index_->Learn({}, {"也", "想", "去"}));
+  // "去" follows "想" more often, but "吃" follows "我 想".
+  EXPECT_EQ((vector<string>{"吃", "去"}),
+            Texts(index_->Predict({"我", "想"}, 5)));
+  EXPECT_EQ((vector<string>{"去", "吃"}), Texts(index_->Predict({"想"}, 5)));
+}
+
+TEST_F(RimeNextWordIndexTest, BreakChainOfWords) {
+  EXPECT_TRUE(index_->Learn({"我"}, {"", "想"}));
+  EXPECT_TRUE(index_->Predict({"我"}, 5).empty());
+}
@@ -0,0 +1,59 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <gtest/gtest.h>
+#include <rime_api.h>
+#include <rime/arena.h>
+#include <rime/perf_counters.h>
+#include <rime/worker_pool.h>
+
+using namespace rime;
+
+TEST(RimePerfCountersTest, CountToCurrentSession) {
+  PerfCounters session;
+  uint64_t global = PerfCounters::Global().get(PerfCounters::kUserDbSeeks);
+  PerfCounters::Count(PerfCounters::kUserDbSeeks);
+  EXPECT_EQ(0, session.get(PerfCounters::kUserDbSeeks));
+  {
+    PerfCounters::Activation counting(&session);
+    EXPECT_EQ(&session, PerfCounters::current());
+    PerfCounters::Count(PerfCounters::kUserDbSeeks, 2);
+    // work on worker threads is counted to the session that submits it.
+    WorkerPool::Shared()
+        .Submit([] { PerfCounters::Count(PerfCounters::kUserDbSeeks); })
+        .get();
+  }
+  EXPECT_EQ(nullptr, PerfCounters::current());
+  EXPECT_EQ(3, session.get(PerfCounters::kUserDbSeeks));
+  EXPECT_EQ(global + 4,
+            PerfCounters::Global().get(PerfCounters::kUserDbSeeks));
+  session.Reset();
+  EXPECT_EQ(0, session.get(PerfCounters::kUserDbSeeks));
+}
+
+TEST(RimePerfCountersTest, CountArenaBlocks) {
+  PerfCounters session;
+  PerfCounters::Activation counting(&session);
+  Arena arena(1024);
+  arena.Allocate(16, 8);
+  arena.Allocate(16, 8);
+  EXPECT_EQ(1024, session.get(PerfCounters::kBytesAllocated));
+  arena.Allocate(2048, 8);
+  EXPECT_EQ(arena.capacity(), session.get(PerfCounters::kBytesAllocated));
+}
+
+TEST(RimePerfCountersTest, GetPerfCounters) {
+  RimeApi* rime = rime_get_api();
+  ASSERT_TRUE(RIME_API_AVAILABLE(rime, get_perf_counters));
+  RimeSessionId session = rime->create_session();
+  ASSERT_NE(0, session);
+  RIME_STRUCT(RimePerfCounters, counters);
+  ASSERT_TRUE(rime->get_perf_counters(session, &counters));
+  EXPECT_EQ(0, counters.candidates_displayed);
+  RIME_STRUCT(RimePerfCounters, global);
+  ASSERT_TRUE(rime->get_perf_counters(0, &global));
+  EXPECT_GE(global.bytes_allocated, counters.bytes_allocated);
+  rime->destroy_session(session);
+  EXPECT_FALSE(rime->get_perf_counters(session, &counters));
+}
@@ -0,0 +1,51 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <rime/gear/translator_commons.h>
+
+using namespace rime;
+
+// splits a phrase into spans of two characters, counting its calls.
+class CountingSyllabifier : public PhraseSyllabifier {
+ public:
+  Spans Syllabify(const Phrase* phrase) override {
+    ++calls;
+    Spans spans;
+    for (size_t pos = phrase->start(); pos < phrase->end(); pos += 2) {
+      spans.AddSpan(pos, (std::min)(pos + 2, phrase->end()));
+    }
+    return spans;
+  }
+  int calls = 0;
+};
+
+TEST(RimePhraseSpansTest, SyllabifiedOnce) {
+  auto syllabifier = New<CountingSyllabifier>();
+  Phrase phrase(nullptr, "phrase", 0, 6, New<DictEntry>());
+  phrase.set_syllabifier(syllabifier);
+  EXPECT_EQ(3, phrase.spans().Count());
+  EXPECT_EQ(2, phrase.spans().PreviousStop(4));
+  EXPECT_EQ(4, phrase.spans().NextStop(2));
+  EXPECT_EQ(1, syllabifier->calls);
+  phrase.set_syllabifier(syllabifier);
+  EXPECT_EQ(3, phrase.spans().Count());
+  EXPECT_EQ(2, syllabifier->calls);
+}
+
+TEST(RimePhraseSpansTest, SentenceSyllabifiedAgainWhenExtended) {
+  auto syllabifier = New<CountingSyllabifier>();
+  Sentence sentence(nullptr);
+  sentence.set_syllabifier(syllabifier);
+  DictEntry word;
+  word.text = "ab";
+  sentence.Extend(word, 2, 0.0);
+  EXPECT_EQ(1, sentence.spans().Count());
+  sentence.Extend(word, 4, 0.0);
+  EXPECT_EQ(2, sentence.spans().Count());
+  sentence.Offset(1);
+  EXPECT_EQ(5, sentence.spans().end());
+  EXPECT_EQ(3, syllabifier->calls);
+}
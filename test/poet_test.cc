@@ -0,0 +1,181 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <gtest/gtest.h>
+#include <rime/candidate.h>
+#include <rime/gear/grammar.h>
+#include <rime/gear/poet.h>
+
+using namespace rime;
+
+// prefers words following a context of even length, to make the choice of
+// each word depend on the words before it.
+class TestGrammar : public Grammar {
+ public:
+  double Query(const string& context,
+               const string& word,
+               bool is_rear) override {
+    return (context.length() % 2 ? -1.0 : 0.0) + (is_rear ? -0.5 : 0.0);
+  }
+};
+
+// scores only in batches, which should be preferred by the poet.
+class BatchGrammar : public TestGrammar {
+ public:
+  void QueryBatch(const vector<const string*>& contexts,
+                  const vector<const string*>& words,
+                  bool is_rear,
+                  vector<double>* scores) override {
+    scores->clear();
+    for (size_t i = 0; i < contexts.size(); ++i) {
+      for (const auto* word : words) {
+        scores->push_back(*word == "ab" ? 0.0 : -10.0);
+      }
+    }
+  }
+  void QueryBatch(const string& context,
+                  const vector<const string*>& words,
+                  bool is_rear,
+                  vector<double>* scores) override {
+    QueryBatch(vector<const string*>{&context}, words, is_rear, scores);
+  }
+};
+
+template <class T>
+class TestGrammarComponent : public Grammar::Component {
+ public:
+  Grammar* Create(Config* config) override { return new T; }
+};
+
+static an<DictEntry> make_entry(const string& text, double weight) {
+  auto entry = New<DictEntry>();
+  entry->text = text;
+  entry->weight = weight;
+  return entry;
+}
+
+// words of one and two syllables over the first `length` syllables.
+static WordGraph make_graph(size_t length, int edited_pos = -1) {
+  WordGraph graph;
+  for (size_t i = 0; i < length; ++i) {
+    string syllable(1, 'a' + i % 26);
+    auto& same_start_pos = graph[i];
+    same_start_pos[i + 1].push_back(make_entry(syllable, -1.0 - i % 3 * 0.1));
+    same_start_pos[i + 1].push_back(make_entry(syllable + "'", -1.2));
+    if (i + 2 <= length) {
+      double weight = int(i) == edited_pos ? -0.1 : -1.9 - i % 2 * 0.2;
+      same_start_pos[i + 2].push_back(make_entry(syllable + "+", weight));
+    }
+  }
+  return graph;
+}
+
+static void expect_same_sentence(Poet& incremental,
+                                 const WordGraph& graph,
+                                 size_t length,
+                                 const string& preceding_text = "") {
+  Poet fresh(nullptr, nullptr);
+  auto expected = fresh.MakeSentence(graph, length, preceding_text);
+  auto actual = incremental.MakeSentence(graph, length, preceding_text);
+  ASSERT_TRUE(bool(expected));
+  ASSERT_TRUE(bool(actual));
+  EXPECT_EQ(expected->text(), actual->text()) << "length: " << length;
+  EXPECT_DOUBLE_EQ(expected->weight(), actual->weight());
+  EXPECT_EQ(expected->word_lengths(), actual->word_lengths());
+}
+
+class RimePoetTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    Registry::instance().Register("grammar",
+                                  new TestGrammarComponent<TestGrammar>);
+  }
+  void TearDown() override { Registry::instance().Unregister("grammar"); }
+};
+
+TEST_F(RimePoetTest, ExtendInput) {
+  Poet poet(nullptr, nullptr);
+  for (size_t length = 2; length <= 24; ++length) {
+    expect_same_sentence(poet, make_graph(length), length);
+  }
+  // backspace
+  for (size_t length = 23; length >= 20; --length) {
+    expect_same_sentence(poet, make_graph(length), length);
+  }
+}
+
+TEST_F(RimePoetTest, ChangeWordGraph) {
+  Poet poet(nullptr, nullptr);
+  expect_same_sentence(poet, make_graph(12), 12);
+  expect_same_sentence(poet, make_graph(12, 3), 12);
+  expect_same_sentence(poet, make_graph(13, 3), 13);
+  expect_same_sentence(poet, make_graph(13), 13);
+  expect_same_sentence(poet, make_graph(13), 13, "x");
+}
+
+TEST_F(RimePoetTest, QueryBatch) {
+  Registry::instance().Register("grammar",
+                                new TestGrammarComponent<BatchGrammar>);
+  WordGraph graph;
+  graph[0][1].push_back(make_entry("a", 0.0));
+  graph[0][2].push_back(make_entry("ab", -5.0));
+  graph[1][2].push_back(make_entry("b", 0.0));
+  graph[1][3].push_back(make_entry("bc", 0.0));
+  graph[2][3].push_back(make_entry("c", 0.0));
+  Poet poet(nullptr, nullptr);
+  auto sentence = poet.MakeSentence(graph, 3, "");
+  ASSERT_TRUE(bool(sentence));
+  EXPECT_EQ((vector<size_t>{2, 1}), sentence->word_lengths());
+}
+
+TEST(RimePoetWithoutGrammarTest, ExtendInput) {
+  Poet poet(nullptr, nullptr);
+  for (size_t length = 2; length <= 12; ++length) {
+    expect_same_sentence(poet, make_graph(length), length);
+  }
+  expect_same_sentence(poet, make_graph(12, 5), 12);
+}
+
+TEST(RimePoetWithoutGrammarTest, LeftAssociateCompare) {
+  WordGraph graph;
+  graph[0][1].push_back(make_entry("a", 0.0));
+  graph[0][2].push_back(make_entry("ab", 0.0));
+  graph[1][2].push_back(make_entry("b", 0.0));
+  graph[1][3].push_back(make_entry("bc", 0.0));
+  graph[2][3].push_back(make_entry("c", 0.0));
+  Poet poet(nullptr, nullptr, Poet::LeftAssociateCompare);
+  auto sentence = poet.MakeSentence(graph, 3, "");
+  ASSERT_TRUE(bool(sentence));
+  EXPECT_EQ("abc", sentence->text());
+  EXPECT_EQ((vector<size_t>{2, 1}), sentence->word_lengths());
+}
+
+TEST_F(RimePoetTest, MakeSentences) {
+  Poet poet(nullptr, nullptr);
+  WordGraph graph = make_graph(6);
+  auto sentences = poet.MakeSentences(graph, 6, "", 3);
+  ASSERT_EQ(3, sentences.size());
+  Poet fresh(nullptr, nullptr);
+  auto best = fresh.MakeSentence(graph, 6, "");
+  ASSERT_TRUE(bool(best));
+  EXPECT_EQ(best->text(), sentences[0]->text());
+  set<string> last_words;
+  for (size_t i = 0; i < sentences.size(); ++i) {
+    if (i > 0) {
+      EXPECT_GE(sentences[i - 1]->weight(), sentences[i]->weight());
+    }
+    last_words.insert(sentences[i]->components().back().text);
+  }
+  EXPECT_EQ(sentences.size(), last_words.size());
+  // the lattice of the pass is reused for the best sentence.
+  expect_same_sentence(poet, graph, 6);
+}
+
+TEST(RimePoetWithoutGrammarTest, MakeSentences) {
+  Poet poet(nullptr, nullptr);
+  auto sentences = poet.MakeSentences(make_graph(6), 6, "", 3);
+  ASSERT_EQ(1, sentences.size());
+  EXPECT_EQ(poet.MakeSentence(make_graph(6), 6, "")->text(),
+            sentences[0]->text());
+}
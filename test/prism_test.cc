@@ -6,6 +6,8 @@
 //
 #include <algorithm>
 #include <gtest/gtest.h>
+#include <rime/algo/algebra.h>
+#include <rime/algo/syllabifier.h>
 #include <rime/dict/prism.h>
 
 using namespace rime;
@@ -88,3 +90,274 @@ TEST_F(RimePrismTest, ExpandSearch) {
   EXPECT_EQ(result[2].value, 3);   // goodbye
   EXPECT_EQ(result[2].length, 7);  // goodbye
 }
+
+TEST_F(RimePrismTest, ExpandSearchFrom) {
+  vector<Prism::Match> expected;
+  vector<Prism::Match> result;
+  size_t node_pos = 0;
+  ASSERT_TRUE(prism_->ExpandSearchFrom("go", 0, &node_pos, &result, 10));
+  prism_->ExpandSearch("go", &expected, 10);
+  EXPECT_EQ(expected.size(), result.size());
+  // continues from the node of "go"
+  ASSERT_TRUE(prism_->ExpandSearchFrom("goo", 2, &node_pos, &result, 10));
+  prism_->ExpandSearch("goo", &expected, 10);
+  ASSERT_EQ(expected.size(), result.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(expected[i].value, result[i].value);
+    EXPECT_EQ(expected[i].length, result[i].length);
+  }
+  size_t goo_node = node_pos;
+  ASSERT_TRUE(prism_->ExpandSearchFrom("goo", 3, &node_pos, &result, 10));
+  EXPECT_EQ(goo_node, node_pos);
+  EXPECT_EQ(expected.size(), result.size());
+  EXPECT_FALSE(prism_->ExpandSearchFrom("gox", 2, &node_pos, &result, 10));
+  EXPECT_TRUE(result.empty());
+}
+
+TEST_F(RimePrismTest, ExpandSearchByWeight) {
+  // without weights, spellings are found as by ExpandSearch
+  vector<Prism::Match> result;
+  prism_->ExpandSearchByWeight("goo", &result, 2);
+  ASSERT_EQ(result.size(), 2);
+  EXPECT_EQ(result[0].value, 2);  // good
+  EXPECT_EQ(result[1].value, 4);  // google
+
+  set<string> keyset{"adobe", "baidu", "good", "goodbye", "google"};
+  vector<prism::Weight> weights{0.0, 0.0, 1.0, 5.0, 3.0};
+  Prism weighted(path{"prism_test_weighted.bin"});
+  weighted.Remove();
+  ASSERT_TRUE(weighted.Build(keyset, nullptr, 0, 0, &weights));
+  ASSERT_TRUE(weighted.Save());
+  Prism loaded(weighted.file_path());
+  ASSERT_TRUE(loaded.Load());
+  EXPECT_TRUE(loaded.has_weights());
+
+  loaded.ExpandSearchByWeight("goo", &result, 2);
+  ASSERT_EQ(result.size(), 2);
+  EXPECT_EQ(result[0].value, 3);   // goodbye
+  EXPECT_EQ(result[0].length, 7);  // goodbye
+  EXPECT_EQ(result[1].value, 4);   // google
+  loaded.ExpandSearchByWeight("goo", &result, 10);
+  ASSERT_EQ(result.size(), 3);
+  EXPECT_EQ(result[2].value, 2);  // good
+  // the key itself goes first
+  loaded.ExpandSearchByWeight("good", &result, 10);
+  ASSERT_EQ(result.size(), 2);
+  EXPECT_EQ(result[0].value, 2);  // good
+  EXPECT_EQ(result[1].value, 3);  // goodbye
+}
+
+TEST_F(RimePrismTest, UpdateWeights) {
+  set<string> keyset{"adobe", "baidu", "good", "goodbye", "google"};
+  vector<prism::Weight> weights{0.0, 0.0, 1.0, 5.0, 3.0};
+  Prism weighted(path{"prism_test_weighted.bin"});
+  weighted.Remove();
+  weighted.set_source_checksums(1, 2);
+  ASSERT_TRUE(weighted.Build(keyset, nullptr, 0, 0, &weights));
+  ASSERT_TRUE(weighted.Save());
+  weighted.Close();
+  // google becomes heavier than goodbye
+  vector<prism::Weight> new_weights{0.0, 0.0, 1.0, 3.0, 5.0};
+  Prism updated(weighted.file_path());
+  ASSERT_TRUE(updated.UpdateWeights(new_weights, 3, 4));
+  EXPECT_EQ(1, updated.syllabary_checksum());
+  EXPECT_EQ(2, updated.algebra_checksum());
+  EXPECT_EQ(3, updated.dict_file_checksum());
+  EXPECT_EQ(4, updated.schema_file_checksum());
+  vector<Prism::Match> result;
+  updated.ExpandSearchByWeight("goo", &result, 10);
+  ASSERT_EQ(result.size(), 3);
+  EXPECT_EQ(result[0].value, 4);  // google
+  EXPECT_EQ(result[1].value, 3);  // goodbye
+  EXPECT_EQ(result[2].value, 2);  // good
+  // the same as built with the new weights
+  Prism rebuilt(path{"prism_test_rebuilt.bin"});
+  rebuilt.Remove();
+  ASSERT_TRUE(rebuilt.Build(keyset, nullptr, 0, 0, &new_weights));
+  for (const string& key : {string(), string("g"), string("good")}) {
+    vector<Prism::Match> expected;
+    rebuilt.ExpandSearchByWeight(key, &expected, 10);
+    updated.ExpandSearchByWeight(key, &result, 10);
+    ASSERT_EQ(expected.size(), result.size()) << key;
+    for (size_t i = 0; i < expected.size(); ++i) {
+      EXPECT_EQ(expected[i].value, result[i].value) << key;
+    }
+  }
+  // a prism without weights is to be rebuilt.
+  prism_->Save();
+  prism_->Close();
+  EXPECT_FALSE(prism_->UpdateWeights(new_weights, 3, 4));
+}
+
+static void expect_resumed_search(Prism& prism, const string& key) {
+  vector<Prism::Match> expected;
+  prism.ExpandSearchByWeight(key, &expected, 100);
+  vector<Prism::Match> resumed;
+  auto search = prism.StartExpandSearch(key);
+  while (prism.ResumeExpandSearch(search.get(), &resumed, 1) == 1)
+    ;
+  ASSERT_EQ(expected.size(), resumed.size()) << key;
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(expected[i].value, resumed[i].value) << key;
+    EXPECT_EQ(expected[i].length, resumed[i].length) << key;
+  }
+}
+
+TEST_F(RimePrismTest, ResumeExpandSearch) {
+  expect_resumed_search(*prism_, "goo");
+  expect_resumed_search(*prism_, "good");
+  expect_resumed_search(*prism_, "");
+  expect_resumed_search(*prism_, "x");
+
+  set<string> keyset{"adobe", "baidu", "good", "goodbye", "google"};
+  vector<prism::Weight> weights{0.0, 0.0, 1.0, 5.0, 3.0};
+  Prism weighted(path{"prism_test_weighted.bin"});
+  weighted.Remove();
+  ASSERT_TRUE(weighted.Build(keyset, nullptr, 0, 0, &weights));
+  ASSERT_TRUE(weighted.has_weights());
+  expect_resumed_search(weighted, "goo");
+  expect_resumed_search(weighted, "good");
+  expect_resumed_search(weighted, "");
+}
+
+TEST(RimePrismCompletionTest, PrecomputedCompletions) {
+  Syllabary syllabary;
+  Script script;
+  for (char c = 'a'; c < 'a' + 20; ++c) {
+    syllabary.insert(string("z") + c);
+    script.AddSyllable(string("z") + c);
+  }
+  syllabary.insert("ba");
+  script.AddSyllable("ba");
+  // an abbreviation is not completed
+  Spelling abbreviation("za");
+  abbreviation.properties.type = kAbbreviation;
+  script["b"].push_back(abbreviation);
+
+  Prism prism(path{"prism_test_completions.bin"});
+  prism.Remove();
+  ASSERT_TRUE(prism.Build(syllabary, &script));
+  ASSERT_TRUE(prism.Save());
+  Prism loaded(prism.file_path());
+  ASSERT_TRUE(loaded.Load());
+
+  const prism::CompactCompletionList* completions =
+      loaded.QueryCompactCompletions("z");
+  ASSERT_TRUE(completions != nullptr);
+  ASSERT_EQ(20, completions->size);
+  for (size_t i = 0; i < completions->size; ++i) {
+    // "ba" comes first in the syllabary
+    EXPECT_EQ(i + 1, completions->at[i].syllable_id());
+    EXPECT_EQ(kNormalSpelling, completions->at[i].type());
+  }
+  // the compact map replaces the legacy one
+  EXPECT_TRUE(loaded.QueryCompletions("z") == nullptr);
+  // too few spellings to precompute
+  EXPECT_TRUE(loaded.QueryCompactCompletions("b") == nullptr);
+  // too long, or not a prefix of any spelling
+  EXPECT_TRUE(loaded.QueryCompactCompletions("zab") == nullptr);
+  EXPECT_TRUE(loaded.QueryCompactCompletions("x") == nullptr);
+
+  // the syllabifier completes the input to the same syllables
+  Syllabifier syllabifier("", true);
+  SyllableGraph graph;
+  EXPECT_EQ(1, syllabifier.BuildSyllableGraph("z", loaded, &graph));
+  ASSERT_EQ(20, graph.edges[0][1].size());
+  EXPECT_EQ(kCompletion, graph.edges[0][1].begin()->second.type);
+}
+
+TEST(RimePrismCompletionTest, CompactSpellingProperties) {
+  Syllabary syllabary{"ba", "pa"};
+  Script script;
+  script.AddSyllable("ba");
+  script.AddSyllable("pa");
+  Spelling fuzzy("ba");
+  fuzzy.properties.type = kFuzzySpelling;
+  fuzzy.properties.credibility = -0.5;
+  fuzzy.properties.tips = "〔ba〕";
+  script["pa"].push_back(fuzzy);
+
+  Prism prism(path{"prism_test_completions.bin"});
+  prism.Remove();
+  ASSERT_TRUE(prism.Build(syllabary, &script));
+  ASSERT_TRUE(prism.Save());
+  Prism loaded(prism.file_path());
+  ASSERT_TRUE(loaded.Load());
+  int spelling_id = -1;
+  ASSERT_TRUE(loaded.GetValue("pa", &spelling_id));
+  SpellingAccessor accessor(loaded.QuerySpelling(spelling_id));
+  ASSERT_FALSE(accessor.exhausted());
+  EXPECT_EQ(1, accessor.syllable_id());
+  EXPECT_EQ(kNormalSpelling, accessor.properties().type);
+  EXPECT_EQ(0.0, accessor.properties().credibility);
+  EXPECT_TRUE(accessor.properties().tips.empty());
+  accessor.Next();
+  ASSERT_FALSE(accessor.exhausted());
+  EXPECT_EQ(0, accessor.syllable_id());
+  SpellingProperties props = accessor.properties();
+  EXPECT_EQ(kFuzzySpelling, props.type);
+  EXPECT_FLOAT_EQ(-0.5, props.credibility);
+  EXPECT_EQ("〔ba〕", props.tips);
+  accessor.Next();
+  EXPECT_TRUE(accessor.exhausted());
+}
+
+TEST(RimePrismLoudsTrieTest, SameAsDoubleArray) {
+  Syllabary syllabary;
+  for (char initial = 'a'; initial <= 'z'; ++initial) {
+    syllabary.insert(string(1, initial));
+    for (char vowel : string("aeiou")) {
+      for (const char* final : {"", "i", "n", "ng", "o"}) {
+        syllabary.insert(string(1, initial) + vowel + final);
+      }
+    }
+  }
+  vector<prism::Weight> weights;
+  for (size_t i = 0; i < syllabary.size(); ++i) {
+    weights.push_back(static_cast<prism::Weight>(i * 7 % 13));
+  }
+  Prism double_array(path{"prism_test.bin"});
+  double_array.Remove();
+  ASSERT_TRUE(double_array.Build(syllabary, nullptr, 0, 0, &weights));
+  Prism built(path{"prism_test_louds.bin"});
+  built.Remove();
+  built.set_trie_backend(prism::kLoudsTrie);
+  ASSERT_TRUE(built.Build(syllabary, nullptr, 0, 0, &weights));
+  ASSERT_TRUE(built.Save());
+  Prism louds(built.file_path());
+  ASSERT_TRUE(louds.Load());
+  EXPECT_EQ(prism::kLoudsTrie, louds.trie_backend());
+  EXPECT_EQ(prism::kDoubleArrayTrie, double_array.trie_backend());
+  EXPECT_LT(louds.trie().image_size(), double_array.trie().image_size());
+
+  auto expect_same = [](const vector<Prism::Match>& expected,
+                        const vector<Prism::Match>& result,
+                        const string& key) {
+    ASSERT_EQ(expected.size(), result.size()) << key;
+    for (size_t i = 0; i < expected.size(); ++i) {
+      EXPECT_EQ(expected[i].value, result[i].value) << key;
+      EXPECT_EQ(expected[i].length, result[i].length) << key;
+    }
+  };
+  vector<string> keys(syllabary.begin(), syllabary.end());
+  keys.insert(keys.end(), {"", "x", "zh", "zong", "angx", "{"});
+  for (const string& key : keys) {
+    int expected_value = -1;
+    int value = -1;
+    EXPECT_EQ(double_array.GetValue(key, &expected_value),
+              louds.GetValue(key, &value))
+        << key;
+    EXPECT_EQ(expected_value, value) << key;
+    vector<Prism::Match> expected;
+    vector<Prism::Match> result;
+    double_array.CommonPrefixSearch(key, &expected);
+    louds.CommonPrefixSearch(key, &result);
+    expect_same(expected, result, key);
+    double_array.ExpandSearch(key, &expected, 0);
+    louds.ExpandSearch(key, &result, 0);
+    expect_same(expected, result, key);
+    double_array.ExpandSearchByWeight(key, &expected, 20);
+    louds.ExpandSearchByWeight(key, &result, 20);
+    expect_same(expected, result, key);
+  }
+}
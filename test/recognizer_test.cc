@@ -0,0 +1,83 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+
+#include <gtest/gtest.h>
+#include <rime/segmentation.h>
+#include <rime/gear/recognizer.h>
+
+using namespace rime;
+
+class RimeRecognizerPatternsTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    patterns_["email"] = boost::regex("^[A-Za-z][-_.0-9A-Za-z]*@.*$");
+    patterns_["punct"] = boost::regex("^/([0-9]0?|[A-Za-z]+)$");
+    patterns_["reverse_lookup"] = boost::regex("`[a-z]*'?$");
+    patterns_["uppercase"] = boost::regex("[A-Z][-_+.'0-9A-Za-z]*$");
+    patterns_.Compile();
+  }
+
+  RecognizerMatch GetMatch(const string& input, size_t segment_start = 0) {
+    Segmentation segmentation;
+    segmentation.Reset(input);
+    if (segment_start > 0)
+      segmentation.AddSegment(Segment(0, segment_start));
+    segmentation.AddSegment(Segment(segment_start, input.length() - 1));
+    return patterns_.GetMatch(input, segmentation);
+  }
+
+  RecognizerPatterns patterns_;
+};
+
+TEST_F(RimeRecognizerPatternsTest, NoMatch) {
+  EXPECT_FALSE(GetMatch("nihao").found());
+  EXPECT_FALSE(GetMatch("ni/hao").found());
+}
+
+TEST_F(RimeRecognizerPatternsTest, MatchFromStart) {
+  auto match = GetMatch("/fh");
+  EXPECT_EQ("punct", match.tag);
+  EXPECT_EQ(0, match.start);
+  EXPECT_EQ(3, match.end);
+  match = GetMatch("Rime@");
+  // both email and uppercase match at the start; tags are in order.
+  EXPECT_EQ("email", match.tag);
+  EXPECT_EQ(0, match.start);
+}
+
+TEST_F(RimeRecognizerPatternsTest, MatchAtSegmentStart) {
+  auto match = GetMatch("ni`hao", 2);
+  EXPECT_EQ("reverse_lookup", match.tag);
+  EXPECT_EQ(2, match.start);
+  EXPECT_EQ(6, match.end);
+  // "^" does not match after the start of the active input.
+  EXPECT_FALSE(GetMatch("ni/fh", 2).found());
+  // nor where no segment starts.
+  EXPECT_FALSE(GetMatch("nihao`a", 2).found());
+}
+
+TEST_F(RimeRecognizerPatternsTest, MatchesWithoutCombining) {
+  patterns_["repeated"] = boost::regex("(a)\\1$");
+  patterns_.Compile();
+  auto match = GetMatch("aa");
+  EXPECT_EQ("repeated", match.tag);
+  match = GetMatch("/fh");
+  EXPECT_EQ("punct", match.tag);
+}
+
+TEST_F(RimeRecognizerPatternsTest, MatchGrowingInput) {
+  EXPECT_FALSE(GetMatch("n").found());
+  EXPECT_FALSE(GetMatch("ni").found());
+  EXPECT_FALSE(GetMatch("ni/").found());
+  // nothing matches from 0 as the input grows.
+  EXPECT_FALSE(GetMatch("ni/f").found());
+  // backspaces.
+  EXPECT_FALSE(GetMatch("n").found());
+  EXPECT_EQ("uppercase", GetMatch("N").tag);
+  EXPECT_FALSE(GetMatch("/").found());
+  EXPECT_EQ("punct", GetMatch("/f").tag);
+  EXPECT_FALSE(GetMatch("/f.").found());
+  EXPECT_EQ("punct", GetMatch("/f").tag);
+}
@@ -53,3 +53,46 @@ TEST(RimeResourceResolverTest, FallbackRootPath) {
   }
   fs::remove_all("fallback");
 }
+
+TEST(RimeResourceResolverTest, CachedFallbackPath) {
+  FallbackResourceResolver rr(kMineralsType);
+  rr.set_fallback_root_path(path{"fallback"});
+  fs::create_directory("fallback");
+  auto default_path = fs::absolute("not_cached.minerals");
+  fs::remove(default_path);
+  auto fallback = fs::absolute("fallback/not_cached.minerals");
+  std::ofstream(fallback.string()).close();
+  EXPECT_TRUE(fallback == rr.ResolvePath("cached"));
+  // the resolved path is remembered until the cache is invalidated.
+  std::ofstream(default_path.string()).close();
+  EXPECT_TRUE(fallback == rr.ResolvePath("cached"));
+  FallbackResourceResolver::InvalidateCache();
+  EXPECT_TRUE(default_path == rr.ResolvePath("cached"));
+  fs::remove(default_path);
+  fs::remove_all("fallback");
+}
+
+TEST(RimeResourceResolverTest, ServeSnapshotButToDeployingThreads) {
+  FallbackResourceResolver rr(kMineralsType);
+  rr.set_root_path(path{"staging"});
+  rr.set_fallback_root_path(path{"fallback"});
+  fs::create_directories("staging/snapshot");
+  auto staged = fs::absolute("staging/not_mined.minerals");
+  auto snapshot = fs::absolute("staging/snapshot/not_mined.minerals");
+  std::ofstream(staged.string()).close();
+  std::ofstream(snapshot.string()).close();
+  EXPECT_TRUE(staged == rr.ResolvePath("mined"));
+  FallbackResourceResolver::ServeSnapshot(path{"staging"},
+                                          path{"staging/snapshot"});
+  EXPECT_TRUE(snapshot == rr.ResolvePath("mined"));
+  {
+    FallbackResourceResolver::Deploying deploying;
+    EXPECT_TRUE(FallbackResourceResolver::deploying());
+    EXPECT_TRUE(staged == rr.ResolvePath("mined"));
+  }
+  EXPECT_FALSE(FallbackResourceResolver::deploying());
+  EXPECT_TRUE(snapshot == rr.ResolvePath("mined"));
+  FallbackResourceResolver::ServeSnapshot(path{"staging"}, path());
+  EXPECT_TRUE(staged == rr.ResolvePath("mined"));
+  fs::remove_all("staging");
+}
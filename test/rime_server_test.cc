@@ -0,0 +1,103 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <gtest/gtest.h>
+#include "rime_server.h"
+
+using std::string;
+
+// returns the end of the socket pair kept by the test; the other end is
+// served.
+static int connect_client(RimeServer* server) {
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+    return -1;
+  server->AddClient(fds[1]);
+  return fds[0];
+}
+
+static bool send_line(int fd, const string& line) {
+  string request = line + "\n";
+  return write(fd, request.data(), request.size()) ==
+         static_cast<ssize_t>(request.size());
+}
+
+// polls the server until the client has received a reply ending with an
+// empty line, or the given number of lines.
+static string receive(RimeServer* server, int fd, int lines = 0) {
+  string received;
+  for (int round = 0; round < 100; ++round) {
+    server->Poll(10);
+    char buffer[4096];
+    ssize_t n;
+    while ((n = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+      received.append(buffer, n);
+    }
+    bool complete = lines > 0 ? std::count(received.begin(), received.end(),
+                                           '\n') >= lines
+                              : received.size() >= 2 &&
+                                    received.compare(received.size() - 2, 2,
+                                                     "\n\n") == 0;
+    if (complete)
+      break;
+  }
+  return received;
+}
+
+TEST(RimeServerTest, EscapeLine) {
+  EXPECT_EQ("abc", escape_line("abc"));
+  EXPECT_EQ("a\\nb\\rc", escape_line("a\nb\rc"));
+  EXPECT_EQ("a\\\\nb", escape_line("a\\nb"));
+}
+
+TEST(RimeServerTest, DropClientLeavingRepliesUnread) {
+  const size_t kMaxPendingBytes = 1024;
+  RimeServer server(-1, kMaxPendingBytes);
+  ASSERT_TRUE(server.ok());
+  int slow = connect_client(&server);
+  int fast = connect_client(&server);
+  ASSERT_GE(slow, 0);
+  ASSERT_GE(fast, 0);
+  EXPECT_EQ(2, server.client_count());
+  // the slow client sends requests but never reads the replies.
+  string requests;
+  for (int i = 0; i < 100; ++i) {
+    requests += "state 0\n";
+  }
+  for (int round = 0; round < 10000 && server.client_count() == 2; ++round) {
+    if (send(slow, requests.data(), requests.size(), MSG_DONTWAIT) < 0)
+      break;
+    server.Poll(0);
+  }
+  EXPECT_EQ(1, server.client_count());
+  // the others are served all the while.
+  ASSERT_TRUE(send_line(fast, "state 0"));
+  EXPECT_EQ("error unknown session\n\n", receive(&server, fast));
+  close(slow);
+  close(fast);
+}
+
+TEST(RimeServerTest, DeliverMessagesFromOtherThreads) {
+  RimeServer server(-1);
+  ASSERT_TRUE(server.ok());
+  int client = connect_client(&server);
+  ASSERT_GE(client, 0);
+  ASSERT_TRUE(send_line(client, "create"));
+  string reply = receive(&server, client);
+  ASSERT_EQ(0, reply.compare(0, 8, "session "));
+  RimeSessionId session_id = std::stoull(reply.substr(8));
+  std::thread sender([&server, session_id] {
+    RimeServer::OnMessage(&server, session_id, "option", "ascii_mode");
+    RimeServer::OnMessage(&server, session_id, "property", "a\nb");
+  });
+  sender.join();
+  EXPECT_EQ("message option ascii_mode\nmessage property a\\nb\n",
+            receive(&server, client, 2));
+  close(client);
+}
@@ -0,0 +1,44 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <fstream>
+#include <gtest/gtest.h>
+#include <rime/schema_index.h>
+
+using namespace rime;
+
+TEST(RimeSchemaIndexTest, SaveAndLoad) {
+  path source_path("schema_index_test.source.yaml");
+  {
+    std::ofstream out(source_path.c_str());
+    out << "schemas:\n"
+           "  - schema_id: alpha\n"
+           "    name: Alpha\n"
+           "    version: '1.0'\n"
+           "    icon: alpha.ico\n"
+           "    switches: [ascii_mode, simplification]\n"
+           "  - schema_id: beta\n"
+           "    name: Beta\n";
+  }
+  SchemaIndex index;
+  ASSERT_TRUE(index.Load(source_path));
+  path file_path("schema_index_test.yaml");
+  ASSERT_TRUE(index.Save(file_path));
+  SchemaIndex loaded;
+  ASSERT_TRUE(loaded.Load(file_path));
+  ASSERT_EQ(2, loaded.schemas().size());
+  EXPECT_EQ("alpha", loaded.schemas()[0].schema_id);
+  const SchemaInfo* alpha = loaded.Find("alpha");
+  ASSERT_TRUE(alpha != nullptr);
+  EXPECT_EQ("Alpha", alpha->name);
+  EXPECT_EQ("1.0", alpha->version);
+  EXPECT_EQ("alpha.ico", alpha->icon);
+  ASSERT_EQ(2, alpha->switches.size());
+  EXPECT_EQ("simplification", alpha->switches[1]);
+  const SchemaInfo* beta = loaded.Find("beta");
+  ASSERT_TRUE(beta != nullptr);
+  EXPECT_EQ("Beta", beta->name);
+  EXPECT_TRUE(beta->switches.empty());
+  EXPECT_EQ(nullptr, loaded.Find("gamma"));
+}
@@ -0,0 +1,79 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <gtest/gtest.h>
+#include <rime/segmentation.h>
+
+using namespace rime;
+
+TEST(RimeSegmentTagsTest, CompatibleWithSetOfNames) {
+  SegmentTags tags;
+  EXPECT_TRUE(tags.empty());
+  tags.insert("punct");
+  tags.insert("abc");
+  tags.insert("abc");
+  EXPECT_EQ(2, tags.size());
+  EXPECT_EQ(1, tags.count("abc"));
+  EXPECT_EQ(0, tags.count("segment_tags_test_never_inserted"));
+  EXPECT_EQ((set<string>{"abc", "punct"}), tags.names());
+  EXPECT_EQ(1, tags.erase("punct"));
+  EXPECT_EQ(0, tags.erase("punct"));
+  EXPECT_EQ((set<string>{"abc"}), tags.names());
+  tags.insert("punct");
+  EXPECT_TRUE(tags.find("abc") != tags.end());
+  EXPECT_EQ("abc", *tags.find("abc"));
+  EXPECT_TRUE(tags.find("raw") == tags.end());
+  set<string> names;
+  for (const string& name : tags) {
+    names.insert(name);
+  }
+  EXPECT_EQ(tags.names(), names);
+  tags.clear();
+  EXPECT_TRUE(tags.empty());
+  EXPECT_TRUE(tags.begin() == tags.end());
+}
+
+TEST(RimeSegmentTagsTest, MatchAndMerge) {
+  SegmentTags abc({"abc"});
+  SegmentTags filtered({"reverse_lookup", "abc"});
+  SegmentTags other({"punct", "raw"});
+  EXPECT_TRUE(abc.HasAnyOf(filtered));
+  EXPECT_FALSE(abc.HasAnyOf(other));
+  abc |= other;
+  EXPECT_EQ(3, abc.size());
+  EXPECT_TRUE(abc.HasAnyOf(other));
+  EXPECT_EQ(SegmentTags({"raw", "punct", "abc"}), abc);
+  EXPECT_NE(other, abc);
+
+  Segment segment;
+  segment.tags = filtered;
+  EXPECT_TRUE(segment.HasTag("reverse_lookup"));
+  EXPECT_TRUE(segment.HasTag(SegmentTags::Intern("reverse_lookup")));
+  EXPECT_TRUE(segment.HasAnyTagIn(vector<string>{"raw", "abc"}));
+  EXPECT_FALSE(segment.HasAnyTagIn(other));
+}
+
+TEST(RimeSegmentTagsTest, MoreTagsThanInline) {
+  vector<string> names;
+  for (size_t i = 0; i < 2 * SegmentTags::kInlineTags; ++i) {
+    names.push_back("segment_tags_test_" + std::to_string(i));
+  }
+  SegmentTags tags(names);
+  EXPECT_EQ(names.size(), tags.size());
+  SegmentTags last({names.back()});
+  EXPECT_TRUE(tags.HasAnyOf(last));
+  EXPECT_TRUE(last.HasAnyOf(tags));
+  tags.erase(names.back());
+  EXPECT_FALSE(tags.HasAnyOf(last));
+  EXPECT_EQ(names.size() - 1, tags.size());
+  // no trace of the removed tag is left
+  tags.insert(names.back());
+  EXPECT_EQ(SegmentTags(names), tags);
+  SegmentTags copy(tags);
+  copy.erase(names.back());
+  copy.erase(names[names.size() - 2]);
+  copy.insert(names[names.size() - 2]);
+  copy.insert(names.back());
+  EXPECT_EQ(tags, copy);
+}
@@ -60,3 +60,28 @@ TEST(AbcSegmentorTest, PrefixMatch) {
   EXPECT_EQ(7, segmentation[0].end);
   EXPECT_GE(1U, segmentation[0].tags.size());
 }
+
+TEST(AbcSegmentorTest, ResumeOnExtendedInput) {
+  Segmentor::Component* component = Segmentor::Require("abc_segmentor");
+  ASSERT_TRUE(component != NULL);
+  the<Engine> engine(Engine::Create());
+  the<Segmentor> segmentor(component->Create(engine.get()));
+  ASSERT_TRUE(bool(segmentor));
+  Segmentation segmentation;
+  segmentation.Reset("abc");
+  segmentor->Proceed(&segmentation);
+  ASSERT_EQ(1, segmentation.size());
+  EXPECT_EQ(3, segmentation[0].end);
+  // typed on.
+  segmentation.Reset("abcdefg.14");
+  segmentation.Reset(0);
+  segmentor->Proceed(&segmentation);
+  ASSERT_EQ(1, segmentation.size());
+  EXPECT_EQ(7, segmentation[0].end);
+  // the scanned input is edited.
+  segmentation.Reset("ab.defg");
+  segmentation.Reset(0);
+  segmentor->Proceed(&segmentation);
+  ASSERT_EQ(1, segmentation.size());
+  EXPECT_EQ(2, segmentation[0].end);
+}
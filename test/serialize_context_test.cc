@@ -0,0 +1,125 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <cstring>
+#include <gtest/gtest.h>
+#include <rime_api.h>
+#include <rime/common.h>
+#include <rime/schema.h>
+#include <rime/service.h>
+#include "dictionary_test_fixture.h"
+
+using namespace rime;
+
+// reads the fields of a serialized context, as laid out in rime_api.h.
+class ContextReader {
+ public:
+  ContextReader(const char* data, size_t size) : data_(data), size_(size) {}
+
+  uint32_t ReadInt() {
+    uint32_t x = 0;
+    if (pos_ + 4 > size_) {
+      pos_ = size_ + 1;
+      return x;
+    }
+    for (int i = 0; i < 4; ++i) {
+      x |= uint32_t(static_cast<unsigned char>(data_[pos_ + i])) << (8 * i);
+    }
+    pos_ += 4;
+    return x;
+  }
+  uint64_t ReadInt64() {
+    uint64_t low = ReadInt();
+    return low | (uint64_t(ReadInt()) << 32);
+  }
+  string ReadString() {
+    uint32_t length = ReadInt();
+    if (pos_ + length > size_) {
+      pos_ = size_ + 1;
+      return string();
+    }
+    string str(data_ + pos_, length);
+    pos_ += length;
+    return str;
+  }
+  // whether the fields read so far are all within the data.
+  bool ok() const { return pos_ <= size_; }
+  size_t pos() const { return pos_; }
+
+ private:
+  const char* data_;
+  size_t size_;
+  size_t pos_ = 0;
+};
+
+class RimeSerializeContextTest : public DictionaryTestFixture {};
+
+TEST_F(RimeSerializeContextTest, SerializeComposingContext) {
+  RimeApi* rime = rime_get_api();
+  ASSERT_TRUE(RIME_API_AVAILABLE(rime, serialize_context));
+  EXPECT_EQ(0, rime->serialize_context(0, nullptr, 0));
+  RimeSessionId session_id = rime->create_session();
+  ASSERT_NE(0, session_id);
+  an<Session> session = Service::instance().GetSession(session_id);
+  ASSERT_TRUE(bool(session));
+  session->ApplySchema(new Schema("concurrency_test"));
+  ASSERT_TRUE(rime->simulate_key_sequence(session_id, "nihao"));
+  RIME_STRUCT(RimeContext, ctx);
+  ASSERT_TRUE(rime->get_context(session_id, &ctx));
+  ASSERT_LT(0, ctx.menu.num_candidates);
+
+  size_t size = rime->serialize_context(session_id, nullptr, 0);
+  ASSERT_LT(16u, size);
+  vector<char> buffer(size);
+  ASSERT_EQ(size,
+            rime->serialize_context(session_id, buffer.data(), buffer.size()));
+  ContextReader reader(buffer.data(), buffer.size());
+  // header
+  EXPECT_EQ(0, std::memcmp(buffer.data(), "RCTX", 4));
+  reader.ReadInt();  // the magic, compared above
+  EXPECT_EQ(1u, reader.ReadInt());
+  EXPECT_EQ(size, reader.ReadInt());
+  reader.ReadInt64();  // revision
+  // status
+  uint32_t flags = reader.ReadInt();
+  EXPECT_FALSE(flags & 1);  // is_disabled
+  EXPECT_TRUE(flags & 2);   // is_composing
+  EXPECT_EQ("concurrency_test", reader.ReadString());
+  EXPECT_EQ("Concurrency Test", reader.ReadString());
+  // composition
+  EXPECT_EQ(ctx.composition.preedit, reader.ReadString());
+  EXPECT_EQ(ctx.composition.cursor_pos, int(reader.ReadInt()));
+  EXPECT_EQ(ctx.composition.sel_start, int(reader.ReadInt()));
+  EXPECT_EQ(ctx.composition.sel_end, int(reader.ReadInt()));
+  EXPECT_EQ(ctx.commit_text_preview ? ctx.commit_text_preview : "",
+            reader.ReadString());
+  // menu
+  EXPECT_EQ(ctx.menu.page_size, int(reader.ReadInt()));
+  EXPECT_EQ(ctx.menu.page_no, int(reader.ReadInt()));
+  EXPECT_EQ(bool(ctx.menu.is_last_page), reader.ReadInt() != 0);
+  EXPECT_EQ(ctx.menu.highlighted_candidate_index, int(reader.ReadInt()));
+  ASSERT_EQ(ctx.menu.num_candidates, int(reader.ReadInt()));
+  for (int i = 0; i < ctx.menu.num_candidates; ++i) {
+    const RimeCandidate& candidate(ctx.menu.candidates[i]);
+    EXPECT_EQ(candidate.text, reader.ReadString());
+    EXPECT_EQ(candidate.comment ? candidate.comment : "", reader.ReadString());
+  }
+  EXPECT_EQ(ctx.menu.select_keys ? ctx.menu.select_keys : "",
+            reader.ReadString());
+  uint32_t num_select_labels = reader.ReadInt();
+  for (uint32_t i = 0; i < num_select_labels; ++i) {
+    reader.ReadString();
+  }
+  EXPECT_TRUE(reader.ok());
+  EXPECT_EQ(size, reader.pos());
+
+  // a buffer too small gets what fits, and the size needed is returned.
+  vector<char> truncated(size - 1);
+  EXPECT_EQ(size, rime->serialize_context(session_id, truncated.data(),
+                                          truncated.size()));
+  EXPECT_EQ(0, std::memcmp(truncated.data(), "RCTX", 4));
+
+  rime->free_context(&ctx);
+  rime->destroy_session(session_id);
+}
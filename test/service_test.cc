@@ -0,0 +1,77 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <atomic>
+#include <thread>
+#include <gtest/gtest.h>
+#include <rime/key_event.h>
+#include <rime/service.h>
+
+using namespace rime;
+
+TEST(RimeServiceTest, GetSessionsFromThreads) {
+  const int kNumThreads = 4;
+  const int kSessionsPerThread = 8;
+  const int kRounds = 1000;
+  Service& service = Service::instance();
+  vector<vector<SessionId>> sessions(kNumThreads);
+  for (auto& ids : sessions) {
+    for (int i = 0; i < kSessionsPerThread; ++i) {
+      SessionId id = service.CreateSession();
+      ASSERT_NE(kInvalidSessionId, id);
+      ids.push_back(id);
+    }
+  }
+  std::atomic<int> found = 0;
+  vector<std::thread> threads;
+  for (const auto& ids : sessions) {
+    threads.emplace_back([&service, &found, &ids] {
+      for (int round = 0; round < kRounds; ++round) {
+        for (SessionId id : ids) {
+          if (service.GetSession(id))
+            ++found;
+        }
+      }
+    });
+  }
+  // none of the sessions is stale.
+  for (int round = 0; round < kRounds / 10; ++round) {
+    service.CleanupStaleSessions();
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(kNumThreads * kSessionsPerThread * kRounds, found);
+  for (const auto& ids : sessions) {
+    for (SessionId id : ids) {
+      EXPECT_TRUE(service.DestroySession(id));
+      EXPECT_FALSE(service.GetSession(id));
+    }
+  }
+}
+
+TEST(RimeServiceTest, ProcessPostedKeys) {
+  Service& service = Service::instance();
+  SessionId id = service.CreateSession();
+  ASSERT_NE(kInvalidSessionId, id);
+  an<Session> session = service.GetSession(id);
+  ASSERT_TRUE(bool(session));
+  string processed;
+  service.SetNotificationHandler(
+      [&processed, id](SessionId session_id, const char* message_type,
+                       const char* message_value) {
+        if (session_id == id && string(message_type) == "keys")
+          processed += message_value;
+      });
+  KeySequence keys("abc");
+  for (const KeyEvent& key : keys) {
+    EXPECT_TRUE(session->PostKey(key));
+  }
+  session->WaitForPostedKeys();
+  service.ClearNotificationHandler();
+  // each key is told once, whether handled or not.
+  EXPECT_EQ(keys.size(), processed.size());
+  session.reset();
+  EXPECT_TRUE(service.DestroySession(id));
+}
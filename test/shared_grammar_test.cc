@@ -0,0 +1,95 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <thread>
+#include <gtest/gtest.h>
+#include <rime/config.h>
+#include <rime/registry.h>
+#include <rime/gear/caching_grammar.h>
+#include <rime/gear/shared_grammar.h>
+
+using namespace rime;
+
+static int models_created = 0;
+
+class QueryCountingModel : public Grammar {
+ public:
+  double Query(const string& context,
+               const string& word,
+               bool is_rear) override {
+    ++queries_;
+    return -double(context.length() + word.length());
+  }
+
+  int queries() const { return queries_; }
+
+ private:
+  int queries_ = 0;
+};
+
+class QueryCountingModelComponent : public Grammar::Component {
+ public:
+  Grammar* Create(Config* config) override {
+    ++models_created;
+    return new QueryCountingModel;
+  }
+};
+
+class RimeSharedGrammarTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    models_created = 0;
+    Registry::instance().Register("test_grammar", new QueryCountingModelComponent);
+    config_.SetString("grammar/language", "test");
+  }
+  void TearDown() override { Registry::instance().Unregister("test_grammar"); }
+
+  Config config_;
+};
+
+TEST_F(RimeSharedGrammarTest, OneModelPerSettings) {
+  const int kNumSessions = 100;
+  vector<an<Grammar>> grammars;
+  for (int i = 0; i < kNumSessions; ++i) {
+    grammars.push_back(SharedGrammar::Require("test_grammar", &config_));
+    ASSERT_TRUE(bool(grammars.back()));
+  }
+  EXPECT_EQ(1, models_created);
+  EXPECT_EQ(grammars.front(), grammars.back());
+  config_.SetString("grammar/language", "another");
+  auto another = SharedGrammar::Require("test_grammar", &config_);
+  EXPECT_EQ(2, models_created);
+  EXPECT_NE(grammars.front(), another);
+  // models are released when no longer in use.
+  grammars.clear();
+  config_.SetString("grammar/language", "test");
+  SharedGrammar::Require("test_grammar", &config_);
+  EXPECT_EQ(3, models_created);
+}
+
+TEST_F(RimeSharedGrammarTest, SerializesQueries) {
+  config_.SetInt("grammar/cache_size", 0);
+  auto grammar = SharedGrammar::Require("test_grammar", &config_);
+  ASSERT_TRUE(bool(grammar));
+  const int kNumThreads = 4;
+  const int kQueries = 1000;
+  vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([&config = config_] {
+      auto session_grammar = CachingGrammar::Wrap(
+          SharedGrammar::Require("test_grammar", &config), &config);
+      for (int j = 0; j < kQueries; ++j) {
+        session_grammar->Query("a", "b", false);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(1, models_created);
+  auto* model =
+      dynamic_cast<QueryCountingModel*>(As<SharedGrammar>(grammar)->model());
+  ASSERT_TRUE(model != nullptr);
+  EXPECT_EQ(kNumThreads * kQueries, model->queries());
+}
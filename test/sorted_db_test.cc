@@ -0,0 +1,77 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <gtest/gtest.h>
+#include <rime/dict/sorted_db.h>
+#include <rime/dict/table_db.h>
+#include <rime/dict/user_db.h>
+
+using namespace rime;
+
+class RimeSortedDbTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    TableDb source(path{"sorted_db_test.txt"}, "sorted_db_test");
+    if (source.Exists())
+      source.Remove();
+    ASSERT_TRUE(source.Open());
+    // enough records to span several index blocks
+    for (int i = 0; i < 100; ++i) {
+      source.Update("code" + std::to_string(i) + " \tphrase",
+                    "c=" + std::to_string(i));
+    }
+    source.Update("ni hao \t你好", "c=1");
+    source.Update("ni \t你", "c=2");
+    ASSERT_TRUE(source.Close());
+    SortedDb db(path{"sorted_db_test.sorted.bin"}, "sorted_db_test");
+    if (db.Exists())
+      db.Remove();
+  }
+};
+
+TEST_F(RimeSortedDbTest, CompileAndFetch) {
+  SortedDb db(path{"sorted_db_test.sorted.bin"}, "sorted_db_test");
+  ASSERT_TRUE(db.Compile());
+  ASSERT_TRUE(db.Exists());
+  ASSERT_TRUE(db.Open());
+  EXPECT_TRUE(db.readonly());
+  string value;
+  EXPECT_TRUE(db.Fetch("ni hao \t你好", &value));
+  EXPECT_EQ(1, UserDbValue(value).commits);
+  for (int i = 0; i < 100; ++i) {
+    string key = "code" + std::to_string(i) + " \tphrase";
+    EXPECT_TRUE(db.Fetch(key, &value)) << key;
+  }
+  EXPECT_FALSE(db.Fetch("ni hao", &value));
+  EXPECT_FALSE(db.Fetch("zzz", &value));
+  EXPECT_FALSE(db.Update("ni \t你", "c=3"));
+  string db_name;
+  EXPECT_TRUE(db.MetaFetch("/db_name", &db_name));
+  EXPECT_EQ("sorted_db_test", db_name);
+  EXPECT_TRUE(db.Close());
+}
+
+TEST_F(RimeSortedDbTest, Query) {
+  SortedDb db(path{"sorted_db_test.sorted.bin"}, "sorted_db_test");
+  // compiled on first open
+  ASSERT_TRUE(db.Open());
+  auto accessor = db.Query("ni ");
+  ASSERT_TRUE(bool(accessor));
+  string key, value;
+  EXPECT_TRUE(accessor->GetNextRecord(&key, &value));
+  EXPECT_EQ("ni \t你", key);
+  EXPECT_TRUE(accessor->GetNextRecord(&key, &value));
+  EXPECT_EQ("ni hao \t你好", key);
+  EXPECT_FALSE(accessor->GetNextRecord(&key, &value));
+  EXPECT_TRUE(accessor->exhausted());
+  accessor = db.QueryAll();
+  EXPECT_TRUE(accessor->Jump("code5"));
+  EXPECT_TRUE(accessor->GetNextRecord(&key, &value));
+  EXPECT_EQ("code5 \tphrase", key);
+  EXPECT_TRUE(accessor->Reset());
+  int count = 0;
+  while (accessor->GetNextRecord(&key, &value))
+    ++count;
+  EXPECT_EQ(102, count);
+}
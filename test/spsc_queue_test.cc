@@ -0,0 +1,54 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <thread>
+#include <gtest/gtest.h>
+#include <rime/algo/spsc_queue.h>
+
+using namespace rime;
+
+TEST(RimeSpscQueueTest, PushAndPop) {
+  SpscQueue<int> queue(2);
+  EXPECT_EQ(2, queue.capacity());
+  EXPECT_TRUE(queue.empty());
+  int value = 0;
+  EXPECT_FALSE(queue.TryPop(&value));
+  EXPECT_TRUE(queue.TryPush(1));
+  EXPECT_TRUE(queue.TryPush(2));
+  EXPECT_FALSE(queue.TryPush(3));
+  EXPECT_FALSE(queue.empty());
+  ASSERT_TRUE(queue.TryPop(&value));
+  EXPECT_EQ(1, value);
+  // wraps around.
+  EXPECT_TRUE(queue.TryPush(3));
+  ASSERT_TRUE(queue.TryPop(&value));
+  EXPECT_EQ(2, value);
+  ASSERT_TRUE(queue.TryPop(&value));
+  EXPECT_EQ(3, value);
+  EXPECT_TRUE(queue.empty());
+}
+
+TEST(RimeSpscQueueTest, PassItemsInOrderBetweenThreads) {
+  const int kNumItems = 100000;
+  SpscQueue<int> queue(16);
+  std::thread producer([&queue] {
+    for (int i = 0; i < kNumItems; ++i) {
+      while (!queue.TryPush(i)) {
+        std::this_thread::yield();
+      }
+    }
+  });
+  int expected = 0;
+  while (expected < kNumItems) {
+    int value = -1;
+    if (!queue.TryPop(&value)) {
+      std::this_thread::yield();
+      continue;
+    }
+    ASSERT_EQ(expected, value);
+    ++expected;
+  }
+  producer.join();
+  EXPECT_TRUE(queue.empty());
+}
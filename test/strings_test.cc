@@ -0,0 +1,44 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <gtest/gtest.h>
+#include <utf8.h>
+#include <rime/algo/strings.h>
+
+using namespace rime;
+
+TEST(RimeStringsTest, Utf8Length) {
+  EXPECT_EQ(0, strings::utf8_length(""));
+  EXPECT_EQ(5, strings::utf8_length("hello"));
+  EXPECT_EQ(2, strings::utf8_length("中文"));
+  // long enough to be scanned in blocks, with sequences across blocks
+  string text = "Rime 中州韻輸入法引擎 😀 emoji and text 𠀀";
+  for (int i = 0; i < 3; ++i) {
+    text += text;
+  }
+  size_t expected =
+      utf8::unchecked::distance(text.c_str(), text.c_str() + text.length());
+  EXPECT_EQ(expected, strings::utf8_length(text));
+}
+
+TEST(RimeStringsTest, Utf8Offset) {
+  string text = "ab中文😀cdefghijklmnopqrstuvwxyz輸入";
+  const char* p = text.c_str();
+  for (size_t i = 0; i <= strings::utf8_length(text); ++i) {
+    EXPECT_EQ(p - text.c_str(), strings::utf8_offset(text, i)) << "index " << i;
+    if (*p)
+      utf8::unchecked::next(p);
+  }
+  EXPECT_EQ(text.length(), strings::utf8_offset(text, 100));
+}
+
+TEST(RimeStringsTest, AsciiPrefixLength) {
+  EXPECT_EQ(0, strings::ascii_prefix_length(nullptr, nullptr));
+  string text = "abcdefghijklmnopqrstuvwxyz中";
+  EXPECT_EQ(26, strings::ascii_prefix_length(text.data(),
+                                             text.data() + text.length()));
+  text = "中" + text;
+  EXPECT_EQ(0, strings::ascii_prefix_length(text.data(),
+                                            text.data() + text.length()));
+}
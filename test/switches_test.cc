@@ -0,0 +1,48 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <sstream>
+#include <gtest/gtest.h>
+#include <rime/config.h>
+#include <rime/switches.h>
+
+using namespace rime;
+
+static const char* kSwitches =
+    "switches:\n"
+    "  - name: ascii_mode\n"
+    "    states: [中文, 西文]\n"
+    "    reset: 0\n"
+    "  - options: [zh_trad, zh_simp]\n"
+    "    states: [字符, 汉字]\n"
+    "    abbrev: [繁, 简]\n"
+    "  - name: ascii_mode\n"
+    "    states: [duplicate, ignored]\n";
+
+TEST(RimeSwitchIndexTest, AnswersAsSwitches) {
+  Config config;
+  std::istringstream stream(kSwitches);
+  ASSERT_TRUE(config.LoadFromStream(stream));
+  Switches switches(&config);
+  SwitchIndex index(&config);
+  ASSERT_EQ(4, index.options().size());
+  auto option = index.OptionByName("zh_simp");
+  ASSERT_TRUE(option != nullptr);
+  EXPECT_EQ(Switches::kRadioGroup, option->type);
+  EXPECT_EQ(1, option->switch_index);
+  EXPECT_EQ(1, option->option_index);
+  EXPECT_EQ(0, index.OptionByName("ascii_mode")->switch_index);
+  EXPECT_EQ(nullptr, index.OptionByName("full_shape"));
+  for (const char* name : {"ascii_mode", "zh_trad", "zh_simp", "x"}) {
+    for (int state = 0; state < 2; ++state) {
+      for (bool abbreviated : {false, true}) {
+        EXPECT_EQ(string(switches.GetStateLabel(name, state, abbreviated)),
+                  string(index.GetStateLabel(name, state, abbreviated)))
+            << name << " " << state << " " << abbreviated;
+      }
+    }
+  }
+  EXPECT_EQ("简", string(index.GetStateLabel("zh_simp", 1, true)));
+  EXPECT_FALSE(index.GetStateLabel("zh_simp", 0, false));
+}
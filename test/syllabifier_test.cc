@@ -160,3 +160,64 @@ TEST_F(RimeSyllabifierTest, TransposedSyllableGraph) {
   ASSERT_FALSE(NULL == g.indices[0][syllable_id_["chan"]][0]);
   EXPECT_EQ(4, g.indices[0][syllable_id_["chan"]][0]->end_pos);
 }
+
+static void ExpectSameGraph(const rime::SyllableGraph& expected,
+                            const rime::SyllableGraph& actual) {
+  EXPECT_EQ(expected.input_length, actual.input_length);
+  EXPECT_EQ(expected.interpreted_length, actual.interpreted_length);
+  EXPECT_EQ(expected.vertices, actual.vertices);
+  ASSERT_EQ(expected.edges.size(), actual.edges.size());
+  for (const auto& start : expected.edges) {
+    auto a = actual.edges.find(start.first);
+    ASSERT_FALSE(actual.edges.end() == a);
+    ASSERT_EQ(start.second.size(), a->second.size());
+    for (const auto& end : start.second) {
+      auto b = a->second.find(end.first);
+      ASSERT_FALSE(a->second.end() == b);
+      ASSERT_EQ(end.second.size(), b->second.size());
+      for (const auto& spelling : end.second) {
+        auto c = b->second.find(spelling.first);
+        ASSERT_FALSE(b->second.end() == c);
+        EXPECT_EQ(spelling.second.type, c->second.type);
+        EXPECT_EQ(spelling.second.end_pos, c->second.end_pos);
+        EXPECT_DOUBLE_EQ(spelling.second.credibility, c->second.credibility);
+      }
+    }
+  }
+  EXPECT_EQ(expected.indices.size(), actual.indices.size());
+}
+
+TEST_F(RimeSyllabifierTest, IncrementalSyllableGraph) {
+  const char* inputs[] = {
+      "c",       "ch",    "cha", "chan", "chang", "changa", "changan",
+      "changa",  "chang", "cha", "chan", "chana", "chanan", "tuan",
+      "tuanan",  "tu",    "t",   "",     "anana", "ana",    "anan",
+  };
+  rime::Syllabifier s;
+  rime::SyllabifierCache cache;
+  for (const char* input : inputs) {
+    rime::SyllableGraph expected;
+    rime::SyllableGraph actual;
+    int expected_length = s.BuildSyllableGraph(input, *prism_, &expected);
+    int actual_length = s.BuildSyllableGraph(input, *prism_, &actual, &cache);
+    EXPECT_EQ(expected_length, actual_length) << "input: " << input;
+    ExpectSameGraph(expected, actual);
+  }
+}
+
+TEST_F(RimeSyllabifierTest, IncrementalCompletion) {
+  const char* inputs[] = {
+      "c",        "ch", "cha", "chan", "chang", "changh", "changha", "chang",
+      "changha", "changhan", "ha", "han", "hx", "t", "tu", "tua",
+  };
+  rime::Syllabifier s("", true);
+  rime::SyllabifierCache cache;
+  for (const char* input : inputs) {
+    rime::SyllableGraph expected;
+    rime::SyllableGraph actual;
+    int expected_length = s.BuildSyllableGraph(input, *prism_, &expected);
+    int actual_length = s.BuildSyllableGraph(input, *prism_, &actual, &cache);
+    EXPECT_EQ(expected_length, actual_length) << "input: " << input;
+    ExpectSameGraph(expected, actual);
+  }
+}
@@ -5,7 +5,9 @@
 // 2011-07-03 GONG Chen <chen.sst@gmail.com>
 //
 #include <gtest/gtest.h>
+#include <rime/memory_stats.h>
 #include <rime/algo/syllabifier.h>
+#include <rime/dict/string_table.h>
 #include <rime/dict/table.h>
 
 class RimeTableTest : public ::testing::Test {
@@ -30,7 +32,7 @@ class RimeTableTest : public ::testing::Test {
   static void PrepareSampleVocabulary(rime::Syllabary& syll,
                                       rime::Vocabulary& voc);
   static rime::string Text(const rime::TableAccessor& a) {
-    return table_->GetEntryText(*a.entry());
+    return table_->GetEntryText(*a.entry_text());
   }
   static rime::the<rime::Table> table_;
 };
@@ -97,6 +99,181 @@ TEST_F(RimeTableTest, IntegrityTest) {
   ASSERT_TRUE(table_->Load());
 }
 
+TEST_F(RimeTableTest, LoadWithFlags) {
+  table_.reset(new rime::Table(rime::path{"table_test.bin"}));
+  table_->set_load_flags(rime::MappedFile::kLoadPrefetch |
+                         rime::MappedFile::kLoadRandomAccess |
+                         rime::MappedFile::kLoadHugePages);
+  ASSERT_TRUE(table_->Load());
+  rime::TableAccessor v = table_->QueryWords(1);
+  ASSERT_FALSE(v.exhausted());
+  EXPECT_EQ("yi", Text(v));
+}
+
+TEST_F(RimeTableTest, FlatTrunkIndex) {
+  ASSERT_TRUE(table_->metadata() != NULL);
+  EXPECT_STREQ("Rime::Table/5.0", table_->metadata()->format);
+  EXPECT_TRUE(table_->has_flat_trunk_index());
+}
+
+TEST_F(RimeTableTest, SyllableFilter) {
+  rime::Table table(rime::path{"table_test.bin"});
+  EXPECT_TRUE(table.MayMatch(0));
+  ASSERT_TRUE(table.LoadSyllableFilter());
+  EXPECT_FALSE(table.IsOpen());
+  // no entries start with '0' or '4'
+  EXPECT_FALSE(table.MayMatch(0));
+  EXPECT_TRUE(table.MayMatch(1));
+  EXPECT_TRUE(table.MayMatch(2));
+  EXPECT_TRUE(table.MayMatch(3));
+  EXPECT_FALSE(table.MayMatch(4));
+  EXPECT_FALSE(table.MayMatch(100));
+}
+
+TEST_F(RimeTableTest, CompactEntries) {
+  rime::Syllabary syll;
+  rime::Vocabulary voc;
+  PrepareSampleVocabulary(syll, voc);
+  rime::Table table(rime::path{"table_test_compact.bin"});
+  table.Remove();
+  table.set_compact_entries(true);
+  ASSERT_TRUE(table.Build(syll, voc, total_num_entries));
+  ASSERT_TRUE(table.Save());
+  table.Close();
+
+  rime::Table loaded(rime::path{"table_test_compact.bin"});
+  ASSERT_TRUE(loaded.Load());
+  EXPECT_STREQ("Rime::Table/6.0", loaded.metadata()->format);
+  EXPECT_TRUE(loaded.has_compact_entries());
+  // not a table of codes
+  EXPECT_FALSE(loaded.has_code_trie());
+  EXPECT_FALSE(table_->has_compact_entries());
+  for (rime::SyllableId id = 0; id < 4; ++id) {
+    rime::TableAccessor expected = table_->QueryWords(id);
+    rime::TableAccessor v = loaded.QueryWords(id);
+    ASSERT_EQ(expected.remaining(), v.remaining());
+    for (; !v.exhausted(); v.Next(), expected.Next()) {
+      EXPECT_TRUE(v.entry() == NULL);
+      EXPECT_EQ(Text(expected), loaded.GetEntryText(*v.entry_text()));
+      EXPECT_NEAR(expected.entry_weight(), v.entry_weight(),
+                  1.0 / rime::table::kQuantizedWeightScale);
+    }
+  }
+  // long entries in the tail index are not compact
+  rime::Code code;
+  code.push_back(1);
+  code.push_back(2);
+  code.push_back(3);
+  code.push_back(4);
+  rime::TableAccessor v = loaded.QueryPhrases(code);
+  ASSERT_EQ(2, v.remaining());
+  ASSERT_TRUE(v.entry() != NULL);
+  EXPECT_EQ("yi-er-san-si", loaded.GetEntryText(*v.entry_text()));
+  EXPECT_EQ(1.0, v.entry_weight());
+  loaded.Close();
+}
+
+TEST(RimeTableCodeTrieTest, RankedCompletions) {
+  rime::Syllabary syll{"a", "ab", "abc", "b"};
+  rime::Vocabulary voc;
+  auto add_entry = [&voc](rime::SyllableId id, const char* text,
+                          double weight) {
+    auto d = rime::New<rime::ShortDictEntry>();
+    d->code.push_back(id);
+    d->text = text;
+    d->weight = weight;
+    voc[id].entries.push_back(d);
+  };
+  add_entry(0, "a", 1.0);
+  add_entry(1, "ab-1", 2.0);
+  add_entry(1, "ab-2", -1.0);
+  add_entry(2, "abc", 3.0);
+  add_entry(3, "b", 0.0);
+  rime::Table table(rime::path{"table_test_code_trie.bin"});
+  table.Remove();
+  table.set_compact_entries(true);
+  ASSERT_TRUE(table.Build(syll, voc, 5));
+  ASSERT_TRUE(table.Save());
+  table.Close();
+
+  rime::Table loaded(rime::path{"table_test_code_trie.bin"});
+  ASSERT_TRUE(loaded.Load());
+  EXPECT_STREQ("Rime::Table/6.1", loaded.metadata()->format);
+  EXPECT_TRUE(loaded.has_code_trie());
+  const rime::table::CodeTrieNode* node = loaded.FindCodeTrieNode("a");
+  ASSERT_TRUE(node != NULL);
+  EXPECT_EQ(3, node->num_codes);
+  // by the length of the code, then by weight
+  const char* expected[] = {"a", "ab-1", "ab-2", "abc"};
+  ASSERT_EQ(4, node->entries.size);
+  for (size_t i = 0; i < 4; ++i) {
+    EXPECT_EQ(expected[i], loaded.GetEntryText(node->entries.at[i].text));
+  }
+  EXPECT_NEAR(2.0, node->entries.at[1].weight,
+              1.0 / rime::table::kQuantizedWeightScale);
+  node = loaded.FindCodeTrieNode("ab");
+  ASSERT_TRUE(node != NULL);
+  EXPECT_EQ(2, node->num_codes);
+  EXPECT_EQ(1, node->entries.at[0].syllable_id);
+  EXPECT_EQ(NULL, loaded.FindCodeTrieNode("c"));
+  // deeper than the trie
+  EXPECT_EQ(NULL, loaded.FindCodeTrieNode("abc"));
+  loaded.Close();
+}
+
+TEST(RimeTableWeightTest, QuantizeWeight) {
+  using rime::table::DequantizeWeight;
+  using rime::table::QuantizeWeight;
+  for (double count : {1.0, 3.0, 7.0, 100.0, 12345.0, 1e8}) {
+    double weight = log(count);
+    EXPECT_NEAR(weight, DequantizeWeight(QuantizeWeight(weight)), 1e-3);
+  }
+  EXPECT_EQ(0.0, DequantizeWeight(QuantizeWeight(0.0)));
+  EXPECT_GT(QuantizeWeight(log(3.0)), QuantizeWeight(log(2.0)));
+  // out of range weights are clamped
+  EXPECT_EQ(0, QuantizeWeight(-100.0));
+  EXPECT_EQ(65535, QuantizeWeight(100.0));
+}
+
+TEST_F(RimeTableTest, AlignedStringTableImage) {
+  ASSERT_TRUE(table_->metadata() != NULL);
+  const char* image = table_->metadata()->string_table.get();
+  ASSERT_TRUE(image != NULL);
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(image) %
+                   rime::StringTable::kImageAlignment);
+}
+
+TEST_F(RimeTableTest, DenseSyllabary) {
+  auto syllabary = table_->dense_syllabary();
+  ASSERT_TRUE(bool(syllabary));
+  EXPECT_EQ(table_->metadata()->num_syllables, syllabary->size());
+  EXPECT_EQ(syllabary, table_->dense_syllabary());
+  for (rime::SyllableId id = 0; id < (int)syllabary->size(); ++id) {
+    EXPECT_EQ(table_->GetSyllableById(id), syllabary->spelling(id));
+    EXPECT_EQ(id, syllabary->Find(syllabary->spelling(id)));
+  }
+  EXPECT_EQ(-1, syllabary->Find("5"));
+  EXPECT_TRUE(syllabary->spelling(-1).empty());
+}
+
+TEST_F(RimeTableTest, MemoryUsage) {
+  auto find_usage = [](const rime::string& category) {
+    for (const auto& usage : rime::MemoryStats::Collect()) {
+      if (usage.category == category && usage.name == "table_test.bin")
+        return usage;
+    }
+    return rime::MemoryUsage();
+  };
+  rime::MemoryUsage mapped = find_usage("table");
+  EXPECT_EQ(table_->file_size(), mapped.mapped_bytes);
+  EXPECT_GE(mapped.mapped_bytes, mapped.resident_bytes);
+  rime::MemoryUsage string_table = find_usage("string_table");
+  EXPECT_LT(0, string_table.count);
+  table_->Close();
+  EXPECT_TRUE(find_usage("table").category.empty());
+  EXPECT_TRUE(find_usage("string_table").category.empty());
+}
+
 TEST_F(RimeTableTest, SimpleQuery) {
   EXPECT_STREQ("0", table_->GetSyllableById(0).c_str());
   EXPECT_STREQ("3", table_->GetSyllableById(3).c_str());
@@ -203,3 +380,123 @@ TEST_F(RimeTableTest, QueryWithSyllableGraph) {
   EXPECT_STREQ("lia", Text(result[4].front()).c_str());
   EXPECT_FALSE(result[4].front().Next());
 }
+
+TEST_F(RimeTableTest, QueryWithCache) {
+  const rime::string input("yiersansi");
+  rime::SyllableGraph g;
+  g.input_length = input.length();
+  g.interpreted_length = g.input_length;
+  g.edges[0][2][1].end_pos = 2;
+  g.edges[2][4][2].end_pos = 4;
+  g.edges[4][7][3].end_pos = 7;
+  g.edges[7][9][4].end_pos = 9;
+  g.indices[0][1].push_back(&g.edges[0][2][1]);
+  g.indices[2][2].push_back(&g.edges[2][4][2]);
+  g.indices[4][3].push_back(&g.edges[4][7][3]);
+  g.indices[7][4].push_back(&g.edges[7][9][4]);
+
+  rime::TableQueryCache cache;
+  rime::TableQueryResult expected;
+  ASSERT_TRUE(table_->Query(g, 0, &expected));
+  for (int i = 0; i < 2; ++i) {
+    rime::TableQueryResult result;
+    ASSERT_TRUE(table_->Query(g, 0, &result, &cache));
+    EXPECT_LT(0, cache.size());
+    ASSERT_EQ(expected.size(), result.size());
+    for (const auto& x : expected) {
+      ASSERT_TRUE(result.find(x.first) != result.end());
+      const auto& accessors = result[x.first];
+      ASSERT_EQ(x.second.size(), accessors.size());
+      for (size_t j = 0; j < accessors.size(); ++j) {
+        EXPECT_EQ(x.second[j].entry(), accessors[j].entry());
+        EXPECT_EQ(x.second[j].remaining(), accessors[j].remaining());
+      }
+    }
+  }
+  // a reloaded table invalidates cached nodes.
+  size_t cached = cache.size();
+  table_->Load();
+  rime::TableQueryResult result;
+  ASSERT_TRUE(table_->Query(g, 4, &result, &cache));
+  EXPECT_GT(cached, cache.size());
+}
+
+TEST(RimeTableWideTrunkTest, QueryPhrases) {
+  const int kNumSyllables = 400;
+  rime::Syllabary syll;
+  rime::Vocabulary voc;
+  for (int i = 0; i < kNumSyllables; ++i) {
+    syll.insert(std::to_string(i));
+  }
+  // a popular prefix with many children in the trunk index.
+  auto lv2 = rime::New<rime::Vocabulary>();
+  voc[0].next_level = lv2;
+  size_t num_entries = 0;
+  for (int i = 0; i < kNumSyllables; i += 2) {
+    auto d = rime::New<rime::ShortDictEntry>();
+    d->code.push_back(0);
+    d->code.push_back(i);
+    d->text = "0-" + std::to_string(i);
+    d->weight = 1.0;
+    (*lv2)[i].entries.push_back(d);
+    ++num_entries;
+  }
+  rime::Table table(rime::path{"table_test_wide.bin"});
+  table.Remove();
+  ASSERT_TRUE(table.Build(syll, voc, num_entries));
+  ASSERT_TRUE(table.Save());
+  ASSERT_TRUE(table.Load());
+  for (int i = 0; i < kNumSyllables; ++i) {
+    rime::Code code;
+    code.push_back(0);
+    code.push_back(i);
+    rime::TableAccessor v = table.QueryPhrases(code);
+    if (i % 2 == 0) {
+      ASSERT_FALSE(v.exhausted()) << "key: " << i;
+      EXPECT_EQ("0-" + std::to_string(i), table.GetEntryText(*v.entry()));
+    } else {
+      EXPECT_TRUE(v.exhausted()) << "key: " << i;
+    }
+  }
+  table.Close();
+}
+
+TEST(RimeStringTableTest, DecodeCachedStrings) {
+  rime::StringTableBuilder builder;
+  const int kNumKeys = 3000;
+  rime::vector<rime::StringId> ids(kNumKeys);
+  for (int i = 0; i < kNumKeys; ++i) {
+    builder.Add("key" + std::to_string(i), 1.0, &ids[i]);
+  }
+  builder.Build();
+  // decode more strings than the cache holds, twice, in different orders
+  for (int i = 0; i < kNumKeys; ++i) {
+    EXPECT_EQ("key" + std::to_string(i), builder.GetString(ids[i]));
+  }
+  for (int i = kNumKeys - 1; i >= 0; --i) {
+    EXPECT_EQ("key" + std::to_string(i), builder.GetString(ids[i]));
+  }
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ("key0", builder.GetString(ids[0]));
+  }
+}
+
+// changes the trie without the decoded strings being cleared.
+class TestStringTable : public rime::StringTableBuilder {
+ public:
+  void DropTrie() { trie_.clear(); }
+};
+
+TEST(RimeStringTableTest, ServeDecodedStringsFromCache) {
+  TestStringTable table;
+  rime::StringId id = rime::kInvalidStringId;
+  table.Add("key", 1.0, &id);
+  table.Build();
+  EXPECT_EQ("key", table.GetString(id));
+  table.DropTrie();
+  // served from the cache, as the trie no longer has it
+  EXPECT_EQ("key", table.GetString(id));
+  // but not once the table is cleared
+  table.Clear();
+  EXPECT_EQ("", table.GetString(id));
+}
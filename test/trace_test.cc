@@ -0,0 +1,83 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <gtest/gtest.h>
+#include <rime_api.h>
+#include <rime/trace.h>
+
+TEST(RimeTraceTest, SessionTrace) {
+  RimeApi* rime = rime_get_api();
+  ASSERT_TRUE(RIME_API_AVAILABLE(rime, set_tracing));
+  ASSERT_TRUE(RIME_API_AVAILABLE(rime, get_trace));
+  RimeSessionId session = rime->create_session();
+  ASSERT_NE(0, session);
+  char buffer[4096];
+#ifdef RIME_ENABLE_TRACING
+  EXPECT_TRUE(rime->set_tracing(session, True));
+  rime->simulate_key_sequence(session, "a");
+  size_t length = rime->get_trace(session, buffer, sizeof(buffer), True);
+  ASSERT_GT(length, 0);
+  ASSERT_LT(length, sizeof(buffer));
+  rime::string trace(buffer);
+  EXPECT_EQ(0, trace.find("{\"traceEvents\":["));
+  EXPECT_NE(rime::string::npos, trace.find("\"name\":\"process_key\""));
+  EXPECT_NE(rime::string::npos, trace.find("\"key\":\"a\""));
+  // cleared
+  EXPECT_EQ(strlen("{\"traceEvents\":[]}"),
+            rime->get_trace(session, buffer, sizeof(buffer), False));
+#else
+  EXPECT_FALSE(rime->set_tracing(session, True));
+  EXPECT_EQ(0, rime->get_trace(session, buffer, sizeof(buffer), True));
+  EXPECT_EQ('\0', buffer[0]);
+#endif  // RIME_ENABLE_TRACING
+  rime->destroy_session(session);
+}
+
+#ifdef RIME_ENABLE_TRACING
+
+using namespace rime;
+
+TEST(RimeTraceTest, TraceScope) {
+  Tracer tracer;
+  {
+    Tracer::Activation activation(&tracer);
+    EXPECT_EQ(&tracer, Tracer::current());
+    bool named = false;
+    {
+      RIME_TRACE_SCOPE("test", (named = true, "skipped"));
+    }
+    // names are not made while the tracer is disabled.
+    EXPECT_FALSE(named);
+    tracer.set_enabled(true);
+    tracer.BeginKeyEvent("Tab");
+    {
+      RIME_TRACE_SCOPE("test", "tab \"key\"");
+    }
+  }
+  EXPECT_EQ(nullptr, Tracer::current());
+  ASSERT_EQ(1, tracer.events().size());
+  EXPECT_EQ(1, tracer.events()[0].key_event);
+  EXPECT_EQ(
+      "{\"traceEvents\":[{\"name\":\"tab \\\"key\\\"\",\"cat\":\"test\","
+      "\"ph\":\"X\",\"ts\":" +
+          std::to_string(tracer.events()[0].begin) +
+          ",\"dur\":" + std::to_string(tracer.events()[0].duration) +
+          ",\"pid\":1,\"tid\":1,\"args\":{\"key_event\":1,\"key\":\"Tab\"}}]}",
+      tracer.ToChromeTraceJson());
+}
+
+TEST(RimeTraceTest, DropOldestEvents) {
+  Tracer tracer;
+  tracer.set_enabled(true);
+  auto now = Tracer::Clock::now();
+  for (size_t i = 0; i < Tracer::kMaxEvents + 1; ++i) {
+    tracer.Record("test", std::to_string(i), now, now);
+  }
+  ASSERT_EQ(Tracer::kMaxEvents, tracer.events().size());
+  auto json = tracer.ToChromeTraceJson();
+  EXPECT_EQ(string::npos, json.find("\"name\":\"0\""));
+  EXPECT_EQ(0, json.find("{\"traceEvents\":[{\"name\":\"1\""));
+}
+
+#endif  // RIME_ENABLE_TRACING
@@ -0,0 +1,120 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <fstream>
+#include <gtest/gtest.h>
+#include <rime/common.h>
+#include <rime/dict/db_utils.h>
+#include <rime/dict/tsv.h>
+
+using namespace rime;
+
+static const path kTestFile("tsv_test.txt");
+
+static void WriteTestFile(const string& content) {
+  std::ofstream out(kTestFile.c_str(), std::ios::binary);
+  out << content;
+}
+
+TEST(RimeTsvLineReaderTest, ReadLines) {
+  WriteTestFile("# comment\r\nni\tni hao\t100\r\n\nhao  \n\t\tlast");
+  TsvLineReader reader(kTestFile);
+  ASSERT_TRUE(reader.Open());
+  vector<string> lines;
+  std::string_view line;
+  while (reader.ReadLine(&line)) {
+    lines.emplace_back(line);
+  }
+  EXPECT_EQ(5, reader.line_number());
+  ASSERT_EQ(5, lines.size());
+  EXPECT_EQ("# comment", lines[0]);
+  EXPECT_EQ("ni\tni hao\t100", lines[1]);
+  EXPECT_EQ("", lines[2]);
+  EXPECT_EQ("hao", lines[3]);
+  EXPECT_EQ("\t\tlast", lines[4]);
+}
+
+TEST(RimeTsvLineReaderTest, EmptyFile) {
+  WriteTestFile("");
+  TsvLineReader reader(kTestFile);
+  ASSERT_TRUE(reader.Open());
+  std::string_view line;
+  EXPECT_FALSE(reader.ReadLine(&line));
+  EXPECT_EQ(0, reader.line_number());
+}
+
+TEST(RimeTsvLineReaderTest, SplitFields) {
+  TsvFields fields;
+  TsvLineReader::Split("ni\tni hao\t\t100", &fields);
+  ASSERT_EQ(4, fields.size());
+  EXPECT_EQ("ni", fields[0]);
+  EXPECT_EQ("ni hao", fields[1]);
+  EXPECT_EQ("", fields[2]);
+  EXPECT_EQ("100", fields[3]);
+  TsvLineReader::Split("", &fields);
+  ASSERT_EQ(1, fields.size());
+  EXPECT_TRUE(fields[0].empty());
+}
+
+namespace {
+
+class NumberSource : public Source {
+ public:
+  explicit NumberSource(int count) : count_(count) {}
+  bool MetaGet(string* key, string* value) override { return false; }
+  bool Get(string* key, string* value) override {
+    if (next_ == count_)
+      return false;
+    *key = std::to_string(next_++);
+    *value = *key;
+    return true;
+  }
+
+ private:
+  int count_;
+  int next_ = 0;
+};
+
+class CountingSink : public Sink {
+ public:
+  bool MetaPut(const string& key, const string& value) override {
+    return true;
+  }
+  bool Put(const string& key, const string& value) override {
+    return key == value && ++count;
+  }
+  int count = 0;
+};
+
+}  // namespace
+
+TEST(RimeTsvTest, ReportProgress) {
+  const int kCount = TsvWriter::kProgressInterval * 2 + 1;
+  TsvWriter writer(kTestFile, [](const string& key, const string& value,
+                                 Tsv* row) {
+    *row = {key, value};
+    return true;
+  });
+  vector<int> written;
+  writer.progress = [&written](int n) { written.push_back(n); };
+  NumberSource source(kCount);
+  EXPECT_EQ(kCount, writer << source);
+  EXPECT_EQ((vector<int>{TsvWriter::kProgressInterval,
+                         TsvWriter::kProgressInterval * 2}),
+            written);
+  TsvReader reader(kTestFile, [](const TsvFields& row, string* key,
+                                 string* value) {
+    if (row.size() != 2)
+      return false;
+    *key = string(row[0]);
+    *value = string(row[1]);
+    return true;
+  });
+  int reported = 0;
+  reader.progress = [&reported](int n) { reported = n; };
+  CountingSink sink;
+  EXPECT_EQ(kCount, reader >> sink);
+  EXPECT_EQ(kCount, sink.count);
+  EXPECT_EQ(TsvReader::kProgressInterval * 2, reported);
+}
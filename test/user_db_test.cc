@@ -4,8 +4,14 @@
 //
 // 2011-07-03 GONG Chen <chen.sst@gmail.com>
 //
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <thread>
 #include <gtest/gtest.h>
 #include <rime/algo/syllabifier.h>
+#include <rime/dict/level_db.h>
+#include <rime/dict/lmdb_db.h>
 #include <rime/dict/text_db.h>
 #include <rime/dict/user_db.h>
 
@@ -40,6 +46,59 @@ TEST(RimeUserDbTest, AccessRecordByKey) {
   ASSERT_FALSE(db.loaded());
 }
 
+TEST(RimeUserDbTest, JournalUpdatesOfTextDb) {
+  TestDb db(path{"user_db_journal_test.txt"}, "user_db_journal_test");
+  path journal_path("user_db_journal_test.txt.journal");
+  if (db.Exists())
+    db.Remove();
+  ASSERT_TRUE(db.Open());
+  EXPECT_TRUE(db.Update("abc \tX", "ZYX"));
+  EXPECT_TRUE(db.Update("zyx \tY", "CBA"));
+  EXPECT_TRUE(db.Close());
+  // a new db is written in full.
+  EXPECT_TRUE(db.Exists());
+  EXPECT_FALSE(std::filesystem::exists(journal_path));
+  auto file_size = std::filesystem::file_size(db.file_path());
+
+  ASSERT_TRUE(db.Open());
+  EXPECT_TRUE(db.Update("abc \tX", "XYZ"));
+  EXPECT_TRUE(db.Erase("zyx \tY"));
+  EXPECT_TRUE(db.Update("a\\b \tZ", "d"));
+  EXPECT_TRUE(db.Close());
+  // updates are appended to the journal, leaving the file as it was.
+  EXPECT_TRUE(std::filesystem::exists(journal_path));
+  EXPECT_EQ(file_size, std::filesystem::file_size(db.file_path()));
+  {
+    // a record cut short is dropped.
+    std::ofstream journal(journal_path.c_str(), std::ios::app);
+    journal << "+\tcut \\tW\tc=1";
+  }
+  ASSERT_TRUE(db.OpenReadOnly());
+  string value;
+  EXPECT_TRUE(db.Fetch("abc \tX", &value));
+  EXPECT_EQ("XYZ", value);
+  EXPECT_FALSE(db.Fetch("zyx \tY", &value));
+  EXPECT_FALSE(db.Fetch("cut \tW", &value));
+  EXPECT_TRUE(db.Fetch("a\\b \tZ", &value));
+  EXPECT_EQ("d", value);
+  EXPECT_TRUE(db.Close());
+
+  // the journal is compacted into the file once it grows large.
+  ASSERT_TRUE(db.Open());
+  for (int i = 0; i < 2000; ++i) {
+    EXPECT_TRUE(db.Update("abc \tX", std::to_string(i)));
+  }
+  EXPECT_TRUE(db.Close());
+  EXPECT_FALSE(std::filesystem::exists(journal_path));
+  ASSERT_TRUE(db.OpenReadOnly());
+  EXPECT_TRUE(db.Fetch("abc \tX", &value));
+  EXPECT_EQ("1999", value);
+  EXPECT_FALSE(db.Fetch("cut \tW", &value));
+  EXPECT_TRUE(db.Close());
+  EXPECT_TRUE(db.Remove());
+  EXPECT_FALSE(db.Exists());
+}
+
 TEST(RimeUserDbTest, Query) {
   TestDb db(path{"user_db_test.txt"}, "user_db_test");
   if (db.Exists())
@@ -89,3 +148,358 @@ TEST(RimeUserDbTest, Query) {
   }
   db.Close();
 }
+
+TEST(RimeUserDbTest, ReadPendingWrites) {
+  using LevelUserDb = UserDbWrapper<LevelDb>;
+  LevelUserDb db(path{"user_db_test.userdb"}, "user_db_test");
+  if (db.Exists())
+    db.Remove();
+  ASSERT_TRUE(db.Open());
+  EXPECT_TRUE(db.Update("abc", "ZYX"));
+  EXPECT_TRUE(db.Update("wvu", "DEF"));
+  EXPECT_TRUE(db.FlushPendingWrites());
+  EXPECT_TRUE(db.BeginTransaction());
+  EXPECT_TRUE(db.Update("abd", "ZYW"));
+  EXPECT_TRUE(db.Erase("wvu"));
+  string value;
+  // reads see writes of the transaction
+  EXPECT_TRUE(db.Fetch("abd", &value));
+  EXPECT_EQ("ZYW", value);
+  EXPECT_FALSE(db.Fetch("wvu", &value));
+  EXPECT_TRUE(db.AbortTransaction());
+  EXPECT_FALSE(db.Fetch("abd", &value));
+  EXPECT_TRUE(db.Fetch("wvu", &value));
+  EXPECT_TRUE(db.BeginTransaction());
+  EXPECT_TRUE(db.Update("abd", "ZYW"));
+  EXPECT_TRUE(db.Update("abc", "ZYV"));
+  EXPECT_TRUE(db.Erase("wvu"));
+  EXPECT_TRUE(db.CommitTransaction());
+  {
+    // pending writes are merged into queries
+    an<DbAccessor> accessor = db.QueryAll();
+    ASSERT_TRUE(bool(accessor));
+    string key;
+    EXPECT_TRUE(accessor->GetNextRecord(&key, &value));
+    EXPECT_EQ("abc", key);
+    EXPECT_EQ("ZYV", value);
+    EXPECT_TRUE(accessor->GetNextRecord(&key, &value));
+    EXPECT_EQ("abd", key);
+    EXPECT_FALSE(accessor->GetNextRecord(&key, &value));
+  }
+  // pending writes are flushed on closing
+  EXPECT_TRUE(db.Close());
+  ASSERT_TRUE(db.Open());
+  EXPECT_TRUE(db.Fetch("abd", &value));
+  EXPECT_EQ("ZYW", value);
+  EXPECT_FALSE(db.Fetch("wvu", &value));
+  db.Close();
+  db.Remove();
+}
+
+TEST(RimeUserDbTest, ReadCommittedWritesFromOtherThreads) {
+  using LevelUserDb = UserDbWrapper<LevelDb>;
+  LevelUserDb db(path{"user_db_mvcc_test.userdb"}, "user_db_mvcc_test");
+  if (db.Exists())
+    db.Remove();
+  ASSERT_TRUE(db.Open());
+  EXPECT_TRUE(db.Update("abc", "0"));
+  EXPECT_TRUE(db.BeginTransaction());
+  EXPECT_TRUE(db.Update("abc", "1"));
+  // the writes of a transaction are not seen by other threads
+  std::thread([&db] {
+    string value;
+    EXPECT_TRUE(db.Fetch("abc", &value));
+    EXPECT_EQ("0", value);
+    auto accessor = db.Query("abc");
+    string key;
+    EXPECT_TRUE(accessor->GetNextRecord(&key, &value));
+    EXPECT_EQ("0", value);
+  }).join();
+  EXPECT_TRUE(db.CommitTransaction());
+  // readers run while another thread commits and flushes
+  std::atomic<bool> done(false);
+  std::thread writer([&db, &done] {
+    for (int i = 2; i < 1000; ++i) {
+      db.BeginTransaction();
+      db.Update("abc", std::to_string(i));
+      db.Update("abd", std::to_string(i));
+      db.CommitTransaction();
+    }
+    done = true;
+  });
+  vector<std::thread> readers;
+  for (int n = 0; n < 4; ++n) {
+    readers.emplace_back([&db, &done] {
+      int last = 0;
+      while (!done) {
+        string value;
+        ASSERT_TRUE(db.Fetch("abc", &value));
+        int current = std::stoi(value);
+        EXPECT_LE(last, current);
+        last = current;
+        // both keys of a commit are seen together in a query
+        auto accessor = db.Query("ab");
+        string key, abc, abd;
+        if (accessor->GetNextRecord(&key, &abc) &&
+            accessor->GetNextRecord(&key, &abd)) {
+          EXPECT_EQ(abc, abd);
+        }
+      }
+    });
+  }
+  writer.join();
+  for (auto& reader : readers) {
+    reader.join();
+  }
+  db.Close();
+  db.Remove();
+}
+
+TEST(RimeUserDbTest, TransactionsOnSeveralThreads) {
+  using LevelUserDb = UserDbWrapper<LevelDb>;
+  LevelUserDb db(path{"user_db_batch_test.userdb"}, "user_db_batch_test");
+  if (db.Exists())
+    db.Remove();
+  ASSERT_TRUE(db.Open());
+  EXPECT_TRUE(db.BeginTransaction());
+  EXPECT_TRUE(db.Update("abc", "1"));
+  // another thread begins and commits a transaction of its own meanwhile
+  std::thread([&db] {
+    EXPECT_FALSE(db.in_transaction());
+    EXPECT_FALSE(db.CommitTransaction());
+    EXPECT_TRUE(db.BeginTransaction());
+    EXPECT_TRUE(db.in_transaction());
+    EXPECT_TRUE(db.Update("abd", "2"));
+    string value;
+    EXPECT_FALSE(db.Fetch("abc", &value));
+    EXPECT_TRUE(db.CommitTransaction());
+    EXPECT_FALSE(db.in_transaction());
+  }).join();
+  // which leaves the transaction of this thread as it was
+  EXPECT_TRUE(db.in_transaction());
+  string value;
+  EXPECT_TRUE(db.Fetch("abc", &value));
+  EXPECT_EQ("1", value);
+  EXPECT_TRUE(db.CommitTransaction());
+  EXPECT_FALSE(db.in_transaction());
+  EXPECT_TRUE(db.Close());
+  ASSERT_TRUE(db.OpenReadOnly());
+  EXPECT_TRUE(db.Fetch("abc", &value));
+  EXPECT_EQ("1", value);
+  EXPECT_TRUE(db.Fetch("abd", &value));
+  EXPECT_EQ("2", value);
+  db.Close();
+  db.Remove();
+}
+
+#ifdef RIME_ENABLE_LMDB
+TEST(RimeUserDbTest, LmdbTransactions) {
+  using LmdbUserDb = UserDbWrapper<LmdbDb>;
+  LmdbUserDb db(path{"user_db_test.userdb.lmdb"}, "user_db_test");
+  if (db.Exists())
+    db.Remove();
+  ASSERT_TRUE(db.Open());
+  EXPECT_TRUE(db.Update("abc", "ZYX"));
+  EXPECT_TRUE(db.Update("wvu", "DEF"));
+  EXPECT_TRUE(db.BeginTransaction());
+  EXPECT_TRUE(db.Update("abd", "ZYW"));
+  EXPECT_TRUE(db.Erase("wvu"));
+  string value;
+  // reads see writes of the transaction
+  EXPECT_TRUE(db.Fetch("abd", &value));
+  EXPECT_EQ("ZYW", value);
+  EXPECT_FALSE(db.Fetch("wvu", &value));
+  // but not other threads
+  std::thread([&db] {
+    string value;
+    EXPECT_FALSE(db.Fetch("abd", &value));
+    EXPECT_TRUE(db.Fetch("wvu", &value));
+  }).join();
+  EXPECT_TRUE(db.AbortTransaction());
+  EXPECT_FALSE(db.Fetch("abd", &value));
+  EXPECT_TRUE(db.Fetch("wvu", &value));
+  EXPECT_TRUE(db.BeginTransaction());
+  EXPECT_TRUE(db.Update("abd", "ZYW"));
+  EXPECT_TRUE(db.Update("abc", "ZYV"));
+  EXPECT_TRUE(db.Erase("wvu"));
+  EXPECT_TRUE(db.CommitTransaction());
+  {
+    an<DbAccessor> accessor = db.QueryAll();
+    ASSERT_TRUE(bool(accessor));
+    string key;
+    EXPECT_TRUE(accessor->GetNextRecord(&key, &value));
+    EXPECT_EQ("abc", key);
+    EXPECT_EQ("ZYV", value);
+    EXPECT_TRUE(accessor->GetNextRecord(&key, &value));
+    EXPECT_EQ("abd", key);
+    EXPECT_TRUE(accessor->exhausted());
+    // a second accessor on the same thread
+    an<DbAccessor> metadata = db.QueryMetadata();
+    ASSERT_TRUE(bool(metadata));
+    EXPECT_FALSE(metadata->exhausted());
+  }
+  EXPECT_TRUE(db.Close());
+  ASSERT_TRUE(db.OpenReadOnly());
+  EXPECT_TRUE(db.Fetch("abd", &value));
+  EXPECT_EQ("ZYW", value);
+  EXPECT_FALSE(db.Fetch("wvu", &value));
+  EXPECT_FALSE(db.Update("abc", "ZYU"));
+  db.Close();
+  db.Remove();
+}
+#endif  // RIME_ENABLE_LMDB
+
+TEST(RimeUserDbTest, PackValues) {
+  UserDbValue v;
+  v.commits = -3;
+  v.dee = 12.5;
+  v.tick = 1234567890123ULL;
+  string text = v.Pack();
+  EXPECT_EQ("c=-3 d=12.5 t=1234567890123", text);
+  EXPECT_FALSE(UserDbValue::IsBinary(text));
+  string binary = v.PackBinary();
+  EXPECT_TRUE(UserDbValue::IsBinary(binary));
+  EXPECT_GT(text.length(), binary.length());
+  for (const auto& packed : {text, binary}) {
+    UserDbValue u;
+    ASSERT_TRUE(u.Unpack(packed));
+    EXPECT_EQ(-3, u.commits);
+    EXPECT_DOUBLE_EQ(12.5, u.dee);
+    EXPECT_EQ(1234567890123ULL, u.tick);
+  }
+  UserDbValue u;
+  EXPECT_FALSE(u.Unpack(binary.substr(0, 4)));
+  EXPECT_FALSE(u.Unpack("c= d=1"));
+  // unknown keys are skipped
+  EXPECT_TRUE(u.Unpack("c=2 x=0 t=3"));
+  EXPECT_EQ(2, u.commits);
+  EXPECT_EQ(3, u.tick);
+}
+
+static void WriteSnapshot(const path& file_path,
+                          const string& db_name,
+                          const string& user_id,
+                          int tick,
+                          const vector<string>& entries) {
+  std::ofstream out(file_path.c_str());
+  out << "# Rime user dictionary\n"
+      << "#@/db_name\t" << db_name << "\n"
+      << "#@/db_type\tuserdb\n"
+      << "#@/tick\t" << tick << "\n"
+      << "#@/user_id\t" << user_id << "\n";
+  for (const auto& entry : entries) {
+    out << entry << "\n";
+  }
+}
+
+TEST(RimeUserDbTest, SyncMergeSnapshots) {
+  TestDb db(path{"user_db_sync_test.txt"}, "user_db_sync_test");
+  if (db.Exists())
+    db.Remove();
+  ASSERT_TRUE(db.Open());
+  path snapshot_a{"user_db_sync_test.a.userdb.txt"};
+  path snapshot_b{"user_db_sync_test.b.userdb.txt"};
+  WriteSnapshot(snapshot_a, "user_db_sync_test", "device_a", 10,
+                {"ni hao\t你好\tc=3 d=1 t=10", "ni\t你\tc=1 d=1 t=10"});
+  WriteSnapshot(snapshot_b, "user_db_sync_test", "device_b", 20,
+                {"zai jian\t再见\tc=2 d=1 t=20",
+                 "ni hao\t你好\tc=5 d=1 t=20"});
+  {
+    UserDbSyncMerger merger(&db);
+    merger.AddSnapshot(snapshot_a);
+    merger.AddSnapshot(snapshot_b);
+    EXPECT_TRUE(merger.Merge());
+    EXPECT_EQ(3, merger.merged_entries());
+  }
+  string value;
+  ASSERT_TRUE(db.Fetch("ni hao \t你好", &value));
+  UserDbValue v(value);
+  EXPECT_EQ(5, v.commits);
+  EXPECT_EQ(20, v.tick);
+  ASSERT_TRUE(db.MetaFetch("/tick", &value));
+  EXPECT_EQ("20", value);
+  ASSERT_TRUE(db.MetaFetch("/sync_tick/device_a", &value));
+  EXPECT_EQ("10", value);
+  // entries not changed since the last sync are skipped
+  WriteSnapshot(snapshot_a, "user_db_sync_test", "device_a", 12,
+                {"ni hao\t你好\tc=3 d=1 t=10", "ni\t你\tc=4 d=1 t=12"});
+  {
+    UserDbSyncMerger merger(&db);
+    merger.AddSnapshot(snapshot_a);
+    merger.AddSnapshot(snapshot_b);
+    EXPECT_TRUE(merger.Merge());
+    EXPECT_EQ(1, merger.merged_entries());
+  }
+  ASSERT_TRUE(db.Fetch("ni \t你", &value));
+  EXPECT_EQ(4, UserDbValue(value).commits);
+  // snapshots of another db are rejected
+  WriteSnapshot(snapshot_b, "another_db", "device_b", 30,
+                {"zai jian\t再见\tc=9 d=1 t=30"});
+  {
+    UserDbSyncMerger merger(&db);
+    merger.AddSnapshot(snapshot_b);
+    EXPECT_FALSE(merger.Merge());
+    EXPECT_EQ(0, merger.merged_entries());
+  }
+  db.Close();
+  db.Remove();
+  std::filesystem::remove(snapshot_a);
+  std::filesystem::remove(snapshot_b);
+}
+
+TEST(RimeUserDbTest, IncrementalBackup) {
+  TestDb db(path{"user_db_delta_test.txt"}, "user_db_delta_test");
+  if (db.Exists())
+    db.Remove();
+  ASSERT_TRUE(db.Open());
+  auto update = [&db](const string& key, int commits, TickCount tick) {
+    UserDbValue v;
+    v.commits = commits;
+    v.dee = 1.0;
+    v.tick = tick;
+    return db.Update(key, v.Pack()) &&
+           db.MetaUpdate("/tick", std::to_string(tick));
+  };
+  for (int i = 0; i < 8; ++i) {
+    ASSERT_TRUE(update("code" + std::to_string(i) + " \tphrase", 1, i + 1));
+  }
+  path snapshot{"user_db_delta_test.userdb.txt"};
+  path delta{"user_db_delta_test.userdb.delta.txt"};
+  std::filesystem::remove(snapshot);
+  std::filesystem::remove(delta);
+  // the first backup is a full snapshot
+  EXPECT_TRUE(UserDbHelper(&db).IncrementalBackup(snapshot, delta));
+  EXPECT_TRUE(std::filesystem::exists(snapshot));
+  EXPECT_FALSE(std::filesystem::exists(delta));
+  auto full_size = std::filesystem::file_size(snapshot);
+  // then only the changes are written
+  ASSERT_TRUE(update("code3 \tphrase", 5, 10));
+  EXPECT_TRUE(UserDbHelper(&db).IncrementalBackup(snapshot, delta));
+  EXPECT_EQ(full_size, std::filesystem::file_size(snapshot));
+  ASSERT_TRUE(std::filesystem::exists(delta));
+  {
+    TestDb copy(path{"user_db_delta_copy.txt"}, "user_db_delta_test");
+    if (copy.Exists())
+      copy.Remove();
+    ASSERT_TRUE(copy.Open());
+    UserDbSyncMerger merger(&copy);
+    merger.AddSnapshot(snapshot, delta);
+    EXPECT_TRUE(merger.Merge());
+    EXPECT_EQ(8, merger.merged_entries());
+    string value;
+    ASSERT_TRUE(copy.Fetch("code3 \tphrase", &value));
+    EXPECT_EQ(5, UserDbValue(value).commits);
+    ASSERT_TRUE(copy.MetaFetch("/tick", &value));
+    EXPECT_EQ("10", value);
+    copy.Close();
+    copy.Remove();
+  }
+  // compacted into a full snapshot once the delta grows large
+  ASSERT_TRUE(update("code4 \tphrase", 2, 11));
+  ASSERT_TRUE(update("code5 \tphrase", 2, 12));
+  EXPECT_TRUE(UserDbHelper(&db).IncrementalBackup(snapshot, delta));
+  EXPECT_FALSE(std::filesystem::exists(delta));
+  db.Close();
+  db.Remove();
+  std::filesystem::remove(snapshot);
+}
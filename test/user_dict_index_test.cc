@@ -0,0 +1,61 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <gtest/gtest.h>
+#include <rime/dict/text_db.h>
+#include <rime/dict/user_db.h>
+#include <rime/dict/user_dict_index.h>
+
+using namespace rime;
+
+using TestDb = UserDbWrapper<TextDb>;
+
+TEST(RimeUserDictIndexTest, LoadAndUpdate) {
+  TestDb db(path{"user_dict_index_test.txt"}, "user_dict_index_test");
+  if (db.Exists())
+    db.Remove();
+  ASSERT_TRUE(db.Open());
+  EXPECT_TRUE(db.Update("hao \t好", "c=1 d=1 t=1"));
+  EXPECT_TRUE(db.Update("ni hao \t你好", "c=2 d=2 t=2"));
+  EXPECT_TRUE(db.Update("ni hao ma \t你好嗎", "c=1 d=1 t=3"));
+  // not in the syllabary
+  EXPECT_TRUE(db.Update("ni xyz \t你x", "c=1 d=1 t=4"));
+
+  Syllabary syllabary{"hao", "ma", "ni"};
+  const SyllableId hao = 0, ma = 1, ni = 2;
+  UserDictIndex index(syllabary);
+  EXPECT_FALSE(index.loaded());
+  ASSERT_TRUE(index.Load(&db));
+  EXPECT_TRUE(index.loaded());
+  EXPECT_EQ(3, index.size());
+
+  auto node = index.Find(index.root(), ni);
+  ASSERT_TRUE(node != nullptr);
+  EXPECT_TRUE(node->records.empty());
+  EXPECT_TRUE(index.Find(node, ni) == nullptr);
+  node = index.Find(node, hao);
+  ASSERT_TRUE(node != nullptr);
+  ASSERT_EQ(1, node->records.size());
+  EXPECT_EQ("ni hao \t你好", node->records[0].key);
+  vector<const UserDictIndex::Record*> descendants;
+  index.CollectDescendants(node, &descendants);
+  ASSERT_EQ(1, descendants.size());
+  EXPECT_EQ("ni hao ma \t你好嗎", descendants[0]->key);
+
+  index.Update("ni hao \t妳好", "c=1 d=1 t=5");
+  index.Update("ni hao \t你好", "c=3 d=3 t=5");
+  EXPECT_EQ(4, index.size());
+  node = index.Find(index.Find(index.root(), ni), hao);
+  ASSERT_EQ(2, node->records.size());
+  EXPECT_EQ("c=3 d=3 t=5", node->records[0].value);
+  EXPECT_EQ("ni hao \t妳好", node->records[1].key);
+  index.Update("ma \t嗎", "c=1 d=1 t=6");
+  ASSERT_TRUE(index.Find(index.root(), ma) != nullptr);
+
+  index.Invalidate();
+  EXPECT_FALSE(index.loaded());
+  EXPECT_TRUE(index.Find(index.root(), ni) == nullptr);
+  EXPECT_TRUE(db.Close());
+  db.Remove();
+}
@@ -0,0 +1,130 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <filesystem>
+#include <gtest/gtest.h>
+#include <rime/deployer.h>
+#include <rime/service.h>
+#include <rime/dict/user_db.h>
+#include <rime/lever/user_dict_manager.h>
+
+using namespace rime;
+namespace fs = std::filesystem;
+
+static string make_key(int i) {
+  return "key" + std::to_string(i);
+}
+
+TEST(RimeUserDictManagerTest, PruneStaleEntries) {
+  const string kDictName = "user_dict_manager_test";
+  const TickCount kTick = 10000;
+  const double kThreshold = 1e-8;
+  auto* component = UserDb::Require("userdb");
+  ASSERT_TRUE(component != nullptr);
+  {
+    the<Db> db(component->Create(kDictName));
+    if (db->Exists())
+      db->Remove();
+    ASSERT_TRUE(db->Open());
+    ASSERT_TRUE(db->MetaUpdate("/tick", std::to_string(kTick)));
+    // entries of even numbers were last used long ago
+    for (int i = 0; i < 10; ++i) {
+      UserDbValue v;
+      v.commits = 1;
+      v.dee = 1.0;
+      v.tick = i % 2 == 0 ? 0 : kTick;
+      ASSERT_TRUE(db->Update(make_key(i), v.PackFor(db.get())));
+    }
+    db->Close();
+  }
+  UserDictManager manager(&Service::instance().deployer());
+  // key0 .. key5 are scanned
+  EXPECT_EQ(3, manager.Prune(kDictName, kThreshold, 6));
+  {
+    the<Db> db(component->Create(kDictName));
+    ASSERT_TRUE(db->OpenReadOnly());
+    string cursor;
+    EXPECT_TRUE(db->MetaFetch("/prune_cursor", &cursor));
+    EXPECT_EQ(make_key(5), cursor);
+    db->Close();
+  }
+  // resumes after key5, scanning to the end
+  EXPECT_EQ(2, manager.Prune(kDictName, kThreshold, 6));
+  // then starts over from the first key, with nothing left to prune
+  EXPECT_EQ(0, manager.Prune(kDictName, kThreshold, 100));
+  the<Db> db(component->Create(kDictName));
+  ASSERT_TRUE(db->OpenReadOnly());
+  string cursor;
+  db->MetaFetch("/prune_cursor", &cursor);
+  EXPECT_TRUE(cursor.empty());
+  for (int i = 0; i < 10; ++i) {
+    string value;
+    EXPECT_EQ(i % 2 != 0, db->Fetch(make_key(i), &value)) << make_key(i);
+  }
+  db->Close();
+}
+
+static bool update_entry(Db* db, const string& code, const string& word) {
+  UserDbValue v;
+  v.commits = 1;
+  v.dee = 1.0;
+  v.tick = 1;
+  return db->Update(code + " \t" + word, v.PackFor(db));
+}
+
+TEST(RimeUserDictManagerTest, SynchronizeInParallel) {
+  const vector<string> kDictNames = {"user_dict_sync_test_a",
+                                     "user_dict_sync_test_b",
+                                     "user_dict_sync_test_c"};
+  auto* component = UserDb::Require("userdb");
+  ASSERT_TRUE(component != nullptr);
+  Deployer& deployer(Service::instance().deployer());
+  const path saved_sync_dir = deployer.sync_dir;
+  const string saved_user_id = deployer.user_id;
+  deployer.sync_dir = path("user_dict_manager_test.sync");
+  std::error_code ec;
+  fs::remove_all(deployer.sync_dir, ec);
+  UserDictManager manager(&deployer);
+  // a peer leaves a snapshot of each user dict in the sync dir
+  deployer.user_id = "peer";
+  for (const string& name : kDictNames) {
+    the<Db> db(component->Create(name));
+    if (db->Exists())
+      db->Remove();
+    ASSERT_TRUE(db->Open());
+    ASSERT_TRUE(update_entry(db.get(), "peer", name));
+    db->Close();
+    ASSERT_TRUE(manager.Backup(name));
+    db->Remove();
+  }
+  deployer.user_id = "local";
+  for (const string& name : kDictNames) {
+    the<Db> db(component->Create(name));
+    ASSERT_TRUE(db->Open());
+    ASSERT_TRUE(update_entry(db.get(), "local", name));
+    db->Close();
+  }
+  EXPECT_EQ(0, manager.ForEachUserDict(
+                   kDictNames, "user_dict_sync",
+                   [&manager](const string& name) {
+                     return manager.Synchronize(name);
+                   }));
+  // each user dict has merged its own snapshot and none of the others
+  for (const string& name : kDictNames) {
+    the<Db> db(component->Create(name));
+    ASSERT_TRUE(db->OpenReadOnly());
+    for (const string& other : kDictNames) {
+      string value;
+      EXPECT_EQ(other == name, db->Fetch("peer \t" + other, &value)) << name;
+      EXPECT_EQ(other == name, db->Fetch("local \t" + other, &value)) << name;
+    }
+    db->Close();
+    db->Remove();
+    EXPECT_TRUE(fs::exists(deployer.user_data_sync_dir() /
+                           (name + UserDb::snapshot_extension())));
+  }
+  fs::remove_all(deployer.sync_dir, ec);
+  deployer.sync_dir = saved_sync_dir;
+  deployer.user_id = saved_user_id;
+}
@@ -0,0 +1,291 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <filesystem>
+#include <gtest/gtest.h>
+#include <rime/deployer.h>
+#include <rime/perf_counters.h>
+#include <rime/service.h>
+#include <rime/algo/syllabifier.h>
+#include <rime/dict/prism.h>
+#include <rime/dict/table.h>
+#include <rime/dict/text_db.h>
+#include <rime/dict/user_db.h>
+#include <rime/dict/user_dictionary.h>
+
+using namespace rime;
+
+using TestDb = UserDbWrapper<TextDb>;
+
+static DictEntry make_entry(const string& code, const string& text) {
+  DictEntry entry;
+  entry.custom_code = code + ' ';
+  entry.text = text;
+  return entry;
+}
+
+static vector<string> lookup_words(UserDictionary& dict, const string& code) {
+  UserDictEntryIterator iter;
+  dict.LookupWords(&iter, code, false);
+  vector<string> texts;
+  for (; !iter.exhausted(); iter.Next()) {
+    texts.push_back(iter.Peek()->text);
+  }
+  return texts;
+}
+
+TEST(RimeUserDictionaryTest, CachedWordLookup) {
+  auto db = New<TestDb>(path{"user_dictionary_test.txt"},
+                        "user_dictionary_test");
+  if (db->Exists())
+    db->Remove();
+  ASSERT_TRUE(db->Open());
+  UserDictionary dict("user_dictionary_test", db);
+  ASSERT_TRUE(dict.Load());
+  EXPECT_TRUE(lookup_words(dict, "abc").empty());
+  EXPECT_TRUE(dict.UpdateEntry(make_entry("abc", "X"), 1));
+  EXPECT_TRUE(dict.UpdateEntry(make_entry("abcd", "Z"), 1));
+  // the cached result of the previous lookup has been invalidated
+  EXPECT_EQ(vector<string>{"X"}, lookup_words(dict, "abc"));
+  EXPECT_TRUE(dict.UpdateEntry(make_entry("abc", "Y"), 2));
+  auto texts = lookup_words(dict, "abc");
+  ASSERT_EQ(2, texts.size());
+  EXPECT_EQ("Y", texts[0]);
+  // served by the cache this time
+  EXPECT_EQ(texts, lookup_words(dict, "abc"));
+  // deleted entries are left out
+  EXPECT_TRUE(dict.UpdateEntry(make_entry("abc", "X"), -1));
+  EXPECT_EQ(vector<string>{"Y"}, lookup_words(dict, "abc"));
+  EXPECT_EQ(vector<string>{"Z"}, lookup_words(dict, "abcd"));
+}
+
+TEST(RimeUserDictionaryTest, ServedBySnapshotWhileRecovering) {
+  Deployer& deployer(Service::instance().deployer());
+  std::error_code ec;
+  std::filesystem::create_directories(deployer.user_data_sync_dir(), ec);
+  const string kDbName = "user_dictionary_standby_test";
+  {
+    path snapshot_path = deployer.user_data_sync_dir() /
+                         (kDbName + UserDb::snapshot_extension());
+    TestDb snapshot(snapshot_path, kDbName);
+    if (snapshot.Exists())
+      snapshot.Remove();
+    ASSERT_TRUE(snapshot.Open());
+    ASSERT_TRUE(snapshot.MetaUpdate("/tick", "1"));
+    ASSERT_TRUE(snapshot.Update("abc \tX", "c=1 d=1 t=1"));
+    ASSERT_TRUE(snapshot.Close());
+  }
+  // the damaged db is disabled while it is being recovered.
+  auto db = New<TestDb>(path{kDbName + ".txt"}, kDbName);
+  if (db->Exists())
+    db->Remove();
+  db->disable();
+  UserDictionary dict(kDbName, db);
+  ASSERT_TRUE(dict.Load());
+  EXPECT_TRUE(dict.loaded());
+  EXPECT_TRUE(dict.readonly());
+  EXPECT_EQ(vector<string>{"X"}, lookup_words(dict, "abc"));
+  EXPECT_FALSE(dict.UpdateEntry(make_entry("abc", "Y"), 1));
+  // the recovered db takes over.
+  ASSERT_TRUE(db->Open());
+  db->enable();
+  EXPECT_FALSE(dict.readonly());
+  EXPECT_TRUE(lookup_words(dict, "abc").empty());
+  EXPECT_TRUE(dict.UpdateEntry(make_entry("abc", "Y"), 1));
+  EXPECT_EQ(vector<string>{"Y"}, lookup_words(dict, "abc"));
+}
+
+TEST(RimeUserDictionaryTest, RevertRecentTransaction) {
+  auto db = New<TestDb>(path{"user_dictionary_test.txt"},
+                        "user_dictionary_test");
+  if (db->Exists())
+    db->Remove();
+  ASSERT_TRUE(db->Open());
+  UserDictionary dict("user_dictionary_test", db);
+  ASSERT_TRUE(dict.Load());
+  EXPECT_TRUE(dict.UpdateEntry(make_entry("abc", "X"), 1));
+  EXPECT_TRUE(dict.NewTransaction());
+  uint64_t revision = dict.revision();
+  EXPECT_TRUE(dict.UpdateEntry(make_entry("abc", "X"), 1));
+  EXPECT_TRUE(dict.UpdateEntry(make_entry("abc", "Y"), 1));
+  EXPECT_EQ(revision + 2, dict.revision());
+  // queued updates are seen by the next lookup
+  EXPECT_EQ(2, lookup_words(dict, "abc").size());
+  EXPECT_TRUE(dict.RevertRecentTransaction());
+  EXPECT_EQ(revision + 3, dict.revision());
+  EXPECT_EQ(vector<string>{"X"}, lookup_words(dict, "abc"));
+  string value;
+  ASSERT_TRUE(db->Fetch("abc \tX", &value));
+  UserDbValue v(value);
+  EXPECT_EQ(1, v.commits);
+  EXPECT_EQ(1, dict.tick());
+  // nothing to revert once committed
+  EXPECT_TRUE(dict.NewTransaction());
+  EXPECT_TRUE(dict.UpdateEntry(make_entry("abc", "Y"), 1));
+  EXPECT_TRUE(dict.CommitPendingTransaction());
+  EXPECT_FALSE(dict.RevertRecentTransaction());
+  EXPECT_EQ(2, lookup_words(dict, "abc").size());
+}
+
+TEST(RimeUserDictionaryTest, NoSharedDataOfClosedDb) {
+  for (int round = 0; round < 2; ++round) {
+    auto db = New<TestDb>(path{"user_dictionary_test.txt"},
+                          "user_dictionary_test");
+    if (db->Exists())
+      db->Remove();
+    ASSERT_TRUE(db->Open());
+    UserDictionary dict("user_dictionary_test", db);
+    ASSERT_TRUE(dict.Load());
+    // nothing is left in the cache by the dictionary of the previous round
+    EXPECT_TRUE(lookup_words(dict, "abc").empty());
+    EXPECT_TRUE(dict.UpdateEntry(make_entry("abc", "X"), 1));
+    EXPECT_EQ(vector<string>{"X"}, lookup_words(dict, "abc"));
+  }
+}
+
+TEST(RimeUserDictionaryTest, SharedDataOfDbName) {
+  auto db = New<TestDb>(path{"user_dictionary_test.txt"},
+                        "user_dictionary_test");
+  if (db->Exists())
+    db->Remove();
+  ASSERT_TRUE(db->Open());
+  UserDictionary dict("user_dictionary_test", db);
+  ASSERT_TRUE(dict.Load());
+  EXPECT_TRUE(dict.UpdateEntry(make_entry("abc", "X"), 1));
+  EXPECT_EQ(vector<string>{"X"}, lookup_words(dict, "abc"));
+  {
+    // another instance of the db, opened while the first is in use
+    auto other_db = New<TestDb>(path{"user_dictionary_test.txt"},
+                                "user_dictionary_test");
+    ASSERT_TRUE(other_db->Open());
+    UserDictionary other("user_dictionary_test", other_db);
+    ASSERT_TRUE(other.Load());
+    // served by the cache of the first, which it does not evict
+    EXPECT_EQ(vector<string>{"X"}, lookup_words(other, "abc"));
+  }
+  EXPECT_EQ(vector<string>{"X"}, lookup_words(dict, "abc"));
+}
+
+TEST(RimeUserDictionaryTest, ReportFailedWritesOnSync) {
+  auto db = New<TestDb>(path{"user_dictionary_test.txt"},
+                        "user_dictionary_test");
+  if (db->Exists())
+    db->Remove();
+  ASSERT_TRUE(db->Open());
+  UserDictionary dict("user_dictionary_test", db);
+  ASSERT_TRUE(dict.Load());
+  // without a syllabary to spell it, the code cannot be written
+  DictEntry entry;
+  entry.text = "X";
+  entry.code.push_back(1);
+  EXPECT_TRUE(dict.UpdateEntry(entry, 1));
+  EXPECT_FALSE(dict.Sync());
+  // reported once
+  EXPECT_TRUE(dict.Sync());
+  EXPECT_TRUE(dict.UpdateEntry(make_entry("abc", "X"), 1));
+  EXPECT_TRUE(dict.Sync());
+}
+
+// spellings of syllables a, b, c at each of the positions, b and c being
+// less credible.
+static void make_syllable_graph(size_t length, SyllableGraph* graph) {
+  const double kCredibility[] = {0.0, -1.0, -2.0};
+  for (size_t pos = 0; pos < length; ++pos) {
+    for (SyllableId syllable_id = 0; syllable_id < 3; ++syllable_id) {
+      auto& props = graph->edges[pos][pos + 1][syllable_id];
+      props.end_pos = pos + 1;
+      props.credibility = kCredibility[syllable_id];
+    }
+  }
+  for (auto& start : graph->edges) {
+    for (auto& end : start.second) {
+      for (auto& spelling : end.second) {
+        graph->indices[start.first][spelling.first].push_back(
+            &spelling.second);
+      }
+    }
+  }
+  graph->input_length = graph->interpreted_length = length;
+}
+
+static size_t count_phrases(const an<UserDictEntryCollector>& result) {
+  size_t count = 0;
+  for (auto& x : *result) {
+    for (auto& iter = x.second; !iter.exhausted(); iter.Next()) {
+      ++count;
+    }
+  }
+  return count;
+}
+
+TEST(RimeUserDictionaryTest, PrunedPhraseLookup) {
+  auto table = New<Table>(path{"user_dictionary_test.table.bin"});
+  table->Remove();
+  Syllabary syllabary{"a", "b", "c"};
+  Vocabulary vocabulary;
+  auto entry = New<ShortDictEntry>();
+  entry->text = "A";
+  entry->code.push_back(0);
+  vocabulary[0].entries.push_back(entry);
+  ASSERT_TRUE(table->Build(syllabary, vocabulary, 1));
+  ASSERT_TRUE(table->Save());
+  ASSERT_TRUE(table->Load());
+  auto db = New<TestDb>(path{"user_dictionary_test.txt"},
+                        "user_dictionary_test");
+  if (db->Exists())
+    db->Remove();
+  ASSERT_TRUE(db->Open());
+  UserDictionary dict("user_dictionary_test", db);
+  dict.Attach(table, New<Prism>(path{"user_dictionary_test.prism.bin"}));
+  ASSERT_TRUE(dict.Load());
+  EXPECT_TRUE(dict.UpdateEntry(make_entry("a", "A"), 1));
+  EXPECT_TRUE(dict.UpdateEntry(make_entry("a a a", "AAA"), 1));
+  EXPECT_TRUE(dict.UpdateEntry(make_entry("c c c", "CCC"), 1));
+  SyllableGraph graph;
+  make_syllable_graph(3, &graph);
+  auto& counters = PerfCounters::Global();
+  uint64_t pruned = counters.get(PerfCounters::kUserDictLookupsPruned);
+  auto result = dict.Lookup(graph, 0);
+  ASSERT_TRUE(bool(result));
+  EXPECT_EQ(3, count_phrases(result));
+  EXPECT_EQ(pruned, counters.get(PerfCounters::kUserDictLookupsPruned));
+  // the most credible branches are followed first; the budget runs out
+  // before the path of 'c c c' is followed to the end.
+  dict.set_lookup_budget(4);
+  result = dict.Lookup(graph, 0);
+  ASSERT_TRUE(bool(result));
+  ASSERT_EQ(1, result->count(3));
+  EXPECT_EQ("AAA", (*result)[3].Peek()->text);
+  EXPECT_EQ(2, count_phrases(result));
+  EXPECT_EQ(pruned + 1, counters.get(PerfCounters::kUserDictLookupsPruned));
+  table->Close();
+  table->Remove();
+}
+
+TEST(RimeUserDictionaryTest, LazilyOrderedEntries) {
+  const int kNumEntries = 100;
+  UserDictEntryIterator iter;
+  auto first = New<DictEntry>();
+  first->text = "first";
+  first->weight = -1.0;
+  iter.Add(std::move(first));
+  for (int i = 0; i < kNumEntries; ++i) {
+    auto entry = New<DictEntry>();
+    entry->text = std::to_string(i);
+    entry->weight = (i * 37) % kNumEntries;
+    iter.Add(std::move(entry));
+  }
+  // the first entry is left out of the range to sort.
+  iter.SortRange(1, kNumEntries);
+  ASSERT_FALSE(iter.exhausted());
+  EXPECT_EQ("first", iter.Peek()->text);
+  double weight = kNumEntries;
+  int count = 0;
+  while (iter.Next()) {
+    EXPECT_GT(weight, iter.Peek()->weight);
+    weight = iter.Peek()->weight;
+    ++count;
+  }
+  EXPECT_EQ(kNumEntries, count);
+}
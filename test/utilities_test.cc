@@ -0,0 +1,47 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <fstream>
+#include <gtest/gtest.h>
+#include <rime/common.h>
+#include <rime/algo/utilities.h>
+
+using namespace rime;
+
+static void WriteFile(const path& file_path, const string& content) {
+  std::ofstream out(file_path.c_str(), std::ios::binary);
+  out << content;
+}
+
+TEST(RimeChecksumComputerTest, ChecksumOfFilesInSequence) {
+  const path a("checksum_test_a.txt");
+  const path b("checksum_test_b.txt");
+  const string text_a = "ni\tni\t100\n";
+  const string text_b = "hao\thao\t200\n";
+  WriteFile(a, text_a);
+  WriteFile(b, text_b);
+  const uint32_t kInitialRemainder = 12345;
+  boost::crc_32_type crc(kInitialRemainder);
+  crc.process_bytes(text_a.data(), text_a.length());
+  crc.process_bytes(text_b.data(), text_b.length());
+  crc.process_bytes(text_a.data(), text_a.length());
+  ChecksumComputer in_parallel(kInitialRemainder);
+  in_parallel.ProcessFiles({a, b, a});
+  EXPECT_EQ(crc.checksum(), in_parallel.Checksum());
+  ChecksumComputer one_by_one(kInitialRemainder);
+  one_by_one.ProcessFile(a);
+  one_by_one.ProcessFile(b);
+  one_by_one.ProcessFile(a);
+  EXPECT_EQ(crc.checksum(), one_by_one.Checksum());
+}
+
+TEST(RimeChecksumComputerTest, ChangedFileIsReadAgain) {
+  const path file_path("checksum_test_changed.txt");
+  WriteFile(file_path, "abc");
+  uint32_t before = Checksum(file_path);
+  WriteFile(file_path, "abcdef");
+  EXPECT_NE(before, Checksum(file_path));
+  WriteFile(file_path, "abc");
+  EXPECT_EQ(before, Checksum(file_path));
+}
@@ -4,6 +4,8 @@
 //
 // 2012-03-24 GONG Chen <chen.sst@gmail.com>
 //
+#include <chrono>
+#include <cstdlib>
 #include <iostream>
 #include <rime/config.h>
 #include <rime/deployer.h>
@@ -16,6 +18,34 @@
 
 using namespace rime;
 
+using Clock = std::chrono::steady_clock;
+
+static double seconds_since(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// prints the number of entries done so far and the rate, on the same line.
+static TsvProgress report_progress(const char* verb, Clock::time_point start) {
+  return [verb, start](int num_entries) {
+    double seconds = seconds_since(start);
+    std::cerr << "\r" << verb << " " << num_entries << " entries ("
+              << int(num_entries / (seconds > 0 ? seconds : 1))
+              << " entries/s)..." << std::flush;
+  };
+}
+
+static void report_throughput(const char* verb,
+                              int num_entries,
+                              Clock::time_point start) {
+  double seconds = seconds_since(start);
+  std::cerr << "\r";
+  std::cout << verb << " " << num_entries << " entries in " << seconds
+            << " s";
+  if (seconds > 0)
+    std::cout << " (" << int(num_entries / seconds) << " entries/s)";
+  std::cout << "." << std::endl;
+}
+
 int main(int argc, char* argv[]) {
   unsigned int codepage = SetConsoleOutputCodePage();
   SetupLogging("rime.tools");
@@ -35,7 +65,8 @@ int main(int argc, char* argv[]) {
               << "\t-b|--backup dict_name" << std::endl
               << "\t-r|--restore xxx.userdb.txt" << std::endl
               << "\t-e|--export dict_name export.txt" << std::endl
-              << "\t-i|--import dict_name import.txt" << std::endl;
+              << "\t-i|--import dict_name import.txt [batch_size]"
+              << std::endl;
     SetConsoleOutputCodePage(codepage);
     return 0;
   }
@@ -92,19 +123,32 @@ int main(int argc, char* argv[]) {
       return 1;
   }
   if (argc == 4 && (option == "-e" || option == "--export")) {
+    auto start = Clock::now();
+    mgr.set_progress(report_progress("exported", start));
     int n = mgr.Export(arg1, path(arg2));
     SetConsoleOutputCodePage(codepage);
     if (n == -1)
       return 1;
-    std::cout << "exported " << n << " entries." << std::endl;
+    report_throughput("exported", n, start);
     return 0;
   }
-  if (argc == 4 && (option == "-i" || option == "--import")) {
+  if ((argc == 4 || argc == 5) && (option == "-i" || option == "--import")) {
+    if (argc == 5) {
+      int batch_size = std::atoi(argv[4]);
+      if (batch_size <= 0) {
+        SetConsoleOutputCodePage(codepage);
+        std::cerr << "invalid batch size: " << argv[4] << std::endl;
+        return 1;
+      }
+      mgr.set_import_batch_size(batch_size);
+    }
+    auto start = Clock::now();
+    mgr.set_progress(report_progress("imported", start));
     int n = mgr.Import(arg1, path(arg2));
     SetConsoleOutputCodePage(codepage);
     if (n == -1)
       return 1;
-    std::cout << "imported " << n << " entries." << std::endl;
+    report_throughput("imported", n, start);
     return 0;
   }
   SetConsoleOutputCodePage(codepage);
@@ -0,0 +1,134 @@
+/*
+ * Copyright RIME Developers
+ * Distributed under the BSD License
+ *
+ * Replays a key log recorded by start_key_recording() through a session,
+ * reporting the time taken to process each key.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <rime_api.h>
+#include <rime/key_recorder.h>
+#include "codepage.h"
+
+using namespace rime;
+
+static void print_usage() {
+  fprintf(stderr,
+          "usage: rime_replay [--max-speed] [--quiet] <key log>\n"
+          "\t--max-speed\tsends the keys without waiting as recorded.\n"
+          "\t--quiet\t\tprints the summary only.\n");
+}
+
+static double percentile(const vector<double>& sorted, double p) {
+  if (sorted.empty())
+    return 0.0;
+  size_t index = size_t(p * (sorted.size() - 1) + 0.5);
+  return sorted[index];
+}
+
+int main(int argc, char* argv[]) {
+  bool max_speed = false;
+  bool quiet = false;
+  const char* log_file = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--max-speed"))
+      max_speed = true;
+    else if (!strcmp(argv[i], "--quiet"))
+      quiet = true;
+    else
+      log_file = argv[i];
+  }
+  if (!log_file) {
+    print_usage();
+    return 1;
+  }
+  KeyLogReader reader{path(log_file)};
+  if (!reader.good()) {
+    fprintf(stderr, "not a key log: %s\n", log_file);
+    return 1;
+  }
+
+  unsigned int codepage = SetConsoleOutputCodePage();
+  RimeApi* rime = rime_get_api();
+  RIME_STRUCT(RimeTraits, traits);
+  traits.app_name = "rime.replay";
+  rime->setup(&traits);
+  fprintf(stderr, "initializing...\n");
+  rime->initialize(NULL);
+  if (rime->start_maintenance(False))
+    rime->join_maintenance_thread();
+  RimeSessionId session_id = rime->create_session();
+  if (!session_id) {
+    fprintf(stderr, "Error creating rime session.\n");
+    rime->finalize();
+    SetConsoleOutputCodePage(codepage);
+    return 1;
+  }
+
+  using Clock = std::chrono::steady_clock;
+  vector<double> latencies;
+  KeyLogRecord record;
+  while (reader.Next(&record)) {
+    if (record.type == KeyLogRecord::kSchema) {
+      char current[100] = {0};
+      // a schema switched by the keys is not to be applied again.
+      if (!rime->get_current_schema(session_id, current, sizeof(current)) ||
+          record.name != current) {
+        rime->select_schema(session_id, record.name.c_str());
+      }
+      continue;
+    }
+    if (record.type == KeyLogRecord::kOption) {
+      if (bool(rime->get_option(session_id, record.name.c_str())) !=
+          record.value) {
+        rime->set_option(session_id, record.name.c_str(),
+                         record.value ? True : False);
+      }
+      continue;
+    }
+    if (!max_speed && record.delay > 0)
+      std::this_thread::sleep_for(std::chrono::milliseconds(record.delay));
+    auto begin = Clock::now();
+    rime->process_key(session_id, record.keycode, record.mask);
+    // the first page of candidates is made as the frontend asks for it.
+    RIME_STRUCT(RimeContext, context);
+    if (rime->get_context(session_id, &context))
+      rime->free_context(&context);
+    RIME_STRUCT(RimeCommit, commit);
+    if (rime->get_commit(session_id, &commit))
+      rime->free_commit(&commit);
+    double ms =
+        std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+    latencies.push_back(ms);
+    if (!quiet) {
+      printf("%zu\t0x%x\t0x%x\t%.3f ms\n", latencies.size(), record.keycode,
+             record.mask, ms);
+    }
+  }
+  if (!reader.good())
+    fprintf(stderr, "the key log ends with a corrupt record.\n");
+
+  rime->destroy_session(session_id);
+  rime->finalize();
+  SetConsoleOutputCodePage(codepage);
+
+  std::sort(latencies.begin(), latencies.end());
+  double total = 0.0;
+  for (double ms : latencies) {
+    total += ms;
+  }
+  printf("keys: %zu\n", latencies.size());
+  if (!latencies.empty()) {
+    printf("mean: %.3f ms, p50: %.3f ms, p90: %.3f ms, p99: %.3f ms, "
+           "max: %.3f ms\n",
+           total / latencies.size(), percentile(latencies, 0.5),
+           percentile(latencies, 0.9), percentile(latencies, 0.99),
+           latencies.back());
+  }
+  return 0;
+}
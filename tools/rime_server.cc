@@ -0,0 +1,344 @@
+/*
+ * Copyright RIME Developers
+ * Distributed under the BSD License
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <sstream>
+#include "rime_server.h"
+
+using std::string;
+
+string escape_line(const string& text) {
+  string result;
+  result.reserve(text.size());
+  for (char c : text) {
+    switch (c) {
+      case '\\':
+        result += "\\\\";
+        break;
+      case '\n':
+        result += "\\n";
+        break;
+      case '\r':
+        result += "\\r";
+        break;
+      default:
+        result += c;
+    }
+  }
+  return result;
+}
+
+static string escape_line(const char* text) {
+  return text ? escape_line(string(text)) : string();
+}
+
+static bool set_non_blocking(int fd) {
+  int flags = fcntl(fd, F_GETFL, 0);
+  return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+// the composition is written with the cursor marked by '|' and the selected
+// range in brackets, as the console does.
+static string format_preedit(const RimeComposition& composition) {
+  string result;
+  const char* preedit = composition.preedit;
+  if (!preedit)
+    return result;
+  size_t len = strlen(preedit);
+  size_t start = composition.sel_start;
+  size_t end = composition.sel_end;
+  size_t cursor = composition.cursor_pos;
+  for (size_t i = 0; i <= len; ++i) {
+    if (start < end) {
+      if (i == start)
+        result += '[';
+      else if (i == end)
+        result += ']';
+    }
+    if (i == cursor)
+      result += '|';
+    if (i < len)
+      result += preedit[i];
+  }
+  return result;
+}
+
+static void write_state(RimeSessionId session_id, string* out) {
+  RimeApi* rime = rime_get_api();
+  RIME_STRUCT(RimeCommit, commit);
+  RIME_STRUCT(RimeStatus, status);
+  RIME_STRUCT(RimeContext, context);
+  if (rime->get_commit(session_id, &commit)) {
+    *out += "commit " + escape_line(commit.text) + "\n";
+    rime->free_commit(&commit);
+  }
+  if (rime->get_status(session_id, &status)) {
+    *out += "schema " + escape_line(status.schema_id) + "\n";
+    *out += string("status") + (status.is_disabled ? " disabled" : "") +
+            (status.is_composing ? " composing" : "") +
+            (status.is_ascii_mode ? " ascii" : "") +
+            (status.is_full_shape ? " full_shape" : "") +
+            (status.is_simplified ? " simplified" : "") + "\n";
+    rime->free_status(&status);
+  }
+  if (rime->get_context(session_id, &context)) {
+    if (context.composition.length > 0) {
+      *out += "preedit " + escape_line(format_preedit(context.composition)) +
+              "\n";
+    }
+    const RimeMenu& menu = context.menu;
+    if (menu.num_candidates > 0) {
+      *out += "page " + std::to_string(menu.page_no + 1) +
+              (menu.is_last_page ? " last" : "") + "\n";
+    }
+    for (int i = 0; i < menu.num_candidates; ++i) {
+      *out += "candidate " + std::to_string(i + 1) +
+              (i == menu.highlighted_candidate_index ? " * " : " ") +
+              escape_line(menu.candidates[i].text);
+      if (menu.candidates[i].comment)
+        *out += " " + escape_line(menu.candidates[i].comment);
+      *out += "\n";
+    }
+    rime->free_context(&context);
+  }
+}
+
+RimeServer::RimeServer(int server_fd, size_t max_pending_bytes)
+    : server_fd_(server_fd), max_pending_bytes_(max_pending_bytes) {
+  if (pipe(wake_fds_) < 0 || !set_non_blocking(wake_fds_[0]) ||
+      !set_non_blocking(wake_fds_[1])) {
+    for (int& fd : wake_fds_) {
+      if (fd >= 0)
+        close(fd);
+      fd = -1;
+    }
+  }
+}
+
+RimeServer::~RimeServer() {
+  while (!clients_.empty()) {
+    CloseClient(clients_.begin()->first);
+  }
+  for (int fd : wake_fds_) {
+    if (fd >= 0)
+      close(fd);
+  }
+}
+
+void RimeServer::AddClient(int fd) {
+  // a client slow to read its replies must not hold up the others.
+  if (!set_non_blocking(fd)) {
+    close(fd);
+    return;
+  }
+  clients_[fd] = Client{fd};
+}
+
+void RimeServer::OnMessage(void* server,
+                           RimeSessionId session_id,
+                           const char* message_type,
+                           const char* message_value) {
+  auto* self = static_cast<RimeServer*>(server);
+  {
+    std::lock_guard<std::mutex> lock(self->messages_mutex_);
+    self->messages_.push_back({session_id, "message " +
+                                               escape_line(message_type) +
+                                               " " +
+                                               escape_line(message_value) +
+                                               "\n"});
+  }
+  // the pipe being full, the polling thread is already to be woken.
+  char wake = 0;
+  ssize_t n = write(self->wake_fds_[1], &wake, 1);
+  (void)n;
+}
+
+void RimeServer::DeliverMessages() {
+  std::vector<Message> messages;
+  {
+    std::lock_guard<std::mutex> lock(messages_mutex_);
+    messages.swap(messages_);
+  }
+  for (const auto& message : messages) {
+    auto owner = session_owners_.find(message.session_id);
+    if (owner == session_owners_.end())
+      continue;
+    auto client = clients_.find(owner->second);
+    if (client != clients_.end())
+      client->second.output += message.line;
+  }
+}
+
+void RimeServer::DestroySession(Client* client, RimeSessionId session_id) {
+  rime_get_api()->destroy_session(session_id);
+  client->sessions.erase(session_id);
+  session_owners_.erase(session_id);
+}
+
+void RimeServer::Execute(Client* client, const string& line) {
+  RimeApi* rime = rime_get_api();
+  string& out = client->output;
+  std::istringstream request(line);
+  string command;
+  request >> command;
+  if (command == "create") {
+    RimeSessionId session_id = rime->create_session();
+    if (session_id) {
+      client->sessions.insert(session_id);
+      session_owners_[session_id] = client->fd;
+      out += "session " + std::to_string(session_id) + "\n";
+    } else {
+      out += "error cannot create session\n";
+    }
+    out += "\n";
+    return;
+  }
+  RimeSessionId session_id = 0;
+  request >> session_id;
+  if (!client->sessions.count(session_id)) {
+    out += "error unknown session\n\n";
+    return;
+  }
+  string arg;
+  std::getline(request >> std::ws, arg);
+  if (command == "destroy") {
+    DestroySession(client, session_id);
+  } else if (command == "key") {
+    int keycode = 0;
+    int mask = 0;
+    std::istringstream(arg) >> keycode >> mask;
+    bool handled = rime->process_key(session_id, keycode, mask);
+    out += string("handled ") + (handled ? "1" : "0") + "\n";
+    write_state(session_id, &out);
+  } else if (command == "keys") {
+    bool handled = rime->simulate_key_sequence(session_id, arg.c_str());
+    out += string("handled ") + (handled ? "1" : "0") + "\n";
+    write_state(session_id, &out);
+  } else if (command == "select") {
+    int index = atoi(arg.c_str());
+    if (index <= 0 ||
+        !rime->select_candidate_on_current_page(session_id, index - 1)) {
+      out += "error cannot select candidate\n";
+    }
+    write_state(session_id, &out);
+  } else if (command == "schema") {
+    if (!rime->select_schema(session_id, arg.c_str()))
+      out += "error cannot select schema\n";
+  } else if (command == "option") {
+    Bool is_on = True;
+    const char* option = arg.c_str();
+    if (*option == '!') {
+      is_on = False;
+      ++option;
+    }
+    rime->set_option(session_id, option, is_on);
+  } else if (command == "clear") {
+    rime->clear_composition(session_id);
+  } else if (command == "state") {
+    write_state(session_id, &out);
+  } else {
+    out += "error unknown command\n";
+  }
+  out += "\n";
+}
+
+void RimeServer::CloseClient(int fd) {
+  auto it = clients_.find(fd);
+  if (it == clients_.end())
+    return;
+  auto sessions = it->second.sessions;
+  for (RimeSessionId session_id : sessions) {
+    DestroySession(&it->second, session_id);
+  }
+  clients_.erase(it);
+  close(fd);
+}
+
+// reads the requests available from the client; false if it has left.
+bool RimeServer::Serve(Client* client) {
+  char buffer[4096];
+  ssize_t n = read(client->fd, buffer, sizeof(buffer));
+  if (n <= 0)
+    return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+  client->input.append(buffer, n);
+  size_t pos;
+  while ((pos = client->input.find('\n')) != string::npos) {
+    string line = client->input.substr(0, pos);
+    client->input.erase(0, pos + 1);
+    if (!line.empty() && line.back() == '\r')
+      line.pop_back();
+    if (!line.empty())
+      Execute(client, line);
+  }
+  // nor is a request that never ends held.
+  return client->input.size() <= max_pending_bytes_;
+}
+
+// writes as much of the pending replies as the client takes without
+// blocking; false if the client can no longer be reached.
+bool RimeServer::Flush(Client* client) {
+  while (!client->output.empty()) {
+    ssize_t n =
+        write(client->fd, client->output.data(), client->output.size());
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    client->output.erase(0, n);
+  }
+  return true;
+}
+
+bool RimeServer::Poll(int timeout) {
+  if (!ok())
+    return false;
+  std::vector<pollfd> fds;
+  fds.push_back({wake_fds_[0], POLLIN, 0});
+  if (server_fd_ >= 0)
+    fds.push_back({server_fd_, POLLIN, 0});
+  size_t first_client = fds.size();
+  for (const auto& client : clients_) {
+    short events = POLLIN;
+    if (!client.second.output.empty())
+      events |= POLLOUT;
+    fds.push_back({client.first, events, 0});
+  }
+  if (poll(fds.data(), fds.size(), timeout) < 0) {
+    if (errno == EINTR)
+      return true;
+    perror("poll");
+    return false;
+  }
+  if (fds[0].revents & POLLIN) {
+    char buffer[64];
+    while (read(wake_fds_[0], buffer, sizeof(buffer)) > 0) {
+    }
+  }
+  if (server_fd_ >= 0 && (fds[1].revents & POLLIN)) {
+    int fd = accept(server_fd_, NULL, NULL);
+    if (fd >= 0)
+      AddClient(fd);
+  }
+  for (size_t i = first_client; i < fds.size(); ++i) {
+    if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+      continue;
+    auto it = clients_.find(fds[i].fd);
+    if (it != clients_.end() && !Serve(&it->second))
+      CloseClient(fds[i].fd);
+  }
+  DeliverMessages();
+  for (auto it = clients_.begin(); it != clients_.end();) {
+    Client& client = (it++)->second;
+    if (!Flush(&client) || client.output.size() > max_pending_bytes_)
+      CloseClient(client.fd);
+  }
+  return true;
+}
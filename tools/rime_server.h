@@ -0,0 +1,102 @@
+/*
+ * Copyright RIME Developers
+ * Distributed under the BSD License
+ *
+ * Serves rime sessions to the frontends of a machine over a local socket,
+ * so that schemas and dictionaries are loaded once rather than once per
+ * frontend process.
+ *
+ * Each client connection owns the sessions it creates. Requests and replies
+ * are lines of text; a reply ends with an empty line.
+ *
+ *   create                    -> session <id>
+ *   destroy <id>
+ *   key <id> <keycode> <mask> -> handled <0|1>, followed by the state
+ *   keys <id> <key sequence>  -> handled <0|1>, followed by the state
+ *   select <id> <index>       -> selects a candidate on the current page
+ *   schema <id> <schema_id>
+ *   option <id> [!]<option>
+ *   clear <id>
+ *   state <id>                -> commit, status, preedit and candidates
+ *
+ * Notifications of a session are sent to its client as "message" lines,
+ * after the reply being written, if any.
+ *
+ * Text in the replies is escaped by escape_line(), so that it never breaks
+ * a line: a backslash, line feed and carriage return are sent as "\\",
+ * "\n" and "\r".
+ */
+#ifndef RIME_SERVER_H_
+#define RIME_SERVER_H_
+
+#include <stddef.h>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include <rime_api.h>
+
+std::string escape_line(const std::string& text);
+
+class RimeServer {
+ public:
+  // a client that leaves this many bytes of replies unread is dropped,
+  // rather than holding up the others or the memory of the server.
+  static const size_t kMaxPendingBytes = 1 << 20;
+
+  // serves the clients connecting to server_fd, which is not closed by the
+  // server. with a server_fd of -1, only clients added are served.
+  explicit RimeServer(int server_fd,
+                      size_t max_pending_bytes = kMaxPendingBytes);
+  ~RimeServer();
+
+  bool ok() const { return wake_fds_[0] >= 0; }
+  // serves the client connected to fd, which is closed by the server.
+  void AddClient(int fd);
+  // waits at most timeout milliseconds (-1 for ever) for the clients and
+  // serves them; false if the server can wait no more.
+  bool Poll(int timeout);
+  size_t client_count() const { return clients_.size(); }
+
+  // a notification handler for set_notification_handler(), taking the
+  // server as the context object. it may be called on any thread.
+  static void OnMessage(void* server,
+                        RimeSessionId session_id,
+                        const char* message_type,
+                        const char* message_value);
+
+ private:
+  struct Client {
+    int fd;
+    std::string input;
+    std::string output;
+    std::set<RimeSessionId> sessions;
+  };
+
+  struct Message {
+    RimeSessionId session_id;
+    std::string line;
+  };
+
+  void Execute(Client* client, const std::string& line);
+  void DestroySession(Client* client, RimeSessionId session_id);
+  void CloseClient(int fd);
+  bool Serve(Client* client);
+  bool Flush(Client* client);
+  void DeliverMessages();
+
+  int server_fd_;
+  size_t max_pending_bytes_;
+  // clients and the sessions they own are only touched on the thread that
+  // polls the server.
+  std::map<int, Client> clients_;
+  std::map<RimeSessionId, int> session_owners_;
+  // messages sent by other threads, delivered by the polling thread.
+  std::mutex messages_mutex_;
+  std::vector<Message> messages_;
+  // a byte written to the pipe wakes the polling thread for the messages.
+  int wake_fds_[2] = {-1, -1};
+};
+
+#endif  // RIME_SERVER_H_
@@ -0,0 +1,94 @@
+/*
+ * Copyright RIME Developers
+ * Distributed under the BSD License
+ *
+ * Serves rime sessions to the frontends of a machine over a local socket,
+ * so that schemas and dictionaries are loaded once rather than once per
+ * frontend process.
+ *
+ * The protocol is described in rime_server.h.
+ */
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <string>
+#include "rime_server.h"
+
+using std::string;
+
+static volatile sig_atomic_t stopping = 0;
+
+static void on_signal(int) {
+  stopping = 1;
+}
+
+static int listen_on(const string& socket_path) {
+  sockaddr_un address = {};
+  if (socket_path.size() >= sizeof(address.sun_path)) {
+    fprintf(stderr, "socket path too long: %s\n", socket_path.c_str());
+    return -1;
+  }
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    perror("socket");
+    return -1;
+  }
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+  unlink(socket_path.c_str());
+  if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+      listen(fd, SOMAXCONN) < 0) {
+    perror(socket_path.c_str());
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int main(int argc, char* argv[]) {
+  RimeApi* rime = rime_get_api();
+
+  RIME_STRUCT(RimeTraits, traits);
+  traits.app_name = "rime.server";
+  rime->setup(&traits);
+
+  fprintf(stderr, "initializing...\n");
+  rime->initialize(NULL);
+  if (rime->start_maintenance(False))
+    rime->join_maintenance_thread();
+
+  string socket_path;
+  if (argc > 1) {
+    socket_path = argv[1];
+  } else {
+    char user_data_dir[1024] = {0};
+    rime->get_user_data_dir_s(user_data_dir, sizeof(user_data_dir));
+    socket_path = string(user_data_dir) + "/rime_server.sock";
+  }
+  int server_fd = listen_on(socket_path);
+  if (server_fd < 0) {
+    rime->finalize();
+    return 1;
+  }
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+  signal(SIGPIPE, SIG_IGN);
+  fprintf(stderr, "listening on %s\n", socket_path.c_str());
+
+  // a single thread serves all clients; a key event takes far less time to
+  // process than it takes the user to type the next.
+  {
+    RimeServer server(server_fd);
+    rime->set_notification_handler(&RimeServer::OnMessage, &server);
+    while (!stopping && server.Poll(-1)) {
+    }
+    rime->set_notification_handler(NULL, NULL);
+  }
+  close(server_fd);
+  unlink(socket_path.c_str());
+  rime->finalize();
+  return 0;
+}
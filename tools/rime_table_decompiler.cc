@@ -33,11 +33,11 @@ void access(rime::Table* table,
             rime::TableAccessor accessor,
             std::ofstream& fout) {
   while (!accessor.exhausted()) {
-    auto word = table->GetEntryText(*accessor.entry());
+    auto word = table->GetEntryText(*accessor.entry_text());
     fout << word << "\t";
     outCode(table, accessor.code(), fout);
 
-    auto weight = accessor.entry()->weight;
+    auto weight = accessor.entry_weight();
     if (weight >= 0) {
       fout << "\t" << exp(weight);
     }
@@ -72,7 +72,9 @@ void traversal(rime::Table* table, std::ofstream& fout) {
 
   fout << std::fixed;
   fout << std::setprecision(0);
-  rime::TableQuery query(table->metadata()->index.get());
+  rime::TableQuery query(table->metadata()->index.get(),
+                         table->has_flat_trunk_index(), nullptr,
+                         table->has_compact_entries());
   recursion(table, &query, fout);
 }
 
@@ -124,8 +126,11 @@ int main(int argc, char* argv[]) {
           "name: "
        << file_path.stem().u8string()
        << "\n"
-          "version: \"1.0\"\n"
-          "...\n\n";
+          "version: \"1.0\"\n";
+  if (table.has_compact_entries()) {
+    fout << "compact_entries: true\n";
+  }
+  fout << "...\n\n";
   traversal(&table, fout);
   std::cout << "Save to: " << output_path << std::endl;
   fout.close();